@@ -131,6 +131,103 @@ ipaddr32_t AnonymizeIPAddr_PrefixMD5::anonymize(ipaddr32_t input)
 	return htonl(output);
 	}
 
+AnonymizeIPAddr_CryptoPAn::AnonymizeIPAddr_CryptoPAn()
+	{
+	ctx = 0;
+	}
+
+AnonymizeIPAddr_CryptoPAn::~AnonymizeIPAddr_CryptoPAn()
+	{
+	if ( ctx )
+		EVP_CIPHER_CTX_free(ctx);
+	}
+
+void AnonymizeIPAddr_CryptoPAn::init()
+	{
+	// Crypto-PAn takes a 256-bit secret: an AES key, and a block that
+	// it encrypts into the pad. We derive both from the HMAC key, so
+	// that they follow the random seed.
+	static const char key_label[] = "Crypto-PAn key";
+	static const char pad_label[] = "Crypto-PAn pad";
+	uint8 key[16];
+	uint8 pad_input[16];
+	hmac_md5(sizeof(key_label), (const u_char*) key_label, key);
+	hmac_md5(sizeof(pad_label), (const u_char*) pad_label, pad_input);
+
+	ctx = EVP_CIPHER_CTX_new();
+
+	if ( ! ctx || ! EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), 0, key, 0) )
+		reporter->InternalError("cannot initialize AES for Crypto-PAn");
+
+	EVP_CIPHER_CTX_set_padding(ctx, 0);
+
+	int len;
+	if ( ! EVP_EncryptUpdate(ctx, pad, &len, pad_input, sizeof(pad_input)) )
+		reporter->InternalError("AES encryption failed");
+	}
+
+ipaddr32_t AnonymizeIPAddr_CryptoPAn::flips(ipaddr32_t input, int first, int last)
+	{
+	// For bit i, the input to AES is the first i bits of the address,
+	// followed by the remaining ones of the pad. The blocks for all
+	// the bits go through AES at once, so that its rounds pipeline.
+	uint8 in[32 * 16];
+	uint8 out[32 * 16];
+	ipaddr32_t pad_first = (pad[0] << 24) | (pad[1] << 16) | (pad[2] << 8) | pad[3];
+	int num = last - first;
+
+	for ( int i = first; i < last; ++i )
+		{
+		ipaddr32_t known = i ? input & first_n_bit_mask(i) : 0;
+		ipaddr32_t block = known | (i ? pad_first & ~first_n_bit_mask(i) : pad_first);
+		uint8* b = in + (i - first) * 16;
+
+		b[0] = block >> 24;
+		b[1] = block >> 16;
+		b[2] = block >> 8;
+		b[3] = block;
+		memcpy(b + 4, pad + 4, 12);
+		}
+
+	int len;
+	if ( ! EVP_EncryptUpdate(ctx, out, &len, in, num * 16) )
+		reporter->InternalError("AES encryption failed");
+
+	ipaddr32_t result = 0;
+
+	// The most significant bit of each output block.
+	for ( int i = first; i < last; ++i )
+		result |= ipaddr32_t(out[(i - first) * 16] >> 7) << (31 - i);
+
+	return result;
+	}
+
+ipaddr32_t AnonymizeIPAddr_CryptoPAn::anonymize(ipaddr32_t input)
+	{
+	if ( ! ctx )
+		init();
+
+	input = ntohl(input);
+
+	ipaddr32_t prefix = input & first_n_bit_mask(24);
+	ipaddr32_t f;
+
+	std::unordered_map<ipaddr32_t, ipaddr32_t>::const_iterator i =
+		prefix_flips.find(prefix);
+
+	if ( i != prefix_flips.end() )
+		f = i->second;
+	else
+		{
+		f = flips(input, 0, 24);
+		prefix_flips[prefix] = f;
+		}
+
+	f |= flips(input, 24, 32);
+
+	return htonl(input ^ f);
+	}
+
 AnonymizeIPAddr_A50::~AnonymizeIPAddr_A50()
 	{
 	for ( unsigned int i = 0; i < blocks.size(); ++i )
@@ -354,6 +451,7 @@ void init_ip_addr_anonymizers()
 	ip_anonymizer[RANDOM_MD5] = new AnonymizeIPAddr_RandomMD5();
 	ip_anonymizer[PREFIX_PRESERVING_A50] = new AnonymizeIPAddr_A50();
 	ip_anonymizer[PREFIX_PRESERVING_MD5] = new AnonymizeIPAddr_PrefixMD5();
+	ip_anonymizer[PREFIX_PRESERVING_CRYPTOPAN] = new AnonymizeIPAddr_CryptoPAn();
 	}
 
 ipaddr32_t anonymize_ip(ipaddr32_t ip, enum ip_addr_anonymization_class_t cl)
@@ -11,9 +11,11 @@ const char* attr_name(attr_tag t)
 	static const char* attr_names[int(NUM_ATTRS)] = {
 		"&optional", "&default", "&redef",
 		"&add_func", "&delete_func", "&expire_func",
+		"&expire_batch_func",
 		"&read_expire", "&write_expire", "&create_expire",
 		"&raw_output", "&priority",
 		"&group", "&log", "&error_handler", "&type_column",
+		"&checkpoint",
 		"(&tracked)", "&deprecated",
 	};
 
@@ -414,11 +416,61 @@ void Attributes::CheckAttr(Attr* a)
 			break;
 			}
 
+		if ( FindAttr(ATTR_EXPIRE_BATCH_FUNC) )
+			{
+			Error("&expire_batch_func can't be combined with &expire_func");
+			break;
+			}
+
 		// ### Should type-check arguments to make sure first is
 		// table type and second is table index type.
 		}
 		break;
 
+	case ATTR_EXPIRE_BATCH_FUNC:
+		{
+		if ( type->Tag() != TYPE_TABLE )
+			{
+			Error("expiration only applicable to tables");
+			break;
+			}
+
+		if ( FindAttr(ATTR_EXPIRE_FUNC) )
+			{
+			Error("&expire_batch_func can't be combined with &expire_func");
+			break;
+			}
+
+		const Expr* batch_func = a->AttrExpr();
+
+		if ( batch_func->Type()->Tag() != TYPE_FUNC )
+			{
+			Error("&expire_batch_func must be a function");
+			break;
+			}
+
+		const FuncType* e_ft = batch_func->Type()->AsFuncType();
+		const BroType* yt = e_ft->YieldType();
+
+		if ( yt && yt->Tag() != TYPE_VOID )
+			{
+			Error("&expire_batch_func must not return a value");
+			break;
+			}
+
+		const RecordType* args = e_ft->Args();
+		const BroType* idx_t = args->NumFields() == 2 ? args->FieldType(1) : 0;
+
+		if ( ! idx_t || ! idx_t->IsSet() ||
+		     ! same_type(idx_t->AsTableType()->Indices(),
+				 type->AsTableType()->Indices()) )
+			{
+			Error("&expire_batch_func function must take the table and a set of its indices");
+			break;
+			}
+		}
+		break;
+
 	case ATTR_TRACKED:
 		// FIXME: Check here for global ID?
 		break;
@@ -449,6 +501,13 @@ void Attributes::CheckAttr(Attr* a)
 			Error("&log applied to a type that cannot be logged");
 		break;
 
+	case ATTR_CHECKPOINT:
+		if ( in_record )
+			Error("&checkpoint only applicable to global variables");
+		else if ( type->Tag() == TYPE_FUNC || type->Tag() == TYPE_FILE )
+			Error("&checkpoint applied to a type that cannot be saved");
+		break;
+
 	case ATTR_TYPE_COLUMN:
 		{
 		if ( type->Tag() != TYPE_PORT )
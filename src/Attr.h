@@ -18,6 +18,7 @@ typedef enum {
 	ATTR_ADD_FUNC,
 	ATTR_DEL_FUNC,
 	ATTR_EXPIRE_FUNC,
+	ATTR_EXPIRE_BATCH_FUNC,
 	ATTR_EXPIRE_READ,
 	ATTR_EXPIRE_WRITE,
 	ATTR_EXPIRE_CREATE,
@@ -27,6 +28,7 @@ typedef enum {
 	ATTR_LOG,
 	ATTR_ERROR_HANDLER,
 	ATTR_TYPE_COLUMN,	// for input framework
+	ATTR_CHECKPOINT,
 	ATTR_TRACKED,	// hidden attribute, tracked by NotifierRegistry
 	ATTR_DEPRECATED,
 #define NUM_ATTRS (int(ATTR_DEPRECATED) + 1)
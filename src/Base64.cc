@@ -2,6 +2,10 @@
 #include "Base64.h"
 #include <math.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 int Base64Converter::default_base64_table[256];
 const string Base64Converter::default_alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
@@ -107,6 +111,81 @@ Base64Converter::~Base64Converter()
 		delete [] base64_table;
 	}
 
+#ifdef __SSE2__
+static inline __m128i in_range(__m128i v, char lo, char hi)
+	{
+	return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+			     _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+	}
+
+// Returns true if the 16 characters are all of the default alphabet.
+// Those are all ASCII, so the signed comparisons leave out the
+// characters from 0x80 on.
+static inline bool all_default_base64(const unsigned char* p)
+	{
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+
+	__m128i ok = _mm_or_si128(
+		_mm_or_si128(in_range(v, 'A', 'Z'), in_range(v, 'a', 'z')),
+		_mm_or_si128(in_range(v, '0', '9'),
+			     _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('+')),
+					  _mm_cmpeq_epi8(v, _mm_set1_epi8('/')))));
+
+	return _mm_movemask_epi8(ok) == 0xffff;
+	}
+#endif
+
+int Base64Converter::DecodeGroups(int len, const char* data, char* buf, int blen)
+	{
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+	int max = min(len / 4, blen / 3) * 4;
+	int n = 0;
+
+#ifdef __SSE2__
+	if ( base64_table == default_base64_table )
+		{
+		// Whole blocks of valid characters need no checks at all.
+		while ( n + 16 <= max && all_default_base64(p + n) )
+			{
+			for ( int i = 0; i < 16; i += 4, n += 4 )
+				{
+				uint32 bit32 =
+					(base64_table[p[n]] << 18) |
+					(base64_table[p[n+1]] << 12) |
+					(base64_table[p[n+2]] << 6) |
+					base64_table[p[n+3]];
+
+				*buf++ = char(bit32 >> 16);
+				*buf++ = char(bit32 >> 8);
+				*buf++ = char(bit32);
+				}
+			}
+		}
+#endif
+
+	while ( n < max )
+		{
+		int a = base64_table[p[n]];
+		int b = base64_table[p[n+1]];
+		int c = base64_table[p[n+2]];
+		int d = base64_table[p[n+3]];
+
+		// Leave anything unusual, including padding, to Decode().
+		if ( (a | b | c | d) < 0 || p[n] == '=' || p[n+1] == '=' ||
+		     p[n+2] == '=' || p[n+3] == '=' )
+			break;
+
+		uint32 bit32 = (a << 18) | (b << 12) | (c << 6) | d;
+
+		*buf++ = char(bit32 >> 16);
+		*buf++ = char(bit32 >> 8);
+		*buf++ = char(bit32);
+		n += 4;
+		}
+
+	return n;
+	}
+
 int Base64Converter::Decode(int len, const char* data, int* pblen, char** pbuf)
 	{
 	int blen;
@@ -178,6 +257,17 @@ int Base64Converter::Decode(int len, const char* data, int* pblen, char** pbuf)
 		if ( dlen >= len )
 			break;
 
+		if ( base64_group_next == 0 && ! base64_after_padding )
+			{
+			int n = DecodeGroups(len - dlen, data + dlen, buf,
+						(*pbuf + blen) - buf);
+			buf += n / 4 * 3;
+			dlen += n;
+
+			if ( dlen >= len )
+				break;
+			}
+
 		if ( data[dlen] == '=' )
 			++base64_padding;
 
@@ -53,6 +53,12 @@ public:
 protected:
 	char error_msg[256];
 
+	// Decodes as many complete groups of four valid characters, without
+	// padding, as there are at the start of the input and fit into the
+	// buffer. Returns the number of input characters consumed. Only to
+	// be called in between groups.
+	int DecodeGroups(int len, const char* data, char* buf, int blen);
+
 protected:
 	static const string default_alphabet;
 	string alphabet;
@@ -117,7 +117,10 @@ public:
 	void ToUpper();
 
 	unsigned int MemoryAllocation() const
-		{ return padded_sizeof(*this) + pad_size(n + final_NUL); }
+		{
+		return padded_sizeof(*this) +
+			(b == small ? 0 : pad_size(n + final_NUL));
+		}
 
 	// Returns new string containing the substring of this string,
 	// starting at @start >= 0 for going up to @length elements,
@@ -146,10 +149,22 @@ public:
 protected:
 	void Reset();
 
+	// Returns room for len bytes: the inline buffer if they fit, or
+	// else a new heap buffer.
+	byte_vec Alloc(int len)
+		{ return len <= SMALL_SIZE ? small : new u_char[len]; }
+
 	byte_vec b;
 	int n;
 	unsigned int final_NUL:1;	// whether we have added a final NUL
 	unsigned int use_free_to_delete:1;	// free() vs. operator delete
+
+	// Most strings are short, like methods, header names, labels and
+	// enum-like values. Those that we copy in live right here instead
+	// of in an allocation of their own. That's room for 15 characters
+	// and a NUL, and keeps the object at 32 bytes.
+	static const int SMALL_SIZE = 16;
+	u_char small[SMALL_SIZE];
 };
 
 // A comparison class that sorts pointers to BroString's according to
@@ -0,0 +1,643 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Checkpoint.h"
+#include "ID.h"
+#include "Net.h"
+#include "Reporter.h"
+#include "Scope.h"
+#include "Timer.h"
+#include "Val.h"
+#include "Var.h"
+#include "broker/Data.h"
+
+Checkpointer* checkpointer = 0;
+
+// A checkpoint starts with these, followed by the name and value of each
+// global.
+static const char CHECKPOINT_MAGIC[4] = { 'Z', 'C', 'K', 'P' };
+static const uint8 CHECKPOINT_VERSION = 1;
+
+// How deeply containers may nest in a value we read back.
+#define MAX_DEPTH 64
+
+// Each encoded value starts with one of these.
+enum DataTag {
+	TAG_NONE,
+	TAG_BOOL,
+	TAG_COUNT,
+	TAG_INTEGER,
+	TAG_REAL,
+	TAG_STRING,
+	TAG_ADDRESS,
+	TAG_SUBNET,
+	TAG_PORT,
+	TAG_TIMESTAMP,
+	TAG_TIMESPAN,
+	TAG_ENUM,
+	TAG_SET,
+	TAG_TABLE,
+	TAG_VECTOR,
+};
+
+// Appends broker data to a string. Integers and lengths are varints,
+// signed ones zigzag-encoded; doubles are little-endian.
+struct data_encoder {
+	using result_type = void;
+
+	std::string* out;
+
+	void Varint(uint64 x)
+		{
+		while ( x >= 0x80 )
+			{
+			out->push_back(char(x | 0x80));
+			x >>= 7;
+			}
+
+		out->push_back(char(x));
+		}
+
+	void Signed(int64 x)
+		{ Varint((uint64(x) << 1) ^ uint64(x >> 63)); }
+
+	void Tag(DataTag t)
+		{ out->push_back(char(t)); }
+
+	void String(const std::string& s)
+		{
+		Varint(s.size());
+		out->append(s);
+		}
+
+	void Address(const broker::address& a)
+		{ out->append(reinterpret_cast<const char*>(a.bytes().data()), 16); }
+
+	result_type operator()(broker::none)
+		{ Tag(TAG_NONE); }
+
+	result_type operator()(bool b)
+		{
+		Tag(TAG_BOOL);
+		out->push_back(char(b));
+		}
+
+	result_type operator()(uint64_t x)
+		{
+		Tag(TAG_COUNT);
+		Varint(x);
+		}
+
+	result_type operator()(int64_t x)
+		{
+		Tag(TAG_INTEGER);
+		Signed(x);
+		}
+
+	result_type operator()(double d)
+		{
+		uint64 x;
+		memcpy(&x, &d, sizeof(x));
+		Tag(TAG_REAL);
+
+		for ( int i = 0; i < 8; ++i )
+			out->push_back(char(x >> (8 * i)));
+		}
+
+	result_type operator()(const std::string& s)
+		{
+		Tag(TAG_STRING);
+		String(s);
+		}
+
+	result_type operator()(const broker::address& a)
+		{
+		Tag(TAG_ADDRESS);
+		Address(a);
+		}
+
+	result_type operator()(const broker::subnet& s)
+		{
+		Tag(TAG_SUBNET);
+		Address(s.network());
+		out->push_back(char(s.length()));
+		}
+
+	result_type operator()(const broker::port& p)
+		{
+		Tag(TAG_PORT);
+		Varint(p.number());
+		out->push_back(char(p.type()));
+		}
+
+	result_type operator()(const broker::timestamp& t)
+		{
+		Tag(TAG_TIMESTAMP);
+		Signed(t.time_since_epoch().count());
+		}
+
+	result_type operator()(const broker::timespan& t)
+		{
+		Tag(TAG_TIMESPAN);
+		Signed(t.count());
+		}
+
+	result_type operator()(const broker::enum_value& e)
+		{
+		Tag(TAG_ENUM);
+		String(e.name);
+		}
+
+	result_type operator()(const broker::set& s)
+		{
+		Tag(TAG_SET);
+		Varint(s.size());
+
+		for ( const auto& x : s )
+			caf::visit(*this, x);
+		}
+
+	result_type operator()(const broker::table& t)
+		{
+		Tag(TAG_TABLE);
+		Varint(t.size());
+
+		for ( const auto& x : t )
+			{
+			caf::visit(*this, x.first);
+			caf::visit(*this, x.second);
+			}
+		}
+
+	result_type operator()(const broker::vector& v)
+		{
+		Tag(TAG_VECTOR);
+		Varint(v.size());
+
+		for ( const auto& x : v )
+			caf::visit(*this, x);
+		}
+};
+
+// Reads back what data_encoder wrote, straight from the mapped file.
+class DataDecoder {
+public:
+	DataDecoder(const char* data, size_t len)
+		: p(data), end(data + len)	{ }
+
+	bool AtEnd() const	{ return p == end; }
+
+	bool Bytes(void* buf, size_t n)
+		{
+		if ( size_t(end - p) < n )
+			return false;
+
+		memcpy(buf, p, n);
+		p += n;
+		return true;
+		}
+
+	bool Varint(uint64* x)
+		{
+		*x = 0;
+
+		for ( int shift = 0; shift < 64; shift += 7 )
+			{
+			if ( p == end )
+				return false;
+
+			uint8 b = uint8(*p++);
+			*x |= uint64(b & 0x7f) << shift;
+
+			if ( ! (b & 0x80) )
+				return true;
+			}
+
+		return false;
+		}
+
+	bool Signed(int64* x)
+		{
+		uint64 u;
+
+		if ( ! Varint(&u) )
+			return false;
+
+		*x = int64(u >> 1) ^ -int64(u & 1);
+		return true;
+		}
+
+	bool String(std::string* s)
+		{
+		uint64 n;
+
+		if ( ! Varint(&n) || n > uint64(end - p) )
+			return false;
+
+		s->assign(p, n);
+		p += n;
+		return true;
+		}
+
+	bool Address(broker::address* a)
+		{
+		uint32_t bytes[4];
+
+		if ( ! Bytes(bytes, sizeof(bytes)) )
+			return false;
+
+		*a = broker::address(bytes, broker::address::family::ipv6,
+				     broker::address::byte_order::network);
+		return true;
+		}
+
+	bool Data(broker::data* d, int depth = 0);
+
+private:
+	const char* p;
+	const char* end;
+};
+
+bool DataDecoder::Data(broker::data* d, int depth)
+	{
+	uint8 tag;
+
+	if ( depth > MAX_DEPTH || ! Bytes(&tag, 1) )
+		return false;
+
+	switch ( tag ) {
+	case TAG_NONE:
+		*d = broker::none{};
+		return true;
+
+	case TAG_BOOL:
+		{
+		uint8 b;
+
+		if ( ! Bytes(&b, 1) )
+			return false;
+
+		*d = bool(b);
+		return true;
+		}
+
+	case TAG_COUNT:
+		{
+		uint64 x;
+
+		if ( ! Varint(&x) )
+			return false;
+
+		*d = broker::count(x);
+		return true;
+		}
+
+	case TAG_INTEGER:
+		{
+		int64 x;
+
+		if ( ! Signed(&x) )
+			return false;
+
+		*d = broker::integer(x);
+		return true;
+		}
+
+	case TAG_REAL:
+		{
+		uint8 b[8];
+
+		if ( ! Bytes(b, sizeof(b)) )
+			return false;
+
+		uint64 x = 0;
+
+		for ( int i = 0; i < 8; ++i )
+			x |= uint64(b[i]) << (8 * i);
+
+		double r;
+		memcpy(&r, &x, sizeof(r));
+		*d = r;
+		return true;
+		}
+
+	case TAG_STRING:
+		{
+		std::string s;
+
+		if ( ! String(&s) )
+			return false;
+
+		*d = std::move(s);
+		return true;
+		}
+
+	case TAG_ADDRESS:
+		{
+		broker::address a;
+
+		if ( ! Address(&a) )
+			return false;
+
+		*d = a;
+		return true;
+		}
+
+	case TAG_SUBNET:
+		{
+		broker::address a;
+		uint8 len;
+
+		if ( ! Address(&a) || ! Bytes(&len, 1) )
+			return false;
+
+		*d = broker::subnet(a, len);
+		return true;
+		}
+
+	case TAG_PORT:
+		{
+		uint64 n;
+		uint8 proto;
+
+		if ( ! Varint(&n) || ! Bytes(&proto, 1) )
+			return false;
+
+		*d = broker::port(n, static_cast<broker::port::protocol>(proto));
+		return true;
+		}
+
+	case TAG_TIMESTAMP:
+	case TAG_TIMESPAN:
+		{
+		int64 ns;
+
+		if ( ! Signed(&ns) )
+			return false;
+
+		if ( tag == TAG_TIMESTAMP )
+			*d = broker::timestamp(broker::timespan(ns));
+		else
+			*d = broker::timespan(ns);
+
+		return true;
+		}
+
+	case TAG_ENUM:
+		{
+		std::string name;
+
+		if ( ! String(&name) )
+			return false;
+
+		*d = broker::enum_value(std::move(name));
+		return true;
+		}
+
+	case TAG_SET:
+	case TAG_VECTOR:
+		{
+		uint64 n;
+
+		if ( ! Varint(&n) )
+			return false;
+
+		broker::set s;
+		broker::vector v;
+
+		for ( uint64 i = 0; i < n; ++i )
+			{
+			broker::data x;
+
+			if ( ! Data(&x, depth + 1) )
+				return false;
+
+			if ( tag == TAG_SET )
+				s.insert(std::move(x));
+			else
+				v.push_back(std::move(x));
+			}
+
+		if ( tag == TAG_SET )
+			*d = std::move(s);
+		else
+			*d = std::move(v);
+
+		return true;
+		}
+
+	case TAG_TABLE:
+		{
+		uint64 n;
+
+		if ( ! Varint(&n) )
+			return false;
+
+		broker::table t;
+
+		for ( uint64 i = 0; i < n; ++i )
+			{
+			broker::data k, v;
+
+			if ( ! Data(&k, depth + 1) || ! Data(&v, depth + 1) )
+				return false;
+
+			t.emplace(std::move(k), std::move(v));
+			}
+
+		*d = std::move(t);
+		return true;
+		}
+
+	default:
+		return false;
+	}
+	}
+
+class CheckpointTimer : public Timer {
+public:
+	CheckpointTimer(double t, Checkpointer* arg_cp)
+		: Timer(t, TIMER_CHECKPOINT)	{ cp = arg_cp; }
+
+	void Dispatch(double t, int is_expire) override
+		{
+		// When terminating, the checkpointer gets to save once more
+		// anyway.
+		if ( is_expire )
+			return;
+
+		cp->Save();
+		timer_mgr->Add(new CheckpointTimer(network_time + cp->Interval(), cp));
+		}
+
+protected:
+	Checkpointer* cp;
+};
+
+Checkpointer::Checkpointer()
+	{
+	StringVal* f = opt_internal_string("checkpoint_file");
+	file = f ? f->CheckString() : "";
+	interval = opt_internal_double("checkpoint_interval");
+
+	if ( file.empty() )
+		return;
+
+	PDict(ID)* globals = global_scope()->Vars();
+	IterCookie* c = globals->InitForIteration();
+
+	ID* id;
+	while ( (id = globals->NextEntry(c)) )
+		{
+		if ( id->FindAttr(ATTR_CHECKPOINT) )
+			ids.push_back(id);
+		}
+
+	if ( ! ids.empty() && interval > 0 )
+		timer_mgr->Add(new CheckpointTimer(network_time + interval, this));
+	}
+
+Checkpointer::~Checkpointer()
+	{
+	}
+
+void Checkpointer::Restore()
+	{
+	int fd = open(file.c_str(), O_RDONLY);
+
+	if ( fd < 0 )
+		{
+		if ( errno != ENOENT )
+			reporter->Error("can't open checkpoint %s: %s",
+					file.c_str(), strerror(errno));
+		return;
+		}
+
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || st.st_size == 0 )
+		{
+		close(fd);
+		return;
+		}
+
+	void* m = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if ( m == MAP_FAILED )
+		{
+		reporter->Error("can't map checkpoint %s: %s",
+				file.c_str(), strerror(errno));
+		return;
+		}
+
+	DataDecoder dec(static_cast<const char*>(m), st.st_size);
+	char magic[sizeof(CHECKPOINT_MAGIC)];
+	uint8 version;
+
+	if ( ! dec.Bytes(magic, sizeof(magic)) ||
+	     memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ||
+	     ! dec.Bytes(&version, 1) || version != CHECKPOINT_VERSION )
+		{
+		reporter->Error("%s is not a checkpoint of this version", file.c_str());
+		munmap(m, st.st_size);
+		return;
+		}
+
+	while ( ! dec.AtEnd() )
+		{
+		std::string name;
+		broker::data d;
+
+		if ( ! dec.String(&name) || ! dec.Data(&d) )
+			{
+			reporter->Error("checkpoint %s is truncated or corrupt",
+					file.c_str());
+			break;
+			}
+
+		ID* id = global_scope()->Lookup(name.c_str());
+
+		if ( ! id || ! id->FindAttr(ATTR_CHECKPOINT) )
+			// Not marked any longer.
+			continue;
+
+		Val* v = bro_broker::data_to_val(std::move(d), id->Type());
+
+		if ( ! v )
+			{
+			reporter->Warning("can't restore %s from checkpoint: type changed",
+					  name.c_str());
+			continue;
+			}
+
+		if ( v->Type()->Tag() == TYPE_TABLE && id->HasVal() )
+			{
+			// Keep the table the scripts created, with its
+			// attributes, and just add the entries.
+			v->AsTableVal()->AddTo(id->ID_Val(), 0, false);
+			Unref(v);
+			}
+		else
+			id->SetVal(v);
+		}
+
+	munmap(m, st.st_size);
+	}
+
+bool Checkpointer::Save()
+	{
+	std::string buf(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+	buf.push_back(char(CHECKPOINT_VERSION));
+
+	data_encoder enc{&buf};
+
+	for ( auto id : ids )
+		{
+		if ( ! id->HasVal() )
+			continue;
+
+		auto d = bro_broker::val_to_data(id->ID_Val());
+
+		if ( ! d )
+			{
+			reporter->Warning("can't checkpoint %s", id->Name());
+			continue;
+			}
+
+		enc.String(id->Name());
+		caf::visit(enc, *d);
+		}
+
+	std::string tmp = file + ".tmp";
+	FILE* f = fopen(tmp.c_str(), "w");
+
+	if ( ! f )
+		{
+		reporter->Error("can't write checkpoint %s: %s", tmp.c_str(), strerror(errno));
+		return false;
+		}
+
+	bool ok = fwrite(buf.data(), buf.size(), 1, f) == 1;
+
+	if ( fclose(f) != 0 )
+		ok = false;
+
+	if ( ! ok || rename(tmp.c_str(), file.c_str()) < 0 )
+		{
+		reporter->Error("can't write checkpoint %s: %s", file.c_str(), strerror(errno));
+		unlink(tmp.c_str());
+		return false;
+		}
+
+	return true;
+	}
@@ -0,0 +1,47 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef checkpoint_h
+#define checkpoint_h
+
+#include <string>
+#include <vector>
+
+class ID;
+
+// Saves the values of the global variables marked &checkpoint to
+// checkpoint_file when Zeek terminates, and every checkpoint_interval, and
+// restores them from there when Zeek starts, right before zeek_init. Tables
+// and sets get the saved entries added to what the scripts initialized them
+// to; other values get replaced.
+//
+// The values get converted to Broker data, as for sending them to peers,
+// which gets encoded in a compact binary format. The file is written to a
+// temporary one first, then renamed, so that a crash in the midst of it
+// leaves the previous checkpoint intact. For restoring, it's mapped into
+// memory and decoded from there.
+class Checkpointer {
+public:
+	Checkpointer();
+	~Checkpointer();
+
+	// False if no global is marked &checkpoint.
+	int IsActive()	{ return ! ids.empty(); }
+
+	// Restores the globals from the file, if there is one.
+	void Restore();
+
+	// Writes the current values to the file. Returns false on error,
+	// which has been reported then.
+	bool Save();
+
+	double Interval() const	{ return interval; }
+
+protected:
+	std::vector<ID*> ids;
+	std::string file;
+	double interval;
+};
+
+extern Checkpointer* checkpointer;
+
+#endif
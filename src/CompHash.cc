@@ -10,8 +10,9 @@
 #include <vector>
 #include <map>
 
-CompositeHash::CompositeHash(TypeList* composite_type)
+CompositeHash::CompositeHash(TypeList* composite_type, HashPolicy arg_policy)
 	{
+	policy = arg_policy;
 	type = composite_type;
 	Ref(type);
 	singleton_tag = TYPE_INTERNAL_ERROR;
@@ -53,14 +54,67 @@ CompositeHash::CompositeHash(TypeList* composite_type)
 		size = ComputeKeySize(0, 1, true);
 
 		if ( size > 0 )
+			{
 			// Fixed size.  Make sure what we get is fully aligned.
 			key = reinterpret_cast<char*>
 				(new double[size/sizeof(double) + 1]);
+
+			if ( ! is_complex_type )
+				InitFlat();
+			}
 		else
 			key = 0;
 		}
 	}
 
+void CompositeHash::InitFlat()
+	{
+	const type_list* tl = type->Types();
+	std::vector<int> offsets;
+	int sz = 0;
+
+	loop_over_list(*tl, i)
+		{
+		unsigned int width;
+
+		switch ( (*tl)[i]->InternalType() ) {
+		case TYPE_INTERNAL_INT:
+		case TYPE_INTERNAL_UNSIGNED:
+			width = sizeof(bro_int_t);
+			break;
+
+		case TYPE_INTERNAL_DOUBLE:
+			width = sizeof(double);
+			break;
+
+		case TYPE_INTERNAL_ADDR:
+		case TYPE_INTERNAL_SUBNET:
+			width = sizeof(uint32);
+			break;
+
+		default:
+			return;
+		}
+
+		// Same layout as SingleValHash() produces.
+		int end = SizeAlign(sz, width);
+		offsets.push_back(end - width);
+		sz = end;
+
+		if ( (*tl)[i]->InternalType() == TYPE_INTERNAL_ADDR )
+			sz += sizeof(uint32) * 3;
+		else if ( (*tl)[i]->InternalType() == TYPE_INTERNAL_SUBNET )
+			sz += sizeof(uint32) * 4;
+		}
+
+	if ( sz != size )
+		return;
+
+	// We never write the alignment padding, so clear it once.
+	memset(key, 0, size);
+	flat_offsets = offsets;
+	}
+
 CompositeHash::~CompositeHash()
 	{
 	Unref(type);
@@ -322,6 +376,9 @@ HashKey* CompositeHash::ComputeHash(const Val* v, int type_check) const
 	if ( is_singleton )
 		return ComputeSingletonHash(v, type_check);
 
+	if ( ! flat_offsets.empty() )
+		return ComputeFlatHash(v, type_check);
+
 	if ( is_complex_type && v->Type()->Tag() != TYPE_LIST )
 		{
 		ListVal lv(TYPE_ANY);
@@ -365,7 +422,17 @@ HashKey* CompositeHash::ComputeHash(const Val* v, int type_check) const
 			return 0;
 		}
 
-	return new HashKey((k == key), (void*) k, kp - k);
+	return new HashKey((k == key), (void*) k, kp - k, policy);
+	}
+
+HashKey* CompositeHash::WithPolicy(HashKey* k) const
+	{
+	if ( ! k || k->Policy() == policy )
+		return k;
+
+	HashKey* pk = new HashKey(k->Key(), k->Size(), k->Hash(policy), policy);
+	delete k;
+	return pk;
 	}
 
 HashKey* CompositeHash::ComputeSingletonHash(const Val* v, int type_check) const
@@ -385,27 +452,27 @@ HashKey* CompositeHash::ComputeSingletonHash(const Val* v, int type_check) const
 	switch ( singleton_tag ) {
 	case TYPE_INTERNAL_INT:
 	case TYPE_INTERNAL_UNSIGNED:
-		return new HashKey(v->ForceAsInt());
+		return new HashKey(v->ForceAsInt(), policy);
 
 	case TYPE_INTERNAL_ADDR:
-		return v->AsAddr().GetHashKey();
+		return WithPolicy(static_cast<const AddrVal*>(v)->GetHashKey());
 
 	case TYPE_INTERNAL_SUBNET:
-		return v->AsSubNet().GetHashKey();
+		return WithPolicy(v->AsSubNet().GetHashKey());
 
 	case TYPE_INTERNAL_DOUBLE:
-		return new HashKey(v->InternalDouble());
+		return new HashKey(v->InternalDouble(), policy);
 
 	case TYPE_INTERNAL_VOID:
 	case TYPE_INTERNAL_OTHER:
 		if ( v->Type()->Tag() == TYPE_FUNC )
-			return new HashKey(v->AsFunc()->GetUniqueFuncID());
+			return new HashKey(v->AsFunc()->GetUniqueFuncID(), policy);
 
 		reporter->InternalError("bad index type in CompositeHash::ComputeSingletonHash");
 		return 0;
 
 	case TYPE_INTERNAL_STRING:
-		return new HashKey(v->AsString());
+		return WithPolicy(static_cast<const StringVal*>(v)->GetHashKey());
 
 	case TYPE_INTERNAL_ERROR:
 		return 0;
@@ -416,6 +483,60 @@ HashKey* CompositeHash::ComputeSingletonHash(const Val* v, int type_check) const
 	}
 	}
 
+HashKey* CompositeHash::ComputeFlatHash(const Val* v, int type_check) const
+	{
+	if ( type_check && v->Type()->Tag() != TYPE_LIST )
+		return 0;
+
+	const val_list* vl = v->AsListVal()->Vals();
+	const type_list* tl = type->Types();
+
+	if ( type_check && vl->length() != tl->length() )
+		return 0;
+
+	loop_over_list(*tl, i)
+		{
+		const Val* vi = (*vl)[i];
+		InternalTypeTag t = (*tl)[i]->InternalType();
+		char* kp = key + flat_offsets[i];
+
+		if ( type_check && vi->Type()->InternalType() != t )
+			return 0;
+
+		switch ( t ) {
+		case TYPE_INTERNAL_INT:
+			*reinterpret_cast<bro_int_t*>(kp) = vi->ForceAsInt();
+			break;
+
+		case TYPE_INTERNAL_UNSIGNED:
+			*reinterpret_cast<bro_uint_t*>(kp) = vi->ForceAsUInt();
+			break;
+
+		case TYPE_INTERNAL_DOUBLE:
+			*reinterpret_cast<double*>(kp) = vi->InternalDouble();
+			break;
+
+		case TYPE_INTERNAL_ADDR:
+			vi->AsAddr().CopyIPv6(reinterpret_cast<uint32*>(kp));
+			break;
+
+		case TYPE_INTERNAL_SUBNET:
+			{
+			uint32* skp = reinterpret_cast<uint32*>(kp);
+			vi->AsSubNet().Prefix().CopyIPv6(skp);
+			skp[4] = vi->AsSubNet().Length();
+			}
+			break;
+
+		default:
+			reporter->InternalError("bad internal type in CompositeHash::ComputeFlatHash");
+			return 0;
+		}
+		}
+
+	return new HashKey(1, key, size, policy);
+	}
+
 int CompositeHash::SingleTypeKeySize(BroType* bt, const Val* v,
 				     int type_check, int sz, bool optional,
 				     bool calc_static_size) const
@@ -670,6 +791,9 @@ int CompositeHash::SizeAlign(int offset, unsigned int size) const
 
 ListVal* CompositeHash::RecoverVals(const HashKey* k) const
 	{
+	if ( ! flat_offsets.empty() )
+		return RecoverFlatVals(k);
+
 	ListVal* l = new ListVal(TYPE_ANY);
 	const type_list* tl = type->Types();
 	const char* kp = (const char*) k->Key();
@@ -689,6 +813,51 @@ ListVal* CompositeHash::RecoverVals(const HashKey* k) const
 	return l;
 	}
 
+ListVal* CompositeHash::RecoverFlatVals(const HashKey* k) const
+	{
+	if ( k->Size() != size )
+		reporter->InternalError("bad key size in CompositeHash::RecoverFlatVals");
+
+	ListVal* l = new ListVal(TYPE_ANY);
+	const type_list* tl = type->Types();
+	const char* const k_start = (const char*) k->Key();
+	const char* const k_end = k_start + size;
+
+	loop_over_list(*tl, i)
+		{
+		BroType* t = (*tl)[i];
+		const char* kp = k_start + flat_offsets[i];
+		Val* v = nullptr;
+
+		// Handle the most common index types directly, the
+		// rest the generic way.
+		switch ( t->Tag() ) {
+		case TYPE_ADDR:
+			v = new AddrVal(IPAddr(IPv6, reinterpret_cast<const uint32*>(kp),
+			                       IPAddr::Network));
+			break;
+
+		case TYPE_PORT:
+			v = val_mgr->GetPort(*reinterpret_cast<const bro_uint_t*>(kp));
+			break;
+
+		case TYPE_COUNT:
+		case TYPE_COUNTER:
+			v = val_mgr->GetCount(*reinterpret_cast<const bro_uint_t*>(kp));
+			break;
+
+		default:
+			RecoverOneVal(k, kp, k_end, t, v, false);
+			break;
+		}
+
+		ASSERT(v);
+		l->Append(v);
+		}
+
+	return l;
+	}
+
 const char* CompositeHash::RecoverOneVal(const HashKey* k, const char* kp0,
 					 const char* const k_end, BroType* t,
 					 Val*& pval, bool optional) const
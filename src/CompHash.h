@@ -3,6 +3,8 @@
 #ifndef comphash_h
 #define comphash_h
 
+#include <vector>
+
 #include "Hash.h"
 #include "Type.h"
 
@@ -10,7 +12,10 @@ class ListVal;
 
 class CompositeHash {
 public:
-	explicit CompositeHash(TypeList* composite_type);
+	// The keys get hashed with the given policy, which should be the
+	// one of the dictionary they're for.
+	explicit CompositeHash(TypeList* composite_type,
+				HashPolicy policy = HASH_KEYED);
 	~CompositeHash();
 
 	// Compute the hash corresponding to the given index val,
@@ -25,6 +30,19 @@ public:
 protected:
 	HashKey* ComputeSingletonHash(const Val* v, int type_check) const;
 
+	// Returns the key itself if it's been built with our policy, or
+	// else a copy of it that is, deleting the original.
+	HashKey* WithPolicy(HashKey* k) const;
+
+	// Fast paths for indices made up only of fixed-size atomic types,
+	// such as [addr, port] or [addr, addr].  Each component lives at
+	// an offset computed once up front.
+	HashKey* ComputeFlatHash(const Val* v, int type_check) const;
+	ListVal* RecoverFlatVals(const HashKey* k) const;
+
+	// Sets up flat_offsets if the index qualifies for the fast paths.
+	void InitFlat();
+
 	// Computes the piece of the hash for Val*, returning the new kp.
 	// Used as a helper for ComputeHash in the non-singleton case.
 	char* SingleValHash(int type_check, char* kp, BroType* bt, Val* v,
@@ -88,6 +106,11 @@ protected:
 	int is_complex_type;
 
 	InternalTypeTag singleton_tag;
+	HashPolicy policy;
+
+	// If non-empty, the index is "flat" and these are the offsets
+	// of its components in the key.
+	std::vector<int> flat_offsets;
 };
 
 #endif
@@ -3,6 +3,7 @@
 #include "zeek-config.h"
 
 #include <ctype.h>
+#include <math.h>
 
 #include "Net.h"
 #include "NetVar.h"
@@ -16,6 +17,7 @@
 #include "TunnelEncapsulation.h"
 #include "analyzer/Analyzer.h"
 #include "analyzer/Manager.h"
+#include "iosource/PktSrc.h"
 
 void ConnectionTimer::Init(Connection* arg_conn, timer_func arg_timer,
 				int arg_do_expire)
@@ -50,6 +52,144 @@ void ConnectionTimer::Dispatch(double t, int is_expire)
 		reporter->InternalError("reference count inconsistency in ConnectionTimer::Dispatch");
 	}
 
+class InactivitySweepTimer : public Timer {
+public:
+	InactivitySweepTimer(double t, int64 arg_bucket)
+		: Timer(t, TIMER_CONN_INACTIVITY_SWEEP)	{ bucket = arg_bucket; }
+
+	void Dispatch(double t, int is_expire) override
+		{ inactivity_sweeper->Sweep(bucket, t, is_expire); }
+
+protected:
+	int64 bucket;
+};
+
+InactivitySweeper* inactivity_sweeper = 0;
+
+InactivitySweeper::InactivitySweeper(double arg_interval)
+	{
+	interval = arg_interval;
+	num_conns = 0;
+	sweep_bucket = 0;
+	sweep_list = 0;
+	}
+
+InactivitySweeper::~InactivitySweeper()
+	{
+	for ( BucketMap::iterator i = buckets.begin(); i != buckets.end(); ++i )
+		{
+		timer_mgr->Cancel(i->second.timer);
+
+		std::vector<Connection*>& conns = i->second.conns;
+
+		for ( size_t j = 0; j < conns.size(); ++j )
+			{
+			conns[j]->sweep_offset = -1;
+			Unref(conns[j]);
+			}
+		}
+	}
+
+void InactivitySweeper::Add(Connection* c, double t)
+	{
+	int64 b = int64(floor(t / interval));
+
+	// Never file into the bucket we're currently going through.
+	if ( sweep_list && b <= sweep_bucket )
+		b = sweep_bucket + 1;
+
+	if ( c->sweep_offset >= 0 )
+		{
+		// It's going to be checked early enough already.
+		if ( c->sweep_bucket <= b )
+			return;
+
+		Remove(c);
+		}
+
+	BucketMap::iterator i = buckets.find(b);
+
+	if ( i == buckets.end() )
+		{
+		i = buckets.insert(BucketMap::value_type(b, Bucket())).first;
+		i->second.timer = new InactivitySweepTimer((b + 1) * interval, b);
+		timer_mgr->Add(i->second.timer);
+		}
+
+	std::vector<Connection*>& conns = i->second.conns;
+
+	Ref(c);
+	c->sweep_bucket = b;
+	c->sweep_offset = conns.size();
+	conns.push_back(c);
+	++num_conns;
+	}
+
+void InactivitySweeper::Remove(Connection* c)
+	{
+	if ( c->sweep_offset < 0 )
+		return;
+
+	if ( sweep_list && c->sweep_bucket == sweep_bucket )
+		// Sweep() will skip it.
+		(*sweep_list)[c->sweep_offset] = 0;
+
+	else
+		{
+		BucketMap::iterator i = buckets.find(c->sweep_bucket);
+
+		if ( i == buckets.end() )
+			reporter->InternalError("connection missing from inactivity sweeper");
+
+		// We leave the bucket in place, even if empty, as its
+		// timer is still pending.
+		std::vector<Connection*>& conns = i->second.conns;
+		conns[c->sweep_offset] = conns.back();
+		conns[c->sweep_offset]->sweep_offset = c->sweep_offset;
+		conns.pop_back();
+		}
+
+	c->sweep_offset = -1;
+	--num_conns;
+	Unref(c);
+	}
+
+void InactivitySweeper::Sweep(int64 bucket, double t, int is_expire)
+	{
+	BucketMap::iterator i = buckets.find(bucket);
+
+	if ( i == buckets.end() )
+		return;
+
+	// The timer deletes itself after dispatching.
+	std::vector<Connection*> conns;
+	conns.swap(i->second.conns);
+	buckets.erase(i);
+
+	sweep_bucket = bucket;
+	sweep_list = &conns;
+
+	for ( size_t j = 0; j < conns.size(); ++j )
+		{
+		Connection* c = conns[j];
+
+		if ( ! c )
+			continue;
+
+		c->sweep_offset = -1;
+		--num_conns;
+
+		// Like a connection's inactivity timer, we don't check
+		// when expiring everything at termination.
+		if ( ! is_expire )
+			c->InactivityTimer(t);
+
+		Unref(c);
+		}
+
+	sweep_list = 0;
+	}
+
 uint64 Connection::total_connections = 0;
 uint64 Connection::current_connections = 0;
 uint64 Connection::external_connections = 0;
@@ -90,6 +230,8 @@ Connection::Connection(NetSessions* s, HashKey* k, double t, const ConnID* id,
 
 	is_active = 1;
 	skip = 0;
+	shunted = 0;
+	shed_level = 0;
 	weird = 0;
 
 	suppress_event = 0;
@@ -99,6 +241,8 @@ Connection::Connection(NetSessions* s, HashKey* k, double t, const ConnID* id,
 
 	timers_canceled = 0;
 	inactivity_timeout = 0;
+	sweep_bucket = 0;
+	sweep_offset = -1;
 	installed_status_timer = 0;
 
 	finished = 0;
@@ -115,6 +259,9 @@ Connection::Connection(NetSessions* s, HashKey* k, double t, const ConnID* id,
 	TimerMgr::Tag* tag = current_iosrc->GetCurrentTag();
 	conn_timer_mgr = tag ? new TimerMgr::Tag(*tag) : 0;
 
+	pkt_src = current_pktsrc;
+	shunted_packets = 0;
+
 	if ( arg_encap )
 		encapsulation = new EncapsulationStack(*arg_encap);
 	else
@@ -185,6 +332,9 @@ void Connection::Done()
 	{
 	finished = 1;
 
+	if ( shunted )
+		Unshunt();
+
 	if ( root_analyzer && ! root_analyzer->IsFinished() )
 		root_analyzer->Done();
 	}
@@ -285,6 +435,12 @@ void Connection::InactivityTimer(double t)
 	// timeout once, but it's disabled now. We do nothing then.
 	if ( inactivity_timeout )
 		{
+		// The packets of a shunted connection don't reach us,
+		// but the source tells us whether it's still seeing them.
+		if ( last_time + inactivity_timeout <= t && shunted &&
+		     ShuntedActivity() )
+			last_time = t;
+
 		if ( last_time + inactivity_timeout <= t )
 			{
 			Event(connection_timeout, 0);
@@ -292,12 +448,97 @@ void Connection::InactivityTimer(double t)
 			++killed_by_inactivity;
 			}
 		else
-			ADD_TIMER(&Connection::InactivityTimer,
-					last_time + inactivity_timeout, 0,
-					TIMER_CONN_INACTIVITY);
+			ScheduleInactivityCheck(last_time + inactivity_timeout);
 		}
 	}
 
+void Connection::GetConnID(ConnID* id) const
+	{
+	id->src_addr = orig_addr;
+	id->dst_addr = resp_addr;
+	id->src_port = orig_port;
+	id->dst_port = resp_port;
+	id->is_one_way = false;
+	}
+
+bool Connection::Shunt()
+	{
+	if ( shunted )
+		return true;
+
+	if ( ! pkt_src || (proto != TRANSPORT_TCP && proto != TRANSPORT_UDP) )
+		return false;
+
+	ConnID id;
+	GetConnID(&id);
+
+	if ( ! pkt_src->Shunt(id, proto) )
+		return false;
+
+	shunted = 1;
+	shunted_packets = 0;
+	skip = 1;
+	return true;
+	}
+
+bool Connection::ShuntedActivity()
+	{
+	ConnID id;
+	GetConnID(&id);
+
+	iosource::PktSrc::ShuntStats stats;
+
+	if ( ! pkt_src->ShuntStatistics(id, proto, &stats) )
+		return false;
+
+	uint64 packets = stats.orig_packets + stats.resp_packets;
+
+	if ( packets == shunted_packets )
+		return false;
+
+	shunted_packets = packets;
+	return true;
+	}
+
+void Connection::Unshunt()
+	{
+	ConnID id;
+	GetConnID(&id);
+
+	iosource::PktSrc::ShuntStats stats;
+	pkt_src->ShuntStatistics(id, proto, &stats);
+	pkt_src->Unshunt(id, proto);
+	shunted = 0;
+
+	if ( connection_unshunted )
+		{
+		RecordVal* r = new RecordVal(shunt_stats);
+		r->Assign(0, val_mgr->GetCount(stats.orig_packets));
+		r->Assign(1, val_mgr->GetCount(stats.orig_bytes));
+		r->Assign(2, val_mgr->GetCount(stats.resp_packets));
+		r->Assign(3, val_mgr->GetCount(stats.resp_bytes));
+		Event(connection_unshunted, 0, r);
+		}
+	}
+
+void Connection::ScheduleInactivityCheck(double t)
+	{
+	// Connections with their own timer manager keep using timers, as
+	// the sweeper runs off the global one.
+	if ( ! inactivity_sweeper || conn_timer_mgr )
+		{
+		ADD_TIMER(&Connection::InactivityTimer, t, 0,
+				TIMER_CONN_INACTIVITY);
+		return;
+		}
+
+	// Same conditions as for AddTimer().
+	if ( timers_canceled || ! key )
+		return;
+
+	inactivity_sweeper->Add(this, t);
+	}
+
 void Connection::RemoveConnectionTimer(double t)
 	{
 	Event(connection_state_remove, 0);
@@ -309,8 +550,7 @@ void Connection::SetInactivityTimeout(double timeout)
 	// We add a new inactivity timer even if there already is one.  When
 	// it fires, we always use the current value to check for inactivity.
 	if ( timeout )
-		ADD_TIMER(&Connection::InactivityTimer,
-				last_time + timeout, 0, TIMER_CONN_INACTIVITY);
+		ScheduleInactivityCheck(last_time + timeout);
 
 	inactivity_timeout = timeout;
 	}
@@ -377,7 +617,8 @@ RecordVal* Connection::BuildConnVal()
 		if ( ! uid )
 			uid.Set(bits_per_uid);
 
-		conn_val->Assign(7, new StringVal(uid.Base62("C").c_str()));
+		char uid_buf[BRO_UID_BASE62_LEN];
+		conn_val->Assign(7, new StringVal(uid.Base62(uid_buf, 'C')));
 
 		if ( encapsulation && encapsulation->Depth() > 0 )
 			conn_val->Assign(8, encapsulation->GetVectorVal());
@@ -393,9 +634,20 @@ RecordVal* Connection::BuildConnVal()
 	if ( root_analyzer )
 		root_analyzer->UpdateConnVal(conn_val);
 
-	conn_val->Assign(3, new Val(start_time, TYPE_TIME));	// ###
-	conn_val->Assign(4, new Val(last_time - start_time, TYPE_INTERVAL));
-	conn_val->Assign(6, new StringVal(history.c_str()));
+	// Only replace what changed since the last time.
+	Val* start_val = conn_val->Lookup(3);
+	if ( ! start_val || start_val->AsTime() != start_time )
+		conn_val->Assign(3, new Val(start_time, TYPE_TIME));	// ###
+
+	Val* duration_val = conn_val->Lookup(4);
+	if ( ! duration_val ||
+	     duration_val->AsInterval() != last_time - start_time )
+		conn_val->Assign(4, new Val(last_time - start_time, TYPE_INTERVAL));
+
+	const BroString* history_val = conn_val->Lookup(6)->AsString();
+	if ( history_val->Len() != int(history.size()) ||
+	     memcmp(history_val->Bytes(), history.data(), history.size()) != 0 )
+		conn_val->Assign(6, new StringVal(history.c_str()));
 
 	conn_val->SetOrigin(this);
 
@@ -713,6 +965,9 @@ void Connection::CancelTimers()
 	loop_over_list(tmp, i)
 		GetTimerMgr()->Cancel(tmp[i]);
 
+	if ( sweep_offset >= 0 )
+		inactivity_sweeper->Remove(this);
+
 	timers_canceled = 1;
 	timers.clear();
 	}
@@ -767,7 +1022,7 @@ void Connection::FlipRoles()
 
 unsigned int Connection::MemoryAllocation() const
 	{
-	return padded_sizeof(*this)
+	return slab_sizeof(*this)
 		+ (key ? key->MemoryAllocation() : 0)
 		+ (timers.MemoryAllocation() - padded_sizeof(timers))
 		+ (conn_val ? conn_val->MemoryAllocation() : 0)
@@ -878,8 +1133,8 @@ void Connection::CheckFlowLabel(bool is_orig, uint32 flow_label)
 		saw_first_resp_packet = 1;
 	}
 
-bool Connection::PermitWeird(const char* name, uint64 threshold, uint64 rate,
+bool Connection::PermitWeird(WeirdID id, uint64 threshold, uint64 rate,
                              double duration)
 	{
-	return ::PermitWeird(weird_state, name, threshold, rate, duration);
+	return ::PermitWeird(weird_state, id, threshold, rate, duration);
 	}
@@ -6,7 +6,9 @@
 #include <sys/types.h>
 
 #include <unordered_map>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "Dict.h"
 #include "Val.h"
@@ -16,12 +18,14 @@
 #include "TunnelEncapsulation.h"
 #include "UID.h"
 #include "WeirdState.h"
+#include "Slab.h"
 
 #include "analyzer/Tag.h"
 #include "analyzer/Analyzer.h"
 
 class Connection;
 class ConnectionTimer;
+class InactivitySweeper;
 class NetSessions;
 class LoginConn;
 class RuleHdrTest;
@@ -29,6 +33,7 @@ class Specific_RE_Matcher;
 class RuleEndpointState;
 
 namespace analyzer { class TransportLayerAnalyzer; }
+namespace iosource { class PktSrc; }
 
 typedef enum {
 	NUL_IN_LINE,
@@ -57,6 +62,8 @@ namespace analyzer { class Analyzer; }
 
 class Connection : public BroObj {
 public:
+	DECLARE_SLAB_ALLOCATED
+
 	Connection(NetSessions* s, HashKey* k, double t, const ConnID* id,
 	           uint32 flow, const Packet* pkt, const EncapsulationStack* arg_encap);
 	~Connection() override;
@@ -137,6 +144,18 @@ public:
 	void SetSkip(int do_skip)		{ skip = do_skip; }
 	int Skipping() const			{ return skip; }
 
+	// Asks the packet source to drop the remainder of the connection
+	// itself, before it reaches us, and skips whatever still does.
+	// Returns false if the source can't. Once the connection goes away,
+	// a connection_unshunted event reports what got dropped.
+	bool Shunt();
+	int Shunted() const			{ return shunted; }
+
+	// How much analysis the connection got shed when it started, as a
+	// LoadShedLevel.
+	void SetShedLevel(int level)		{ shed_level = level; }
+	int ShedLevel() const			{ return shed_level; }
+
 	// Arrange for the connection to expire after the given amount of time.
 	void SetLifetime(double lifetime);
 
@@ -295,7 +314,7 @@ public:
 	uint32 GetOrigFlowLabel() { return orig_flow_label; }
 	uint32 GetRespFlowLabel() { return resp_flow_label; }
 
-	bool PermitWeird(const char* name, uint64 threshold, uint64 rate,
+	bool PermitWeird(WeirdID id, uint64 threshold, uint64 rate,
 	                 double duration);
 
 protected:
@@ -312,8 +331,24 @@ protected:
 
 	// Allow other classes to access pointers to these:
 	friend class ConnectionTimer;
+	friend class InactivitySweeper;
 
 	void InactivityTimer(double t);
+
+	// Describes the connection to the packet source.
+	void GetConnID(ConnID* id) const;
+
+	// Returns true if the packet source dropped packets of the shunted
+	// connection since we last asked.
+	bool ShuntedActivity();
+
+	// Lets the packet source pass on packets of a shunted connection
+	// again, raising connection_unshunted.
+	void Unshunt();
+
+	// Arranges for InactivityTimer() to be called at time t, either
+	// through a timer or through the inactivity sweeper.
+	void ScheduleInactivityCheck(double t);
 	void StatusUpdateTimer(double t);
 	void RemoveConnectionTimer(double t);
 
@@ -322,6 +357,10 @@ protected:
 
 	// Timer manager to use for this conn (or nil).
 	TimerMgr::Tag* conn_timer_mgr;
+
+	// Packet source the connection came from (or nil).
+	iosource::PktSrc* pkt_src;
+	uint64 shunted_packets;	// dropped by the source when we last looked
 	timer_list timers;
 
 	IPAddr orig_addr;
@@ -334,6 +373,10 @@ protected:
 	u_char resp_l2_addr[Packet::l2_addr_len];	// Link-layer responder address, if available
 	double start_time, last_time;
 	double inactivity_timeout;
+
+	// Position in the inactivity sweeper, if registered there.
+	int64 sweep_bucket;
+	int sweep_offset;	// -1 if not registered
 	RecordVal* conn_val;
 	LoginConn* login_conn;	// either nil, or this
 	const EncapsulationStack* encapsulation; // tunnels
@@ -343,6 +386,8 @@ protected:
 	unsigned int timers_canceled:1;
 	unsigned int is_active:1;
 	unsigned int skip:1;
+	unsigned int shunted:1;
+	unsigned int shed_level:2;
 	unsigned int weird:1;
 	unsigned int finished:1;
 	unsigned int record_packets:1, record_contents:1;
@@ -387,4 +432,46 @@ protected:
 #define ADD_TIMER(timer, t, do_expire, type) \
 	AddTimer(timer_func(timer), (t), (do_expire), (type))
 
+// Checks connections for inactivity in coarse buckets of time, instead
+// of giving each connection a timer of its own. Each bucket has a single
+// timer that fires at its end; connections found to still be active then
+// are filed into the bucket of their new deadline. Used when
+// inactivity_sweep_interval is non-zero.
+class InactivitySweeper {
+public:
+	explicit InactivitySweeper(double arg_interval);
+	~InactivitySweeper();
+
+	// Makes sure that the connection gets checked no earlier than time
+	// t (and at most one interval later).
+	void Add(Connection* c, double t);
+
+	// Stops checking the connection.
+	void Remove(Connection* c);
+
+	// Checks all connections in the given bucket. Called by the
+	// bucket's timer.
+	void Sweep(int64 bucket, double t, int is_expire);
+
+	int Size() const	{ return num_conns; }
+
+protected:
+	struct Bucket {
+		std::vector<Connection*> conns;
+		Timer* timer;
+	};
+
+	typedef std::map<int64, Bucket> BucketMap;
+
+	double interval;
+	BucketMap buckets;
+	int num_conns;
+
+	// While sweeping, the bucket and the connections in it.
+	int64 sweep_bucket;
+	std::vector<Connection*>* sweep_list;
+};
+
+extern InactivitySweeper* inactivity_sweeper;
+
 #endif
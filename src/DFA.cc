@@ -2,9 +2,12 @@
 
 #include "zeek-config.h"
 
+#include <vector>
+
 #include "EquivClass.h"
 #include "DFA.h"
 #include "digest.h"
+#include "NetVar.h"
 
 unsigned int DFA_State::transition_counter = 0;
 
@@ -18,28 +21,18 @@ DFA_State::DFA_State(int arg_state_num, const EquivClass* ec,
 	accept = arg_accept;
 	mark = 0;
 	centry = 0;
+	num_computed = 0;
 
 	SymPartition(ec);
-
-	xtions = new DFA_State*[num_sym];
-
-	for ( int i = 0; i < num_sym; ++i )
-		xtions[i] = DFA_UNCOMPUTED_STATE_PTR;
 	}
 
 DFA_State::~DFA_State()
 	{
-	delete [] xtions;
 	delete nfa_states;
 	delete accept;
 	delete meta_ec;
 	}
 
-void DFA_State::AddXtion(int sym, DFA_State* next_state)
-	{
-	xtions[sym] = next_state;
-	}
-
 void DFA_State::SymPartition(const EquivClass* ec)
 	{
 	// Partitioning is done by creating equivalence classes for those
@@ -73,39 +66,6 @@ void DFA_State::SymPartition(const EquivClass* ec)
 	meta_ec->BuildECs();
 	}
 
-DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine)
-	{
-	int equiv_sym = meta_ec->EquivRep(sym);
-	if ( xtions[equiv_sym] != DFA_UNCOMPUTED_STATE_PTR )
-		{
-		AddXtion(sym, xtions[equiv_sym]);
-		return xtions[sym];
-		}
-
-	const EquivClass* ec = machine->EC();
-
-	DFA_State* next_d;
-
-	NFA_state_list* ns = SymFollowSet(equiv_sym, ec);
-	if ( ns->length() > 0 )
-		{
-		NFA_state_list* state_set = epsilon_closure(ns);
-		if ( ! machine->StateSetToDFA_State(state_set, next_d, ec) )
-			delete state_set;
-		}
-	else
-		{
-		delete ns;
-		next_d = 0;	// Jam
-		}
-
-	AddXtion(equiv_sym, next_d);
-	if ( sym != equiv_sym )
-		AddXtion(sym, next_d);
-
-	return xtions[sym];
-	}
-
 void DFA_State::AppendIfNew(int sym, int_list* sym_list)
 	{
 	for ( int i = 0; i < sym_list->length(); ++i )
@@ -178,22 +138,6 @@ NFA_state_list* DFA_State::SymFollowSet(int ec_sym, const EquivClass* ec)
 	return ns;
 	}
 
-void DFA_State::ClearMarks()
-	{
-	if ( mark )
-		{
-		SetMark(0);
-
-		for ( int i = 0; i < num_sym; ++i )
-			{
-			DFA_State* s = xtions[i];
-
-			if ( s && s != DFA_UNCOMPUTED_STATE_PTR )
-				xtions[i]->ClearMarks();
-			}
-		}
-	}
-
 void DFA_State::Describe(ODesc* d) const
 	{
 	d->Add("DFA state");
@@ -216,12 +160,14 @@ void DFA_State::Dump(FILE* f, DFA_Machine* m)
 
 	fprintf(f, "\n");
 
+	const int32_t* xtions = &m->dense_xtions[state_num * num_sym];
+
 	int num_trans = 0;
 	for ( int sym = 0; sym < num_sym; ++sym )
 		{
-		DFA_State* s = xtions[sym];
+		int s = xtions[sym];
 
-		if ( ! s )
+		if ( s == -1 )
 			continue;
 
 		// Look ahead for compression.
@@ -241,13 +187,12 @@ void DFA_State::Dump(FILE* f, DFA_Machine* m)
 		else
 			sprintf(xbuf, "'%c'-'%c'", r, m->Rep(i-1));
 
-		if ( s == DFA_UNCOMPUTED_STATE_PTR )
+		if ( s == DFA_UNCOMPUTED_STATE )
 			fprintf(f, "%stransition on %s to <uncomputed>",
 				++num_trans == 1 ? "\t" : "\n\t", xbuf);
 		else
 			fprintf(f, "%stransition on %s to state %d",
-				++num_trans == 1 ? "\t" : "\n\t", xbuf,
-				s->StateNum());
+				++num_trans == 1 ? "\t" : "\n\t", xbuf, s);
 
 		sym = i - 1;
 		}
@@ -259,39 +204,33 @@ void DFA_State::Dump(FILE* f, DFA_Machine* m)
 
 	for ( int sym = 0; sym < num_sym; ++sym )
 		{
-		DFA_State* s = xtions[sym];
+		int s = xtions[sym];
 
-		if ( s && s != DFA_UNCOMPUTED_STATE_PTR )
-			s->Dump(f, m);
+		if ( s >= 0 )
+			m->dense_states[s]->Dump(f, m);
 		}
 	}
 
 void DFA_State::Stats(unsigned int* computed, unsigned int* uncomputed)
 	{
-	for ( int sym = 0; sym < num_sym; ++sym )
-		{
-		DFA_State* s = xtions[sym];
-
-		if ( s == DFA_UNCOMPUTED_STATE_PTR )
-			(*uncomputed)++;
-		else
-			(*computed)++;
-		}
+	*computed += num_computed;
+	*uncomputed += num_sym - num_computed;
 	}
 
 unsigned int DFA_State::Size()
 	{
 	return sizeof(*this)
-		+ pad_size(sizeof(DFA_State*) * num_sym)
 		+ (accept ? pad_size(sizeof(int) * accept->size()) : 0)
 		+ (nfa_states ? pad_size(sizeof(NFA_State*) * nfa_states->length()) : 0)
 		+ (meta_ec ? meta_ec->Size() : 0)
 		+ (centry ? padded_sizeof(CacheEntry) : 0);
 	}
 
+uint64 DFA_State_Cache::total_mem = 0;
+
 DFA_State_Cache::DFA_State_Cache()
 	{
-	hits = misses = 0;
+	hits = misses = evictions = 0;
 	}
 
 DFA_State_Cache::~DFA_State_Cache()
@@ -301,12 +240,32 @@ DFA_State_Cache::~DFA_State_Cache()
 	while ( (e = (CacheEntry*) states.NextEntry(i)) )
 		{
 		assert(e->state);
-		delete e->hash;
-		Unref(e->state);
-		delete e;
+		DeleteEntry(e);
 		}
 	}
 
+void DFA_State_Cache::DeleteEntry(CacheEntry* e)
+	{
+	total_mem -= e->mem;
+	delete e->hash;
+	Unref(e->state);
+	delete e;
+	}
+
+void DFA_State_Cache::Clear()
+	{
+	IterCookie* i = states.InitForIteration();
+	CacheEntry* e;
+	while ( (e = (CacheEntry*) states.NextEntry(i)) )
+		{
+		e->state->centry = 0;
+		DeleteEntry(e);
+		++evictions;
+		}
+
+	states.Clear();
+	}
+
 DFA_State* DFA_State_Cache::Lookup(const NFA_state_list& nfas,
 						HashKey** hash)
 	{
@@ -362,6 +321,8 @@ DFA_State* DFA_State_Cache::Insert(DFA_State* state, HashKey* hash)
 	e->state = state;
 	e->state->centry = e;
 	e->hash = hash;
+	e->mem = pad_size(state->Size()) + padded_sizeof(*state);
+	total_mem += e->mem;
 
 	states.Insert(hash, e);
 
@@ -377,6 +338,7 @@ void DFA_State_Cache::GetStats(Stats* s)
 	s->mem = 0;
 	s->hits = hits;
 	s->misses = misses;
+	s->evictions = evictions;
 
 	CacheEntry* e;
 
@@ -398,11 +360,20 @@ DFA_Machine::DFA_Machine(NFA_Machine* n, EquivClass* arg_ec)
 	Ref(n);
 
 	ec = arg_ec;
+	num_syms = ec->NumClasses();
+
+	generation = 0;
+	defer_reset = false;
 
 	dfa_state_cache = new DFA_State_Cache();
 
+	BuildStartState();
+	}
+
+void DFA_Machine::BuildStartState()
+	{
 	NFA_state_list* ns = new NFA_state_list;
-	ns->append(n->FirstState());
+	ns->append(nfa->FirstState());
 
 	if ( ns->length() > 0 )
 		{
@@ -416,12 +387,61 @@ DFA_Machine::DFA_Machine(NFA_Machine* n, EquivClass* arg_ec)
 		}
 	}
 
+void DFA_Machine::Reset()
+	{
+	dfa_state_cache->Clear();
+
+	state_count = 0;
+	dense_xtions.clear();
+	dense_states.clear();
+	accepting.clear();
+	accel.clear();
+
+	++generation;
+
+	BuildStartState();
+	}
+
+int DFA_Machine::Resume(DFA_State* s)
+	{
+	// The state list passed in gets owned by the new state if there
+	// is one, so it needs to be a copy.
+	NFA_state_list* state_set = new NFA_state_list(*s->NFAStates());
+	DFA_State* d;
+
+	if ( ! StateSetToDFA_State(state_set, d, ec) )
+		delete state_set;
+
+	return d->StateNum();
+	}
+
 DFA_Machine::~DFA_Machine()
 	{
 	delete dfa_state_cache;
 	Unref(nfa);
 	}
 
+int DFA_Machine::Precompute(int max_states)
+	{
+	if ( ! start_state )
+		return 0;
+
+	// Don't build more than we'd keep.
+	if ( dfa_max_states > 0 && max_states > dfa_max_states )
+		max_states = dfa_max_states;
+
+	// States get numbered in the order we first reach them, starting
+	// with the start state, so going through them by number is a
+	// breadth-first walk.
+	for ( int i = 0; i < NumStates() && NumStates() < max_states; ++i )
+		{
+		for ( int sym = 0; sym < num_syms && NumStates() < max_states; ++sym )
+			(void) NextStateNum(i, sym);
+		}
+
+	return NumStates();
+	}
+
 void DFA_Machine::Describe(ODesc* d) const
 	{
 	d->Add("DFA machine");
@@ -430,7 +450,9 @@ void DFA_Machine::Describe(ODesc* d) const
 void DFA_Machine::Dump(FILE* f)
 	{
 	start_state->Dump(f, this);
-	start_state->ClearMarks();
+
+	for ( auto s : dense_states )
+		s->SetMark(0);
 	}
 
 unsigned int DFA_Machine::MemoryAllocation() const
@@ -442,7 +464,11 @@ unsigned int DFA_Machine::MemoryAllocation() const
 	return padded_sizeof(*this)
 		+ s.mem
 		+ padded_sizeof(*start_state)
-		+ nfa->MemoryAllocation();
+		+ nfa->MemoryAllocation()
+		+ pad_size(dense_xtions.capacity() * sizeof(int32_t))
+		+ pad_size(dense_states.capacity() * sizeof(DFA_State*))
+		+ pad_size(accepting.capacity() / 8)
+		+ pad_size(accel.capacity() * sizeof(DFA_Accel));
 	}
 
 int DFA_Machine::StateSetToDFA_State(NFA_state_list* state_set,
@@ -473,9 +499,106 @@ int DFA_Machine::StateSetToDFA_State(NFA_state_list* state_set,
 	DFA_State* ds = new DFA_State(state_count++, ec, state_set, accept);
 	d = dfa_state_cache->Insert(ds, hash);
 
+	dense_states.push_back(d);
+	accepting.push_back(d->Accept() != 0);
+	dense_xtions.resize(dense_xtions.size() + num_syms, DFA_UNCOMPUTED_STATE);
+
+	DFA_Accel a;
+	a.visits = 0;
+	a.usable = false;
+	a.num_escapes = 0;
+	accel.push_back(a);
+
 	return 1;
 	}
 
+int DFA_Machine::ComputeNextStateNum(int state_num, int sym)
+	{
+	DFA_State* s = dense_states[state_num];
+
+	// Symbols the state treats alike share their transition.
+	int equiv_sym = s->meta_ec->EquivRep(sym);
+	int next_num = dense_xtions[state_num * num_syms + equiv_sym];
+
+	if ( next_num == DFA_UNCOMPUTED_STATE )
+		{
+		DFA_State* next = 0;	// Jam
+
+		NFA_state_list* ns = s->SymFollowSet(equiv_sym, ec);
+		if ( ns->length() > 0 )
+			{
+			NFA_state_list* state_set = epsilon_closure(ns);
+			if ( ! StateSetToDFA_State(state_set, next, ec) )
+				delete state_set;
+			}
+		else
+			delete ns;
+
+		if ( next && dfa_max_states > 0 &&
+		     NumStates() > dfa_max_states && ! defer_reset )
+			{
+			// Over budget. Start over, carrying over just the
+			// state we're moving to, so that the caller can keep
+			// matching.
+			Ref(next);
+			Reset();
+			next_num = Resume(next);
+			Unref(next);
+			return next_num;
+			}
+
+		next_num = next ? next->StateNum() : -1;
+		SetXtion(state_num, equiv_sym, next_num);
+		}
+
+	if ( sym != equiv_sym )
+		SetXtion(state_num, sym, next_num);
+
+	return next_num;
+	}
+
+void DFA_Machine::SetXtion(int state_num, int sym, int next_num)
+	{
+	dense_xtions[state_num * num_syms + sym] = next_num;
+	++dense_states[state_num]->num_computed;
+	}
+
+void DFA_Machine::ComputeAccel(int state_num)
+	{
+	const int* ecs = ec->EquivClasses();
+	u_char escapes[DFA_MAX_ACCEL_ESCAPES];
+	int num_escapes = 0;
+	bool usable = true;
+
+	// This computes all of the state's transitions, which may add new
+	// states, so we fill in the entry only at the end. Our caller
+	// still needs state_num afterwards, so it must stay valid even if
+	// that takes us over budget; the next transition will reset.
+	defer_reset = true;
+
+	for ( int c = 0; c < 256; ++c )
+		{
+		if ( NextStateNum(state_num, ecs[c]) == state_num )
+			continue;
+
+		if ( num_escapes == DFA_MAX_ACCEL_ESCAPES )
+			{
+			usable = false;
+			break;
+			}
+
+		escapes[num_escapes++] = c;
+		}
+
+	defer_reset = false;
+
+	DFA_Accel& a = accel[state_num];
+	a.visits = -1;
+	a.usable = usable;
+	a.num_escapes = num_escapes;
+	memcpy(a.escapes, escapes, sizeof(escapes));
+	}
+
 int DFA_Machine::Rep(int sym)
 	{
 	for ( int i = 0; i < NUM_SYM; ++i )
@@ -5,13 +5,16 @@
 #define dfa_h
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
 
 class DFA_State;
 
 // Transitions to the uncomputed state indicate that we haven't yet
 // computed the state to go to.
 #define DFA_UNCOMPUTED_STATE -2
-#define DFA_UNCOMPUTED_STATE_PTR ((DFA_State*) DFA_UNCOMPUTED_STATE)
 
 #include "NFA.h"
 
@@ -19,6 +22,20 @@ class DFA_Machine;
 class DFA_State;
 struct CacheEntry;
 
+// A state gets looked at for skipping, see DFA_Machine::SkipLength(),
+// once matching has started from it this many times.
+#define DFA_ACCEL_VISITS 64
+
+// A state can be skipped through if at most this many bytes leave it.
+#define DFA_MAX_ACCEL_ESCAPES 3
+
+struct DFA_Accel {
+	int visits;	// -1 once we know whether we can skip
+	bool usable;
+	int num_escapes;
+	u_char escapes[DFA_MAX_ACCEL_ESCAPES];
+};
+
 class DFA_State : public BroObj {
 public:
 	DFA_State(int state_num, const EquivClass* ec,
@@ -27,11 +44,9 @@ public:
 
 	int StateNum() const		{ return state_num; }
 	int NFAStateNum() const		{ return nfa_states->length(); }
-	void AddXtion(int sym, DFA_State* next_state);
-
-	inline DFA_State* Xtion(int sym, DFA_Machine* machine);
 
 	const AcceptingSet* Accept() const	{ return accept; }
+	const NFA_state_list* NFAStates() const	{ return nfa_states; }
 	void SymPartition(const EquivClass* ec);
 
 	// ec_sym is an equivalence class, not a character.
@@ -39,7 +54,6 @@ public:
 
 	void SetMark(DFA_State* m)	{ mark = m; }
 	DFA_State* Mark() const		{ return mark; }
-	void ClearMarks();
 
 	// Returns the equivalence classes of ec's corresponding to this state.
 	const EquivClass* MetaECs() const	{ return meta_ec; }
@@ -51,14 +65,16 @@ public:
 
 protected:
 	friend class DFA_State_Cache;
+	friend class DFA_Machine;
 
-	DFA_State* ComputeXtion(int sym, DFA_Machine* machine);
 	void AppendIfNew(int sym, int_list* sym_list);
 
 	int state_num;
 	int num_sym;
 
-	DFA_State** xtions;
+	// The transitions themselves live in the machine's table; we just
+	// count how many of ours have been computed.
+	int num_computed;
 
 	AcceptingSet* accept;
 	NFA_state_list* nfa_states;
@@ -72,6 +88,7 @@ protected:
 struct CacheEntry {
 	DFA_State* state;
 	HashKey* hash;
+	unsigned int mem;	// charged to the total when inserted
 };
 
 class DFA_State_Cache {
@@ -88,6 +105,10 @@ public:
 
 	int NumEntries() const	{ return states.Length(); }
 
+	// Drops all states, counting them as evicted. States still
+	// referenced elsewhere stay alive, but are no longer found.
+	void Clear();
+
 	struct Stats {
 		// Sum of all NFA states
 		unsigned int nfa_states;
@@ -97,13 +118,24 @@ public:
 		unsigned int mem;
 		unsigned int hits;
 		unsigned int misses;
+		unsigned int evictions;
 	};
 
 	void GetStats(Stats* s);
 
+	// Returns the memory of the states in all caches, as accounted
+	// when they got inserted. Unlike GetStats(), this is cheap.
+	static uint64 TotalMemory()	{ return total_mem; }
+
 private:
+	// Removes an entry, taking care of the accounting.
+	void DeleteEntry(CacheEntry* e);
+
+	static uint64 total_mem;
+
 	int hits;	// Statistics
 	int misses;
+	int evictions;
 
 	declare(PDict,CacheEntry);
 
@@ -122,6 +154,43 @@ public:
 
 	DFA_State_Cache* Cache()	{ return dfa_state_cache; }
 
+	// Once the machine has more states than dfa_max_states allows, it
+	// drops all of them and starts over, rebuilding states as matching
+	// needs them again. That invalidates all state numbers, which the
+	// generation tells apart. To continue from a state of an earlier
+	// generation, keep a reference to it (see State()) and pass it to
+	// Resume(), which returns its number in the current one.
+	unsigned int Generation() const	{ return generation; }
+	DFA_State* State(int state_num) const
+		{ return dense_states[state_num]; }
+	int Resume(DFA_State* s);
+
+	// Computes states reachable from the start state, in breadth-first
+	// order, until the machine has max_states of them or there are no
+	// more. Returns the number of states the machine has afterwards.
+	int Precompute(int max_states);
+
+	// Matching works on state numbers, as given by StateNum(), with
+	// all transitions kept in a single table of state numbers. State
+	// numbers below zero stand for the jam state. Transitions not
+	// computed yet get computed on first use.
+	int StartStateNum() const
+		{ return start_state ? start_state->StateNum() : -1; }
+
+	inline int NextStateNum(int state_num, int sym);
+
+	bool IsAccepting(int state_num) const
+		{ return accepting[state_num]; }
+
+	const AcceptingSet* Accept(int state_num) const
+		{ return dense_states[state_num]->Accept(); }
+
+	// Returns how many of the given bytes just lead back into the state
+	// itself, so that matching can skip over them. Frequently used
+	// states that only few bytes leave get searched for those bytes
+	// directly, for all others this returns 0.
+	inline int SkipLength(int state_num, const u_char* data, int len);
+
 	int Rep(int sym);
 
 	void Describe(ODesc* d) const override;
@@ -130,11 +199,22 @@ public:
 	unsigned int MemoryAllocation() const;
 
 protected:
-	friend class DFA_State;	// for DFA_State::ComputeXtion
+	friend class DFA_State;	// for DFA_State::Dump
 	friend class DFA_State_Cache;
 
 	int state_count;
 
+	// Computes a transition for the dense table.
+	int ComputeNextStateNum(int state_num, int sym);
+	void SetXtion(int state_num, int sym, int next_num);
+
+	// Determines whether SkipLength() can skip through the state.
+	void ComputeAccel(int state_num);
+
+	// Drops all states and starts over with a new generation.
+	void Reset();
+	void BuildStartState();
+
 	// The state list has to be sorted according to IDs.
 	int StateSetToDFA_State(NFA_state_list* state_set, DFA_State*& d,
 				const EquivClass* ec);
@@ -145,14 +225,62 @@ protected:
 	DFA_State_Cache* dfa_state_cache;
 
 	NFA_Machine* nfa;
+
+	// Dense representation, indexed by state number.
+	int num_syms;
+	std::vector<int32_t> dense_xtions;	// num_syms entries per state
+	std::vector<DFA_State*> dense_states;
+	std::vector<bool> accepting;
+	std::vector<DFA_Accel> accel;
+
+	unsigned int generation;
+
+	// While set, going over dfa_max_states doesn't reset the machine.
+	bool defer_reset;
 };
 
-inline DFA_State* DFA_State::Xtion(int sym, DFA_Machine* machine)
+inline int DFA_Machine::NextStateNum(int state_num, int sym)
+	{
+	int next = dense_xtions[state_num * num_syms + sym];
+
+	if ( next == DFA_UNCOMPUTED_STATE )
+		return ComputeNextStateNum(state_num, sym);
+
+	return next;
+	}
+
+inline int DFA_Machine::SkipLength(int state_num, const u_char* data, int len)
 	{
-	if ( xtions[sym] == DFA_UNCOMPUTED_STATE_PTR )
-		return ComputeXtion(sym, machine);
-	else
-		return xtions[sym];
+	if ( accel[state_num].visits >= 0 )
+		{
+		if ( ++accel[state_num].visits < DFA_ACCEL_VISITS )
+			return 0;
+
+		ComputeAccel(state_num);
+		}
+
+	const DFA_Accel& a = accel[state_num];
+
+	if ( ! a.usable )
+		return 0;
+
+	if ( a.num_escapes == 0 )
+		return len;
+
+	if ( a.num_escapes == 1 )
+		{
+		const u_char* p = (const u_char*) memchr(data, a.escapes[0], len);
+		return p ? p - data : len;
+		}
+
+	for ( int i = 0; i < len; ++i )
+		{
+		for ( int j = 0; j < a.num_escapes; ++j )
+			if ( data[i] == a.escapes[j] )
+				return i;
+		}
+
+	return len;
 	}
 
 #endif
@@ -128,7 +128,7 @@ public:
 
 	bool Expired() const
 		{
-		if ( req_host && num_addrs == 0)
+		if ( req_host && num_addrs == 0 && ! failed )
 			return false; // nothing to expire
 
 		return current_time() > (creation_time + req_ttl);
@@ -160,6 +160,9 @@ protected:
 	int failed;
 	double creation_time;
 	int map_type;
+
+	// When the mapping was last used, in DNS_Mgr::cache_clock ticks.
+	uint64 last_use;
 };
 
 void DNS_Mgr_mapping_delete_func(void* v)
@@ -317,6 +320,7 @@ void DNS_Mapping::Init(struct hostent* h)
 	creation_time = current_time();
 	host_val = 0;
 	addrs_val = 0;
+	last_use = 0;
 
 	if ( ! h )
 		{
@@ -359,6 +363,7 @@ void DNS_Mapping::Clear()
 	no_mapping = 0;
 	map_type = 0;
 	failed = 1;
+	last_use = 0;
 	}
 
 void DNS_Mapping::Save(FILE* f) const
@@ -372,6 +377,8 @@ void DNS_Mapping::Save(FILE* f) const
 		fprintf(f, "%s\n", addrs[i].AsString().c_str());
 	}
 
+// How many requests we keep outstanding at a time, by default.
+#define MAX_PENDING_REQUESTS 20
 
 DNS_Mgr::DNS_Mgr(DNS_MgrMode arg_mode)
 	{
@@ -393,6 +400,11 @@ DNS_Mgr::DNS_Mgr(DNS_MgrMode arg_mode)
 	failed = 0;
 	nb_dns = nullptr;
 	next_timestamp = -1.0;
+
+	max_cache_entries = 0;
+	negative_ttl = 0;
+	max_pending_requests = MAX_PENDING_REQUESTS;
+	cache_clock = 0;
 	}
 
 DNS_Mgr::~DNS_Mgr()
@@ -415,7 +427,33 @@ void DNS_Mgr::Init()
 	// configured to the user's desired address at the time when we need to to
 	// the lookup.
 	auto dns_resolver = zeekenv("ZEEK_DNS_RESOLVER");
-	auto dns_resolver_addr = dns_resolver ? IPAddr(dns_resolver) : IPAddr();
+	std::string resolver_host = dns_resolver ? dns_resolver : "";
+	uint16 resolver_port = 0;
+
+	// The address may come with a port, as "<addr>:<port>" for IPv4 and
+	// "[<addr>]:<port>" for IPv6.
+	if ( ! resolver_host.empty() && resolver_host[0] == '[' )
+		{
+		std::string::size_type end = resolver_host.find(']');
+
+		if ( end != std::string::npos )
+			{
+			if ( resolver_host.compare(end + 1, 1, ":") == 0 )
+				resolver_port = atoi(resolver_host.c_str() + end + 2);
+
+			resolver_host = resolver_host.substr(1, end - 1);
+			}
+		}
+
+	else if ( std::count(resolver_host.begin(), resolver_host.end(), ':') == 1 )
+		{
+		std::string::size_type colon = resolver_host.find(':');
+		resolver_port = atoi(resolver_host.c_str() + colon + 1);
+		resolver_host.erase(colon);
+		}
+
+	auto dns_resolver_addr = resolver_host.empty() ?
+		IPAddr() : IPAddr(resolver_host);
 	char err[NB_DNS_ERRSIZE];
 
 	if ( dns_resolver_addr == IPAddr() )
@@ -428,12 +466,14 @@ void DNS_Mgr::Init()
 			{
 			struct sockaddr_in* sa = (struct sockaddr_in*)&ss;
 			sa->sin_family = AF_INET;
+			sa->sin_port = htons(resolver_port);
 			dns_resolver_addr.CopyIPv4(&sa->sin_addr);
 			}
 		else
 			{
 			struct sockaddr_in6* sa = (struct sockaddr_in6*)&ss;
 			sa->sin6_family = AF_INET6;
+			sa->sin6_port = htons(resolver_port);
 			dns_resolver_addr.CopyIPv6(&sa->sin6_addr);
 			}
 
@@ -446,6 +486,15 @@ void DNS_Mgr::Init()
 	did_init = true;
 	}
 
+void DNS_Mgr::AfterFork()
+	{
+	if ( nb_dns )
+		nb_dns_finish(nb_dns);
+
+	nb_dns = 0;
+	did_init = false;
+	}
+
 void DNS_Mgr::InitPostScript()
 	{
 	dns_mapping_valid = internal_handler("dns_mapping_valid");
@@ -457,6 +506,13 @@ void DNS_Mgr::InitPostScript()
 
 	dm_rec = internal_type("dns_mapping")->AsRecordType();
 
+	max_cache_entries = opt_internal_int("dns_max_cache_entries");
+	negative_ttl = opt_internal_double("dns_negative_ttl");
+	max_pending_requests = opt_internal_int("dns_max_pending_requests");
+
+	if ( max_pending_requests <= 0 )
+		max_pending_requests = MAX_PENDING_REQUESTS;
+
 	// Registering will call Init()
 	iosource_mgr->Register(this, true);
 
@@ -604,8 +660,6 @@ void DNS_Mgr::Verify()
 	{
 	}
 
-#define MAX_PENDING_REQUESTS 20
-
 void DNS_Mgr::Resolve()
 	{
 	if ( ! nb_dns )
@@ -758,6 +812,10 @@ void DNS_Mgr::AddResult(DNS_Mgr_Request* dr, struct nb_dns_result* r)
 	struct hostent* h = (r && r->host_errno == 0) ? r->hostent : 0;
 	u_int32_t ttl = (r && r->host_errno == 0) ? r->ttl : 0;
 
+	if ( ! h )
+		// Remember the failure for a while.
+		ttl = u_int32_t(negative_ttl);
+
 	DNS_Mapping* new_dm;
 	DNS_Mapping* prev_dm;
 	int keep_prev = 0;
@@ -843,7 +901,96 @@ void DNS_Mgr::AddResult(DNS_Mgr_Request* dr, struct nb_dns_result* r)
 	if ( keep_prev )
 		delete new_dm;
 	else
+		{
 		delete prev_dm;
+		new_dm->last_use = ++cache_clock;
+		}
+
+	if ( mode == DNS_DEFAULT )
+		EnforceCacheLimit();
+	}
+
+void DNS_Mgr::EnforceCacheLimit()
+	{
+	size_t n = host_mappings.size() + addr_mappings.size() +
+		text_mappings.size();
+
+	if ( max_cache_entries <= 0 || n <= size_t(max_cache_entries) )
+		return;
+
+	// Evict down to 90% of the limit at once, so that we don't need to
+	// go through the cache for every new entry. Entries of requests
+	// still waiting for results stay.
+	size_t target = max_cache_entries - max_cache_entries / 10;
+	std::vector<uint64> uses;
+	uses.reserve(n);
+
+	for ( const auto& m : host_mappings )
+		if ( asyncs_names.find(m.first) == asyncs_names.end() )
+			uses.push_back(HostLastUse(m.second));
+
+	for ( const auto& m : addr_mappings )
+		if ( asyncs_addrs.find(m.first) == asyncs_addrs.end() )
+			uses.push_back(m.second->last_use);
+
+	for ( const auto& m : text_mappings )
+		if ( asyncs_texts.find(m.first) == asyncs_texts.end() )
+			uses.push_back(m.second->last_use);
+
+	size_t evict = std::min(n - target, uses.size());
+
+	if ( ! evict )
+		return;
+
+	std::nth_element(uses.begin(), uses.begin() + (evict - 1), uses.end());
+	uint64 cutoff = uses[evict - 1];
+
+	for ( auto i = host_mappings.begin(); evict && i != host_mappings.end(); )
+		{
+		if ( HostLastUse(i->second) <= cutoff &&
+		     asyncs_names.find(i->first) == asyncs_names.end() )
+			{
+			delete i->second.first;
+			delete i->second.second;
+			i = host_mappings.erase(i);
+			--evict;
+			}
+		else
+			++i;
+		}
+
+	for ( auto i = addr_mappings.begin(); evict && i != addr_mappings.end(); )
+		{
+		if ( i->second->last_use <= cutoff &&
+		     asyncs_addrs.find(i->first) == asyncs_addrs.end() )
+			{
+			delete i->second;
+			i = addr_mappings.erase(i);
+			--evict;
+			}
+		else
+			++i;
+		}
+
+	for ( auto i = text_mappings.begin(); evict && i != text_mappings.end(); )
+		{
+		if ( i->second->last_use <= cutoff &&
+		     asyncs_texts.find(i->first) == asyncs_texts.end() )
+			{
+			delete i->second;
+			i = text_mappings.erase(i);
+			--evict;
+			}
+		else
+			++i;
+		}
+	}
+
+uint64 DNS_Mgr::HostLastUse(const pair<DNS_Mapping*, DNS_Mapping*>& m)
+	{
+	uint64 u4 = m.first ? m.first->last_use : 0;
+	uint64 u6 = m.second ? m.second->last_use : 0;
+	return std::max(u4, u6);
 	}
 
 void DNS_Mgr::CompareMappings(DNS_Mapping* prev_dm, DNS_Mapping* new_dm)
@@ -1006,6 +1153,8 @@ const char* DNS_Mgr::LookupAddrInCache(const IPAddr& addr)
 		return 0;
 		}
 
+	d->last_use = ++cache_clock;
+
 	// The escapes in the following strings are to avoid having it
 	// interpreted as a trigraph sequence.
 	return d->names ? d->names[0] : "<\?\?\?>";
@@ -1034,6 +1183,8 @@ TableVal* DNS_Mgr::LookupNameInCache(const string& name)
 		return 0;
 		}
 
+	d4->last_use = d6->last_use = ++cache_clock;
+
 	TableVal* tv4 = d4->AddrsSet();
 	TableVal* tv6 = d6->AddrsSet();
 	tv4->AddTo(tv6, false);
@@ -1041,6 +1192,30 @@ TableVal* DNS_Mgr::LookupNameInCache(const string& name)
 	return tv6;
 	}
 
+bool DNS_Mgr::NameFailedInCache(const string& name)
+	{
+	HostMap::iterator it = host_mappings.find(name);
+	if ( it == host_mappings.end() )
+		return false;
+
+	DNS_Mapping* d4 = it->second.first;
+	DNS_Mapping* d6 = it->second.second;
+
+	if ( ! d4 || ! d4->Failed() || ! d6 || ! d6->Failed() )
+		return false;
+
+	if ( d4->Expired() || d6->Expired() )
+		{
+		host_mappings.erase(it);
+		delete d4;
+		delete d6;
+		return false;
+		}
+
+	d4->last_use = d6->last_use = ++cache_clock;
+	return true;
+	}
+
 const char* DNS_Mgr::LookupTextInCache(const string& name)
 	{
 	TextMap::iterator it = text_mappings.find(name);
@@ -1056,6 +1231,8 @@ const char* DNS_Mgr::LookupTextInCache(const string& name)
 		return 0;
 		}
 
+	d->last_use = ++cache_clock;
+
 	// The escapes in the following strings are to avoid having it
 	// interpreted as a trigraph sequence.
 	return d->names ? d->names[0] : "<\?\?\?>";
@@ -1132,6 +1309,14 @@ void DNS_Mgr::AsyncLookupName(const string& name, LookupCallback* callback)
 		return;
 		}
 
+	// Or that there's none?
+	if ( NameFailedInCache(name) )
+		{
+		callback->Timeout();
+		delete callback;
+		return;
+		}
+
 	AsyncRequest* req = 0;
 
 	// Have we already a request waiting for this host?
@@ -1205,7 +1390,7 @@ static bool DoRequest(nb_dns_info* nb_dns, DNS_Mgr_Request* dr)
 
 void DNS_Mgr::IssueAsyncRequests()
 	{
-	while ( asyncs_queued.size() && asyncs_pending < MAX_PENDING_REQUESTS )
+	while ( asyncs_queued.size() && asyncs_pending < max_pending_requests )
 		{
 		AsyncRequest* req = asyncs_queued.front();
 		asyncs_queued.pop_front();
@@ -1279,7 +1464,11 @@ void DNS_Mgr::CheckAsyncAddrRequest(const IPAddr& addr, bool timeout)
 		const char* name = LookupAddrInCache(addr);
 		if ( name )
 			{
-			++successful;
+			if ( addr_mappings[addr]->Failed() )
+				++failed;
+			else
+				++successful;
+
 			i->second->Resolved(name);
 			}
 
@@ -1311,7 +1500,11 @@ void DNS_Mgr::CheckAsyncTextRequest(const char* host, bool timeout)
 		const char* name = LookupTextInCache(host);
 		if ( name )
 			{
-			++successful;
+			if ( text_mappings[host]->Failed() )
+				++failed;
+			else
+				++successful;
+
 			i->second->Resolved(name);
 			}
 
@@ -51,6 +51,10 @@ public:
 	void InitPostScript();
 	void Flush();
 
+	// Drops the resolver socket inherited from a parent process, so
+	// that the next lookup opens one of the process' own.
+	void AfterFork();
+
 	// Looks up the address or addresses of the given host, and returns
 	// a set of addr.
 	TableVal* LookupHost(const char* host);
@@ -68,6 +72,10 @@ public:
 	TableVal* LookupNameInCache(const string& name);
 	const char* LookupTextInCache(const string& name);
 
+	// Returns true if the cache has an unexpired record of both the
+	// A and AAAA lookups of the name having failed.
+	bool NameFailedInCache(const string& name);
+
 	// Support for async lookups.
 	class LookupCallback {
 	public:
@@ -117,6 +125,11 @@ protected:
 	void Save(FILE* f, const AddrMap& m);
 	void Save(FILE* f, const HostMap& m);
 
+	// Evicts the least recently used mappings if there are more than
+	// dns_max_cache_entries.
+	void EnforceCacheLimit();
+	static uint64 HostLastUse(const pair<DNS_Mapping*, DNS_Mapping*>& m);
+
 	// Selects on the fd to see if there is an answer available (timeout
 	// is secs). Returns 0 on timeout, -1 on EINTR or other error, and 1
 	// if answer is ready.
@@ -248,6 +261,14 @@ protected:
 	unsigned long successful;
 	unsigned long failed;
 	double next_timestamp;
+
+	// Settings from the scripts, see InitPostScript().
+	int max_cache_entries;
+	double negative_ttl;
+	int max_pending_requests;
+
+	// Orders the uses of mappings, for eviction.
+	uint64 cache_clock;
 };
 
 extern DNS_Mgr* dns_mgr;
@@ -838,10 +838,9 @@ int dbg_handle_debug_input()
 
 
 // Return true to continue execution, false to abort.
-bool pre_execute_stmt(Stmt* stmt, Frame* f)
+bool do_pre_execute_stmt(Stmt* stmt, Frame* f)
 	{
-	if ( ! g_policy_debug ||
-	     stmt->Tag() == STMT_LIST || stmt->Tag() == STMT_NULL )
+	if ( stmt->Tag() == STMT_LIST || stmt->Tag() == STMT_NULL )
 		return true;
 
 	if ( g_trace_state.DoTrace() )
@@ -903,7 +902,7 @@ bool pre_execute_stmt(Stmt* stmt, Frame* f)
 	return true;
 	}
 
-bool post_execute_stmt(Stmt* stmt, Frame* f, Val* result, stmt_flow_type* flow)
+bool do_post_execute_stmt(Stmt* stmt, Frame* f, Val* result, stmt_flow_type* flow)
 	{
 	// Handle the case where someone issues a "next" debugger command,
 	// but we're at a return statement, so the next statement is in
@@ -148,9 +148,22 @@ vector<ParseLocationRec> parse_location_string(const string& s);
 
 // Debugging hooks.
 
-// Return true to continue execution, false to abort.
-bool pre_execute_stmt(Stmt* stmt, Frame* f);
-bool post_execute_stmt(Stmt* stmt, Frame* f, Val* result, stmt_flow_type* flow);
+// Return true to continue execution, false to abort.  These run around
+// every statement, so the check whether the debugger is active at all is
+// done inline.
+bool do_pre_execute_stmt(Stmt* stmt, Frame* f);
+bool do_post_execute_stmt(Stmt* stmt, Frame* f, Val* result, stmt_flow_type* flow);
+
+inline bool pre_execute_stmt(Stmt* stmt, Frame* f)
+	{
+	return ! g_policy_debug || do_pre_execute_stmt(stmt, f);
+	}
+
+inline bool post_execute_stmt(Stmt* stmt, Frame* f, Val* result,
+				stmt_flow_type* flow)
+	{
+	return ! g_policy_debug || do_post_execute_stmt(stmt, f, result, flow);
+	}
 
 // Returns 1 if successful, 0 otherwise.
 // If cmdfile is non-nil, it contains the location of a file of commands
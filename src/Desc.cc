@@ -11,7 +11,26 @@
 #include "Reporter.h"
 
 #define DEFAULT_SIZE 128
-#define SLOP 10
+
+// How large a buffer an ODesc may leave behind for the next one of its
+// thread to use.
+#define MAX_SPARE_SIZE (64 * 1024)
+
+// Most descriptions are short-lived, for rendering a single value or
+// line. Passing on the buffer from one to the next saves allocating and
+// freeing one each time.
+namespace {
+
+struct SpareBuffer {
+	void* base = 0;
+	unsigned int size = 0;
+
+	~SpareBuffer()	{ free(base); }
+};
+
+thread_local SpareBuffer spare;
+
+}
 
 ODesc::ODesc(desc_type t, BroFile* arg_f)
 	{
@@ -21,8 +40,18 @@ ODesc::ODesc(desc_type t, BroFile* arg_f)
 
 	if ( f == 0 )
 		{
-		size = DEFAULT_SIZE;
-		base = safe_malloc(size);
+		if ( spare.base )
+			{
+			base = spare.base;
+			size = spare.size;
+			spare.base = 0;
+			}
+		else
+			{
+			size = DEFAULT_SIZE;
+			base = safe_malloc(size);
+			}
+
 		((char*) base)[0] = '\0';
 		offset = 0;
 		}
@@ -49,7 +78,15 @@ ODesc::~ODesc()
 			f->Flush();
 		}
 	else if ( base )
-		free(base);
+		{
+		if ( ! spare.base && size <= MAX_SPARE_SIZE )
+			{
+			spare.base = base;
+			spare.size = size;
+			}
+		else
+			free(base);
+		}
 	}
 
 void ODesc::EnableEscaping()
@@ -149,10 +186,13 @@ void ODesc::Add(double d, bool no_exp)
 		// of 1.79e308 without using scientific notation.
 		char tmp[350];
 
-		if ( no_exp )
-			modp_dtoa3(d, tmp, sizeof(tmp), IsReadable() ? 6 : 8);
+		int prec = IsReadable() ? 6 : 8;
+
+		// The two only differ for large values.
+		if ( no_exp && fabs(d) > 0x7fffffff )
+			modp_dtoa3(d, tmp, sizeof(tmp), prec);
 		else
-			modp_dtoa2(d, tmp, IsReadable() ? 6 : 8);
+			modp_dtoa_n(d, tmp, prec, 1);
 
 		Add(tmp);
 
@@ -164,7 +204,8 @@ void ODesc::Add(double d, bool no_exp)
 
 void ODesc::Add(const IPAddr& addr)
 	{
-	Add(addr.AsString());
+	char buf[IPAddr::MAX_STRING_LEN];
+	AddN(buf, addr.AsString(buf));
 	}
 
 void ODesc::Add(const IPPrefix& prefix)
@@ -261,6 +302,10 @@ pair<const char*, size_t> ODesc::FirstEscapeLoc(const char* bytes, size_t n)
 		if ( ! isprint(bytes[i]) || bytes[i] == '\\' )
 			return escape_pos(bytes + i, 1);
 
+		// Only look through the sequences where one might start.
+		if ( ! escape_starts[(unsigned char) bytes[i]] )
+			continue;
+
 		size_t len = StartsWithEscapeSequence(bytes + i, bytes + n);
 
 		if ( len )
@@ -299,7 +344,16 @@ void ODesc::AddBytes(const void* bytes, unsigned int n)
 		}
 	}
 
-void ODesc::AddBytesRaw(const void* bytes, unsigned int n)
+void ODesc::UpdateEscapeStarts()
+	{
+	escape_starts.reset();
+
+	for ( const auto& s : escape_sequences )
+		if ( ! s.empty() )
+			escape_starts.set((unsigned char) s[0]);
+	}
+
+void ODesc::AddBytesRawSlow(const void* bytes, unsigned int n)
 	{
 	if ( n == 0 )
 		return;
@@ -336,13 +390,17 @@ void ODesc::AddBytesRaw(const void* bytes, unsigned int n)
 		}
 	}
 
-void ODesc::Grow(unsigned int n)
+void ODesc::Resize(unsigned int n)
 	{
+	if ( size == 0 )
+		// After TakeBytes().
+		size = DEFAULT_SIZE;
+
+	// Go straight to the size we'll end up with.
 	while ( offset + n + SLOP >= size )
-		{
 		size *= 2;
-		base = safe_realloc(base, size);
-		}
+
+	base = safe_realloc(base, size);
 	}
 
 void ODesc::Clear()
@@ -4,6 +4,8 @@
 #define descriptor_h
 
 #include <stdio.h>
+#include <string.h>
+#include <bitset>
 #include <set>
 #include <utility>
 
@@ -54,16 +56,16 @@ public:
 	void SetFlush(int arg_do_flush)	{ do_flush = arg_do_flush; }
 
 	void EnableEscaping();
-	void AddEscapeSequence(const char* s) { escape_sequences.insert(s); }
+	void AddEscapeSequence(const char* s) { AddEscapeSequence(string(s)); }
 	void AddEscapeSequence(const char* s, size_t n)
-	    { escape_sequences.insert(string(s, n)); }
+	    { AddEscapeSequence(string(s, n)); }
 	void AddEscapeSequence(const string & s)
-	    { escape_sequences.insert(s); }
-	void RemoveEscapeSequence(const char* s) { escape_sequences.erase(s); }
+	    { escape_sequences.insert(s); UpdateEscapeStarts(); }
+	void RemoveEscapeSequence(const char* s) { RemoveEscapeSequence(string(s)); }
 	void RemoveEscapeSequence(const char* s, size_t n)
-	    { escape_sequences.erase(string(s, n)); }
+	    { RemoveEscapeSequence(string(s, n)); }
 	void RemoveEscapeSequence(const string & s)
-	    { escape_sequences.erase(s); }
+	    { escape_sequences.erase(s); UpdateEscapeStarts(); }
 
 	void PushIndent();
 	void PopIndent();
@@ -139,6 +141,14 @@ public:
 
 	int Len() const		{ return offset; }
 
+	// Makes room for n more bytes up front, for when the caller knows
+	// roughly how much is coming.
+	void Reserve(unsigned int n)
+		{
+		if ( ! f )
+			Grow(n);
+		}
+
 	void Clear();
 
 	// Used to determine recursive types. Records push their types on here;
@@ -151,10 +161,33 @@ protected:
 	void Indent();
 
 	void AddBytes(const void* bytes, unsigned int n);
-	void AddBytesRaw(const void* bytes, unsigned int n);
+
+	void AddBytesRaw(const void* bytes, unsigned int n)
+		{
+		// The common case of appending to a buffer that has room.
+		if ( ! f && offset + n + SLOP < size )
+			{
+			memcpy((char*) base + offset, bytes, n);
+			offset += n;
+			((char*) base)[offset] = '\0';	// ensure that always NUL-term.
+			}
+		else
+			AddBytesRawSlow(bytes, n);
+		}
+
+	void AddBytesRawSlow(const void* bytes, unsigned int n);
 
 	// Make buffer big enough for n bytes beyond bufp.
-	void Grow(unsigned int n);
+	void Grow(unsigned int n)
+		{
+		if ( offset + n + SLOP >= size )
+			Resize(n);
+		}
+
+	void Resize(unsigned int n);
+
+	// Notes the first bytes of the escape sequences.
+	void UpdateEscapeStarts();
 
 	/**
 	 * Returns the location of the first place in the bytes to be hex-escaped.
@@ -188,6 +221,10 @@ protected:
 	bool escape;	// escape unprintable characters in output?
 	typedef set<string> escape_set;
 	escape_set escape_sequences; // additional sequences of chars to escape
+	std::bitset<256> escape_starts;	// first bytes of escape_sequences
+
+	// Room always kept free at the end of the buffer.
+	static const unsigned int SLOP = 10;
 
 	BroFile* f;	// or the file we're using.
 
@@ -7,7 +7,13 @@
 #endif
 
 #include "Dict.h"
+#include "HugePages.h"
 #include "Reporter.h"
+#include "util.h"
+
+// The open-addressing implementation selected via ENABLE_OPEN_DICT lives
+// in OpenDict.cc.
+#ifndef ENABLE_OPEN_DICT
 
 // If the mean bucket length exceeds the following then Insert() will
 // increase the size of the hash table.
@@ -21,6 +27,12 @@
 // increase the size of the hash table as needed.
 #define DEFAULT_DICT_SIZE 16
 
+// While resizing, the number of entries we try to move per operation
+// and the maximum number of old buckets we look at to find them.  The
+// latter bounds the work when long runs of buckets are empty.
+#define MOVE_CHAINS_ENTRIES 8
+#define MOVE_CHAINS_BUCKETS 32
+
 class DictEntry {
 public:
 	DictEntry(void* k, int l, hash_t h, void* val)
@@ -55,8 +67,10 @@ public:
 	PList(DictEntry) inserted;	// inserted while iterating
 };
 
-Dictionary::Dictionary(dict_order ordering, int initial_size)
+Dictionary::Dictionary(dict_order ordering, int initial_size,
+			HashPolicy policy)
 	{
+	hash_policy = policy;
 	tbl = 0;
 	tbl2 = 0;
 
@@ -111,7 +125,7 @@ void Dictionary::DeInit()
 			delete chain;
 			}
 
-	delete [] tbl;
+	huge_free(tbl);
 
 	if ( tbl2 == 0 )
 		return;
@@ -131,7 +145,7 @@ void Dictionary::DeInit()
 			delete chain;
 			}
 
-	delete [] tbl2;
+	huge_free(tbl2);
 	tbl2 = 0;
 	}
 
@@ -319,7 +333,8 @@ void* Dictionary::NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) c
 		// and removing from the tail is cheaper.
 		entry = cookie->inserted.remove_nth(cookie->inserted.length()-1);
 		if ( return_hash )
-			h = new HashKey(entry->key, entry->len, entry->hash);
+			h = new HashKey(entry->key, entry->len, entry->hash,
+						hash_policy);
 
 		return entry->value;
 		}
@@ -344,7 +359,8 @@ void* Dictionary::NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) c
 		entry = (*ttbl[b])[o];
 		++cookie->offset;
 		if ( return_hash )
-			h = new HashKey(entry->key, entry->len, entry->hash);
+			h = new HashKey(entry->key, entry->len, entry->hash,
+						hash_policy);
 		return entry->value;
 		}
 
@@ -376,7 +392,8 @@ void* Dictionary::NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) c
 
 	entry = (*ttbl[b])[0];
 	if ( return_hash )
-		h = new HashKey(entry->key, entry->len, entry->hash);
+		h = new HashKey(entry->key, entry->len, entry->hash,
+						hash_policy);
 
 	cookie->bucket = b;
 	cookie->offset = 1;
@@ -387,7 +404,7 @@ void* Dictionary::NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) c
 void Dictionary::Init(int size)
 	{
 	num_buckets = NextPrime(size);
-	tbl = new PList(DictEntry)*[num_buckets];
+	tbl = huge_new_array<PList(DictEntry)*>(num_buckets);
 
 	for ( int i = 0; i < num_buckets; ++i )
 		tbl[i] = 0;
@@ -399,7 +416,7 @@ void Dictionary::Init(int size)
 void Dictionary::Init2(int size)
 	{
 	num_buckets2 = NextPrime(size);
-	tbl2 = new PList(DictEntry)*[num_buckets2];
+	tbl2 = huge_new_array<PList(DictEntry)*>(num_buckets2);
 
 	for ( int i = 0; i < num_buckets2; ++i )
 		tbl2[i] = 0;
@@ -526,12 +543,17 @@ void Dictionary::StartChangeSize(int new_size)
 	if ( tbl2 )
 		reporter->InternalError("Dictionary::StartChangeSize() tbl2 not NULL");
 
+	double start = current_time(true);
+
 	Init2(new_size);
 
 	tbl_next_ind = 0;
 
 	// Preserve threshold density
 	SetDensityThresh2(DensityThresh());
+
+	++resize_stats.resizes;
+	RecordResizeStep(0, start);
 	}
 
 void Dictionary::MoveChains()
@@ -540,12 +562,18 @@ void Dictionary::MoveChains()
 	if ( cookies.length() > 0 )
 		return;
 
-	// Attempt to move this many entries (must do at least 2)
-	int num = 8;
+	double start = current_time(true);
+
+	// Attempt to move this many entries (must do at least 2), but
+	// don't scan more than a fixed number of buckets for them.
+	int num = MOVE_CHAINS_ENTRIES;
+	int buckets = MOVE_CHAINS_BUCKETS;
+	uint64 moved = 0;
 
 	do
 		{
 		PList(DictEntry)* chain = tbl[tbl_next_ind++];
+		--buckets;
 
 		if ( ! chain )
 			continue;
@@ -559,12 +587,15 @@ void Dictionary::MoveChains()
 			--num;
 			}
 
+		moved += chain->length();
 		delete chain;
 		}
-	while ( num > 0 && int(tbl_next_ind) < num_buckets );
+	while ( num > 0 && buckets > 0 && int(tbl_next_ind) < num_buckets );
 
 	if ( int(tbl_next_ind) >= num_buckets )
 		FinishChangeSize();
+
+	RecordResizeStep(moved, start);
 	}
 
 void Dictionary::FinishChangeSize()
@@ -577,7 +608,7 @@ void Dictionary::FinishChangeSize()
 
 	for ( int i = 0; i < num_buckets; ++i )
 		delete tbl[i];
-	delete [] tbl;
+	huge_free(tbl);
 
 	tbl = tbl2;
 	tbl2 = 0;
@@ -593,6 +624,8 @@ void Dictionary::FinishChangeSize()
 	max_num_entries2 = 0;
 	den_thresh2 = 0;
 	thresh_entries2 = 0;
+
+	++resize_stats.completed;
 	}
 
 unsigned int Dictionary::MemoryAllocation() const
@@ -633,6 +666,50 @@ unsigned int Dictionary::MemoryAllocation() const
 	return size;
 	}
 
+unsigned int Dictionary::MemoryAllocationEstimate(unsigned int key_size) const
+	{
+	unsigned int size = padded_sizeof(*this);
+
+	if ( ! tbl )
+		return size;
+
+	// Each entry is referenced from the list of its chain, and most
+	// chains hold a single entry.
+	unsigned int entry = padded_sizeof(DictEntry) + pad_size(key_size) +
+				sizeof(DictEntry*);
+	int num_chains = Length() < num_buckets ? Length() : num_buckets;
+
+	size += Length() * entry;
+	size += num_chains * padded_sizeof(PList(DictEntry));
+	size += pad_size(num_buckets * sizeof(PList(DictEntry)*));
+
+	if ( order )
+		size += pad_size(order->max() * sizeof(DictEntry*));
+
+	if ( tbl2 )
+		size += pad_size(num_buckets2 * sizeof(PList(DictEntry)*));
+
+	return size;
+	}
+
+#endif
+
+Dictionary::ResizeStats Dictionary::resize_stats;
+
+void Dictionary::RecordResizeStep(uint64 moved, double start)
+	{
+	double stall = current_time(true) - start;
+
+	++resize_stats.steps;
+	resize_stats.total_time += stall;
+
+	if ( moved > resize_stats.max_moved )
+		resize_stats.max_moved = moved;
+
+	if ( stall > resize_stats.max_stall )
+		resize_stats.max_stall = stall;
+	}
+
 void generic_delete_func(void* v)
 	{
 	free(v);
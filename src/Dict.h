@@ -3,11 +3,13 @@
 #ifndef dict_h
 #define dict_h
 
+#include "zeek-config.h"
 #include "List.h"
 #include "Hash.h"
 
 class Dictionary;
 class DictEntry;
+class DictSlot;
 class IterCookie;
 
 declare(PList,DictEntry);
@@ -25,22 +27,27 @@ extern void generic_delete_func(void*);
 
 class Dictionary {
 public:
+	// The hash policy can't change later, as all hashes of the keys
+	// have to come from it.
 	explicit Dictionary(dict_order ordering = UNORDERED,
-			int initial_size = 0);
+			int initial_size = 0, HashPolicy policy = HASH_KEYED);
 	virtual ~Dictionary();
 
 	// Member functions for looking up a key, inserting/changing its
 	// contents, and deleting it.  These come in two flavors: one
 	// which takes a HashKey, and the other which takes a raw key,
-	// its size, and its (unmodulated) hash.
+	// its size, and its (unmodulated) hash.  The HashKey flavor
+	// rehashes keys built with another policy than the dictionary's;
+	// for the raw one, the hash must be the dictionary's.
 	void* Lookup(const HashKey* key) const
-		{ return Lookup(key->Key(), key->Size(), key->Hash()); }
+		{ return Lookup(key->Key(), key->Size(), key->Hash(hash_policy)); }
 	void* Lookup(const void* key, int key_size, hash_t hash) const;
 
 	// Returns previous value, or 0 if none.
 	void* Insert(HashKey* key, void* val)
 		{
-		return Insert(key->TakeKey(), key->Size(), key->Hash(), val, 0);
+		hash_t h = key->Hash(hash_policy);
+		return Insert(key->TakeKey(), key->Size(), h, val, 0);
 		}
 	// If copy_key is true, then the key is copied, otherwise it's assumed
 	// that it's a heap pointer that now belongs to the Dictionary to
@@ -52,10 +59,19 @@ public:
 	// case it needs to be deleted.  Returns 0 if no such element exists.
 	// If dontdelete is true, the key's bytes will not be deleted.
 	void* Remove(const HashKey* key)
-		{ return Remove(key->Key(), key->Size(), key->Hash()); }
+		{ return Remove(key->Key(), key->Size(), key->Hash(hash_policy)); }
 	void* Remove(const void* key, int key_size, hash_t hash,
 				bool dont_delete = false);
 
+#ifdef ENABLE_OPEN_DICT
+	// Number of entries.
+	int Length() const
+		{ return num_entries; }
+
+	// Largest it's ever been.
+	int MaxLength() const
+		{ return max_num_entries; }
+#else
 	// Number of entries.
 	int Length() const
 		{ return tbl2 ? num_entries + num_entries2 : num_entries; }
@@ -66,6 +82,7 @@ public:
 		return tbl2 ?
 			max_num_entries + max_num_entries2 : max_num_entries;
 		}
+#endif
 
 	// Total number of entries ever.
 	uint64 NumCumulativeInserts() const
@@ -73,8 +90,14 @@ public:
 		return cumulative_entries;
 		}
 
+	HashPolicy Policy() const	{ return hash_policy; }
+
 	// True if the dictionary is ordered, false otherwise.
+#ifdef ENABLE_OPEN_DICT
+	int IsOrdered() const		{ return ordered; }
+#else
 	int IsOrdered() const		{ return order != 0; }
+#endif
 
 	// If the dictionary is ordered then returns the n'th entry's value;
 	// the second method also returns the key.  The first entry inserted
@@ -123,7 +146,69 @@ public:
 
 	unsigned int MemoryAllocation() const;
 
+	// Like MemoryAllocation() but in constant time, assuming that all
+	// keys have the given size and that all chains are short.
+	unsigned int MemoryAllocationEstimate(unsigned int key_size) const;
+
+	// Statistics about growing the hash tables, accumulated across all
+	// dictionaries. A resize may be spread out over many operations;
+	// each "step" is one such operation's share of the work.
+	struct ResizeStats {
+		uint64 resizes;		// resizes started
+		uint64 completed;	// resizes finished
+		uint64 steps;		// operations that did resizing work
+		uint64 max_moved;	// most entries moved in a single step
+		double max_stall;	// longest time spent in a single step
+		double total_time;	// total time spent resizing
+	};
+
+	static const ResizeStats& GetResizeStats()	{ return resize_stats; }
+
 private:
+	// Accounts for a resizing step that moved the given number of
+	// entries and started at the given (real) time.
+	static void RecordResizeStep(uint64 moved, double start);
+
+	static ResizeStats resize_stats;
+
+#ifdef ENABLE_OPEN_DICT
+	// Open-addressing implementation, see OpenDict.cc. Entries live in
+	// a dense array in insertion order; a separate power-of-two sized
+	// index of slots maps hashes to entry positions using linear
+	// probing. Each slot carries part of the hash, so that most probes
+	// don't need to touch the entry itself.
+	void Init(int size);
+	void DeInit();
+
+	// Returns the index of the slot holding the given key, or -1.
+	int FindSlot(const void* key, int key_size, hash_t hash) const;
+
+	// Rebuilds the slot index with the given number of slots (which
+	// must be a power of two), dropping deleted markers.
+	void Rehash(int new_num_slots);
+
+	// Closes the holes that removals left in the entry array. Must not
+	// be called while robust cookies are active.
+	void Compact();
+
+	// Makes sure that there's room for at least one more entry.
+	void GrowEntries();
+
+	DictEntry* entries;
+	int entries_len;	// positions used, including holes
+	int entries_cap;
+
+	DictSlot* slots;
+	int num_slots;
+	int num_deleted_slots;
+
+	int num_entries;
+	int max_num_entries;
+	uint64 cumulative_entries;
+
+	bool ordered;
+	dict_delete_func delete_func;
+#else
 	void Init(int size);
 	void Init2(int size);	// initialize second table for resizing
 	void DeInit();
@@ -182,8 +267,10 @@ private:
 
 	PList(DictEntry)* order;
 	dict_delete_func delete_func;
+#endif
 
 	PList(IterCookie) cookies;
+	HashPolicy hash_policy;
 };
 
 
@@ -192,18 +279,19 @@ private:
 class PDict(type) : public Dictionary {	\
 public:	\
 	explicit PDict(type)(dict_order ordering = UNORDERED,	\
-			int initial_size = 0) :	\
-		Dictionary(ordering, initial_size) {}	\
+			int initial_size = 0,	\
+			HashPolicy policy = HASH_KEYED) :	\
+		Dictionary(ordering, initial_size, policy) {}	\
 	type* Lookup(const char* key) const	\
 		{	\
-		HashKey h(key);	\
+		HashKey h(key, Policy());	\
 		return (type*) Dictionary::Lookup(&h);	\
 		}	\
 	type* Lookup(const HashKey* key) const	\
 		{ return (type*) Dictionary::Lookup(key); }	\
 	type* Insert(const char* key, type* val)	\
 		{	\
-		HashKey h(key);	\
+		HashKey h(key, Policy());	\
 		return (type*) Dictionary::Insert(&h, (void*) val);	\
 		}	\
 	type* Insert(HashKey* key, type* val)	\
@@ -224,8 +312,7 @@ public:	\
 	type* NextEntry(HashKey*& h, IterCookie*& cookie) const	\
 		{ return (type*) Dictionary::NextEntry(h, cookie, 1); } \
 	type* RemoveEntry(const HashKey* key)	\
-		{ return (type*) Remove(key->Key(), key->Size(),	\
-					key->Hash()); } \
+		{ return (type*) Remove(key); } \
 }
 
 #endif
@@ -3,15 +3,52 @@
 #include "zeek-config.h"
 
 #include "Event.h"
+#include "FreeList.h"
 #include "Func.h"
 #include "NetVar.h"
+#include "Net.h"
+#include "Probes.h"
+#include "StallDetector.h"
 #include "Trigger.h"
+#include "Var.h"
+#include "metrics/Manager.h"
 #include "plugin/Manager.h"
 
 EventMgr mgr;
 
 uint64 num_events_queued = 0;
 uint64 num_events_dispatched = 0;
+uint64 max_events_pending = 0;
+uint64 num_events_allocated = 0;
+uint64 num_events_reused = 0;
+
+// Upper bound on the number of freed events we hang on to.
+#define EVENT_POOL_MAX 4096
+
+static FreeList<EVENT_POOL_MAX> event_pool;
+
+void* Event::operator new(size_t size)
+	{
+	if ( size == sizeof(Event) )
+		{
+		if ( void* e = event_pool.Get() )
+			{
+			++num_events_reused;
+			return e;
+			}
+		}
+
+	++num_events_allocated;
+	return ::operator new(size);
+	}
+
+void Event::operator delete(void* ptr, size_t size)
+	{
+	if ( size == sizeof(Event) && event_pool.Put(ptr) )
+		return;
+
+	::operator delete(ptr);
+	}
 
 Event::Event(EventHandlerPtr arg_handler, val_list arg_args,
 		SourceID arg_src, analyzer::ID arg_aid, TimerMgr* arg_mgr,
@@ -22,7 +59,8 @@ Event::Event(EventHandlerPtr arg_handler, val_list arg_args,
 	  aid(arg_aid),
 	  mgr(arg_mgr ? arg_mgr : timer_mgr),
 	  obj(arg_obj),
-	  next_event(nullptr)
+	  next_event(nullptr),
+	  queued_at(0)
 	{
 	if ( obj )
 		Ref(obj);
@@ -61,6 +99,8 @@ void Event::Dispatch(bool no_remote)
 	if ( handler->ErrorHandler() )
 		reporter->BeginErrorHandler();
 
+	ZEEK_PROBE1(event__start, handler->Name());
+
 	try
 		{
 		handler->Call(&args, no_remote);
@@ -71,6 +111,8 @@ void Event::Dispatch(bool no_remote)
 		// Already reported.
 		}
 
+	ZEEK_PROBE1(event__done, handler->Name());
+
 	if ( obj )
 		// obj->EventDone();
 		Unref(obj);
@@ -81,7 +123,10 @@ void Event::Dispatch(bool no_remote)
 
 EventMgr::EventMgr()
 	{
-	head = tail = 0;
+	for ( int i = 0; i < NUM_EVENT_LANES; ++i )
+		lanes[i].head = lanes[i].tail = 0;
+
+	drain_budget = 0;
 	current_src = SOURCE_LOCAL;
 	current_mgr = timer_mgr;
 	current_aid = 0;
@@ -91,11 +136,14 @@ EventMgr::EventMgr()
 
 EventMgr::~EventMgr()
 	{
-	while ( head )
+	for ( int i = 0; i < NUM_EVENT_LANES; ++i )
 		{
-		Event* n = head->NextEvent();
-		Unref(head);
-		head = n;
+		while ( lanes[i].head )
+			{
+			Event* n = lanes[i].head->NextEvent();
+			Unref(lanes[i].head);
+			lanes[i].head = n;
+			}
 		}
 
 	Unref(src_val);
@@ -108,15 +156,58 @@ void EventMgr::QueueEvent(Event* event)
 	if ( done )
 		return;
 
-	if ( ! head )
-		head = tail = event;
+	EventHandler* h = event->Handler().Ptr();
+	Lane* l = &lanes[h ? h->Lane() : EVENT_LANE_NORMAL];
+
+	if ( ! l->head )
+		l->head = l->tail = event;
 	else
 		{
-		tail->SetNext(event);
-		tail = event;
+		l->tail->SetNext(event);
+		l->tail = event;
 		}
 
 	++num_events_queued;
+
+	if ( h )
+		++h->GetStats().queued;
+
+	if ( metrics_mgr && metrics_mgr->GetLatencies().event_wait )
+		event->queued_at = current_time(true);
+
+	if ( uint64(Size()) > max_events_pending )
+		max_events_pending = Size();
+	}
+
+// Puts the events in the set into the given lane.
+static void assign_lane(const char* option, EventLane lane)
+	{
+	Val* v = opt_internal_val(option);
+
+	if ( ! v )
+		return;
+
+	ListVal* names = v->AsTableVal()->ConvertToPureList();
+
+	for ( int i = 0; i < names->Length(); ++i )
+		{
+		const char* name = names->Index(i)->AsString()->CheckString();
+		EventHandler* h = event_registry->Lookup(name);
+
+		if ( h )
+			h->SetLane(lane);
+		else
+			reporter->Warning("%s: no such event: %s", option, name);
+		}
+
+	Unref(names);
+	}
+
+void EventMgr::InitPostScript()
+	{
+	assign_lane("event_queue_high_priority", EVENT_LANE_HIGH);
+	assign_lane("event_queue_low_priority", EVENT_LANE_LOW);
+	drain_budget = opt_internal_double("event_queue_drain_budget");
 	}
 
 void EventMgr::Drain()
@@ -137,24 +228,79 @@ void EventMgr::Drain()
 	// just one round to make it less likley to break existing scripts
 	// that expect the old behavior to trigger something quickly.
 
-	for ( int round = 0; head && round < 2; round++ )
+	metrics::Histogram* wait =
+		metrics_mgr ? metrics_mgr->GetLatencies().event_wait : 0;
+
+	// When detecting stalls, each dispatch gets timed to find the
+	// handlers responsible.
+	double last = stall_detector ? StallDetector::Now() : 0;
+	double start = last;
+
+	// Once past it, low-priority events wait for the next drain. We
+	// don't hold anything back when shutting down, though.
+	double deadline = 0;
+
+	if ( drain_budget > 0 && ! terminating )
+		deadline = current_time(true) + drain_budget;
+
+	bool did_low = false;
+
+	for ( int round = 0; HasEvents() && round < 2; round++ )
 		{
-		Event* current = head;
-		head = 0;
-		tail = 0;
+		Lane taken[NUM_EVENT_LANES];
+
+		for ( int i = 0; i < NUM_EVENT_LANES; ++i )
+			{
+			taken[i] = lanes[i];
+			lanes[i].head = lanes[i].tail = 0;
+			}
 
-		while ( current )
+		for ( int i = 0; i < NUM_EVENT_LANES; ++i )
 			{
-			Event* next = current->NextEvent();
+			Event* current = taken[i].head;
 
-			current_src = current->Source();
-			current_mgr = current->Mgr();
-			current_aid = current->Analyzer();
-			current->Dispatch();
-			Unref(current);
+			while ( current )
+				{
+				if ( i == EVENT_LANE_LOW && deadline && did_low &&
+				     current_time(true) > deadline )
+					{
+					// Put the rest back in front of anything
+					// queued since.
+					taken[i].tail->SetNext(lanes[i].head);
 
-			++num_events_dispatched;
-			current = next;
+					if ( ! lanes[i].head )
+						lanes[i].tail = taken[i].tail;
+
+					lanes[i].head = current;
+					break;
+					}
+
+				Event* next = current->NextEvent();
+
+				if ( wait && current->queued_at )
+					wait->Observe(current_time(true) - current->queued_at);
+
+				current_src = current->Source();
+				current_mgr = current->Mgr();
+				current_aid = current->Analyzer();
+				current->Dispatch();
+
+				if ( stall_detector )
+					{
+					double now = StallDetector::Now();
+					stall_detector->AddHandler(current->Handler().Ptr(), now - last);
+					last = now;
+					}
+
+				Unref(current);
+
+				++num_events_dispatched;
+
+				if ( i == EVENT_LANE_LOW )
+					did_low = true;
+
+				current = next;
+				}
 			}
 		}
 
@@ -162,6 +308,9 @@ void EventMgr::Drain()
 	// do after draining events.
 	draining = false;
 
+	if ( stall_detector )
+		stall_detector->Add(StallDetector::EVENTS, last - start);
+
 	// We evaluate Triggers here. While this is somewhat unrelated to event
 	// processing, we ensure that it's done at a regular basis by checking
 	// them here.
@@ -172,14 +321,17 @@ void EventMgr::Describe(ODesc* d) const
 	{
 	int n = 0;
 	Event* e;
-	for ( e = head; e; e = e->NextEvent() )
-		++n;
+
+	for ( int i = 0; i < NUM_EVENT_LANES; ++i )
+		for ( e = lanes[i].head; e; e = e->NextEvent() )
+			++n;
 
 	d->AddCount(n);
 
-	for ( e = head; e; e = e->NextEvent() )
-		{
-		e->Describe(d);
-		d->NL();
-		}
+	for ( int i = 0; i < NUM_EVENT_LANES; ++i )
+		for ( e = lanes[i].head; e; e = e->NextEvent() )
+			{
+			e->Describe(d);
+			d->NL();
+			}
 	}
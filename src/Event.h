@@ -33,6 +33,11 @@ public:
 
 	void Describe(ODesc* d) const override;
 
+	// Events come and go at a high rate, so the memory of freed ones
+	// is kept around for reuse rather than returned to malloc.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 protected:
 	friend class EventMgr;
 
@@ -47,10 +52,14 @@ protected:
 	TimerMgr* mgr;
 	BroObj* obj;
 	Event* next_event;
+	double queued_at;	// wall-clock time, if measuring latencies
 };
 
 extern uint64 num_events_queued;
 extern uint64 num_events_dispatched;
+extern uint64 max_events_pending;	// largest queue depth seen
+extern uint64 num_events_allocated;	// events that had to be malloc'd
+extern uint64 num_events_reused;	// events served from the free pool
 
 class EventMgr : public BroObj {
 public:
@@ -110,10 +119,22 @@ public:
 		Unref(event);
 		}
 
+	// Assigns events to the queue's lanes as the scripts ask for.
+	void InitPostScript();
+
+	// Dispatches the queued events, lane by lane. If a drain budget is
+	// set, the low-priority lane may get left partly for the next call.
 	void Drain();
 	bool IsDraining() const	{ return draining; }
 
-	int HasEvents() const	{ return head != 0; }
+	int HasEvents() const
+		{
+		for ( int i = 0; i < NUM_EVENT_LANES; ++i )
+			if ( lanes[i].head )
+				return 1;
+
+		return 0;
+		}
 
 	// Returns the source ID of last raised event.
 	SourceID CurrentSource() const	{ return current_src; }
@@ -133,8 +154,14 @@ public:
 protected:
 	void QueueEvent(Event* event);
 
-	Event* head;
-	Event* tail;
+	// A FIFO of events.
+	struct Lane {
+		Event* head;
+		Event* tail;
+	};
+
+	Lane lanes[NUM_EVENT_LANES];
+	double drain_budget;	// wall-clock seconds, 0 for none
 	SourceID current_src;
 	analyzer::ID current_aid;
 	TimerMgr* current_mgr;
@@ -3,6 +3,8 @@
 #include "Func.h"
 #include "Scope.h"
 #include "NetVar.h"
+#include "Traverse.h"
+#include "plugin/Manager.h"
 
 #include "broker/Manager.h"
 #include "broker/Data.h"
@@ -16,6 +18,8 @@ EventHandler::EventHandler(const char* arg_name)
 	error_handler = false;
 	enabled = true;
 	generate_always = false;
+	lane = EVENT_LANE_NORMAL;
+	args_used_bodies = 0;
 	}
 
 EventHandler::~EventHandler()
@@ -58,6 +62,107 @@ void EventHandler::SetLocalHandler(Func* f)
 
 	Ref(f);
 	local = f;
+
+	args_used.clear();
+	args_used_bodies = 0;
+	}
+
+// Marks the arguments of an event handler that its bodies refer to.
+// Arguments are the first locals of each body's frame, so any reference
+// to a local with an offset in that range is a use.
+class ArgUseFinder : public TraversalCallback {
+public:
+	explicit ArgUseFinder(std::vector<bool>* arg_used)
+		: used(arg_used)	{ }
+
+	TraversalCode PreExpr(const Expr* expr) override
+		{
+		if ( expr->Tag() == EXPR_CONST )
+			{
+			FindInFunction(static_cast<const ConstExpr*>(expr)->Value());
+			return TC_CONTINUE;
+			}
+
+		if ( expr->Tag() != EXPR_NAME )
+			return TC_CONTINUE;
+
+		const ID* id = static_cast<const NameExpr*>(expr)->Id();
+
+		if ( ! id->IsGlobal() && id->Offset() >= 0 &&
+		     id->Offset() < int(used->size()) )
+			(*used)[id->Offset()] = true;
+
+		return TC_CONTINUE;
+		}
+
+private:
+	// Anonymous functions are constants. Their bodies can name the
+	// handler's arguments too, and their own locals may share the
+	// arguments' offsets; counting those errs on the side of building
+	// arguments.
+	void FindInFunction(const Val* v)
+		{
+		if ( v->Type()->Tag() != TYPE_FUNC )
+			return;
+
+		const Func* f = v->AsFunc();
+
+		if ( f->GetKind() != Func::BRO_FUNC || ! seen.insert(f).second )
+			return;
+
+		for ( const auto& body : f->GetBodies() )
+			body.stmts->Traverse(this);
+		}
+
+	std::vector<bool>* used;
+	std::unordered_set<const Func*> seen;
+};
+
+void EventHandler::FindUsedArgs()
+	{
+	FuncType* ft = FType();
+	int num_args = ft ? ft->Args()->NumFields() : 0;
+
+	args_used.assign(num_args, false);
+	args_used_bodies = local->GetBodies().size();
+
+	ArgUseFinder cb(&args_used);
+
+	for ( const auto& body : local->GetBodies() )
+		body.stmts->Traverse(&cb);
+	}
+
+bool EventHandler::ArgUsed(int n)
+	{
+	if ( ! auto_publish.empty() || generate_always || new_event )
+		return true;
+
+	if ( plugin_mgr->HavePluginForHook(plugin::HOOK_QUEUE_EVENT) ||
+	     plugin_mgr->HavePluginForHook(plugin::HOOK_CALL_FUNCTION) )
+		return true;
+
+	if ( ! local || local->GetKind() != Func::BRO_FUNC )
+		return local != 0;
+
+	// Bodies only get added while parsing, but make sure we're not
+	// relying on an analysis done before the last one came in.
+	if ( args_used_bodies != local->GetBodies().size() )
+		FindUsedArgs();
+
+	return n < 0 || n >= int(args_used.size()) || args_used[n];
+	}
+
+RecordVal* EventHandler::Placeholder(RecordType* t)
+	{
+	static std::unordered_map<RecordType*, RecordVal*> placeholders;
+
+	auto& r = placeholders[t];
+
+	if ( ! r )
+		r = new RecordVal(t);
+
+	Ref(r);
+	return r;
 	}
 
 void EventHandler::Call(val_list* vl, bool no_remote)
@@ -77,6 +182,7 @@ void EventHandler::Call(val_list* vl, bool no_remote)
 			broker::vector xs;
 			xs.reserve(vl->length());
 			bool valid_args = true;
+			double start = current_time(true);
 
 			for ( auto i = 0; i < vl->length(); ++i )
 				{
@@ -93,6 +199,8 @@ void EventHandler::Call(val_list* vl, bool no_remote)
 					}
 				}
 
+			broker_mgr->AddEncodeTime(current_time(true) - start);
+
 			if ( valid_args )
 				{
 				for ( auto it = auto_publish.begin(); ; )
@@ -113,8 +221,24 @@ void EventHandler::Call(val_list* vl, bool no_remote)
 		}
 
 	if ( local )
+		{
+		++stats.calls;
+
 		// No try/catch here; we pass exceptions upstream.
-		Unref(local->Call(vl));
+		if ( event_handler_timing )
+			{
+			uint64 start = read_cycles();
+			Unref(local->Call(vl));
+			uint64 cycles = read_cycles() - start;
+
+			stats.cycles += cycles;
+
+			if ( cycles > stats.max_cycles )
+				stats.max_cycles = cycles;
+			}
+		else
+			Unref(local->Call(vl));
+		}
 	else
 		{
 		loop_over_list(*vl, i)
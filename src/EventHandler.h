@@ -6,11 +6,23 @@
 #include <assert.h>
 #include <unordered_set>
 #include <string>
+#include <vector>
 #include "List.h"
 #include "BroList.h"
+#include "util.h"
 
 class Func;
 class FuncType;
+class RecordType;
+class RecordVal;
+
+// The event queue's lanes, which EventMgr drains in this order.
+enum EventLane {
+	EVENT_LANE_HIGH,
+	EVENT_LANE_NORMAL,
+	EVENT_LANE_LOW,
+	NUM_EVENT_LANES
+};
 
 class EventHandler {
 public:
@@ -53,9 +65,39 @@ public:
 	void SetGenerateAlways()	{ generate_always = true; }
 	bool GenerateAlways()	{ return generate_always; }
 
+	// The lane of the event queue that the events go into.
+	void SetLane(EventLane arg_lane)	{ lane = arg_lane; }
+	EventLane Lane() const	{ return lane; }
+
+	// Returns false if nothing will ever look at the n'th argument of
+	// the event: none of the handler bodies refers to it, and it's
+	// neither published nor passed to new_event() or plugins. Callers
+	// can then pass Placeholder() instead of building the value.
+	bool ArgUsed(int n);
+
+	// Returns a shared, otherwise empty record of the given type to
+	// pass for arguments that ArgUsed() reports as unused.  The caller
+	// gets a new reference.
+	static RecordVal* Placeholder(RecordType* t);
+
+	// Usage counters. The cycles cover the handler bodies, including
+	// whatever they call directly, and are only measured if
+	// event_handler_timing is set.
+	struct Stats {
+		uint64 queued = 0;	// events queued for this handler
+		uint64 calls = 0;	// events dispatched to the bodies
+		uint64 cycles = 0;
+		uint64 max_cycles = 0;
+	};
+
+	Stats& GetStats()	{ return stats; }
+
 private:
 	void NewEvent(val_list* vl);	// Raise new_event() meta event.
 
+	// Determines which arguments the handler bodies refer to.
+	void FindUsedArgs();
+
 	const char* name;
 	Func* local;
 	FuncType* type;
@@ -63,8 +105,14 @@ private:
 	bool enabled;
 	bool error_handler;	// this handler reports error messages.
 	bool generate_always;
+	EventLane lane;
 
 	std::unordered_set<std::string> auto_publish;
+
+	std::vector<bool> args_used;	// by FindUsedArgs()
+	size_t args_used_bodies;	// number of bodies args_used covers
+
+	Stats stats;
 };
 
 // Encapsulates a ptr to an event handler to overload the boolean operator.
@@ -4,14 +4,12 @@
 
 void EventRegistry::Register(EventHandlerPtr handler)
 	{
-	HashKey key(handler->Name());
-	handlers.Insert(&key, handler.Ptr());
+	handlers.Insert(handler->Name(), handler.Ptr());
 	}
 
 EventHandler* EventRegistry::Lookup(const char* name)
 	{
-	HashKey key(name);
-	return handlers.Lookup(&key);
+	return handlers.Lookup(name);
 	}
 
 EventRegistry::string_list* EventRegistry::Match(RE_Matcher* pattern)
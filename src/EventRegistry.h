@@ -11,7 +11,9 @@
 // The registry keeps track of all events that we provide or handle.
 class EventRegistry {
 public:
-	EventRegistry()		{ }
+	// Event names come from the loaded scripts and plugins, never
+	// from traffic, so they can go by the fast hash.
+	EventRegistry() : handlers(UNORDERED, 0, HASH_FAST)	{ }
 	~EventRegistry()	{ }
 
 	void Register(EventHandlerPtr handler);
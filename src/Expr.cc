@@ -247,6 +247,26 @@ Val* NameExpr::Eval(Frame* f) const
 		}
 	}
 
+Val* NameExpr::EvalBorrowed(Frame* f, bool* borrowed) const
+	{
+	Val* v = 0;
+
+	if ( ! id->AsType() )
+		{
+		if ( id->IsGlobal() )
+			v = id->ID_Val();
+		else if ( f )
+			v = f->NthElement(id->Offset());
+		}
+
+	if ( ! v )
+		// Let Eval() take care of types and errors.
+		return Expr::EvalBorrowed(f, borrowed);
+
+	*borrowed = true;
+	return v;
+	}
+
 Expr* NameExpr::MakeLvalue()
 	{
 	if ( id->AsType() )
@@ -447,14 +467,25 @@ Val* BinaryExpr::Eval(Frame* f) const
 	if ( IsError() )
 		return 0;
 
-	Val* v1 = op1->Eval(f);
+	// The first operand's value may only be borrowed if evaluating
+	// the second one can't change it; the second's always can be.
+	bool borrowed1 = false;
+	bool borrowed2 = false;
+	Val* v1;
+
+	if ( op2->Tag() == EXPR_NAME || op2->Tag() == EXPR_CONST )
+		v1 = op1->EvalBorrowed(f, &borrowed1);
+	else
+		v1 = op1->Eval(f);
+
 	if ( ! v1 )
 		return 0;
 
-	Val* v2 = op2->Eval(f);
+	Val* v2 = op2->EvalBorrowed(f, &borrowed2);
 	if ( ! v2 )
 		{
-		Unref(v1);
+		if ( ! borrowed1 )
+			Unref(v1);
 		return 0;
 		}
 
@@ -487,8 +518,10 @@ Val* BinaryExpr::Eval(Frame* f) const
 			// SetError("undefined element in vector operation");
 			}
 
-		Unref(v1);
-		Unref(v2);
+		if ( ! borrowed1 )
+			Unref(v1);
+		if ( ! borrowed2 )
+			Unref(v2);
 		return v_result;
 		}
 
@@ -510,16 +543,20 @@ Val* BinaryExpr::Eval(Frame* f) const
 			// SetError("Undefined element in vector operation");
 			}
 
-		Unref(v1);
-		Unref(v2);
+		if ( ! borrowed1 )
+			Unref(v1);
+		if ( ! borrowed2 )
+			Unref(v2);
 		return v_result;
 		}
 
 	// scalar op scalar
 	result = Fold(v1, v2);
 
-	Unref(v1);
-	Unref(v2);
+	if ( ! borrowed1 )
+		Unref(v1);
+	if ( ! borrowed2 )
+		Unref(v2);
 	return result;
 	}
 
@@ -2924,6 +2961,65 @@ void FieldExpr::Delete(Frame* f)
 	Assign(f, 0);
 	}
 
+Val* FieldExpr::Eval(Frame* f) const
+	{
+	if ( IsError() )
+		return 0;
+
+	// The operand is always a record, so we can skip the checks for
+	// vector operands that UnaryExpr::Eval() does.
+	bool borrowed;
+	Val* v = op->EvalBorrowed(f, &borrowed);
+
+	if ( ! v )
+		return 0;
+
+	Val* result = Fold(v);
+
+	if ( ! borrowed )
+		Unref(v);
+
+	return result;
+	}
+
+Val* FieldExpr::EvalBorrowed(Frame* f, bool* borrowed) const
+	{
+	if ( IsError() )
+		{
+		*borrowed = false;
+		return 0;
+		}
+
+	bool op_borrowed;
+	Val* v = op->EvalBorrowed(f, &op_borrowed);
+
+	if ( ! v )
+		{
+		*borrowed = false;
+		return 0;
+		}
+
+	if ( op_borrowed )
+		{
+		// The field lives as long as the borrowed record does.
+		Val* result = v->AsRecordVal()->Lookup(field);
+
+		if ( result )
+			{
+			*borrowed = true;
+			return result;
+			}
+		}
+
+	*borrowed = false;
+	Val* result = Fold(v);
+
+	if ( ! op_borrowed )
+		Unref(v);
+
+	return result;
+	}
+
 Val* FieldExpr::Fold(Val* v) const
 	{
 	Val* result = v->AsRecordVal()->Lookup(field);
@@ -2986,20 +3082,34 @@ HasFieldExpr::~HasFieldExpr()
 	delete field_name;
 	}
 
-Val* HasFieldExpr::Fold(Val* v) const
+Val* HasFieldExpr::Eval(Frame* f) const
 	{
-	RecordVal* rec_to_look_at;
+	if ( IsError() )
+		return 0;
 
-	rec_to_look_at = v->AsRecordVal();
+	// As for FieldExpr, the operand is always a record.
+	bool borrowed;
+	Val* v = op->EvalBorrowed(f, &borrowed);
+
+	if ( ! v )
+		return 0;
+
+	Val* result = Fold(v);
+
+	if ( ! borrowed )
+		Unref(v);
+
+	return result;
+	}
+
+Val* HasFieldExpr::Fold(Val* v) const
+	{
+	RecordVal* rec_to_look_at = v->AsRecordVal();
 
 	if ( ! rec_to_look_at )
 		return val_mgr->GetBool(0);
 
-	RecordVal* r = rec_to_look_at->Ref()->AsRecordVal();
-	Val* ret = val_mgr->GetBool(r->Lookup(field) != 0);
-	Unref(r);
-
-	return ret;
+	return val_mgr->GetBool(rec_to_look_at->Lookup(field) != 0);
 	}
 
 void HasFieldExpr::ExprDescribe(ODesc* d) const
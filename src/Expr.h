@@ -78,6 +78,19 @@ public:
 	// or nil if the expression's value isn't fixed.
 	virtual Val* Eval(Frame* f) const = 0;
 
+	// Same, but expressions that merely read a value stored elsewhere
+	// (names, constants, and fields of those) may return it without
+	// taking a reference, in which case they set *borrowed to true.
+	// Such a value stays valid only until its storage gets modified,
+	// so callers must not evaluate anything else before they are done
+	// with it.  Otherwise, *borrowed is false and the caller owns the
+	// reference, as with Eval().
+	virtual Val* EvalBorrowed(Frame* f, bool* borrowed) const
+		{
+		*borrowed = false;
+		return Eval(f);
+		}
+
 	// Same, but the context is that we are adding an element
 	// into the given aggregate of the given type.  Note that
 	// return type is void since it's updating an existing
@@ -239,6 +252,7 @@ public:
 	ID* Id() const		{ return id; }
 
 	Val* Eval(Frame* f) const override;
+	Val* EvalBorrowed(Frame* f, bool* borrowed) const override;
 	void Assign(Frame* f, Val* v) override;
 	Expr* MakeLvalue() override;
 	int IsPure() const override;
@@ -263,6 +277,11 @@ public:
 	Val* Value() const	{ return val; }
 
 	Val* Eval(Frame* f) const override;
+	Val* EvalBorrowed(Frame* f, bool* borrowed) const override
+		{
+		*borrowed = true;
+		return val;
+		}
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
 
@@ -669,6 +688,9 @@ public:
 	int Field() const	{ return field; }
 	const char* FieldName() const	{ return field_name; }
 
+	Val* Eval(Frame* f) const override;
+	Val* EvalBorrowed(Frame* f, bool* borrowed) const override;
+
 	int CanDel() const override;
 
 	void Assign(Frame* f, Val* v) override;
@@ -698,6 +720,8 @@ public:
 
 	const char* FieldName() const	{ return field_name; }
 
+	Val* Eval(Frame* f) const override;
+
 protected:
 	friend class Expr;
 	HasFieldExpr()	{ field_name = 0; }
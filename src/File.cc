@@ -19,6 +19,12 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "File.h"
 #include "Type.h"
@@ -27,9 +33,198 @@
 #include "Net.h"
 #include "Event.h"
 #include "Reporter.h"
+#include "Var.h"
+#include "threading/Manager.h"
 
 std::list<std::pair<std::string, BroFile*>> BroFile::open_files;
 
+// With async_file_writes, data written to a file gets collected in
+// buffers that a writer thread, shared by all files, writes out. Whatever
+// needs the FILE itself on the main thread, like seeking or rotating,
+// first waits for the writer to finish with the file's buffers.
+
+// How long data may sit in a partially filled buffer of a fully buffered
+// file before the next write hands it to the writer.
+#define ASYNC_FLUSH_INTERVAL 1.0
+
+struct AsyncFileBuffer {
+	std::vector<char> data;
+	size_t len;
+	FILE* file;	// where the writer writes it
+	AsyncFileState* owner;
+};
+
+struct AsyncFileState {
+	// Options, copied from the script constants.
+	size_t buffer_size;
+	size_t max_buffers;
+	bool drop_when_full;
+
+	// Shared with the writer thread, protected by its mutex.
+	std::vector<AsyncFileBuffer*> free_buffers;
+	size_t num_buffers;
+	size_t pending;	// buffers queued or being written
+	std::atomic<int> error;	// errno of the first failed write, if any
+
+	// State of the main thread.
+	AsyncFileBuffer* cur;
+	double last_handoff;
+	uint64 dropped;
+};
+
+class AsyncFileWriter {
+public:
+	// Returns the writer, starting its thread on first use.
+	static AsyncFileWriter* Get();
+
+	// Stops the writer thread, once it's written everything queued.
+	static void Stop();
+
+	// Returns one of the file's free buffers, or a new one if it has
+	// fewer than its maximum. Otherwise, waits for one if wait is true,
+	// or returns nil.
+	AsyncFileBuffer* GetBuffer(AsyncFileState* s, bool wait);
+
+	// Queues a buffer for writing out.
+	void Submit(AsyncFileBuffer* b);
+
+	// Waits until all of the file's queued buffers are written.
+	void Wait(AsyncFileState* s);
+
+private:
+	AsyncFileWriter()	{ stopping = false; }
+
+	void Run();
+
+	std::mutex mutex;
+	std::condition_variable work;	// signals new buffers, or stopping
+	std::condition_variable done;	// signals buffers written
+	std::deque<AsyncFileBuffer*> queue;
+	bool stopping;
+
+	std::thread thread;
+
+	static AsyncFileWriter* writer;
+};
+
+AsyncFileWriter* AsyncFileWriter::writer = 0;
+
+AsyncFileWriter* AsyncFileWriter::Get()
+	{
+	if ( ! writer )
+		{
+		writer = new AsyncFileWriter();
+		writer->thread = std::thread(&AsyncFileWriter::Run, writer);
+		thread_mgr->PlaceThread(writer->thread);
+		}
+
+	return writer;
+	}
+
+void AsyncFileWriter::Stop()
+	{
+	if ( ! writer )
+		return;
+
+		{
+		std::lock_guard<std::mutex> lock(writer->mutex);
+		writer->stopping = true;
+		}
+
+	writer->work.notify_one();
+	writer->thread.join();
+
+	delete writer;
+	writer = 0;
+	}
+
+AsyncFileBuffer* AsyncFileWriter::GetBuffer(AsyncFileState* s, bool wait)
+	{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for ( ; ; )
+		{
+		if ( ! s->free_buffers.empty() )
+			{
+			AsyncFileBuffer* b = s->free_buffers.back();
+			s->free_buffers.pop_back();
+			return b;
+			}
+
+		if ( s->num_buffers < s->max_buffers )
+			{
+			++s->num_buffers;
+			lock.unlock();
+
+			AsyncFileBuffer* b = new AsyncFileBuffer;
+			b->data.resize(s->buffer_size);
+			b->len = 0;
+			b->file = 0;
+			b->owner = s;
+			return b;
+			}
+
+		if ( ! wait )
+			return 0;
+
+		done.wait(lock);
+		}
+	}
+
+void AsyncFileWriter::Submit(AsyncFileBuffer* b)
+	{
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		++b->owner->pending;
+		queue.push_back(b);
+		}
+
+	work.notify_one();
+	}
+
+void AsyncFileWriter::Wait(AsyncFileState* s)
+	{
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [s] { return s->pending == 0; });
+	}
+
+void AsyncFileWriter::Run()
+	{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for ( ; ; )
+		{
+		work.wait(lock, [this] { return stopping || ! queue.empty(); });
+
+		if ( queue.empty() )
+			break;
+
+		AsyncFileBuffer* b = queue.front();
+		queue.pop_front();
+		lock.unlock();
+
+		int err = 0;
+		errno = 0;
+
+		if ( fwrite(b->data.data(), 1, b->len, b->file) < b->len ||
+		     fflush(b->file) != 0 )
+			err = errno ? errno : EIO;
+
+		lock.lock();
+
+		AsyncFileState* s = b->owner;
+
+		if ( err && ! s->error )
+			s->error = err;
+
+		b->len = 0;
+		s->free_buffers.push_back(b);
+		--s->pending;
+
+		done.notify_all();
+		}
+	}
+
 // Maximizes the number of open file descriptors.
 static void maximize_num_fds()
 	{
@@ -144,6 +339,23 @@ bool BroFile::Open(FILE* file, const char* mode)
 	is_open = 1;
 	open_files.emplace_back(std::make_pair(name, this));
 
+	// Rotation reopens the file with its state kept.
+	if ( ! async && opt_internal_int("async_file_writes") )
+		{
+		async = new AsyncFileState();
+		async->buffer_size = std::max(bro_int_t(MIN_BUFFER_SIZE),
+					opt_internal_int("async_file_buffer_size"));
+		async->max_buffers = std::max(bro_int_t(1),
+					opt_internal_int("async_file_max_buffers"));
+		async->drop_when_full = opt_internal_int("async_file_drop_when_full");
+		async->num_buffers = 0;
+		async->pending = 0;
+		async->error = 0;
+		async->cur = 0;
+		async->last_handoff = network_time;
+		async->dropped = 0;
+		}
+
 	RaiseOpenEvent();
 
 	return true;
@@ -170,6 +382,7 @@ void BroFile::Init()
 	buffered = true;
 	print_hook = true;
 	raw_output = false;
+	async = 0;
 	t = 0;
 
 #ifdef USE_PERFTOOLS_DEBUG
@@ -187,6 +400,9 @@ FILE* BroFile::Seek(long new_position)
 	if ( ! File() )
 		return 0;
 
+	if ( async )
+		AsyncSync();
+
 	if ( fseek(f, new_position, SEEK_SET) < 0 )
 		reporter->Error("seek failed");
 
@@ -198,6 +414,9 @@ void BroFile::SetBuf(bool arg_buffered)
 	if ( ! f )
 		return;
 
+	if ( async )
+		AsyncSync();
+
 	if ( setvbuf(f, NULL, arg_buffered ? _IOFBF : _IOLBF, 0) != 0 )
 		reporter->Error("setvbuf failed");
 
@@ -216,6 +435,9 @@ int BroFile::Close()
 	if ( ! f )
 		return 0;
 
+	if ( async )
+		AsyncDone();
+
 	fclose(f);
 	f = nullptr;
 	open_time = is_open = 0;
@@ -289,6 +511,9 @@ RecordVal* BroFile::Rotate()
 
 	Unlink();
 
+	if ( async )
+		AsyncSync();
+
  	fclose(f);
 	f = 0;
 
@@ -304,6 +529,22 @@ void BroFile::CloseOpenFiles()
 		auto el = it++;
 		(*el).second->Close();
 		}
+
+	AsyncFileWriter::Stop();
+	}
+
+void BroFile::FlushOpenFiles()
+	{
+	for ( const auto& el : open_files )
+		el.second->Flush();
+	}
+
+void BroFile::Flush()
+	{
+	if ( async )
+		AsyncSync();
+	else
+		fflush(f);
 	}
 
 int BroFile::Write(const char* data, int len)
@@ -314,6 +555,9 @@ int BroFile::Write(const char* data, int len)
 	if ( ! len )
 		len = strlen(data);
 
+	if ( async )
+		return AsyncWrite(data, len);
+
 	if ( fwrite(data, len, 1, f) < 1 )
 		return false;
 
@@ -330,8 +574,105 @@ void BroFile::RaiseOpenEvent()
 	mgr.Dispatch(event, true);
 	}
 
+bool BroFile::AsyncWrite(const char* data, int len)
+	{
+	if ( async->error )
+		{
+		errno = async->error;
+		return false;
+		}
+
+	AsyncFileWriter* writer = AsyncFileWriter::Get();
+	AsyncFileBuffer* b = async->cur;
+
+	if ( b && b->len + len > b->data.size() )
+		{
+		AsyncHandOff();
+		b = 0;
+		}
+
+	if ( ! b )
+		{
+		b = writer->GetBuffer(async, ! async->drop_when_full);
+
+		if ( ! b )
+			{
+			++async->dropped;
+			return true;
+			}
+
+		async->cur = b;
+		}
+
+	if ( size_t(len) > b->data.size() )
+		b->data.resize(len);
+
+	memcpy(b->data.data() + b->len, data, len);
+	b->len += len;
+
+	if ( ! buffered ||
+	     network_time - async->last_handoff >= ASYNC_FLUSH_INTERVAL )
+		{
+		// Only if that doesn't make the next write wait or drop.
+		AsyncFileBuffer* next = writer->GetBuffer(async, false);
+
+		if ( next )
+			{
+			AsyncHandOff();
+			async->cur = next;
+			}
+		}
+
+	return true;
+	}
+
+void BroFile::AsyncHandOff()
+	{
+	AsyncFileBuffer* b = async->cur;
+
+	if ( ! b || ! b->len )
+		return;
+
+	b->file = f;
+	async->cur = 0;
+	async->last_handoff = network_time;
+
+	AsyncFileWriter::Get()->Submit(b);
+	}
+
+void BroFile::AsyncSync()
+	{
+	AsyncHandOff();
+	AsyncFileWriter::Get()->Wait(async);
+	}
+
+void BroFile::AsyncDone()
+	{
+	AsyncSync();
+
+	if ( async->error )
+		reporter->Error("error writing to %s: %s", name,
+				strerror(async->error));
+
+	if ( async->dropped )
+		reporter->Warning("dropped %" PRIu64 " writes to %s as the asynchronous writer fell behind",
+				  async->dropped, name);
+
+	// All buffers are back after the sync.
+	delete async->cur;
+
+	for ( auto b : async->free_buffers )
+		delete b;
+
+	delete async;
+	async = 0;
+	}
+
 double BroFile::Size()
 	{
+	if ( async )
+		AsyncSync();
+
 	fflush(f);
 	struct stat s;
 	if ( fstat(fileno(f), &s) < 0 )
@@ -16,6 +16,7 @@
 # endif // NEED_KRB5_H
 
 class BroType;
+struct AsyncFileState;
 
 class BroFile : public BroObj {
 public:
@@ -29,7 +30,9 @@ public:
 	// Returns false if an error occured.
 	int Write(const char* data, int len = 0);
 
-	void Flush()	{ fflush(f); }
+	// With async_file_writes, waits for everything written so far to
+	// reach the file.
+	void Flush();
 
 	FILE* Seek(long position);	// seek to absolute position
 
@@ -60,6 +63,9 @@ public:
 	// Close all files which are currently open.
 	static void CloseOpenFiles();
 
+	// Flush all files which are currently open.
+	static void FlushOpenFiles();
+
 	// Get the file with the given name, opening it if it doesn't yet exist.
 	static BroFile* GetFile(const char* name);
 
@@ -90,6 +96,14 @@ protected:
 	// Raises a file_opened event.
 	void RaiseOpenEvent();
 
+	// With async_file_writes: queues data for the writer thread, hands
+	// the current buffer to it, waits for it to write everything handed
+	// to it, and releases the buffers once the file gets closed.
+	bool AsyncWrite(const char* data, int len);
+	void AsyncHandOff();
+	void AsyncSync();
+	void AsyncDone();
+
 	FILE* f;
 	BroType* t;
 	char* name;
@@ -100,6 +114,7 @@ protected:
 	double open_time;
 	bool print_hook;
 	bool raw_output;
+	AsyncFileState* async;	// nil if writing synchronously
 
 	static const int MIN_BUFFER_SIZE = 1024;
 
@@ -6,12 +6,12 @@
 #include <fcntl.h>
 #include <errno.h>
 
-using namespace bro;
+#ifdef HAVE_LINUX
+#include <stdint.h>
+#include <sys/eventfd.h>
+#endif
 
-Flare::Flare()
-	: pipe(FD_CLOEXEC, FD_CLOEXEC, O_NONBLOCK, O_NONBLOCK)
-	{
-	}
+using namespace bro;
 
 static void bad_pipe_op(const char* which)
 	{
@@ -20,8 +20,113 @@ static void bad_pipe_op(const char* which)
 	reporter->FatalErrorWithCore("unexpected pipe %s failure: %s", which, buf);
 	}
 
+#ifdef HAVE_LINUX
+
+Flare::Flare()
+	: fired(std::make_shared<std::atomic<bool>>(false))
+	{
+	fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	if ( fd < 0 )
+		bad_pipe_op("eventfd");
+	}
+
+Flare::Flare(const Flare& other)
+	: fired(other.fired)
+	{
+	fd = fcntl(other.fd, F_DUPFD_CLOEXEC, 0);
+
+	if ( fd < 0 )
+		bad_pipe_op("dup");
+	}
+
+Flare& Flare::operator=(const Flare& other)
+	{
+	if ( this == &other )
+		return *this;
+
+	close(fd);
+	fd = fcntl(other.fd, F_DUPFD_CLOEXEC, 0);
+
+	if ( fd < 0 )
+		bad_pipe_op("dup");
+
+	fired = other.fired;
+	return *this;
+	}
+
+Flare::~Flare()
+	{
+	close(fd);
+	}
+
+void Flare::Fire()
+	{
+	// Already lit: the consumer hasn't extinguished the flare yet, and
+	// will look for what we signal once it has.
+	if ( fired->exchange(true) )
+		return;
+
+	uint64_t one = 1;
+
+	for ( ; ; )
+		{
+		int n = write(fd, &one, sizeof(one));
+
+		if ( n == sizeof(one) )
+			break;
+
+		if ( n < 0 )
+			{
+			if ( errno == EAGAIN )
+				// The counter is about to overflow, so it's
+				// certainly nonzero.
+				break;
+
+			if ( errno == EINTR )
+				continue;
+
+			bad_pipe_op("write");
+			}
+		}
+	}
+
+void Flare::Extinguish()
+	{
+	uint64_t tmp;
+
+	for ( ; ; )
+		{
+		// A single read resets the counter.
+		int n = read(fd, &tmp, sizeof(tmp));
+
+		if ( n >= 0 || errno == EAGAIN )
+			break;
+
+		if ( errno == EINTR )
+			continue;
+
+		bad_pipe_op("read");
+		}
+
+	// Only now, so that a Fire() in between doesn't get lost with the
+	// counter we just reset; it'll be taken care of by our caller.
+	fired->store(false);
+	}
+
+#else
+
+Flare::Flare()
+	: pipe(FD_CLOEXEC, FD_CLOEXEC, O_NONBLOCK, O_NONBLOCK),
+	  fired(std::make_shared<std::atomic<bool>>(false))
+	{
+	}
+
 void Flare::Fire()
 	{
+	if ( fired->exchange(true) )
+		return;
+
 	char tmp = 0;
 
 	for ( ; ; )
@@ -71,4 +176,8 @@ void Flare::Extinguish()
 
 		bad_pipe_op("read");
 		}
+
+	fired->store(false);
 	}
+
+#endif
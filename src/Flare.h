@@ -3,6 +3,10 @@
 #ifndef BRO_FLARE_H
 #define BRO_FLARE_H
 
+#include <atomic>
+#include <memory>
+
+#include "zeek-config.h"
 #include "Pipe.h"
 
 namespace bro {
@@ -13,20 +17,35 @@ public:
 	/**
 	 * Create a flare object that can be used to signal a "ready" status via
 	 * a file descriptor that may be integrated with select(), poll(), etc.
-	 * Not thread-safe, but that should only require Fire()/Extinguish() calls
-	 * to be made mutually exclusive (across all copies of a Flare).
+	 * Fire() may be called from any thread at any time. Extinguish() calls
+	 * must be made mutually exclusive (across all copies of a Flare), and
+	 * the caller has to look for whatever the flare signals only after
+	 * Extinguish() returns.
+	 *
+	 * On Linux, the flare is an eventfd rather than a pipe.
 	 */
 	Flare();
 
+#ifdef HAVE_LINUX
+	Flare(const Flare& other);
+	Flare& operator=(const Flare& other);
+	~Flare();
+#endif
+
 	/**
 	 * @return a file descriptor that will become ready if the flare has been
 	 *         Fire()'d and not yet Extinguished()'d.
 	 */
 	int FD() const
+#ifdef HAVE_LINUX
+		{ return fd; }
+#else
 		{ return pipe.ReadFD(); }
+#endif
 
 	/**
-	 * Put the object in the "ready" state.
+	 * Put the object in the "ready" state. Only the first call after an
+	 * Extinguish() makes a system call.
 	 */
 	void Fire();
 
@@ -36,7 +55,14 @@ public:
 	void Extinguish();
 
 private:
+#ifdef HAVE_LINUX
+	int fd;
+#else
 	Pipe pipe;
+#endif
+
+	// Whether the flare is lit, shared by all copies.
+	std::shared_ptr<std::atomic<bool>> fired;
 };
 
 } // namespace bro
@@ -0,0 +1,196 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "FlowAccounting.h"
+#include "Conn.h"
+#include "NetVar.h"
+#include "Reporter.h"
+#include "Scope.h"
+#include "Var.h"
+#include "logging/Manager.h"
+
+// The table starts out with this many slots, doubling whenever it gets
+// half full.
+#define INITIAL_SLOTS 1024
+
+// How many slots each packet checks for expired flows.
+#define SWEEP_SLOTS 4
+
+FlowAccounting::FlowAccounting() : flows(INITIAL_SLOTS)
+	{
+	sweep_pos = 0;
+	log_id = 0;
+	info_type = 0;
+
+	idle_timeout = opt_internal_double("flow_accounting_idle_timeout");
+	active_timeout = opt_internal_double("flow_accounting_active_timeout");
+
+	Val* v = opt_internal_val("flow_accounting_analyze");
+	analyze = v ? v->AsTableVal() : 0;
+
+	if ( ! opt_internal_int("flow_accounting") )
+		return;
+
+	ID* info = lookup_ID("Info", "Flow");
+	bro_int_t stream = internal_type("Log::ID")->AsEnumType()->Lookup("Flow", "LOG");
+
+	if ( ! info || ! info->AsType() || stream < 0 )
+		{
+		reporter->Error("flow_accounting needs the Flow::LOG stream of policy/misc/flow-accounting");
+		Unref(info);
+		return;
+		}
+
+	info_type = info->AsType()->AsRecordType();
+	Unref(info);
+
+	log_id = new EnumVal(stream, internal_type("Log::ID")->AsEnumType());
+	}
+
+FlowAccounting::~FlowAccounting()
+	{
+	Unref(log_id);
+	}
+
+bool FlowAccounting::Account(double t, const ConnID& id, const ConnIDKey& key,
+				hash_t hash, int proto, uint32 len)
+	{
+	Sweep(t);
+
+	uint32 slot = flows.Find(hash, key);
+	Flow* f;
+
+	if ( slot != flows.NumSlots() )
+		f = &flows[slot];
+	else
+		{
+		f = flows.Insert(hash);
+		f->key = key;
+		f->hash = hash;
+		f->used = true;
+		f->proto = proto;
+		f->analyze = WantAnalysis(id);
+		f->orig_is_1 = (IPAddr(key.ip1) == id.src_addr &&
+				key.port1 == id.src_port);
+		}
+
+	f->last_time = t;
+
+	if ( f->analyze )
+		return false;
+
+	if ( f->first_time == 0 )
+		f->first_time = t;
+
+	bool is_1 = (IPAddr(key.ip1) == id.src_addr && key.port1 == id.src_port);
+	int is_orig = (is_1 == f->orig_is_1);
+
+	++f->pkts[is_orig];
+	f->bytes[is_orig] += len;
+
+	return true;
+	}
+
+void FlowAccounting::Flush()
+	{
+	for ( uint32 i = 0; i < flows.NumSlots(); ++i )
+		if ( flows[i].used && ! flows[i].analyze && flows[i].first_time )
+			Log(&flows[i]);
+
+	flows.Clear();
+	}
+
+void FlowAccounting::Sweep(double t)
+	{
+	if ( ! flows.Size() )
+		return;
+
+	for ( int n = 0; n < SWEEP_SLOTS; ++n )
+		{
+		Flow* f = &flows[sweep_pos];
+
+		if ( f->used )
+			{
+			if ( t - f->last_time > idle_timeout )
+				{
+				if ( ! f->analyze && f->first_time )
+					Log(f);
+
+				// Another flow may move into the slot; look
+				// at it again next time.
+				flows.Remove(sweep_pos);
+				continue;
+				}
+
+			if ( active_timeout > 0 && f->first_time &&
+			     t - f->first_time > active_timeout )
+				{
+				Log(f);
+				f->first_time = 0;
+				f->pkts[0] = f->pkts[1] = 0;
+				f->bytes[0] = f->bytes[1] = 0;
+				}
+			}
+
+		sweep_pos = (sweep_pos + 1) & flows.Mask();
+		}
+	}
+
+void FlowAccounting::Log(const Flow* f)
+	{
+	IPAddr orig_addr(f->orig_is_1 ? f->key.ip1 : f->key.ip2);
+	IPAddr resp_addr(f->orig_is_1 ? f->key.ip2 : f->key.ip1);
+	uint16 orig_port = f->orig_is_1 ? f->key.port1 : f->key.port2;
+	uint16 resp_port = f->orig_is_1 ? f->key.port2 : f->key.port1;
+
+	TransportProto tproto;
+
+	switch ( f->proto ) {
+	case IPPROTO_TCP:
+		tproto = TRANSPORT_TCP;
+		break;
+
+	case IPPROTO_UDP:
+		tproto = TRANSPORT_UDP;
+		break;
+
+	default:
+		tproto = TRANSPORT_ICMP;
+		break;
+	}
+
+	RecordVal* id_val = new RecordVal(conn_id);
+	id_val->Assign(0, new AddrVal(orig_addr));
+	id_val->Assign(1, val_mgr->GetPort(ntohs(orig_port), tproto));
+	id_val->Assign(2, new AddrVal(resp_addr));
+	id_val->Assign(3, val_mgr->GetPort(ntohs(resp_port), tproto));
+
+	RecordVal* r = new RecordVal(info_type);
+	r->Assign(0, new Val(f->first_time, TYPE_TIME));
+	r->Assign(1, id_val);
+	r->Assign(2, new EnumVal(tproto, transport_proto));
+	r->Assign(3, new Val(f->last_time - f->first_time, TYPE_INTERVAL));
+	r->Assign(4, val_mgr->GetCount(f->pkts[1]));
+	r->Assign(5, val_mgr->GetCount(f->bytes[1]));
+	r->Assign(6, val_mgr->GetCount(f->pkts[0]));
+	r->Assign(7, val_mgr->GetCount(f->bytes[0]));
+
+	log_mgr->Write(log_id, r);
+	Unref(r);
+	}
+
+bool FlowAccounting::WantAnalysis(const ConnID& id) const
+	{
+	if ( ! analyze || ! analyze->Size() )
+		return false;
+
+	AddrVal* src = new AddrVal(id.src_addr);
+	AddrVal* dst = new AddrVal(id.dst_addr);
+
+	bool want = analyze->Lookup(src, false) || analyze->Lookup(dst, false);
+
+	Unref(src);
+	Unref(dst);
+	return want;
+	}
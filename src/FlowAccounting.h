@@ -0,0 +1,82 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef flowaccounting_h
+#define flowaccounting_h
+
+#include <string.h>
+
+#include "IPAddr.h"
+#include "OpenTable.h"
+#include "util.h"
+
+class EnumVal;
+class RecordType;
+class TableVal;
+struct ConnID;
+
+// Keeps packet and byte counters per flow in place of connections, and
+// writes a record per flow to the Flow::LOG stream once it has been idle
+// for flow_accounting_idle_timeout, or active for longer than
+// flow_accounting_active_timeout. Flows with an endpoint in
+// flow_accounting_analyze instead get analyzed as connections as usual.
+//
+// The flows live in an OpenTable. Each packet checks a few slots for
+// expired flows, moving on round the table, so that timing out flows
+// doesn't need timers.
+class FlowAccounting {
+public:
+	FlowAccounting();
+	~FlowAccounting();
+
+	// False if flow accounting is off, or its log stream is missing.
+	int IsActive()	{ return log_id != 0; }
+
+	// Counts a packet of the flow with the given key, as built for
+	// the id, and hash. len is the length of the IP datagram. Returns
+	// false if the packet is to be analyzed as part of a connection
+	// instead.
+	bool Account(double t, const ConnID& id, const ConnIDKey& key,
+			hash_t hash, int proto, uint32 len);
+
+	// Logs and removes all flows.
+	void Flush();
+
+	int Size() const	{ return flows.Size(); }
+
+protected:
+	struct Flow {
+		ConnIDKey key;
+		hash_t hash;
+		double first_time;	// 0 if no packet since the last record
+		double last_time;
+		uint64 pkts[2];		// indexed by is_orig
+		uint64 bytes[2];
+		uint8 proto;
+		bool used;
+		bool analyze;	// handed over to connections
+		bool orig_is_1;	// key's first endpoint is the originator
+
+		bool Used() const	{ return used; }
+		hash_t Hash() const	{ return hash; }
+		bool Matches(const ConnIDKey& k) const
+			{ return memcmp(&key, &k, sizeof(key)) == 0; }
+	};
+
+	// Checks the next few slots for flows that have timed out.
+	void Sweep(double t);
+
+	void Log(const Flow* f);
+
+	bool WantAnalysis(const ConnID& id) const;
+
+	OpenTable<Flow> flows;
+	uint32 sweep_pos;
+
+	double idle_timeout;
+	double active_timeout;
+	TableVal* analyze;
+	EnumVal* log_id;
+	RecordType* info_type;
+};
+
+#endif
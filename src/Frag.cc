@@ -32,6 +32,7 @@ FragReassembler::FragReassembler(NetSessions* arg_s,
 	{
 	s = arg_s;
 	key = k;
+	older = newer = 0;
 
 	const struct ip* ip4 = ip->IP4_Hdr();
 	if ( ip4 )
@@ -300,12 +301,7 @@ void FragReassembler::BlockInserted(DataBlock* /* start_block */)
 
 void FragReassembler::Expire(double t)
 	{
-	while ( blocks )
-		{
-		DataBlock* b = blocks->next;
-		delete blocks;
-		blocks = b;
-		}
+	ClearBlocks();
 
 	expire_timer->ClearReassembler();
 	expire_timer = 0;	// timer manager will delete it
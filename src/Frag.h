@@ -12,6 +12,13 @@
 class HashKey;
 class NetSessions;
 
+// The key of a datagram's fragments in the session table.
+struct FragKey {
+	in6_addr src;
+	in6_addr dst;
+	uint32 id;
+};
+
 class FragReassembler;
 class FragTimer;
 
@@ -37,6 +44,9 @@ protected:
 	void Overlap(const u_char* b1, const u_char* b2, uint64 n) override;
 	void Weird(const char* name) const;
 
+	// for keeping track of the order of reassemblers
+	friend class NetSessions;
+
 	u_char* proto_hdr;
 	IP_Hdr* reassembled_pkt;
 	uint16 proto_hdr_len;
@@ -46,6 +56,9 @@ protected:
 	HashKey* key;
 
 	FragTimer* expire_timer;
+
+	FragReassembler* older;
+	FragReassembler* newer;
 };
 
 class FragTimer : public Timer {
@@ -3,16 +3,66 @@
 #include "zeek-config.h"
 
 #include "Frame.h"
+#include "FreeList.h"
 #include "Stmt.h"
 #include "Func.h"
 #include "Trigger.h"
 
 vector<Frame*> g_frame_stack;
 
+// Upper bound on the number of freed frames we hang on to.
+#define FRAME_POOL_MAX 1024
+
+// Slot arrays up to this size get pooled, per size, with at most
+// FRAME_POOL_MAX arrays of each.
+#define FRAME_ARRAY_POOL_MAX_SIZE 32
+
+static FreeList<FRAME_POOL_MAX> frame_pool;
+static FreeList<FRAME_POOL_MAX> array_pool[FRAME_ARRAY_POOL_MAX_SIZE + 1];
+
+static Val** alloc_slots(int size)
+	{
+	if ( size > 0 && size <= FRAME_ARRAY_POOL_MAX_SIZE )
+		{
+		if ( void* a = array_pool[size].Get() )
+			return static_cast<Val**>(a);
+		}
+
+	return new Val*[size];
+	}
+
+static void free_slots(Val** slots, int size)
+	{
+	if ( size > 0 && size <= FRAME_ARRAY_POOL_MAX_SIZE &&
+	     array_pool[size].Put(slots) )
+		return;
+
+	delete [] slots;
+	}
+
+void* Frame::operator new(size_t size)
+	{
+	if ( size == sizeof(Frame) )
+		{
+		if ( void* f = frame_pool.Get() )
+			return f;
+		}
+
+	return ::operator new(size);
+	}
+
+void Frame::operator delete(void* ptr, size_t size)
+	{
+	if ( size == sizeof(Frame) && frame_pool.Put(ptr) )
+		return;
+
+	::operator delete(ptr);
+	}
+
 Frame::Frame(int arg_size, const BroFunc* func, const val_list* fn_args)
 	{
 	size = arg_size;
-	frame = new Val*[size];
+	frame = alloc_slots(size);
 	function = func;
 	func_args = fn_args;
 
@@ -47,7 +97,7 @@ void Frame::Release()
 	for ( int i = 0; i < size; ++i )
 		Unref(frame[i]);
 
-	delete [] frame;
+	free_slots(frame, size);
 	}
 
 void Frame::Describe(ODesc* d) const
@@ -29,6 +29,11 @@ public:
 
 	void Describe(ODesc* d) const override;
 
+	// Every script function call creates a frame, so the memory of
+	// freed ones is kept around for reuse, as are their slot arrays.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	// For which function is this stack frame.
 	const BroFunc* GetFunction() const	{ return function; }
 	const val_list* GetFuncArgs() const	{ return func_args; }
@@ -0,0 +1,54 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef freelist_h
+#define freelist_h
+
+// A pool of freed memory blocks of one size, for classes that recycle
+// their objects through their operator new/delete. The blocks are
+// chained through their first bytes, so they must be at least the size
+// of a pointer. The pool hangs on to at most MAX blocks. It isn't
+// thread-safe.
+//
+// Instances have constant initialization, so that objects getting
+// created during static initialization elsewhere can use them.
+template<int MAX>
+class FreeList {
+public:
+	// Returns a block from the pool, or nil if it's empty.
+	void* Get()
+		{
+		if ( ! head )
+			return 0;
+
+		Block* b = head;
+		head = b->next;
+		--size;
+		return b;
+		}
+
+	// Adds the block to the pool. Returns false if the pool is full,
+	// in which case the caller needs to free the block itself.
+	bool Put(void* p)
+		{
+		if ( size >= MAX )
+			return false;
+
+		Block* b = static_cast<Block*>(p);
+		b->next = head;
+		head = b;
+		++size;
+		return true;
+		}
+
+	int Size() const	{ return size; }
+
+private:
+	struct Block {
+		Block* next;
+	};
+
+	Block* head = nullptr;
+	int size = 0;
+};
+
+#endif
@@ -44,6 +44,7 @@
 #include "Event.h"
 #include "Traverse.h"
 #include "Reporter.h"
+#include "Probes.h"
 #include "plugin/Manager.h"
 
 extern	RETSIGTYPE sig_handler(int signo);
@@ -54,6 +55,30 @@ bool did_builtin_init = false;
 vector<Func*> Func::unique_ids;
 static const std::pair<bool, Val*> empty_hook_result(false, NULL);
 
+// Fires the function probes around a call, even if the function throws.
+class FunctionProbe {
+public:
+	explicit FunctionProbe(const Func* arg_func)
+		{
+		func = arg_func;
+
+#ifdef USE_USDT
+		const Location* loc = func->GetLocationInfo();
+
+		if ( func->GetKind() == Func::BUILTIN_FUNC || ! loc->filename )
+			ZEEK_PROBE3(function__entry, func->Name(), "", 0);
+		else
+			ZEEK_PROBE3(function__entry, func->Name(), loc->filename,
+				    loc->first_line);
+#endif
+		}
+
+	~FunctionProbe()	{ ZEEK_PROBE1(function__return, func->Name()); }
+
+private:
+	const Func* func;
+};
+
 std::string render_call_stack()
 	{
 	std::string rval;
@@ -318,6 +343,8 @@ Val* BroFunc::Call(val_list* args, Frame* parent) const
 	g_frame_stack.push_back(f);	// used for backtracing
 	const CallExpr* call_expr = parent ? parent->GetCall() : nullptr;
 	call_stack.emplace_back(CallInfo{call_expr, this, args});
+	ScriptProfiler::Call profiler_call(this);
+	FunctionProbe probe(this);
 
 	if ( g_trace_state.DoTrace() )
 		{
@@ -330,6 +357,8 @@ Val* BroFunc::Call(val_list* args, Frame* parent) const
 
 	stmt_flow_type flow = FLOW_NEXT;
 	Val* result = 0;
+	bool is_event = Flavor() == FUNC_FLAVOR_EVENT;
+	bool time_bodies = is_event && event_handler_timing;
 
 	for ( size_t i = 0; i < bodies.size(); ++i )
 		{
@@ -337,6 +366,9 @@ Val* BroFunc::Call(val_list* args, Frame* parent) const
 			sample_logger->LocationSeen(
 				bodies[i].stmts->GetLocationInfo());
 
+		if ( is_event )
+			++bodies[i].calls;
+
 		Unref(result);
 
 		loop_over_list(*args, j)
@@ -354,6 +386,9 @@ Val* BroFunc::Call(val_list* args, Frame* parent) const
 
 		f->Reset(args->length());
 
+		uint64 start = time_bodies ? read_cycles() : 0;
+		bool failed = false;
+
 		try
 			{
 			result = bodies[i].stmts->Exec(f, flow);
@@ -365,9 +400,21 @@ Val* BroFunc::Call(val_list* args, Frame* parent) const
 			if ( Flavor() == FUNC_FLAVOR_FUNCTION )
 				throw;
 
+			failed = true;
+			}
+
+		if ( time_bodies )
+			{
+			uint64 cycles = read_cycles() - start;
+			bodies[i].cycles += cycles;
+
+			if ( cycles > bodies[i].max_cycles )
+				bodies[i].max_cycles = cycles;
+			}
+
+		if ( failed )
 			// Continue exec'ing remaining bodies of hooks/events.
 			continue;
-			}
 
 		if ( f->HasDelayed() )
 			{
@@ -537,7 +584,14 @@ Val* BuiltinFunc::Call(val_list* args, Frame* parent) const
 
 	const CallExpr* call_expr = parent ? parent->GetCall() : nullptr;
 	call_stack.emplace_back(CallInfo{call_expr, this, args});
-	Val* result = func(parent, args);
+	Val* result;
+
+		{
+		ScriptProfiler::Call profiler_call(this);
+		FunctionProbe probe(this);
+		result = func(parent, args);
+		}
+
 	call_stack.pop_back();
 
 	loop_over_list(*args, i)
@@ -656,7 +710,22 @@ void init_builtin_funcs()
 	FileAnalysisStats = internal_type("FileAnalysisStats")->AsRecordType();
 	ThreadStats = internal_type("ThreadStats")->AsRecordType();
 	BrokerStats = internal_type("BrokerStats")->AsRecordType();
+	BrokerTopicStats = internal_type("BrokerTopicStats")->AsRecordType();
+	BrokerTopicStatsTable = internal_type("BrokerTopicStatsTable")->AsTableType();
+	BrokerQueueStats = internal_type("BrokerQueueStats")->AsRecordType();
 	ReporterStats = internal_type("ReporterStats")->AsRecordType();
+	DictStats = internal_type("DictStats")->AsRecordType();
+	AnalyzerStats = internal_type("AnalyzerStats")->AsRecordType();
+	AnalyzerStatsTable = internal_type("AnalyzerStatsTable")->AsTableType();
+	EventHandlerStats = internal_type("EventHandlerStats")->AsRecordType();
+	EventHandlerBodyStats = internal_type("EventHandlerBodyStats")->AsRecordType();
+	EventHandlerBodyStatsVector = internal_type("EventHandlerBodyStatsVector")->AsVectorType();
+	EventHandlerStatsTable = internal_type("EventHandlerStatsTable")->AsTableType();
+	LatencyStats = internal_type("LatencyStats")->AsRecordType();
+	LatencyStatsTable = internal_type("LatencyStatsTable")->AsTableType();
+	GlobalMemoryStats = internal_type("GlobalMemoryStats")->AsRecordType();
+	GlobalMemoryStatsTable = internal_type("GlobalMemoryStatsTable")->AsTableType();
+	MemoryStats = internal_type("MemoryStats")->AsRecordType();
 
 	var_sizes = internal_type("var_sizes")->AsTableType();
 
@@ -32,6 +32,13 @@ public:
 	struct Body {
 		Stmt* stmts;
 		int priority;
+
+		// Usage counters, maintained for event handler bodies. The
+		// cycles are only measured if event_handler_timing is set.
+		mutable uint64 calls = 0;
+		mutable uint64 cycles = 0;
+		mutable uint64 max_cycles = 0;
+
 		bool operator<(const Body& other) const
 			{ return priority > other.priority; } // reverse sort
 	};
@@ -0,0 +1,95 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <float.h>
+#include <string.h>
+
+#include "HalfOpen.h"
+#include "NetVar.h"
+#include "Var.h"
+
+// The table starts out with this many slots, doubling whenever it gets
+// half full.
+#define INITIAL_SLOTS 1024
+
+HalfOpenTable::HalfOpenTable() : entries(INITIAL_SLOTS)
+	{
+	active = opt_internal_int("tcp_half_open_state");
+	max_entries = opt_internal_int("tcp_max_half_open");
+	attempt_delay = tcp_attempt_delay;
+	}
+
+bool HalfOpenTable::Insert(double t, const ConnIDKey& key, hash_t hash,
+				const Packet* pkt)
+	{
+	if ( pkt->cap_len > MAX_FRAME || uint32(entries.Size()) >= max_entries )
+		return false;
+
+	Entry* e = entries.Insert(hash);
+	e->key = key;
+	e->hash = hash;
+	e->time = t;
+	e->ts = pkt->ts;
+	e->link_type = pkt->link_type;
+	e->len = pkt->len;
+	e->cap_len = pkt->cap_len;
+	memcpy(e->frame, pkt->data, pkt->cap_len);
+	e->used = true;
+
+	Pending p;
+	p.key = key;
+	p.hash = hash;
+	p.time = t;
+	pending.push_back(p);
+
+	return true;
+	}
+
+bool HalfOpenTable::Take(const ConnIDKey& key, hash_t hash, Entry* e)
+	{
+	uint32 slot = entries.Find(hash, key);
+
+	if ( slot == entries.NumSlots() )
+		return false;
+
+	Remove(slot, e);
+	return true;
+	}
+
+bool HalfOpenTable::TakeExpired(double t, Entry* e)
+	{
+	return TakeOldest(t - attempt_delay, e);
+	}
+
+bool HalfOpenTable::TakeAny(Entry* e)
+	{
+	return TakeOldest(DBL_MAX, e);
+	}
+
+bool HalfOpenTable::TakeOldest(double before, Entry* e)
+	{
+	while ( ! pending.empty() && pending.front().time <= before )
+		{
+		Pending p = pending.front();
+		pending.pop_front();
+
+		// The queue still has those that got taken otherwise since,
+		// and the flow may have come back with a new SYN.
+		uint32 slot = entries.Find(p.hash, p.key);
+
+		if ( slot != entries.NumSlots() && entries[slot].time == p.time )
+			{
+			Remove(slot, e);
+			return true;
+			}
+		}
+
+	return false;
+	}
+
+void HalfOpenTable::Remove(uint32 slot, Entry* e)
+	{
+	*e = entries[slot];
+	entries.Remove(slot);
+	}
@@ -0,0 +1,95 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef halfopen_h
+#define halfopen_h
+
+#include <string.h>
+
+#include <deque>
+
+#include "IPAddr.h"
+#include "OpenTable.h"
+#include "util.h"
+#include "iosource/Packet.h"
+
+// Keeps initial TCP SYNs that nothing has answered yet in place of full
+// connections, with tcp_half_open_state. Scans send lots of those that
+// never go anywhere, and a connection with its analyzer tree, endpoints
+// and timers is a lot of state to set up for each of them just to report
+// the attempt.
+//
+// An entry holds a copy of the captured SYN frame. Once another packet of
+// the flow shows up, or tcp_attempt_delay has passed, the sessions feed
+// that copy through the usual path as if it had just arrived with its
+// original timestamp, and take it from there.
+//
+// The entries live in an OpenTable. As they come in over time, a queue of
+// their keys takes care of timing them out in order.
+class HalfOpenTable {
+public:
+	// The largest SYN frame we keep. Leaves room for link layer,
+	// IPv6 and the usual TCP options.
+	static const uint32 MAX_FRAME = 128;
+
+	struct Entry {
+		ConnIDKey key;
+		hash_t hash;
+		double time;
+		pkt_timeval ts;
+		uint32 link_type;
+		uint32 len;
+		uint32 cap_len;
+		u_char frame[MAX_FRAME];
+		bool used;
+
+		bool Used() const	{ return used; }
+		hash_t Hash() const	{ return hash; }
+		bool Matches(const ConnIDKey& k) const
+			{ return memcmp(&key, &k, sizeof(key)) == 0; }
+	};
+
+	HalfOpenTable();
+
+	// False if tcp_half_open_state is off.
+	int IsActive()	{ return active; }
+
+	// Takes the SYN in pkt, which opens the flow with the given key and
+	// hash. Returns false if it's too large or the table full, in which
+	// case it's up to the caller to set up a connection.
+	bool Insert(double t, const ConnIDKey& key, hash_t hash,
+			const Packet* pkt);
+
+	// If there's an entry for the flow, copies it into e, removes it,
+	// and returns true.
+	bool Take(const ConnIDKey& key, hash_t hash, Entry* e);
+
+	// Same for the oldest entry that has been waiting for an answer
+	// since before t - tcp_attempt_delay, if any.
+	bool TakeExpired(double t, Entry* e);
+
+	// Same for any entry.
+	bool TakeAny(Entry* e);
+
+	int Size() const	{ return entries.Size(); }
+
+protected:
+	struct Pending {
+		ConnIDKey key;
+		hash_t hash;
+		double time;
+	};
+
+	// Takes the oldest entry if it's from no later than before.
+	bool TakeOldest(double before, Entry* e);
+
+	// Copies the entry in the given slot into e and removes it.
+	void Remove(uint32 slot, Entry* e);
+
+	OpenTable<Entry> entries;
+	std::deque<Pending> pending;	// oldest first
+	bool active;
+	uint32 max_entries;
+	double attempt_delay;
+};
+
+#endif
@@ -14,6 +14,9 @@
 // length. MD5 is used as a scrambling scheme so that it is difficult
 // for the adversary to construct conflicts, though I do not know if
 // HMAC/MD5 is provably universal.
+//
+// 3) Dictionaries of keys that adversaries don't get to pick can ask for
+// HASH_FAST instead, which is wyhash without a secret seed.
 
 #include "zeek-config.h"
 
@@ -21,6 +24,7 @@
 #include "Reporter.h"
 
 #include "siphash24.h"
+#include "wyhash.h"
 
 void init_hash_function()
 	{
@@ -29,30 +33,33 @@ void init_hash_function()
 		reporter->InternalError("Zeek's hash functions aren't fully initialized");
 	}
 
-HashKey::HashKey(bro_int_t i)
+HashKey::HashKey(bro_int_t i, HashPolicy arg_policy)
 	{
 	key_u.i = i;
 	key = (void*) &key_u;
 	size = sizeof(i);
-	hash = HashBytes(key, size);
+	policy = arg_policy;
+	hash = HashBytes(key, size, policy);
 	is_our_dynamic = 0;
 	}
 
-HashKey::HashKey(bro_uint_t u)
+HashKey::HashKey(bro_uint_t u, HashPolicy arg_policy)
 	{
 	key_u.i = bro_int_t(u);
 	key = (void*) &key_u;
 	size = sizeof(u);
-	hash = HashBytes(key, size);
+	policy = arg_policy;
+	hash = HashBytes(key, size, policy);
 	is_our_dynamic = 0;
 	}
 
-HashKey::HashKey(uint32 u)
+HashKey::HashKey(uint32 u, HashPolicy arg_policy)
 	{
 	key_u.u32 = u;
 	key = (void*) &key_u;
 	size = sizeof(u);
-	hash = HashBytes(key, size);
+	policy = arg_policy;
+	hash = HashBytes(key, size, policy);
 	is_our_dynamic = 0;
 	}
 
@@ -60,11 +67,12 @@ HashKey::HashKey(const uint32 u[], int n)
 	{
 	size = n * sizeof(u[0]);
 	key = (void*) u;
+	policy = HASH_KEYED;
 	hash = HashBytes(key, size);
 	is_our_dynamic = 0;
 	}
 
-HashKey::HashKey(double d)
+HashKey::HashKey(double d, HashPolicy arg_policy)
 	{
 	union {
 		double d;
@@ -74,7 +82,8 @@ HashKey::HashKey(double d)
 	key_u.d = u.d = d;
 	key = (void*) &key_u;
 	size = sizeof(d);
-	hash = HashBytes(key, size);
+	policy = arg_policy;
+	hash = HashBytes(key, size, policy);
 	is_our_dynamic = 0;
 	}
 
@@ -83,27 +92,31 @@ HashKey::HashKey(const void* p)
 	key_u.p = p;
 	key = (void*) &key_u;
 	size = sizeof(p);
+	policy = HASH_KEYED;
 	hash = HashBytes(key, size);
 	is_our_dynamic = 0;
 	}
 
-HashKey::HashKey(const char* s)
+HashKey::HashKey(const char* s, HashPolicy arg_policy)
 	{
 	size = strlen(s);	// note - skip final \0
 	key = (void*) s;
-	hash = HashBytes(key, size);
+	policy = arg_policy;
+	hash = HashBytes(key, size, policy);
 	is_our_dynamic = 0;
 	}
 
-HashKey::HashKey(const BroString* s)
+HashKey::HashKey(const BroString* s, HashPolicy arg_policy)
 	{
 	size = s->Len();
 	key = (void*) s->Bytes();
-	hash = HashBytes(key, size);
+	policy = arg_policy;
+	hash = HashBytes(key, size, policy);
 	is_our_dynamic = 0;
 	}
 
-HashKey::HashKey(int copy_key, void* arg_key, int arg_size)
+HashKey::HashKey(int copy_key, void* arg_key, int arg_size,
+		HashPolicy arg_policy)
 	{
 	size = arg_size;
 	is_our_dynamic = 1;
@@ -116,13 +129,16 @@ HashKey::HashKey(int copy_key, void* arg_key, int arg_size)
 	else
 		key = arg_key;
 
-	hash = HashBytes(key, size);
+	policy = arg_policy;
+	hash = HashBytes(key, size, policy);
 	}
 
-HashKey::HashKey(const void* arg_key, int arg_size, hash_t arg_hash)
+HashKey::HashKey(const void* arg_key, int arg_size, hash_t arg_hash,
+		HashPolicy arg_policy)
 	{
 	size = arg_size;
 	hash = arg_hash;
+	policy = arg_policy;
 	key = CopyKey(arg_key, size);
 	is_our_dynamic = 1;
 	}
@@ -132,6 +148,7 @@ HashKey::HashKey(const void* arg_key, int arg_size, hash_t arg_hash,
 	{
 	size = arg_size;
 	hash = arg_hash;
+	policy = HASH_KEYED;
 	key = const_cast<void*>(arg_key);
 	is_our_dynamic = 0;
 	}
@@ -140,6 +157,7 @@ HashKey::HashKey(const void* bytes, int arg_size)
 	{
 	size = arg_size;
 	key = CopyKey(bytes, size);
+	policy = HASH_KEYED;
 	hash = HashBytes(key, size);
 	is_our_dynamic = 1;
 	}
@@ -177,3 +195,11 @@ hash_t HashKey::HashBytes(const void* bytes, int size)
 	hmac_md5(size, (const unsigned char*) bytes, (unsigned char*) digest);
 	return digest[0];
 	}
+
+hash_t HashKey::HashBytes(const void* bytes, int size, HashPolicy policy)
+	{
+	if ( policy == HASH_FAST )
+		return wyhash(bytes, size, 0);
+
+	return HashBytes(bytes, size);
+	}
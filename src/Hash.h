@@ -11,6 +11,19 @@
 
 typedef uint64 hash_t;
 
+// How a dictionary hashes its keys. Whoever sends the traffic must not be
+// able to make keys collide, so any dictionary that can get keys derived
+// from traffic, like connections and script-level tables, needs the keyed
+// hash. Dictionaries whose keys come only from the loaded scripts and
+// plugins, like the names of events and identifiers, can use a faster hash
+// without a key: those are trusted, as they could do worse than that.
+// Looking up traffic-derived values in such a dictionary is fine, since
+// they never go in.
+typedef enum {
+	HASH_KEYED,	// SipHash, HMAC/MD5 for long keys
+	HASH_FAST	// wyhash with a fixed seed
+} HashPolicy;
+
 typedef enum {
 	HASH_KEY_INT,
 	HASH_KEY_DOUBLE,
@@ -20,14 +33,14 @@ typedef enum {
 
 class HashKey {
 public:
-	explicit HashKey(bro_int_t i);
-	explicit HashKey(bro_uint_t u);
-	explicit HashKey(uint32 u);
+	explicit HashKey(bro_int_t i, HashPolicy policy = HASH_KEYED);
+	explicit HashKey(bro_uint_t u, HashPolicy policy = HASH_KEYED);
+	explicit HashKey(uint32 u, HashPolicy policy = HASH_KEYED);
 	HashKey(const uint32 u[], int n);
-	explicit HashKey(double d);
+	explicit HashKey(double d, HashPolicy policy = HASH_KEYED);
 	explicit HashKey(const void* p);
-	explicit HashKey(const char* s);
-	explicit HashKey(const BroString* s);
+	explicit HashKey(const char* s, HashPolicy policy = HASH_KEYED);
+	explicit HashKey(const BroString* s, HashPolicy policy = HASH_KEYED);
 	~HashKey()
 		{
 		if ( is_our_dynamic )
@@ -42,10 +55,13 @@ public:
 	// The calling sequence here is unusual (normally key would be
 	// first) to avoid possible ambiguities with the next constructor,
 	// which is the more commonly used one.
-	HashKey(int copy_key, void* key, int size);
+	HashKey(int copy_key, void* key, int size,
+		HashPolicy policy = HASH_KEYED);
 
-	// Same, but automatically copies the key.
-	HashKey(const void* key, int size, hash_t hash);
+	// Same, but automatically copies the key. The hash must be the one
+	// the given policy computes.
+	HashKey(const void* key, int size, hash_t hash,
+		HashPolicy policy = HASH_KEYED);
 
 	// Builds a key from the given chunk of bytes.
 	HashKey(const void* bytes, int size);
@@ -66,9 +82,18 @@ public:
 	int Size() const	{ return size; }
 	hash_t Hash() const	{ return hash; }
 
+	// The hash the key was built with.
+	HashPolicy Policy() const	{ return policy; }
+
+	// Returns the key's hash under the given policy, computing it if
+	// the key was built with another one.
+	hash_t Hash(HashPolicy p) const
+		{ return p == policy ? hash : HashBytes(key, size, p); }
+
 	unsigned int MemoryAllocation() const	{ return padded_sizeof(*this) + pad_size(size); }
 
 	static hash_t HashBytes(const void* bytes, int size);
+	static hash_t HashBytes(const void* bytes, int size, HashPolicy policy);
 protected:
 	void* CopyKey(const void* key, int size) const;
 
@@ -83,6 +108,7 @@ protected:
 	int is_our_dynamic;
 	int size;
 	hash_t hash;
+	HashPolicy policy;
 };
 
 extern void init_hash_function();
@@ -0,0 +1,135 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <mutex>
+#include <unordered_map>
+
+#include "HugePages.h"
+#include "Reporter.h"
+
+// Tables may get resized from threads other than the main one.
+static std::mutex huge_mutex;
+
+static uint64 huge_limit = 0;
+static uint64 huge_used = 0;
+
+// The mappings from mmap(), by address, with their lengths.
+static std::unordered_map<void*, size_t>* huge_regions = 0;
+
+void set_huge_page_limit(uint64 bytes)
+	{
+	std::lock_guard<std::mutex> lock(huge_mutex);
+	huge_limit = bytes;
+	}
+
+uint64 huge_page_usage()
+	{
+	std::lock_guard<std::mutex> lock(huge_mutex);
+	return huge_used;
+	}
+
+// Maps len bytes, a multiple of HUGE_PAGE_SIZE, preferably from reserved
+// huge pages, otherwise aligned such that transparent huge pages can back
+// them. Returns nil if that fails.
+static void* map_huge(size_t len)
+	{
+	void* p;
+
+#ifdef MAP_HUGETLB
+	p = mmap(0, len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+	if ( p != MAP_FAILED )
+		return p;
+#endif
+
+	// Map one page more, then trim to an aligned range.
+	p = mmap(0, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if ( p == MAP_FAILED )
+		return 0;
+
+	uintptr_t start = reinterpret_cast<uintptr_t>(p);
+	uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~uintptr_t(HUGE_PAGE_SIZE - 1);
+
+	if ( aligned > start )
+		munmap(p, aligned - start);
+
+	if ( aligned + len < start + len + HUGE_PAGE_SIZE )
+		munmap(reinterpret_cast<void*>(aligned + len),
+		       start + HUGE_PAGE_SIZE - aligned);
+
+	p = reinterpret_cast<void*>(aligned);
+
+#ifdef MADV_HUGEPAGE
+	// Just a hint; without it, we still get the alignment.
+	madvise(p, len, MADV_HUGEPAGE);
+#endif
+
+	return p;
+	}
+
+void* huge_alloc(size_t size, size_t align)
+	{
+	if ( size >= HUGE_PAGE_SIZE )
+		{
+		size_t len = (size + HUGE_PAGE_SIZE - 1) & ~size_t(HUGE_PAGE_SIZE - 1);
+
+		std::lock_guard<std::mutex> lock(huge_mutex);
+
+		if ( huge_used + len <= huge_limit )
+			{
+			void* p = map_huge(len);
+
+			if ( p )
+				{
+				if ( ! huge_regions )
+					huge_regions = new std::unordered_map<void*, size_t>();
+
+				(*huge_regions)[p] = len;
+				huge_used += len;
+				return p;
+				}
+			}
+		}
+
+	if ( align < sizeof(void*) )
+		align = sizeof(void*);
+
+	void* p;
+
+	if ( posix_memalign(&p, align, size ? size : 1) != 0 )
+		out_of_memory("allocating an array");
+
+	return p;
+	}
+
+void huge_free(void* p)
+	{
+	if ( ! p )
+		return;
+
+	std::unique_lock<std::mutex> lock(huge_mutex);
+
+	if ( huge_regions )
+		{
+		auto i = huge_regions->find(p);
+
+		if ( i != huge_regions->end() )
+			{
+			munmap(p, i->second);
+			huge_used -= i->second;
+			huge_regions->erase(i);
+			return;
+			}
+		}
+
+	lock.unlock();
+	free(p);
+	}
@@ -0,0 +1,69 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Allocation of large, long-lived arrays, such as the bucket arrays of
+// big tables, backed by 2 MB huge pages where possible. Walking such an
+// array at random then takes far fewer TLB misses. Smaller allocations,
+// and all of them once huge_page_memory is used up or if the kernel
+// doesn't cooperate, come from malloc() as usual.
+
+#ifndef hugepages_h
+#define hugepages_h
+
+#include <stddef.h>
+
+#include <type_traits>
+
+#include "util.h"
+
+// The size of a huge page, and the smallest allocation that gets them.
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Sets how much memory may be backed by huge pages. Zero, the default,
+// turns them off.
+extern void set_huge_page_limit(uint64 bytes);
+
+// Returns how much memory huge_alloc() got backed by huge pages.
+extern uint64 huge_page_usage();
+
+// Allocates uninitialized memory, aligned to at least align bytes (a power
+// of two). Never returns nil.
+extern void* huge_alloc(size_t size, size_t align = 16);
+
+// Releases memory from huge_alloc(); nil is fine.
+extern void huge_free(void* p);
+
+// Allocates an uninitialized array of n elements.
+template<typename T>
+inline T* huge_new_array(size_t n)
+	{
+	static_assert(std::is_trivial<T>::value, "huge arrays skip constructors");
+	return static_cast<T*>(huge_alloc(n * sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+	}
+
+// An allocator for STL containers, such as a vector that may grow large.
+template<typename T>
+class HugePageAllocator {
+public:
+	typedef T value_type;
+
+	HugePageAllocator()	{ }
+
+	template<typename U>
+	HugePageAllocator(const HugePageAllocator<U>&)	{ }
+
+	T* allocate(size_t n)
+		{ return static_cast<T*>(huge_alloc(n * sizeof(T))); }
+
+	void deallocate(T* p, size_t)
+		{ huge_free(p); }
+};
+
+template<typename T, typename U>
+inline bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&)
+	{ return true; }
+
+template<typename T, typename U>
+inline bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&)
+	{ return false; }
+
+#endif
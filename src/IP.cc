@@ -29,6 +29,8 @@ static RecordType* ip6_mob_cot_type = 0;
 static RecordType* ip6_mob_bu_type = 0;
 static RecordType* ip6_mob_back_type = 0;
 static RecordType* ip6_mob_be_type = 0;
+static VectorType* ip6_options_type = 0;
+static VectorType* ip6_ext_hdr_chain_type = 0;
 
 static inline RecordType* hdrType(RecordType*& type, const char* name)
 	{
@@ -38,9 +40,17 @@ static inline RecordType* hdrType(RecordType*& type, const char* name)
 	return type;
 	}
 
+static inline VectorType* vecType(VectorType*& type, const char* name)
+	{
+	if ( ! type )
+		type = internal_type(name)->AsVectorType();
+
+	return type;
+	}
+
 static VectorVal* BuildOptionsVal(const u_char* data, int len)
 	{
-	VectorVal* vv = new VectorVal(internal_type("ip6_options")->AsVectorType());
+	VectorVal* vv = new VectorVal(vecType(ip6_options_type, "ip6_options"));
 
 	while ( len > 0 )
 		{
@@ -90,8 +100,8 @@ RecordVal* IPv6_Hdr::BuildRecordVal(VectorVal* chain) const
 		rv->Assign(5, new AddrVal(IPAddr(ip6->ip6_src)));
 		rv->Assign(6, new AddrVal(IPAddr(ip6->ip6_dst)));
 		if ( ! chain )
-			chain = new VectorVal(
-			    internal_type("ip6_ext_hdr_chain")->AsVectorType());
+			chain = new VectorVal(vecType(ip6_ext_hdr_chain_type,
+						      "ip6_ext_hdr_chain"));
 		rv->Assign(7, chain);
 		}
 		break;
@@ -467,26 +477,29 @@ void IPv6_Hdr_Chain::Init(const struct ip6_hdr* ip6, int total_len,
 		if ( total_len < 2 )
 			return;
 
+		if ( num_hdrs == MAX_HDRS )
+			{
+			reporter->Weird(SrcAddr(), DstAddr(), "excessive_IPv6_ext_hdrs");
+			return;
+			}
+
 		current_type = next_type;
-		IPv6_Hdr* p = new IPv6_Hdr(current_type, hdrs);
+		IPv6_Hdr p(current_type, hdrs);
 
-		next_type = p->NextHdr();
-		uint16 cur_len = p->Length();
+		next_type = p.NextHdr();
+		uint16 cur_len = p.Length();
 
 		// If this header is truncated, don't add it to chain, don't go further.
 		if ( cur_len > total_len )
-			{
-			delete p;
 			return;
-			}
 
 		if ( set_next && next_type == IPPROTO_FRAGMENT )
 			{
-			p->ChangeNext(next);
+			p.ChangeNext(next);
 			next_type = next;
 			}
 
-		chain.push_back(p);
+		chain[num_hdrs++] = p;
 
 		// Check for routing headers and remember final destination address.
 		if ( current_type == IPPROTO_ROUTING )
@@ -512,7 +525,7 @@ void IPv6_Hdr_Chain::Init(const struct ip6_hdr* ip6, int total_len,
 
 void IPv6_Hdr_Chain::ProcessRoutingHeader(const struct ip6_rthdr* r, uint16 len)
 	{
-	if ( finalDst )
+	if ( has_final_dst )
 		{
 		// RFC 2460 section 4.1 says Routing should occur at most once.
 		reporter->Weird(SrcAddr(), DstAddr(), "multiple_routing_headers");
@@ -528,7 +541,10 @@ void IPv6_Hdr_Chain::ProcessRoutingHeader(const struct ip6_rthdr* r, uint16 len)
 		if ( r->ip6r_segleft > 0 && r->ip6r_len >= 2 )
 			{
 			if ( r->ip6r_len % 2 == 0 )
-				finalDst = new IPAddr(*addr);
+				{
+				finalDst = IPAddr(*addr);
+				has_final_dst = true;
+				}
 			else
 				reporter->Weird(SrcAddr(), DstAddr(), "odd_routing0_len");
 			}
@@ -544,7 +560,10 @@ void IPv6_Hdr_Chain::ProcessRoutingHeader(const struct ip6_rthdr* r, uint16 len)
 		if ( r->ip6r_segleft > 0 )
 			{
 			if ( r->ip6r_len == 2 )
-				finalDst = new IPAddr(*addr);
+				{
+				finalDst = IPAddr(*addr);
+				has_final_dst = true;
+				}
 			else
 				reporter->Weird(SrcAddr(), DstAddr(), "bad_routing2_len");
 			}
@@ -572,10 +591,13 @@ void IPv6_Hdr_Chain::ProcessDstOpts(const struct ip6_dest* d, uint16 len)
 		case 201: // Home Address Option, Mobile IPv6 RFC 6275 section 6.3
 			{
 			if ( opt->ip6o_len == 16 )
-				if ( homeAddr )
+				if ( has_home_addr )
 					reporter->Weird(SrcAddr(), DstAddr(), "multiple_home_addr_opts");
 				else
-					homeAddr = new IPAddr(*((const in6_addr*)(data + 2)));
+					{
+					homeAddr = IPAddr(*((const in6_addr*)(data + 2)));
+					has_home_addr = true;
+					}
 			else
 				reporter->Weird(SrcAddr(), DstAddr(), "bad_home_addr_len");
 			}
@@ -613,14 +635,14 @@ VectorVal* IPv6_Hdr_Chain::BuildVal() const
 		ip6_mob_type = internal_type("ip6_mobility_hdr")->AsRecordType();
 		}
 
-	VectorVal* rval = new VectorVal(
-	    internal_type("ip6_ext_hdr_chain")->AsVectorType());
+	VectorVal* rval = new VectorVal(vecType(ip6_ext_hdr_chain_type,
+						"ip6_ext_hdr_chain"));
 
-	for ( size_t i = 1; i < chain.size(); ++i )
+	for ( size_t i = 1; i < num_hdrs; ++i )
 		{
-		RecordVal* v = chain[i]->BuildRecordVal();
+		RecordVal* v = chain[i].BuildRecordVal();
 		RecordVal* ext_hdr = new RecordVal(ip6_ext_hdr_type);
-		uint8 type = chain[i]->Type();
+		uint8 type = chain[i].Type();
 		ext_hdr->Assign(0, val_mgr->GetCount(type));
 
 		switch (type) {
@@ -681,14 +703,14 @@ IPv6_Hdr_Chain* IPv6_Hdr_Chain::Copy(const ip6_hdr* new_hdr) const
 	rval->length = length;
 
 #ifdef ENABLE_MOBILE_IPV6
-	if ( homeAddr )
-		rval->homeAddr = new IPAddr(*homeAddr);
+	rval->homeAddr = homeAddr;
+	rval->has_home_addr = has_home_addr;
 #endif
 
-	if ( finalDst )
-		rval->finalDst = new IPAddr(*finalDst);
+	rval->finalDst = finalDst;
+	rval->has_final_dst = has_final_dst;
 
-	if ( chain.empty() )
+	if ( num_hdrs == 0 )
 		{
 		reporter->InternalWarning("empty IPv6 header chain");
 		delete rval;
@@ -696,13 +718,15 @@ IPv6_Hdr_Chain* IPv6_Hdr_Chain::Copy(const ip6_hdr* new_hdr) const
 		}
 
 	const u_char* new_data = (const u_char*)new_hdr;
-	const u_char* old_data = chain[0]->Data();
+	const u_char* old_data = chain[0].Data();
 
-	for ( size_t i = 0; i < chain.size(); ++i )
+	for ( size_t i = 0; i < num_hdrs; ++i )
 		{
-		int off = chain[i]->Data() - old_data;
-		rval->chain.push_back(new IPv6_Hdr(chain[i]->Type(), new_data + off));
+		int off = chain[i].Data() - old_data;
+		rval->chain[i] = IPv6_Hdr(chain[i].Type(), new_data + off);
 		}
 
+	rval->num_hdrs = num_hdrs;
+
 	return rval;
 	}
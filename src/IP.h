@@ -39,6 +39,12 @@ public:
 	 */
 	IPv6_Hdr(uint8 t, const u_char* d) : type(t), data(d) {}
 
+	/**
+	 * Construct a placeholder to be assigned to later.  It's left
+	 * uninitialized, as a chain only looks at the entries it has filled.
+	 */
+	IPv6_Hdr() {}
+
 	/**
 	 * Replace the value of the next protocol field.
 	 */
@@ -142,20 +148,18 @@ public:
 	 * Initializes the header chain from an IPv6 header structure.
 	 */
 	IPv6_Hdr_Chain(const struct ip6_hdr* ip6, int len) :
+		num_hdrs(0),
 #ifdef ENABLE_MOBILE_IPV6
-		homeAddr(0),
+		has_home_addr(false),
 #endif
-		finalDst(0)
+		has_final_dst(false)
 		{ Init(ip6, len, false); }
 
-	~IPv6_Hdr_Chain()
-		{
-		for ( size_t i = 0; i < chain.size(); ++i ) delete chain[i];
-#ifdef ENABLE_MOBILE_IPV6
-		delete homeAddr;
-#endif
-		delete finalDst;
-		}
+	/**
+	 * The most headers a chain holds, including the main IPv6 header.
+	 * Parsing stops at any further extension headers.
+	 */
+	static const size_t MAX_HDRS = 16;
 
 	/**
 	 * @return a copy of the header chain, but with pointers to individual
@@ -166,7 +170,7 @@ public:
 	/**
 	 * Returns the number of headers in the chain.
 	 */
-	size_t Size() const { return chain.size(); }
+	size_t Size() const { return num_hdrs; }
 
 	/**
 	 * Returns the sum of the length of all headers in the chain in bytes.
@@ -176,20 +180,20 @@ public:
 	/**
 	 * Accesses the header at the given location in the chain.
 	 */
-	const IPv6_Hdr* operator[](const size_t i) const { return chain[i]; }
+	const IPv6_Hdr* operator[](const size_t i) const { return &chain[i]; }
 
 	/**
 	 * Returns whether the header chain indicates a fragmented packet.
 	 */
 	bool IsFragment() const
 		{
-		if ( chain.empty() )
+		if ( num_hdrs == 0 )
 			{
 			reporter->InternalWarning("empty IPv6 header chain");
 			return false;
 			}
 
-		return chain[chain.size()-1]->Type() == IPPROTO_FRAGMENT;
+		return chain[num_hdrs-1].Type() == IPPROTO_FRAGMENT;
 		}
 
 	/**
@@ -197,7 +201,7 @@ public:
 	 */
 	const struct ip6_frag* GetFragHdr() const
 		{ return IsFragment() ?
-				(const struct ip6_frag*)chain[chain.size()-1]->Data(): 0; }
+				(const struct ip6_frag*)chain[num_hdrs-1].Data(): 0; }
 
 	/**
 	 * If the header chain is a fragment, returns the offset in number of bytes
@@ -228,16 +232,16 @@ public:
 	IPAddr SrcAddr() const
 		{
 #ifdef ENABLE_MOBILE_IPV6
-		if ( homeAddr )
-			return IPAddr(*homeAddr);
+		if ( has_home_addr )
+			return homeAddr;
 #endif
-		if ( chain.empty() )
+		if ( num_hdrs == 0 )
 			{
 			reporter->InternalWarning("empty IPv6 header chain");
 			return IPAddr();
 			}
 
-		return IPAddr(((const struct ip6_hdr*)(chain[0]->Data()))->ip6_src);
+		return IPAddr(((const struct ip6_hdr*)(chain[0].Data()))->ip6_src);
 		}
 
 	/**
@@ -247,16 +251,16 @@ public:
 	 */
 	IPAddr DstAddr() const
 		{
-		if ( finalDst )
-			return IPAddr(*finalDst);
+		if ( has_final_dst )
+			return finalDst;
 
-		if ( chain.empty() )
+		if ( num_hdrs == 0 )
 			{
 			reporter->InternalWarning("empty IPv6 header chain");
 			return IPAddr();
 			}
 
-		return IPAddr(((const struct ip6_hdr*)(chain[0]->Data()))->ip6_dst);
+		return IPAddr(((const struct ip6_hdr*)(chain[0].Data()))->ip6_dst);
 		}
 
 	/**
@@ -270,12 +274,16 @@ protected:
 	// point to a fragment
 	friend class FragReassembler;
 
+	// for keeping a chain inline
+	friend class IP_Hdr;
+
 	IPv6_Hdr_Chain() :
+		num_hdrs(0),
 		length(0),
 #ifdef ENABLE_MOBILE_IPV6
-		homeAddr(0),
+		has_home_addr(false),
 #endif
-		finalDst(0)
+		has_final_dst(false)
 		{}
 
 	/**
@@ -283,10 +291,11 @@ protected:
 	 * the first next protocol pointer field that points to a fragment header.
 	 */
 	IPv6_Hdr_Chain(const struct ip6_hdr* ip6, uint16 next, int len) :
+		num_hdrs(0),
 #ifdef ENABLE_MOBILE_IPV6
-		homeAddr(0),
+		has_home_addr(false),
 #endif
-		finalDst(0)
+		has_final_dst(false)
 		{ Init(ip6, len, true, next); }
 
 	/**
@@ -298,7 +307,7 @@ protected:
 	          uint16 next = 0);
 
 	/**
-	 * Process a routing header and allocate/remember the final destination
+	 * Process a routing header and remember the final destination
 	 * address if it has segments left and is a valid routing header.
 	 */
 	void ProcessRoutingHeader(const struct ip6_rthdr* r, uint16 len);
@@ -311,7 +320,11 @@ protected:
 	void ProcessDstOpts(const struct ip6_dest* d, uint16 len);
 #endif
 
-	vector<IPv6_Hdr*> chain;
+	/**
+	 * The headers, kept inline so that parsing a packet doesn't allocate.
+	 */
+	IPv6_Hdr chain[MAX_HDRS];
+	size_t num_hdrs;
 
 	/**
 	 * The summation of all header lengths in the chain in bytes.
@@ -322,14 +335,16 @@ protected:
 	/**
 	 * Home Address of the packet's source as defined by Mobile IPv6 (RFC 6275).
 	 */
-	IPAddr* homeAddr;
+	IPAddr homeAddr;
+	bool has_home_addr;
 #endif
 
 	/**
 	 * The final destination address in chain's first Routing header that has
 	 * non-zero segments left.
 	 */
-	IPAddr* finalDst;
+	IPAddr finalDst;
+	bool has_final_dst;
 };
 
 /**
@@ -359,12 +374,31 @@ public:
 	 * @param arg_del whether to take ownership of \a arg_ip6 pointer's memory.
 	 * @param len the packet's length in bytes.
 	 * @param c an already-constructed header chain to take ownership of.
+	 * Without one, the chain gets parsed into the wrapper itself.
 	 */
 	IP_Hdr(const struct ip6_hdr* arg_ip6, bool arg_del, int len,
 	       const IPv6_Hdr_Chain* c = 0)
-		: ip4(0), ip6(arg_ip6), del(arg_del),
-		  ip6_hdrs(c ? c : new IPv6_Hdr_Chain(ip6, len))
+		: ip4(0), ip6(arg_ip6), del(arg_del), ip6_hdrs(c)
 		{
+		if ( ! c )
+			{
+			inline_hdrs.Init(ip6, len, false);
+			ip6_hdrs = &inline_hdrs;
+			}
+		}
+
+	/**
+	 * Copy a wrapper.  The copy refers to the same header data without
+	 * taking ownership of it, so it must not outlive the original.
+	 */
+	IP_Hdr(const IP_Hdr& other)
+		: ip4(other.ip4), ip6(other.ip6), del(false), ip6_hdrs(0)
+		{
+		if ( other.ip6_hdrs )
+			{
+			inline_hdrs = *other.ip6_hdrs;
+			ip6_hdrs = &inline_hdrs;
+			}
 		}
 
 	/**
@@ -379,7 +413,8 @@ public:
 	 */
 	~IP_Hdr()
 		{
-		delete ip6_hdrs;
+		if ( ip6_hdrs != &inline_hdrs )
+			delete ip6_hdrs;
 
 		if ( del )
 			{
@@ -585,6 +620,9 @@ private:
 	const struct ip6_hdr* ip6;
 	bool del;
 	const IPv6_Hdr_Chain* ip6_hdrs;
+	IPv6_Hdr_Chain inline_hdrs;
+
+	IP_Hdr& operator=(const IP_Hdr&);	// not implemented
 };
 
 #endif
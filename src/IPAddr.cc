@@ -14,15 +14,8 @@ const uint8_t IPAddr::v4_mapped_prefix[12] = { 0, 0, 0, 0,
                                                0, 0, 0, 0,
                                                0, 0, 0xff, 0xff };
 
-HashKey* BuildConnIDHashKey(const ConnID& id)
+void BuildConnIDKey(const ConnID& id, ConnIDKey* key)
 	{
-	struct {
-		in6_addr ip1;
-		in6_addr ip2;
-		uint16 port1;
-		uint16 port2;
-	} key;
-
 	// Lookup up connection based on canonical ordering, which is
 	// the smaller of <src addr, src port> and <dst addr, dst port>
 	// followed by the other.
@@ -30,19 +23,24 @@ HashKey* BuildConnIDHashKey(const ConnID& id)
 	     addr_port_canon_lt(id.src_addr, id.src_port, id.dst_addr, id.dst_port)
 	   )
 		{
-		key.ip1 = id.src_addr.in6;
-		key.ip2 = id.dst_addr.in6;
-		key.port1 = id.src_port;
-		key.port2 = id.dst_port;
+		key->ip1 = id.src_addr.in6;
+		key->ip2 = id.dst_addr.in6;
+		key->port1 = id.src_port;
+		key->port2 = id.dst_port;
 		}
 	else
 		{
-		key.ip1 = id.dst_addr.in6;
-		key.ip2 = id.src_addr.in6;
-		key.port1 = id.dst_port;
-		key.port2 = id.src_port;
+		key->ip1 = id.dst_addr.in6;
+		key->ip2 = id.src_addr.in6;
+		key->port1 = id.dst_port;
+		key->port2 = id.src_port;
 		}
+	}
 
+HashKey* BuildConnIDHashKey(const ConnID& id)
+	{
+	ConnIDKey key;
+	BuildConnIDKey(id, &key);
 	return new HashKey(&key, sizeof(key));
 	}
 
@@ -62,20 +60,17 @@ void IPAddr::Mask(int top_bits_to_keep)
 		return;
 		}
 
-	uint32_t mask_bits[4] = { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff };
-	std::ldiv_t res = std::ldiv(top_bits_to_keep, 32);
+	// Only the word with the boundary and those after it change.
+	uint32_t* p = reinterpret_cast<uint32_t*>(in6.s6_addr);
+	int word = top_bits_to_keep / 32;
 
-	if ( res.quot < 4 )
-		mask_bits[res.quot] =
-		        htonl(mask_bits[res.quot] & ~bit_mask32(32 - res.rem));
+	if ( word == 4 )
+		return;
 
-	for ( unsigned int i = res.quot + 1; i < 4; ++i )
-		mask_bits[i] = 0;
+	p[word] &= htonl(~bit_mask32(32 - top_bits_to_keep % 32));
 
-	uint32_t* p = reinterpret_cast<uint32_t*>(in6.s6_addr);
-
-	for ( unsigned int i = 0; i < 4; ++i )
-		p[i] &= mask_bits[i];
+	for ( int i = word + 1; i < 4; ++i )
+		p[i] = 0;
 	}
 
 void IPAddr::ReverseMask(int top_bits_to_chop)
@@ -86,19 +81,15 @@ void IPAddr::ReverseMask(int top_bits_to_chop)
 		return;
 		}
 
-	uint32_t mask_bits[4] = { 0, 0, 0, 0 };
-	std::ldiv_t res = std::ldiv(top_bits_to_chop, 32);
-
-	if ( res.quot < 4 )
-		mask_bits[res.quot] = htonl(bit_mask32(32 - res.rem));
-
-	for ( unsigned int i = res.quot + 1; i < 4; ++i )
-		mask_bits[i] = 0xffffffff;
-
+	// Only the word with the boundary and those before it change.
 	uint32_t* p = reinterpret_cast<uint32_t*>(in6.s6_addr);
+	int word = top_bits_to_chop / 32;
+
+	for ( int i = 0; i < word; ++i )
+		p[i] = 0;
 
-	for ( unsigned int i = 0; i < 4; ++i )
-		p[i] &= mask_bits[i];
+	if ( word < 4 )
+		p[word] &= htonl(bit_mask32(32 - top_bits_to_chop % 32));
 	}
 
 bool IPAddr::ConvertString(const char* s, in6_addr* result)
@@ -144,24 +135,31 @@ void IPAddr::Init(const char* s)
 
 string IPAddr::AsString() const
 	{
+	char s[MAX_STRING_LEN];
+	return string(s, AsString(s));
+	}
+
+int IPAddr::AsString(char* buf) const
+	{
+	const char* err;
+
 	if ( GetFamily() == IPv4 )
 		{
-		char s[INET_ADDRSTRLEN];
+		if ( bro_inet_ntop(AF_INET, &in6.s6_addr[12], buf, INET_ADDRSTRLEN) )
+			return strlen(buf);
 
-		if ( ! bro_inet_ntop(AF_INET, &in6.s6_addr[12], s, INET_ADDRSTRLEN) )
-			return "<bad IPv4 address conversion";
-		else
-			return s;
+		err = "<bad IPv4 address conversion";
 		}
 	else
 		{
-		char s[INET6_ADDRSTRLEN];
+		if ( bro_inet_ntop(AF_INET6, in6.s6_addr, buf, INET6_ADDRSTRLEN) )
+			return strlen(buf);
 
-		if ( ! bro_inet_ntop(AF_INET6, in6.s6_addr, s, INET6_ADDRSTRLEN) )
-			return "<bad IPv6 address conversion";
-		else
-			return s;
+		err = "<bad IPv6 address conversion";
 		}
+
+	strcpy(buf, err);
+	return strlen(err);
 	}
 
 string IPAddr::AsHexString() const
@@ -7,6 +7,10 @@
 #include <arpa/inet.h>
 #include <string>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "BroString.h"
 #include "Hash.h"
 #include "util.h"
@@ -14,6 +18,7 @@
 #include "threading/SerialTypes.h"
 
 struct ConnID;
+struct ConnIDKey;
 namespace analyzer { class ExpectedConn; }
 
 typedef in_addr in4_addr;
@@ -122,7 +127,13 @@ public:
 	 */
 	Family GetFamily() const
 		{
-		if ( memcmp(in6.s6_addr, v4_mapped_prefix, 12) == 0 )
+		// Same as comparing with v4_mapped_prefix, in two loads.
+		uint64_t top;
+		uint32_t mid;
+		memcpy(&top, in6.s6_addr, sizeof(top));
+		memcpy(&mid, &in6.s6_addr[8], sizeof(mid));
+
+		if ( top == 0 && mid == htonl(0xffff) )
 			return IPv4;
 		else
 			return IPv6;
@@ -235,6 +246,18 @@ public:
 		return new HashKey((void*)in6.s6_addr, sizeof(in6.s6_addr));
 		}
 
+	/**
+	 * Like GetHashKey(), but uses an already known hash of the address
+	 * rather than computing it again.
+	 *
+	 * @param hash The hash of the address, as returned by a previous
+	 * GetHashKey() call.
+	 */
+	HashKey* GetHashKey(hash_t hash) const
+		{
+		return new HashKey((void*)in6.s6_addr, sizeof(in6.s6_addr), hash);
+		}
+
 	/**
 	 * Masks out lower bits of the address.
 	 *
@@ -295,11 +318,45 @@ public:
 	 * IPv6 addresses are encased in square brackets.
 	 */
 	string AsURIString() const
+		{
+		char buf[MAX_STRING_LEN];
+		return string(buf, AsURIString(buf));
+		}
+
+	/**
+	 * The size of a buffer that can hold any result of AsString(char*)
+	 * and AsURIString(char*), including the terminating NUL.
+	 */
+	static const int MAX_STRING_LEN = INET6_ADDRSTRLEN + 2;
+
+	/**
+	 * Writes the same as AsString() returns into a buffer, for when
+	 * there's no need for a string object. That's quicker for IPv4
+	 * addresses in particular.
+	 *
+	 * @param buf The buffer, with room for MAX_STRING_LEN characters.
+	 *
+	 * @return The length of the result, without the terminating NUL.
+	 */
+	int AsString(char* buf) const;
+
+	/**
+	 * Writes the same as AsURIString() returns into a buffer.
+	 *
+	 * @param buf The buffer, with room for MAX_STRING_LEN characters.
+	 *
+	 * @return The length of the result, without the terminating NUL.
+	 */
+	int AsURIString(char* buf) const
 		{
 		if ( GetFamily() == IPv4 )
-			return AsString();
-		else
-			return string("[") + AsString() + "]";
+			return AsString(buf);
+
+		buf[0] = '[';
+		int n = AsString(buf + 1);
+		buf[n + 1] = ']';
+		buf[n + 2] = '\0';
+		return n + 2;
 		}
 
 	/**
@@ -324,7 +381,13 @@ public:
 	 */
 	friend bool operator==(const IPAddr& addr1, const IPAddr& addr2)
 		{
+#ifdef __SSE2__
+		__m128i a = _mm_loadu_si128((const __m128i*) addr1.in6.s6_addr);
+		__m128i b = _mm_loadu_si128((const __m128i*) addr2.in6.s6_addr);
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xffff;
+#else
 		return memcmp(&addr1.in6, &addr2.in6, sizeof(in6_addr)) == 0;
+#endif
 		}
 
 	friend bool operator!=(const IPAddr& addr1, const IPAddr& addr2)
@@ -339,7 +402,16 @@ public:
 	 */
 	friend bool operator<(const IPAddr& addr1, const IPAddr& addr2)
 		{
-		return memcmp(&addr1.in6, &addr2.in6, sizeof(in6_addr)) < 0;
+		// The same order as memcmp() gives, comparing the two halves
+		// as big-endian numbers.
+		uint64_t hi1 = BigEndian64(addr1.in6.s6_addr);
+		uint64_t hi2 = BigEndian64(addr2.in6.s6_addr);
+
+		if ( hi1 != hi2 )
+			return hi1 < hi2;
+
+		return BigEndian64(&addr1.in6.s6_addr[8]) <
+		       BigEndian64(&addr2.in6.s6_addr[8]);
 		}
 
 	friend bool operator<=(const IPAddr& addr1, const IPAddr& addr2)
@@ -363,6 +435,7 @@ public:
 	void ConvertToThreadingValue(threading::Value::addr_t* v) const;
 
 	friend HashKey* BuildConnIDHashKey(const ConnID& id);
+	friend void BuildConnIDKey(const ConnID& id, ConnIDKey* key);
 
 	unsigned int MemoryAllocation() const { return padded_sizeof(*this); }
 
@@ -400,6 +473,16 @@ private:
 	 */
 	void Init(const char* s);
 
+	// Reads eight bytes in network order. Compilers turn this into a
+	// load and a byte swap.
+	static uint64_t BigEndian64(const uint8_t* p)
+		{
+		return (uint64_t(p[0]) << 56) | (uint64_t(p[1]) << 48) |
+		       (uint64_t(p[2]) << 40) | (uint64_t(p[3]) << 32) |
+		       (uint64_t(p[4]) << 24) | (uint64_t(p[5]) << 16) |
+		       (uint64_t(p[6]) << 8) | uint64_t(p[7]);
+		}
+
 	in6_addr in6; // IPv6 or v4-to-v6-mapped address
 
 	static const uint8_t v4_mapped_prefix[12]; // top 96 bits of v4-mapped-addr
@@ -469,6 +552,22 @@ inline void IPAddr::ConvertToThreadingValue(threading::Value::addr_t* v) const
 	}
 	}
 
+/**
+ * The raw key of a connection in the session tables: the endpoints in
+ * canonical order, so that both directions map to the same key.
+ */
+struct ConnIDKey {
+	in6_addr ip1;
+	in6_addr ip2;
+	uint16 port1;
+	uint16 port2;
+};
+
+/**
+ * Fills in the key for a given ConnID, without allocating anything.
+ */
+void BuildConnIDKey(const ConnID& id, ConnIDKey* key);
+
 /**
   * Returns a hash key for a given ConnID. Passes ownership to caller.
   */
@@ -0,0 +1,141 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "LoadShedder.h"
+#include "Event.h"
+#include "Net.h"
+#include "NetVar.h"
+#include "Reporter.h"
+#include "Var.h"
+#include "iosource/Manager.h"
+
+static const char* level_names[] = {
+	"none", "analyzers", "headers", "sampling",
+};
+
+// Sums up the counters of all packet sources.
+static void get_pkt_src_stats(uint64* received, uint64* dropped)
+	{
+	*received = *dropped = 0;
+
+	for ( auto ps : iosource_mgr->GetPktSrcs() )
+		{
+		iosource::PktSrc::Stats s;
+		ps->Statistics(&s);
+		*received += s.received;
+		*dropped += s.dropped;
+		}
+	}
+
+LoadShedder::LoadShedder()
+	{
+	active = opt_internal_int("load_shedding");
+	level = LOAD_SHED_NONE;
+	interval = opt_internal_double("load_shedding_interval");
+	next_check = 0;
+
+	sample_rate = opt_internal_unsigned("load_shedding_sample_rate");
+
+	if ( sample_rate == 0 )
+		sample_rate = 1;
+
+	last_received = last_dropped = 0;
+	}
+
+void LoadShedder::Update(double t)
+	{
+	bool first = (next_check == 0);
+	next_check = t + interval;
+
+	if ( first )
+		{
+		// Just a baseline for the packet counters.
+		get_pkt_src_stats(&last_received, &last_dropped);
+		return;
+		}
+
+	bool relaxed;
+	const char* reason = Overloaded(t, &relaxed);
+
+	if ( reason )
+		{
+		if ( level < LOAD_SHED_SAMPLING )
+			SetLevel(LoadShedLevel(level + 1), reason);
+		}
+
+	else if ( relaxed && level > LOAD_SHED_NONE )
+		SetLevel(LoadShedLevel(level - 1), "load went down");
+	}
+
+const char* LoadShedder::Overloaded(double t, bool* relaxed)
+	{
+	const char* reason = 0;
+	*relaxed = true;
+
+	// These are options that may have changed since the last check.
+	double max_lag = opt_internal_double("load_shedding_max_lag");
+	double max_drop_rate = opt_internal_double("load_shedding_max_drop_rate");
+	uint64 max_memory = opt_internal_unsigned("load_shedding_max_memory");
+
+	if ( reading_live && max_lag > 0 )
+		{
+		double lag = current_time() - t;
+
+		if ( lag > max_lag )
+			reason = "processing lags behind";
+
+		if ( lag > max_lag / 2 )
+			*relaxed = false;
+		}
+
+	uint64 received, dropped;
+	get_pkt_src_stats(&received, &dropped);
+
+	uint64 new_received = received - last_received;
+	uint64 new_dropped = dropped - last_dropped;
+	last_received = received;
+	last_dropped = dropped;
+
+	if ( max_drop_rate > 0 && new_dropped )
+		{
+		double rate = double(new_dropped) / (new_received + new_dropped);
+
+		if ( rate > max_drop_rate && ! reason )
+			reason = "packets got dropped";
+
+		if ( rate > max_drop_rate / 2 )
+			*relaxed = false;
+		}
+
+	if ( max_memory )
+		{
+		// The peak resident size never goes down, so prefer what's
+		// allocated if we know it.
+		uint64 total, malloced = 0;
+		get_memory_usage(&total, &malloced);
+		uint64 mem = malloced ? malloced : total;
+
+		if ( mem > max_memory && ! reason )
+			reason = "memory use is high";
+
+		if ( mem > max_memory / 10 * 9 )
+			*relaxed = false;
+		}
+
+	return reason;
+	}
+
+void LoadShedder::SetLevel(LoadShedLevel new_level, const char* reason)
+	{
+	reporter->Info("load shedding level %s -> %s: %s",
+			level_names[level], level_names[new_level], reason);
+
+	level = new_level;
+
+	if ( load_shedding_level_change )
+		mgr.QueueEventFast(load_shedding_level_change, {
+			val_mgr->GetCount(level),
+			new StringVal(reason),
+		});
+	}
@@ -0,0 +1,70 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef loadshedder_h
+#define loadshedder_h
+
+#include "Hash.h"
+#include "util.h"
+
+// What new connections get while Zeek is overloaded. Each level includes
+// the ones before it.
+enum LoadShedLevel {
+	LOAD_SHED_NONE,		// everything as usual
+	LOAD_SHED_ANALYZERS,	// none of load_shedding_analyzers
+	LOAD_SHED_HEADERS,	// just the transport-layer analyzers
+	LOAD_SHED_SAMPLING,	// only one in load_shedding_sample_rate
+};
+
+// Watches for Zeek falling behind, and sheds load by degrading the
+// analysis of new connections step by step rather than leaving it to the
+// kernel to drop packets at random, which breaks up many connections at
+// once. Every load_shedding_interval of packet time, it checks how far
+// processing lags behind the packets' timestamps, what fraction of
+// packets the packet sources dropped, and how much memory is in use.
+// If any of them is above its limit, it moves up a level; once all are
+// below half of their limits (memory: 90%), it moves back down one. The
+// limits are script options, looked up at each check.
+class LoadShedder {
+public:
+	LoadShedder();
+
+	// False if load shedding is off.
+	int IsActive()	{ return active; }
+
+	// Called for each packet, with its timestamp.
+	void Check(double t)
+		{
+		if ( t >= next_check )
+			Update(t);
+		}
+
+	LoadShedLevel Level() const	{ return level; }
+
+	// Whether to analyze a new connection with the given hash.
+	bool Admit(hash_t hash) const
+		{
+		return level < LOAD_SHED_SAMPLING || hash % sample_rate == 0;
+		}
+
+protected:
+	void Update(double t);
+
+	// Returns what's over its limit, or nil. Sets *relaxed to whether
+	// everything is well below.
+	const char* Overloaded(double t, bool* relaxed);
+
+	void SetLevel(LoadShedLevel new_level, const char* reason);
+
+	bool active;
+	LoadShedLevel level;
+	double interval;
+	double next_check;
+
+	uint64 sample_rate;
+
+	// Packet source counters as of the last check.
+	uint64 last_received;
+	uint64 last_dropped;
+};
+
+#endif
@@ -0,0 +1,197 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "MemoryAccounting.h"
+
+#include "DFA.h"
+#include "ID.h"
+#include "Reassem.h"
+#include "Scope.h"
+#include "Sessions.h"
+#include "Val.h"
+#include "broker/Manager.h"
+
+// Elements sampled from top-level containers. Nested containers get a
+// quarter of their parent's samples, so that the work for a value stays
+// bounded however deeply its containers nest.
+#define MAX_SAMPLES 16
+
+// Containers nested deeper than this count as just their own object.
+#define MAX_DEPTH 4
+
+static uint64 estimate(const Val* v, int depth);
+
+static int num_samples(int depth)
+	{
+	int n = MAX_SAMPLES >> (2 * depth);
+	return n > 0 ? n : 1;
+	}
+
+static uint64 estimate_table(const TableVal* v, int depth)
+	{
+	const PDict(TableEntryVal)* d = v->AsTable();
+	int n = d->Length();
+	int max_samples = num_samples(depth);
+	int samples = 0;
+	uint64 key_bytes = 0;
+	uint64 entry_bytes = 0;
+
+	IterCookie* c = d->InitForIteration();
+	HashKey* k;
+	TableEntryVal* e = 0;
+
+	while ( samples < max_samples && (e = d->NextEntry(k, c)) )
+		{
+		key_bytes += k->Size();
+		delete k;
+
+		entry_bytes += padded_sizeof(TableEntryVal);
+
+		if ( e->Value() )
+			entry_bytes += estimate(e->Value(), depth + 1);
+
+		++samples;
+		}
+
+	if ( e )
+		// Stopped early, the cookie is still alive.
+		d->StopIteration(c);
+
+	uint64 size = padded_sizeof(*v);
+
+	if ( ! samples )
+		return size + d->MemoryAllocationEstimate(0);
+
+	size += d->MemoryAllocationEstimate(key_bytes / samples);
+	size += entry_bytes * n / samples;
+
+	return size;
+	}
+
+static uint64 estimate_vector(const VectorVal* v, int depth)
+	{
+	const vector<Val*>* vec = v->AsVector();
+	unsigned int n = vec->size();
+	unsigned int max_samples = num_samples(depth);
+	unsigned int samples = n < max_samples ? n : max_samples;
+	uint64 size = padded_sizeof(*v) + pad_size(vec->capacity() * sizeof(Val*));
+	uint64 elem_bytes = 0;
+
+	// Spread the samples across the vector.
+	for ( unsigned int i = 0; i < samples; ++i )
+		{
+		const Val* e = (*vec)[uint64(i) * n / samples];
+
+		if ( e )
+			elem_bytes += estimate(e, depth + 1);
+		}
+
+	if ( samples )
+		size += elem_bytes * n / samples;
+
+	return size;
+	}
+
+static uint64 estimate_record(const RecordVal* v, int depth)
+	{
+	const val_list* vl = v->AsRecord();
+	uint64 size = padded_sizeof(*v) + vl->MemoryAllocation();
+
+	loop_over_list(*vl, i)
+		{
+		const Val* f = (*vl)[i];
+
+		if ( f )
+			size += estimate(f, depth + 1);
+		}
+
+	return size;
+	}
+
+static uint64 estimate(const Val* v, int depth)
+	{
+	if ( depth > MAX_DEPTH )
+		return padded_sizeof(*v);
+
+	switch ( v->Type()->Tag() ) {
+	case TYPE_TABLE:
+		return estimate_table(v->AsTableVal(), depth);
+
+	case TYPE_VECTOR:
+		return estimate_vector(v->AsVectorVal(), depth);
+
+	case TYPE_RECORD:
+		return estimate_record(v->AsRecordVal(), depth);
+
+	default:
+		return v->MemoryAllocation();
+	}
+	}
+
+uint64 estimate_memory_allocation(const Val* v)
+	{
+	return estimate(v, 0);
+	}
+
+void get_subsystem_memory(subsystem_memory_list* usage)
+	{
+	usage->clear();
+
+	usage->push_back(std::make_pair("connections",
+		sessions ? sessions->MemoryAllocationEstimate() : 0));
+
+	static const char* reassem_names[] = { "file", "frag", "tcp", "unknown" };
+	static const ReassemblerType reassem_types[] = {
+		REASSEM_FILE, REASSEM_FRAG, REASSEM_TCP, REASSEM_UNKNOWN };
+
+	for ( int i = 0; i < 4; ++i )
+		usage->push_back(std::make_pair(
+			std::string("reassembly_") + reassem_names[i],
+			Reassembler::MemoryAllocation(reassem_types[i])));
+
+	usage->push_back(std::make_pair("dfa", DFA_State_Cache::TotalMemory()));
+
+	size_t log_bytes = 0;
+	size_t events = 0;
+
+	if ( broker_mgr )
+		broker_mgr->GetBufferedSizes(&log_bytes, &events);
+
+	usage->push_back(std::make_pair("broker_log_buffers", uint64(log_bytes)));
+	}
+
+void get_global_memory(std::vector<GlobalMemoryUsage>* usage)
+	{
+	usage->clear();
+
+	PDict(ID)* globals = global_scope()->Vars();
+	IterCookie* c = globals->InitForIteration();
+
+	ID* id;
+	while ( (id = globals->NextEntry(c)) )
+		{
+		if ( ! id->HasVal() )
+			continue;
+
+		const Val* v = id->ID_Val();
+		uint64 entries;
+
+		switch ( v->Type()->Tag() ) {
+		case TYPE_TABLE:
+			entries = v->AsTableVal()->Size();
+			break;
+
+		case TYPE_VECTOR:
+			entries = v->AsVectorVal()->Size();
+			break;
+
+		default:
+			continue;
+		}
+
+		GlobalMemoryUsage u;
+		u.id = id;
+		u.entries = entries;
+		u.bytes = estimate_memory_allocation(v);
+		usage->push_back(u);
+		}
+	}
@@ -0,0 +1,49 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Estimates of where memory goes, cheap enough to take regularly even
+// when the process has grown large.
+
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "util.h"
+
+class ID;
+class Val;
+
+/**
+ * Estimates the memory that a value uses, including what it references.
+ * Unlike Val::MemoryAllocation(), which visits all elements of containers,
+ * this extrapolates from a bounded sample of the elements of each
+ * container, so that its cost doesn't depend on their sizes.
+ */
+extern uint64 estimate_memory_allocation(const Val* v);
+
+/**
+ * The memory that subsystems use, as pairs of subsystem name and bytes.
+ * Most figures are maintained incrementally; the others are estimated
+ * in constant time.
+ */
+typedef std::vector<std::pair<std::string, uint64> > subsystem_memory_list;
+
+extern void get_subsystem_memory(subsystem_memory_list* usage);
+
+/**
+ * The estimated memory of a global table, set or vector.
+ */
+struct GlobalMemoryUsage {
+	const ID* id;
+	uint64 entries;	// number of elements
+	uint64 bytes;	// see estimate_memory_allocation()
+};
+
+/**
+ * Returns the memory usage of all global tables, sets and vectors.
+ */
+extern void get_global_memory(std::vector<GlobalMemoryUsage>* usage);
+
+#endif
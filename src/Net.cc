@@ -21,14 +21,18 @@
 
 #include "NetVar.h"
 #include "Sessions.h"
+#include "Conn.h"
 #include "Event.h"
 #include "Timer.h"
 #include "Var.h"
 #include "Reporter.h"
 #include "Net.h"
+#include "Probes.h"
+#include "StallDetector.h"
 #include "Anon.h"
 #include "PacketDumper.h"
 #include "iosource/Manager.h"
+#include "metrics/Manager.h"
 #include "iosource/PktSrc.h"
 #include "iosource/PktDumper.h"
 #include "plugin/Manager.h"
@@ -209,6 +213,9 @@ void net_init(name_list& interfaces, name_list& readfiles,
 
 	sessions = new NetSessions();
 
+	if ( inactivity_sweep_interval > 0 )
+		inactivity_sweeper = new InactivitySweeper(inactivity_sweep_interval);
+
 	if ( do_watchdog )
 		{
 		// Set up the watchdog to make sure we don't wedge.
@@ -224,6 +231,9 @@ void expire_timers(iosource::PktSrc* src_ps)
 		src_ps ? sessions->LookupTimerMgr(src_ps->GetCurrentTag())
 			: timer_mgr;
 
+	if ( sessions )
+		sessions->ExpireHalfOpen(network_time);
+
 	current_dispatched +=
 		tmgr->Advance(network_time,
 				max_timer_expires - current_dispatched);
@@ -265,9 +275,13 @@ void net_packet_dispatch(double t, const Packet* pkt, iosource::PktSrc* src_ps)
 			}
 		}
 
+	ZEEK_PROBE2(packet__start, int64(t * 1e6), pkt->cap_len);
+
 	sessions->NextPacket(t, pkt);
 	mgr.Drain();
 
+	ZEEK_PROBE(packet__done);
+
 	if ( sp )
 		{
 		delete sp;
@@ -291,6 +305,9 @@ void net_run()
 		double ts;
 		iosource::IOSource* src = iosource_mgr->FindSoonest(&ts);
 
+		if ( stall_detector )
+			stall_detector->StartIteration();
+
 #ifdef DEBUG
 		static int loop_counter = 0;
 
@@ -308,7 +325,13 @@ void net_run()
 		current_iosrc = src;
 		auto communication_enabled = broker_mgr->Active();
 
-		if ( src )
+		if ( src == broker_mgr )
+			{
+			StallTimer st(StallDetector::BROKER);
+			src->Process();
+			}
+
+		else if ( src )
 			src->Process();	// which will call net_packet_dispatch()
 
 		else if ( reading_live && ! pseudo_realtime)
@@ -320,6 +343,8 @@ void net_run()
 				// date on timers and events.
 				net_update_time(ct);
 				expire_timers();
+
+				StallTimer st(StallDetector::IDLE);
 				usleep(1); // Just yield.
 				}
 			}
@@ -340,6 +365,8 @@ void net_run()
 			// us a lot of idle time, but doesn't delay near-term
 			// timers too much.  (Delaying them somewhat is okay,
 			// since Bro timers are not high-precision anyway.)
+			StallTimer st(StallDetector::IDLE);
+
 			if ( ! communication_enabled )
 				usleep(100000);
 			else
@@ -357,6 +384,17 @@ void net_run()
 
 		mgr.Drain();
 
+		// Send out batched events that have waited long enough.
+		{
+		StallTimer st(StallDetector::BROKER);
+		broker_mgr->FlushEventBuffers(false);
+		}
+
+		metrics_mgr->Update();
+
+		if ( stall_detector )
+			stall_detector->EndIteration();
+
 		processing_start_time = 0.0;	// = "we're not processing now"
 		current_dispatched = 0;
 		current_iosrc = 0;
@@ -416,6 +454,19 @@ void net_get_final_stats()
 			reporter->Info("%" PRIu64 " packets received on interface %s, %" PRIu64 " dropped",
 					s.received, ps->Path().c_str(), s.dropped);
 			}
+
+		iosource::PktSrc::PseudoRealtimeStats ps_stats;
+		ps->GetPseudoRealtimeStats(&ps_stats);
+
+		if ( ps_stats.packets > 1 && ps_stats.wall_time > 0 )
+			// Falling short of the target speed means that we
+			// couldn't keep up with it.
+			reporter->Info("%" PRIu64 " packets replayed from %s at %.2fx speed (target %.2fx), %.6fs average and %.6fs maximum lateness",
+					ps_stats.packets, ps->Path().c_str(),
+					ps_stats.trace_time / ps_stats.wall_time,
+					ps_stats.speed,
+					ps_stats.total_lateness / (ps_stats.packets - 1),
+					ps_stats.max_lateness);
 		}
 	}
 
@@ -8,6 +8,7 @@
 RecordType* conn_id;
 RecordType* endpoint;
 RecordType* endpoint_stats;
+RecordType* shunt_stats;
 RecordType* connection_type;
 RecordType* fa_file_type;
 RecordType* fa_metadata_type;
@@ -39,6 +40,7 @@ int tcp_match_undelivered;
 int encap_hdr_size;
 
 double frag_timeout;
+int max_frag_reassemblers;
 
 double tcp_SYN_timeout;
 double tcp_session_timer;
@@ -52,6 +54,7 @@ int tcp_max_initial_window;
 int tcp_max_above_hole_without_any_acks;
 int tcp_excessive_data_without_further_acks;
 int tcp_max_old_segments;
+int tcp_direct_delivery;
 
 RecordType* socks_address;
 
@@ -59,6 +62,7 @@ double non_analyzed_lifetime;
 double tcp_inactivity_timeout;
 double udp_inactivity_timeout;
 double icmp_inactivity_timeout;
+double inactivity_sweep_interval;
 
 int tcp_storm_thresh;
 double tcp_storm_interarrival_thresh;
@@ -120,6 +124,9 @@ TableVal* dns_skip_addl;
 int dns_skip_all_auth;
 int dns_skip_all_addl;
 int dns_max_queries;
+int dns_summary_only;
+double dns_summary_interval;
+int dns_summary_max_buckets;
 
 double stp_delta;
 double stp_idle_min;
@@ -144,6 +151,7 @@ RecordType* software_version;
 double table_expire_interval;
 double table_expire_delay;
 int table_incremental_step;
+int table_expire_index;
 
 RecordType* packet_type;
 
@@ -165,6 +173,8 @@ Val* profiling_file;
 double profiling_interval;
 int expensive_profiling_multiple;
 int segment_profiling;
+double script_profiling_interval;
+StringVal* script_profiling_file;
 int pkt_profile_mode;
 double pkt_profile_freq;
 Val* pkt_profile_file;
@@ -176,6 +186,17 @@ double gap_report_freq;
 int packet_filter_default;
 
 int sig_max_group_size;
+int sig_dfa_precompute_states;
+int dfa_max_states;
+
+int analyzer_stats_sampling;
+int event_handler_timing;
+
+bro_uint_t file_reassembly_max_memory;
+StringVal* file_reassembly_spill_dir;
+bro_uint_t file_reassembly_max_spill;
+int incremental_file_sniffing;
+bro_uint_t file_delivery_block_size;
 
 TableType* irc_join_list;
 RecordType* irc_join_info;
@@ -211,6 +232,7 @@ StringVal* cmd_line_bpf_filter;
 StringVal* global_hash_seed;
 
 bro_uint_t bits_per_uid;
+int fast_uids;
 
 #include "const.bif.netvar_def"
 #include "types.bif.netvar_def"
@@ -227,6 +249,7 @@ void init_general_global_var()
 	table_expire_interval = opt_internal_double("table_expire_interval");
 	table_expire_delay = opt_internal_double("table_expire_delay");
 	table_incremental_step = opt_internal_int("table_incremental_step");
+	table_expire_index = opt_internal_int("table_expire_index");
 
 	rotate_info = internal_type("rotate_info")->AsRecordType();
 	log_rotate_base_time = opt_internal_string("log_rotate_base_time");
@@ -238,6 +261,17 @@ void init_general_global_var()
 	packet_filter_default = opt_internal_int("packet_filter_default");
 
 	sig_max_group_size = opt_internal_int("sig_max_group_size");
+	sig_dfa_precompute_states = opt_internal_int("sig_dfa_precompute_states");
+	dfa_max_states = opt_internal_int("dfa_max_states");
+
+	analyzer_stats_sampling = opt_internal_int("analyzer_stats_sampling");
+	event_handler_timing = opt_internal_int("event_handler_timing");
+
+	file_reassembly_max_memory = opt_internal_unsigned("file_reassembly_max_memory");
+	file_reassembly_spill_dir = opt_internal_string("file_reassembly_spill_dir");
+	file_reassembly_max_spill = opt_internal_unsigned("file_reassembly_max_spill");
+	incremental_file_sniffing = opt_internal_int("incremental_file_sniffing");
+	file_delivery_block_size = opt_internal_unsigned("file_delivery_block_size");
 
 	check_for_unused_event_handlers =
 		opt_internal_int("check_for_unused_event_handlers");
@@ -256,6 +290,7 @@ void init_general_global_var()
 	global_hash_seed = opt_internal_string("global_hash_seed");
 
 	bits_per_uid = opt_internal_unsigned("bits_per_uid");
+	fast_uids = opt_internal_int("fast_uids");
 	}
 
 void init_net_var()
@@ -267,6 +302,7 @@ void init_net_var()
 	conn_id = internal_type("conn_id")->AsRecordType();
 	endpoint = internal_type("endpoint")->AsRecordType();
 	endpoint_stats = internal_type("endpoint_stats")->AsRecordType();
+	shunt_stats = internal_type("shunt_stats")->AsRecordType();
 	connection_type = internal_type("connection")->AsRecordType();
 	fa_file_type = internal_type("fa_file")->AsRecordType();
 	fa_metadata_type = internal_type("fa_metadata")->AsRecordType();
@@ -293,6 +329,7 @@ void init_net_var()
 	encap_hdr_size = opt_internal_int("encap_hdr_size");
 
 	frag_timeout = opt_internal_double("frag_timeout");
+	max_frag_reassemblers = opt_internal_int("max_frag_reassemblers");
 
 	tcp_SYN_timeout = opt_internal_double("tcp_SYN_timeout");
 	tcp_session_timer = opt_internal_double("tcp_session_timer");
@@ -308,6 +345,7 @@ void init_net_var()
 	tcp_excessive_data_without_further_acks =
 		opt_internal_int("tcp_excessive_data_without_further_acks");
 	tcp_max_old_segments = opt_internal_int("tcp_max_old_segments");
+	tcp_direct_delivery = opt_internal_int("tcp_direct_delivery");
 
 	socks_address = internal_type("SOCKS::Address")->AsRecordType();
 
@@ -315,6 +353,7 @@ void init_net_var()
 	tcp_inactivity_timeout = opt_internal_double("tcp_inactivity_timeout");
 	udp_inactivity_timeout = opt_internal_double("udp_inactivity_timeout");
 	icmp_inactivity_timeout = opt_internal_double("icmp_inactivity_timeout");
+	inactivity_sweep_interval = opt_internal_double("inactivity_sweep_interval");
 
 	tcp_storm_thresh = opt_internal_int("tcp_storm_thresh");
 	tcp_storm_interarrival_thresh =
@@ -393,6 +432,9 @@ void init_net_var()
 	dns_skip_all_auth = opt_internal_int("dns_skip_all_auth");
 	dns_skip_all_addl = opt_internal_int("dns_skip_all_addl");
 	dns_max_queries = opt_internal_int("dns_max_queries");
+	dns_summary_only = opt_internal_int("dns_summary_only");
+	dns_summary_interval = opt_internal_double("dns_summary_interval");
+	dns_summary_max_buckets = opt_internal_int("dns_summary_max_buckets");
 
 	stp_delta = opt_internal_double("stp_delta");
 	stp_idle_min = opt_internal_double("stp_idle_min");
@@ -431,6 +473,8 @@ void init_net_var()
 		opt_internal_int("expensive_profiling_multiple");
 	profiling_interval = opt_internal_double("profiling_interval");
 	segment_profiling = opt_internal_int("segment_profiling");
+	script_profiling_interval = opt_internal_double("script_profiling_interval");
+	script_profiling_file = opt_internal_string("script_profiling_file");
 
 	pkt_profile_mode = opt_internal_int("pkt_profile_mode");
 	pkt_profile_freq = opt_internal_double("pkt_profile_freq");
@@ -11,6 +11,7 @@
 extern RecordType* conn_id;
 extern RecordType* endpoint;
 extern RecordType* endpoint_stats;
+extern RecordType* shunt_stats;
 extern RecordType* connection_type;
 extern RecordType* fa_file_type;
 extern RecordType* fa_metadata_type;
@@ -42,6 +43,7 @@ extern int tcp_match_undelivered;
 extern int encap_hdr_size;
 
 extern double frag_timeout;
+extern int max_frag_reassemblers;
 
 extern double tcp_SYN_timeout;
 extern double tcp_session_timer;
@@ -55,6 +57,7 @@ extern int tcp_max_initial_window;
 extern int tcp_max_above_hole_without_any_acks;
 extern int tcp_excessive_data_without_further_acks;
 extern int tcp_max_old_segments;
+extern int tcp_direct_delivery;
 
 extern RecordType* socks_address;
 
@@ -62,6 +65,7 @@ extern double non_analyzed_lifetime;
 extern double tcp_inactivity_timeout;
 extern double udp_inactivity_timeout;
 extern double icmp_inactivity_timeout;
+extern double inactivity_sweep_interval;
 
 extern int tcp_storm_thresh;
 extern double tcp_storm_interarrival_thresh;
@@ -123,6 +127,9 @@ extern TableVal* dns_skip_addl;
 extern int dns_skip_all_auth;
 extern int dns_skip_all_addl;
 extern int dns_max_queries;
+extern int dns_summary_only;
+extern double dns_summary_interval;
+extern int dns_summary_max_buckets;
 
 extern double stp_delta;
 extern double stp_idle_min;
@@ -147,6 +154,7 @@ extern RecordType* software_version;
 extern double table_expire_interval;
 extern double table_expire_delay;
 extern int table_incremental_step;
+extern int table_expire_index;
 
 extern RecordType* packet_type;
 
@@ -169,6 +177,8 @@ extern double profiling_interval;
 extern int expensive_profiling_multiple;
 
 extern int segment_profiling;
+extern double script_profiling_interval;
+extern StringVal* script_profiling_file;
 extern int pkt_profile_mode;
 extern double pkt_profile_freq;
 extern Val* pkt_profile_file;
@@ -178,6 +188,17 @@ extern int load_sample_freq;
 extern int packet_filter_default;
 
 extern int sig_max_group_size;
+extern int sig_dfa_precompute_states;
+extern int dfa_max_states;
+
+extern int analyzer_stats_sampling;
+extern int event_handler_timing;
+
+extern bro_uint_t file_reassembly_max_memory;
+extern StringVal* file_reassembly_spill_dir;
+extern bro_uint_t file_reassembly_max_spill;
+extern int incremental_file_sniffing;
+extern bro_uint_t file_delivery_block_size;
 
 extern TableType* irc_join_list;
 extern RecordType* irc_join_info;
@@ -213,6 +234,7 @@ extern StringVal* cmd_line_bpf_filter;
 extern StringVal* global_hash_seed;
 
 extern bro_uint_t bits_per_uid;
+extern int fast_uids;
 
 // Initializes globals that don't pertain to network/event analysis.
 extern void init_general_global_var();
@@ -19,6 +19,9 @@ notifier::Registry::~Registry()
 	{
 	while ( registrations.begin() != registrations.end() )
 		Unregister(registrations.begin()->first);
+
+	while ( keyed_registrations.begin() != keyed_registrations.end() )
+		Unregister(keyed_registrations.begin()->first);
 	}
 
 void notifier::Registry::Register(Modifiable* m, notifier::Receiver* r)
@@ -29,6 +32,15 @@ void notifier::Registry::Register(Modifiable* m, notifier::Receiver* r)
 	++m->num_receivers;
 	}
 
+void notifier::Registry::Register(Modifiable* m, notifier::Receiver* r,
+				  const std::string& key)
+	{
+	DBG_LOG(DBG_NOTIFIERS, "registering key of object %p for receiver %p", m, r);
+
+	keyed_registrations[m].insert({key, r});
+	++m->num_receivers;
+	}
+
 void notifier::Registry::Unregister(Modifiable* m, notifier::Receiver* r)
 	{
 	DBG_LOG(DBG_NOTIFIERS, "unregistering object %p from receiver %p", m, r);
@@ -45,6 +57,30 @@ void notifier::Registry::Unregister(Modifiable* m, notifier::Receiver* r)
 		}
 	}
 
+void notifier::Registry::Unregister(Modifiable* m, notifier::Receiver* r,
+				    const std::string& key)
+	{
+	DBG_LOG(DBG_NOTIFIERS, "unregistering key of object %p from receiver %p", m, r);
+
+	auto k = keyed_registrations.find(m);
+	if ( k == keyed_registrations.end() )
+		return;
+
+	auto x = k->second.equal_range(key);
+	for ( auto i = x.first; i != x.second; i++ )
+		{
+		if ( i->second == r )
+			{
+			--m->num_receivers;
+			k->second.erase(i);
+			break;
+			}
+		}
+
+	if ( k->second.empty() )
+		keyed_registrations.erase(k);
+	}
+
 void notifier::Registry::Unregister(Modifiable* m)
 	{
 	DBG_LOG(DBG_NOTIFIERS, "unregistering object %p from all notifiers", m);
@@ -54,6 +90,13 @@ void notifier::Registry::Unregister(Modifiable* m)
 		--i->first->num_receivers;
 
 	registrations.erase(x.first, x.second);
+
+	auto k = keyed_registrations.find(m);
+	if ( k != keyed_registrations.end() )
+		{
+		m->num_receivers -= k->second.size();
+		keyed_registrations.erase(k);
+		}
 	}
 
 void notifier::Registry::Modified(Modifiable* m)
@@ -63,6 +106,28 @@ void notifier::Registry::Modified(Modifiable* m)
 	auto x = registrations.equal_range(m);
 	for ( auto i = x.first; i != x.second; i++ )
 		i->second->Modified(m);
+
+	auto k = keyed_registrations.find(m);
+	if ( k != keyed_registrations.end() )
+		for ( auto& i : k->second )
+			i.second->Modified(m);
+	}
+
+void notifier::Registry::Modified(Modifiable* m, const std::string& key)
+	{
+	DBG_LOG(DBG_NOTIFIERS, "object %p has been modified under a key", m);
+
+	auto x = registrations.equal_range(m);
+	for ( auto i = x.first; i != x.second; i++ )
+		i->second->Modified(m);
+
+	auto k = keyed_registrations.find(m);
+	if ( k == keyed_registrations.end() )
+		return;
+
+	auto y = k->second.equal_range(key);
+	for ( auto i = y.first; i != y.second; i++ )
+		i->second->Modified(m);
 	}
 
 notifier::Modifiable::~Modifiable()
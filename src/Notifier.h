@@ -51,6 +51,19 @@ public:
 	 */
 	void Register(Modifiable* m, Receiver* r);
 
+	/**
+	 * Registers a receiver to be informed only when the part of a
+	 * modifiable object stored under a given key has changed, such as
+	 * a single table entry, or when the object changed as a whole.
+	 *
+	 * @param m object to track, as with Register().
+	 *
+	 * @param r receiver to notify on changes, as with Register().
+	 *
+	 * @param key the key's bytes, in the object's own representation.
+	 */
+	void Register(Modifiable* m, Receiver* r, const std::string& key);
+
 	/**
 	 * Cancels a receiver's request to be informed about an object's
 	 * modification. The arguments to the method must match what was
@@ -62,6 +75,19 @@ public:
 	 */
 	void Unregister(Modifiable* m, Receiver* Receiver);
 
+	/**
+	 * Cancels a receiver's request to be informed about modifications
+	 * under a key. The arguments to the method must match what was
+	 * originally registered.
+	 *
+	 * @param m object to no loger track.
+	 *
+	 * @param r receiver to no longer notify.
+	 *
+	 * @param key the key that was registered.
+	 */
+	void Unregister(Modifiable* m, Receiver* r, const std::string& key);
+
 	/**
 	 * Cancels any active receiver requests to be informed about a
 	 * partilar object's modifications.
@@ -77,8 +103,16 @@ private:
 	// Will be called from the object itself.
 	void Modified(Modifiable* m);
 
+	// Inform the receivers registered for the object as a whole and
+	// those for the given key.
+	void Modified(Modifiable* m, const std::string& key);
+
 	typedef std::unordered_multimap<Modifiable*, Receiver*> ModifiableMap;
 	ModifiableMap registrations;
+
+	// Receivers interested in individual keys, per object.
+	typedef std::unordered_multimap<std::string, Receiver*> KeyMap;
+	std::unordered_map<Modifiable*, KeyMap> keyed_registrations;
 };
 
 /**
@@ -102,6 +136,17 @@ public:
 			registry.Modified(this);
 		}
 
+	/**
+	 * Like Modified(), but for a change that only affects what's stored
+	 * under the given key, so that receivers registered for other keys
+	 * don't get notified.
+	 */
+	void Modified(const void* key, int size)
+		{
+		if ( num_receivers )
+			registry.Modified(this, std::string(static_cast<const char*>(key), size));
+		}
+
 protected:
 	friend class Registry;
 
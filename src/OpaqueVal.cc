@@ -5,6 +5,9 @@
 #include "Reporter.h"
 #include "probabilistic/BloomFilter.h"
 #include "probabilistic/CardinalityCounter.h"
+#include "probabilistic/CuckooFilter.h"
+#include "probabilistic/XorFilter.h"
+#include "probabilistic/CountMinSketch.h"
 
 #include <broker/error.hh>
 
@@ -921,6 +924,333 @@ bool BloomFilterVal::DoUnserialize(const broker::data& data)
 	return true;
 	}
 
+CuckooFilterVal::CuckooFilterVal()
+	: OpaqueVal(cuckoofilter_type)
+	{
+	type = 0;
+	hash = 0;
+	cuckoo_filter = 0;
+	}
+
+CuckooFilterVal::CuckooFilterVal(probabilistic::CuckooFilter* cf)
+	: OpaqueVal(cuckoofilter_type)
+	{
+	type = 0;
+	hash = 0;
+	cuckoo_filter = cf;
+	}
+
+CuckooFilterVal::~CuckooFilterVal()
+	{
+	Unref(type);
+	delete hash;
+	delete cuckoo_filter;
+	}
+
+Val* CuckooFilterVal::DoClone(CloneState* state)
+	{
+	if ( cuckoo_filter )
+		{
+		auto cf = new CuckooFilterVal(cuckoo_filter->Clone());
+
+		if ( type )
+			cf->Typify(type);
+
+		return state->NewClone(this, cf);
+		}
+
+	return state->NewClone(this, new CuckooFilterVal());
+	}
+
+bool CuckooFilterVal::Typify(BroType* arg_type)
+	{
+	if ( type )
+		return false;
+
+	type = arg_type;
+	type->Ref();
+
+	TypeList* tl = new TypeList(type);
+	tl->Append(type->Ref());
+	hash = new CompositeHash(tl);
+	Unref(tl);
+
+	return true;
+	}
+
+BroType* CuckooFilterVal::Type() const
+	{
+	return type;
+	}
+
+bool CuckooFilterVal::Add(const Val* val)
+	{
+	HashKey* key = hash->ComputeHash(val, 1);
+	bool result = cuckoo_filter->Add(key);
+	delete key;
+	return result;
+	}
+
+bool CuckooFilterVal::Remove(const Val* val)
+	{
+	HashKey* key = hash->ComputeHash(val, 1);
+	bool result = cuckoo_filter->Remove(key);
+	delete key;
+	return result;
+	}
+
+bool CuckooFilterVal::Lookup(const Val* val) const
+	{
+	HashKey* key = hash->ComputeHash(val, 1);
+	bool result = cuckoo_filter->Lookup(key);
+	delete key;
+	return result;
+	}
+
+uint64 CuckooFilterVal::Size() const
+	{
+	return cuckoo_filter->Size();
+	}
+
+void CuckooFilterVal::Clear()
+	{
+	cuckoo_filter->Clear();
+	}
+
+string CuckooFilterVal::InternalState() const
+	{
+	return cuckoo_filter->InternalState();
+	}
+
+CuckooFilterVal* CuckooFilterVal::Merge(const CuckooFilterVal* x,
+					const CuckooFilterVal* y)
+	{
+	if ( x->Type() && // any one 0 is ok here
+	     y->Type() &&
+	     ! same_type(x->Type(), y->Type()) )
+		{
+		reporter->Error("cannot merge cuckoo filters with different types");
+		return 0;
+		}
+
+	probabilistic::CuckooFilter* copy = x->cuckoo_filter->Clone();
+
+	if ( ! copy->Merge(y->cuckoo_filter) )
+		{
+		delete copy;
+		reporter->Error("failed to merge cuckoo filter");
+		return 0;
+		}
+
+	CuckooFilterVal* merged = new CuckooFilterVal(copy);
+	BroType* t = x->Type() ? x->Type() : y->Type();
+
+	if ( t && ! merged->Typify(t) )
+		{
+		Unref(merged);
+		reporter->Error("failed to set type on merged cuckoo filter");
+		return 0;
+		}
+
+	return merged;
+	}
+
+IMPLEMENT_OPAQUE_VALUE(CuckooFilterVal)
+
+broker::expected<broker::data> CuckooFilterVal::DoSerialize() const
+	{
+	broker::vector d;
+
+	if ( type )
+		{
+		auto t = SerializeType(type);
+		if ( ! t )
+			return broker::ec::invalid_data;
+
+		d.emplace_back(std::move(*t));
+		}
+	else
+		d.emplace_back(broker::none());
+
+	auto cf = cuckoo_filter->Serialize();
+	if ( ! cf )
+		return broker::ec::invalid_data; // Cannot serialize;
+
+	d.emplace_back(std::move(*cf));
+	return {std::move(d)};
+	}
+
+bool CuckooFilterVal::DoUnserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() == 2) )
+		return false;
+
+	auto no_type = caf::get_if<broker::none>(&(*v)[0]);
+	if ( ! no_type )
+		{
+		BroType* t = UnserializeType((*v)[0]);
+		if ( ! (t && Typify(t)) )
+			return false;
+
+		Unref(t);
+		}
+
+	auto cf = probabilistic::CuckooFilter::Unserialize((*v)[1]);
+	if ( ! cf )
+		return false;
+
+	cuckoo_filter = cf.release();
+	return true;
+	}
+
+XorFilterVal::XorFilterVal()
+	: OpaqueVal(xorfilter_type)
+	{
+	type = 0;
+	hash = 0;
+	xor_filter = 0;
+	}
+
+XorFilterVal::XorFilterVal(probabilistic::XorFilter* xf)
+	: OpaqueVal(xorfilter_type)
+	{
+	type = 0;
+	hash = 0;
+	xor_filter = xf;
+	}
+
+XorFilterVal::~XorFilterVal()
+	{
+	Unref(type);
+	delete hash;
+	delete xor_filter;
+	}
+
+Val* XorFilterVal::DoClone(CloneState* state)
+	{
+	if ( xor_filter )
+		{
+		auto xf = new XorFilterVal(xor_filter->Clone());
+
+		if ( type )
+			xf->Typify(type);
+
+		return state->NewClone(this, xf);
+		}
+
+	return state->NewClone(this, new XorFilterVal());
+	}
+
+bool XorFilterVal::Typify(BroType* arg_type)
+	{
+	if ( type )
+		return false;
+
+	type = arg_type;
+	type->Ref();
+
+	TypeList* tl = new TypeList(type);
+	tl->Append(type->Ref());
+	hash = new CompositeHash(tl);
+	Unref(tl);
+
+	return true;
+	}
+
+BroType* XorFilterVal::Type() const
+	{
+	return type;
+	}
+
+bool XorFilterVal::Build(TableVal* set)
+	{
+	const type_list* indices = set->Type()->AsTableType()->IndexTypes();
+
+	if ( indices->length() != 1 || ! Typify((*indices)[0]) )
+		return false;
+
+	const PDict(TableEntryVal)* tbl = set->AsTable();
+	IterCookie* c = tbl->InitForIteration();
+	HashKey* k;
+
+	std::vector<HashKey*> keys;
+	keys.reserve(tbl->Length());
+
+	while ( tbl->NextEntry(k, c) )
+		{
+		ListVal* index = set->RecoverIndex(k);
+		keys.push_back(hash->ComputeHash(index->Index(0), 1));
+		Unref(index);
+		delete k;
+		}
+
+	bool result = xor_filter->Build(keys);
+
+	for ( auto key : keys )
+		delete key;
+
+	return result;
+	}
+
+bool XorFilterVal::Lookup(const Val* val) const
+	{
+	HashKey* key = hash->ComputeHash(val, 1);
+	bool result = xor_filter->Lookup(key);
+	delete key;
+	return result;
+	}
+
+uint64 XorFilterVal::Size() const
+	{
+	return xor_filter->Size();
+	}
+
+string XorFilterVal::InternalState() const
+	{
+	return xor_filter->InternalState();
+	}
+
+IMPLEMENT_OPAQUE_VALUE(XorFilterVal)
+
+broker::expected<broker::data> XorFilterVal::DoSerialize() const
+	{
+	if ( ! type )
+		return broker::ec::invalid_data;
+
+	auto t = SerializeType(type);
+	if ( ! t )
+		return broker::ec::invalid_data;
+
+	auto xf = xor_filter->Serialize();
+	if ( ! xf )
+		return broker::ec::invalid_data; // Cannot serialize;
+
+	return {broker::vector{std::move(*t), std::move(*xf)}};
+	}
+
+bool XorFilterVal::DoUnserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() == 2) )
+		return false;
+
+	BroType* t = UnserializeType((*v)[0]);
+	if ( ! (t && Typify(t)) )
+		return false;
+
+	Unref(t);
+
+	auto xf = probabilistic::XorFilter::Unserialize((*v)[1]);
+	if ( ! xf )
+		return false;
+
+	xor_filter = xf.release();
+	return true;
+	}
+
 CardinalityVal::CardinalityVal() : OpaqueVal(cardinality_type)
 	{
 	c = 0;
@@ -928,6 +1258,178 @@ CardinalityVal::CardinalityVal() : OpaqueVal(cardinality_type)
 	hash = 0;
 	}
 
+CountMinSketchVal::CountMinSketchVal()
+	: OpaqueVal(countminsketch_type)
+	{
+	type = 0;
+	hash = 0;
+	sketch = 0;
+	}
+
+CountMinSketchVal::CountMinSketchVal(probabilistic::CountMinSketch* cms)
+	: OpaqueVal(countminsketch_type)
+	{
+	type = 0;
+	hash = 0;
+	sketch = cms;
+	}
+
+CountMinSketchVal::~CountMinSketchVal()
+	{
+	Unref(type);
+	delete hash;
+	delete sketch;
+	}
+
+Val* CountMinSketchVal::DoClone(CloneState* state)
+	{
+	if ( sketch )
+		{
+		auto cms = new CountMinSketchVal(sketch->Clone());
+
+		if ( type )
+			cms->Typify(type);
+
+		return state->NewClone(this, cms);
+		}
+
+	return state->NewClone(this, new CountMinSketchVal());
+	}
+
+bool CountMinSketchVal::Typify(BroType* arg_type)
+	{
+	if ( type )
+		return false;
+
+	type = arg_type;
+	type->Ref();
+
+	TypeList* tl = new TypeList(type);
+	tl->Append(type->Ref());
+	hash = new CompositeHash(tl);
+	Unref(tl);
+
+	return true;
+	}
+
+BroType* CountMinSketchVal::Type() const
+	{
+	return type;
+	}
+
+void CountMinSketchVal::Add(const Val* val, uint64 count)
+	{
+	HashKey* key = hash->ComputeHash(val, 1);
+	sketch->Add(key, count);
+	delete key;
+	}
+
+uint64 CountMinSketchVal::Estimate(const Val* val) const
+	{
+	HashKey* key = hash->ComputeHash(val, 1);
+	uint64 result = sketch->Estimate(key);
+	delete key;
+	return result;
+	}
+
+uint64 CountMinSketchVal::Total() const
+	{
+	return sketch->Total();
+	}
+
+void CountMinSketchVal::Clear()
+	{
+	sketch->Clear();
+	}
+
+string CountMinSketchVal::InternalState() const
+	{
+	return sketch->InternalState();
+	}
+
+CountMinSketchVal* CountMinSketchVal::Merge(const CountMinSketchVal* x,
+					    const CountMinSketchVal* y)
+	{
+	if ( x->Type() && // any one 0 is ok here
+	     y->Type() &&
+	     ! same_type(x->Type(), y->Type()) )
+		{
+		reporter->Error("cannot merge count-min sketches with different types");
+		return 0;
+		}
+
+	probabilistic::CountMinSketch* copy = x->sketch->Clone();
+
+	if ( ! copy->Merge(y->sketch) )
+		{
+		delete copy;
+		reporter->Error("failed to merge count-min sketch");
+		return 0;
+		}
+
+	CountMinSketchVal* merged = new CountMinSketchVal(copy);
+	BroType* t = x->Type() ? x->Type() : y->Type();
+
+	if ( t && ! merged->Typify(t) )
+		{
+		Unref(merged);
+		reporter->Error("failed to set type on merged count-min sketch");
+		return 0;
+		}
+
+	return merged;
+	}
+
+IMPLEMENT_OPAQUE_VALUE(CountMinSketchVal)
+
+broker::expected<broker::data> CountMinSketchVal::DoSerialize() const
+	{
+	broker::vector d;
+
+	if ( type )
+		{
+		auto t = SerializeType(type);
+		if ( ! t )
+			return broker::ec::invalid_data;
+
+		d.emplace_back(std::move(*t));
+		}
+	else
+		d.emplace_back(broker::none());
+
+	auto cms = sketch->Serialize();
+	if ( ! cms )
+		return broker::ec::invalid_data; // Cannot serialize;
+
+	d.emplace_back(std::move(*cms));
+	return {std::move(d)};
+	}
+
+bool CountMinSketchVal::DoUnserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() == 2) )
+		return false;
+
+	auto no_type = caf::get_if<broker::none>(&(*v)[0]);
+	if ( ! no_type )
+		{
+		BroType* t = UnserializeType((*v)[0]);
+		if ( ! (t && Typify(t)) )
+			return false;
+
+		Unref(t);
+		}
+
+	auto cms = probabilistic::CountMinSketch::Unserialize((*v)[1]);
+	if ( ! cms )
+		return false;
+
+	sketch = cms.release();
+	return true;
+	}
+
 CardinalityVal::CardinalityVal(probabilistic::CardinalityCounter* arg_c)
 	: OpaqueVal(cardinality_type)
 	{
@@ -1033,7 +1535,12 @@ ParaglobVal::ParaglobVal(std::unique_ptr<paraglob::Paraglob> p)
 
 VectorVal* ParaglobVal::Get(StringVal* &pattern)
 	{
-	VectorVal* rval = new VectorVal(internal_type("string_vec")->AsVectorType());
+	static VectorType* string_vec_type = 0;
+
+	if ( ! string_vec_type )
+		string_vec_type = internal_type("string_vec")->AsVectorType();
+
+	VectorVal* rval = new VectorVal(string_vec_type);
 	std::string string_pattern (reinterpret_cast<const char*>(pattern->Bytes()), pattern->Len());
 
 	std::vector<std::string> matches = this->internal_paraglob->get(string_pattern);
@@ -1109,3 +1616,118 @@ Val* ParaglobVal::DoClone(CloneState* state)
 		return nullptr;
 		}
 	}
+
+PatternStreamVal::PatternStreamVal() : OpaqueVal(pattern_stream_type)
+	{
+	re = 0;
+	state = 0;
+	started = matched = finished = false;
+	}
+
+PatternStreamVal::PatternStreamVal(const char* exact_pat,
+                                   const char* anywhere_pat)
+	: OpaqueVal(pattern_stream_type)
+	{
+	re = 0;
+	state = 0;
+	started = matched = finished = false;
+
+	Init(exact_pat, anywhere_pat);
+	}
+
+PatternStreamVal::~PatternStreamVal()
+	{
+	delete state;
+	delete re;
+	}
+
+bool PatternStreamVal::Init(const char* exact_pat, const char* anywhere_pat)
+	{
+	// Our own copy, as the pattern value may change or go away.
+	re = new RE_Matcher(exact_pat, anywhere_pat);
+
+	if ( ! re->Compile() )
+		return false;
+
+	state = new RE_Match_State(re->AnywhereMatcher());
+	return true;
+	}
+
+void PatternStreamVal::Done()
+	{
+	delete state;
+	state = 0;
+	}
+
+bool PatternStreamVal::Feed(const u_char* data, int len)
+	{
+	if ( ! state || finished )
+		return matched;
+
+	state->Match(data, len, ! started, false, false);
+	started = true;
+
+	// Unlike its return value, this also covers patterns that match
+	// the empty input already.
+	if ( ! state->AcceptedMatches().empty() )
+		{
+		matched = true;
+		Done();
+		}
+
+	return matched;
+	}
+
+bool PatternStreamVal::Finish()
+	{
+	if ( state && ! finished )
+		{
+		state->Match((const u_char*) "", 0, ! started, true, false);
+		matched = ! state->AcceptedMatches().empty();
+		}
+
+	finished = true;
+	Done();
+
+	return matched;
+	}
+
+IMPLEMENT_OPAQUE_VALUE(PatternStreamVal)
+
+broker::expected<broker::data> PatternStreamVal::DoSerialize() const
+	{
+	// The DFA state of a match in progress doesn't carry over.
+	if ( state && started )
+		return broker::ec::invalid_data;
+
+	return {broker::vector{std::string(re->PatternText()),
+	                       std::string(re->AnywherePatternText()),
+	                       started, matched, finished}};
+	}
+
+bool PatternStreamVal::DoUnserialize(const broker::data& data)
+	{
+	auto d = caf::get_if<broker::vector>(&data);
+	if ( ! (d && d->size() == 5) )
+		return false;
+
+	auto exact_pat = caf::get_if<std::string>(&(*d)[0]);
+	auto anywhere_pat = caf::get_if<std::string>(&(*d)[1]);
+	if ( ! (exact_pat && anywhere_pat) )
+		return false;
+
+	if ( ! get_vector_idx<bool>(*d, 2, &started) )
+		return false;
+	if ( ! get_vector_idx<bool>(*d, 3, &matched) )
+		return false;
+	if ( ! get_vector_idx<bool>(*d, 4, &finished) )
+		return false;
+
+	if ( ! Init(exact_pat->c_str(), anywhere_pat->c_str()) )
+		return false;
+
+	if ( started )
+		Done();
+
+	return true;
+	}
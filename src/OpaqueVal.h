@@ -7,6 +7,7 @@
 #include <broker/expected.hh>
 
 #include "RandTest.h"
+#include "RE.h"
 #include "Val.h"
 #include "digest.h"
 #include "src/paraglob.h"
@@ -155,6 +156,9 @@ protected:
 namespace probabilistic {
 	class BloomFilter;
 	class CardinalityCounter;
+	class CuckooFilter;
+	class XorFilter;
+	class CountMinSketch;
 }
 
 class HashVal : public OpaqueVal {
@@ -296,6 +300,109 @@ private:
 };
 
 
+class CuckooFilterVal : public OpaqueVal {
+public:
+	explicit CuckooFilterVal(probabilistic::CuckooFilter* cf);
+	~CuckooFilterVal() override;
+
+	Val* DoClone(CloneState* state) override;
+
+	BroType* Type() const;
+	bool Typify(BroType* type);
+
+	bool Add(const Val* val);
+	bool Remove(const Val* val);
+	bool Lookup(const Val* val) const;
+	uint64 Size() const;
+	void Clear();
+	string InternalState() const;
+
+	static CuckooFilterVal* Merge(const CuckooFilterVal* x,
+				      const CuckooFilterVal* y);
+
+protected:
+	friend class Val;
+	CuckooFilterVal();
+
+	DECLARE_OPAQUE_VALUE(CuckooFilterVal)
+private:
+	// Disable.
+	CuckooFilterVal(const CuckooFilterVal&);
+	CuckooFilterVal& operator=(const CuckooFilterVal&);
+
+	BroType* type;
+	CompositeHash* hash;
+	probabilistic::CuckooFilter* cuckoo_filter;
+};
+
+class XorFilterVal : public OpaqueVal {
+public:
+	explicit XorFilterVal(probabilistic::XorFilter* xf);
+	~XorFilterVal() override;
+
+	Val* DoClone(CloneState* state) override;
+
+	BroType* Type() const;
+
+	// Builds the filter from the elements of a set with a single index
+	// type, which becomes the filter's type.
+	bool Build(TableVal* set);
+
+	bool Lookup(const Val* val) const;
+	uint64 Size() const;
+	string InternalState() const;
+
+protected:
+	friend class Val;
+	XorFilterVal();
+
+	DECLARE_OPAQUE_VALUE(XorFilterVal)
+private:
+	// Disable.
+	XorFilterVal(const XorFilterVal&);
+	XorFilterVal& operator=(const XorFilterVal&);
+
+	bool Typify(BroType* type);
+
+	BroType* type;
+	CompositeHash* hash;
+	probabilistic::XorFilter* xor_filter;
+};
+
+class CountMinSketchVal : public OpaqueVal {
+public:
+	explicit CountMinSketchVal(probabilistic::CountMinSketch* cms);
+	~CountMinSketchVal() override;
+
+	Val* DoClone(CloneState* state) override;
+
+	BroType* Type() const;
+	bool Typify(BroType* type);
+
+	void Add(const Val* val, uint64 count);
+	uint64 Estimate(const Val* val) const;
+	uint64 Total() const;
+	void Clear();
+	string InternalState() const;
+
+	static CountMinSketchVal* Merge(const CountMinSketchVal* x,
+					const CountMinSketchVal* y);
+
+protected:
+	friend class Val;
+	CountMinSketchVal();
+
+	DECLARE_OPAQUE_VALUE(CountMinSketchVal)
+private:
+	// Disable.
+	CountMinSketchVal(const CountMinSketchVal&);
+	CountMinSketchVal& operator=(const CountMinSketchVal&);
+
+	BroType* type;
+	CompositeHash* hash;
+	probabilistic::CountMinSketch* sketch;
+};
+
 class CardinalityVal: public OpaqueVal {
 public:
 	explicit CardinalityVal(probabilistic::CardinalityCounter*);
@@ -336,4 +443,37 @@ private:
 	std::unique_ptr<paraglob::Paraglob> internal_paraglob;
 };
 
+// Matches a pattern against input that arrives in pieces, with the same
+// result as matching it anywhere in the concatenated input.
+class PatternStreamVal : public OpaqueVal {
+public:
+	PatternStreamVal(const char* exact_pat, const char* anywhere_pat);
+	~PatternStreamVal() override;
+
+	// Returns true once the pattern has matched the input so far.
+	bool Feed(const u_char* data, int len);
+
+	// Marks the end of the input, for patterns anchored there.
+	bool Finish();
+
+	bool Matched() const	{ return matched; }
+
+protected:
+	friend class Val;
+	PatternStreamVal();
+
+	DECLARE_OPAQUE_VALUE(PatternStreamVal)
+private:
+	bool Init(const char* exact_pat, const char* anywhere_pat);
+
+	// Having a result, we don't need the matcher anymore.
+	void Done();
+
+	RE_Matcher* re;
+	RE_Match_State* state;	// null once we have a result
+	bool started;	// fed any input yet
+	bool matched;
+	bool finished;
+};
+
 #endif
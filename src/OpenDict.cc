@@ -0,0 +1,472 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Open-addressing implementation of Dictionary, selected at configure time
+// with --enable-open-dict. The interface and iteration semantics match the
+// chained implementation in Dict.cc, but the order in which unordered
+// dictionaries return their entries differs.
+
+#include "zeek-config.h"
+
+#ifdef ENABLE_OPEN_DICT
+
+#ifdef HAVE_MEMORY_H
+#include <memory.h>
+#endif
+
+#include "Dict.h"
+#include "HugePages.h"
+#include "Reporter.h"
+#include "util.h"
+
+// Default number of entries a dictionary is sized for initially.  The
+// dictionary will grow as needed.
+#define DEFAULT_DICT_SIZE 16
+
+// Slot positions with special meaning.
+#define SLOT_EMPTY	0xffffffff
+#define SLOT_DELETED	0xfffffffe
+
+class DictEntry {
+public:
+	void* key;
+	int len;	// -1 for a hole left by Remove()
+	hash_t hash;
+	void* value;
+};
+
+class DictSlot {
+public:
+	uint32 pos;	// index into the entry array, or SLOT_*
+	uint32 tag;	// upper half of the entry's hash
+};
+
+// An iteration cookie is just the position in the entry array at which
+// to continue. Entries inserted during the iteration get appended, so
+// we'll reach them eventually; removed ones leave holes that we skip.
+class IterCookie {
+public:
+	explicit IterCookie(int p)	{ pos = p; }
+
+	int pos;
+};
+
+static inline uint32 hash_tag(hash_t hash)
+	{
+	return uint32(hash >> 32);
+	}
+
+// Returns the number of slots to use for holding n entries, keeping the
+// load factor at or below 2/3.
+static int slots_for(int n)
+	{
+	int want = n + n / 2 + 1;
+	int s = 8;
+
+	while ( s < want )
+		s <<= 1;
+
+	return s;
+	}
+
+Dictionary::Dictionary(dict_order ordering, int initial_size,
+			HashPolicy policy)
+	{
+	hash_policy = policy;
+	entries = 0;
+	entries_len = entries_cap = 0;
+	slots = 0;
+	num_slots = num_deleted_slots = 0;
+	num_entries = max_num_entries = 0;
+	cumulative_entries = 0;
+	ordered = (ordering == ORDERED);
+	delete_func = 0;
+
+	if ( initial_size > 0 )
+		Init(initial_size);
+	}
+
+Dictionary::~Dictionary()
+	{
+	DeInit();
+	}
+
+void Dictionary::Clear()
+	{
+	DeInit();
+	}
+
+void Dictionary::Init(int size)
+	{
+	entries_cap = size;
+	entries = huge_new_array<DictEntry>(entries_cap);
+	entries_len = 0;
+
+	num_slots = slots_for(size);
+	slots = huge_new_array<DictSlot>(num_slots);
+
+	for ( int i = 0; i < num_slots; ++i )
+		slots[i].pos = SLOT_EMPTY;
+
+	num_deleted_slots = 0;
+	max_num_entries = num_entries = 0;
+	}
+
+void Dictionary::DeInit()
+	{
+	if ( ! entries )
+		return;
+
+	for ( int i = 0; i < entries_len; ++i )
+		{
+		DictEntry* e = &entries[i];
+
+		if ( e->len < 0 )
+			continue;
+
+		if ( delete_func )
+			delete_func(e->value);
+
+		delete [] (char*) e->key;
+		}
+
+	huge_free(entries);
+	huge_free(slots);
+
+	entries = 0;
+	slots = 0;
+	entries_len = entries_cap = 0;
+	num_slots = num_deleted_slots = 0;
+	num_entries = 0;
+	}
+
+int Dictionary::FindSlot(const void* key, int key_size, hash_t hash) const
+	{
+	uint32 mask = num_slots - 1;
+	uint32 tag = hash_tag(hash);
+
+	for ( uint32 i = hash & mask; ; i = (i + 1) & mask )
+		{
+		const DictSlot& s = slots[i];
+
+		if ( s.pos == SLOT_EMPTY )
+			return -1;
+
+		if ( s.pos == SLOT_DELETED || s.tag != tag )
+			continue;
+
+		const DictEntry& e = entries[s.pos];
+
+		if ( e.hash == hash && e.len == key_size &&
+		     ! memcmp(key, e.key, key_size) )
+			return i;
+		}
+	}
+
+void* Dictionary::Lookup(const void* key, int key_size, hash_t hash) const
+	{
+	if ( ! num_entries )
+		return 0;
+
+	int i = FindSlot(key, key_size, hash);
+	return i >= 0 ? entries[slots[i].pos].value : 0;
+	}
+
+void* Dictionary::Insert(void* key, int key_size, hash_t hash, void* val,
+				int copy_key)
+	{
+	if ( ! entries )
+		Init(DEFAULT_DICT_SIZE);
+
+	// Make room first, as growing may compact the entries and rebuild
+	// the slot index.
+	if ( entries_len == entries_cap )
+		GrowEntries();
+
+	uint32 mask = num_slots - 1;
+	uint32 tag = hash_tag(hash);
+	int free_slot = -1;
+	uint32 i;
+
+	for ( i = hash & mask; ; i = (i + 1) & mask )
+		{
+		DictSlot& s = slots[i];
+
+		if ( s.pos == SLOT_EMPTY )
+			break;
+
+		if ( s.pos == SLOT_DELETED )
+			{
+			if ( free_slot < 0 )
+				free_slot = i;
+
+			continue;
+			}
+
+		if ( s.tag != tag )
+			continue;
+
+		DictEntry& e = entries[s.pos];
+
+		if ( e.hash == hash && e.len == key_size &&
+		     ! memcmp(key, e.key, key_size) )
+			{
+			// Key is already present. As in the chained
+			// version, we own the caller's key and don't need it.
+			if ( ! copy_key )
+				delete [] (char*) key;
+
+			void* old_value = e.value;
+			e.value = val;
+			return old_value;
+			}
+		}
+
+	if ( free_slot >= 0 )
+		{
+		i = free_slot;
+		--num_deleted_slots;
+		}
+
+	if ( copy_key )
+		{
+		void* old_key = key;
+		key = (void*) new char[key_size];
+		memcpy(key, old_key, key_size);
+		}
+
+	DictEntry& e = entries[entries_len];
+	e.key = key;
+	e.len = key_size;
+	e.hash = hash;
+	e.value = val;
+
+	slots[i].pos = entries_len++;
+	slots[i].tag = tag;
+
+	++cumulative_entries;
+	if ( max_num_entries < ++num_entries )
+		max_num_entries = num_entries;
+
+	// Keep the load factor, including deleted markers, at or below
+	// 2/3. Rebuilding the index doesn't move entries, so it's safe
+	// during robust iterations.
+	if ( (num_entries + num_deleted_slots) * 3 >= num_slots * 2 )
+		Rehash(slots_for(num_entries * 2));
+
+	return 0;
+	}
+
+void* Dictionary::Remove(const void* key, int key_size, hash_t hash,
+				bool dont_delete)
+	{
+	if ( ! num_entries )
+		return 0;
+
+	int i = FindSlot(key, key_size, hash);
+
+	if ( i < 0 )
+		return 0;
+
+	DictEntry& e = entries[slots[i].pos];
+	void* entry_value = e.value;
+
+	if ( ! dont_delete )
+		delete [] (char*) e.key;
+
+	e.key = 0;
+	e.len = -1;
+	e.value = 0;
+
+	slots[i].pos = SLOT_DELETED;
+	++num_deleted_slots;
+	--num_entries;
+
+	// Ordered dictionaries need NthEntry() to stay cheap; for the
+	// others we only bother once holes make up most of the array.
+	if ( cookies.length() == 0 &&
+	     (ordered || entries_len - num_entries > num_entries) )
+		Compact();
+
+	return entry_value;
+	}
+
+void* Dictionary::NthEntry(int n, const void*& key, int& key_len) const
+	{
+	if ( ! ordered || n < 0 || n >= Length() )
+		return 0;
+
+	const DictEntry* entry = 0;
+
+	if ( entries_len == num_entries )
+		entry = &entries[n];
+	else
+		{
+		// Holes left while an iteration was active.
+		for ( int i = 0; i < entries_len; ++i )
+			{
+			if ( entries[i].len < 0 )
+				continue;
+
+			if ( n-- == 0 )
+				{
+				entry = &entries[i];
+				break;
+				}
+			}
+		}
+
+	if ( ! entry )
+		return 0;
+
+	key = entry->key;
+	key_len = entry->len;
+	return entry->value;
+	}
+
+IterCookie* Dictionary::InitForIteration() const
+	{
+	return new IterCookie(0);
+	}
+
+void Dictionary::StopIteration(IterCookie* cookie) const
+	{
+	delete cookie;
+	}
+
+void* Dictionary::NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) const
+	{
+	while ( cookie->pos < entries_len && entries[cookie->pos].len < 0 )
+		++cookie->pos;
+
+	if ( cookie->pos >= entries_len )
+		{
+		// All done.
+		const_cast<PList(IterCookie)*>(&cookies)->remove(cookie);
+		delete cookie;
+		cookie = 0;
+		return 0;
+		}
+
+	const DictEntry& entry = entries[cookie->pos++];
+
+	if ( return_hash )
+		h = new HashKey(entry.key, entry.len, entry.hash, hash_policy);
+
+	return entry.value;
+	}
+
+void Dictionary::Rehash(int new_num_slots)
+	{
+	// Rebuilding the index happens in one go, so each one counts as a
+	// complete resize consisting of a single step.
+	double start = current_time(true);
+
+	huge_free(slots);
+
+	num_slots = new_num_slots;
+	slots = huge_new_array<DictSlot>(num_slots);
+
+	for ( int i = 0; i < num_slots; ++i )
+		slots[i].pos = SLOT_EMPTY;
+
+	num_deleted_slots = 0;
+
+	uint32 mask = num_slots - 1;
+
+	for ( int p = 0; p < entries_len; ++p )
+		{
+		const DictEntry& e = entries[p];
+
+		if ( e.len < 0 )
+			continue;
+
+		uint32 i = e.hash & mask;
+
+		while ( slots[i].pos != SLOT_EMPTY )
+			i = (i + 1) & mask;
+
+		slots[i].pos = p;
+		slots[i].tag = hash_tag(e.hash);
+		}
+
+	++resize_stats.resizes;
+	++resize_stats.completed;
+	RecordResizeStep(num_entries, start);
+	}
+
+void Dictionary::Compact()
+	{
+	if ( cookies.length() > 0 )
+		reporter->InternalError("Dictionary::Compact() during iteration");
+
+	int n = 0;
+
+	for ( int p = 0; p < entries_len; ++p )
+		{
+		if ( entries[p].len < 0 )
+			continue;
+
+		if ( n != p )
+			entries[n] = entries[p];
+
+		++n;
+		}
+
+	entries_len = n;
+	Rehash(slots_for(num_entries > DEFAULT_DICT_SIZE ?
+	                 num_entries : DEFAULT_DICT_SIZE));
+	}
+
+void Dictionary::GrowEntries()
+	{
+	// If removals left a lot of holes, reclaim them instead of
+	// growing. We can't move entries while robust cookies are active.
+	if ( cookies.length() == 0 && entries_len - num_entries >= entries_len / 4 )
+		{
+		Compact();
+
+		if ( entries_len < entries_cap )
+			return;
+		}
+
+	int new_cap = entries_cap * 2;
+	DictEntry* new_entries = huge_new_array<DictEntry>(new_cap);
+	memcpy(new_entries, entries, entries_len * sizeof(DictEntry));
+
+	huge_free(entries);
+	entries = new_entries;
+	entries_cap = new_cap;
+	}
+
+unsigned int Dictionary::MemoryAllocation() const
+	{
+	int size = padded_sizeof(*this);
+
+	if ( ! entries )
+		return size;
+
+	for ( int i = 0; i < entries_len; ++i )
+		if ( entries[i].len >= 0 )
+			size += pad_size(entries[i].len);
+
+	size += pad_size(entries_cap * sizeof(DictEntry));
+	size += pad_size(num_slots * sizeof(DictSlot));
+
+	return size;
+	}
+
+unsigned int Dictionary::MemoryAllocationEstimate(unsigned int key_size) const
+	{
+	unsigned int size = padded_sizeof(*this);
+
+	if ( ! entries )
+		return size;
+
+	size += num_entries * pad_size(key_size);
+	size += pad_size(entries_cap * sizeof(DictEntry));
+	size += pad_size(num_slots * sizeof(DictSlot));
+
+	return size;
+	}
+
+#endif
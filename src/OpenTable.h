@@ -0,0 +1,135 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef opentable_h
+#define opentable_h
+
+#include <vector>
+
+#include "util.h"
+
+// A hash table of small fixed-size entries with open addressing and
+// linear probing, for the per-packet tables that a Dictionary with its
+// HashKeys and chains is too costly for. The number of slots is a power
+// of two, doubling whenever the table gets half full. Removing an entry
+// moves up the ones behind it instead of leaving a tombstone, so lookups
+// never need to look past the end of a cluster.
+//
+// A value-initialized T is an empty slot. Entries further provide:
+//
+//	bool Used() const			false for an empty slot
+//	hash_t Hash() const			picks the home slot
+//	bool Matches(const K& key) const	for Find() with keys of type K
+//
+// Pointers to entries are good until the next Insert() or Remove().
+template<class T>
+class OpenTable {
+public:
+	// The slots get allocated with the first Insert().
+	explicit OpenTable(uint32 arg_initial_slots)
+		{
+		initial_slots = arg_initial_slots;
+		mask = 0;
+		num_entries = 0;
+		}
+
+	// Returns the slot of the entry with the given hash and key, or
+	// NumSlots() if there's none.
+	template<class K>
+	uint32 Find(hash_t hash, const K& key) const
+		{
+		if ( ! num_entries )
+			return slots.size();
+
+		for ( uint32 i = hash & mask; slots[i].Used(); i = (i + 1) & mask )
+			{
+			if ( slots[i].Hash() == hash && slots[i].Matches(key) )
+				return i;
+			}
+
+		return slots.size();
+		}
+
+	// Returns an empty slot for a new entry with the given hash, which
+	// the caller then fills in so that it's Used().
+	T* Insert(hash_t hash)
+		{
+		if ( 2 * (num_entries + 1) > slots.size() )
+			Grow();
+
+		uint32 i = hash & mask;
+
+		while ( slots[i].Used() )
+			i = (i + 1) & mask;
+
+		++num_entries;
+		return &slots[i];
+		}
+
+	// Empties the given slot.
+	void Remove(uint32 slot)
+		{
+		slots[slot] = T();
+		--num_entries;
+
+		// Move each following entry of the cluster into the hole if
+		// that's no further from its home slot than where it is.
+		uint32 hole = slot;
+
+		for ( uint32 i = (slot + 1) & mask; slots[i].Used(); i = (i + 1) & mask )
+			{
+			uint32 home = slots[i].Hash() & mask;
+
+			if ( ((i - home) & mask) >= ((i - hole) & mask) )
+				{
+				slots[hole] = slots[i];
+				slots[i] = T();
+				hole = i;
+				}
+			}
+		}
+
+	// Empties all slots, keeping their memory.
+	void Clear()
+		{
+		slots.assign(slots.size(), T());
+		num_entries = 0;
+		}
+
+	// For going through the slots, including empty ones.
+	uint32 NumSlots() const			{ return slots.size(); }
+	uint32 Mask() const			{ return mask; }
+	T& operator[](uint32 i)			{ return slots[i]; }
+	const T& operator[](uint32 i) const	{ return slots[i]; }
+
+	int Size() const	{ return num_entries; }
+
+protected:
+	void Grow()
+		{
+		std::vector<T> old;
+		old.swap(slots);
+
+		slots.resize(old.empty() ? initial_slots : 2 * old.size());
+		mask = slots.size() - 1;
+
+		for ( uint32 i = 0; i < old.size(); ++i )
+			{
+			if ( ! old[i].Used() )
+				continue;
+
+			uint32 j = old[i].Hash() & mask;
+
+			while ( slots[j].Used() )
+				j = (j + 1) & mask;
+
+			slots[j] = old[i];
+			}
+		}
+
+	std::vector<T> slots;
+	uint32 initial_slots;
+	uint32 mask;
+	uint32 num_entries;
+};
+
+#endif
@@ -0,0 +1,215 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "Optimize.h"
+#include "Traverse.h"
+#include "Reporter.h"
+
+// We only fold values of these types, as the contents of aggregates may
+// still be modified even if they're constant.
+static bool is_atomic_type(TypeTag t)
+	{
+	switch ( t ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+	case TYPE_STRING:
+	case TYPE_ENUM:
+	case TYPE_PORT:
+	case TYPE_ADDR:
+	case TYPE_SUBNET:
+		return true;
+
+	default:
+		return false;
+	}
+	}
+
+// Returns true if it's safe to treat the given global as a constant:
+// nothing can change it once parsing is done.
+static bool is_constant_global(const ID* id)
+	{
+	return id->IsGlobal() && id->IsConst() && ! id->IsOption() &&
+		id->ID_Val() && is_atomic_type(id->Type()->Tag());
+	}
+
+// Returns a new reference to the value of the expression if it's known
+// already, or nil if it's not.
+static Val* constant_value(const Expr* e)
+	{
+	switch ( e->Tag() ) {
+	case EXPR_CONST:
+		return e->ExprVal()->Ref();
+
+	case EXPR_NAME:
+		{
+		ID* id = e->AsNameExpr()->Id();
+		return is_constant_global(id) ? id->ID_Val()->Ref() : 0;
+		}
+
+	case EXPR_AND_AND:
+	case EXPR_OR_OR:
+		{
+		const BinaryExpr* b = static_cast<const BinaryExpr*>(e);
+
+		if ( b->Type()->Tag() != TYPE_BOOL )
+			return 0;
+
+		Val* v1 = constant_value(b->Op1());
+
+		if ( ! v1 )
+			return 0;
+
+		// If the first operand decides the result, the second one
+		// won't ever get evaluated.
+		bool decisive = (e->Tag() == EXPR_AND_AND) == v1->IsZero();
+
+		if ( decisive )
+			return v1;
+
+		Unref(v1);
+		return constant_value(b->Op2());
+		}
+
+	case EXPR_NOT:
+	case EXPR_NEGATE:
+	case EXPR_POSITIVE:
+	case EXPR_COMPLEMENT:
+		{
+		Val* v = constant_value(static_cast<const UnaryExpr*>(e)->Op());
+
+		if ( ! v )
+			return 0;
+
+		Unref(v);
+		break;
+		}
+
+	// Division and modulo are left alone, as they may raise run-time
+	// errors that shouldn't be reported before they actually occur.
+	case EXPR_ADD:
+	case EXPR_SUB:
+	case EXPR_TIMES:
+	case EXPR_AND:
+	case EXPR_OR:
+	case EXPR_XOR:
+	case EXPR_LT:
+	case EXPR_LE:
+	case EXPR_EQ:
+	case EXPR_NE:
+	case EXPR_GE:
+	case EXPR_GT:
+		{
+		const BinaryExpr* b = static_cast<const BinaryExpr*>(e);
+		Val* v1 = constant_value(b->Op1());
+		Val* v2 = v1 ? constant_value(b->Op2()) : 0;
+
+		Unref(v1);
+
+		if ( ! v2 )
+			return 0;
+
+		Unref(v2);
+		break;
+		}
+
+	default:
+		return 0;
+	}
+
+	// All operands are constant, so we can evaluate the expression
+	// without a frame.
+	if ( ! is_atomic_type(e->Type()->Tag()) )
+		return 0;
+
+	try
+		{
+		return e->Eval(0);
+		}
+
+	catch ( InterpreterException& )
+		{
+		return 0;
+		}
+	}
+
+class ScriptOptimizer : public TraversalCallback {
+public:
+	ScriptOptimizer()
+		{ num_ifs = num_folded = num_stmts = num_dropped = 0; }
+
+	TraversalCode PreStmt(const Stmt* s) override
+		{
+		if ( s->Tag() != STMT_NULL )
+			++num_stmts;
+
+		if ( s->Tag() != STMT_IF )
+			return TC_CONTINUE;
+
+		++num_ifs;
+
+		IfStmt* if_stmt = const_cast<IfStmt*>(static_cast<const IfStmt*>(s));
+		Val* v = constant_value(if_stmt->StmtExpr());
+
+		if ( ! v )
+			return TC_CONTINUE;
+
+		const Stmt* dead = v->IsZero() ?
+			if_stmt->TrueBranch() : if_stmt->FalseBranch();
+		num_dropped += CountStmts(dead);
+
+		if_stmt->FoldCondition(v);
+		++num_folded;
+
+		return TC_CONTINUE;
+		}
+
+	int num_ifs;
+	int num_folded;
+	int num_stmts;	// statements left, not counting null ones
+	int num_dropped;
+
+private:
+	// Counts the statements in the given subtree (except null ones).
+	class StmtCounter : public TraversalCallback {
+	public:
+		StmtCounter()	{ n = 0; }
+
+		TraversalCode PreStmt(const Stmt* s) override
+			{
+			if ( s->Tag() != STMT_NULL )
+				++n;
+
+			return TC_CONTINUE;
+			}
+
+		int n;
+	};
+
+	static int CountStmts(const Stmt* s)
+		{
+		StmtCounter cb;
+		s->Traverse(&cb);
+		return cb.n;
+		}
+};
+
+void optimize_scripts(bool report)
+	{
+	ScriptOptimizer cb;
+	traverse_all(&cb);
+
+	if ( ! report )
+		return;
+
+	fprintf(stderr, "optimizer: %d statements before, %d after\n",
+	        cb.num_stmts + cb.num_dropped, cb.num_stmts);
+	fprintf(stderr, "optimizer: folded %d of %d if conditions, "
+	        "dropping %d statements\n",
+	        cb.num_folded, cb.num_ifs, cb.num_dropped);
+	}
@@ -0,0 +1,14 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Optimizations applied to the script AST once all scripts are parsed.
+
+#ifndef optimize_h
+#define optimize_h
+
+// Folds conditions of "if" statements that depend only on constants,
+// including non-option "const" globals whose final values are known by
+// now, and drops the branches that can never be taken.  If report is
+// true, prints statistics about what changed to stderr.
+extern void optimize_scripts(bool report);
+
+#endif
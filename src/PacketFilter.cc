@@ -1,5 +1,12 @@
 #include "PacketFilter.h"
 
+PacketFilter::PacketFilter(bool arg_default)
+	{
+	default_match = arg_default;
+	memset(proto_set, 0, sizeof(proto_set));
+	num_protos = 0;
+	}
+
 void PacketFilter::AddSrc(const IPAddr& src, uint32 tcp_flags, double probability)
 	{
 	Filter* f = new Filter;
@@ -52,19 +59,127 @@ bool PacketFilter::RemoveDst(Val* dst)
 	return dst_filter.Remove(dst) != NULL;
 	}
 
+bool PacketFilter::AddProto(uint32 proto, double probability)
+	{
+	if ( proto >= 256 )
+		return false;
+
+	if ( ! proto_set[proto] )
+		{
+		proto_set[proto] = true;
+		++num_protos;
+		}
+
+	proto_filter[proto] = uint32(probability * RAND_MAX);
+	return true;
+	}
+
+bool PacketFilter::RemoveProto(uint32 proto)
+	{
+	if ( proto >= 256 || ! proto_set[proto] )
+		return false;
+
+	proto_set[proto] = false;
+	--num_protos;
+	return true;
+	}
+
+static bool port_key(const PortVal* port, uint32* key)
+	{
+	if ( port->IsTCP() )
+		*key = (IPPROTO_TCP << 16) | port->Port();
+	else if ( port->IsUDP() )
+		*key = (IPPROTO_UDP << 16) | port->Port();
+	else
+		return false;
+
+	return true;
+	}
+
+bool PacketFilter::AddPort(const PortVal* port, double probability)
+	{
+	uint32 key;
+
+	if ( ! port_key(port, &key) )
+		return false;
+
+	port_filter[key] = uint32(probability * RAND_MAX);
+	return true;
+	}
+
+bool PacketFilter::RemovePort(const PortVal* port)
+	{
+	uint32 key;
+
+	if ( ! port_key(port, &key) )
+		return false;
+
+	return port_filter.erase(key) != 0;
+	}
+
 bool PacketFilter::Match(const IP_Hdr* ip, int len, int caplen)
 	{
-	Filter* f = (Filter*) src_filter.Lookup(ip->SrcAddr(), 128);
-	if ( f )
-		return MatchFilter(*f, *ip, len, caplen);
+	// Both lookups at once are cheaper than one after the other, even
+	// if the second one may turn out unnecessary.
+	const PrefixTable* tables[2] = { &src_filter, &dst_filter };
+	IPAddr addrs[2] = { ip->SrcAddr(), ip->DstAddr() };
+	void* filters[2];
+	PrefixTable::Lookup(tables, addrs, 2, filters);
+
+	for ( int i = 0; i < 2; ++i )
+		{
+		Filter* f = (Filter*) filters[i];
+		if ( f )
+			return MatchFilter(*f, *ip, len, caplen);
+		}
 
-	f = (Filter*) dst_filter.Lookup(ip->DstAddr(), 128);
-	if ( f )
-		return MatchFilter(*f, *ip, len, caplen);
+	if ( num_protos )
+		{
+		unsigned char proto = ip->NextProto();
+
+		if ( proto_set[proto] )
+			return uint32(bro_random()) < proto_filter[proto];
+		}
+
+	if ( ! port_filter.empty() )
+		{
+		int64 probability = MatchPorts(*ip, len, caplen);
+
+		if ( probability >= 0 )
+			return uint32(bro_random()) < uint32(probability);
+		}
 
 	return default_match;
 	}
 
+int64 PacketFilter::MatchPorts(const IP_Hdr& ip, int len, int caplen)
+	{
+	uint32 proto = ip.NextProto();
+
+	if ( (proto != IPPROTO_TCP && proto != IPPROTO_UDP) || ip.FragOffset() )
+		return -1;
+
+	// Caution! The packet sanity checks have not been performed yet
+	int ip_hdr_len = ip.HdrLen();
+	len -= ip_hdr_len;
+	caplen -= ip_hdr_len;
+
+	// Both TCP and UDP start with the two ports.
+	if ( len < 4 || caplen < 4 )
+		return -1;
+
+	const u_char* data = ip.Payload();
+	uint32 sport = (data[0] << 8) | data[1];
+	uint32 dport = (data[2] << 8) | data[3];
+
+	PortMap::const_iterator i = port_filter.find((proto << 16) | sport);
+
+	if ( i == port_filter.end() )
+		i = port_filter.find((proto << 16) | dport);
+
+	return i == port_filter.end() ? -1 : int64(i->second);
+	}
+
 bool PacketFilter::MatchFilter(const Filter& f, const IP_Hdr& ip,
 				int len, int caplen)
 	{
@@ -3,12 +3,14 @@
 #ifndef PACKETFILTER_H
 #define PACKETFILTER_H
 
+#include <map>
+
 #include "IP.h"
 #include "PrefixTable.h"
 
 class PacketFilter {
 public:
-	explicit PacketFilter(bool arg_default)	{ default_match = arg_default; }
+	explicit PacketFilter(bool arg_default);
 	~PacketFilter()	{}
 
 	// Drops all packets from a particular source (which may be given
@@ -26,6 +28,17 @@ public:
 	bool RemoveDst(const IPAddr& dst);
 	bool RemoveDst(Val* dst);
 
+	// Drops all packets of a given IP protocol with the given
+	// probability.  Returns false for a protocol number beyond 255.
+	bool AddProto(uint32 proto, double probability);
+	bool RemoveProto(uint32 proto);
+
+	// Drops all TCP or UDP packets with the given port as either source
+	// or destination with the given probability.  Returns false for
+	// ports of other transports.
+	bool AddPort(const PortVal* port, double probability);
+	bool RemovePort(const PortVal* port);
+
 	// Returns true if packet matches a drop filter
 	bool Match(const IP_Hdr* ip, int len, int caplen);
 
@@ -37,9 +50,23 @@ private:
 
 	bool MatchFilter(const Filter& f, const IP_Hdr& ip, int len, int caplen);
 
+	// Returns the probability to drop the packet with according to the
+	// port filters, or -1 if none applies.
+	int64 MatchPorts(const IP_Hdr& ip, int len, int caplen);
+
+	// Ports are keyed by their protocol in the upper half.
+	typedef std::map<uint32, uint32> PortMap;
+
 	bool default_match;
 	PrefixTable src_filter;
 	PrefixTable dst_filter;
+
+	// Probabilities to drop packets of a protocol with, if set.
+	bool proto_set[256];
+	uint32 proto_filter[256];
+	int num_protos;
+
+	PortMap port_filter;
 };
 
 #endif
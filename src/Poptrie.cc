@@ -0,0 +1,150 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <algorithm>
+
+#include "Poptrie.h"
+
+static bool shorter(const Poptrie::Prefix& a, const Poptrie::Prefix& b)
+	{
+	return a.len < b.len;
+	}
+
+Poptrie::Poptrie()
+	{
+	std::vector<Prefix> none;
+	Build(&none);
+	}
+
+void Poptrie::Build(std::vector<Prefix>* prefixes, void* def)
+	{
+	// With the shorter prefixes first, longer ones overwrite their
+	// results below.
+	std::stable_sort(prefixes->begin(), prefixes->end(), shorter);
+
+	std::vector<const Prefix*> all;
+	all.reserve(prefixes->size());
+
+	for ( const auto& p : *prefixes )
+		all.push_back(&p);
+
+	nodes.clear();
+	leaves.clear();
+	nodes.resize(1);
+	BuildNode(0, 0, all, def);
+
+	nodes.shrink_to_fit();
+	leaves.shrink_to_fit();
+	}
+
+void Poptrie::Lookup(const Poptrie* const* tries, const uint64* hi,
+                     const uint64* lo, void** results, int n)
+	{
+	for ( int base = 0; base < n; base += BATCH )
+		{
+		const Node* current[BATCH];
+		int active[BATCH];
+		int num_active = 0;
+
+		for ( int i = base; i < n && i < base + BATCH; ++i )
+			{
+			current[i - base] = &tries[i]->nodes[0];
+			active[num_active++] = i;
+			}
+
+		for ( int depth = 0; num_active; depth += STRIDE )
+			{
+			int still_active = 0;
+
+			for ( int j = 0; j < num_active; ++j )
+				{
+				int i = active[j];
+				const Poptrie* t = tries[i];
+				const Node* nd = current[i - base];
+
+				uint64 bit = uint64(1) << Chunk(hi[i], lo[i], depth);
+				uint64 upto = (bit << 1) - 1;
+
+				if ( ! (nd->children & bit) )
+					{
+					results[i] = t->leaves[nd->base_leaves +
+					                       __builtin_popcountll(nd->runs & upto) - 1];
+					continue;
+					}
+
+				nd = &t->nodes[nd->base_children +
+				               __builtin_popcountll(nd->children & upto) - 1];
+
+				// By the time we get back to this walk, the
+				// node will hopefully have arrived.
+				__builtin_prefetch(nd);
+				current[i - base] = nd;
+				active[still_active++] = i;
+				}
+
+			num_active = still_active;
+			}
+		}
+	}
+
+void Poptrie::BuildNode(uint32 n, int depth,
+                        const std::vector<const Prefix*>& prefixes, void* def)
+	{
+	void* results[FANOUT];
+	std::vector<const Prefix*> below[FANOUT];
+
+	std::fill(results, results + FANOUT, def);
+
+	for ( const auto p : prefixes )
+		{
+		unsigned int slot = Chunk(p->hi, p->lo, depth);
+
+		if ( p->len > depth + STRIDE )
+			{
+			below[slot].push_back(p);
+			continue;
+			}
+
+		// Covers a range of slots.
+		unsigned int num = 1 << (depth + STRIDE - p->len);
+		std::fill(results + slot, results + slot + num, p->data);
+		}
+
+	uint64 children = 0;
+	uint64 runs = 0;
+	uint32 base_leaves = leaves.size();
+	bool first = true;
+
+	for ( int i = 0; i < FANOUT; ++i )
+		{
+		if ( ! below[i].empty() )
+			{
+			children |= uint64(1) << i;
+			continue;
+			}
+
+		// A child in between doesn't end a run.
+		if ( first || results[i] != leaves.back() )
+			{
+			runs |= uint64(1) << i;
+			leaves.push_back(results[i]);
+			first = false;
+			}
+		}
+
+	// The children get their places before any of them adds its own.
+	uint32 base_children = nodes.size();
+	nodes.resize(nodes.size() + __builtin_popcountll(children));
+
+	nodes[n].children = children;
+	nodes[n].runs = runs;
+	nodes[n].base_children = base_children;
+	nodes[n].base_leaves = base_leaves;
+
+	uint32 child = base_children;
+
+	for ( int i = 0; i < FANOUT; ++i )
+		{
+		if ( ! below[i].empty() )
+			BuildNode(child++, depth + STRIDE, below[i], results[i]);
+		}
+	}
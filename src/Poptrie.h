@@ -0,0 +1,103 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef POPTRIE_H
+#define POPTRIE_H
+
+#include <vector>
+
+#include "util.h"
+
+// A multibit trie for longest-prefix matching (Asai and Ohara, "Poptrie: A
+// Compressed Trie with Population Count for Fast and Scalable Software IP
+// Routing Table Lookup", SIGCOMM 2015). Each node covers six bits of the
+// key and keeps two bitmaps instead of an array of 64 entries: one marking
+// the slots that continue in a child, the other marking where a run of
+// slots with the same result starts. A population count of the bitmaps
+// then gives the position of the child or the result, and children and
+// results of a node sit next to each other.
+//
+// The trie can't be changed, it gets built from the complete set of
+// prefixes at once.
+class Poptrie {
+public:
+	// A prefix with its key in host order, most significant bit first.
+	// Bits beyond the prefix's length must be zero.
+	struct Prefix {
+		uint64 hi;
+		uint64 lo;
+		int len;
+		void* data;
+	};
+
+	Poptrie();
+
+	// Replaces the trie's contents. Addresses matching none of the
+	// prefixes map to def. Reorders the prefixes.
+	void Build(std::vector<Prefix>* prefixes, void* def = 0);
+
+	// Returns the data of the longest prefix matching the key, or the
+	// default.
+	void* Lookup(uint64 hi, uint64 lo) const
+		{
+		const Node* n = &nodes[0];
+
+		for ( int depth = 0; ; depth += STRIDE )
+			{
+			uint64 bit = uint64(1) << Chunk(hi, lo, depth);
+			uint64 upto = (bit << 1) - 1;
+
+			if ( ! (n->children & bit) )
+				return leaves[n->base_leaves +
+				              __builtin_popcountll(n->runs & upto) - 1];
+
+			n = &nodes[n->base_children +
+			           __builtin_popcountll(n->children & upto) - 1];
+			}
+		}
+
+	// Looks up many keys at once, the i-th one in tries[i]. The walks
+	// proceed in lockstep, so that their memory accesses overlap.
+	static void Lookup(const Poptrie* const* tries, const uint64* hi,
+	                   const uint64* lo, void** results, int n);
+
+private:
+	static const int STRIDE = 6;
+	static const int FANOUT = 1 << STRIDE;
+
+	// The number of walks interleaved at a time.
+	static const int BATCH = 16;
+
+	struct Node {
+		uint64 children;	// Slots continuing in a child.
+		uint64 runs;		// Slots starting a new result.
+		uint32 base_children;
+		uint32 base_leaves;
+	};
+
+	// Returns the STRIDE bits of the key starting at depth.
+	static unsigned int Chunk(uint64 hi, uint64 lo, int depth)
+		{
+		if ( depth + STRIDE <= 64 )
+			return (hi >> (64 - STRIDE - depth)) & (FANOUT - 1);
+
+		if ( depth < 64 )
+			return ((hi << (depth + STRIDE - 64)) |
+			        (lo >> (128 - STRIDE - depth))) & (FANOUT - 1);
+
+		if ( depth + STRIDE <= 128 )
+			return (lo >> (128 - STRIDE - depth)) & (FANOUT - 1);
+
+		if ( depth < 128 )
+			return (lo << (depth + STRIDE - 128)) & (FANOUT - 1);
+
+		return 0;
+		}
+
+	void BuildNode(uint32 n, int depth,
+	               const std::vector<const Prefix*>& prefixes, void* def);
+
+	std::vector<Node> nodes;
+	std::vector<void*> leaves;
+};
+
+#endif
@@ -1,6 +1,107 @@
+#include <algorithm>
+
 #include "PrefixTable.h"
 #include "Reporter.h"
 
+// Converts an address from network order into a key for a Poptrie, with
+// all bits beyond the width cleared.
+static void make_key(const in6_addr& addr, int width, uint64* hi, uint64* lo)
+	{
+	*hi = *lo = 0;
+
+	for ( int i = 0; i < 8; ++i )
+		{
+		*hi = (*hi << 8) | addr.s6_addr[i];
+		*lo = (*lo << 8) | addr.s6_addr[i + 8];
+		}
+
+	if ( width < 64 )
+		{
+		*hi &= width ? ~uint64(0) << (64 - width) : 0;
+		*lo = 0;
+		}
+
+	else if ( width < 128 )
+		*lo &= width > 64 ? ~uint64(0) << (128 - width) : 0;
+	}
+
+static bool is_v4_mapped(uint64 hi, uint64 lo)
+	{
+	// ::ffff:0:0/96
+	return hi == 0 && (lo >> 32) == 0xffff;
+	}
+
+PrefixTable::PrefixTable()
+	{
+	tree = New_Patricia(128);
+	v4_trie = v6_trie = 0;
+	lookups = 0;
+	}
+
+PrefixTable::~PrefixTable()
+	{
+	Destroy_Patricia(tree, 0);
+	delete v4_trie;
+	delete v6_trie;
+	}
+
+void PrefixTable::Changed()
+	{
+	delete v4_trie;
+	delete v6_trie;
+	v4_trie = v6_trie = 0;
+	lookups = 0;
+	}
+
+void PrefixTable::BuildTries() const
+	{
+	std::vector<Poptrie::Prefix> v4;
+	std::vector<Poptrie::Prefix> v6;
+
+	// The longest prefix covering all of the IPv4 space.
+	in6_addr v4_space;
+	IPAddr("0.0.0.0").CopyIPv6(&v4_space);
+	void* v4_default = 0;
+	int v4_default_len = -1;
+
+	patricia_node_t* node;
+
+	PATRICIA_WALK(tree->head, node) {
+		Poptrie::Prefix p;
+		p.len = node->prefix->bitlen;
+		p.data = node->data;
+		make_key(node->prefix->add.sin6, p.len, &p.hi, &p.lo);
+
+		if ( p.len >= 96 && is_v4_mapped(p.hi, p.lo) )
+			{
+			p.hi = p.lo << 32;
+			p.lo = 0;
+			p.len -= 96;
+			v4.push_back(p);
+			}
+
+		else
+			{
+			uint64 hi, lo;
+			make_key(v4_space, p.len, &hi, &lo);
+
+			if ( hi == p.hi && lo == p.lo && p.len > v4_default_len )
+				{
+				v4_default = p.data;
+				v4_default_len = p.len;
+				}
+
+			v6.push_back(p);
+			}
+	} PATRICIA_WALK_END;
+
+	v4_trie = new Poptrie();
+	v4_trie->Build(&v4, v4_default);
+
+	v6_trie = new Poptrie();
+	v6_trie->Build(&v6);
+	}
+
 prefix_t* PrefixTable::MakePrefix(const IPAddr& addr, int width)
 	{
 	prefix_t* prefix = (prefix_t*) safe_malloc(sizeof(prefix_t));
@@ -30,6 +131,8 @@ void* PrefixTable::Insert(const IPAddr& addr, int width, void* data)
 		return 0;
 		}
 
+	Changed();
+
 	void* old = node->data;
 
 	// If there is no data to be associated with addr, we take the
@@ -85,20 +188,122 @@ list<tuple<IPPrefix,void*>> PrefixTable::FindAll(const SubNetVal* value) const
 	return FindAll(value->AsSubNet().Prefix(), value->AsSubNet().LengthIPv6());
 	}
 
+bool PrefixTable::UseTries(uint64 n) const
+	{
+	if ( v4_trie )
+		return true;
+
+	// Building the tries takes about as long as a couple of lookups per
+	// prefix.
+	lookups += n;
+
+	if ( lookups <= 2 * uint64(tree->num_active_node) + 16 )
+		return false;
+
+	BuildTries();
+	return true;
+	}
+
+void PrefixTable::TrieKey(const IPAddr& addr, const Poptrie** trie,
+                          uint64* hi, uint64* lo) const
+	{
+	in6_addr a;
+	addr.CopyIPv6(&a);
+	make_key(a, 128, hi, lo);
+
+	if ( addr.GetFamily() == IPv4 )
+		{
+		*hi = *lo << 32;
+		*lo = 0;
+		*trie = v4_trie;
+		}
+	else
+		*trie = v6_trie;
+	}
+
 void* PrefixTable::Lookup(const IPAddr& addr, int width, bool exact) const
+	{
+	if ( exact || width != 128 || ! UseTries(1) )
+		return LookupPatricia(addr, width, exact);
+
+	const Poptrie* trie;
+	uint64 hi, lo;
+	TrieKey(addr, &trie, &hi, &lo);
+
+	return trie->Lookup(hi, lo);
+	}
+
+void* PrefixTable::LookupPatricia(const IPAddr& addr, int width, bool exact) const
 	{
 	prefix_t* prefix = MakePrefix(addr, width);
 	patricia_node_t* node =
 		exact ? patricia_search_exact(tree, prefix) :
 			patricia_search_best(tree, prefix);
 
-	int elems = 0;
-	patricia_node_t** list = nullptr;
-
 	Deref_Prefix(prefix);
 	return node ? node->data : 0;
 	}
 
+// The number of lookups prepared on the stack at a time.
+static const int BATCH = 64;
+
+void PrefixTable::Lookup(const IPAddr* addrs, int n, void** results) const
+	{
+	if ( ! UseTries(n) )
+		{
+		for ( int i = 0; i < n; ++i )
+			results[i] = LookupPatricia(addrs[i], 128, false);
+
+		return;
+		}
+
+	const Poptrie* tries[BATCH];
+	uint64 hi[BATCH];
+	uint64 lo[BATCH];
+
+	for ( int base = 0; base < n; base += BATCH )
+		{
+		int m = std::min(n - base, BATCH);
+
+		for ( int i = 0; i < m; ++i )
+			TrieKey(addrs[base + i], &tries[i], &hi[i], &lo[i]);
+
+		Poptrie::Lookup(tries, hi, lo, results + base, m);
+		}
+	}
+
+void PrefixTable::Lookup(const PrefixTable* const* tables, const IPAddr* addrs,
+                         int n, void** results)
+	{
+	const Poptrie* tries[BATCH];
+	uint64 hi[BATCH];
+	uint64 lo[BATCH];
+	void* found[BATCH];
+	int pos[BATCH];
+
+	for ( int base = 0; base < n; base += BATCH )
+		{
+		int m = 0;
+
+		for ( int i = base; i < n && i < base + BATCH; ++i )
+			{
+			if ( ! tables[i]->UseTries(1) )
+				{
+				results[i] = tables[i]->LookupPatricia(addrs[i], 128, false);
+				continue;
+				}
+
+			tables[i]->TrieKey(addrs[i], &tries[m], &hi[m], &lo[m]);
+			pos[m++] = i;
+			}
+
+		Poptrie::Lookup(tries, hi, lo, found, m);
+
+		for ( int j = 0; j < m; ++j )
+			results[pos[j]] = found[j];
+		}
+	}
+
 void* PrefixTable::Lookup(const Val* value, bool exact) const
 	{
 	// [elem] -> elem
@@ -132,6 +337,8 @@ void* PrefixTable::Remove(const IPAddr& addr, int width)
 	if ( ! node )
 		return 0;
 
+	Changed();
+
 	void* old = node->data;
 	patricia_remove(tree, node);
 
@@ -4,6 +4,7 @@
 #include "Val.h"
 #include "net_util.h"
 #include "IPAddr.h"
+#include "Poptrie.h"
 
 extern "C" {
 	#include "patricia.h"
@@ -19,8 +20,8 @@ private:
 	};
 
 public:
-	PrefixTable()	{ tree = New_Patricia(128); }
-	~PrefixTable()	{ Destroy_Patricia(tree, 0); }
+	PrefixTable();
+	~PrefixTable();
 
 	// Addr in network byte order. If data is zero, acts like a set.
 	// Returns ptr to old data if already existing.
@@ -36,6 +37,14 @@ public:
 	void* Lookup(const IPAddr& addr, int width, bool exact = false) const;
 	void* Lookup(const Val* value, bool exact = false) const;
 
+	// Longest-prefix matches for many addresses at once, which is
+	// faster than one at a time. Fills in results like Lookup() would.
+	void Lookup(const IPAddr* addrs, int n, void** results) const;
+
+	// Longest-prefix matches of addrs[i] in tables[i], all at once.
+	static void Lookup(const PrefixTable* const* tables, const IPAddr* addrs,
+	                   int n, void** results);
+
 	// Returns list of all found matches or empty list otherwise.
 	list<tuple<IPPrefix,void*>> FindAll(const IPAddr& addr, int width) const;
 	list<tuple<IPPrefix,void*>> FindAll(const SubNetVal* value) const;
@@ -44,7 +53,7 @@ public:
 	void* Remove(const IPAddr& addr, int width);
 	void* Remove(const Val* value);
 
-	void Clear()	{ Clear_Patricia(tree, 0); }
+	void Clear()	{ Clear_Patricia(tree, 0); Changed(); }
 
 	iterator InitIterator();
 	void* GetNext(iterator* i);
@@ -53,7 +62,30 @@ private:
 	static prefix_t* MakePrefix(const IPAddr& addr, int width);
 	static IPPrefix PrefixToIPPrefix(prefix_t* p);
 
+	void* LookupPatricia(const IPAddr& addr, int width, bool exact) const;
+
+	// Drops the tries, they'll get rebuilt once worthwhile again.
+	void Changed();
+	void BuildTries() const;
+
+	// Accounts for n lookups about to happen and returns whether they
+	// should go through the tries, which it builds if needed.
+	bool UseTries(uint64 n) const;
+
+	// Returns the trie to look up an address in, and its key there.
+	void TrieKey(const IPAddr& addr, const Poptrie** trie,
+	             uint64* hi, uint64* lo) const;
+
 	patricia_tree_t* tree;
+
+	// Longest-prefix matches of single addresses go through these once
+	// enough lookups have been done since the last change to pay for
+	// building them. The patricia tree remains the authority for
+	// everything else. IPv4 addresses get their own trie so that their
+	// lookups don't have to go through the 96 bits of the mapped prefix.
+	mutable Poptrie* v4_trie;
+	mutable Poptrie* v6_trie;
+	mutable uint64 lookups;
 };
 
 #endif
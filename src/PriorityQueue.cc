@@ -6,13 +6,14 @@
 #include <stdlib.h>
 
 #include "PriorityQueue.h"
+#include "HugePages.h"
 #include "Reporter.h"
 #include "util.h"
 
 PriorityQueue::PriorityQueue(int initial_size)
 	{
 	max_heap_size = initial_size;
-	heap = new PQ_Element*[max_heap_size];
+	heap = huge_new_array<PQ_Element*>(max_heap_size);
 	peak_heap_size = heap_size = cumulative_num = 0;
 	}
 
@@ -21,7 +22,7 @@ PriorityQueue::~PriorityQueue()
 	for ( int i = 0; i < heap_size; ++i )
 		delete heap[i];
 
-	delete [] heap;
+	huge_free(heap);
 	}
 
 PQ_Element* PriorityQueue::Remove()
@@ -75,11 +76,11 @@ int PriorityQueue::Add(PQ_Element* e)
 
 int PriorityQueue::Resize(int new_size)
 	{
-	PQ_Element** tmp = new PQ_Element*[new_size];
+	PQ_Element** tmp = huge_new_array<PQ_Element*>(new_size);
 	for ( int i = 0; i < max_heap_size; ++i )
 		tmp[i] = heap[i];
 
-	delete [] heap;
+	huge_free(heap);
 	heap = tmp;
 
 	max_heap_size = new_size;
@@ -0,0 +1,55 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Static tracing probes (USDT) for external profilers. Tools like perf,
+// bpftrace and SystemTap can attach to them in a running, unmodified
+// binary, which lets them attribute the time spent in the interpreter to
+// script functions and events. A probe nobody attached to is a single nop.
+//
+// All probes belong to the "zeek" provider:
+//
+//   event__start(name), event__done(name)
+//	Around dispatching an event to all of its handlers.
+//
+//   function__entry(name, file, line), function__return(name)
+//	Around calls of script functions, hooks, event handlers and BIFs.
+//	The location is where the function was defined; it's the empty
+//	string and 0 for BIFs.
+//
+//   packet__start(ts_usec, caplen), packet__done()
+//	Around processing a packet, including draining the events it raised.
+//
+//   timer__start(type), timer__done(type)
+//	Around dispatching a timer, with the name of its type.
+//
+//   log__write(stream)
+//	When a script writes to a log stream, with the stream's name.
+//
+// Names are C strings. For example, to count calls per script function:
+//
+//   bpftrace -e 'usdt:/usr/local/zeek/bin/zeek:zeek:function__entry
+//		{ @[str(arg0)] = count(); }'
+
+#ifndef PROBES_H
+#define PROBES_H
+
+#include "zeek-config.h"
+
+#ifdef USE_USDT
+
+#include <sys/sdt.h>
+
+#define ZEEK_PROBE(name) DTRACE_PROBE(zeek, name)
+#define ZEEK_PROBE1(name, a) DTRACE_PROBE1(zeek, name, a)
+#define ZEEK_PROBE2(name, a, b) DTRACE_PROBE2(zeek, name, a, b)
+#define ZEEK_PROBE3(name, a, b, c) DTRACE_PROBE3(zeek, name, a, b, c)
+
+#else
+
+#define ZEEK_PROBE(name)
+#define ZEEK_PROBE1(name, a)
+#define ZEEK_PROBE2(name, a, b)
+#define ZEEK_PROBE3(name, a, b, c)
+
+#endif
+
+#endif
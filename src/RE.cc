@@ -237,22 +237,22 @@ int Specific_RE_Matcher::MatchAll(const u_char* bv, int n)
 		// matched is empty.
 		return n == 0;
 
-	DFA_State* d = dfa->StartState();
-	d = d->Xtion(ecs[SYM_BOL], dfa);
+	int d = dfa->StartStateNum();
+	d = dfa->NextStateNum(d, ecs[SYM_BOL]);
 
-	while ( d )
+	while ( d >= 0 )
 		{
 		if ( --n < 0 )
 			break;
 
 		int ec = ecs[*(bv++)];
-		d = d->Xtion(ec, dfa);
+		d = dfa->NextStateNum(d, ec);
 		}
 
-	if ( d )
-		d = d->Xtion(ecs[SYM_EOL], dfa);
+	if ( d >= 0 )
+		d = dfa->NextStateNum(d, ecs[SYM_EOL]);
 
-	return d && d->Accept() != 0;
+	return d >= 0 && dfa->IsAccepting(d);
 	}
 
 
@@ -262,26 +262,26 @@ int Specific_RE_Matcher::Match(const u_char* bv, int n)
 		// An empty pattern matches anything.
 		return 1;
 
-	DFA_State* d = dfa->StartState();
+	int d = dfa->StartStateNum();
 
-	d = d->Xtion(ecs[SYM_BOL], dfa);
-	if ( ! d ) return 0;
+	d = dfa->NextStateNum(d, ecs[SYM_BOL]);
+	if ( d < 0 ) return 0;
 
 	for ( int i = 0; i < n; ++i )
 		{
 		int ec = ecs[bv[i]];
-		d = d->Xtion(ec, dfa);
-		if ( ! d )
+		d = dfa->NextStateNum(d, ec);
+		if ( d < 0 )
 			break;
 
-		if ( d->Accept() )
+		if ( dfa->IsAccepting(d) )
 			return i + 1;
 		}
 
-	if ( d )
+	if ( d >= 0 )
 		{
-		d = d->Xtion(ecs[SYM_EOL], dfa);
-		if ( d && d->Accept() )
+		d = dfa->NextStateNum(d, ecs[SYM_EOL]);
+		if ( d >= 0 && dfa->IsAccepting(d) )
 			return n > 0 ? n : 1;	// we can't return 0 here for match...
 		}
 
@@ -303,6 +303,28 @@ inline void RE_Match_State::AddMatches(const AcceptingSet& as,
 		accepted_matches.insert(am_idx(*it, position));
 	}
 
+RE_Match_State::~RE_Match_State()
+	{
+	Unref(saved_state);
+	}
+
+void RE_Match_State::SaveState()
+	{
+	DFA_State* s = current_state >= 0 ? dfa->State(current_state) : 0;
+
+	if ( s != saved_state )
+		{
+		if ( s )
+			Ref(s);
+
+		Unref(saved_state);
+		saved_state = s;
+		}
+
+	if ( dfa )
+		generation = dfa->Generation();
+	}
+
 bool RE_Match_State::Match(const u_char* bv, int n,
 				bool bol, bool eol, bool clear)
 	{
@@ -314,19 +336,23 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 
 		// Initialize state and copy the accepting states of the start
 		// state into the acceptance set.
-		current_state = dfa->StartState();
-
-		const AcceptingSet* ac = current_state->Accept();
+		current_state = dfa->StartStateNum();
 
-		if ( ac )
-			AddMatches(*ac, 0);
+		if ( current_state >= 0 && dfa->IsAccepting(current_state) )
+			AddMatches(*dfa->Accept(current_state), 0);
 		}
 
 	else if ( clear )
-		current_state = dfa->StartState();
+		current_state = dfa->StartStateNum();
+
+	else if ( current_state >= 0 && generation != dfa->Generation() )
+		current_state = dfa->Resume(saved_state);
 
-	if ( ! current_state )
+	if ( current_state < 0 )
+		{
+		SaveState();
 		return false;
+		}
 
 	current_pos = 0;
 
@@ -343,26 +369,43 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 		else if ( m == -1 )
 			ec = ecs[SYM_EOL];
 		else
-			ec = ecs[*(bv++)];
+			{
+			// Skip over bytes that don't take us anywhere. This
+			// can't miss any matches, as these would have been
+			// recorded when we entered the state.
+			int skip = dfa->SkipLength(current_state, bv, m + 1);
+
+			if ( skip )
+				{
+				bv += skip;
+				m -= skip;
+				current_pos += skip;
+
+				if ( m < e )
+					break;
+				}
+
+			ec = m >= 0 ? ecs[*(bv++)] : ecs[SYM_EOL];
+			}
 
-		DFA_State* next_state = current_state->Xtion(ec,dfa);
+		int next_state = dfa->NextStateNum(current_state, ec);
 
-		if ( ! next_state )
+		if ( next_state < 0 )
 			{
-			current_state = 0;
+			current_state = -1;
 			break;
 			}
 
-		const AcceptingSet* ac = next_state->Accept();
-
-		if ( ac )
-			AddMatches(*ac, current_pos);
+		if ( dfa->IsAccepting(next_state) )
+			AddMatches(*dfa->Accept(next_state), current_pos);
 
 		++current_pos;
 
 		current_state = next_state;
 		}
 
+	SaveState();
+
 	return accepted_matches.size() != old_matches;
 	}
 
@@ -374,31 +417,31 @@ int Specific_RE_Matcher::LongestMatch(const u_char* bv, int n)
 
 	// Use -1 to indicate no match.
 	int last_accept = -1;
-	DFA_State* d = dfa->StartState();
+	int d = dfa->StartStateNum();
 
-	d = d->Xtion(ecs[SYM_BOL], dfa);
-	if ( ! d )
+	d = dfa->NextStateNum(d, ecs[SYM_BOL]);
+	if ( d < 0 )
 		return -1;
 
-	if ( d->Accept() )
+	if ( dfa->IsAccepting(d) )
 		last_accept = 0;
 
 	for ( int i = 0; i < n; ++i )
 		{
 		int ec = ecs[bv[i]];
-		d = d->Xtion(ec, dfa);
+		d = dfa->NextStateNum(d, ec);
 
-		if ( ! d )
+		if ( d < 0 )
 			break;
 
-		if ( d->Accept() )
+		if ( dfa->IsAccepting(d) )
 			last_accept = i + 1;
 		}
 
-	if ( d )
+	if ( d >= 0 )
 		{
-		d = d->Xtion(ecs[SYM_EOL], dfa);
-		if ( d && d->Accept() )
+		d = dfa->NextStateNum(d, ecs[SYM_EOL]);
+		if ( d >= 0 && dfa->IsAccepting(d) )
 			return n;
 		}
 
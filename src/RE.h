@@ -140,15 +140,24 @@ public:
 		dfa = matcher->DFA() ? matcher->DFA() : 0;
 		ecs = matcher->EC()->EquivClasses();
 		current_pos = -1;
-		current_state = 0;
+		current_state = -1;
+		saved_state = 0;
+		generation = 0;
 		}
 
+	~RE_Match_State();
+
 	const AcceptingMatchSet& AcceptedMatches() const
 		{ return accepted_matches; }
 
 	// Returns the number of bytes feeded into the matcher so far
 	int Length()	{ return current_pos; }
 
+	// Returns true if the DFA has jammed, so that no further input
+	// can lead to new matches until the state is cleared.
+	bool Jammed() const
+		{ return ! dfa || (current_pos >= 0 && current_state < 0); }
+
 	// Returns true if this inputs leads to at least one new match.
 	// If clear is true, starts matching over.
 	bool Match(const u_char* bv, int n, bool bol, bool eol, bool clear);
@@ -156,7 +165,8 @@ public:
 	void Clear()
 		{
 		current_pos = -1;
-		current_state = 0;
+		current_state = -1;
+		SaveState();
 		accepted_matches.clear();
 		}
 
@@ -166,9 +176,16 @@ protected:
 	DFA_Machine* dfa;
 	int* ecs;
 
+	// Keeps a reference to the current state, so that we can find
+	// it again if the DFA drops its states between calls to Match().
+	void SaveState();
+
 	AcceptingMatchSet accepted_matches;
-	DFA_State* current_state;
+	int current_state;	// state number in the DFA, -1 if none
 	int current_pos;
+
+	DFA_State* saved_state;	// current_state, if any
+	unsigned int generation;	// of the DFA when saved
 };
 
 class RE_Matcher {
@@ -212,6 +229,8 @@ public:
 	const char* PatternText() const	{ return re_exact->PatternText(); }
 	const char* AnywherePatternText() const	{ return re_anywhere->PatternText(); }
 
+	Specific_RE_Matcher* AnywhereMatcher() const	{ return re_anywhere; }
+
 	unsigned int MemoryAllocation() const
 		{
 		return padded_sizeof(*this)
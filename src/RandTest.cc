@@ -13,6 +13,7 @@
 */
 
 #include <math.h>
+#include <string.h>
 #include "RandTest.h"
 
 #define log2of10 3.32192809488736234787
@@ -23,7 +24,7 @@ static double rt_log2(double x)
 }
 
 // RT_INCIRC = pow(pow(256.0, (double) (RT_MONTEN / 2)) - 1, 2.0);
-#define RT_INCIRC 281474943156225.0
+#define RT_INCIRC 281474943156225ULL
 
 RandTest::RandTest()
 	{
@@ -39,54 +40,146 @@ RandTest::RandTest()
 		}
 	}
 
+/*  RT_MONTECOORDS  --  Get Monte Carlo co-ordinates from a group of bytes  */
+static inline void rt_montecoords(const unsigned char *group, uint64 *x, uint64 *y)
+{
+    uint64 mx = 0, my = 0;
+
+    for (int mj = 0; mj < RT_MONTEN / 2; mj++)
+        {
+        mx = (mx << 8) | group[mj];
+        my = (my << 8) | group[(RT_MONTEN / 2) + mj];
+        }
+
+    *x = mx;
+    *y = my;
+}
+
+// Below this, counting into a single histogram is as fast as setting up
+// several of them.
+#define RT_LANE_MIN 1024
+
+// Number of histograms counted into at once. Consecutive bytes go to
+// different ones, so that runs of equal bytes don't stall on updating the
+// same counter over and over.
+#define RT_LANES 4
+
 void RandTest::add(const void *buf, int bufl)
 	{
 	const unsigned char *bp = static_cast<const unsigned char*>(buf);
-	int oc;
 
-	while (bufl-- > 0)
+	if (bufl <= 0)
+		return;
+
+	totalc += bufl;
+
+	/* Update counters for the bins. The sums for the serial
+	   correlation coefficient that don't depend on the order of
+	   the bytes come out of the counts. */
+	uint64 t2 = 0, t3 = 0;
+
+	if (bufl < RT_LANE_MIN)
 		{
-		oc = *bp++;
-		ccount[oc]++;   /* Update counter for this bin */
-		totalc++;
-
-		/* Update inside / outside circle counts for Monte Carlo
- 		   computation of PI */
-		monte[mp++] = oc;  /* Save character for Monte Carlo */
-		if (mp >= RT_MONTEN)  /* Calculate every RT_MONTEN character */
+		for (int i = 0; i < bufl; i++)
 			{
-			mp = 0;
-			mcount++;
-			montex = 0;
-			montey = 0;
-			for (int mj=0; mj < RT_MONTEN/2; mj++)
-				{
-				montex = (montex * 256.0) + monte[mj];
-				montey = (montey * 256.0) + monte[(RT_MONTEN / 2) + mj];
-				}
-			if (montex*montex + montey*montey <= RT_INCIRC)
-				{
-				inmont++;
-				}
+			uint64 oc = bp[i];
+			ccount[oc]++;
+			t2 += oc;
+			t3 += oc * oc;
 			}
+		}
+	else
+		{
+		uint32 lanes[RT_LANES][256];
+		memset(lanes, 0, sizeof(lanes));
+
+		int i = 0;
 
-		/* Update calculation of serial correlation coefficient */
-		if (sccfirst)
+		for ( ; i + RT_LANES <= bufl; i += RT_LANES)
+			for (int l = 0; l < RT_LANES; l++)
+				lanes[l][bp[i + l]]++;
+
+		for ( ; i < bufl; i++)
+			lanes[0][bp[i]]++;
+
+		for (uint64 c = 0; c < 256; c++)
 			{
-			sccfirst = 0;
-			scclast = 0;
-			sccu0 = oc;
+			uint64 n = 0;
+
+			for (int l = 0; l < RT_LANES; l++)
+				n += lanes[l][c];
+
+			ccount[c] += n;
+			t2 += c * n;
+			t3 += c * c * n;
 			}
-		else
+		}
+
+	/* Update inside / outside circle counts for Monte Carlo
+	   computation of PI, every RT_MONTEN characters. First finish
+	   a group left incomplete by the previous call. */
+	int i = 0;
+	int64 groups = 0, inside = 0;
+	uint64 x = 0, y = 0;
+
+	if (mp > 0)
+		{
+		while (mp < RT_MONTEN && i < bufl)
+			monte[mp++] = bp[i++];
+
+		if (mp == RT_MONTEN)
 			{
-			scct1 = scct1 + scclast * oc;
+			unsigned char group[RT_MONTEN];
+
+			for (int mj = 0; mj < RT_MONTEN; mj++)
+				group[mj] = monte[mj];
+
+			rt_montecoords(group, &x, &y);
+			groups++;
+			inside += (x * x + y * y <= RT_INCIRC);
+			mp = 0;
 			}
+		}
 
-		scct2 = scct2 + oc;
-		scct3 = scct3 + (oc * oc);
-		scclast = oc;
-		oc <<= 1;
+	for ( ; i + RT_MONTEN <= bufl; i += RT_MONTEN)
+		{
+		rt_montecoords(bp + i, &x, &y);
+		groups++;
+		inside += (x * x + y * y <= RT_INCIRC);
 		}
+
+	if (groups)
+		{
+		mcount += groups;
+		inmont += inside;
+		montex = x;
+		montey = y;
+		}
+
+	/* Save the rest for the next call */
+	while (i < bufl)
+		monte[mp++] = bp[i++];
+
+	/* Update calculation of serial correlation coefficient. The
+	   sums are integers, so adding them up per call gives the same
+	   doubles as adding them up per byte, as long as they stay below
+	   2^53. */
+	if (sccfirst)
+		{
+		sccfirst = 0;
+		scclast = 0;
+		sccu0 = bp[0];
+		}
+
+	uint64 t1 = uint64(scclast) * bp[0];
+
+	for (int j = 1; j < bufl; j++)
+		t1 += uint64(bp[j - 1]) * bp[j];
+
+	scct1 += t1;
+	scct2 += t2;
+	scct3 += t3;
+	scclast = bp[bufl - 1];
 	}
 
 void RandTest::end(double* r_ent, double* r_chisq,
@@ -15,7 +15,7 @@ DataBlock::DataBlock(Reassembler* reass, const u_char* data,
 	{
 	seq = arg_seq;
 	upper = seq + size;
-	block = new u_char[size];
+	block = reinterpret_cast<u_char*>(this + 1);
 
 	memcpy((void*) block, (const void*) data, size);
 
@@ -30,9 +30,12 @@ DataBlock::DataBlock(Reassembler* reass, const u_char* data,
 	reassembler = reass;
 	reassembler->size_of_all_blocks += size;
 
+	if ( reassembler->size_of_all_blocks > reassembler->stats.peak_buffered )
+		reassembler->stats.peak_buffered = reassembler->size_of_all_blocks;
+
 	rtype = reassem_type;
-	Reassembler::sizes[rtype] += pad_size(size) + padded_sizeof(DataBlock);
-	Reassembler::total_size += pad_size(size) + padded_sizeof(DataBlock);
+	Reassembler::sizes[rtype] += Allocation(size);
+	Reassembler::total_size += Allocation(size);
 	}
 
 uint64 Reassembler::total_size = 0;
@@ -42,7 +45,7 @@ Reassembler::Reassembler(uint64 init_seq, ReassemblerType reassem_type)
 	:  blocks(), last_block(), old_blocks(), last_old_block(),
 	  last_reassem_seq(init_seq), trim_seq(init_seq),
 	  max_old_blocks(0), total_old_blocks(0), size_of_all_blocks(0),
-	  rtype(reassem_type)
+	  stats(), rtype(reassem_type)
 	{
 	}
 
@@ -52,29 +55,29 @@ Reassembler::~Reassembler()
 	ClearOldBlocks();
 	}
 
-void Reassembler::CheckOverlap(DataBlock *head, DataBlock *tail,
+void Reassembler::CheckOverlap(const DataBlockMap& m,
 					uint64 seq, uint64 len, const u_char* data)
 	{
-	if ( ! head || ! tail )
+	if ( m.empty() )
 		return;
 
-	if ( seq == tail->upper )
+	if ( seq == m.rbegin()->first )
 		// Special case check for common case of appending to the end.
 		return;
 
 	uint64 upper = (seq + len);
 
-	for ( DataBlock* b = head; b; b = b->next )
+	// The first block that doesn't end at or before the new data.
+	for ( DataBlockMap::const_iterator it = m.upper_bound(seq);
+	      it != m.end(); ++it )
 		{
+		DataBlock* b = it->second;
 		uint64 nseq = seq;
 		uint64 nupper = upper;
 		const u_char* ndata = data;
 
 		if ( nupper <= b->seq )
-			continue;
-
-		if ( nseq >= b->upper )
-			continue;
+			break;
 
 		if ( nseq < b->seq )
 			{
@@ -100,13 +103,13 @@ void Reassembler::NewBlock(double t, uint64 seq, uint64 len, const u_char* data)
 
 	uint64 upper_seq = seq + len;
 
-	CheckOverlap(old_blocks, last_old_block, seq, len, data);
+	CheckOverlap(old_block_map, seq, len, data);
 
 	if ( upper_seq <= trim_seq )
 		// Old data, don't do any work for it.
 		return;
 
-	CheckOverlap(blocks, last_block, seq, len, data);
+	CheckOverlap(block_map, seq, len, data);
 
 	if ( seq < trim_seq )
 		{ // Partially old data, just keep the good stuff.
@@ -117,13 +120,16 @@ void Reassembler::NewBlock(double t, uint64 seq, uint64 len, const u_char* data)
 		len -= amount_old;
 		}
 
+	if ( seq > last_reassem_seq )
+		++stats.out_of_order;
+
 	DataBlock* start_block;
 
 	if ( ! blocks )
 		blocks = last_block = start_block =
-			new DataBlock(this, data, len, seq, 0, 0, rtype);
+			InsertBlock(data, len, seq, 0, 0);
 	else
-		start_block = AddAndCheck(blocks, seq, upper_seq, data);
+		start_block = AddAndCheck(seq, upper_seq, data);
 
 	BlockInserted(start_block);
 	}
@@ -174,10 +180,13 @@ uint64 Reassembler::TrimToSeq(uint64 seq)
 				num_missing += seq - blocks->upper;
 			}
 
+		block_map.erase(blocks->upper);
+
 		if ( max_old_blocks )
 			{
 			// Move block over to old_blocks queue.
 			blocks->next = 0;
+			old_block_map[blocks->upper] = blocks;
 
 			if ( last_old_block )
 				{
@@ -196,9 +205,11 @@ uint64 Reassembler::TrimToSeq(uint64 seq)
 			while ( old_blocks && total_old_blocks > max_old_blocks )
 				{
 				DataBlock* next = old_blocks->next;
+				old_block_map.erase(old_blocks->upper);
 				delete old_blocks;
 				old_blocks = next;
 				total_old_blocks--;
+				++stats.old_evicted;
 				}
 			}
 
@@ -238,6 +249,7 @@ void Reassembler::ClearBlocks()
 		}
 
 	last_block = 0;
+	block_map.clear();
 	}
 
 void Reassembler::ClearOldBlocks()
@@ -250,6 +262,8 @@ void Reassembler::ClearOldBlocks()
 		}
 
 	last_old_block = 0;
+	old_block_map.clear();
+	total_old_blocks = 0;
 	}
 
 uint64 Reassembler::TotalSize() const
@@ -268,7 +282,16 @@ void Reassembler::Undelivered(uint64 up_to_seq)
 	last_reassem_seq = up_to_seq;
 	}
 
-DataBlock* Reassembler::AddAndCheck(DataBlock* b, uint64 seq, uint64 upper,
+DataBlock* Reassembler::InsertBlock(const u_char* data, uint64 size,
+					uint64 seq, DataBlock* prev, DataBlock* next)
+	{
+	DataBlock* b = new (size) DataBlock(this, data, size, seq, prev, next,
+	                                    rtype);
+	block_map[b->upper] = b;
+	return b;
+	}
+
+DataBlock* Reassembler::AddAndCheck(uint64 seq, uint64 upper,
 					const u_char* data)
 	{
 	if ( DEBUG_reassem )
@@ -280,32 +303,28 @@ DataBlock* Reassembler::AddAndCheck(DataBlock* b, uint64 seq, uint64 upper,
 	// Special check for the common case of appending to the end.
 	if ( last_block && seq == last_block->upper )
 		{
-		last_block = new DataBlock(this, data, upper - seq,
-		                           seq, last_block, 0, rtype);
+		last_block = InsertBlock(data, upper - seq, seq, last_block, 0);
 		return last_block;
 		}
 
 	// Find the first block that doesn't come completely before the
 	// new data.
-	while ( b->next && b->upper <= seq )
-		b = b->next;
+	DataBlockMap::const_iterator it = block_map.upper_bound(seq);
 
-	if ( b->upper <= seq )
+	if ( it == block_map.end() )
 		{
-		// b is the last block, and it comes completely before
-		// the new block.
-		last_block = new DataBlock(this, data, upper - seq,
-		                           seq, b, 0, rtype);
+		// All blocks come completely before the new block.
+		last_block = InsertBlock(data, upper - seq, seq, last_block, 0);
 		return last_block;
 		}
 
+	DataBlock* b = it->second;
 	DataBlock* new_b = 0;
 
 	if ( upper <= b->seq )
 		{
 		// The new block comes completely before b.
-		new_b = new DataBlock(this, data, upper - seq, seq,
-		                      b->prev, b, rtype);
+		new_b = InsertBlock(data, upper - seq, seq, b->prev, b);
 		if ( b == blocks )
 			blocks = new_b;
 		return new_b;
@@ -316,8 +335,7 @@ DataBlock* Reassembler::AddAndCheck(DataBlock* b, uint64 seq, uint64 upper,
 		{
 		// The new block has a prefix that comes before b.
 		uint64 prefix_len = b->seq - seq;
-		new_b = new DataBlock(this, data, prefix_len, seq,
-		                      b->prev, b, rtype);
+		new_b = InsertBlock(data, prefix_len, seq, b->prev, b);
 		if ( b == blocks )
 			blocks = new_b;
 
@@ -340,9 +358,9 @@ DataBlock* Reassembler::AddAndCheck(DataBlock* b, uint64 seq, uint64 upper,
 		seq += overlap_len;
 
 		if ( new_b == b )
-			new_b = AddAndCheck(b, seq, upper, data);
+			new_b = AddAndCheck(seq, upper, data);
 		else
-			(void) AddAndCheck(b, seq, upper, data);
+			(void) AddAndCheck(seq, upper, data);
 		}
 
 	if ( new_b->prev == last_block )
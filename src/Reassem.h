@@ -3,6 +3,8 @@
 #ifndef reassem_h
 #define reassem_h
 
+#include <map>
+
 #include "Obj.h"
 #include "IPAddr.h"
 
@@ -20,6 +22,8 @@ enum ReassemblerType {
 
 class Reassembler;
 
+// A block's data is stored right behind it, in the same allocation; the
+// size must be passed to new, e.g. "new (len) DataBlock(r, data, len, ...)".
 class DataBlock {
 public:
 	DataBlock(Reassembler* reass, const u_char* data,
@@ -29,12 +33,23 @@ public:
 
 	~DataBlock();
 
+	static void* operator new(size_t n, uint64 size)
+		{ return ::operator new(n + size); }
+	static void operator delete(void* p)
+		{ ::operator delete(p); }
+	static void operator delete(void* p, uint64 size)
+		{ ::operator delete(p); }
+
+	// Memory taken up by a block holding the given amount of data.
+	static uint64 Allocation(uint64 size)
+		{ return pad_size(sizeof(DataBlock) + size); }
+
 	uint64 Size() const	{ return upper - seq; }
 
 	DataBlock* next;	// next block with higher seq #
 	DataBlock* prev;	// previous block with lower seq #
 	uint64 seq, upper;
-	u_char* block;
+	u_char* block;	// points just past the end of the object
 	ReassemblerType rtype;
 
 	Reassembler* reassembler; // Non-owning pointer back to parent.
@@ -70,6 +85,16 @@ public:
 
 	void SetMaxOldBlocks(uint32 count)	{ max_old_blocks = count; }
 
+	// Statistics over the reassembler's lifetime, cheap enough to
+	// always maintain.
+	struct Stats {
+		uint64 out_of_order;	// blocks that arrived above a hole
+		uint64 old_evicted;	// old blocks beyond max_old_blocks
+		uint64 peak_buffered;	// most bytes buffered at once
+	};
+
+	const Stats& GetStats() const	{ return stats; }
+
 protected:
 	Reassembler()	{ }
 
@@ -80,23 +105,34 @@ protected:
 	virtual void BlockInserted(DataBlock* b) = 0;
 	virtual void Overlap(const u_char* b1, const u_char* b2, uint64 n) = 0;
 
-	DataBlock* AddAndCheck(DataBlock* b, uint64 seq,
-				uint64 upper, const u_char* data);
+	// Blocks in a list never overlap, so indexing them by their upper
+	// sequence number finds the first one at or beyond a given seq in
+	// O(log n) rather than walking the list.
+	typedef std::map<uint64, DataBlock*> DataBlockMap;
+
+	DataBlock* AddAndCheck(uint64 seq, uint64 upper, const u_char* data);
+
+	// Creates a new live block and links it in between prev and next.
+	DataBlock* InsertBlock(const u_char* data, uint64 size, uint64 seq,
+				DataBlock* prev, DataBlock* next);
 
-	void CheckOverlap(DataBlock *head, DataBlock *tail,
+	void CheckOverlap(const DataBlockMap& m,
 				uint64 seq, uint64 len, const u_char* data);
 
 	DataBlock* blocks;
 	DataBlock* last_block;
+	DataBlockMap block_map;
 
 	DataBlock* old_blocks;
 	DataBlock* last_old_block;
+	DataBlockMap old_block_map;
 
 	uint64 last_reassem_seq;
 	uint64 trim_seq;	// how far we've trimmed
 	uint32 max_old_blocks;
 	uint32 total_old_blocks;
 	uint64 size_of_all_blocks;
+	Stats stats;
 
 	ReassemblerType rtype;
 
@@ -107,9 +143,8 @@ protected:
 inline DataBlock::~DataBlock()
 	{
 	reassembler->size_of_all_blocks -= Size();
-	Reassembler::total_size -= pad_size(upper - seq) + padded_sizeof(DataBlock);
-	Reassembler::sizes[rtype] -= pad_size(upper - seq) + padded_sizeof(DataBlock);
-	delete [] block;
+	Reassembler::total_size -= Allocation(Size());
+	Reassembler::sizes[rtype] -= Allocation(Size());
 	}
 
 #endif
@@ -76,6 +76,8 @@ void Reporter::InitOptions()
 		Unref(index);
 		delete k;
 		}
+
+	weird_whitelisted.clear();
 	}
 
 void Reporter::Info(const char* fmt, ...)
@@ -244,22 +246,49 @@ void Reporter::WeirdFlowHelper(const IPAddr& orig, const IPAddr& resp, const cha
 	va_end(ap);
 	}
 
-void Reporter::UpdateWeirdStats(const char* name)
+void Reporter::UpdateWeirdStats(WeirdID id)
 	{
 	++weird_count;
-	++weird_count_by_type[name];
+
+	if ( id >= weird_count_by_type.size() )
+		weird_count_by_type.resize(num_weird_ids());
+
+	++weird_count_by_type[id];
+	}
+
+Reporter::WeirdCountMap Reporter::GetWeirdsByType() const
+	{
+	WeirdCountMap m;
+
+	for ( WeirdID id = 0; id < weird_count_by_type.size(); ++id )
+		if ( weird_count_by_type[id] )
+			m[weird_name(id)] = weird_count_by_type[id];
+
+	return m;
+	}
+
+bool Reporter::WeirdOnSamplingWhiteList(WeirdID id)
+	{
+	if ( weird_sampling_whitelist.empty() )
+		return false;
+
+	for ( WeirdID i = weird_whitelisted.size(); i <= id; ++i )
+		weird_whitelisted.push_back(weird_sampling_whitelist.find(weird_name(i)) !=
+		                            weird_sampling_whitelist.end());
+
+	return weird_whitelisted[id];
 	}
 
 class NetWeirdTimer : public Timer {
 public:
-	NetWeirdTimer(double t, const char* name, double timeout)
-	: Timer(t + timeout, TIMER_NET_WEIRD_EXPIRE), weird_name(name)
+	NetWeirdTimer(double t, WeirdID id, double timeout)
+	: Timer(t + timeout, TIMER_NET_WEIRD_EXPIRE), weird(id)
 		{}
 
 	void Dispatch(double t, int is_expire) override
-		{ reporter->ResetNetWeird(weird_name); }
+		{ reporter->ResetNetWeird(weird_name(weird)); }
 
-	std::string weird_name;
+	WeirdID weird;
 };
 
 class FlowWeirdTimer : public Timer {
@@ -278,7 +307,10 @@ public:
 
 void Reporter::ResetNetWeird(const std::string& name)
 	{
-	net_weird_state.erase(name);
+	WeirdID id = weird_id(name.c_str());
+
+	if ( id < net_weird_state.size() )
+		net_weird_state[id] = 0;
 	}
 
 void Reporter::ResetFlowWeird(const IPAddr& orig, const IPAddr& resp)
@@ -286,13 +318,16 @@ void Reporter::ResetFlowWeird(const IPAddr& orig, const IPAddr& resp)
 	flow_weird_state.erase(std::make_pair(orig, resp));
 	}
 
-bool Reporter::PermitNetWeird(const char* name)
+bool Reporter::PermitNetWeird(WeirdID id)
 	{
-	auto& count = net_weird_state[name];
+	if ( id >= net_weird_state.size() )
+		net_weird_state.resize(num_weird_ids());
+
+	auto& count = net_weird_state[id];
 	++count;
 
 	if ( count == 1 )
-		timer_mgr->Add(new NetWeirdTimer(network_time, name,
+		timer_mgr->Add(new NetWeirdTimer(network_time, id,
 		                                 weird_sampling_duration));
 
 	if ( count <= weird_sampling_threshold )
@@ -305,7 +340,7 @@ bool Reporter::PermitNetWeird(const char* name)
 		return false;
 	}
 
-bool Reporter::PermitFlowWeird(const char* name,
+bool Reporter::PermitFlowWeird(WeirdID id,
                                const IPAddr& orig, const IPAddr& resp)
 	{
 	auto endpoints = std::make_pair(orig, resp);
@@ -315,7 +350,7 @@ bool Reporter::PermitFlowWeird(const char* name,
 		timer_mgr->Add(new FlowWeirdTimer(network_time, endpoints,
 		                                  weird_sampling_duration));
 
-	auto& count = map[name];
+	auto& count = map[id];
 	++count;
 
 	if ( count <= weird_sampling_threshold )
@@ -330,11 +365,12 @@ bool Reporter::PermitFlowWeird(const char* name,
 
 void Reporter::Weird(const char* name)
 	{
-	UpdateWeirdStats(name);
+	WeirdID id = weird_id(name);
+	UpdateWeirdStats(id);
 
-	if ( ! WeirdOnSamplingWhiteList(name) )
+	if ( ! WeirdOnSamplingWhiteList(id) )
 		{
-		if ( ! PermitNetWeird(name) )
+		if ( ! PermitNetWeird(id) )
 			return;
 		}
 
@@ -343,11 +379,12 @@ void Reporter::Weird(const char* name)
 
 void Reporter::Weird(file_analysis::File* f, const char* name, const char* addl)
 	{
-	UpdateWeirdStats(name);
+	WeirdID id = weird_id(name);
+	UpdateWeirdStats(id);
 
-	if ( ! WeirdOnSamplingWhiteList(name) )
+	if ( ! WeirdOnSamplingWhiteList(id) )
 		{
-		if ( ! f->PermitWeird(name, weird_sampling_threshold,
+		if ( ! f->PermitWeird(id, weird_sampling_threshold,
 		                      weird_sampling_rate, weird_sampling_duration) )
 			return;
 		}
@@ -357,11 +394,12 @@ void Reporter::Weird(file_analysis::File* f, const char* name, const char* addl)
 
 void Reporter::Weird(Connection* conn, const char* name, const char* addl)
 	{
-	UpdateWeirdStats(name);
+	WeirdID id = weird_id(name);
+	UpdateWeirdStats(id);
 
-	if ( ! WeirdOnSamplingWhiteList(name) )
+	if ( ! WeirdOnSamplingWhiteList(id) )
 		{
-		if ( ! conn->PermitWeird(name, weird_sampling_threshold,
+		if ( ! conn->PermitWeird(id, weird_sampling_threshold,
 		                         weird_sampling_rate, weird_sampling_duration) )
 			return;
 		}
@@ -371,11 +409,12 @@ void Reporter::Weird(Connection* conn, const char* name, const char* addl)
 
 void Reporter::Weird(const IPAddr& orig, const IPAddr& resp, const char* name)
 	{
-	UpdateWeirdStats(name);
+	WeirdID id = weird_id(name);
+	UpdateWeirdStats(id);
 
-	if ( ! WeirdOnSamplingWhiteList(name) )
+	if ( ! WeirdOnSamplingWhiteList(id) )
 		{
-		if ( ! PermitFlowWeird(name, orig, resp) )
+		if ( ! PermitFlowWeird(id, orig, resp) )
 			 return;
 		}
 
@@ -11,10 +11,12 @@
 #include <map>
 #include <unordered_set>
 #include <unordered_map>
+#include <vector>
 
 #include "util.h"
 #include "EventHandler.h"
 #include "IPAddr.h"
+#include "WeirdState.h"
 
 namespace analyzer { class Analyzer; }
 namespace file_analysis { class File; }
@@ -43,7 +45,8 @@ class Reporter {
 public:
 	using IPPair = std::pair<IPAddr, IPAddr>;
 	using WeirdCountMap = std::unordered_map<std::string, uint64>;
-	using WeirdFlowMap = std::map<IPPair, WeirdCountMap>;
+	using WeirdIDCountMap = std::unordered_map<WeirdID, uint64>;
+	using WeirdFlowMap = std::map<IPPair, WeirdIDCountMap>;
 	using WeirdSet = std::unordered_set<std::string>;
 
 	Reporter();
@@ -151,8 +154,7 @@ public:
 	 * Return number of weirds generated per weird type/name (counts weirds
 	 * before any rate-limiting occurs).
 	 */
-	const WeirdCountMap& GetWeirdsByType() const
-		{ return weird_count_by_type; }
+	WeirdCountMap GetWeirdsByType() const;
 
 	/**
 	 * Gets the weird sampling whitelist.
@@ -170,6 +172,7 @@ public:
 	void SetWeirdSamplingWhitelist(const WeirdSet& weird_sampling_whitelist)
 		{
 		this->weird_sampling_whitelist = weird_sampling_whitelist;
+		weird_whitelisted.clear();
 		}
 
 	/**
@@ -249,11 +252,10 @@ private:
 	// contain format specifiers
 	void WeirdHelper(EventHandlerPtr event, Val* conn_val, file_analysis::File* f, const char* addl, const char* fmt_name, ...) __attribute__((format(printf, 6, 7)));;
 	void WeirdFlowHelper(const IPAddr& orig, const IPAddr& resp, const char* fmt_name, ...) __attribute__((format(printf, 4, 5)));;
-	void UpdateWeirdStats(const char* name);
-	inline bool WeirdOnSamplingWhiteList(const char* name)
-		{ return weird_sampling_whitelist.find(name) != weird_sampling_whitelist.end(); }
-	bool PermitNetWeird(const char* name);
-	bool PermitFlowWeird(const char* name, const IPAddr& o, const IPAddr& r);
+	void UpdateWeirdStats(WeirdID id);
+	bool WeirdOnSamplingWhiteList(WeirdID id);
+	bool PermitNetWeird(WeirdID id);
+	bool PermitFlowWeird(WeirdID id, const IPAddr& o, const IPAddr& r);
 
 	bool EmitToStderr(bool flag)
 		{ return flag || ! after_zeek_init; }
@@ -269,11 +271,17 @@ private:
 	std::list<std::pair<const Location*, const Location*> > locations;
 
 	uint64 weird_count;
-	WeirdCountMap weird_count_by_type;
-	WeirdCountMap net_weird_state;
+
+	// Indexed by weird ID, growing as they get used.
+	std::vector<uint64> weird_count_by_type;
+	std::vector<uint64> net_weird_state;
 	WeirdFlowMap flow_weird_state;
 
 	WeirdSet weird_sampling_whitelist;
+
+	// Whether the weird with the given ID is on the whitelist, for the
+	// IDs checked so far.
+	std::vector<bool> weird_whitelisted;
 	uint64 weird_sampling_threshold;
 	uint64 weird_sampling_rate;
 	double weird_sampling_duration;
@@ -10,6 +10,7 @@
 #include "Scope.h"
 #include "File.h"
 #include "Reporter.h"
+#include "PrefixTable.h"
 
 // FIXME: Things that are not fully implemented/working yet:
 //
@@ -38,6 +39,7 @@ RuleHdrTest::RuleHdrTest(Prot arg_prot, uint32 arg_offset, uint32 arg_size,
 	pattern_rules = 0;
 	pure_rules = 0;
 	ruleset = new IntSet;
+	prefix_table = 0;
 	id = ++idcounter;
 	level = 0;
 	}
@@ -55,6 +57,7 @@ RuleHdrTest::RuleHdrTest(Prot arg_prot, Comp arg_comp, vector<IPPrefix> arg_v)
 	pattern_rules = 0;
 	pure_rules = 0;
 	ruleset = new IntSet;
+	prefix_table = 0;
 	id = ++idcounter;
 	level = 0;
 	}
@@ -104,6 +107,7 @@ RuleHdrTest::RuleHdrTest(RuleHdrTest& h)
 	pattern_rules = 0;
 	pure_rules = 0;
 	ruleset = new IntSet;
+	prefix_table = 0;
 	id = ++idcounter;
 	level = 0;
 	}
@@ -121,6 +125,7 @@ RuleHdrTest::~RuleHdrTest()
 		}
 
 	delete ruleset;
+	delete prefix_table;
 	}
 
 bool RuleHdrTest::operator==(const RuleHdrTest& h)
@@ -196,10 +201,14 @@ RuleFileMagicState::~RuleFileMagicState()
 	}
 
 RuleMatcher::RuleMatcher(int arg_RE_level)
+	: rules_by_id(UNORDERED, 0, HASH_FAST)
 	{
 	root = new RuleHdrTest(RuleHdrTest::NOPROT, 0, 0, RuleHdrTest::EQ,
 				new maskedvalue_list);
 	RE_level = arg_RE_level;
+
+	for ( int i = 0; i < Rule::TYPES; ++i )
+		has_patterns[i] = false;
 	}
 
 RuleMatcher::~RuleMatcher()
@@ -282,6 +291,21 @@ void RuleMatcher::BuildRulesTree()
 
 		rules[r]->SortHdrTests();
 		InsertRuleIntoTree(rules[r], 0, root, 0);
+
+		loop_over_list(rules[r]->patterns, j)
+			has_patterns[rules[r]->patterns[j]->type] = true;
+		}
+
+	// Now that equal tests have been merged, precompute the lookups.
+	rule_hdr_test_list tests;
+	tests.append(root);
+
+	loop_over_list(tests, i)
+		{
+		tests[i]->Compile();
+
+		for ( RuleHdrTest* h = tests[i]->child; h; h = h->sibling )
+			tests.append(h);
 		}
 	}
 
@@ -416,6 +440,10 @@ void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
 				new RuleHdrTest::PatternSet;
 			set->re = new Specific_RE_Matcher(MATCH_EXACTLY, 1);
 			set->re->CompileSet(group_exprs, group_ids);
+
+			if ( sig_dfa_precompute_states > 0 && set->re->DFA() )
+				set->re->DFA()->Precompute(sig_dfa_precompute_states);
+
 			set->patterns = group_exprs;
 			set->ids = group_ids;
 			dst->append(set);
@@ -573,6 +601,62 @@ static inline bool compare(const vector<IPPrefix>& prefixes, const IPAddr& a,
 	return false;
 	}
 
+// Minimum number of values for which a header test gets a lookup
+// structure; shorter lists are just as quick to scan.
+#define HDR_TEST_LOOKUP_MIN 4
+
+void RuleHdrTest::Compile()
+	{
+	if ( prot == IPSrc || prot == IPDst )
+		{
+		if ( (comp != EQ && comp != NE) ||
+		     prefix_vals.size() < HDR_TEST_LOOKUP_MIN )
+			return;
+
+		// An address is equal to one of the prefixes exactly if
+		// the longest-prefix lookup finds any of them.
+		prefix_table = new PrefixTable();
+
+		for ( size_t i = 0; i < prefix_vals.size(); ++i )
+			prefix_table->Insert(prefix_vals[i].Prefix(),
+			                     prefix_vals[i].LengthIPv6());
+		return;
+		}
+
+	// The next-protocol test doesn't set a size, but it's a single byte.
+	uint32 bytes = (prot == NEXT ? 1 : size);
+
+	if ( bytes == 0 || bytes > 2 )
+		return;
+
+	// One-byte fields are cheap enough to always tabulate.
+	if ( bytes == 2 && vals->length() < HDR_TEST_LOOKUP_MIN )
+		return;
+
+	uint32 num_values = 1 << (8 * bytes);
+	value_map.assign(num_values / 64, 0);
+
+	for ( uint32 v = 0; v < num_values; ++v )
+		if ( compare(*vals, v, comp) )
+			value_map[v / 64] |= uint64(1) << (v % 64);
+	}
+
+bool RuleHdrTest::MatchValue(uint32 v) const
+	{
+	if ( ! value_map.empty() )
+		return value_map[v / 64] & (uint64(1) << (v % 64));
+
+	return compare(*vals, v, comp);
+	}
+
+bool RuleHdrTest::MatchAddr(const IPAddr& a) const
+	{
+	if ( prefix_table )
+		return (prefix_table->Lookup(a, 128) != 0) == (comp == EQ);
+
+	return compare(prefix_vals, a, comp);
+	}
+
 RuleFileMagicState* RuleMatcher::InitFileMagic() const
 	{
 	RuleFileMagicState* state = new RuleFileMagicState();
@@ -653,6 +737,35 @@ RuleMatcher::MIME_Matches* RuleMatcher::Match(RuleFileMagicState* state,
 
 	DBG_LOG(DBG_RULES, "New pattern match found");
 
+	return MIMEMatches(state, rval);
+	}
+
+bool RuleMatcher::MatchIncremental(RuleFileMagicState* state,
+                                   const u_char* data, uint64 len) const
+	{
+	bool jammed = true;
+
+	loop_over_list(state->matchers, x)
+		{
+		RE_Match_State* m = state->matchers[x]->state;
+
+		// Only the first chunk starts at the beginning of the file.
+		m->Match(data, len, ! state->started, false, false);
+
+		if ( ! m->Jammed() )
+			jammed = false;
+		}
+
+	state->started = true;
+	return jammed;
+	}
+
+RuleMatcher::MIME_Matches* RuleMatcher::MIMEMatches(RuleFileMagicState* state,
+                                                    MIME_Matches* rval) const
+	{
+	if ( ! rval )
+		rval = new MIME_Matches();
+
 	AcceptingMatchSet accepted_matches;
 
 	loop_over_list(state->matchers, y)
@@ -761,36 +874,36 @@ RuleEndpointState* RuleMatcher::InitEndpoint(analyzer::Analyzer* analyzer,
 				// Evaluate the header test.
 				switch ( h->prot ) {
 				case RuleHdrTest::NEXT:
-					match = compare(*h->vals, ip->NextProto(), h->comp);
+					match = h->MatchValue(ip->NextProto());
 					break;
 
 				case RuleHdrTest::IP:
 					if ( ! ip->IP4_Hdr() )
 						continue;
 
-					match = compare(*h->vals, getval((const u_char*)ip->IP4_Hdr() + h->offset, h->size), h->comp);
+					match = h->MatchValue(getval((const u_char*)ip->IP4_Hdr() + h->offset, h->size));
 					break;
 
 				case RuleHdrTest::IPv6:
 					if ( ! ip->IP6_Hdr() )
 						continue;
 
-					match = compare(*h->vals, getval((const u_char*)ip->IP6_Hdr() + h->offset, h->size), h->comp);
+					match = h->MatchValue(getval((const u_char*)ip->IP6_Hdr() + h->offset, h->size));
 					break;
 
 				case RuleHdrTest::ICMP:
 				case RuleHdrTest::ICMPv6:
 				case RuleHdrTest::TCP:
 				case RuleHdrTest::UDP:
-					match = compare(*h->vals, getval(ip->Payload() + h->offset, h->size), h->comp);
+					match = h->MatchValue(getval(ip->Payload() + h->offset, h->size));
 					break;
 
 				case RuleHdrTest::IPSrc:
-					match = compare(h->prefix_vals, ip->IPHeaderSrcAddr(), h->comp);
+					match = h->MatchAddr(ip->IPHeaderSrcAddr());
 					break;
 
 				case RuleHdrTest::IPDst:
-					match = compare(h->prefix_vals, ip->IPHeaderDstAddr(), h->comp);
+					match = h->MatchAddr(ip->IPHeaderDstAddr());
 					break;
 
 				default:
@@ -1103,10 +1216,41 @@ void RuleMatcher::ClearEndpointState(RuleEndpointState* state)
 		state->matchers[j]->state->Clear();
 	}
 
+bool RuleMatcher::PayloadExhausted(RuleEndpointState* state) const
+	{
+	// Pure rules may still fire at the end, or when another rule they
+	// depend on matches.
+	loop_over_list(state->hdr_tests, i)
+		{
+		for ( Rule* r = state->hdr_tests[i]->pure_rules; r; r = r->next )
+			if ( ! state->matched_rules.is_member(r->Index()) )
+				return false;
+		}
+
+	// Same for rules whose patterns have matched already.
+	loop_over_list(state->matched_by_patterns, j)
+		{
+		if ( ! state->matched_rules.is_member(state->matched_by_patterns[j]->Index()) )
+			return false;
+		}
+
+	loop_over_list(state->matchers, k)
+		{
+		RuleEndpointState::Matcher* m = state->matchers[k];
+
+		if ( m->type == Rule::PAYLOAD && ! m->state->Jammed() )
+			return false;
+		}
+
+	return true;
+	}
+
 void RuleMatcher::ClearFileMagicState(RuleFileMagicState* state) const
 	{
 	loop_over_list(state->matchers, j)
 		state->matchers[j]->state->Clear();
+
+	state->started = false;
 	}
 
 void RuleMatcher::PrintDebug()
@@ -1174,6 +1318,7 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test)
 		stats->mem = 0;
 		stats->hits = 0;
 		stats->misses = 0;
+		stats->evictions = 0;
 		stats->nfa_states = 0;
 		hdr_test = root;
 		}
@@ -1195,6 +1340,7 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test)
 			stats->mem += cstats.mem;
 			stats->hits += cstats.hits;
 			stats->misses += cstats.misses;
+			stats->evictions += cstats.evictions;
 			stats->nfa_states += cstats.nfa_states;
 			}
 		}
@@ -1462,6 +1608,19 @@ void RuleMatcherState::Match(Rule::PatternType type, const u_char* data,
 					type, data, data_len, bol, eol, clear);
 	}
 
+bool RuleMatcherState::PayloadExhausted()
+	{
+	if ( ! rule_matcher )
+		return true;
+
+	// Until we have seen both sides, the other one may still match.
+	if ( ! orig_match_state || ! resp_match_state )
+		return false;
+
+	return rule_matcher->PayloadExhausted(orig_match_state) &&
+		rule_matcher->PayloadExhausted(resp_match_state);
+	}
+
 void RuleMatcherState::ClearMatchState(bool orig)
 	{
 	if ( ! rule_matcher )
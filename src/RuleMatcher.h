@@ -70,6 +70,8 @@ extern void id_to_maskedvallist(const char* id, maskedvalue_list* append_to,
 extern char* id_to_str(const char* id);
 extern uint32 id_to_uint(const char* id);
 
+class PrefixTable;
+
 class RuleHdrTest {
 public:
 	// Note: Adapt RuleHdrTest::PrintDebug() when changing these enums.
@@ -92,6 +94,13 @@ private:
 	// Likewise, the operator== checks only for same test semantics.
 	bool operator==(const RuleHdrTest& h);
 
+	// Sets up the lookup structures below, once the tree is complete.
+	void Compile();
+
+	// Evaluate the test for a value extracted from the packet.
+	bool MatchValue(uint32 v) const;
+	bool MatchAddr(const IPAddr& a) const;
+
 	Prot prot;
 	Comp comp;
 	maskedvalue_list* vals;
@@ -99,6 +108,15 @@ private:
 	uint32 offset;
 	uint32 size;
 
+	// For tests on one or two byte fields, a bitmap with the outcome
+	// for every possible value, so that long lists of ports or flags
+	// take a single lookup. Empty if not used.
+	std::vector<uint64> value_map;
+
+	// For == and != tests on longer address lists, the prefixes to
+	// look up in. Null if not used.
+	PrefixTable* prefix_table;
+
 	uint32 id;	// For debugging, each HdrTest gets an unique ID
 	static uint32 idcounter;
 
@@ -206,7 +224,7 @@ private:
 	// Ctor is private; use RuleMatcher::InitFileMagic() for
 	// instantiation.
 	RuleFileMagicState()
-		{ }
+		{ started = false; }
 
 	struct Matcher {
 		RE_Match_State* state;
@@ -216,6 +234,9 @@ private:
 	typedef PList(Matcher) matcher_list;
 
 	matcher_list matchers;
+
+	// Whether RuleMatcher::MatchIncremental() has seen data yet.
+	bool started;
 };
 
 
@@ -261,6 +282,32 @@ public:
 	MIME_Matches* Match(RuleFileMagicState* state, const u_char* data,
 	                   uint64 len, MIME_Matches* matches = 0) const;
 
+	/**
+	 * Matches the next chunk of a file against file magic signatures,
+	 * continuing where the previous call left off.  Use
+	 * RuleMatcher::MIMEMatches() to get the results.
+	 * @param state A state object previously returned from
+	 *              RuleMatcher::InitFileMagic()
+	 * @param data Chunk of data to match signatures against.
+	 * @param len Length of \a data in bytes.
+	 * @return True if no further data can change the results.
+	 */
+	bool MatchIncremental(RuleFileMagicState* state, const u_char* data,
+	                      uint64 len) const;
+
+	/**
+	 * Returns the file magic signatures matched so far.
+	 * @param state A state object previously returned from
+	 *              RuleMatcher::InitFileMagic()
+	 * @param matches An optional pre-existing match result object to
+	 *                modify with additional matches.  If it's a null
+	 *                pointer, one will be instantiated and returned from
+	 *                this method.
+	 * @return The results of the signature matching.
+	 */
+	MIME_Matches* MIMEMatches(RuleFileMagicState* state,
+	                          MIME_Matches* matches = 0) const;
+
 
 	/**
 	 * Resets a state object used with matching file magic signatures.
@@ -288,6 +335,15 @@ public:
 	// Reset the state of the pattern matcher for this endpoint.
 	void ClearEndpointState(RuleEndpointState* state);
 
+	// Returns true if no further payload for this endpoint can lead to
+	// any more rules matching: all payload patterns have failed for
+	// good, and no rule is left waiting on other conditions.
+	bool PayloadExhausted(RuleEndpointState* state) const;
+
+	// Returns true if any active rule has a pattern of the given type.
+	bool HasPatterns(Rule::PatternType type) const
+		{ return has_patterns[type]; }
+
 	void PrintDebug();
 
 	// Interface to parser
@@ -309,6 +365,7 @@ public:
 		// # cache hits (sampled, multiply by MOVE_TO_FRONT_SAMPLE_SIZE)
 		unsigned int hits;
 		unsigned int misses;	// # cache misses
+		unsigned int evictions;	// # DFA states dropped
 	};
 
 	Val* BuildRuleStateValue(const Rule* rule,
@@ -368,6 +425,8 @@ private:
 	RuleHdrTest* root;
 	rule_list rules;
 	rule_dict rules_by_id;
+
+	bool has_patterns[Rule::TYPES];
 };
 
 // Keeps bi-directional matching-state.
@@ -392,6 +451,9 @@ public:
 	bool MatcherInitialized(bool orig)
 		{ return orig ? orig_match_state : resp_match_state; }
 
+	// True if neither direction's payload can trigger any more rules.
+	bool PayloadExhausted();
+
 private:
 	RuleEndpointState* orig_match_state;
 	RuleEndpointState* resp_match_state;
@@ -20,7 +20,8 @@ Scope::Scope(ID* id, attr_list* al)
 	attrs = al;
 	return_type = 0;
 
-	local = new PDict(ID)(ORDERED);
+	// Identifiers are named by the loaded scripts, never by traffic.
+	local = new PDict(ID)(ORDERED, 0, HASH_FAST);
 	inits = new id_list;
 
 	if ( id )
@@ -26,7 +26,7 @@ public:
 	void Insert(const char* name, ID* id)	{ local->Insert(name, id); }
 	ID* Remove(const char* name)
 		{
-		HashKey key(name);
+		HashKey key(name, local->Policy());
 		return (ID*) local->Remove(&key);
 		}
 
@@ -0,0 +1,212 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <sys/time.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "ScriptProfiler.h"
+#include "Func.h"
+#include "Stmt.h"
+
+ScriptProfiler::Frame ScriptProfiler::frames[MAX_DEPTH + 1];
+volatile sig_atomic_t ScriptProfiler::depth = 0;
+ScriptProfiler::Frame* volatile ScriptProfiler::current = &ScriptProfiler::frames[0];
+
+ScriptProfiler::Sample ScriptProfiler::ring[RING_SIZE];
+volatile sig_atomic_t ScriptProfiler::ring_len = 0;
+volatile sig_atomic_t ScriptProfiler::lost = 0;
+pthread_t ScriptProfiler::main_thread;
+
+ScriptProfiler::ScriptProfiler()
+	{
+	active = false;
+	memset(&old_action, 0, sizeof(old_action));
+	}
+
+ScriptProfiler::~ScriptProfiler()
+	{
+	if ( active )
+		Stop();
+	}
+
+bool ScriptProfiler::Start(double interval)
+	{
+	if ( active )
+		Stop();
+
+	main_thread = pthread_self();
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = Handler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+
+	if ( sigaction(SIGPROF, &sa, &old_action) < 0 )
+		return false;
+
+	// An all-zero interval would disable the timer.
+	long usecs = std::max(long(interval * 1e6), 1L);
+
+	struct itimerval it;
+	it.it_interval.tv_sec = usecs / 1000000;
+	it.it_interval.tv_usec = usecs % 1000000;
+	it.it_value = it.it_interval;
+
+	if ( setitimer(ITIMER_PROF, &it, 0) < 0 )
+		{
+		sigaction(SIGPROF, &old_action, 0);
+		return false;
+		}
+
+	active = true;
+	return true;
+	}
+
+void ScriptProfiler::Stop()
+	{
+	if ( ! active )
+		return;
+
+	struct itimerval it;
+	memset(&it, 0, sizeof(it));
+	setitimer(ITIMER_PROF, &it, 0);
+	sigaction(SIGPROF, &old_action, 0);
+
+	active = false;
+	Aggregate();
+	}
+
+bool ScriptProfiler::Write(const char* path)
+	{
+	Aggregate();
+
+	FILE* f = fopen(path, "w");
+
+	if ( ! f )
+		return false;
+
+	for ( auto& s : stacks )
+		fprintf(f, "%s %" PRIu64 "\n", s.first.c_str(), s.second);
+
+	if ( lost )
+		// Samples taken while the ring buffer was full.
+		fprintf(f, "<lost> %d\n", int(lost));
+
+	return fclose(f) == 0;
+	}
+
+void ScriptProfiler::Reset()
+	{
+	Aggregate();
+	stacks.clear();
+	lost = 0;
+	}
+
+uint64 ScriptProfiler::NumSamples()
+	{
+	Aggregate();
+
+	uint64 n = lost;
+
+	for ( auto& s : stacks )
+		n += s.second;
+
+	return n;
+	}
+
+void ScriptProfiler::Push(const Func* func)
+	{
+	// Fill in the frame before making it visible to the signal
+	// handler.
+	int d = std::min(int(depth) + 1, int(MAX_DEPTH));
+	frames[d].func = func;
+	frames[d].stmt = 0;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+
+	depth = depth + 1;
+	current = &frames[d];
+
+	if ( ring_len > RING_SIZE / 2 )
+		script_profiler.Aggregate();
+	}
+
+void ScriptProfiler::Pop()
+	{
+	depth = depth - 1;
+	current = &frames[std::min(int(depth), int(MAX_DEPTH))];
+	}
+
+void ScriptProfiler::Handler(int sig)
+	{
+	// The timer counts the CPU time of all threads, and the signal may
+	// hit any of them. Only the main thread runs scripts, so we ignore
+	// it elsewhere; that leaves the main thread's samples unbiased.
+	if ( ! pthread_equal(pthread_self(), main_thread) )
+		return;
+
+	if ( ring_len >= RING_SIZE )
+		{
+		++lost;
+		return;
+		}
+
+	Sample* s = &ring[ring_len];
+	int d = std::min(int(depth), int(MAX_DEPTH));
+	s->depth = d;
+
+	for ( int i = 0; i < d; ++i )
+		s->frames[i] = frames[i + 1];
+
+	ring_len = ring_len + 1;
+	}
+
+void ScriptProfiler::Aggregate()
+	{
+	if ( ! ring_len )
+		return;
+
+	sigset_t set, old_set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGPROF);
+	pthread_sigmask(SIG_BLOCK, &set, &old_set);
+
+	// Note that we rely on functions and statements staying around,
+	// which they generally do once parsing is done.
+	for ( int i = 0; i < ring_len; ++i )
+		{
+		const Sample& s = ring[i];
+
+		if ( ! s.depth )
+			{
+			++stacks["<core>"];
+			continue;
+			}
+
+		std::string stack;
+
+		for ( int j = 0; j < s.depth; ++j )
+			{
+			if ( j )
+				stack += ';';
+
+			const Func* func = s.frames[j].func;
+			stack += func ? func->Name() : "<unknown>";
+			}
+
+		const Stmt* stmt = s.frames[s.depth - 1].stmt;
+
+		if ( stmt )
+			{
+			const Location* loc = stmt->GetLocationInfo();
+			stack += fmt(";%s:%d", loc->filename ? loc->filename : "<unknown>",
+			             loc->first_line);
+			}
+
+		++stacks[stack];
+		}
+
+	ring_len = 0;
+	pthread_sigmask(SIG_SETMASK, &old_set, 0);
+	}
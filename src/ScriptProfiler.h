@@ -0,0 +1,134 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef SCRIPTPROFILER_H
+#define SCRIPTPROFILER_H
+
+#include <signal.h>
+#include <pthread.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+
+#include "util.h"
+
+class Func;
+class Stmt;
+
+/**
+ * A sampling profiler for the script interpreter.
+ *
+ * The interpreter keeps a cheap shadow of its call stack here, with the
+ * statement each frame is executing. Once started, a CPU time timer
+ * signal snapshots that shadow stack into a ring buffer, which gets
+ * aggregated into counts per distinct stack outside the signal handler.
+ * Time spent outside of scripts counts as "<core>", and time spent in
+ * built-in functions shows with them on top of the stack.
+ */
+class ScriptProfiler {
+public:
+	ScriptProfiler();
+	~ScriptProfiler();
+
+	/**
+	 * Starts sampling.
+	 *
+	 * @param interval The CPU time between samples, in seconds.
+	 *
+	 * @return False if the timer couldn't be set up.
+	 */
+	bool Start(double interval);
+
+	/**
+	 * Stops sampling, keeping what has been sampled so far.
+	 */
+	void Stop();
+
+	/**
+	 * Returns true if sampling.
+	 */
+	bool Active() const	{ return active; }
+
+	/**
+	 * Writes the samples taken so far in the "folded" format that
+	 * flamegraph.pl reads: one line per distinct stack, with its frames
+	 * from the outermost to the innermost separated by semicolons,
+	 * followed by the number of samples. The innermost frame is the
+	 * location of the statement that was executing.
+	 *
+	 * @param path The file to write to.
+	 *
+	 * @return False if the file couldn't be written.
+	 */
+	bool Write(const char* path);
+
+	/**
+	 * Discards the samples taken so far.
+	 */
+	void Reset();
+
+	/**
+	 * Returns the number of samples taken so far.
+	 */
+	uint64 NumSamples();
+
+	/**
+	 * Called by the interpreter before executing a statement.
+	 */
+	static void SetStmt(const Stmt* stmt)	{ current->stmt = stmt; }
+
+	/**
+	 * Pushes a function onto the shadow call stack for the lifetime of
+	 * the instance, so that it gets popped even if the function throws.
+	 */
+	class Call {
+	public:
+		Call(const Func* func)	{ ScriptProfiler::Push(func); }
+		~Call()			{ ScriptProfiler::Pop(); }
+	};
+
+private:
+	// Frames beyond this depth replace the innermost one.
+	static const int MAX_DEPTH = 32;
+
+	// Number of samples that can wait for aggregation.
+	static const int RING_SIZE = 4096;
+
+	struct Frame {
+		const Func* func;
+		const Stmt* stmt;
+	};
+
+	struct Sample {
+		int depth;
+		Frame frames[MAX_DEPTH];
+	};
+
+	static void Push(const Func* func);
+	static void Pop();
+	static void Handler(int sig);
+
+	// Moves the samples from the ring buffer into the counts.
+	void Aggregate();
+
+	// The shadow call stack. The first frame stands for code outside of
+	// any function.
+	static Frame frames[MAX_DEPTH + 1];
+	static volatile sig_atomic_t depth;
+	static Frame* volatile current;
+
+	// Filled by the signal handler, which only takes samples on the
+	// main thread. Aggregate() blocks the signal while emptying it.
+	static Sample ring[RING_SIZE];
+	static volatile sig_atomic_t ring_len;
+	static volatile sig_atomic_t lost;
+	static pthread_t main_thread;
+
+	bool active;
+	struct sigaction old_action;
+	std::map<std::string, uint64> stacks;
+};
+
+extern ScriptProfiler script_profiler;
+
+#endif
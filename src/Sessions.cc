@@ -27,6 +27,8 @@
 #include "analyzer/protocol/arp/ARP.h"
 #include "analyzer/protocol/arp/events.bif.h"
 #include "Discard.h"
+#include "FlowAccounting.h"
+#include "LoadShedder.h"
 #include "RuleMatcher.h"
 
 #include "TunnelEncapsulation.h"
@@ -105,6 +107,11 @@ NetSessions::NetSessions()
 	icmp_conns.SetDeleteFunc(bro_obj_delete_func);
 	fragments.SetDeleteFunc(bro_obj_delete_func);
 
+	memset(conn_cache, 0, sizeof(conn_cache));
+
+	oldest_frag = newest_frag = 0;
+	evicted_fragments = 0;
+
 	if ( stp_correlate_pair )
 		stp_manager = new analyzer::stepping_stone::SteppingStoneManager();
 	else
@@ -117,6 +124,29 @@ NetSessions::NetSessions()
 		discarder = 0;
 		}
 
+	flows = new FlowAccounting();
+	if ( ! flows->IsActive() )
+		{
+		delete flows;
+		flows = 0;
+		}
+
+	shedder = new LoadShedder();
+	if ( ! shedder->IsActive() )
+		{
+		delete shedder;
+		shedder = 0;
+		}
+
+	half_open = new HalfOpenTable();
+	if ( ! half_open->IsActive() )
+		{
+		delete half_open;
+		half_open = 0;
+		}
+
+	replaying_syn = 0;
+
 	packet_filter = 0;
 
 	build_backdoor_analyzer =
@@ -148,11 +178,16 @@ NetSessions::~NetSessions()
 	delete pkt_profiler;
 	Unref(arp_analyzer);
 	delete discarder;
+	delete flows;
+	delete shedder;
+	delete half_open;
 	delete stp_manager;
 	}
 
 void NetSessions::Done()
 	{
+	if ( flows )
+		flows->Flush();
 	}
 
 void NetSessions::NextPacket(double t, const Packet* pkt)
@@ -167,6 +202,9 @@ void NetSessions::NextPacket(double t, const Packet* pkt)
 
 	++num_packets_processed;
 
+	if ( shedder )
+		shedder->Check(t);
+
 	dump_this_packet = 0;
 
 	if ( record_all_packets )
@@ -337,8 +375,11 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 		return;
 		}
 
-	// Ignore if packet matches packet filter.
-	if ( packet_filter && packet_filter->Match(ip_hdr, len, caplen) )
+	// Ignore if packet matches packet filter. A replayed SYN has been
+	// through the filter and the discarder already, and they may have
+	// changed their minds since.
+	if ( packet_filter && ! replaying_syn &&
+	     packet_filter->Match(ip_hdr, len, caplen) )
 		 return;
 
 	if ( ! ignore_checksums && ip4 &&
@@ -348,7 +389,8 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 		return;
 		}
 
-	if ( discarder && discarder->NextPacket(ip_hdr, len, caplen) )
+	if ( discarder && ! replaying_syn &&
+	     discarder->NextPacket(ip_hdr, len, caplen) )
 		return;
 
 	FragReassembler* f = 0;
@@ -726,30 +768,59 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 		return;
 	}
 
-	HashKey* h = BuildConnIDHashKey(id);
-	if ( ! h )
-		reporter->InternalError("hash computation failed");
+	// The key lives on the stack while we look it up; only a new
+	// connection gets a copy of its own.
+	ConnIDKey key;
+	BuildConnIDKey(id, &key);
+	hash_t hash = HashKey::HashBytes(&key, sizeof(key));
+
+	if ( flows && flows->Account(t, id, key, hash, proto, len) )
+		return;
+
+	if ( half_open && half_open->Size() && ! replaying_syn &&
+	     proto == IPPROTO_TCP )
+		{
+		// Something more is happening on a flow we've only seen a
+		// SYN of so far; catch up on that first.
+		HalfOpenTable::Entry e;
+
+		if ( half_open->Take(key, hash, &e) )
+			ReplaySyn(e);
+		}
+
+	HashKey h(&key, sizeof(key), hash, true);
 
 	Connection* conn = 0;
 
 	// FIXME: The following is getting pretty complex. Need to split up
 	// into separate functions.
-	conn = (Connection*) d->Lookup(h);
+	conn = LookupConn(d, h);
 	if ( ! conn )
 		{
-		conn = NewConn(h, t, &id, data, proto, ip_hdr->FlowLabel(), pkt, encapsulation);
+		if ( half_open && ! replaying_syn && proto == IPPROTO_TCP &&
+		     DeferSyn(ip_hdr, len, caplen, data, f, encapsulation) &&
+		     half_open->Insert(t, key, hash, pkt) )
+			{
+			dump_this_packet = 1;
+			return;
+			}
+
+		HashKey* k = new HashKey(&key, sizeof(key), hash);
+		conn = NewConn(k, t, &id, data, proto, ip_hdr->FlowLabel(), pkt, encapsulation);
 		if ( conn )
-			d->Insert(h, conn);
+			{
+			d->Insert(k, conn);
+			CacheConn(d, conn);
+			}
+		else
+			delete k;
 		}
 	else
 		{
 		// We already know that connection.
 		int consistent = CheckConnectionTag(conn);
 		if ( consistent < 0 )
-			{
-			delete h;
 			return;
-			}
 
 		if ( ! consistent || conn->IsReuse(t, data) )
 			{
@@ -757,22 +828,23 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 				conn->Event(connection_reused, 0);
 
 			Remove(conn);
-			conn = NewConn(h, t, &id, data, proto, ip_hdr->FlowLabel(), pkt, encapsulation);
+
+			HashKey* k = new HashKey(&key, sizeof(key), hash);
+			conn = NewConn(k, t, &id, data, proto, ip_hdr->FlowLabel(), pkt, encapsulation);
 			if ( conn )
-				d->Insert(h, conn);
+				{
+				d->Insert(k, conn);
+				CacheConn(d, conn);
+				}
+			else
+				delete k;
 			}
 		else
-			{
-			delete h;
 			conn->CheckEncapsulation(encapsulation);
-			}
 		}
 
 	if ( ! conn )
-		{
-		delete h;
 		return;
-		}
 
 	int record_packet = 1;	// whether to record the packet at all
 	int record_content = 1;	// whether to record its data
@@ -820,6 +892,19 @@ void NetSessions::DoNextInnerPacket(double t, const Packet* pkt,
 		const IP_Hdr* inner, const EncapsulationStack* prev,
 		const EncapsulatingConn& ec)
 	{
+	EncapsulationStack outer;
+
+	if ( prev )
+		outer = *prev;
+
+	outer.Add(ec);
+
+	DoNextInnerPacket(t, pkt, inner, &outer);
+	}
+
+void NetSessions::DoNextInnerPacket(double t, const Packet* pkt,
+		const IP_Hdr* inner, const EncapsulationStack* encap)
+	{
 	uint32 caplen, len;
 	caplen = len = inner->TotalLen();
 
@@ -849,18 +934,13 @@ void NetSessions::DoNextInnerPacket(double t, const Packet* pkt,
 		l3_proto = L3_IPV6;
 		}
 
-	EncapsulationStack* outer = prev ?
-			new EncapsulationStack(*prev) : new EncapsulationStack();
-	outer->Add(ec);
-
 	// Construct fake packet for DoNextPacket
 	Packet p;
 	p.Init(DLT_RAW, &ts, caplen, len, data, false, "");
 
-	DoNextPacket(t, &p, inner, outer);
+	DoNextPacket(t, &p, inner, encap);
 
 	delete inner;
-	delete outer;
 	}
 
 int NetSessions::ParseIPPacket(int caplen, const u_char* const pkt, int proto,
@@ -949,33 +1029,57 @@ bool NetSessions::CheckHeaderTrunc(int proto, uint32 len, uint32 caplen,
 FragReassembler* NetSessions::NextFragment(double t, const IP_Hdr* ip,
 					const u_char* pkt)
 	{
-	uint32 frag_id = ip->ID();
+	FragKey key;
+	ip->SrcAddr().CopyIPv6(&key.src);
+	ip->DstAddr().CopyIPv6(&key.dst);
+	key.id = ip->ID();
 
-	ListVal* key = new ListVal(TYPE_ANY);
-	key->Append(new AddrVal(ip->SrcAddr()));
-	key->Append(new AddrVal(ip->DstAddr()));
-	key->Append(val_mgr->GetCount(frag_id));
+	hash_t hash = HashKey::HashBytes(&key, sizeof(key));
+	HashKey h(&key, sizeof(key), hash, true);
 
-	HashKey* h = ch->ComputeHash(key, 1);
-	if ( ! h )
-		reporter->InternalError("hash computation failed");
-
-	FragReassembler* f = fragments.Lookup(h);
-	if ( ! f )
+	FragReassembler* f = fragments.Lookup(&h);
+	if ( f )
 		{
-		f = new FragReassembler(this, ip, pkt, h, t);
-		fragments.Insert(h, f);
-		Unref(key);
+		f->AddFragment(t, ip, pkt);
 		return f;
 		}
 
-	delete h;
-	Unref(key);
+	if ( max_frag_reassemblers > 0 &&
+	     fragments.Length() >= max_frag_reassemblers )
+		EvictFragment();
+
+	HashKey* k = new HashKey(&key, sizeof(key), hash);
+	f = new FragReassembler(this, ip, pkt, k, t);
+	fragments.Insert(k, f);
+
+	f->older = newest_frag;
+
+	if ( newest_frag )
+		newest_frag->newer = f;
+	else
+		oldest_frag = f;
+
+	newest_frag = f;
 
-	f->AddFragment(t, ip, pkt);
 	return f;
 	}
 
+void NetSessions::EvictFragment()
+	{
+	for ( FragReassembler* f = oldest_frag; f; f = f->newer )
+		{
+		// One that has reassembled is still in use for the packet
+		// at hand, and goes away afterwards anyway.
+		if ( f->ReassembledPkt() )
+			continue;
+
+		++evicted_fragments;
+		f->DeleteTimer();
+		Remove(f);
+		return;
+		}
+	}
+
 Connection* NetSessions::FindConnection(Val* v)
 	{
 	BroType* vt = v->Type();
@@ -1027,9 +1131,9 @@ Connection* NetSessions::FindConnection(Val* v)
 
 	id.is_one_way = 0;	// ### incorrect for ICMP connections
 
-	HashKey* h = BuildConnIDHashKey(id);
-	if ( ! h )
-		reporter->InternalError("hash computation failed");
+	ConnIDKey key;
+	BuildConnIDKey(id, &key);
+	HashKey h(&key, sizeof(key), HashKey::HashBytes(&key, sizeof(key)), true);
 
 	Dictionary* d;
 
@@ -1044,17 +1148,49 @@ Connection* NetSessions::FindConnection(Val* v)
 		// This can happen due to pseudo-connections we
 		// construct, for example for packet headers embedded
 		// in ICMPs.
-		delete h;
 		return 0;
 		}
 
-	Connection* conn = (Connection*) d->Lookup(h);
+	return LookupConn(d, h);
+	}
+
+Connection* NetSessions::LookupConn(Dictionary* d, const HashKey& key)
+	{
+	ConnCacheEntry* e = &conn_cache[key.Hash() % CONN_CACHE_SIZE];
+
+	if ( e->conn && e->hash == key.Hash() && e->dict == d )
+		{
+		const HashKey* k = e->conn->Key();
 
-	delete h;
+		if ( k && k->Size() == key.Size() &&
+		     memcmp(k->Key(), key.Key(), key.Size()) == 0 )
+			return e->conn;
+		}
+
+	Connection* conn = (Connection*) d->Lookup(&key);
+
+	if ( conn )
+		CacheConn(d, conn);
 
 	return conn;
 	}
 
+void NetSessions::CacheConn(Dictionary* d, Connection* c)
+	{
+	ConnCacheEntry* e = &conn_cache[c->Key()->Hash() % CONN_CACHE_SIZE];
+	e->hash = c->Key()->Hash();
+	e->dict = d;
+	e->conn = c;
+	}
+
+void NetSessions::UncacheConn(const HashKey* key)
+	{
+	ConnCacheEntry* e = &conn_cache[key->Hash() % CONN_CACHE_SIZE];
+
+	if ( e->conn && e->hash == key->Hash() )
+		e->conn = 0;
+	}
+
 void NetSessions::Remove(Connection* c)
 	{
 	HashKey* k = c->Key();
@@ -1082,6 +1218,9 @@ void NetSessions::Remove(Connection* c)
 		// longer in the dictionary.
 		c->ClearKey();
 
+		// Only now, as the events above may have looked it up again.
+		UncacheConn(k);
+
 		switch ( c->ConnTransport() ) {
 		case TRANSPORT_TCP:
 			if ( ! tcp_conns.RemoveEntry(k) )
@@ -1113,6 +1252,18 @@ void NetSessions::Remove(FragReassembler* f)
 	if ( ! f )
 		return;
 
+	if ( f->older )
+		f->older->newer = f->newer;
+	else if ( oldest_frag == f )
+		oldest_frag = f->newer;
+
+	if ( f->newer )
+		f->newer->older = f->older;
+	else if ( newest_frag == f )
+		newest_frag = f->older;
+
+	f->older = f->newer = 0;
+
 	HashKey* k = f->Key();
 
 	if ( k )
@@ -1132,6 +1283,9 @@ void NetSessions::Insert(Connection* c)
 
 	Connection* old = 0;
 
+	// Whatever the cache has for the key is on its way out.
+	UncacheConn(c->Key());
+
 	switch ( c->ConnTransport() ) {
 	// Remove first. Otherwise the dictioanry would still
 	// reference the old key for already existing connections.
@@ -1170,6 +1324,14 @@ void NetSessions::Insert(Connection* c)
 
 void NetSessions::Drain()
 	{
+	if ( half_open )
+		{
+		HalfOpenTable::Entry e;
+
+		while ( half_open->TakeAny(&e) )
+			ReplaySyn(e);
+		}
+
 	IterCookie* cookie = tcp_conns.InitForIteration();
 	Connection* tc;
 
@@ -1215,6 +1377,7 @@ void NetSessions::GetStats(SessionStats& s) const
 	s.max_UDP_conns = udp_conns.MaxLength();
 	s.max_ICMP_conns = icmp_conns.MaxLength();
 	s.max_fragments = fragments.MaxLength();
+	s.evicted_fragments = evicted_fragments;
 	}
 
 Connection* NetSessions::NewConn(HashKey* k, double t, const ConnID* id,
@@ -1258,9 +1421,15 @@ Connection* NetSessions::NewConn(HashKey* k, double t, const ConnID* id,
 	if ( ! WantConnection(src_h, dst_h, tproto, flags, flip) )
 		return 0;
 
+	if ( shedder && ! shedder->Admit(k->Hash()) )
+		return 0;
+
 	Connection* conn = new Connection(this, k, t, id, flow_label, pkt, encapsulation);
 	conn->SetTransport(tproto);
 
+	if ( shedder )
+		conn->SetShedLevel(shedder->Level());
+
 	if ( flip )
 		conn->FlipRoles();
 
@@ -1293,6 +1462,63 @@ Connection* NetSessions::NewConn(HashKey* k, double t, const ConnID* id,
 	return conn;
 	}
 
+void NetSessions::ExpireHalfOpen(double t)
+	{
+	if ( ! half_open )
+		return;
+
+	HalfOpenTable::Entry e;
+
+	while ( half_open->TakeExpired(t, &e) )
+		ReplaySyn(e);
+	}
+
+bool NetSessions::DeferSyn(const IP_Hdr* ip_hdr, uint32 len, uint32 caplen,
+				const u_char* data, const FragReassembler* f,
+				const EncapsulationStack* encapsulation) const
+	{
+	// Replaying the SYN later must come to the same, so leave alone
+	// anything that takes more than the packet itself to process.
+	if ( f || (encapsulation && encapsulation->Depth()) ||
+	     ip_hdr->NumHeaders() > 1 || new_packet ||
+	     current_iosrc->GetCurrentTag() )
+		return false;
+
+	const struct tcphdr* tp = (const struct tcphdr*) data;
+
+	if ( (tp->th_flags & (TH_SYN | TH_ACK | TH_RST | TH_FIN)) != TH_SYN )
+		return false;
+
+	// No payload, and all of it captured.
+	return len == uint32(tp->th_off * 4) && caplen == len;
+	}
+
+void NetSessions::ReplaySyn(const HalfOpenTable::Entry& e)
+	{
+	pkt_timeval ts = e.ts;
+	Packet pkt(e.link_type, &ts, e.cap_len, e.len, e.frame);
+	const u_char* ip = pkt.data + pkt.hdr_size;
+
+	// The SYN got recorded when it came in.
+	int dump = dump_this_packet;
+	replaying_syn = 1;
+
+	if ( pkt.l3_proto == L3_IPV4 )
+		{
+		IP_Hdr ip_hdr((const struct ip*) ip, false);
+		DoNextPacket(e.time, &pkt, &ip_hdr, 0);
+		}
+	else
+		{
+		IP_Hdr ip_hdr((const struct ip6_hdr*) ip, false,
+				pkt.cap_len - pkt.hdr_size);
+		DoNextPacket(e.time, &pkt, &ip_hdr, 0);
+		}
+
+	replaying_syn = 0;
+	dump_this_packet = dump;
+	}
+
 bool NetSessions::IsLikelyServerPort(uint32 port, TransportProto proto) const
 	{
 	// We keep a cached in-core version of the table to speed up the lookup.
@@ -1524,3 +1750,22 @@ unsigned int NetSessions::MemoryAllocation()
 		// FIXME: MemoryAllocation() not implemented for rest.
 		;
 	}
+
+uint64 NetSessions::MemoryAllocationEstimate() const
+	{
+	if ( terminating )
+		return 0;
+
+	// The dictionaries keep the keys; each connection has a copy of
+	// its own as well.
+	unsigned int conn_size = padded_sizeof(Connection) +
+		padded_sizeof(HashKey) + pad_size(sizeof(ConnIDKey));
+
+	return uint64(tcp_conns.Length() + udp_conns.Length() +
+		      icmp_conns.Length()) * conn_size
+		+ tcp_conns.MemoryAllocationEstimate(sizeof(ConnIDKey))
+		+ udp_conns.MemoryAllocationEstimate(sizeof(ConnIDKey))
+		+ icmp_conns.MemoryAllocationEstimate(sizeof(ConnIDKey))
+		+ uint64(fragments.Length()) * padded_sizeof(FragReassembler)
+		+ fragments.MemoryAllocationEstimate(sizeof(FragKey));
+	}
@@ -10,6 +10,7 @@
 #include "PacketFilter.h"
 #include "Stats.h"
 #include "NetVar.h"
+#include "HalfOpen.h"
 #include "TunnelEncapsulation.h"
 #include "analyzer/protocol/tcp/Stats.h"
 
@@ -24,6 +25,8 @@ declare(PDict,Connection);
 declare(PDict,FragReassembler);
 
 class Discarder;
+class FlowAccounting;
+class LoadShedder;
 class PacketFilter;
 
 namespace analyzer { namespace stepping_stone { class SteppingStoneManager; } }
@@ -44,6 +47,7 @@ struct SessionStats {
 
 	int num_fragments;
 	int max_fragments;
+	uint64 evicted_fragments;
 	uint64 num_packets;
 };
 
@@ -71,6 +75,10 @@ public:
 
 	void Done();	// call to drain events before destructing
 
+	// Sets up connections for the SYNs in the half-open table that
+	// have been waiting for an answer for tcp_attempt_delay by time t.
+	void ExpireHalfOpen(double t);
+
 	// Returns a reassembled packet, or nil if there are still
 	// some missing fragments.
 	FragReassembler* NextFragment(double t, const IP_Hdr* ip,
@@ -92,6 +100,9 @@ public:
 
 	void GetStats(SessionStats& s) const;
 
+	// Number of packets processed so far.
+	uint64 NumPacketsProcessed() const	{ return num_packets_processed; }
+
 	void Weird(const char* name, const Packet* pkt,
 	    const EncapsulationStack* encap = 0);
 	void Weird(const char* name, const IP_Hdr* ip,
@@ -140,6 +151,21 @@ public:
 	                      const IP_Hdr* inner, const EncapsulationStack* prev,
 	                      const EncapsulatingConn& ec);
 
+	/**
+	 * Same as above, but with the inner packet's encapsulation already at
+	 * hand, such as the one a tunnel analyzer keeps in an
+	 * InnerEncapsulation for all packets of its tunnel.
+	 *
+	 * @param t Network time.
+	 * @param pkt If the outer packet is available, the fake packet passed
+	 *        to DoNextPacket will use its timestamp.
+	 * @param inner Pointer to IP header wrapper of the inner packet, ownership
+	 *        of the pointer's memory is assumed by this function.
+	 * @param encap The full encapsulation of the inner packet.
+	 */
+	void DoNextInnerPacket(double t, const Packet* pkt,
+	                      const IP_Hdr* inner, const EncapsulationStack* encap);
+
 	/**
 	 * Returns a wrapper IP_Hdr object if \a pkt appears to be a valid IPv4
 	 * or IPv6 header based on whether it's long enough to contain such a header,
@@ -168,6 +194,12 @@ public:
 	unsigned int ConnectionMemoryUsage();
 	unsigned int ConnectionMemoryUsageConnVals();
 	unsigned int MemoryAllocation();
+
+	// Estimates the memory of the connections and fragments in constant
+	// time, counting only the objects themselves and the tables
+	// holding them, not their analyzers or script-level state.
+	uint64 MemoryAllocationEstimate() const;
+
 	analyzer::tcp::TCPStateStats tcp_stats;	// keeps statistics on TCP states
 
 protected:
@@ -204,6 +236,17 @@ protected:
 				TransportProto transport_proto,
 				uint8 tcp_flags, bool& flip_roles);
 
+	// Whether to hold off on a connection for the given TCP packet,
+	// keeping it in the half-open table instead. That's for a bare
+	// initial SYN that arrived on its own.
+	bool DeferSyn(const IP_Hdr* ip_hdr, uint32 len, uint32 caplen,
+			const u_char* data, const FragReassembler* f,
+			const EncapsulationStack* encapsulation) const;
+
+	// Processes a SYN from the half-open table as if it had just
+	// arrived.
+	void ReplaySyn(const HalfOpenTable::Entry& e);
+
 	// Record the given packet (if a dumper is active).  If len=0
 	// then the whole packet is recorded, otherwise just the first
 	// len bytes.
@@ -215,12 +258,42 @@ protected:
 	bool CheckHeaderTrunc(int proto, uint32 len, uint32 caplen,
 			      const Packet *pkt, const EncapsulationStack* encap);
 
+	// Gives up on the oldest incomplete fragmented datagram.
+	void EvictFragment();
+
+	// Looks up a connection in one of the tables, trying the cache of
+	// recent connections first.
+	Connection* LookupConn(Dictionary* d, const HashKey& key);
+
+	// Adds a connection to the cache of recent ones, or removes the one
+	// with the given key.
+	void CacheConn(Dictionary* d, Connection* c);
+	void UncacheConn(const HashKey* key);
+
 	CompositeHash* ch;
 	PDict(Connection) tcp_conns;
 	PDict(Connection) udp_conns;
 	PDict(Connection) icmp_conns;
 	PDict(FragReassembler) fragments;
 
+	// The reassemblers in the order they got created, for giving up on
+	// the oldest ones once there are max_frag_reassemblers of them.
+	FragReassembler* oldest_frag;
+	FragReassembler* newest_frag;
+	uint64 evicted_fragments;
+
+	// Packets of a flow tend to come back to back. A small cache of the
+	// most recent connection per slot, in front of the tables, saves
+	// walking their chains for those.
+	struct ConnCacheEntry {
+		hash_t hash;
+		const Dictionary* dict;
+		Connection* conn;
+	};
+
+	static const int CONN_CACHE_SIZE = 64;
+	ConnCacheEntry conn_cache[CONN_CACHE_SIZE];
+
 	typedef pair<IPAddr, IPAddr> IPPair;
 	typedef pair<EncapsulatingConn, double> TunnelActivity;
 	typedef std::map<IPPair, TunnelActivity> IPTunnelMap;
@@ -230,6 +303,10 @@ protected:
 
 	analyzer::stepping_stone::SteppingStoneManager* stp_manager;
 	Discarder* discarder;
+	FlowAccounting* flows;
+	LoadShedder* shedder;
+	HalfOpenTable* half_open;
+	int replaying_syn;	// if true, the current packet is from half_open
 	PacketFilter* packet_filter;
 	int build_backdoor_analyzer;
 	int dump_this_packet;	// if true, current packet should be recorded
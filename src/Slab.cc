@@ -0,0 +1,110 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <stdlib.h>
+
+#include "Slab.h"
+
+// Objects are rounded up to multiples of the granularity; anything larger
+// than the biggest size class just goes to malloc().
+#define SLAB_GRANULARITY 16
+#define SLAB_NUM_CLASSES 64
+#define SLAB_MAX_SIZE (SLAB_GRANULARITY * SLAB_NUM_CLASSES)
+
+// Size of the slabs objects are carved from.
+#define SLAB_SIZE (64 * 1024)
+
+namespace {
+
+struct FreeObj {
+	FreeObj* next;
+};
+
+struct SizeClass {
+	FreeObj* free_list;
+	char* slab_pos;	// uncarved part of the current slab
+	char* slab_end;
+};
+
+SizeClass size_classes[SLAB_NUM_CLASSES];
+
+SlabAllocator::Stats slab_stats;
+
+inline int size_class(size_t size)
+	{
+	return size ? (size - 1) / SLAB_GRANULARITY : 0;
+	}
+
+}
+
+size_t SlabAllocator::AllocationSize(size_t size)
+	{
+	if ( size > SLAB_MAX_SIZE )
+		return pad_size(size);
+
+	return (size_class(size) + 1) * SLAB_GRANULARITY;
+	}
+
+void* SlabAllocator::Alloc(size_t size)
+	{
+	++slab_stats.allocs;
+
+	if ( size > SLAB_MAX_SIZE )
+		{
+		++slab_stats.large_allocs;
+		return safe_malloc(size);
+		}
+
+	int c = size_class(size);
+	size_t obj_size = (c + 1) * SLAB_GRANULARITY;
+	SizeClass* sc = &size_classes[c];
+
+	slab_stats.in_use += obj_size;
+
+	if ( sc->free_list )
+		{
+		FreeObj* obj = sc->free_list;
+		sc->free_list = obj->next;
+		return obj;
+		}
+
+	if ( size_t(sc->slab_end - sc->slab_pos) < obj_size )
+		{
+		// Whatever is left of the previous slab is too small for
+		// another object; it's lost.
+		sc->slab_pos = (char*) safe_malloc(SLAB_SIZE);
+		sc->slab_end = sc->slab_pos + SLAB_SIZE;
+		slab_stats.reserved += SLAB_SIZE;
+		}
+
+	void* obj = sc->slab_pos;
+	sc->slab_pos += obj_size;
+	return obj;
+	}
+
+void SlabAllocator::Free(void* p, size_t size)
+	{
+	if ( ! p )
+		return;
+
+	if ( size > SLAB_MAX_SIZE )
+		{
+		free(p);
+		return;
+		}
+
+	int c = size_class(size);
+	SizeClass* sc = &size_classes[c];
+
+	FreeObj* obj = (FreeObj*) p;
+	obj->next = sc->free_list;
+	sc->free_list = obj;
+
+	slab_stats.in_use -= (c + 1) * SLAB_GRANULARITY;
+	}
+
+void SlabAllocator::GetStats(Stats* stats)
+	{
+	*stats = slab_stats;
+	}
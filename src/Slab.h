@@ -0,0 +1,59 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// A size-class allocator for the objects that come and go with every
+// connection: the Connection itself, its analyzer tree and its timers.
+// Each size class carves its objects out of large slabs and recycles
+// freed ones through a free list, so steady connection churn neither
+// goes to malloc nor fragments the heap with short-lived objects mixed
+// into long-lived ones. Slabs are never returned to the system.
+//
+// The allocator is not thread-safe; only use it for classes whose
+// instances are created and destroyed by the main thread only. It's
+// enabled by configuring with --enable-slab-alloc.
+
+#ifndef slab_h
+#define slab_h
+
+#include "zeek-config.h"
+#include "util.h"
+
+class SlabAllocator {
+public:
+	static void* Alloc(size_t size);
+	static void Free(void* p, size_t size);
+
+	// Returns the number of bytes an object of the given size takes up.
+	static size_t AllocationSize(size_t size);
+
+	struct Stats {
+		uint64 reserved;	// bytes held in slabs
+		uint64 in_use;	// bytes handed out from slabs
+		uint64 allocs;	// cumulative number of allocations
+		uint64 large_allocs;	// of those, passed on to malloc
+	};
+
+	static void GetStats(Stats* stats);
+};
+
+#ifdef ENABLE_SLAB_ALLOC
+
+// Placed in a class declaration, makes instances of it and all its
+// subclasses come from the slab allocator. The class must have a virtual
+// destructor if it is ever deleted through a base class pointer, so that
+// the right size is passed to the operator delete.
+#define DECLARE_SLAB_ALLOCATED \
+	static void* operator new(size_t size) \
+		{ return SlabAllocator::Alloc(size); } \
+	static void operator delete(void* p, size_t size) \
+		{ SlabAllocator::Free(p, size); }
+
+#define slab_sizeof(x) (SlabAllocator::AllocationSize(sizeof(x)))
+
+#else
+
+#define DECLARE_SLAB_ALLOCATED
+#define slab_sizeof(x) padded_sizeof(x)
+
+#endif
+
+#endif
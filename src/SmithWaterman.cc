@@ -195,50 +195,56 @@ bool BroSubstringCmp::operator()(const BroSubstring* bst1,
 	return false;
 	}
 
-// A node in Smith-Waterman's dynamic programming matrix.  Each node
-// contains the byte it represents in the case of a match, the score
-// at this point, and a pointer to the previous cell. Previous means
-// one up and left in case of a match, or a jump somewhere above and
-// left in case of a gap.
+// The cells of Smith-Waterman's dynamic programming matrix. As the scores
+// are only needed for the row above while filling in the matrix, the
+// matrix itself keeps just a byte of flags per cell: whether the bytes
+// match at this point, and which neighbour the previous cell is. Previous
+// means one up and left in case of a match, or a jump up or left in case
+// of a gap.
 //
-struct SWNode {
-	// ID field for the cell, for debugging purposes.
-	int id;
-
-	u_char swn_byte;
-	bool swn_byte_assigned;
-	bool swn_visited;
-
-	// The score in this cell. The cell with the globally best score
-	// marks the end of the alignment.
-	int swn_score;
-
-	// Pointer to previous match, walking back yields subsequence.
-	SWNode* swn_prev;
-};
-
-// A matrix of Smith-Waterman nodes.
+#define SW_PREV_MASK	0x03
+#define SW_PREV_NONE	0x00	// no predecessor, only for row and column 0
+#define SW_PREV_TL	0x01
+#define SW_PREV_T	0x02
+#define SW_PREV_L	0x03
+#define SW_MATCH	0x04
+#define SW_VISITED	0x08
+
+// A matrix of Smith-Waterman cells.
 //
 class SWNodeMatrix {
 public:
 	SWNodeMatrix(const BroString* s1, const BroString* s2)
-	: _s1(s1), _s2(s2), _rows(s1->Len() + 1), _cols(s2->Len() + 1)
+	: _s1(s1), _s2(s2), _rows(s1->Len() + 1), _cols(s2->Len() + 1),
+	  _cells(size_t(_rows) * _cols, 0)
 		{
-		_nodes = new SWNode[_cols * _rows];
-		memset(_nodes, 0, sizeof(SWNode) * _cols * _rows);
 		}
 
-	~SWNodeMatrix()	{ delete [] _nodes; }
+	u_char& operator()(int row, int col)
+		{ return _cells[size_t(row) * _cols + col]; }
 
-	SWNode* operator()(int row, int col)
+	// Moves the given coordinates to the cell's predecessor. Returns
+	// false if there's none.
+	//
+	bool Prev(int& row, int& col)
 		{
-		// Make sure access is in allowed range.
-		if ( row < 0 || row >= _rows )
-			return 0;
-		if ( col < 0 || col >= _cols )
-			return 0;
+		switch ( (*this)(row, col) & SW_PREV_MASK ) {
+		case SW_PREV_TL:
+			--row;
+			--col;
+			return true;
+
+		case SW_PREV_T:
+			--row;
+			return true;
+
+		case SW_PREV_L:
+			--col;
+			return true;
 
-		return &(_nodes[row * _cols + col]);
+		default:
+			return false;
+		}
 		}
 
 	const BroString* GetRowsString() const	{ return _s1; }
@@ -247,55 +253,46 @@ public:
 	int GetHeight() const	{ return _rows; }
 	int GetWidth() const	{ return _cols; }
 
-	// Quick helper function that calculates the coordinates of a
-	// node in the matrix via pointer arithmetic.
-	//
-	void GetNodeIndices(SWNode* node, int& row, int& col)
-		{
-		SWNode* base = &_nodes[0];
-		int offset = (node - base);
-		col = (offset % _cols);
-		row = (offset / _cols);
-		}
-
 private:
 	const BroString* _s1;
 	const BroString* _s2;
 
 	int _rows, _cols;
-	SWNode* _nodes;
+	vector<u_char> _cells;
 };
 
-// Returns the common subsequence starting from a given node.
+// Returns the common subsequence starting from a given cell.
 // @result: vector holding results on return.
 // @matrix: SW matrix.
-// @node: starting node.
+// @node_row, @node_col: starting cell.
 // @params: SW parameters.
 //
 static void sw_collect_single(BroSubstring::Vec* result, SWNodeMatrix& matrix,
-			      SWNode* node, SWParams& params)
+			      int node_row, int node_col, SWParams& params)
 	{
 	string substring("");
 	int row = 0, col = 0;
+	const u_char* string1 = matrix.GetRowsString()->Bytes();
+
+	bool more = (node_row >= 0);
 
-	while ( node )
+	while ( more )
 		{
-//		printf("NODE: %i\n", node->id);
-		node->swn_visited = true;
+		u_char& node = matrix(node_row, node_col);
+		node |= SW_VISITED;
 
 		// Once we hit a gap, terminate the string and prepend
 		// it to our result vector, IF it has at least the length
 		// requested through the params._min_toklen parameter.
 		//
-		if ( node->swn_byte_assigned )
+		if ( node & SW_MATCH )
 			{
-			matrix.GetNodeIndices(node, row, col);
-			substring += node->swn_byte;
-//			printf("SUBSTRING: %s\n", substring.c_str());
+			row = node_row;
+			col = node_col;
+			substring += string1[row-1];
 			}
 		else
 			{
-//			printf("GAP\n");
 			if ( substring.size() >= params._min_toklen )
 				{
 				reverse(substring.begin(), substring.end());
@@ -308,7 +305,7 @@ static void sw_collect_single(BroSubstring::Vec* result, SWNodeMatrix& matrix,
 			substring = "";
 			}
 
-		node = node->swn_prev;
+		more = matrix.Prev(node_row, node_col);
 		}
 
 	// Anything left over now is the first string of an alignment and is
@@ -345,13 +342,13 @@ static void sw_collect_multiple(BroSubstring::Vec* result,
 		{
 		for ( int j = matrix.GetWidth() - 1; j > 0; --j )
 			{
-			SWNode* node = matrix(i, j);
+			u_char node = matrix(i, j);
 
-			if ( ! (node->swn_byte_assigned && ! node->swn_visited) )
+			if ( ! ((node & SW_MATCH) && ! (node & SW_VISITED)) )
 				continue;
 
 			BroSubstring::Vec* new_al = new BroSubstring::Vec();
-			sw_collect_single(new_al, matrix, node, params);
+			sw_collect_single(new_al, matrix, i, j, params);
 
 			for ( vector<BroSubstring::Vec*>::iterator it = als.begin();
 			      it != als.end(); ++it )
@@ -425,14 +422,18 @@ BroSubstring::Vec* smith_waterman(const BroString* s1, const BroString* s2,
 	int i, len1 = s1->Len() + 1;
 	int j, len2 = s2->Len() + 1;
 
-	int row = 0, col = 0;
-
 	byte_vec string1 = s1->Bytes();
 	byte_vec string2 = s2->Bytes();
 
 	SWNodeMatrix matrix(s1, s2);	// dynamic programming matrix.
-	SWNode* node_max = 0;	// pointer to the best score's node
-	SWNode* node_br_max = 0;	// pointer to lowest-right matching node
+
+	// The scores of the current row and the one above it.
+	vector<int> scores_t(len2, 0);
+	vector<int> scores(len2, 0);
+
+	// The best score's node.
+	int node_max_row = -1;
+	int node_max_col = -1;
 
 	// The highest score in the matrix, globally.  We initialize to 1
 	// because we are only interested in real scores (initializing to
@@ -440,20 +441,6 @@ BroSubstring::Vec* smith_waterman(const BroString* s1, const BroString* s2,
 	// structure in the matrix).
 	//
 	int matrix_max = 1;
-	int br_max_r = 0;
-	int br_max_b = 0;
-
-
-	// Matrix initialization ----------------------------------------------
-
-	// Assign IDs to each cell -- this is only for debugging purposes
-	// and can go later.
-
-	int counter = 1;
-
-	for ( i = 1; i < len1; ++i )
-		for ( j = 1; j < len2; ++j )
-			matrix(i, j)->id = counter++;
 
 	// Subsequence calculation --------------------------------------------
 
@@ -461,18 +448,14 @@ BroSubstring::Vec* smith_waterman(const BroString* s1, const BroString* s2,
 		{
 		for ( j = 1; j < len2; ++j )
 			{
-			// Current node, top/left neighbours.
-			//
-			SWNode* current = matrix(i, j);
-			SWNode* node_tl = matrix(i-1, j-1);
-			SWNode* node_l  = matrix(i, j-1);
-			SWNode* node_t  = matrix(i-1, j);
+			u_char& current = matrix(i, j);
 
 			// Scores of neighbouring nodes.
 			//
-			int score_t = node_t->swn_score;
-			int score_l = node_l->swn_score;
-			int score_tl = node_tl->swn_score;
+			int score_t = scores_t[j];
+			int score_l = scores[j-1];
+			int score_tl = scores_t[j-1];
+			int score;
 
 			// If strings at current indices match, assign new
 			// score to current node.  Minus-one adjustments
@@ -483,78 +466,44 @@ BroSubstring::Vec* smith_waterman(const BroString* s1, const BroString* s2,
 				{
 				// We have a match: improve previous score.
 				//
-				score_tl += 1;
+				score = score_tl + 1;
 
 				// If we're continuing a chain of matches, rate
 				// higher.  This favours longer consecutive
 				// substrings.
 				//
-				if ( node_tl->swn_byte_assigned )
-					score_tl += 99;
+				if ( matrix(i-1, j-1) & SW_MATCH )
+					score += 99;
 
-				// Store the byte we've matched in the node for
-				// easier access.
-				//
-				current->swn_byte = string1[i-1];
-				current->swn_byte_assigned = true;
+				current = SW_MATCH | SW_PREV_TL;
 				}
 
-			// Pick the score among the neighbours that is now highest.
-			// This is the core of Smith-Waterman.
-			//
-			if ( current->swn_byte_assigned )
-				current->swn_score = score_tl;
 			else
-				current->swn_score = max(max(score_t, score_l), score_tl);
-
-			// Establish predecessor chain according to neighbor
-			// with best score.
-			//
-			if ( current->swn_score == score_tl &&
-			     current->swn_byte_assigned )
 				{
-				// If we had matched bytes (*and* it's the
-				// best neighbor), marke the node accordingly
+				// Pick the score among the neighbours that is
+				// now highest. This is the core of
+				// Smith-Waterman.
 				//
-				if ( i >= br_max_b && j >= br_max_r )
-					{
-					node_br_max = current;
-					br_max_b = i;
-					br_max_r = j;
-					}
-
-				current->swn_prev = node_tl;
+				score = max(max(score_t, score_l), score_tl);
+				current = (score == score_t) ? SW_PREV_T : SW_PREV_L;
 				}
-			else if ( current->swn_score == score_t )
-				current->swn_prev = node_t;
-			else
-				current->swn_prev = node_l;
+
+			scores[j] = score;
 
 			// Check if we have a new global maximum -- we
 			// specifically track the node that is the global
 			// maximum so we now from where to backtrack at
 			// the end of the matrix iteration.
 			//
-			if ( current->swn_score > matrix_max )
+			if ( score > matrix_max )
 				{
-				node_max = current;
-				matrix_max = current->swn_score;
+				node_max_row = i;
+				node_max_col = j;
+				matrix_max = score;
 				}
-
-#if 0
-			printf("%4i/%.5i%c/%.5i[%c%c] ",
-				current->swn_score,
-		 		current->id,
-				current->swn_byte_assigned ? '*' : ' ',
-		 		current->swn_prev ? current->swn_prev->id : 0,
-			       string1[i-1], string2[j-1]);
-#endif
-			//printf("%.5i ", current->swn_score); 
 			}
 
-#if 0
-		printf("\n");
-#endif
+		scores_t.swap(scores);
 		}
 
 	// Result generation.
@@ -567,7 +516,7 @@ BroSubstring::Vec* smith_waterman(const BroString* s1, const BroString* s2,
 	if ( params._sw_variant == SW_MULTIPLE )
 		sw_collect_multiple(result, matrix, params);
 	else
-		sw_collect_single(result, matrix, node_max, params);
+		sw_collect_single(result, matrix, node_max_row, node_max_col, params);
 
 	if ( len1 > len2 )
 		sort(result->begin(), result->end(), BroSubstringCmp(0));
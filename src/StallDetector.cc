@@ -0,0 +1,85 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "StallDetector.h"
+
+#include "Dict.h"
+#include "Event.h"
+#include "EventHandler.h"
+#include "NetVar.h"
+#include "Var.h"
+#include "iosource/Manager.h"
+#include "iosource/PktSrc.h"
+
+#include "event.bif.h"
+
+StallDetector::StallDetector(double arg_threshold)
+	{
+	threshold = arg_threshold;
+	stall_type = internal_type("MainLoopStall")->AsRecordType();
+	start = 0;
+	start_events = 0;
+	start_resize_time = 0;
+	slowest_handler = 0;
+	slowest_handler_time = 0;
+	last_dropped = 0;
+
+	for ( int i = 0; i < NUM_CATEGORIES; ++i )
+		times[i] = 0;
+	}
+
+void StallDetector::StartIteration()
+	{
+	start = Now();
+	start_events = num_events_dispatched;
+	start_resize_time = Dictionary::GetResizeStats().total_time;
+	slowest_handler = 0;
+	slowest_handler_time = 0;
+
+	for ( int i = 0; i < NUM_CATEGORIES; ++i )
+		times[i] = 0;
+	}
+
+void StallDetector::EndIteration()
+	{
+	double duration = Now() - start - times[IDLE];
+
+	if ( duration <= threshold || ! main_loop_stall )
+		return;
+
+	// Reading the drop counters can involve system calls, so we only
+	// do it when something's wrong.
+	uint64 dropped = 0;
+
+	for ( auto ps : iosource_mgr->GetPktSrcs() )
+		{
+		struct iosource::PktSrc::Stats s;
+		ps->Statistics(&s);
+		dropped += s.dropped;
+		}
+
+	RecordVal* r = new RecordVal(stall_type);
+	int n = 0;
+
+	r->Assign(n++, new Val(current_time(true) - duration, TYPE_TIME));
+	r->Assign(n++, new Val(duration, TYPE_INTERVAL));
+	r->Assign(n++, val_mgr->GetCount(num_events_dispatched - start_events));
+	r->Assign(n++, new Val(times[EVENTS], TYPE_INTERVAL));
+	r->Assign(n++, new Val(times[TIMERS], TYPE_INTERVAL));
+	r->Assign(n++, new Val(times[BROKER], TYPE_INTERVAL));
+	r->Assign(n++, new Val(Dictionary::GetResizeStats().total_time -
+			       start_resize_time, TYPE_INTERVAL));
+
+	if ( slowest_handler )
+		{
+		r->Assign(n++, new StringVal(slowest_handler->Name()));
+		r->Assign(n++, new Val(slowest_handler_time, TYPE_INTERVAL));
+		}
+	else
+		n += 2;
+
+	r->Assign(n++, val_mgr->GetCount(dropped >= last_dropped ?
+					 dropped - last_dropped : 0));
+	last_dropped = dropped;
+
+	mgr.QueueEventFast(main_loop_stall, {r});
+	}
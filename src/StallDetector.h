@@ -0,0 +1,92 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Detection of main loop iterations that take long enough for packets to
+// pile up in the capture buffers.
+
+#ifndef STALLDETECTOR_H
+#define STALLDETECTOR_H
+
+#include <time.h>
+
+#include "util.h"
+
+class EventHandler;
+class RecordType;
+
+class StallDetector {
+public:
+	// Work that an iteration may spend its time on. Anything else,
+	// mostly analyzing packets, is the remainder of its duration.
+	enum Category {
+		EVENTS,	// draining the event queue
+		TIMERS,	// expiring timers
+		BROKER,	// processing and sending Broker messages
+		IDLE,	// sleeping for lack of input, not part of the duration
+		NUM_CATEGORIES
+	};
+
+	// Iterations taking longer than the threshold, in seconds, raise
+	// main_loop_stall.
+	explicit StallDetector(double threshold);
+
+	// Called at the start and end of each iteration of the main loop.
+	void StartIteration();
+	void EndIteration();
+
+	// Accounts time to a category.
+	void Add(Category c, double t)	{ times[c] += t; }
+
+	// Accounts time to an event handler, remembering the slowest.
+	void AddHandler(EventHandler* h, double t)
+		{
+		if ( t > slowest_handler_time )
+			{
+			slowest_handler = h;
+			slowest_handler_time = t;
+			}
+		}
+
+	// A monotonic clock, in seconds.
+	static double Now()
+		{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec + ts.tv_nsec / 1e9;
+		}
+
+private:
+	RecordType* stall_type;
+	double threshold;
+	double start;
+	uint64 start_events;
+	double start_resize_time;
+	double times[NUM_CATEGORIES];
+	EventHandler* slowest_handler;
+	double slowest_handler_time;
+	uint64 last_dropped;	// as of the last stall
+};
+
+// Null unless main_loop_stall_threshold is set.
+extern StallDetector* stall_detector;
+
+// Accounts the time of its lifetime to a category, if detecting stalls.
+class StallTimer {
+public:
+	explicit StallTimer(StallDetector::Category arg_category)
+		{
+		category = arg_category;
+		start = stall_detector ? StallDetector::Now() : 0;
+		}
+
+	~StallTimer()
+		{
+		if ( start && stall_detector )
+			stall_detector->Add(category, StallDetector::Now() - start);
+		}
+
+private:
+	StallDetector::Category category;
+	double start;
+};
+
+#endif
@@ -164,6 +164,15 @@ void ProfileLogger::Log()
 	file->Write(fmt("%.06f Total reassembler data: %" PRIu64 "K\n", network_time,
 		Reassembler::TotalMemoryAllocation() / 1024));
 
+#ifdef ENABLE_SLAB_ALLOC
+	SlabAllocator::Stats slab_stats;
+	SlabAllocator::GetStats(&slab_stats);
+
+	file->Write(fmt("%.06f Slabs: reserved=%" PRIu64 "K in_use=%" PRIu64 "K allocs=%" PRIu64 " large=%" PRIu64 "\n",
+		network_time, slab_stats.reserved / 1024, slab_stats.in_use / 1024,
+		slab_stats.allocs, slab_stats.large_allocs));
+#endif
+
 	// Signature engine.
 	if ( expensive && rule_matcher )
 		{
@@ -179,7 +188,7 @@ void ProfileLogger::Log()
 		network_time,
 		timer_mgr->Size(), timer_mgr->PeakSize(),
 		int(cq_memory_allocation() +
-		    (timer_mgr->Size() * padded_sizeof(ConnectionTimer))) / 1024,
+		    (timer_mgr->Size() * slab_sizeof(ConnectionTimer))) / 1024,
 		network_time - timer_mgr->LastTimestamp()));
 
 	DNS_Mgr::Stats dstats;
@@ -212,12 +221,14 @@ void ProfileLogger::Log()
 		{
 		threading::MsgThread::Stats s = i->second;
 		file->Write(fmt("%0.6f   %-25s in=%" PRIu64 " out=%" PRIu64 " pending=%" PRIu64 "/%" PRIu64
+				" max_pending=%" PRIu64 "/%" PRIu64
 				" (#queue r/w: in=%" PRIu64 "/%" PRIu64 " out=%" PRIu64 "/%" PRIu64 ")"
 			        "\n",
 			    network_time,
 			    i->first.c_str(),
 			    s.sent_in, s.sent_out,
 			    s.pending_in, s.pending_out,
+			    s.queue_in_stats.max_pending, s.queue_out_stats.max_pending,
 			    s.queue_in_stats.num_reads, s.queue_in_stats.num_writes,
 			    s.queue_out_stats.num_reads, s.queue_out_stats.num_writes
 			    ));
@@ -355,6 +355,20 @@ IfStmt::~IfStmt()
 	Unref(s2);
 	}
 
+void IfStmt::FoldCondition(Val* v)
+	{
+	Expr* folded = new ConstExpr(v);
+	folded->SetLocationInfo(e->GetLocationInfo());
+	Unref(e);
+	e = folded;
+
+	Stmt*& dead = v->IsZero() ? s1 : s2;
+	Stmt* null_stmt = new NullStmt();
+	null_stmt->SetLocationInfo(dead->GetLocationInfo());
+	Unref(dead);
+	dead = null_stmt;
+	}
+
 Val* IfStmt::DoExec(Frame* f, Val* v, stmt_flow_type& flow) const
 	{
 	// Treat 0 as false, but don't require 1 for true.
@@ -561,14 +575,17 @@ void SwitchStmt::Init()
 	{
 	TypeList* t = new TypeList();
 	t->Append(e->Type()->Ref());
-	comp_hash = new CompositeHash(t);
+	// The labels are constants of the script, whatever values get
+	// looked up, so there's no need for the keyed hash.
+	comp_hash = new CompositeHash(t, HASH_FAST);
 	Unref(t);
 
 	case_label_value_map.SetDeleteFunc(int_del_func);
 	}
 
 SwitchStmt::SwitchStmt(Expr* index, case_list* arg_cases) :
-	ExprStmt(STMT_SWITCH, index), cases(arg_cases), default_case_idx(-1)
+	ExprStmt(STMT_SWITCH, index), cases(arg_cases), default_case_idx(-1),
+	case_label_value_map(UNORDERED, 0, HASH_FAST)
 	{
 	Init();
 
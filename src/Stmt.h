@@ -11,6 +11,7 @@
 #include "Reporter.h"
 
 #include "StmtEnums.h"
+#include "ScriptProfiler.h"
 
 #include "TraverseTypes.h"
 
@@ -54,7 +55,12 @@ public:
 		return (ForStmt*) this;
 		}
 
-	void RegisterAccess() const	{ last_access = network_time; access_count++; }
+	void RegisterAccess() const
+		{
+		last_access = network_time;
+		access_count++;
+		ScriptProfiler::SetStmt(this);
+		}
 	void AccessStats(ODesc* d) const;
 	uint32 GetAccessCount() const { return access_count; }
 
@@ -153,6 +159,11 @@ public:
 	const Stmt* TrueBranch() const	{ return s1; }
 	const Stmt* FalseBranch() const	{ return s2; }
 
+	// Replaces the condition with its constant value, which must be
+	// known to never change, and drops the branch that can't be
+	// taken anymore.  Takes ownership of v.
+	void FoldCondition(Val* v);
+
 	void Describe(ODesc* d) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
@@ -211,7 +222,8 @@ public:
 
 protected:
 	friend class Stmt;
-	SwitchStmt()	{ cases = 0; default_case_idx = -1; comp_hash = 0; }
+	SwitchStmt() : case_label_value_map(UNORDERED, 0, HASH_FAST)
+		{ cases = 0; default_case_idx = -1; comp_hash = 0; }
 
 	Val* DoExec(Frame* f, Val* v, stmt_flow_type& flow) const override;
 	int IsPure() const override;
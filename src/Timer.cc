@@ -5,17 +5,22 @@
 #include "util.h"
 #include "Timer.h"
 #include "Desc.h"
+#include "Probes.h"
+#include "StallDetector.h"
 #include "broker/Manager.h"
 
 // Names of timers in same order than in TimerType.
 const char* TimerNames[] = {
 	"BackdoorTimer",
 	"BreakpointTimer",
+	"CheckpointTimer",
 	"ConnectionDeleteTimer",
 	"ConnectionExpireTimer",
 	"ConnectionInactivityTimer",
+	"ConnectionInactivitySweepTimer",
 	"ConnectionStatusUpdateTimer",
 	"DNSExpireTimer",
+	"DNSSummaryTimer",
 	"FileAnalysisInactivityTimer",
 	"FlowWeirdTimer",
 	"FragTimer",
@@ -64,6 +69,8 @@ int TimerMgr::Advance(double arg_t, int max_expire)
 	DBG_LOG(DBG_TM, "advancing %stimer mgr %p to %.6f",
 		this == timer_mgr ? "global " : "", this, arg_t);
 
+	StallTimer st(StallDetector::TIMERS);
+
 	t = arg_t;
 	last_timestamp = 0;
 	num_expired = 0;
@@ -127,7 +134,9 @@ int PQ_TimerMgr::DoAdvance(double new_t, int max_expire)
 
 		DBG_LOG(DBG_TM, "Dispatching timer %s in TimeMgr %p",
 				timer_type_to_string(timer->Type()), this);
+		ZEEK_PROBE1(timer__start, timer_type_to_string(timer->Type()));
 		timer->Dispatch(new_t, 0);
+		ZEEK_PROBE1(timer__done, timer_type_to_string(timer->Type()));
 		delete timer;
 
 		timer = Top();
@@ -202,7 +211,9 @@ int CQ_TimerMgr::DoAdvance(double new_t, int max_expire)
 		last_timestamp = timer->Time();
 		DBG_LOG(DBG_TM, "Dispatching timer %s in TimeMgr %p",
 				timer_type_to_string(timer->Type()), this);
+		ZEEK_PROBE1(timer__start, timer_type_to_string(timer->Type()));
 		timer->Dispatch(new_t, 0);
+		ZEEK_PROBE1(timer__done, timer_type_to_string(timer->Type()));
 		--current_timers[timer->Type()];
 		delete timer;
 		++num_expired;
@@ -227,3 +238,278 @@ void CQ_TimerMgr::Remove(Timer* timer)
 		delete timer;
 		}
 	}
+
+Wheel_TimerMgr::Wheel_TimerMgr(const Tag& tag, double arg_resolution)
+	: TimerMgr(tag)
+	{
+	resolution = arg_resolution;
+	now_tick = 0;
+
+	for ( int i = 0; i < LEVELS; ++i )
+		level_size[i] = 0;
+
+	num_wheel_timers = 0;
+	q = new PriorityQueue;
+
+	peak_size = 0;
+	cumulative_num = 0;
+	}
+
+Wheel_TimerMgr::~Wheel_TimerMgr()
+	{
+	for ( int i = 0; i < LEVELS * SLOTS; ++i )
+		for ( size_t j = 0; j < slots[i].size(); ++j )
+			delete slots[i][j];
+
+	delete q;
+	}
+
+uint64 Wheel_TimerMgr::TimeToTick(double t) const
+	{
+	// Keep well clear of overflowing when adding a full wheel's span.
+	static const double max_tick = double(uint64(1) << 62);
+
+	if ( t <= 0.0 )
+		return 0;
+
+	double tick = t / resolution;
+
+	if ( tick >= max_tick )
+		return uint64(1) << 62;
+
+	return uint64(tick);
+	}
+
+void Wheel_TimerMgr::Insert(Timer* timer)
+	{
+	uint64 tick = TimeToTick(timer->Time());
+
+	if ( tick <= now_tick )
+		{
+		if ( ! q->Add(timer) )
+			reporter->InternalError("out of memory");
+
+		timer->wheel_slot = IN_QUEUE;
+		return;
+		}
+
+	// Timers beyond the span of the wheel go into the slot furthest
+	// out; once that one cascades, they get filed anew.
+	static const uint64 max_delta = (uint64(1) << (LEVELS * SLOT_BITS)) - 1;
+
+	if ( tick - now_tick > max_delta )
+		tick = now_tick + max_delta;
+
+	uint64 delta = tick - now_tick;
+	int level = 0;
+
+	while ( delta >= (uint64(1) << ((level + 1) * SLOT_BITS)) )
+		++level;
+
+	int slot = level * SLOTS + ((tick >> (level * SLOT_BITS)) & (SLOTS - 1));
+	std::vector<Timer*>& v = slots[slot];
+
+	timer->wheel_slot = slot;
+	timer->SetOffset(v.size());
+	v.push_back(timer);
+
+	++level_size[level];
+	++num_wheel_timers;
+	}
+
+void Wheel_TimerMgr::Add(Timer* timer)
+	{
+	DBG_LOG(DBG_TM, "Adding timer %s to TimeMgr %p",
+			timer_type_to_string(timer->Type()), this);
+
+	// With nothing pending, we can move the clock straight to the new
+	// timer rather than stepping through all the empty ticks later.
+	if ( Size() == 0 )
+		{
+		uint64 tick = TimeToTick(timer->Time());
+
+		if ( tick > now_tick )
+			now_tick = tick;
+		}
+
+	Insert(timer);
+
+	++cumulative_num;
+	if ( Size() > peak_size )
+		peak_size = Size();
+
+	++current_timers[timer->Type()];
+	}
+
+void Wheel_TimerMgr::Cascade(int slot)
+	{
+	if ( slots[slot].empty() )
+		return;
+
+	std::vector<Timer*> v;
+	v.swap(slots[slot]);
+
+	level_size[slot / SLOTS] -= v.size();
+	num_wheel_timers -= v.size();
+
+	for ( size_t i = 0; i < v.size(); ++i )
+		Insert(v[i]);
+	}
+
+void Wheel_TimerMgr::Flush(int slot)
+	{
+	std::vector<Timer*>& v = slots[slot];
+
+	for ( size_t i = 0; i < v.size(); ++i )
+		{
+		if ( ! q->Add(v[i]) )
+			reporter->InternalError("out of memory");
+
+		v[i]->wheel_slot = IN_QUEUE;
+		}
+
+	level_size[slot / SLOTS] -= v.size();
+	num_wheel_timers -= v.size();
+	v.clear();
+	}
+
+void Wheel_TimerMgr::Step(uint64 target)
+	{
+	// If the lowest levels are empty, there's nothing to do until the
+	// next time the level above them cascades.
+	uint64 next = target;
+	int level;
+
+	for ( level = 0; level < LEVELS; ++level )
+		{
+		if ( level_size[level] > 0 )
+			{
+			uint64 span = uint64(1) << (level * SLOT_BITS);
+			next = (now_tick | (span - 1)) + 1;
+			break;
+			}
+		}
+
+	if ( next > target )
+		next = target;
+
+	now_tick = next;
+
+	// Whenever a level wraps around, it pulls in the timers of the next
+	// slot of the level above.
+	for ( level = 1; level < LEVELS; ++level )
+		{
+		uint64 low_bits = (uint64(1) << (level * SLOT_BITS)) - 1;
+
+		if ( now_tick & low_bits )
+			break;
+
+		int idx = (now_tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+		Cascade(level * SLOTS + idx);
+		}
+
+	Flush(now_tick & (SLOTS - 1));
+	}
+
+int Wheel_TimerMgr::DoAdvance(double new_t, int max_expire)
+	{
+	uint64 target = TimeToTick(new_t);
+
+	for ( num_expired = 0; ; )
+		{
+		Timer* timer = (Timer*) q->Top();
+
+		if ( timer && timer->Time() <= new_t )
+			{
+			if ( max_expire > 0 && num_expired >= max_expire )
+				break;
+
+			last_timestamp = timer->Time();
+			--current_timers[timer->Type()];
+
+			// Remove it before dispatching, since the dispatch
+			// can otherwise delete it, and then we won't know
+			// whether we should delete it too.
+			(void) q->Remove();
+
+			DBG_LOG(DBG_TM, "Dispatching timer %s in TimeMgr %p",
+					timer_type_to_string(timer->Type()), this);
+			ZEEK_PROBE1(timer__start, timer_type_to_string(timer->Type()));
+			timer->Dispatch(new_t, 0);
+			ZEEK_PROBE1(timer__done, timer_type_to_string(timer->Type()));
+			delete timer;
+
+			++num_expired;
+			continue;
+			}
+
+		// Anything left in the queue expires later during the current
+		// tick.
+		if ( timer || now_tick >= target )
+			break;
+
+		if ( num_wheel_timers == 0 )
+			{
+			now_tick = target;
+			break;
+			}
+
+		Step(target);
+		}
+
+	return num_expired;
+	}
+
+void Wheel_TimerMgr::Expire()
+	{
+	while ( Size() > 0 )
+		{
+		// Gather everything in the queue, so that we still dispatch
+		// in order.
+		for ( int i = 0; i < LEVELS * SLOTS; ++i )
+			Flush(i);
+
+		Timer* timer;
+		while ( (timer = (Timer*) q->Remove()) )
+			{
+			DBG_LOG(DBG_TM, "Dispatching timer %s in TimeMgr %p",
+					timer_type_to_string(timer->Type()), this);
+			timer->Dispatch(t, 1);
+			--current_timers[timer->Type()];
+			delete timer;
+			}
+		}
+	}
+
+void Wheel_TimerMgr::Remove(Timer* timer)
+	{
+	int slot = timer->wheel_slot;
+
+	if ( slot == IN_QUEUE )
+		{
+		if ( ! q->Remove(timer) )
+			reporter->InternalError("asked to remove a missing timer");
+		}
+
+	else
+		{
+		int offset = timer->Offset();
+
+		if ( slot > IN_QUEUE || offset < 0 ||
+		     offset >= int(slots[slot].size()) ||
+		     slots[slot][offset] != timer )
+			reporter->InternalError("asked to remove a missing timer");
+
+		std::vector<Timer*>& v = slots[slot];
+		v[offset] = v.back();
+		v[offset]->SetOffset(offset);
+		v.pop_back();
+
+		timer->SetOffset(-1);
+		--level_size[slot / SLOTS];
+		--num_wheel_timers;
+		}
+
+	--current_timers[timer->Type()];
+	delete timer;
+	}
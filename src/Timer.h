@@ -6,7 +6,9 @@
 #include <string>
 
 #include <string>
+#include <vector>
 #include "PriorityQueue.h"
+#include "Slab.h"
 
 extern "C" {
 #include "cq.h"
@@ -16,11 +18,14 @@ extern "C" {
 enum TimerType {
 	TIMER_BACKDOOR,
 	TIMER_BREAKPOINT,
+	TIMER_CHECKPOINT,
 	TIMER_CONN_DELETE,
 	TIMER_CONN_EXPIRE,
 	TIMER_CONN_INACTIVITY,
+	TIMER_CONN_INACTIVITY_SWEEP,
 	TIMER_CONN_STATUS_UPDATE,
 	TIMER_DNS_EXPIRE,
+	TIMER_DNS_SUMMARY,
 	TIMER_FILE_ANALYSIS_INACTIVITY,
 	TIMER_FLOW_WEIRD_EXPIRE,
 	TIMER_FRAG,
@@ -52,6 +57,8 @@ class ODesc;
 
 class Timer : public PQ_Element {
 public:
+	DECLARE_SLAB_ALLOCATED
+
 	Timer(double t, TimerType arg_type) : PQ_Element(t)
 		{ type = (char) arg_type; }
 	~Timer() override { }
@@ -66,9 +73,12 @@ public:
 	void Describe(ODesc* d) const;
 
 protected:
+	friend class Wheel_TimerMgr;
+
 	Timer()	{}
 
 	unsigned int type:8;
+	unsigned int wheel_slot:24;	// for use by Wheel_TimerMgr
 };
 
 class TimerMgr {
@@ -174,6 +184,69 @@ protected:
 	struct cq_handle *cq;
 };
 
+// A hierarchical timing wheel. Time is divided into ticks of a fixed
+// resolution, and timers are filed into one of several levels of slots
+// depending on how far in the future they expire; whenever the lower
+// levels wrap around, the next slot of the level above is redistributed
+// ("cascaded") among them. Adding and cancelling a timer are constant
+// time. Timers expiring in the current tick are kept in a small priority
+// queue, so that they are still dispatched in order of their times.
+class Wheel_TimerMgr : public TimerMgr {
+public:
+	explicit Wheel_TimerMgr(const Tag& arg_tag, double arg_resolution = 0.01);
+	~Wheel_TimerMgr() override;
+
+	void Add(Timer* timer) override;
+	void Expire() override;
+
+	int Size() const override { return num_wheel_timers + q->Size(); }
+	int PeakSize() const override { return peak_size; }
+	uint64 CumulativeNum() const override { return cumulative_num; }
+
+protected:
+	// Each level has 2^SLOT_BITS slots; a slot at level n spans
+	// 2^(n * SLOT_BITS) ticks.
+	static const int LEVELS = 4;
+	static const int SLOT_BITS = 8;
+	static const int SLOTS = 1 << SLOT_BITS;
+
+	// Value of Timer::wheel_slot for timers in the queue.
+	static const int IN_QUEUE = LEVELS * SLOTS;
+
+	int DoAdvance(double t, int max_expire) override;
+	void Remove(Timer* timer) override;
+
+	uint64 TimeToTick(double t) const;
+
+	// Files the timer into the wheel, or into the queue if it expires
+	// no later than the current tick.
+	void Insert(Timer* timer);
+
+	// Moves the clock forward by at least one tick, but no further than
+	// the given one, skipping over ticks with nothing to do.
+	void Step(uint64 target);
+
+	// Re-inserts all timers of the given slot relative to the current
+	// tick.
+	void Cascade(int slot);
+
+	// Moves all timers of the given slot into the queue.
+	void Flush(int slot);
+
+	double resolution;
+	uint64 now_tick;	// all earlier ticks are done
+
+	std::vector<Timer*> slots[LEVELS * SLOTS];
+	int level_size[LEVELS];
+	int num_wheel_timers;
+
+	// Timers expiring in the current tick (or earlier).
+	PriorityQueue* q;
+
+	int peak_size;
+	uint64 cumulative_num;
+};
+
 extern TimerMgr* timer_mgr;
 
 #endif
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <set>
 
 #include "Trigger.h"
 #include "Traverse.h"
@@ -17,9 +18,69 @@ public:
 	virtual TraversalCode PreExpr(const Expr*);
 
 private:
+	// If the table gets looked up by a simple index, registers that
+	// key with the trigger instead of the whole table.
+	void RegisterKey(const Expr* table, const Expr* index);
+
 	Trigger* trigger;
+
+	// Names of tables whose keys got registered.
+	std::set<const Expr*> keyed;
 };
 
+// Returns true if evaluating the index is cheap and has no side effects.
+static bool is_simple_index(const Expr* index)
+	{
+	if ( index->Tag() == EXPR_LIST )
+		{
+		const expr_list& exprs = static_cast<const ListExpr*>(index)->Exprs();
+
+		loop_over_list(exprs, i)
+			if ( ! is_simple_index(exprs[i]) )
+				return false;
+
+		return true;
+		}
+
+	return index->Tag() == EXPR_NAME || index->Tag() == EXPR_CONST;
+	}
+
+void TriggerTraversalCallback::RegisterKey(const Expr* table, const Expr* index)
+	{
+	if ( table->Tag() != EXPR_NAME || table->Type()->Tag() != TYPE_TABLE ||
+	     index->Type()->Tag() == TYPE_RECORD || ! is_simple_index(index) )
+		return;
+
+	Val* tv = static_cast<const NameExpr*>(table)->Id()->ID_Val();
+
+	// Lookups in subnet tables match prefixes, not keys.
+	if ( ! tv || tv->AsTableVal()->Subnets() )
+		return;
+
+	BroObj::SuppressErrors no_errors;
+	Val* idx = 0;
+
+	try
+		{
+		idx = index->Eval(trigger->frame);
+		}
+	catch ( InterpreterException& )
+		{ /* Already reported */ }
+
+	if ( ! idx )
+		return;
+
+	HashKey* k = tv->AsTableVal()->ComputeHash(idx);
+	Unref(idx);
+
+	if ( ! k )
+		return;
+
+	trigger->Register(tv, std::string(static_cast<const char*>(k->Key()), k->Size()));
+	keyed.insert(table);
+	delete k;
+	}
+
 TraversalCode TriggerTraversalCallback::PreExpr(const Expr* expr)
 	{
 	// We catch all expressions here which in some way reference global
@@ -32,15 +93,28 @@ TraversalCode TriggerTraversalCallback::PreExpr(const Expr* expr)
 		if ( e->Id()->IsGlobal() )
 			trigger->Register(e->Id());
 
+		if ( keyed.erase(e) )
+			// Only the key we registered matters.
+			break;
+
 		Val* v = e->Id()->ID_Val();
 		if ( v && v->Modifiable() )
 			trigger->Register(v);
 		break;
 		};
 
+	case EXPR_IN:
+		{
+		const BinaryExpr* e = static_cast<const BinaryExpr*>(expr);
+		RegisterKey(e->Op2(), e->Op1());
+		break;
+		}
+
 	case EXPR_INDEX:
 		{
 		const IndexExpr* e = static_cast<const IndexExpr*>(expr);
+		RegisterKey(e->Op1(), e->Op2());
+
 		BroObj::SuppressErrors no_errors;
 
 		try
@@ -117,6 +191,7 @@ Trigger::Trigger(Expr* arg_cond, Stmt* arg_body, Stmt* arg_timeout_stmts,
 	timer = 0;
 	delayed = false;
 	disabled = false;
+	queued = false;
 	attached = 0;
 	is_return = arg_is_return;
 	location = arg_location;
@@ -298,9 +373,10 @@ void Trigger::QueueTrigger(Trigger* trigger)
 	{
 	assert(! trigger->disabled);
 	assert(pending);
-	if ( std::find(pending->begin(), pending->end(), trigger) == pending->end() )
+	if ( ! trigger->queued )
 		{
 		Ref(trigger);
+		trigger->queued = true;
 		pending->push_back(trigger);
 		}
 	}
@@ -323,7 +399,9 @@ void Trigger::EvaluatePending()
 	for ( TriggerList::iterator i = orig->begin(); i != orig->end(); ++i )
 		{
 		Trigger* t = *i;
-		(*i)->Eval();
+		// From here on, a modification queues it again.
+		t->queued = false;
+		t->Eval();
 		Unref(t);
 		}
 
@@ -400,6 +478,15 @@ void Trigger::Register(Val* val)
 	objs.emplace_back(val, val->Modifiable());
 	}
 
+void Trigger::Register(Val* val, const std::string& key)
+	{
+	assert(! disabled);
+	notifier::registry.Register(val->Modifiable(), this, key);
+
+	Ref(val);
+	keyed_objs.emplace_back(val, key);
+	}
+
 void Trigger::UnregisterAll()
 	{
 	DBG_LOG(DBG_NOTIFIERS, "%s: unregistering all", Name());
@@ -411,6 +498,14 @@ void Trigger::UnregisterAll()
 		}
 
 	objs.clear();
+
+	for ( const auto& o : keyed_objs )
+		{
+		notifier::registry.Unregister(o.first->Modifiable(), this, o.second);
+		Unref(o.first);
+		}
+
+	keyed_objs.clear();
 	}
 
 void Trigger::Attach(Trigger *trigger)
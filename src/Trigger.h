@@ -85,6 +85,7 @@ private:
 	void Init();
 	void Register(ID* id);
 	void Register(Val* val);
+	void Register(Val* val, const std::string& key);
 	void UnregisterAll();
 
 	Expr* cond;
@@ -101,9 +102,13 @@ private:
 
 	bool delayed; // true if a function call is currently being delayed
 	bool disabled;
+	bool queued; // true while waiting in the list of pending triggers
 
 	std::vector<std::pair<BroObj *, notifier::Modifiable*>> objs;
 
+	// Tables registered for a single key, with the key's bytes.
+	std::vector<std::pair<Val*, std::string>> keyed_objs;
+
 	typedef map<const CallExpr*, Val*> ValCache;
 	ValCache cache;
 
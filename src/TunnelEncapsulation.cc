@@ -28,11 +28,37 @@ RecordVal* EncapsulatingConn::GetRecordVal() const
 	rv->Assign(0, id_val);
 	rv->Assign(1, BifType::Enum::Tunnel::Type->GetVal(type));
 
-	rv->Assign(2, new StringVal(uid.Base62("C").c_str()));
+	char uid_buf[BRO_UID_BASE62_LEN];
+	rv->Assign(2, new StringVal(uid.Base62(uid_buf, 'C')));
 
 	return rv;
 	}
 
+const EncapsulationStack* InnerEncapsulation::Get(Connection* c,
+                                                  BifEnum::Tunnel::Type t)
+	{
+	const EncapsulationStack* e = c->GetEncapsulation();
+
+	if ( inner && type == t )
+		{
+		size_t depth = e ? e->Depth() : 0;
+		size_t outer_depth = outer ? outer->Depth() : 0;
+
+		if ( depth == outer_depth && (depth == 0 || *e == *outer) )
+			return inner;
+		}
+
+	delete outer;
+	delete inner;
+
+	outer = e ? new EncapsulationStack(*e) : 0;
+	inner = e ? new EncapsulationStack(*e) : new EncapsulationStack();
+	inner->Add(EncapsulatingConn(c, t));
+	type = t;
+
+	return inner;
+	}
+
 bool operator==(const EncapsulationStack& e1, const EncapsulationStack& e2)
 	{
 	if ( ! e1.conns )
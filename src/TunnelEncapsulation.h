@@ -94,7 +94,8 @@ public:
 			  ((ec1.src_addr == ec2.src_addr && ec1.dst_addr == ec2.dst_addr) ||
 			   (ec1.src_addr == ec2.dst_addr && ec1.dst_addr == ec2.src_addr));
 
-		if ( ec1.type == BifEnum::Tunnel::VXLAN )
+		if ( ec1.type == BifEnum::Tunnel::VXLAN ||
+		     ec1.type == BifEnum::Tunnel::GENEVE )
 			// Reversing endpoints is still same tunnel, destination port is
 			// always the same.
 			return ec1.dst_port == ec2.dst_port &&
@@ -217,4 +218,38 @@ protected:
 	vector<EncapsulatingConn>* conns;
 };
 
+/**
+ * The encapsulation of the packets that a tunnel connection carries, kept
+ * by its analyzer so that it doesn't need to be built for each of them.
+ */
+class InnerEncapsulation {
+public:
+	InnerEncapsulation()
+		: outer(0), inner(0), type(BifEnum::Tunnel::NONE)
+		{}
+
+	~InnerEncapsulation()
+		{
+		delete outer;
+		delete inner;
+		}
+
+	/**
+	 * Returns the encapsulation of packets found inside a tunnel
+	 * connection: the connection's own encapsulation plus the tunnel.
+	 * It's rebuilt only if the connection's encapsulation has changed
+	 * since last time.
+	 *
+	 * @param c The tunnel connection.
+	 * @param t The type of tunneling that is occurring over the connection.
+	 * @return The encapsulation, valid until the next call.
+	 */
+	const EncapsulationStack* Get(Connection* c, BifEnum::Tunnel::Type t);
+
+private:
+	EncapsulationStack* outer;	// copy of the connection's encapsulation
+	EncapsulationStack* inner;
+	BifEnum::Tunnel::Type type;
+};
+
 #endif
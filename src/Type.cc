@@ -13,6 +13,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <algorithm>
 
 BroType::TypeAliasMap BroType::type_aliases;
 
@@ -693,10 +694,38 @@ void TypeDecl::DescribeReST(ODesc* d, bool roles_only) const
 		}
 	}
 
+// Records with up to this many fields get their field offsets looked up
+// by a linear search, which is faster than hashing for few fields.
+static const int MAX_LINEAR_FIELD_OFFSETS = 8;
+
+static uint64 record_type_serial = 0;
+
+// Pairs of record type serials, ordered, that same_type() found to be
+// the same, separately for each combination of its flags. Only adding
+// fields changes the result, so that clears them.
+static std::set<std::pair<uint64, uint64> > same_record_types[2][2];
+
+static void clear_same_record_types()
+	{
+	for ( int i = 0; i < 2; ++i )
+		for ( int j = 0; j < 2; ++j )
+			same_record_types[i][j].clear();
+	}
+
+RecordType::RecordType() : BroType(TYPE_RECORD)
+	{
+	types = 0;
+	num_fields = 0;
+	serial = ++record_type_serial;
+	field_offsets = 0;
+	}
+
 RecordType::RecordType(type_decl_list* arg_types) : BroType(TYPE_RECORD)
 	{
 	types = arg_types;
 	num_fields = types ? types->length() : 0;
+	serial = ++record_type_serial;
+	field_offsets = 0;
 	}
 
 // in this case the clone is actually not so shallow, since
@@ -711,6 +740,8 @@ RecordType* RecordType::ShallowClone()
 
 RecordType::~RecordType()
 	{
+	delete field_offsets;
+
 	if ( types )
 		{
 		loop_over_list(*types, i)
@@ -750,14 +781,31 @@ Val* RecordType::FieldDefault(int field) const
 
 int RecordType::FieldOffset(const char* field) const
 	{
-	loop_over_list(*types, i)
+	if ( num_fields <= MAX_LINEAR_FIELD_OFFSETS )
 		{
-		TypeDecl* td = (*types)[i];
-		if ( streq(td->id, field) )
-			return i;
+		loop_over_list(*types, i)
+			{
+			TypeDecl* td = (*types)[i];
+			if ( streq(td->id, field) )
+				return i;
+			}
+
+		return -1;
+		}
+
+	if ( ! field_offsets )
+		{
+		field_offsets = new std::unordered_map<std::string, int>;
+		field_offsets->reserve(num_fields);
+
+		// Going backwards makes the first of duplicate names win,
+		// as with the linear search.
+		for ( int i = num_fields - 1; i >= 0; --i )
+			(*field_offsets)[(*types)[i]->id] = i;
 		}
 
-	return -1;
+	auto it = field_offsets->find(field);
+	return it != field_offsets->end() ? it->second : -1;
 	}
 
 const char* RecordType::FieldName(int field) const
@@ -852,6 +900,11 @@ const char* RecordType::AddFields(type_decl_list* others, attr_list* attr)
 	delete others;
 
 	num_fields = types->length();
+
+	delete field_offsets;
+	field_offsets = 0;
+
+	clear_same_record_types();
 	return 0;
 	}
 
@@ -1556,6 +1609,15 @@ int same_type(const BroType* t1, const BroType* t2, int is_init, bool match_reco
 		if ( rt1->NumFields() != rt2->NumFields() )
 			return 0;
 
+		// Redef'd records get compared over and over again, and
+		// they tend to be large, so remember which are the same.
+		auto key = std::make_pair(std::min(rt1->Serial(), rt2->Serial()),
+					  std::max(rt1->Serial(), rt2->Serial()));
+		auto& known = same_record_types[is_init != 0][match_record_field_names];
+
+		if ( known.find(key) != known.end() )
+			return 1;
+
 		for ( int i = 0; i < rt1->NumFields(); ++i )
 			{
 			const TypeDecl* td1 = rt1->FieldDecl(i);
@@ -1566,6 +1628,7 @@ int same_type(const BroType* t1, const BroType* t2, int is_init, bool match_reco
 				return 0;
 			}
 
+		known.insert(key);
 		return 1;
 		}
 
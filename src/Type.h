@@ -502,11 +502,21 @@ public:
 
 	string GetFieldDeprecationWarning(int field, bool has_check) const;
 
+	// A number identifying this type for as long as the process runs.
+	// Unlike the address, it's never reused for another type.
+	uint64 Serial() const			{ return serial; }
+
 protected:
-	RecordType() { types = 0; }
+	RecordType();
 
 	int num_fields;
 	type_decl_list* types;
+
+	uint64 serial;
+
+	// Maps field names to offsets once there are enough fields for a
+	// linear search to be slower. Built on first use, 0 before.
+	mutable std::unordered_map<std::string, int>* field_offsets;
 };
 
 class SubNetType : public BroType {
@@ -633,9 +643,13 @@ extern OpaqueType* entropy_type;
 extern OpaqueType* cardinality_type;
 extern OpaqueType* topk_type;
 extern OpaqueType* bloomfilter_type;
+extern OpaqueType* cuckoofilter_type;
+extern OpaqueType* xorfilter_type;
+extern OpaqueType* countminsketch_type;
 extern OpaqueType* x509_opaque_type;
 extern OpaqueType* ocsp_resp_opaque_type;
 extern OpaqueType* paraglob_type;
+extern OpaqueType* pattern_stream_type;
 
 // Returns the Bro basic (non-parameterized) type with the given type.
 // The reference count of the type is not increased.
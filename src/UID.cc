@@ -3,6 +3,7 @@
 #include <cstdlib>
 
 #include "UID.h"
+#include "NetVar.h"
 
 using namespace Bro;
 using namespace std;
@@ -21,8 +22,43 @@ void UID::Set(bro_uint_t bits, const uint64* v, size_t n)
 	size_t size = res.rem ? res.quot + 1 : res.quot;
 
 	for ( size_t i = 0; i < size; ++i )
-		uid[i] = v && i < n ? v[i] : calculate_unique_id();
+		{
+		if ( v && i < n )
+			uid[i] = v[i];
+		else if ( fast_uids )
+			uid[i] = calculate_fast_unique_id(UID_POOL_DEFAULT_INTERNAL);
+		else
+			uid[i] = calculate_unique_id();
+		}
 
 	if ( res.rem )
 		uid[0] >>= 64 - res.rem;
 	}
+
+const char* UID::Base62(char* buf, char prefix) const
+	{
+	// Same digits as uitoa_n(), in the same order.
+	static const char dig[] =
+		"0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+	if ( ! initialized )
+		reporter->InternalError("use of uninitialized UID");
+
+	char* p = buf;
+
+	if ( prefix )
+		*p++ = prefix;
+
+	for ( size_t i = 0; i < BRO_UID_LEN; ++i )
+		{
+		uint64 v = uid[i];
+
+		do {
+			*p++ = dig[v % 62];
+			v /= 62;
+		} while ( v );
+		}
+
+	*p = '\0';
+	return buf;
+	}
@@ -10,6 +10,10 @@
 
 #define BRO_UID_LEN 2
 
+// Space needed for the base62 representation of a UID with a one-character
+// prefix: up to 11 digits per 64-bit value, plus the terminating null.
+#define BRO_UID_BASE62_LEN (1 + BRO_UID_LEN * 11 + 1)
+
 namespace Bro {
 
 /**
@@ -43,7 +47,8 @@ public:
 	 * @param v A pointer to an array of values with which to initialize the
 	 *          UID.  If empty or doesn't contain enough values to satisfy
 	 *          \a bits, then values are automatically generated using
-	 *          calculate_unique_id().  If \a bits isn't evenly divisible by
+	 *          calculate_unique_id(), or calculate_fast_unique_id() if
+	 *          \a fast_uids is set.  If \a bits isn't evenly divisible by
 	 *          64, then a value is truncated to bit in desired bit-length.
 	 * @param n number of 64-bit elements in array pointed to by \a v.
 	 */
@@ -56,6 +61,15 @@ public:
 	 */
 	std::string Base62(std::string prefix = "") const;
 
+	/**
+	 * Writes the same representation as Base62() into a buffer, which
+	 * avoids allocating memory.
+	 * @param buf A buffer of at least BRO_UID_BASE62_LEN bytes.
+	 * @param prefix A character to start with, or 0 for none.
+	 * @return \a buf.
+	 */
+	const char* Base62(char* buf, char prefix) const;
+
 	/**
 	 * @return false if the UID instance was created via the default ctor
 	 *         and not yet initialized w/ Set().
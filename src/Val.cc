@@ -12,9 +12,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
+
 #include "Val.h"
 #include "Net.h"
 #include "File.h"
+#include "FreeList.h"
 #include "Func.h"
 #include "RE.h"
 #include "Scope.h"
@@ -70,6 +73,42 @@ Val::~Val()
 #endif
 	}
 
+// Upper bound on the number of freed Vals we hang on to.
+#define VAL_POOL_MAX 16384
+
+// The pooled blocks have room for a Val plus the remembered hash of
+// AddrVal and StringVal, so that those get pooled as well.
+static const size_t VAL_POOL_SLOT = sizeof(Val) + sizeof(hash_t);
+
+static_assert(sizeof(AddrVal) <= VAL_POOL_SLOT,
+	      "AddrVal no longer fits the Val pool's blocks");
+static_assert(sizeof(StringVal) <= VAL_POOL_SLOT,
+	      "StringVal no longer fits the Val pool's blocks");
+
+// Vals are only ever created by the main thread.
+static FreeList<VAL_POOL_MAX> val_pool;
+
+void* Val::operator new(size_t size)
+	{
+	if ( size <= VAL_POOL_SLOT )
+		{
+		if ( void* v = val_pool.Get() )
+			return v;
+
+		return ::operator new(VAL_POOL_SLOT);
+		}
+
+	return ::operator new(size);
+	}
+
+void Val::operator delete(void* ptr, size_t size)
+	{
+	if ( size <= VAL_POOL_SLOT && val_pool.Put(ptr) )
+		return;
+
+	::operator delete(ptr);
+	}
+
 Val* Val::Clone()
 	{
 	Val::CloneState state;
@@ -557,6 +596,16 @@ AddrVal::~AddrVal()
 	delete val.addr_val;
 	}
 
+HashKey* AddrVal::GetHashKey() const
+	{
+	if ( hash )
+		return val.addr_val->GetHashKey(hash);
+
+	HashKey* k = val.addr_val->GetHashKey();
+	hash = k->Hash();
+	return k;
+	}
+
 unsigned int AddrVal::MemoryAllocation() const
 	{
 	return padded_sizeof(*this) + val.addr_val->MemoryAllocation();
@@ -716,9 +765,22 @@ StringVal::StringVal(const string& s) : Val(TYPE_STRING)
 StringVal* StringVal::ToUpper()
 	{
 	val.string_val->ToUpper();
+	hash = 0;
 	return this;
 	}
 
+HashKey* StringVal::GetHashKey() const
+	{
+	const BroString* s = val.string_val;
+
+	if ( hash )
+		return new HashKey(s->Bytes(), s->Len(), hash, true);
+
+	HashKey* k = new HashKey(s);
+	hash = k->Hash();
+	return k;
+	}
+
 void StringVal::ValDescribe(ODesc* d) const
 	{
 	// Should reintroduce escapes ? ###
@@ -736,12 +798,10 @@ unsigned int StringVal::MemoryAllocation() const
 
 Val* StringVal::DoClone(CloneState* state)
 	{
-	// We could likely treat this type as immutable and return a reference
-	// instead of creating a new copy, but we first need to be careful and
-	// audit whether anything internal actually does mutate it.
-	return state->NewClone(this, new StringVal(
-	        new BroString((u_char*) val.string_val->Bytes(),
-	                      val.string_val->Len(), 1)));
+	// Immutable. The only in-place modification is ToUpper(), which
+	// callers apply to values they just created, before anyone else
+	// can have gotten hold of them.
+	return Ref();
 	}
 
 PatternVal::PatternVal(RE_Matcher* re) : Val(base_type(TYPE_PATTERN))
@@ -945,10 +1005,14 @@ void TableVal::Init(TableType* t)
 	::Ref(t);
 	table_type = t;
 	expire_func = 0;
+	expire_batch_func = 0;
 	expire_time = 0;
 	expire_cookie = 0;
 	timer = 0;
 	def_val = 0;
+	changes = 0;
+	changes_cleared = false;
+	expire_index = 0;
 
 	if ( t->IsSubNetIndex() )
 		subnets = new PrefixTable;
@@ -972,7 +1036,18 @@ TableVal::~TableVal()
 	Unref(attrs);
 	Unref(def_val);
 	Unref(expire_func);
+	Unref(expire_batch_func);
 	Unref(expire_time);
+	delete changes;
+
+	if ( expire_index )
+		{
+		for ( auto& b : *expire_index )
+			for ( auto k : b.second )
+				delete k;
+
+		delete expire_index;
+		}
 	}
 
 void TableVal::RemoveAll()
@@ -981,6 +1056,82 @@ void TableVal::RemoveAll()
 	delete AsTable();
 	val.table_val = new PDict(TableEntryVal);
 	val.table_val->SetDeleteFunc(table_entry_val_delete_func);
+
+	if ( changes )
+		{
+		changes->clear();
+		changes_cleared = true;
+		}
+	}
+
+void TableVal::Reserve(int n)
+	{
+	if ( Size() > 0 || expire_cookie )
+		return;
+
+	delete AsTable();
+	val.table_val = new PDict(TableEntryVal)(UNORDERED, n);
+	val.table_val->SetDeleteFunc(table_entry_val_delete_func);
+	}
+
+void TableVal::TakeEntries(TableVal* other)
+	{
+	if ( expire_cookie )
+		{
+		// The iteration over the old entries can't go on.
+		AsTable()->StopIteration(expire_cookie);
+		expire_cookie = 0;
+		}
+
+	std::swap(val.table_val, other->val.table_val);
+	std::swap(subnets, other->subnets);
+	other->RemoveAll();
+
+	if ( other->subnets )
+		other->subnets->Clear();
+
+	if ( changes )
+		{
+		changes->clear();
+		changes_cleared = true;
+		}
+
+	Modified();
+	}
+
+void TableVal::TrackChanges(bool track)
+	{
+	if ( track && ! changes )
+		{
+		changes = new std::map<std::string, hash_t>;
+		changes_cleared = false;
+		}
+
+	else if ( ! track )
+		{
+		delete changes;
+		changes = 0;
+		}
+	}
+
+bool TableVal::TakeChanges(std::vector<HashKey*>* keys)
+	{
+	if ( ! changes )
+		return true;
+
+	bool complete = ! changes_cleared;
+
+	if ( complete )
+		{
+		keys->reserve(keys->size() + changes->size());
+
+		for ( const auto& c : *changes )
+			keys->push_back(new HashKey(c.first.data(), c.first.size(), c.second));
+		}
+
+	changes->clear();
+	changes_cleared = false;
+	return complete;
 	}
 
 int TableVal::RecursiveSize() const
@@ -1024,6 +1175,13 @@ void TableVal::SetAttrs(Attributes* a)
 		expire_func = ef->AttrExpr();
 		expire_func->Ref();
 		}
+
+	Attr* ebf = attrs->FindAttr(ATTR_EXPIRE_BATCH_FUNC);
+	if ( ebf )
+		{
+		expire_batch_func = ebf->AttrExpr();
+		expire_batch_func->Ref();
+		}
 	}
 
 void TableVal::CheckExpireAttr(attr_tag at)
@@ -1099,13 +1257,26 @@ int TableVal::Assign(Val* index, HashKey* k, Val* new_val)
 	if ( old_entry_val && attrs && attrs->FindAttr(ATTR_EXPIRE_CREATE) )
 		new_entry_val->SetExpireAccess(old_entry_val->ExpireAccessTime());
 
+	if ( expire_index )
+		{
+		if ( old_entry_val )
+			// The key is queued already, slots only ever move
+			// later.
+			new_entry_val->expire_slot = old_entry_val->expire_slot;
+		else
+			AddToExpireIndex(new HashKey(k_copy.Key(), k_copy.Size(),
+						     k_copy.Hash()),
+					 new_entry_val, 0);
+		}
+
 	if ( old_entry_val )
 		{
 		old_entry_val->Unref();
 		delete old_entry_val;
 		}
 
-	Modified();
+	RecordChange(&k_copy);
+	Modified(k_copy.Key(), k_copy.Size());
 	return 1;
 	}
 
@@ -1471,7 +1642,12 @@ VectorVal* TableVal::LookupSubnets(const SubNetVal* search)
 	if ( ! subnets )
 		reporter->InternalError("LookupSubnets called on wrong table type");
 
-	VectorVal* result = new VectorVal(internal_type("subnet_vec")->AsVectorType());
+	static VectorType* subnet_vec_type = 0;
+
+	if ( ! subnet_vec_type )
+		subnet_vec_type = internal_type("subnet_vec")->AsVectorType();
+
+	VectorVal* result = new VectorVal(subnet_vec_type);
 
 	auto matches = subnets->FindAll(search);
 	for ( auto element : matches )
@@ -1513,6 +1689,46 @@ TableVal* TableVal::LookupSubnetValues(const SubNetVal* search)
 	return nt;
 	}
 
+VectorVal* TableVal::LookupAddrs(const VectorVal* addrs)
+	{
+	if ( ! subnets )
+		reporter->InternalError("LookupAddrs called on wrong table type");
+
+	int n = addrs->Size();
+	std::vector<IPAddr> a(n);
+	std::vector<void*> entries(n);
+
+	for ( int i = 0; i < n; ++i )
+		{
+		Val* v = addrs->Lookup(i);
+
+		if ( v )
+			a[i] = v->AsAddr();
+		}
+
+	subnets->Lookup(a.data(), n, entries.data());
+
+	static VectorType* bool_vec_type = 0;
+
+	if ( ! bool_vec_type )
+		bool_vec_type = internal_type("bool_vec")->AsVectorType();
+
+	VectorVal* result = new VectorVal(bool_vec_type);
+
+	for ( int i = 0; i < n; ++i )
+		{
+		// Holes in the vector don't match anything.
+		TableEntryVal* entry = addrs->Lookup(i) ? (TableEntryVal*) entries[i] : 0;
+
+		if ( entry && attrs && attrs->FindAttr(ATTR_EXPIRE_READ) )
+			entry->SetExpireAccess(network_time);
+
+		result->Assign(i, val_mgr->GetBool(entry != 0));
+		}
+
+	return result;
+	}
+
 bool TableVal::UpdateTimestamp(Val* index)
 	{
 	TableEntryVal* v;
@@ -1552,10 +1768,17 @@ Val* TableVal::Delete(const Val* index)
 	if ( subnets && ! subnets->Remove(index) )
 		reporter->InternalWarning("index not in prefix table");
 
+	if ( v )
+		RecordChange(k);
+
+	if ( k )
+		Modified(k->Key(), k->Size());
+	else
+		Modified();
+
 	delete k;
 	delete v;
 
-	Modified();
 	return va;
 	}
 
@@ -1572,9 +1795,12 @@ Val* TableVal::Delete(const HashKey* k)
 		Unref(index);
 		}
 
+	if ( v )
+		RecordChange(k);
+
 	delete v;
 
-	Modified();
+	Modified(k->Key(), k->Size());
 	return va;
 	}
 
@@ -1776,6 +2002,12 @@ void TableVal::DoExpire(double t)
 		// error, it has been reported already.
 		return;
 
+	if ( table_expire_index )
+		{
+		DoExpireIndexed(t, timeout);
+		return;
+		}
+
 	if ( ! expire_cookie )
 		{
 		expire_cookie = tbl->InitForIteration();
@@ -1784,8 +2016,8 @@ void TableVal::DoExpire(double t)
 
 	HashKey* k = 0;
 	TableEntryVal* v = 0;
-	TableEntryVal* v_saved = 0;
 	bool modified = false;
+	std::vector<HashKey*> batch;
 
 	for ( int i = 0; i < table_incremental_step &&
 			 (v = tbl->NextEntry(k, expire_cookie)); ++i )
@@ -1801,52 +2033,22 @@ void TableVal::DoExpire(double t)
 
 		else if ( v->ExpireAccessTime() + timeout < t )
 			{
-			if ( expire_func )
+			if ( expire_batch_func )
 				{
-				Val* idx = RecoverIndex(k);
-				double secs = CallExpireFunc(idx);
-
-				// It's possible that the user-provided
-				// function modified or deleted the table
-				// value, so look it up again.
-				v_saved = v;
-				v = tbl->Lookup(k);
-
-				if ( ! v )
-					{ // user-provided function deleted it
-					v = v_saved;
-					delete k;
-					continue;
-					}
-
-				if ( secs > 0 )
-					{
-					// User doesn't want us to expire
-					// this now.
-					v->SetExpireAccess(network_time - timeout + secs);
-					delete k;
-					continue;
-					}
-
-				}
-
-			if ( subnets )
-				{
-				Val* index = RecoverIndex(k);
-				if ( ! subnets->Remove(index) )
-					reporter->InternalWarning("index not in prefix table");
-				Unref(index);
+				batch.push_back(k);
+				continue;
 				}
 
-			tbl->RemoveEntry(k);
-			Unref(v->Value());
-			delete v;
-			modified = true;
+			if ( ExpireEntry(k, v, timeout) )
+				modified = true;
 			}
 
 		delete k;
 		}
 
+	if ( ! batch.empty() && ExpireBatch(batch) )
+		modified = true;
+
 	if ( modified )
 		Modified();
 
@@ -1859,6 +2061,215 @@ void TableVal::DoExpire(double t)
 		InitTimer(table_expire_delay);
 	}
 
+bool TableVal::ExpireEntry(HashKey* k, TableEntryVal* v, double timeout)
+	{
+	PDict(TableEntryVal)* tbl = AsNonConstTable();
+
+	if ( expire_func )
+		{
+		Val* idx = RecoverIndex(k);
+		double secs = CallExpireFunc(idx);
+
+		// It's possible that the user-provided function modified or
+		// deleted the table value, so look it up again.
+		v = tbl->Lookup(k);
+
+		if ( ! v )
+			// User-provided function deleted it.
+			return false;
+
+		if ( secs > 0 )
+			{
+			// User doesn't want us to expire this now.
+			v->SetExpireAccess(network_time - timeout + secs);
+			return false;
+			}
+		}
+
+	RemoveExpired(k, v);
+	return true;
+	}
+
+void TableVal::RemoveExpired(HashKey* k, TableEntryVal* v)
+	{
+	if ( subnets )
+		{
+		Val* index = RecoverIndex(k);
+		if ( ! subnets->Remove(index) )
+			reporter->InternalWarning("index not in prefix table");
+		Unref(index);
+		}
+
+	AsNonConstTable()->RemoveEntry(k);
+	Unref(v->Value());
+	delete v;
+	RecordChange(k);
+	}
+
+bool TableVal::ExpireBatch(const std::vector<HashKey*>& keys)
+	{
+	SetType* st = new SetType(table_type->Indices()->Ref()->AsTypeList(), 0);
+	TableVal* idxs = new TableVal(st);
+	Unref(st);
+
+	for ( auto k : keys )
+		{
+		Val* idx = RecoverIndex(k);
+		idxs->Assign(idx, 0);
+		Unref(idx);
+		}
+
+	try
+		{
+		Val* vf = expire_batch_func->Eval(0);
+
+		if ( vf && vf->Type()->Tag() == TYPE_FUNC )
+			{
+			val_list vl{Ref(), idxs};
+			idxs = 0;
+			Unref(vf->AsFunc()->Call(&vl));
+			}
+
+		else if ( vf )
+			vf->Error("not a function");
+
+		Unref(vf);
+		}
+
+	catch ( InterpreterException& e )
+		{
+		}
+
+	Unref(idxs);
+
+	// What the function didn't delete itself goes now, in one go.
+	PDict(TableEntryVal)* tbl = AsNonConstTable();
+	bool removed = false;
+
+	for ( auto k : keys )
+		{
+		TableEntryVal* v = tbl->Lookup(k);
+
+		if ( v )
+			{
+			RemoveExpired(k, v);
+			removed = true;
+			}
+
+		delete k;
+		}
+
+	return removed;
+	}
+
+void TableVal::AddToExpireIndex(HashKey* k, TableEntryVal* v, int min_slot)
+	{
+	int slot = std::max(v->expire_access_time, min_slot);
+	v->expire_slot = slot;
+	(*expire_index)[slot].push_back(k);
+	}
+
+void TableVal::DoExpireIndexed(double t, double timeout)
+	{
+	PDict(TableEntryVal)* tbl = AsNonConstTable();
+
+	if ( ! expire_index )
+		{
+		// One pass over everything, from then on Assign() keeps
+		// the index up to date.
+		expire_index = new std::map<int, std::vector<HashKey*> >;
+
+		IterCookie* c = tbl->InitForIteration();
+		HashKey* k;
+		TableEntryVal* v;
+
+		while ( (v = tbl->NextEntry(k, c)) )
+			AddToExpireIndex(k, v, 0);
+		}
+
+	bool modified = false;
+	bool more = false;
+	int n = 0;
+	std::vector<HashKey*> batch;
+	auto b = expire_index->begin();
+
+	while ( b != expire_index->end() )
+		{
+		int slot = b->first;
+
+		// Slots are whole seconds, like the access times.
+		if ( bro_start_network_time + slot + timeout >= t )
+			break;
+
+		if ( slot == 0 && bro_start_network_time == 0 )
+			{
+			// Inserted before network time was known, see
+			// DoExpire(); we just need to wait.
+			++b;
+			continue;
+			}
+
+		std::vector<HashKey*>& keys = b->second;
+
+		while ( ! keys.empty() )
+			{
+			if ( n++ >= table_incremental_step )
+				{
+				more = true;
+				break;
+				}
+
+			HashKey* k = keys.back();
+			keys.pop_back();
+
+			TableEntryVal* v = tbl->Lookup(k);
+
+			if ( ! v || v->expire_slot != slot )
+				{
+				// Entry is gone, or it's queued in a later
+				// slot as well.
+				delete k;
+				continue;
+				}
+
+			if ( v->ExpireAccessTime() + timeout < t )
+				{
+				if ( expire_batch_func )
+					{
+					batch.push_back(k);
+					continue;
+					}
+
+				if ( ExpireEntry(k, v, timeout) )
+					modified = true;
+
+				if ( ! (v = tbl->Lookup(k)) )
+					{
+					delete k;
+					continue;
+					}
+				}
+
+			// Accessed since it got queued, or kept by the
+			// &expire_func; move it to where it belongs now.
+			AddToExpireIndex(k, v, slot + 1);
+			}
+
+		if ( more )
+			break;
+
+		b = expire_index->erase(b);
+		}
+
+	if ( ! batch.empty() && ExpireBatch(batch) )
+		modified = true;
+
+	if ( modified )
+		Modified();
+
+	InitTimer(more ? table_expire_delay : table_expire_interval);
+	}
+
 double TableVal::GetExpireTime()
 	{
 	if ( ! expire_time )
@@ -1991,6 +2402,9 @@ Val* TableVal::DoClone(CloneState* state)
 	if ( expire_func )
 		tv->expire_func = expire_func->Ref();
 
+	if ( expire_batch_func )
+		tv->expire_batch_func = expire_batch_func->Ref();
+
 	if ( def_val )
 		tv->def_val = def_val->Ref();
 
@@ -2086,6 +2500,16 @@ void RecordVal::Assign(int field, Val* new_val)
 	Modified();
 	}
 
+void RecordVal::AssignCount(int field, bro_uint_t c)
+	{
+	Val* old_val = Lookup(field);
+
+	if ( old_val && old_val->AsCount() == c )
+		return;
+
+	Assign(field, val_mgr->GetCount(c));
+	}
+
 Val* RecordVal::Lookup(int field) const
 	{
 	return (*AsRecord())[field];
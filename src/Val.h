@@ -7,6 +7,8 @@
 #include <list>
 #include <array>
 #include <unordered_map>
+#include <map>
+#include <string>
 
 #include "net_util.h"
 #include "Type.h"
@@ -170,6 +172,14 @@ public:
 
 	~Val() override;
 
+	// Scalar values are created and destroyed all the time during
+	// expression evaluation, so the memory of freed Vals is kept in a
+	// free list for reuse.  This applies to Vals and the subclasses
+	// that add at most a hash_t of their own, like AddrVal and
+	// StringVal; all of them get blocks of the same size.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	Val* Ref()			{ ::Ref(this); return this; }
 	Val* Clone();
 
@@ -576,6 +586,11 @@ public:
 
 	unsigned int MemoryAllocation() const override;
 
+	// Returns a key for using the address as a table index.  As the
+	// same address often gets looked up in several tables in a row,
+	// we compute its hash only once.
+	HashKey* GetHashKey() const;
+
 protected:
 	friend class Val;
 	AddrVal()	{}
@@ -583,6 +598,8 @@ protected:
 	explicit AddrVal(BroType* t) : Val(t)	{ }
 
 	Val* DoClone(CloneState* state) override;
+
+	mutable hash_t hash = 0;	// 0 if not yet computed
 };
 
 class SubNetVal : public Val {
@@ -636,12 +653,19 @@ public:
 
 	unsigned int MemoryAllocation() const override;
 
+	// Returns a key for using the string as a table index, computing
+	// its hash only the first time.  The key refers to the string's
+	// bytes rather than copying them.
+	HashKey* GetHashKey() const;
+
 protected:
 	friend class Val;
 	StringVal()	{}
 
 	void ValDescribe(ODesc* d) const override;
 	Val* DoClone(CloneState* state) override;
+
+	mutable hash_t hash = 0;	// 0 if not yet computed
 };
 
 class PatternVal : public Val {
@@ -720,6 +744,7 @@ public:
 		last_access_time = network_time;
 		expire_access_time =
 			int(network_time - bro_start_network_time);
+		expire_slot = 0;
 		}
 
 	TableEntryVal* Clone(Val::CloneState* state)
@@ -752,6 +777,10 @@ protected:
 	// to save a few bytes, as we do not need a high resolution for these
 	// anyway.
 	int expire_access_time;
+
+	// Where the table's expiration index queues the entry's key, if
+	// the table has one.
+	int expire_slot;
 };
 
 class TableValTimer : public Timer {
@@ -796,6 +825,15 @@ public:
 	// Remove the entire contents.
 	void RemoveAll();
 
+	// Sets aside room for the given number of entries, if the table
+	// is empty.
+	void Reserve(int n);
+
+	// Replaces the entire contents with those of the given table, which
+	// must be of the same type and ends up empty. Doesn't depend on the
+	// number of entries.
+	void TakeEntries(TableVal* other);
+
 	// Remove the entire contents of the table from the given value.
 	// which must also be a TableVal.
 	// Returns true if the addition typechecked, false if not.
@@ -836,6 +874,12 @@ public:
 	// Causes an internal error if called for any other kind of table.
 	TableVal* LookupSubnetValues(const SubNetVal* s);
 
+	// For a set[subnet]/table[subnet], return a vector of bools telling
+	// for each of the addresses whether it's covered by the table, like
+	// the "in" operator does. Faster than checking one by one.
+	// Causes an internal error if called for any other kind of table.
+	VectorVal* LookupAddrs(const VectorVal* addrs);
+
 	// Sets the timestamp for the given index to network time.
 	// Returns false if index does not exist.
 	bool UpdateTimestamp(Val* index);
@@ -881,11 +925,23 @@ public:
 	HashKey* ComputeHash(const Val* index) const
 		{ return table_hash->ComputeHash(index, 1); }
 
+	// Starts or stops recording which entries get inserted, replaced
+	// or removed. Changes inside an entry's value, such as assigning
+	// to a field of a record the table holds, aren't recorded.
+	void TrackChanges(bool track);
+	bool TrackingChanges() const	{ return changes != 0; }
+
+	// Returns the keys of the entries changed since tracking started
+	// or since the previous call, and starts over. The caller owns the
+	// keys. Returns false, with no keys, if the table got emptied all
+	// at once in between, which isn't recorded per entry.
+	bool TakeChanges(std::vector<HashKey*>* keys);
+
 	notifier::Modifiable* Modifiable() override	{ return this; }
 
 protected:
 	friend class Val;
-	TableVal()	{}
+	TableVal()	{ changes = 0; expire_index = 0; }
 
 	void Init(TableType* t);
 
@@ -896,6 +952,13 @@ protected:
 	// Calculates default value for index.  Returns 0 if none.
 	Val* Default(Val* index);
 
+	// Records a change to the entry with the given key, if tracking.
+	void RecordChange(const HashKey* k)
+		{
+		if ( changes )
+			changes->emplace(std::string(static_cast<const char*>(k->Key()), k->Size()), k->Hash());
+		}
+
 	// Returns true if item expiration is enabled.
 	bool ExpirationEnabled()	{ return expire_time != 0; }
 
@@ -908,6 +971,28 @@ protected:
 	// takes ownership of the reference.
 	double CallExpireFunc(Val *idx);
 
+	// Expires the entry with the given key unless the &expire_func
+	// keeps it. Returns true if it got removed here, which requires
+	// a call to Modified() later on. Doesn't take ownership of k.
+	bool ExpireEntry(HashKey* k, TableEntryVal* v, double timeout);
+
+	// Removes an expired entry, without consulting any function.
+	void RemoveExpired(HashKey* k, TableEntryVal* v);
+
+	// Passes the indices of the expired entries to &expire_batch_func
+	// and then removes those it didn't remove itself. Returns true if
+	// any got removed here, like ExpireEntry(). Takes ownership of the
+	// keys.
+	bool ExpireBatch(const std::vector<HashKey*>& keys);
+
+	// Expiration through expire_index, for table_expire_index.
+	void DoExpireIndexed(double t, double timeout);
+
+	// Queues the key in the expiration index, in the slot for the
+	// entry's expiration access time but no earlier than min_slot.
+	// Takes ownership of k.
+	void AddToExpireIndex(HashKey* k, TableEntryVal* v, int min_slot);
+
 	Val* DoClone(CloneState* state) override;
 
 	TableType* table_type;
@@ -915,10 +1000,21 @@ protected:
 	Attributes* attrs;
 	Expr* expire_time;
 	Expr* expire_func;
+	Expr* expire_batch_func;
 	TableValTimer* timer;
 	IterCookie* expire_cookie;
 	PrefixTable* subnets;
 	Val* def_val;
+
+	// Key bytes and hashes of the entries changed, while tracking.
+	std::map<std::string, hash_t>* changes;
+	bool changes_cleared;
+
+	// Copies of the keys by the expiration access time they got queued
+	// with, in seconds since bro_start_network_time. An entry accessed
+	// since stays queued where it was and moves on once that slot
+	// comes due, so that lookups don't need to touch the index.
+	std::map<int, std::vector<HashKey*> >* expire_index;
 };
 
 class RecordVal : public Val, public notifier::Modifiable {
@@ -931,6 +1027,9 @@ public:
 
 	void Assign(int field, Val* new_val);
 	Val* Lookup(int field) const;	// Does not Ref() value.
+
+	// Assigns a count to the field, unless it holds that count already.
+	void AssignCount(int field, bro_uint_t c);
 	Val* LookupWithDefault(int field) const;	// Does Ref() value.
 
 	/**
@@ -1,10 +1,65 @@
+#include <stdint.h>
+
+#include <vector>
+
 #include "WeirdState.h"
 #include "Net.h"
 
-bool PermitWeird(WeirdStateMap& wsm, const char* name, uint64_t threshold,
+static std::vector<std::string> weird_names;
+static std::unordered_map<std::string, WeirdID> weird_ids;
+
+// Most names are string literals that keep coming back, so we remember
+// which ID we found for a given pointer last. That the name is still the
+// same gets verified, as the bytes behind a pointer may change.
+#define WEIRD_ID_CACHE_SIZE 256
+
+struct WeirdIDCacheEntry {
+	const char* name;
+	WeirdID id;
+};
+
+static WeirdIDCacheEntry weird_id_cache[WEIRD_ID_CACHE_SIZE];
+
+WeirdID weird_id(const char* name)
+	{
+	auto slot = (reinterpret_cast<uintptr_t>(name) >> 3) % WEIRD_ID_CACHE_SIZE;
+	auto& c = weird_id_cache[slot];
+
+	if ( c.name == name && weird_names[c.id] == name )
+		return c.id;
+
+	std::string s(name);
+	auto i = weird_ids.find(s);
+	WeirdID id;
+
+	if ( i != weird_ids.end() )
+		id = i->second;
+	else
+		{
+		id = weird_names.size();
+		weird_names.push_back(s);
+		weird_ids.emplace(s, id);
+		}
+
+	c.name = name;
+	c.id = id;
+	return id;
+	}
+
+const std::string& weird_name(WeirdID id)
+	{
+	return weird_names[id];
+	}
+
+WeirdID num_weird_ids()
+	{
+	return weird_names.size();
+	}
+
+bool PermitWeird(WeirdStateMap& wsm, WeirdID id, uint64_t threshold,
                  uint64_t rate, double duration)
     {
-	auto& state = wsm[name];
+	auto& state = wsm[id];
 	++state.count;
 
 	if ( state.count <= threshold )
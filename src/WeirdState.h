@@ -12,10 +12,22 @@ struct WeirdState {
 	double sampling_start_time = 0;
 };
 
-using WeirdStateMap = std::unordered_map<std::string, WeirdState>;
+// Weird names get interned to small, dense IDs the first time they come
+// up, so that the per-name state doesn't have to hash the names.
+using WeirdID = uint32_t;
 
-bool PermitWeird(WeirdStateMap& wsm, const char* name, uint64_t threshold,
+// Returns the ID of the weird with the given name.
+WeirdID weird_id(const char* name);
+
+// Returns the name of the weird with the given ID.
+const std::string& weird_name(WeirdID id);
+
+// Returns the number of IDs handed out so far, which are the IDs below it.
+WeirdID num_weird_ids();
+
+using WeirdStateMap = std::unordered_map<WeirdID, WeirdState>;
+
+bool PermitWeird(WeirdStateMap& wsm, WeirdID id, uint64_t threshold,
                  uint64_t rate, double duration);
 
 #endif // WEIRDSTATE_H
-
@@ -0,0 +1,273 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Zygote.h"
+#include "DNS_Mgr.h"
+#include "ID.h"
+#include "input.h"
+#include "Reporter.h"
+#include "Scope.h"
+#include "Val.h"
+#include "util.h"
+
+extern "C" {
+#include "setsignal.h"
+}
+
+// The parent's children, with entries zeroed once they have exited, and
+// what they run.
+static std::vector<pid_t> children;
+static std::vector<std::string> child_names;
+
+// Tells a zeek that a zygote started to parse the scripts for a node type
+// which nodes it has to fork.
+#define ZYGOTE_NODES_ENV "ZEEK_ZYGOTE_NODES"
+
+static RETSIGTYPE forward_signal(int signo)
+	{
+	for ( auto pid : children )
+		if ( pid > 0 )
+			kill(pid, signo);
+
+	return RETSIGVAL;
+	}
+
+// Returns the node's entry in Cluster::nodes, an error if the layout
+// doesn't have it, or nil if there's no layout at all.
+static RecordVal* lookup_node(const std::string& node)
+	{
+	ID* id = global_scope()->Lookup("Cluster::nodes");
+
+	if ( ! id || ! id->HasVal() )
+		return 0;
+
+	TableVal* nodes = id->ID_Val()->AsTableVal();
+
+	if ( ! nodes->Size() )
+		return 0;
+
+	StringVal* idx = new StringVal(node);
+	Val* n = nodes->Lookup(idx, false);
+	Unref(idx);
+
+	if ( ! n )
+		reporter->FatalError("cluster node %s is not in Cluster::nodes",
+				     node.c_str());
+
+	return n->AsRecordVal();
+	}
+
+// Returns the node's type in Cluster::nodes, or -1 if there's no layout.
+static int node_type(const std::string& node)
+	{
+	RecordVal* r = lookup_node(node);
+
+	if ( ! r )
+		return -1;
+
+	int offset = r->Type()->AsRecordType()->FieldOffset("node_type");
+	return r->Lookup(offset)->InternalInt();
+	}
+
+// Forks a child for the named node(s). Returns 0 in the child.
+static pid_t spawn(const std::string& name)
+	{
+	pid_t pid = fork();
+
+	if ( pid < 0 )
+		{
+		int err = errno;
+
+		for ( auto c : children )
+			if ( c > 0 )
+				kill(c, SIGTERM);
+
+		reporter->FatalError("can't fork cluster node %s: %s",
+				     name.c_str(), strerror(err));
+		}
+
+	if ( pid == 0 )
+		{
+		children.clear();
+		child_names.clear();
+		return 0;
+		}
+
+	children.push_back(pid);
+	child_names.push_back(name);
+	return pid;
+	}
+
+// Replaces the process with a zeek that parses the scripts as the first
+// of the comma-separated nodes, and then forks all of them.
+static void exec_group(const std::string& first, const std::string& list)
+	{
+	setenv("CLUSTER_NODE", first.c_str(), 1);
+	setenv(ZYGOTE_NODES_ENV, list.c_str(), 1);
+
+	std::vector<char*> args(bro_argv, bro_argv + bro_argc);
+	args.push_back(0);
+	execvp(args[0], args.data());
+
+	fprintf(stderr, "can't start zeek for cluster nodes %s: %s\n",
+		list.c_str(), strerror(errno));
+	_exit(1);
+	}
+
+static void setup_child(const std::string& node, unsigned int index,
+			name_list* interfaces)
+	{
+	setenv("CLUSTER_NODE", node.c_str(), 1);
+
+	ID* id = global_scope()->Lookup("Cluster::node");
+
+	if ( id )
+		id->SetVal(new StringVal(node));
+
+	RecordVal* r = lookup_node(node);
+
+	if ( r && interfaces->length() == 0 )
+		{
+		int offset = r->Type()->AsRecordType()->FieldOffset("interface");
+		Val* iface = offset >= 0 ? r->Lookup(offset) : 0;
+
+		if ( iface )
+			interfaces->append(copy_string(iface->AsString()->CheckString()));
+		}
+
+	// All children start with the parent's generator state. Offsetting
+	// it keeps them apart, connection UIDs in particular, while leaving
+	// runs with a deterministic seed deterministic. The hash keys stay
+	// as they are, as the inherited tables depend on them.
+	bro_srandom(bro_random() + index);
+
+	dns_mgr->AfterFork();
+	}
+
+void zygote_fork(const char* nodes, name_list* interfaces)
+	{
+	std::vector<std::string> names;
+	std::string s(nodes);
+	std::string::size_type start = 0;
+
+	// In a zeek that a zygote started for some of its nodes, the
+	// environment says which ones those are.
+	if ( const char* group = getenv(ZYGOTE_NODES_ENV) )
+		{
+		s = group;
+		unsetenv(ZYGOTE_NODES_ENV);
+		}
+
+	while ( start <= s.size() )
+		{
+		std::string::size_type end = s.find(',', start);
+
+		if ( end == std::string::npos )
+			end = s.size();
+
+		if ( end > start )
+			names.push_back(s.substr(start, end - start));
+
+		start = end + 1;
+		}
+
+	if ( names.empty() )
+		reporter->FatalError("--zygote needs at least one node name");
+
+	// The @if directives in the scripts, including the cluster
+	// framework's, were evaluated for the node type that CLUSTER_NODE
+	// named during parsing. Only nodes of that type can use the result.
+	// The others get a zeek of their own per type, which parses the
+	// scripts for it and then forks those nodes.
+	const char* parsed_for = getenv("CLUSTER_NODE");
+	int parsed_type = parsed_for && *parsed_for ? node_type(parsed_for) : -1;
+
+	std::vector<std::string> direct;
+	std::map<int, std::vector<std::string>> other_types;
+
+	for ( const auto& n : names )
+		{
+		int t = node_type(n);
+
+		if ( t == parsed_type )
+			direct.push_back(n);
+		else
+			other_types[t].push_back(n);
+		}
+
+	// Don't let the children write out what's buffered a second time.
+	fflush(0);
+
+	for ( size_t i = 0; i < direct.size(); ++i )
+		{
+		if ( spawn(direct[i]) == 0 )
+			{
+			setup_child(direct[i], i + 1, interfaces);
+			return;
+			}
+		}
+
+	for ( const auto& t : other_types )
+		{
+		std::string list;
+
+		for ( const auto& n : t.second )
+			list += (list.empty() ? "" : ",") + n;
+
+		if ( spawn(list) == 0 )
+			exec_group(t.second[0], list);
+		}
+
+	(void) setsignal(SIGTERM, forward_signal);
+	(void) setsignal(SIGINT, forward_signal);
+	(void) setsignal(SIGHUP, forward_signal);
+
+	size_t remaining = children.size();
+	int failed = 0;
+
+	while ( remaining > 0 )
+		{
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+
+		if ( pid < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			reporter->FatalError("waiting for cluster nodes: %s",
+					     strerror(errno));
+			}
+
+		for ( size_t i = 0; i < children.size(); ++i )
+			{
+			if ( children[i] != pid )
+				continue;
+
+			children[i] = 0;
+			--remaining;
+
+			if ( ! WIFEXITED(status) || WEXITSTATUS(status) != 0 )
+				{
+				reporter->Warning("cluster node %s exited abnormally",
+						  child_names[i].c_str());
+				++failed;
+				}
+			}
+		}
+
+	exit(failed ? 1 : 0);
+	}
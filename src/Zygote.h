@@ -0,0 +1,29 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Starting several cluster nodes from a single parse of the scripts. The
+// process parses and initializes the scripts once, then forks a process
+// per node that inherits the resulting state copy-on-write.
+
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include "List.h"
+
+// Forks a process for each of the comma-separated node names and
+// supervises them, passing on termination signals, until they have all
+// exited. Returns only in the children, set up to run as their node:
+// CLUSTER_NODE and Cluster::node name it, its random number generator
+// gets a seed of its own, and unless interfaces are given already, it
+// reads from the node's interface in Cluster::nodes.
+//
+// Only nodes of the type CLUSTER_NODE named while parsing share that
+// parse, as @if directives depend on the type. For each other type, a
+// child executes zeek anew with CLUSTER_NODE set to one of its nodes,
+// and that zeek forks them all. Directives testing a node's name rather
+// than its type still see the name the scripts were parsed for.
+//
+// Must be called after parsing but before anything starts threads or
+// opens connections, as the children don't inherit those.
+void zygote_fork(const char* nodes, name_list* interfaces);
+
+#endif
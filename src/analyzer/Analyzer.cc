@@ -8,6 +8,7 @@
 
 #include "analyzer/protocol/pia/PIA.h"
 #include "../Event.h"
+#include "../NetVar.h"
 
 namespace analyzer {
 
@@ -34,6 +35,66 @@ protected:
 
 using namespace analyzer;
 
+// Deliveries currently on the stack.
+static int delivery_depth = 0;
+// Outermost deliveries seen, to pick every Nth for sampling.
+static uint64 delivery_counter = 0;
+// Whether the current outermost delivery is being sampled.
+static bool delivery_sampled = false;
+// Cycles spent in deliveries nested inside the innermost one timed.
+static uint64 nested_cycles = 0;
+
+// Accounts for a single DeliverPacket()/DeliverStream() call over its
+// lifetime. When sampling, each analyzer is charged only the cycles spent
+// in itself, not in the analyzers it passes the data on to.
+class DeliveryAccounting {
+public:
+	DeliveryAccounting(UsageStats* arg_stats, int len)
+		{
+		stats = arg_stats;
+		timed = false;
+
+		if ( stats )
+			{
+			++stats->deliveries;
+			stats->bytes += len;
+			}
+
+		if ( delivery_depth++ == 0 )
+			delivery_sampled = analyzer_stats_sampling > 0 &&
+				++delivery_counter % analyzer_stats_sampling == 0;
+
+		if ( stats && delivery_sampled )
+			{
+			timed = true;
+			saved_nested = nested_cycles;
+			nested_cycles = 0;
+			start = read_cycles();
+			}
+		}
+
+	~DeliveryAccounting()
+		{
+		--delivery_depth;
+
+		if ( ! timed )
+			return;
+
+		uint64 total = read_cycles() - start;
+		uint64 nested = std::min(nested_cycles, total);
+
+		stats->cycles += total - nested;
+		++stats->sampled;
+		nested_cycles = saved_nested + total;
+		}
+
+private:
+	UsageStats* stats;
+	bool timed;
+	uint64 start;
+	uint64 saved_nested;
+};
+
 AnalyzerTimer::AnalyzerTimer(Analyzer* arg_analyzer, analyzer_timer_func arg_timer,
 			     double arg_t, int arg_do_expire, TimerType arg_type)
 	: Timer(arg_t, arg_type)
@@ -134,6 +195,13 @@ void Analyzer::CtorInit(const Tag& arg_tag, Connection* arg_conn)
 	resp_supporters = 0;
 	signature = 0;
 	output_handler = 0;
+	stats = analyzer_mgr ? analyzer_mgr->GetUsageStats(tag) : 0;
+
+	if ( stats )
+		{
+		++stats->created;
+		++stats->live;
+		}
 	}
 
 Analyzer::~Analyzer()
@@ -158,6 +226,9 @@ Analyzer::~Analyzer()
 		}
 
 	delete output_handler;
+
+	if ( stats )
+		--stats->live;
 	}
 
 void Analyzer::Init()
@@ -217,6 +288,8 @@ void Analyzer::NextPacket(int len, const u_char* data, bool is_orig, uint64 seq,
 
 	else
 		{
+		DeliveryAccounting acct(stats, len);
+
 		try
 			{
 			DeliverPacket(len, data, is_orig, seq, ip, caplen);
@@ -240,6 +313,8 @@ void Analyzer::NextStream(int len, const u_char* data, bool is_orig)
 
 	else
 		{
+		DeliveryAccounting acct(stats, len);
+
 		try
 			{
 			DeliverStream(len, data, is_orig);
@@ -747,7 +822,7 @@ void Analyzer::AppendNewChildren()
 
 unsigned int Analyzer::MemoryAllocation() const
 	{
-	unsigned int mem = padded_sizeof(*this)
+	unsigned int mem = slab_sizeof(*this)
 		+ (timers.MemoryAllocation() - padded_sizeof(timers));
 
 	LOOP_OVER_CONST_CHILDREN(i)
@@ -833,8 +908,11 @@ void SupportAnalyzer::ForwardPacket(int len, const u_char* data, bool is_orig,
 		// Pass to next in chain.
 		next_sibling->NextPacket(len, data, is_orig, seq, ip, caplen);
 	else
+		{
 		// Finished with preprocessing - now it's the parent's turn.
+		DeliveryAccounting acct(Parent()->stats, len);
 		Parent()->DeliverPacket(len, data, is_orig, seq, ip, caplen);
+		}
 	}
 
 void SupportAnalyzer::ForwardStream(int len, const u_char* data, bool is_orig)
@@ -853,8 +931,11 @@ void SupportAnalyzer::ForwardStream(int len, const u_char* data, bool is_orig)
 		// Pass to next in chain.
 		next_sibling->NextStream(len, data, is_orig);
 	else
+		{
 		// Finished with preprocessing - now it's the parent's turn.
+		DeliveryAccounting acct(Parent()->stats, len);
 		Parent()->DeliverStream(len, data, is_orig);
+		}
 	}
 
 void SupportAnalyzer::ForwardUndelivered(uint64 seq, int len, bool is_orig)
@@ -10,6 +10,7 @@
 #include "../Obj.h"
 #include "../EventHandler.h"
 #include "../Timer.h"
+#include "../Slab.h"
 
 class Rule;
 class Connection;
@@ -29,6 +30,20 @@ typedef list<Analyzer*> analyzer_list;
 typedef uint32 ID;
 typedef void (Analyzer::*analyzer_timer_func)(double t);
 
+/**
+ * Resource usage accumulated across all instances of one analyzer type.
+ *
+ * .. zeek:see:: get_analyzer_stats
+ */
+struct UsageStats {
+	uint64 created;		// Instances created.
+	uint64 live;		// Instances currently in existence.
+	uint64 deliveries;	// Packets and stream chunks delivered.
+	uint64 bytes;		// Bytes delivered.
+	uint64 sampled;		// Deliveries whose CPU cost got measured.
+	uint64 cycles;		// Cycles spent in the sampled deliveries.
+};
+
 /**
  * Class to receive processed output from an anlyzer.
  */
@@ -75,6 +90,9 @@ public:
  */
 class Analyzer {
 public:
+	// Analyzer trees are created and destroyed with every connection.
+	DECLARE_SLAB_ALLOCATED
+
 	/**
 	 * Constructor.
 	 *
@@ -568,6 +586,7 @@ protected:
 	friend class AnalyzerTimer;
 	friend class Manager;
 	friend class ::Connection;
+	friend class SupportAnalyzer;
 	friend class tcp::TCP_ApplicationAnalyzer;
 
 	/**
@@ -664,6 +683,7 @@ private:
 	Analyzer* parent;
 	const Rule* signature;
 	OutputHandler* output_handler;
+	UsageStats* stats;
 
 	analyzer_list children;
 	SupportAnalyzer* orig_supporters;
@@ -3,6 +3,7 @@
 #include "Manager.h"
 
 #include "Hash.h"
+#include "LoadShedder.h"
 #include "Val.h"
 
 #include "protocol/backdoor/BackDoor.h"
@@ -62,6 +63,14 @@ bool Manager::ConnIndex::operator<(const ConnIndex& other) const
 Manager::Manager()
 	: plugin::ComponentManager<analyzer::Tag, analyzer::Component>("Analyzer", "Tag")
 	{
+	port_index_tcp.resize(65536);
+	port_index_udp.resize(65536);
+
+	analyzer_backdoor = 0;
+	analyzer_connsize = 0;
+	analyzer_interconn = 0;
+	analyzer_stepping = 0;
+	analyzer_tcpstats = 0;
 	}
 
 Manager::~Manager()
@@ -74,6 +83,8 @@ Manager::~Manager()
 
 	analyzers_by_port_udp.clear();
 	analyzers_by_port_tcp.clear();
+	port_index_udp.clear();
+	port_index_tcp.clear();
 
 	// Clean up expected-connection table.
 	while ( conns_by_timeout.size() )
@@ -86,12 +97,12 @@ Manager::~Manager()
 
 void Manager::InitPreScript()
 	{
-	// Cache these tags.
-	analyzer_backdoor = GetComponentTag("BACKDOOR");
-	analyzer_connsize = GetComponentTag("CONNSIZE");
-	analyzer_interconn = GetComponentTag("INTERCONN");
-	analyzer_stepping = GetComponentTag("STEPPINGSTONE");
-	analyzer_tcpstats = GetComponentTag("TCPSTATS");
+	// Cache these components.
+	analyzer_backdoor = Lookup("BACKDOOR");
+	analyzer_connsize = Lookup("CONNSIZE");
+	analyzer_interconn = Lookup("INTERCONN");
+	analyzer_stepping = Lookup("STEPPINGSTONE");
+	analyzer_tcpstats = Lookup("TCPSTATS");
 	}
 
 void Manager::InitPostScript()
@@ -108,6 +119,18 @@ void Manager::InitPostScript()
 		vxlan_ports.emplace_back(port_list->Index(i)->AsPortVal()->Port());
 
 	Unref(port_list);
+
+	id = global_scope()->Lookup("load_shedding_analyzers");
+
+	if ( id && id->ID_Val() )
+		{
+		auto tags = id->ID_Val()->AsTableVal()->ConvertToPureList();
+
+		for ( auto i = 0; i < tags->Length(); ++i )
+			shed_analyzers.insert(Tag(tags->Index(i)->AsEnumVal()));
+
+		Unref(tags);
+		}
 	}
 
 void Manager::DumpDebug()
@@ -304,6 +327,14 @@ Analyzer* Manager::InstantiateAnalyzer(Tag tag, Connection* conn)
 	if ( ! c->Enabled() )
 		return 0;
 
+	if ( conn->ShedLevel() >= LOAD_SHED_ANALYZERS &&
+	     shed_analyzers.count(tag) )
+		{
+		DBG_ANALYZER_ARGS(conn, "not activating %s analyzer due to load shedding",
+				  GetComponentName(tag).c_str());
+		return 0;
+		}
+
 	if ( ! c->Factory() )
 		{
 		reporter->InternalWarning("analyzer %s cannot be instantiated dynamically",
@@ -333,14 +364,17 @@ Analyzer* Manager::InstantiateAnalyzer(const char* name, Connection* conn)
 Manager::tag_set* Manager::LookupPort(TransportProto proto, uint32 port, bool add_if_not_found)
 	{
 	analyzer_map_by_port* m = 0;
+	std::vector<tag_set*>* index = 0;
 
 	switch ( proto ) {
 	case TRANSPORT_TCP:
 		m = &analyzers_by_port_tcp;
+		index = &port_index_tcp;
 		break;
 
 	case TRANSPORT_UDP:
 		m = &analyzers_by_port_udp;
+		index = &port_index_udp;
 		break;
 
 	default:
@@ -348,6 +382,10 @@ Manager::tag_set* Manager::LookupPort(TransportProto proto, uint32 port, bool ad
 		return 0;
 	}
 
+	// The index has all valid port numbers.
+	if ( port < index->size() && ((*index)[port] || ! add_if_not_found) )
+		return (*index)[port];
+
 	analyzer_map_by_port::const_iterator i = m->find(port);
 
 	if ( i != m->end() )
@@ -358,6 +396,10 @@ Manager::tag_set* Manager::LookupPort(TransportProto proto, uint32 port, bool ad
 
 	tag_set* l = new tag_set;
 	m->insert(std::make_pair(port, l));
+
+	if ( port < index->size() )
+		(*index)[port] = l;
+
 	return l;
 	}
 
@@ -375,19 +417,29 @@ bool Manager::BuildInitialAnalyzerTree(Connection* conn)
 	pia::PIA* pia = 0;
 	bool check_port = false;
 
+	// Under load shedding, connections may get no more than is needed
+	// for their headers.
+	bool headers_only = conn->ShedLevel() >= LOAD_SHED_HEADERS;
+
 	switch ( conn->ConnTransport() ) {
 
 	case TRANSPORT_TCP:
 		root = tcp = new tcp::TCP_Analyzer(conn);
-		pia = new pia::PIA_TCP(conn);
-		check_port = true;
+
+		if ( ! headers_only )
+			pia = new pia::PIA_TCP(conn);
+
+		check_port = ! headers_only;
 		DBG_ANALYZER(conn, "activated TCP analyzer");
 		break;
 
 	case TRANSPORT_UDP:
 		root = udp = new udp::UDP_Analyzer(conn);
-		pia = new pia::PIA_UDP(conn);
-		check_port = true;
+
+		if ( ! headers_only )
+			pia = new pia::PIA_UDP(conn);
+
+		check_port = ! headers_only;
 		DBG_ANALYZER(conn, "activated UDP analyzer");
 		break;
 
@@ -402,7 +454,8 @@ bool Manager::BuildInitialAnalyzerTree(Connection* conn)
 		return false;
 	}
 
-	bool scheduled = ApplyScheduledAnalyzers(conn, false, root);
+	bool scheduled = ! headers_only &&
+			 ApplyScheduledAnalyzers(conn, false, root);
 
 	// Hmm... Do we want *just* the expected analyzer, or all
 	// other potential analyzers as well?  For now we only take
@@ -439,12 +492,13 @@ bool Manager::BuildInitialAnalyzerTree(Connection* conn)
 		// asks us to do so.  In all other cases, reassembly may
 		// be turned on later by the TCP PIA.
 
-		bool reass = root->GetChildren().size() ||
-				dpd_reassemble_first_packets ||
-				tcp_content_deliver_all_orig ||
-				tcp_content_deliver_all_resp;
+		bool reass = ! headers_only &&
+				(root->GetChildren().size() ||
+				 dpd_reassemble_first_packets ||
+				 tcp_content_deliver_all_orig ||
+				 tcp_content_deliver_all_resp);
 
-		if ( tcp_contents && ! reass )
+		if ( tcp_contents && ! reass && ! headers_only )
 			{
 			auto dport = val_mgr->GetPort(ntohs(conn->RespPort()), TRANSPORT_TCP);
 			Val* result;
@@ -461,17 +515,20 @@ bool Manager::BuildInitialAnalyzerTree(Connection* conn)
 		if ( reass )
 			tcp->EnableReassembly();
 
-		if ( IsEnabled(analyzer_backdoor) )
+		if ( ! headers_only &&
+		     analyzer_backdoor && analyzer_backdoor->Enabled() )
 			// Add a BackDoor analyzer if requested.  This analyzer
 			// can handle both reassembled and non-reassembled input.
 			tcp->AddChildAnalyzer(new backdoor::BackDoor_Analyzer(conn), false);
 
-		if ( IsEnabled(analyzer_interconn) )
+		if ( ! headers_only &&
+		     analyzer_interconn && analyzer_interconn->Enabled() )
 			// Add a InterConn analyzer if requested.  This analyzer
 			// can handle both reassembled and non-reassembled input.
 			tcp->AddChildAnalyzer(new interconn::InterConn_Analyzer(conn), false);
 
-		if ( IsEnabled(analyzer_stepping) )
+		if ( ! headers_only &&
+		     analyzer_stepping && analyzer_stepping->Enabled() )
 			{
 			// Add a SteppingStone analyzer if requested.  The port
 			// should really not be hardcoded here, but as it can
@@ -487,19 +544,19 @@ bool Manager::BuildInitialAnalyzerTree(Connection* conn)
 				}
 			}
 
-		if ( IsEnabled(analyzer_tcpstats) )
+		if ( analyzer_tcpstats && analyzer_tcpstats->Enabled() )
 			// Add TCPStats analyzer. This needs to see packets so
 			// we cannot add it as a normal child.
 			tcp->AddChildPacketAnalyzer(new tcp::TCPStats_Analyzer(conn));
 
-		if ( IsEnabled(analyzer_connsize) )
+		if ( analyzer_connsize && analyzer_connsize->Enabled() )
 			// Add ConnSize analyzer. Needs to see packets, not stream.
 			tcp->AddChildPacketAnalyzer(new conn_size::ConnSize_Analyzer(conn));
 		}
 
 	else
 		{
-		if ( IsEnabled(analyzer_connsize) )
+		if ( analyzer_connsize && analyzer_connsize->Enabled() )
 			// Add ConnSize analyzer. Needs to see packets, not stream.
 			root->AddChildAnalyzer(new conn_size::ConnSize_Analyzer(conn));
 		}
@@ -554,6 +611,20 @@ void Manager::ExpireScheduledAnalyzers()
 		}
 	}
 
+UsageStats* Manager::GetUsageStats(const Tag& tag)
+	{
+	auto i = usage_stats.find(tag);
+
+	if ( i == usage_stats.end() )
+		{
+		UsageStats s;
+		memset(&s, 0, sizeof(s));
+		i = usage_stats.insert(std::make_pair(tag, s)).first;
+		}
+
+	return &i->second;
+	}
+
 void Manager::ScheduleAnalyzer(const IPAddr& orig, const IPAddr& resp,
 			uint16 resp_p,
 			TransportProto proto, Tag analyzer,
@@ -599,18 +670,23 @@ void Manager::ScheduleAnalyzer(const IPAddr& orig, const IPAddr& resp, PortVal*
 
 Manager::tag_set Manager::GetScheduled(const Connection* conn)
 	{
+	tag_set result;
+
+	// Usually, nothing is.
+	if ( conns.empty() )
+		return result;
+
 	ConnIndex c(conn->OrigAddr(), conn->RespAddr(),
 		    ntohs(conn->RespPort()), conn->ConnTransport());
 
 	std::pair<conns_map::iterator, conns_map::iterator> all = conns.equal_range(c);
 
-	tag_set result;
-
 	for ( conns_map::iterator i = all.first; i != all.second; i++ )
 		result.insert(i->second->analyzer);
 
 	// Try wildcard for originator.
-	c.orig = IPAddr(string("::"));
+	static const IPAddr wildcard(string("::"));
+	c.orig = wildcard;
 	all = conns.equal_range(c);
 
 	for ( conns_map::iterator i = all.first; i != all.second; i++ )
@@ -629,7 +705,7 @@ bool Manager::ApplyScheduledAnalyzers(Connection* conn, bool init, TransportLaye
 	if ( ! parent )
 		parent = conn->GetRootAnalyzer();
 
-	if ( ! parent )
+	if ( ! parent || conns.empty() )
 		return false;
 
 	tag_set expected = GetScheduled(conn);
@@ -21,6 +21,7 @@
 #ifndef ANALYZER_MANAGER_H
 #define ANALYZER_MANAGER_H
 
+#include <map>
 #include <queue>
 #include <vector>
 
@@ -342,6 +343,22 @@ public:
 	const std::vector<uint16>& GetVxlanPorts() const
 		{ return vxlan_ports; }
 
+	/**
+	 * Returns the resource usage accumulated for an analyzer type,
+	 * creating an empty entry if there's none yet. The pointer remains
+	 * valid for the manager's lifetime.
+	 *
+	 * @param tag The analyzer's tag.
+	 */
+	UsageStats* GetUsageStats(const Tag& tag);
+
+	/**
+	 * @return the resource usage of all analyzer types instantiated so
+	 * far.
+	 */
+	const std::map<Tag, UsageStats>& GetAllUsageStats() const
+		{ return usage_stats; }
+
 private:
 	typedef set<Tag> tag_set;
 	typedef map<uint32, tag_set*> analyzer_map_by_port;
@@ -355,11 +372,22 @@ private:
 	analyzer_map_by_port analyzers_by_port_tcp;
 	analyzer_map_by_port analyzers_by_port_udp;
 
-	Tag analyzer_backdoor;
-	Tag analyzer_connsize;
-	Tag analyzer_interconn;
-	Tag analyzer_stepping;
-	Tag analyzer_tcpstats;
+	// The same sets indexed directly by port number, for looking them
+	// up when setting up connections.
+	std::vector<tag_set*> port_index_tcp;
+	std::vector<tag_set*> port_index_udp;
+
+	// The analyzers that BuildInitialAnalyzerTree() adds on its own,
+	// nil if they aren't available.
+	Component* analyzer_backdoor;
+	Component* analyzer_connsize;
+	Component* analyzer_interconn;
+	Component* analyzer_stepping;
+	Component* analyzer_tcpstats;
+
+	// The analyzers that connections starting under load shedding
+	// don't get.
+	tag_set shed_analyzers;
 
 	//// Data structures to track analyzed scheduled for future connections.
 
@@ -398,6 +426,8 @@ private:
 	conns_map conns;
 	conns_queue conns_by_timeout;
 	std::vector<uint16> vxlan_ports;
+
+	std::map<Tag, UsageStats> usage_stats;
 };
 
 }
@@ -146,12 +146,12 @@ uint64_t ConnSize_Analyzer::GetThreshold(bool bytes, bool orig)
 void ConnSize_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	{
 	// RecordType *connection_type is decleared in NetVar.h
-	RecordVal *orig_endp = conn_val->Lookup("orig")->AsRecordVal();
-	RecordVal *resp_endp = conn_val->Lookup("resp")->AsRecordVal();
+	RecordVal *orig_endp = conn_val->Lookup(1)->AsRecordVal();
+	RecordVal *resp_endp = conn_val->Lookup(2)->AsRecordVal();
 
 	// endpoint is the RecordType from NetVar.h
-	int pktidx = endpoint->FieldOffset("num_pkts");
-	int bytesidx = endpoint->FieldOffset("num_bytes_ip");
+	static int pktidx = endpoint->FieldOffset("num_pkts");
+	static int bytesidx = endpoint->FieldOffset("num_bytes_ip");
 
 	if ( pktidx < 0 )
 		reporter->InternalError("'endpoint' record missing 'num_pkts' field");
@@ -159,10 +159,10 @@ void ConnSize_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	if ( bytesidx < 0 )
 		reporter->InternalError("'endpoint' record missing 'num_bytes_ip' field");
 
-	orig_endp->Assign(pktidx, val_mgr->GetCount(orig_pkts));
-	orig_endp->Assign(bytesidx, val_mgr->GetCount(orig_bytes));
-	resp_endp->Assign(pktidx, val_mgr->GetCount(resp_pkts));
-	resp_endp->Assign(bytesidx, val_mgr->GetCount(resp_bytes));
+	orig_endp->AssignCount(pktidx, orig_pkts);
+	orig_endp->AssignCount(bytesidx, orig_bytes);
+	resp_endp->AssignCount(pktidx, resp_pkts);
+	resp_endp->AssignCount(bytesidx, resp_bytes);
 
 	Analyzer::UpdateConnVal(conn_val);
 	}
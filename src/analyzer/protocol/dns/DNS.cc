@@ -9,6 +9,7 @@
 
 #include "NetVar.h"
 #include "DNS.h"
+#include "Summary.h"
 #include "Sessions.h"
 #include "Event.h"
 
@@ -20,6 +21,8 @@ DNS_Interpreter::DNS_Interpreter(analyzer::Analyzer* arg_analyzer)
 	{
 	analyzer = arg_analyzer;
 	first_message = true;
+	name_anomaly = false;
+	name_cache.reserve(DNS_NAME_CACHE_SIZE);
 	}
 
 int DNS_Interpreter::ParseMessage(const u_char* data, int len, int is_query)
@@ -34,6 +37,11 @@ int DNS_Interpreter::ParseMessage(const u_char* data, int len, int is_query)
 
 	DNS_MsgInfo msg((DNS_RawMsgHdr*) data, is_query);
 
+	// Compression offsets only mean something within one message.
+	name_cache.clear();
+	name_cache_buf.clear();
+	name_anomaly = false;
+
 	if ( first_message && msg.QR && is_query == 1 )
 		{
 		is_query = msg.is_query = 0;
@@ -44,12 +52,15 @@ int DNS_Interpreter::ParseMessage(const u_char* data, int len, int is_query)
 
 	first_message = false;
 
+	if ( dns_summary_only )
+		return Summarize(&msg, data, len);
+
 	if ( dns_message )
 		{
 		analyzer->ConnectionEventFast(dns_message, {
 			analyzer->BuildConnVal(),
 			val_mgr->GetBool(is_query),
-			msg.BuildHdrVal(),
+			msg.BuildHdrVal(dns_message, 2),
 			val_mgr->GetCount(len),
 		});
 		}
@@ -130,12 +141,61 @@ int DNS_Interpreter::ParseMessage(const u_char* data, int len, int is_query)
 	return 1;
 	}
 
+int DNS_Interpreter::Summarize(DNS_MsgInfo* msg, const u_char* data, int len)
+	{
+	if ( dns_max_queries > 0 && msg->qdcount > dns_max_queries )
+		{
+		analyzer->ProtocolViolation("DNS_Conn_count_too_large");
+		analyzer->Weird("DNS_Conn_count_too_large");
+		return 0;
+		}
+
+	const u_char* msg_start = data;
+	int hdr_len = sizeof(DNS_RawMsgHdr);
+
+	data += hdr_len;
+	len -= hdr_len;
+
+	// Only the first question counts. Replies without any get an empty
+	// name and type 0.
+	u_char name[513];
+	int name_len = sizeof(name) - 1;
+	u_char* name_end = name;
+	int qtype = 0;
+
+	if ( msg->qdcount > 0 )
+		{
+		name_end = ExtractName(data, len, name, name_len, msg_start);
+
+		if ( ! name_end )
+			return 0;
+
+		if ( len < int(sizeof(short)) * 2 )
+			{
+			analyzer->Weird("DNS_truncated_quest_too_short");
+			return 0;
+			}
+
+		qtype = ExtractShort(data, len);
+		}
+
+	analyzer->ProtocolConfirmation();
+
+	if ( msg->QR == 0 )
+		Summary::Get()->AddRequest();
+	else
+		Summary::Get()->AddReply(analyzer->Conn()->OrigAddr(), name,
+					 name_end - name, qtype, msg->rcode);
+
+	return 1;
+	}
+
 int DNS_Interpreter::EndMessage(DNS_MsgInfo* msg)
 	{
 	if ( dns_end )
 		analyzer->ConnectionEventFast(dns_end, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
+			msg->BuildHdrVal(dns_end, 1),
 		});
 
 	return 1;
@@ -231,8 +291,7 @@ int DNS_Interpreter::ParseAnswer(DNS_MsgInfo* msg,
 	// Note that the exact meaning of some of these fields will be
 	// re-interpreted by other, more adventurous RR types.
 
-	Unref(msg->query_name);
-	msg->query_name = new StringVal(new BroString(name, name_end - name, 1));
+	msg->SetQueryName(name, name_end - name);
 	msg->atype = RR_Type(ExtractShort(data, len));
 	msg->aclass = ExtractShort(data, len);
 	msg->ttl = ExtractLong(data, len);
@@ -341,8 +400,8 @@ int DNS_Interpreter::ParseAnswer(DNS_MsgInfo* msg,
 				{
 				analyzer->ConnectionEventFast(dns_unknown_reply, {
 					analyzer->BuildConnVal(),
-					msg->BuildHdrVal(),
-					msg->BuildAnswerVal(),
+					msg->BuildHdrVal(dns_unknown_reply, 1),
+					msg->BuildAnswerVal(dns_unknown_reply, 2),
 				});
 				}
 
@@ -368,7 +427,10 @@ u_char* DNS_Interpreter::ExtractName(const u_char*& data, int& len,
 	int n = name - name_start;
 
 	if ( n >= 255 )
+		{
 		analyzer->Weird("DNS_NAME_too_long");
+		name_anomaly = true;
+		}
 
 	if ( n >= 2 && name[-1] == '.' )
 		{
@@ -399,7 +461,14 @@ int DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 	--len;
 
 	if ( len <= 0 )
+		{
+		// Cut short by the end of the data, unless this was the
+		// terminating label anyway.
+		if ( label_len != 0 )
+			name_anomaly = true;
+
 		return 0;
+		}
 
 	if ( label_len == 0 )
 		// Found terminating label.
@@ -425,6 +494,22 @@ int DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 			//  sometimes compression points to compression.)
 
 			analyzer->Weird("DNS_label_forward_compress_offset");
+			name_anomaly = true;
+			return 0;
+			}
+
+		// Many RRs point at the same few names, typically the
+		// question; reuse what an earlier pointer decompressed.
+		for ( const auto& e : name_cache )
+			{
+			if ( e.offset != offset ||
+			     e.end > orig_data - msg_start ||
+			     e.len + 1 >= name_len )
+				continue;
+
+			memcpy(name, name_cache_buf.data() + e.buf_offset, e.len);
+			name_len -= e.len;
+			name += e.len;
 			return 0;
 			}
 
@@ -432,9 +517,27 @@ int DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 		const u_char* recurse_data = msg_start + offset;
 		int recurse_max_len = orig_data - recurse_data;
 
+		bool outer_anomaly = name_anomaly;
+		name_anomaly = false;
+
 		u_char* name_end = ExtractName(recurse_data, recurse_max_len,
 						name, name_len, msg_start);
 
+		// Only names that decoded cleanly get cached, so that the
+		// weirds of bad ones keep getting reported the same way.
+		if ( ! name_anomaly && name_cache.size() < DNS_NAME_CACHE_SIZE )
+			{
+			NameCacheEntry e;
+			e.offset = offset;
+			e.end = recurse_data - msg_start;
+			e.buf_offset = name_cache_buf.size();
+			e.len = name_end - name;
+			name_cache_buf.append((const char*) name, e.len);
+			name_cache.push_back(e);
+			}
+
+		name_anomaly = name_anomaly || outer_anomaly;
+
 		name_len -= name_end - name;
 		name = name_end;
 
@@ -444,6 +547,7 @@ int DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 	if ( label_len > len )
 		{
 		analyzer->Weird("DNS_label_len_gt_pkt");
+		name_anomaly = true;
 		data += len;	// consume the rest of the packet
 		len = 0;
 		return 0;
@@ -454,12 +558,14 @@ int DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 		ntohs(analyzer->Conn()->RespPort()) != 137 )
 		{
 		analyzer->Weird("DNS_label_too_long");
+		name_anomaly = true;
 		return 0;
 		}
 
 	if ( label_len >= name_len )
 		{
 		analyzer->Weird("DNS_label_len_gt_name_len");
+		name_anomaly = true;
 		return 0;
 		}
 
@@ -556,8 +662,8 @@ int DNS_Interpreter::ParseRR_Name(DNS_MsgInfo* msg,
 		{
 		analyzer->ConnectionEventFast(reply_event, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(reply_event, 1),
+			msg->BuildAnswerVal(reply_event, 2),
 			new StringVal(new BroString(name, name_end - name, 1)),
 		});
 		}
@@ -610,8 +716,8 @@ int DNS_Interpreter::ParseRR_SOA(DNS_MsgInfo* msg,
 
 		analyzer->ConnectionEventFast(dns_SOA_reply, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_SOA_reply, 1),
+			msg->BuildAnswerVal(dns_SOA_reply, 2),
 			r
 		});
 		}
@@ -641,8 +747,8 @@ int DNS_Interpreter::ParseRR_MX(DNS_MsgInfo* msg,
 		{
 		analyzer->ConnectionEventFast(dns_MX_reply, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_MX_reply, 1),
+			msg->BuildAnswerVal(dns_MX_reply, 2),
 			new StringVal(new BroString(name, name_end - name, 1)),
 			val_mgr->GetCount(preference),
 		});
@@ -684,8 +790,8 @@ int DNS_Interpreter::ParseRR_SRV(DNS_MsgInfo* msg,
 		{
 		analyzer->ConnectionEventFast(dns_SRV_reply, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_SRV_reply, 1),
+			msg->BuildAnswerVal(dns_SRV_reply, 2),
 			new StringVal(new BroString(name, name_end - name, 1)),
 			val_mgr->GetCount(priority),
 			val_mgr->GetCount(weight),
@@ -707,7 +813,7 @@ int DNS_Interpreter::ParseRR_EDNS(DNS_MsgInfo* msg,
 		{
 		analyzer->ConnectionEventFast(dns_EDNS_addl, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
+			msg->BuildHdrVal(dns_EDNS_addl, 1),
 			msg->BuildEDNS_Val(),
 		});
 		}
@@ -785,7 +891,7 @@ int DNS_Interpreter::ParseRR_TSIG(DNS_MsgInfo* msg,
 
 		analyzer->ConnectionEventFast(dns_TSIG_addl, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
+			msg->BuildHdrVal(dns_TSIG_addl, 1),
 			msg->BuildTSIG_Val(&tsig),
 		});
 		}
@@ -886,8 +992,8 @@ int DNS_Interpreter::ParseRR_RRSIG(DNS_MsgInfo* msg,
 
 		analyzer->ConnectionEventFast(dns_RRSIG, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_RRSIG, 1),
+			msg->BuildAnswerVal(dns_RRSIG, 2),
 			msg->BuildRRSIG_Val(&rrsig),
 		});
 		}
@@ -981,8 +1087,8 @@ int DNS_Interpreter::ParseRR_DNSKEY(DNS_MsgInfo* msg,
 
 		analyzer->ConnectionEventFast(dns_DNSKEY, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_DNSKEY, 1),
+			msg->BuildAnswerVal(dns_DNSKEY, 2),
 			msg->BuildDNSKEY_Val(&dnskey),
 		});
 		}
@@ -1033,8 +1139,8 @@ int DNS_Interpreter::ParseRR_NSEC(DNS_MsgInfo* msg,
 	if ( dns_NSEC )
 		analyzer->ConnectionEventFast(dns_NSEC, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_NSEC, 1),
+			msg->BuildAnswerVal(dns_NSEC, 2),
 			new StringVal(new BroString(name, name_end - name, 1)),
 			char_strings,
 		});
@@ -1121,8 +1227,8 @@ int DNS_Interpreter::ParseRR_NSEC3(DNS_MsgInfo* msg,
 
 		analyzer->ConnectionEventFast(dns_NSEC3, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_NSEC3, 1),
+			msg->BuildAnswerVal(dns_NSEC3, 2),
 			msg->BuildNSEC3_Val(&nsec3),
 		});
 		}
@@ -1179,8 +1285,8 @@ int DNS_Interpreter::ParseRR_DS(DNS_MsgInfo* msg,
 
 		analyzer->ConnectionEventFast(dns_DS, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_DS, 1),
+			msg->BuildAnswerVal(dns_DS, 2),
 			msg->BuildDS_Val(&ds),
 		});
 		}
@@ -1203,8 +1309,8 @@ int DNS_Interpreter::ParseRR_A(DNS_MsgInfo* msg,
 		{
 		analyzer->ConnectionEventFast(dns_A_reply, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_A_reply, 1),
+			msg->BuildAnswerVal(dns_A_reply, 2),
 			new AddrVal(htonl(addr)),
 		});
 		}
@@ -1240,8 +1346,8 @@ int DNS_Interpreter::ParseRR_AAAA(DNS_MsgInfo* msg,
 		{
 		analyzer->ConnectionEventFast(event, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(event, 1),
+			msg->BuildAnswerVal(event, 2),
 			new AddrVal(addr),
 		});
 		}
@@ -1315,8 +1421,8 @@ int DNS_Interpreter::ParseRR_TXT(DNS_MsgInfo* msg,
 	if ( dns_TXT_reply )
 		analyzer->ConnectionEventFast(dns_TXT_reply, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_TXT_reply, 1),
+			msg->BuildAnswerVal(dns_TXT_reply, 2),
 			char_strings,
 		});
 	else
@@ -1345,8 +1451,8 @@ int DNS_Interpreter::ParseRR_SPF(DNS_MsgInfo* msg,
 	if ( dns_SPF_reply )
 		analyzer->ConnectionEventFast(dns_SPF_reply, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_SPF_reply, 1),
+			msg->BuildAnswerVal(dns_SPF_reply, 2),
 			char_strings,
 		});
 	else
@@ -1388,8 +1494,8 @@ int DNS_Interpreter::ParseRR_CAA(DNS_MsgInfo* msg,
 	if ( dns_CAA_reply )
 		analyzer->ConnectionEventFast(dns_CAA_reply, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
+			msg->BuildHdrVal(dns_CAA_reply, 1),
+			msg->BuildAnswerVal(dns_CAA_reply, 2),
 			val_mgr->GetCount(flags),
 			new StringVal(tag),
 			new StringVal(value),
@@ -1415,7 +1521,7 @@ void DNS_Interpreter::SendReplyOrRejectEvent(DNS_MsgInfo* msg,
 	if ( event )
 		analyzer->ConnectionEventFast(event, {
 			analyzer->BuildConnVal(),
-			msg->BuildHdrVal(),
+			msg->BuildHdrVal(event, 1),
 			new StringVal(question_name),
 			val_mgr->GetCount(qtype),
 			val_mgr->GetCount(qclass),
@@ -1447,6 +1553,7 @@ DNS_MsgInfo::DNS_MsgInfo(DNS_RawMsgHdr* hdr, int arg_is_query)
 	is_query = arg_is_query;
 
 	query_name = 0;
+	query_name_len = 0;
 	atype = TYPE_ALL;
 	aclass = 0;
 	ttl = 0;
@@ -1460,6 +1567,27 @@ DNS_MsgInfo::~DNS_MsgInfo()
 	Unref(query_name);
 	}
 
+void DNS_MsgInfo::SetQueryName(const u_char* name, int len)
+	{
+	// Only keep the bytes; most answers never get turned into a record,
+	// so the StringVal gets built on first use.
+	Unref(query_name);
+	query_name = 0;
+
+	query_name_len = min(len, int(sizeof(query_name_buf)));
+	memcpy(query_name_buf, name, query_name_len);
+	}
+
+StringVal* DNS_MsgInfo::QueryNameVal()
+	{
+	if ( ! query_name )
+		query_name = new StringVal(query_name_len,
+					(const char*) query_name_buf);
+
+	Ref(query_name);
+	return query_name;
+	}
+
 Val* DNS_MsgInfo::BuildHdrVal()
 	{
 	RecordVal* r = new RecordVal(dns_msg);
@@ -1485,9 +1613,8 @@ Val* DNS_MsgInfo::BuildAnswerVal()
 	{
 	RecordVal* r = new RecordVal(dns_answer);
 
-	Ref(query_name);
 	r->Assign(0, val_mgr->GetCount(int(answer_type)));
-	r->Assign(1, query_name);
+	r->Assign(1, QueryNameVal());
 	r->Assign(2, val_mgr->GetCount(atype));
 	r->Assign(3, val_mgr->GetCount(aclass));
 	r->Assign(4, new IntervalVal(double(ttl), Seconds));
@@ -1495,15 +1622,30 @@ Val* DNS_MsgInfo::BuildAnswerVal()
 	return r;
 	}
 
+Val* DNS_MsgInfo::BuildHdrVal(EventHandlerPtr e, int arg)
+	{
+	if ( ! e->ArgUsed(arg) )
+		return EventHandler::Placeholder(dns_msg);
+
+	return BuildHdrVal();
+	}
+
+Val* DNS_MsgInfo::BuildAnswerVal(EventHandlerPtr e, int arg)
+	{
+	if ( ! e->ArgUsed(arg) )
+		return EventHandler::Placeholder(dns_answer);
+
+	return BuildAnswerVal();
+	}
+
 Val* DNS_MsgInfo::BuildEDNS_Val()
 	{
 	// We have to treat the additional record type in EDNS differently
 	// than a regular resource record.
 	RecordVal* r = new RecordVal(dns_edns_additional);
 
-	Ref(query_name);
 	r->Assign(0, val_mgr->GetCount(int(answer_type)));
-	r->Assign(1, query_name);
+	r->Assign(1, QueryNameVal());
 
 	// type = 0x29 or 41 = EDNS
 	r->Assign(2, val_mgr->GetCount(atype));
@@ -1536,9 +1678,8 @@ Val* DNS_MsgInfo::BuildTSIG_Val(struct TSIG_DATA* tsig)
 	RecordVal* r = new RecordVal(dns_tsig_additional);
 	double rtime = tsig->time_s + tsig->time_ms / 1000.0;
 
-	Ref(query_name);
 	// r->Assign(0, val_mgr->GetCount(int(answer_type)));
-	r->Assign(0, query_name);
+	r->Assign(0, QueryNameVal());
 	r->Assign(1, val_mgr->GetCount(int(answer_type)));
 	r->Assign(2, new StringVal(tsig->alg_name));
 	r->Assign(3, new StringVal(tsig->sig));
@@ -1555,8 +1696,7 @@ Val* DNS_MsgInfo::BuildRRSIG_Val(RRSIG_DATA* rrsig)
 	{
 	RecordVal* r = new RecordVal(dns_rrsig_rr);
 
-	Ref(query_name);
-	r->Assign(0, query_name);
+	r->Assign(0, QueryNameVal());
 	r->Assign(1, val_mgr->GetCount(int(answer_type)));
 	r->Assign(2, val_mgr->GetCount(rrsig->type_covered));
 	r->Assign(3, val_mgr->GetCount(rrsig->algorithm));
@@ -1576,8 +1716,7 @@ Val* DNS_MsgInfo::BuildDNSKEY_Val(DNSKEY_DATA* dnskey)
 	{
 	RecordVal* r = new RecordVal(dns_dnskey_rr);
 
-	Ref(query_name);
-	r->Assign(0, query_name);
+	r->Assign(0, QueryNameVal());
 	r->Assign(1, val_mgr->GetCount(int(answer_type)));
 	r->Assign(2, val_mgr->GetCount(dnskey->dflags));
 	r->Assign(3, val_mgr->GetCount(dnskey->dprotocol));
@@ -1592,8 +1731,7 @@ Val* DNS_MsgInfo::BuildNSEC3_Val(NSEC3_DATA* nsec3)
 	{
 	RecordVal* r = new RecordVal(dns_nsec3_rr);
 
-	Ref(query_name);
-	r->Assign(0, query_name);
+	r->Assign(0, QueryNameVal());
 	r->Assign(1, val_mgr->GetCount(int(answer_type)));
 	r->Assign(2, val_mgr->GetCount(nsec3->nsec_flags));
 	r->Assign(3, val_mgr->GetCount(nsec3->nsec_hash_algo));
@@ -1612,8 +1750,7 @@ Val* DNS_MsgInfo::BuildDS_Val(DS_DATA* ds)
 	{
 	RecordVal* r = new RecordVal(dns_ds_rr);
 
-	Ref(query_name);
-	r->Assign(0, query_name);
+	r->Assign(0, QueryNameVal());
 	r->Assign(1, val_mgr->GetCount(int(answer_type)));
 	r->Assign(2, val_mgr->GetCount(ds->key_tag));
 	r->Assign(3, val_mgr->GetCount(ds->algorithm));
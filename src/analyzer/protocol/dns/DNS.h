@@ -3,6 +3,9 @@
 #ifndef ANALYZER_PROTOCOL_DNS_DNS_H
 #define ANALYZER_PROTOCOL_DNS_DNS_H
 
+#include <string>
+#include <vector>
+
 #include "analyzer/protocol/tcp/TCP.h"
 #include "binpac_bro.h"
 
@@ -75,6 +78,9 @@ typedef enum {
 #define DNS_CLASS_IN 1
 #define DNS_CLASS_ANY 255
 
+// How many decompressed names per message to remember for reuse.
+#define DNS_NAME_CACHE_SIZE 32
+
 typedef enum {
 	DNS_QUESTION,
 	DNS_ANSWER,
@@ -183,6 +189,11 @@ public:
 
 	Val* BuildHdrVal();
 	Val* BuildAnswerVal();
+
+	// Same, but for passing as the given argument of an event; a
+	// handler that never looks at it gets a placeholder instead.
+	Val* BuildHdrVal(EventHandlerPtr e, int arg);
+	Val* BuildAnswerVal(EventHandlerPtr e, int arg);
 	Val* BuildEDNS_Val();
 	Val* BuildTSIG_Val(struct TSIG_DATA*);
 	Val* BuildRRSIG_Val(struct RRSIG_DATA*);
@@ -190,6 +201,12 @@ public:
 	Val* BuildNSEC3_Val(struct NSEC3_DATA*);
 	Val* BuildDS_Val(struct DS_DATA*);
 
+	// Sets the owner name of the current RR.
+	void SetQueryName(const u_char* name, int len);
+
+	// Returns the owner name of the current RR, with a new reference.
+	StringVal* QueryNameVal();
+
 	int id;
 	int opcode;	///< query type, see DNS_Opcode
 	int rcode;	///< return code, see DNS_Code
@@ -205,7 +222,9 @@ public:
 	int arcount;	///< number of additional RRs
 	int is_query;	///< whether it came from the session initiator
 
-	StringVal* query_name;
+	StringVal* query_name;	///< built lazily from query_name_buf
+	u_char query_name_buf[512];
+	int query_name_len;
 	RR_Type atype;
 	int aclass;	///< normally = 1, inet
 	uint32 ttl;
@@ -230,6 +249,10 @@ public:
 protected:
 	int EndMessage(DNS_MsgInfo* msg);
 
+	// Hands a message to the Summary instead of parsing it in full,
+	// for dns_summary_only mode.
+	int Summarize(DNS_MsgInfo* msg, const u_char* data, int len);
+
 	int ParseQuestions(DNS_MsgInfo* msg,
 				const u_char*& data, int& len,
 				const u_char* start);
@@ -314,6 +337,21 @@ protected:
 
 	analyzer::Analyzer* analyzer;
 	bool first_message;
+
+	// Names that compression pointers of the current message have
+	// already been resolved to. The bytes live in name_cache_buf.
+	struct NameCacheEntry {
+		uint16 offset;	///< where the name starts within the message
+		int end;	///< where its encoding ends
+		int buf_offset;
+		int len;
+	};
+
+	std::vector<NameCacheEntry> name_cache;
+	std::string name_cache_buf;
+
+	// Set when extracting a name ran into anything unusual.
+	bool name_anomaly;
 };
 
 
@@ -0,0 +1,138 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "Summary.h"
+#include "Event.h"
+#include "Hash.h"
+#include "NetVar.h"
+#include "Timer.h"
+
+#include "events.bif.h"
+
+using namespace analyzer::dns;
+
+// Error margin of the distinct-name estimate for the replies beyond the
+// bucket limit.
+#define OTHER_QUERIES_ERROR 0.01
+
+namespace {
+
+class SummaryTimer : public Timer {
+public:
+	explicit SummaryTimer(double t) : Timer(t, TIMER_DNS_SUMMARY)	{ }
+
+	void Dispatch(double t, int is_expire) override
+		{
+		Summary::Get()->Flush();
+		}
+};
+
+}
+
+Summary* Summary::Get()
+	{
+	static Summary summary;
+	return &summary;
+	}
+
+Summary::Summary()
+	{
+	start = 0;
+	timer_pending = false;
+	requests = replies = other_replies = 0;
+	}
+
+void Summary::Start()
+	{
+	if ( timer_pending )
+		return;
+
+	start = network_time;
+	timer_mgr->Add(new SummaryTimer(network_time + dns_summary_interval));
+	timer_pending = true;
+	}
+
+void Summary::AddRequest()
+	{
+	Start();
+	++requests;
+	}
+
+void Summary::AddReply(const IPAddr& client, const u_char* query,
+			int query_len, int qtype, int rcode)
+	{
+	Start();
+	++replies;
+
+	const uint32_t* addr;
+	int addr_len = client.GetBytes(&addr);
+
+	key.clear();
+	key.push_back(char(addr_len));
+	key.append((const char*) addr, addr_len * sizeof(uint32));
+	key.push_back(char(qtype >> 8));
+	key.push_back(char(qtype));
+	key.push_back(char(rcode));
+	key.append((const char*) query, query_len);
+
+	auto i = bucket_index.find(key);
+
+	if ( i != bucket_index.end() )
+		{
+		++buckets[i->second].n;
+		return;
+		}
+
+	if ( buckets.size() >= size_t(dns_summary_max_buckets) )
+		{
+		if ( ! other_queries )
+			other_queries = std::unique_ptr<probabilistic::CardinalityCounter>(
+				new probabilistic::CardinalityCounter(OTHER_QUERIES_ERROR));
+
+		other_queries->AddElement(HashKey::HashBytes(query, query_len));
+		++other_replies;
+		return;
+		}
+
+	bucket_index[key] = buckets.size();
+	buckets.push_back({client, std::string((const char*) query, query_len),
+			   qtype, rcode, 1});
+	}
+
+void Summary::Flush()
+	{
+	timer_pending = false;
+
+	if ( dns_summary_bucket )
+		{
+		for ( const auto& b : buckets )
+			mgr.QueueEventFast(dns_summary_bucket, {
+				new AddrVal(b.client),
+				new StringVal(b.query.size(), b.query.data()),
+				val_mgr->GetCount(b.qtype),
+				val_mgr->GetCount(b.rcode),
+				val_mgr->GetCount(b.n),
+			});
+		}
+
+	if ( dns_summary )
+		{
+		uint64 distinct = other_queries ?
+			uint64(other_queries->Size() + 0.5) : 0;
+
+		mgr.QueueEventFast(dns_summary, {
+			new Val(start, TYPE_TIME),
+			val_mgr->GetCount(requests),
+			val_mgr->GetCount(replies),
+			val_mgr->GetCount(buckets.size()),
+			val_mgr->GetCount(other_replies),
+			val_mgr->GetCount(distinct),
+		});
+		}
+
+	buckets.clear();
+	bucket_index.clear();
+	other_queries.reset();
+	requests = replies = other_replies = 0;
+	}
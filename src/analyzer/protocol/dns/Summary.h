@@ -0,0 +1,91 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Aggregation of DNS traffic for dns_summary_only mode.
+//
+// Instead of raising events per message, the DNS analyzer hands each
+// message to the summary, which counts replies per (client, query, qtype,
+// rcode) bucket and reports all buckets once per dns_summary_interval.
+// The number of buckets per interval is bounded; replies that don't fit
+// anymore are only counted, plus a HyperLogLog estimate of how many distinct
+// names they asked for.
+
+#ifndef ANALYZER_PROTOCOL_DNS_SUMMARY_H
+#define ANALYZER_PROTOCOL_DNS_SUMMARY_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "IPAddr.h"
+#include "probabilistic/CardinalityCounter.h"
+
+namespace analyzer { namespace dns {
+
+class Summary {
+public:
+	/**
+	 * Returns the global instance.
+	 */
+	static Summary* Get();
+
+	/**
+	 * Accounts for a request.
+	 */
+	void AddRequest();
+
+	/**
+	 * Accounts for a reply.
+	 *
+	 * @param client The host that asked.
+	 *
+	 * @param query The name in the reply's question, lower-cased.
+	 *
+	 * @param query_len The length of *query*.
+	 *
+	 * @param qtype The type of the question.
+	 *
+	 * @param rcode The reply's return code.
+	 */
+	void AddReply(const IPAddr& client, const u_char* query, int query_len,
+		      int qtype, int rcode);
+
+	/**
+	 * Raises the events for the current interval and resets the counts.
+	 * Called by the summary's timer; the next interval starts with the
+	 * next message.
+	 */
+	void Flush();
+
+private:
+	struct Bucket {
+		IPAddr client;
+		std::string query;
+		int qtype;
+		int rcode;
+		uint64 n;
+	};
+
+	Summary();
+
+	// Starts a new interval if none is running.
+	void Start();
+
+	// Buckets in the order they were created, and an index into them.
+	std::vector<Bucket> buckets;
+	std::unordered_map<std::string, size_t> bucket_index;
+
+	// Key buffer, kept around for its memory.
+	std::string key;
+
+	double start;
+	bool timer_pending;
+	uint64 requests;
+	uint64 replies;
+	uint64 other_replies;
+	std::unique_ptr<probabilistic::CardinalityCounter> other_queries;
+};
+
+} } // namespace analyzer::*
+
+#endif
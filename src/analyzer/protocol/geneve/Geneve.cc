@@ -0,0 +1,133 @@
+// See the file  in the main distribution directory for copyright.
+
+#include "Geneve.h"
+#include "TunnelEncapsulation.h"
+#include "Conn.h"
+#include "IP.h"
+#include "Reporter.h"
+
+#include "events.bif.h"
+
+using namespace analyzer::geneve;
+
+void Geneve_Analyzer::Done()
+	{
+	Analyzer::Done();
+	Event(udp_session_done);
+	}
+
+void Geneve_Analyzer::DeliverPacket(int len, const u_char* data, bool orig,
+                                    uint64 seq, const IP_Hdr* ip, int caplen)
+	{
+	Analyzer::DeliverPacket(len, data, orig, seq, ip, caplen);
+
+	// Outer Ethernet, IP, and UDP layers already skipped.
+	// Also, generic UDP analyzer already checked/guarantees caplen >= len.
+
+	constexpr auto geneve_len = 8;
+
+	if ( len < geneve_len )
+		{
+		ProtocolViolation("Geneve header truncation", (const char*) data, len);
+		return;
+		}
+
+	if ( (data[0] >> 6) != 0 )
+		{
+		ProtocolViolation("Geneve unknown version", (const char*) data, len);
+		return;
+		}
+
+	// The options come right after the fixed header, in 4-byte words.
+	int hdr_len = geneve_len + (data[0] & 0x3f) * 4;
+
+	if ( len < hdr_len )
+		{
+		ProtocolViolation("Geneve option truncation", (const char*) data, len);
+		return;
+		}
+
+	const EncapsulationStack* estack = Conn()->GetEncapsulation();
+
+	if ( estack && estack->Depth() >= BifConst::Tunnel::max_depth )
+		{
+		reporter->Weird(Conn(), "tunnel_depth");
+		return;
+		}
+
+	int proto_type = (data[2] << 8) + data[3];
+	int vni = (data[4] << 16) + (data[5] << 8) + (data[6] << 0);
+
+	data += hdr_len;
+	caplen -= hdr_len;
+	len -= hdr_len;
+
+	pkt_timeval ts;
+	ts.tv_sec = (time_t) current_timestamp;
+	ts.tv_usec = (suseconds_t) ((current_timestamp - (double)ts.tv_sec) * 1000000);
+
+	Packet pkt;
+	int inner_proto;
+
+	switch ( proto_type ) {
+	case 0x6558:	// Transparent Ethernet Bridging
+		pkt.Init(DLT_EN10MB, &ts, caplen, len, data);
+
+		if ( ! pkt.Layer2Valid() )
+			{
+			ProtocolViolation("Geneve invalid inner ethernet frame",
+			                  (const char*) data, len);
+			return;
+			}
+
+		data += pkt.hdr_size;
+		len -= pkt.hdr_size;
+		caplen -= pkt.hdr_size;
+
+		switch ( pkt.l3_proto ) {
+		case L3_IPV4:
+			inner_proto = IPPROTO_IPV4;
+			break;
+		case L3_IPV6:
+			inner_proto = IPPROTO_IPV6;
+			break;
+		default:
+			return;
+		}
+
+		break;
+
+	case 0x0800:
+		pkt.Init(DLT_RAW, &ts, caplen, len, data);
+		inner_proto = IPPROTO_IPV4;
+		break;
+
+	case 0x86dd:
+		pkt.Init(DLT_RAW, &ts, caplen, len, data);
+		inner_proto = IPPROTO_IPV6;
+		break;
+
+	default:
+		return;
+	}
+
+	IP_Hdr* inner = nullptr;
+	int res = sessions->ParseIPPacket(len, data, inner_proto, inner);
+
+	if ( res < 0 )
+		{
+		delete inner;
+		ProtocolViolation("Truncated Geneve or invalid inner IP",
+		                  (const char*) data, len);
+		return;
+		}
+
+	ProtocolConfirmation();
+
+	if ( geneve_packet )
+		Conn()->Event(geneve_packet, 0, inner->BuildPktHdrVal(),
+		              val_mgr->GetCount(vni));
+
+	sessions->DoNextInnerPacket(network_time, &pkt, inner,
+	                            inner_encap.Get(Conn(), BifEnum::Tunnel::GENEVE));
+	}
@@ -0,0 +1,33 @@
+// See the file  in the main distribution directory for copyright.
+
+#ifndef ANALYZER_PROTOCOL_GENEVE_GENEVE_H
+#define ANALYZER_PROTOCOL_GENEVE_GENEVE_H
+
+#include "analyzer/Analyzer.h"
+#include "NetVar.h"
+#include "Reporter.h"
+#include "TunnelEncapsulation.h"
+
+namespace analyzer { namespace geneve {
+
+class Geneve_Analyzer : public analyzer::Analyzer {
+public:
+	explicit Geneve_Analyzer(Connection* conn)
+	    : Analyzer("GENEVE", conn)
+		{}
+
+	void Done() override;
+
+	void DeliverPacket(int len, const u_char* data, bool orig,
+	                   uint64 seq, const IP_Hdr* ip, int caplen) override;
+
+	static analyzer::Analyzer* Instantiate(Connection* conn)
+		{ return new Geneve_Analyzer(conn); }
+
+protected:
+	InnerEncapsulation inner_encap;
+};
+
+} } // namespace analyzer::*
+
+#endif
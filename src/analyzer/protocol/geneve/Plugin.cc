@@ -0,0 +1,24 @@
+// See the file  in the main distribution directory for copyright.
+
+#include "plugin/Plugin.h"
+
+#include "Geneve.h"
+
+namespace plugin {
+namespace Zeek_GENEVE {
+
+class Plugin : public plugin::Plugin {
+public:
+	plugin::Configuration Configure()
+		{
+		AddComponent(new ::analyzer::Component("GENEVE", ::analyzer::geneve::Geneve_Analyzer::Instantiate));
+
+		plugin::Configuration config;
+		config.name = "Zeek::GENEVE";
+		config.description = "Geneve analyzer";
+		return config;
+		}
+} plugin;
+
+}
+}
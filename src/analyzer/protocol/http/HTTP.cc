@@ -213,6 +213,10 @@ void HTTP_Entity::DeliverBodyClear(int len, const char* data, int trailing_CRLF)
 	if ( trailing_CRLF )
 		body_length += 2;
 
+	if ( ! data_wanted )
+		// Just keep counting.
+		return;
+
 	if ( deliver_body )
 		MIME_Entity::Deliver(len, data, trailing_CRLF);
 
@@ -341,6 +345,15 @@ void HTTP_Entity::SubmitData(int len, const char* buf)
 		}
 
 	send_size = false;
+
+	// Without a file to pass the data on to, see whether there's
+	// anybody else still looking at it.
+	if ( precomputed_file_id.empty() &&
+	     ! http_entity_data &&
+	     ! (rule_matcher && rule_matcher->HasPatterns(http_message->IsOrig() ?
+				Rule::HTTP_REQUEST_BODY : Rule::HTTP_REPLY_BODY)) &&
+	     http_message->MyHTTP_Analyzer()->GetChildren().empty() )
+		data_wanted = false;
 	}
 
 void HTTP_Entity::SetPlainDelivery(int64_t length)
@@ -1696,7 +1709,7 @@ void HTTP_Analyzer::HTTP_Header(int is_orig, mime::MIME_Header* h)
 		ConnectionEventFast(http_header, {
 			BuildConnVal(),
 			val_mgr->GetBool(is_orig),
-			mime::new_string_val(h->get_name())->ToUpper(),
+			mime::new_header_name_val(h->get_name()),
 			mime::new_string_val(h->get_value()),
 		});
 		}
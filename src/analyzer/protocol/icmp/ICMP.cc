@@ -45,7 +45,8 @@ void ICMP_Analyzer::DeliverPacket(int len, const u_char* data,
 
 	const struct icmp* icmpp = (const struct icmp*) data;
 
-	if ( ! ignore_checksums && caplen >= len )
+	if ( ! ignore_checksums && caplen >= len &&
+	     ! (current_pkt && current_pkt->l4_checksum_valid) )
 		{
 		int chksum = 0;
 
@@ -455,8 +456,8 @@ void ICMP_Analyzer::Describe(ODesc* d) const
 
 void ICMP_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	{
-	RecordVal *orig_endp = conn_val->Lookup("orig")->AsRecordVal();
-	RecordVal *resp_endp = conn_val->Lookup("resp")->AsRecordVal();
+	RecordVal *orig_endp = conn_val->Lookup(1)->AsRecordVal();
+	RecordVal *resp_endp = conn_val->Lookup(2)->AsRecordVal();
 
 	UpdateEndpointVal(orig_endp, 1);
 	UpdateEndpointVal(resp_endp, 0);
@@ -472,14 +473,14 @@ void ICMP_Analyzer::UpdateEndpointVal(RecordVal* endp, int is_orig)
 	int size = is_orig ? request_len : reply_len;
 	if ( size < 0 )
 		{
-		endp->Assign(0, val_mgr->GetCount(0));
-		endp->Assign(1, val_mgr->GetCount(int(ICMP_INACTIVE)));
+		endp->AssignCount(0, 0);
+		endp->AssignCount(1, int(ICMP_INACTIVE));
 		}
 
 	else
 		{
-		endp->Assign(0, val_mgr->GetCount(size));
-		endp->Assign(1, val_mgr->GetCount(int(ICMP_ACTIVE)));
+		endp->AssignCount(0, size);
+		endp->AssignCount(1, int(ICMP_ACTIVE));
 		}
 	}
 
@@ -4,6 +4,7 @@
 
 #include <ctype.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "NetVar.h"
 #include "Login.h"
@@ -14,13 +15,11 @@
 
 using namespace analyzer::login;
 
-static RE_Matcher* re_skip_authentication = 0;
-static RE_Matcher* re_direct_login_prompts;
-static RE_Matcher* re_login_prompts;
-static RE_Matcher* re_login_non_failure_msgs;
-static RE_Matcher* re_login_failure_msgs;
-static RE_Matcher* re_login_success_msgs;
-static RE_Matcher* re_login_timeouts;
+static RE_Matcher* login_res[NUM_LOGIN_RES];
+
+// All of the lists that have any patterns compiled into one matcher, with
+// the index into login_res plus one as the accepting index.
+static Specific_RE_Matcher* re_login_set = 0;
 
 static RE_Matcher* init_RE(ListVal* l);
 
@@ -39,19 +38,45 @@ Login_Analyzer::Login_Analyzer(const char* name, Connection* conn)
 	num_user_text = 0;
 	client_name = username = 0;
 	saw_ploy = is_VMS = 0;
+	matched_line = 0;
 
-	if ( ! re_skip_authentication )
+	if ( ! login_res[RE_SKIP_AUTHENTICATION] )
 		{
 #ifdef USE_PERFTOOLS_DEBUG
 		HeapLeakChecker::Disabler disabler;
 #endif
-		re_skip_authentication = init_RE(skip_authentication);
-		re_direct_login_prompts = init_RE(direct_login_prompts);
-		re_login_prompts = init_RE(login_prompts);
-		re_login_non_failure_msgs = init_RE(login_non_failure_msgs);
-		re_login_failure_msgs = init_RE(login_failure_msgs);
-		re_login_success_msgs = init_RE(login_success_msgs);
-		re_login_timeouts = init_RE(login_timeouts);
+		login_res[RE_SKIP_AUTHENTICATION] = init_RE(skip_authentication);
+		login_res[RE_DIRECT_LOGIN_PROMPTS] = init_RE(direct_login_prompts);
+		login_res[RE_LOGIN_PROMPTS] = init_RE(login_prompts);
+		login_res[RE_LOGIN_NON_FAILURE_MSGS] = init_RE(login_non_failure_msgs);
+		login_res[RE_LOGIN_FAILURE_MSGS] = init_RE(login_failure_msgs);
+		login_res[RE_LOGIN_SUCCESS_MSGS] = init_RE(login_success_msgs);
+		login_res[RE_LOGIN_TIMEOUTS] = init_RE(login_timeouts);
+
+		string_list pats;
+		int_list idx;
+
+		for ( int i = 0; i < NUM_LOGIN_RES; ++i )
+			{
+			Specific_RE_Matcher* m = login_res[i]->AnywhereMatcher();
+
+			if ( m->DFA() )
+				{
+				pats.append(const_cast<char*>(m->PatternText()));
+				idx.append(i + 1);
+				}
+			}
+
+		if ( pats.length() > 0 )
+			{
+			re_login_set = new Specific_RE_Matcher(MATCH_ANYWHERE);
+
+			if ( ! re_login_set->CompileSet(pats, idx) )
+				{
+				delete re_login_set;
+				re_login_set = 0;
+				}
+			}
 		}
 	}
 
@@ -86,7 +111,11 @@ void Login_Analyzer::DeliverStream(int length, const u_char* line, bool orig)
 
 	str[j] = '\0';
 
+	if ( state == LOGIN_STATE_AUTHENTICATE || state == LOGIN_STATE_CONFUSED )
+		MatchLine(str);
+
 	NewLine(orig, str);
+	matched_line = 0;
 	delete [] str;
 	}
 
@@ -508,12 +537,12 @@ int Login_Analyzer::IsPloy(const char* line)
 
 int Login_Analyzer::IsSkipAuthentication(const char* line) const
 	{
-	return re_skip_authentication->MatchAnywhere(line);
+	return MatchesList(RE_SKIP_AUTHENTICATION, line);
 	}
 
 const char* Login_Analyzer::IsLoginPrompt(const char* line) const
 	{
-	int prompt_match = re_login_prompts->MatchAnywhere(line);
+	int prompt_match = MatchesList(RE_LOGIN_PROMPTS, line);
 	if ( ! prompt_match || IsFailureMsg(line) )
 		// IRIX can report "login: ERROR: Login incorrect"
 		return 0;
@@ -523,23 +552,65 @@ const char* Login_Analyzer::IsLoginPrompt(const char* line) const
 
 int Login_Analyzer::IsDirectLoginPrompt(const char* line) const
 	{
-	return re_direct_login_prompts->MatchAnywhere(line);
+	return MatchesList(RE_DIRECT_LOGIN_PROMPTS, line);
 	}
 
 int Login_Analyzer::IsFailureMsg(const char* line) const
 	{
-	return re_login_failure_msgs->MatchAnywhere(line) &&
-		! re_login_non_failure_msgs->MatchAnywhere(line);
+	return MatchesList(RE_LOGIN_FAILURE_MSGS, line) &&
+		! MatchesList(RE_LOGIN_NON_FAILURE_MSGS, line);
 	}
 
 int Login_Analyzer::IsSuccessMsg(const char* line) const
 	{
-	return re_login_success_msgs->MatchAnywhere(line);
+	return MatchesList(RE_LOGIN_SUCCESS_MSGS, line);
 	}
 
 int Login_Analyzer::IsTimeout(const char* line) const
 	{
-	return re_login_timeouts->MatchAnywhere(line);
+	return MatchesList(RE_LOGIN_TIMEOUTS, line);
+	}
+
+void Login_Analyzer::MatchLine(const char* line)
+	{
+	matched_line = line;
+
+	for ( int i = 0; i < NUM_LOGIN_RES; ++i )
+		// Without any patterns, a list matches anything.
+		line_matches[i] = login_res[i]->AnywhereMatcher()->DFA() ? 0 : 1;
+
+	if ( ! re_login_set )
+		return;
+
+	int n = strlen(line);
+	RE_Match_State ms(re_login_set);
+	ms.Match((const u_char*) line, n, true, true, false);
+
+	const AcceptingMatchSet& accepted = ms.AcceptedMatches();
+
+	for ( AcceptingMatchSet::const_iterator it = accepted.begin();
+	      it != accepted.end(); ++it )
+		{
+		// Turn the position of the first match into what
+		// Specific_RE_Matcher::Match() returns for it, which doesn't
+		// count the beginning and end of the line.
+		int pos = it->second;
+
+		if ( pos == 0 )
+			pos = 1;
+		else if ( pos > n )
+			pos = n > 0 ? n : 1;
+
+		line_matches[it->first - 1] = pos;
+		}
+	}
+
+int Login_Analyzer::MatchesList(int which, const char* line) const
+	{
+	if ( line == matched_line )
+		return line_matches[which];
+
+	return login_res[which]->MatchAnywhere(line);
 	}
 
 int Login_Analyzer::IsEmpty(const char* line) const
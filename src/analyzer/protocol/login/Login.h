@@ -15,6 +15,18 @@ typedef enum {
 	LOGIN_STATE_CONFUSED,	// we're confused
 } login_state;
 
+// The lists of login patterns.
+enum {
+	RE_SKIP_AUTHENTICATION,	// skip_authentication
+	RE_DIRECT_LOGIN_PROMPTS,	// direct_login_prompts
+	RE_LOGIN_PROMPTS,	// login_prompts
+	RE_LOGIN_NON_FAILURE_MSGS,	// login_non_failure_msgs
+	RE_LOGIN_FAILURE_MSGS,	// login_failure_msgs
+	RE_LOGIN_SUCCESS_MSGS,	// login_success_msgs
+	RE_LOGIN_TIMEOUTS,	// login_timeouts
+	NUM_LOGIN_RES
+};
+
 // If no action by this many lines, we're definitely confused.
 #define MAX_AUTHENTICATE_LINES 50
 
@@ -54,6 +66,14 @@ protected:
 	int IsTimeout(const char* line) const;
 	int IsEmpty(const char* line) const;
 
+	// Matches the line against all of the lists in one pass, for the
+	// Is*() checks above to look up instead of matching each list on
+	// their own.
+	void MatchLine(const char* line);
+
+	// What MatchAnywhere() returns for the given list and line.
+	int MatchesList(int which, const char* line) const;
+
 	void AddUserText(const char* line);	// complains on overflow
 	char* PeekUserText();	// internal warning on underflow
 	char* PopUserText();		// internal warning on underflow
@@ -82,6 +102,9 @@ protected:
 
 	int is_VMS;
 	int saw_ploy;
+
+	const char* matched_line;	// the line line_matches is for, if any
+	int line_matches[NUM_LOGIN_RES];
 };
 
 } } // namespace analyzer::* 
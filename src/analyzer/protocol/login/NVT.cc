@@ -3,6 +3,7 @@
 #include "zeek-config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "NVT.h"
 #include "NetVar.h"
@@ -478,6 +479,49 @@ void NVT_Analyzer::SetEncrypting(int mode)
 
 #define MAX_DELIVER_UNIT 128
 
+// True if any byte of the word is zero.
+#define HAS_ZERO_BYTE(w) \
+	(((w) - 0x0101010101010101ULL) & ~(w) & 0x8080808080808080ULL)
+
+// Returns the length of the initial run of bytes that go into the line as
+// they are, i.e., anything but CR, LF, NUL and IAC. In binary mode, that's
+// after stripping the high bit, which an IAC keeps.
+static int plain_run(const u_char* data, int len, bool binary)
+	{
+	uint64 mask = binary ? 0x7f7f7f7f7f7f7f7fULL : ~0ULL;
+	int n = 0;
+
+	for ( ; n + 8 <= len; n += 8 )
+		{
+		uint64 w;
+		memcpy(&w, data + n, sizeof(w));
+
+		uint64 m = w & mask;
+
+		if ( HAS_ZERO_BYTE(m) ||
+		     HAS_ZERO_BYTE(m ^ 0x0d0d0d0d0d0d0d0dULL) ||
+		     HAS_ZERO_BYTE(m ^ 0x0a0a0a0a0a0a0a0aULL) ||
+		     HAS_ZERO_BYTE(~w) )
+			break;
+		}
+
+	for ( ; n < len; ++n )
+		{
+		int c = data[n];
+
+		if ( c == TELNET_IAC )
+			break;
+
+		if ( binary )
+			c &= 0x7f;
+
+		if ( c == '\0' || c == '\r' || c == '\n' )
+			break;
+		}
+
+	return n;
+	}
+
 void NVT_Analyzer::DoDeliver(int len, const u_char* data)
 	{
 	// This code is very similar to that for TCP_ContentLine.  We
@@ -492,6 +536,35 @@ void NVT_Analyzer::DoDeliver(int len, const u_char* data)
 	// Add data up to IAC or end.
 	for ( ; len > 0; --len, ++data )
 		{
+		if ( last_char != '\r' )
+			{
+			// Copy a run of bytes that need no attention in
+			// one go.
+			int n = plain_run(data, len, binary_mode);
+
+			if ( n > 0 )
+				{
+				while ( offset + n >= buf_len )
+					InitBuffer(buf_len * 2);
+
+				if ( binary_mode )
+					{
+					for ( int i = 0; i < n; ++i )
+						buf[offset + i] = data[i] & 0x7f;
+					}
+				else
+					memcpy(buf + offset, data, n);
+
+				offset += n;
+				data += n;
+				len -= n;
+				last_char = buf[offset - 1];
+
+				if ( len == 0 )
+					break;
+				}
+			}
+
 		if ( offset >= buf_len )
 			InitBuffer(buf_len * 2);
 
@@ -554,6 +627,19 @@ void NVT_Analyzer::DoDeliver(int len, const u_char* data)
 			break;
 
 		case TELNET_IAC:
+			if ( len > 1 && data[1] == TELNET_IAC )
+				{
+				// An escaped 255, which stays in the line
+				// like any other byte. Taking it here saves
+				// going through ScanOption() for each one
+				// in binary transfers.
+				buf[offset++] = c;
+				last_char = c;
+				--len;
+				++data;
+				continue;
+				}
+
 			pending_IAC = 1;
 			IAC_pos = offset;
 			is_suboption = 0;
@@ -638,6 +724,25 @@ void NVT_Analyzer::ScanOption(int seq, int len, const u_char* data)
 	// A suboption.  Spin looking for end.
 	for ( ; len > 0; --len, ++data )
 		{
+		if ( ! last_was_IAC && data[0] != TELNET_IAC )
+			{
+			// Copy everything up to the next IAC in one go.
+			const u_char* iac = (const u_char*)
+				memchr(data, TELNET_IAC, len);
+			int n = iac ? iac - data : len;
+
+			while ( offset + n >= buf_len )
+				InitBuffer(buf_len * 2);
+
+			memcpy(buf + offset, data, n);
+			offset += n;
+			data += n;
+			len -= n;
+
+			if ( len == 0 )
+				break;
+			}
+
 		unsigned int code = data[0];
 
 		if ( last_was_IAC )
@@ -1,5 +1,7 @@
 #include "zeek-config.h"
 
+#include <unordered_map>
+
 #include "NetVar.h"
 #include "MIME.h"
 #include "Event.h"
@@ -123,6 +125,39 @@ StringVal* new_string_val(const data_chunk_t buf)
 	return new_string_val(buf.length, buf.data);
 	}
 
+// The same few header names show up over and over again, so we keep
+// their values around for sharing, up to this many.
+#define MAX_SHARED_HEADER_NAMES 256
+
+StringVal* new_header_name_val(const data_chunk_t name)
+	{
+	static std::unordered_map<std::string, StringVal*> shared_names;
+
+	std::string s(name.data, name.length);
+
+	for ( auto& c : s )
+		if ( islower((unsigned char) c) )
+			c = toupper((unsigned char) c);
+
+	auto i = shared_names.find(s);
+
+	if ( i != shared_names.end() )
+		{
+		Ref(i->second);
+		return i->second;
+		}
+
+	StringVal* v = new StringVal(s);
+
+	if ( shared_names.size() < MAX_SHARED_HEADER_NAMES )
+		{
+		Ref(v);
+		shared_names[s] = v;
+		}
+
+	return v;
+	}
+
 static data_chunk_t get_data_chunk(BroString* s)
 	{
 	data_chunk_t b;
@@ -456,6 +491,10 @@ BroString* MIME_Multiline::get_concatenated_line()
 	if ( buffer.size() == 0 )
 		return 0;
 
+	// Most headers fit on one line, no need to copy that.
+	if ( buffer.size() == 1 )
+		return const_cast<BroString*>(buffer[0]);
+
 	delete line;
 	line = concatenate(buffer);
 
@@ -569,6 +608,7 @@ void MIME_Entity::init()
 
 	message = 0;
 	delay_adding_implicit_CRLF = false;
+	data_wanted = true;
 	}
 
 MIME_Entity::~MIME_Entity()
@@ -699,7 +739,7 @@ void MIME_Entity::NewDataLine(int len, const char* data, int trailing_CRLF)
 		}
 	else
 		{
-		if ( mime_decode_data )
+		if ( mime_decode_data && data_wanted )
 			DecodeDataLine(len, data, trailing_CRLF);
 		}
 	}
@@ -1049,6 +1089,13 @@ void MIME_Entity::DecodeBinary(int len, const char* data, int trailing_CRLF)
 		}
 	}
 
+static inline bool is_qp_literal(char ch)
+	{
+	// Printable characters except '=', plus HT and SP.
+	return (ch >= 33 && ch <= 60) || (ch >= 62 && ch <= 126) ||
+		ch == HT || ch == SP;
+	}
+
 void MIME_Entity::DecodeQuotedPrintable(int len, const char* data)
 	{
 	// Ignore trailing HT and SP.
@@ -1093,13 +1140,17 @@ void MIME_Entity::DecodeQuotedPrintable(int len, const char* data)
 				}
 			}
 
-		else if ( (data[i] >= 33 && data[i] <= 60) ||
-			   // except controls, whitespace and '='
-			  (data[i] >= 62 && data[i] <= 126) )
-			DataOctet(data[i]);
+		else if ( is_qp_literal(data[i]) )
+			{
+			// Pass on runs of literal characters in one go.
+			int j = i + 1;
 
-		else if ( data[i] == HT || data[i] == SP )
-			DataOctet(data[i]);
+			while ( j <= end_of_line && is_qp_literal(data[j]) )
+				++j;
+
+			DataOctets(j - i, data + i);
+			i = j - 1;
+			}
 
 		else
 			{
@@ -1117,16 +1168,38 @@ void MIME_Entity::DecodeQuotedPrintable(int len, const char* data)
 
 void MIME_Entity::DecodeBase64(int len, const char* data)
 	{
-	int rlen;
-	char rbuf[128];
-
+	// Decode straight into the message's buffer.
 	while ( len > 0 )
 		{
-		rlen = 128;
-		char* prbuf = rbuf;
+		if ( data_buf_offset < 0 && ! GetDataBuffer() )
+			return;
+
+		int rlen = data_buf_length - data_buf_offset;
+		char* prbuf = data_buf_data + data_buf_offset;
 		int decoded = base64_decoder->Decode(len, data, &rlen, &prbuf);
-		DataOctets(rlen, rbuf);
+		data_buf_offset += rlen;
 		len -= decoded; data += decoded;
+
+		if ( data_buf_offset == data_buf_length )
+			{
+			SubmitData(data_buf_offset, data_buf_data);
+			data_buf_offset = -1;
+			continue;
+			}
+
+		if ( len > 0 )
+			{
+			// The next group doesn't fit into what's left of the
+			// buffer. Decode it on the side, and split it across
+			// this buffer and the next one, so that all buffers
+			// but the last get passed on full.
+			char group[3];
+			int glen = sizeof(group);
+			char* pgroup = group;
+			decoded = base64_decoder->Decode(len, data, &glen, &pgroup);
+			len -= decoded; data += decoded;
+			DataOctets(glen, group);
+			}
 		}
 	}
 
@@ -1199,6 +1272,9 @@ void MIME_Entity::DataOctet(char ch)
 void MIME_Entity::SubmitData(int len, const char* buf)
 	{
 	message->SubmitData(len, buf);
+
+	if ( ! message->WantsEntityData() )
+		data_wanted = false;
 	}
 
 void MIME_Entity::DataOctets(int len, const char* data)
@@ -1285,7 +1361,7 @@ void MIME_Entity::DebugPrintHeaders()
 RecordVal* MIME_Message::BuildHeaderVal(MIME_Header* h)
 	{
 	RecordVal* header_record = new RecordVal(mime_header_rec);
-	header_record->Assign(0, new_string_val(h->get_name())->ToUpper());
+	header_record->Assign(0, new_header_name_val(h->get_name()));
 	header_record->Assign(1, new_string_val(h->get_value()));
 	return header_record;
 	}
@@ -1484,6 +1560,14 @@ void MIME_Mail::SubmitData(int len, const char* buf)
 	buffer_start = (buf + len) - (char*)data_buffer->Bytes();
 	}
 
+bool MIME_Mail::WantsEntityData()
+	{
+	// File analysis leaves us without an ID once it's done with the
+	// entity, or isn't looking at it in the first place.
+	return compute_content_hash || mime_entity_data || mime_all_data ||
+		mime_segment_data || ! cur_entity_id.empty();
+	}
+
 int MIME_Mail::RequestBuffer(int* plen, char** pbuf)
 	{
 	data_start = buffer_start - min_overlap_length;
@@ -173,6 +173,10 @@ protected:
 
 	MIME_Message* message;
 	bool delay_adding_implicit_CRLF;
+
+	// False once nobody is interested in the body's data anymore;
+	// then we stop decoding it.
+	bool data_wanted;
 };
 
 // The reason I separate MIME_Message as an abstract class is to
@@ -218,6 +222,10 @@ public:
 	virtual int RequestBuffer(int* plen, char** pbuf) = 0;
 	virtual void SubmitEvent(int event_type, const char* detail) = 0;
 
+	// Returns false if nothing consumes the current entity's data
+	// anymore, so that its remainder can be skipped.
+	virtual bool WantsEntityData()	{ return true; }
+
 protected:
 	analyzer::Analyzer* analyzer;
 
@@ -242,6 +250,7 @@ public:
 	int RequestBuffer(int* plen, char** pbuf) override;
 	void SubmitAllData();
 	void SubmitEvent(int event_type, const char* detail) override;
+	bool WantsEntityData() override;
 	void Undelivered(int len);
 
 protected:
@@ -267,6 +276,9 @@ extern int is_null_data_chunk(data_chunk_t b);
 extern StringVal* new_string_val(int length, const char* data);
 extern StringVal* new_string_val(const char* data, const char* end_of_data);
 extern StringVal* new_string_val(const data_chunk_t buf);
+// Returns the upper-cased header name, which may be shared with other
+// callers.
+extern StringVal* new_header_name_val(const data_chunk_t name);
 extern int fputs(data_chunk_t b, FILE* fp);
 extern bool istrequal(data_chunk_t s, const char* t);
 extern int is_lws(char ch);
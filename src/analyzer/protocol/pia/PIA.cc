@@ -110,6 +110,16 @@ void PIA::PIA_DeliverPacket(int len, const u_char* data, bool is_orig, uint64 se
 	if ( clear_state )
 		RuleMatcherState::ClearMatchState(is_orig);
 
+	else if ( PayloadExhausted() )
+		{
+		// No signature can match anymore, so there's nothing we
+		// could ever replay the buffer to.
+		DBG_LOG(DBG_ANALYZER, "PIA all signatures ruled out, releasing %d packet bytes",
+			pkt_buffer.size);
+		ClearBuffer(&pkt_buffer);
+		new_state = SKIPPING;
+		}
+
 	pkt_buffer.state = new_state;
 
 	current_packet.data = 0;
@@ -258,6 +268,14 @@ void PIA_TCP::DeliverStream(int len, const u_char* data, bool is_orig)
 
 	DoMatch(data, len, is_orig, false, false, false, 0);
 
+	if ( PayloadExhausted() )
+		{
+		DBG_LOG(DBG_ANALYZER, "PIA all signatures ruled out, releasing %d stream bytes",
+			stream_buffer.size);
+		ClearBuffer(&stream_buffer);
+		new_state = SKIPPING;
+		}
+
 	stream_buffer.state = new_state;
 	}
 
@@ -9,6 +9,8 @@
 #include "XDR.h"
 #include "NFS.h"
 #include "Event.h"
+#include "analyzer/Manager.h"
+#include "file_analysis/Manager.h"
 
 #include "events.bif.h"
 
@@ -184,7 +186,8 @@ int NFS_Interp::RPC_BuildReply(RPC_CallInfo* c, BifEnum::rpc_status rpc_status,
 	case BifEnum::NFS3::PROC_READ:
 		bro_uint_t offset;
 		offset = c->RequestVal()->AsRecordVal()->Lookup(1)->AsCount();
-		reply = nfs3_read_reply(buf, n, nfs_status, offset);
+		reply = nfs3_read_reply(buf, n, nfs_status, offset,
+					c->RequestVal()->AsRecordVal()->Lookup(0));
 		event = nfs_proc_read;
 		break;
 
@@ -293,13 +296,38 @@ int NFS_Interp::RPC_BuildReply(RPC_CallInfo* c, BifEnum::rpc_status rpc_status,
 	return 1;
 	}
 
-StringVal* NFS_Interp::nfs3_file_data(const u_char*& buf, int& n, uint64_t offset, int size)
+StringVal* NFS_Interp::nfs3_file_data(const u_char*& buf, int& n, uint64_t offset, int size,
+				      Val* fh, bool is_orig)
 	{
 	int data_n;
 
 	// extract the data, move buf and n
 	const u_char *data = extract_XDR_opaque(buf, n, data_n, 1 << 30, true);
 
+	analyzer::Tag tag = analyzer->GetAnalyzerTag();
+
+	if ( BifConst::NFS3::analyze_files && data && fh && size > 0 &&
+	     ! file_analysis::Manager::IsDisabled(tag) )
+		{
+		const BroString* fh_s = fh->AsString();
+		std::string fh_key((const char*) fh_s->Bytes(), fh_s->Len());
+		auto it = file_ids.find(fh_key);
+
+		if ( it == file_ids.end() )
+			{
+			std::string handle = analyzer_mgr->GetComponentName(tag);
+			handle += analyzer->Conn()->OrigAddr().AsString();
+			handle += analyzer->Conn()->RespAddr().AsString();
+			handle += fh_key;
+			it = file_ids.insert(std::make_pair(fh_key, file_mgr->HashHandle(handle))).first;
+			}
+
+		// The data stays in the packet, file analysis doesn't need
+		// a copy of it.
+		file_mgr->DataIn(data, min(data_n, size), offset, tag,
+				 analyzer->Conn(), is_orig, it->second);
+		}
+
 	// check whether we have to deliver data to the event
 	if ( ! BifConst::NFS3::return_data )
 		return 0;
@@ -326,7 +354,7 @@ val_list NFS_Interp::event_common_vl(RPC_CallInfo *c, BifEnum::rpc_status rpc_st
 	// These are the first parameters for each nfs_* event ...
 	val_list vl(2 + extra_elements);
 	vl.append(analyzer->BuildConnVal());
-	VectorVal* auxgids = new VectorVal(internal_type("index_vec")->AsVectorType());
+	VectorVal* auxgids = new VectorVal(index_vec);
 
 	for ( size_t i = 0; i < c->AuxGIDs().size(); ++i )
 		auxgids->Assign(i, val_mgr->GetCount(c->AuxGIDs()[i]));
@@ -565,7 +593,7 @@ RecordVal *NFS_Interp::nfs3_readargs(const u_char*& buf, int& n)
 	}
 
 RecordVal* NFS_Interp::nfs3_read_reply(const u_char*& buf, int& n, BifEnum::NFS3::status_t status,
-		bro_uint_t offset)
+		bro_uint_t offset, Val* fh)
 	{
 	RecordVal *rep = new RecordVal(BifType::Record::NFS3::read_reply_t);
 
@@ -577,7 +605,7 @@ RecordVal* NFS_Interp::nfs3_read_reply(const u_char*& buf, int& n, BifEnum::NFS3
 		bytes_read = extract_XDR_uint32(buf, n);
 		rep->Assign(1, val_mgr->GetCount(bytes_read));
 		rep->Assign(2, ExtractBool(buf, n));
-		rep->Assign(3, nfs3_file_data(buf, n, offset, bytes_read));
+		rep->Assign(3, nfs3_file_data(buf, n, offset, bytes_read, fh, false));
 		}
 	else
 		{
@@ -656,14 +684,15 @@ RecordVal *NFS_Interp::nfs3_writeargs(const u_char*& buf, int& n)
 	uint64_t offset;
 	RecordVal *writeargs = new RecordVal(BifType::Record::NFS3::writeargs_t);
 
-	writeargs->Assign(0, nfs3_fh(buf, n));
+	StringVal* fh = nfs3_fh(buf, n);
+	writeargs->Assign(0, fh);
 	offset = extract_XDR_uint64(buf, n);
 	writeargs->Assign(1, val_mgr->GetCount(offset));  // offset
 	bytes = extract_XDR_uint32(buf, n);
 	writeargs->Assign(2, val_mgr->GetCount(bytes));   // size
 
 	writeargs->Assign(3, nfs3_stable_how(buf, n));
-	writeargs->Assign(4, nfs3_file_data(buf, n, offset, bytes));
+	writeargs->Assign(4, nfs3_file_data(buf, n, offset, bytes, fh, true));
 
 	return writeargs;
 	}
@@ -802,6 +831,14 @@ RecordVal* NFS_Interp::nfs3_readdir_reply(bool isplus, const u_char*& buf,
 	return rep;
 	}
 
+void NFS_Interp::EndOfFiles()
+	{
+	for ( const auto& f : file_ids )
+		file_mgr->EndOfFile(f.second);
+
+	file_ids.clear();
+	}
+
 Val* NFS_Interp::ExtractUint32(const u_char*& buf, int& n)
 	{
 	return val_mgr->GetCount(extract_XDR_uint32(buf, n));
@@ -846,3 +883,10 @@ void NFS_Analyzer::Init()
 		AddSupportAnalyzer(resp_rpc);
 		}
 	}
+
+void NFS_Analyzer::Done()
+	{
+	RPC_Analyzer::Done();
+
+	static_cast<NFS_Interp*>(interp)->EndOfFiles();
+	}
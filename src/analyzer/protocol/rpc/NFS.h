@@ -3,6 +3,9 @@
 #ifndef ANALYZER_PROTOCOL_RPC_NFS_H
 #define ANALYZER_PROTOCOL_RPC_NFS_H
 
+#include <map>
+#include <string>
+
 #include "RPC.h"
 #include "XDR.h"
 #include "Event.h"
@@ -13,6 +16,10 @@ class NFS_Interp : public RPC_Interpreter {
 public:
 	explicit NFS_Interp(analyzer::Analyzer* arg_analyzer) : RPC_Interpreter(arg_analyzer) { }
 
+	// Ends file analysis of all files the connection has read or
+	// written.
+	void EndOfFiles();
+
 protected:
 	int RPC_BuildCall(RPC_CallInfo* c, const u_char*& buf, int& n) override;
 	int RPC_BuildReply(RPC_CallInfo* c, BifEnum::rpc_status rpc_status,
@@ -55,7 +62,8 @@ protected:
 	RecordVal* nfs3_sattr_reply(const u_char*& buf, int& n, BifEnum::NFS3::status_t status);
 	RecordVal* nfs3_lookup_reply(const u_char*& buf, int& n, BifEnum::NFS3::status_t status);
 	RecordVal* nfs3_readargs(const u_char*& buf, int& n);
-	RecordVal* nfs3_read_reply(const u_char*& buf, int& n, BifEnum::NFS3::status_t status, bro_uint_t offset);
+	RecordVal* nfs3_read_reply(const u_char*& buf, int& n, BifEnum::NFS3::status_t status,
+				   bro_uint_t offset, Val* fh);
 	RecordVal* nfs3_readlink_reply(const u_char*& buf, int& n, BifEnum::NFS3::status_t status);
 	RecordVal* nfs3_link_reply(const u_char*& buf, int& n, BifEnum::NFS3::status_t status);
 	RecordVal* nfs3_writeargs(const u_char*& buf, int& n);
@@ -72,19 +80,26 @@ protected:
 	// in bro.init returns NULL or the data as string val:
 	//   * offset is the offset of the read/write call
 	//   * size is the amount of bytes read (or requested to be written),
-	StringVal* nfs3_file_data(const u_char*& buf, int& n, uint64_t offset, int size);
+	// Also passes the data on to file analysis if NFS3::analyze_files
+	// is set; fh is the handle of the file it belongs to, if known.
+	StringVal* nfs3_file_data(const u_char*& buf, int& n, uint64_t offset, int size,
+				  Val* fh, bool is_orig);
 
 	Val* ExtractUint32(const u_char*& buf, int& n);
 	Val* ExtractUint64(const u_char*& buf, int& n);
 	Val* ExtractTime(const u_char*& buf, int& n);
 	Val* ExtractInterval(const u_char*& buf, int& n);
 	Val* ExtractBool(const u_char*& buf, int& n);
+
+	// Maps the file handles seen in reads and writes to their file IDs.
+	std::map<std::string, std::string> file_ids;
 };
 
 class NFS_Analyzer : public RPC_Analyzer {
 public:
 	explicit NFS_Analyzer(Connection* conn);
 	void Init() override;
+	void Done() override;
 
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new NFS_Analyzer(conn); }
@@ -98,15 +98,70 @@ int RPC_CallInfo::CompareRexmit(const u_char* buf, int n) const
 	}
 
 
-void rpc_callinfo_delete_func(void* v)
+// The call table starts out with this many slots once it gets its first
+// call, doubling whenever it gets half full.
+#define INITIAL_CALL_SLOTS 16
+
+// How many slots each RPC checks for calls that have timed out.
+#define SWEEP_CALL_SLOTS 4
+
+RPC_CallTable::RPC_CallTable()
+	: slots(INITIAL_CALL_SLOTS)
+	{
+	sweep_pos = 0;
+	}
+
+RPC_CallTable::~RPC_CallTable()
+	{
+	for ( uint32 i = 0; i < slots.NumSlots(); ++i )
+		delete slots[i].call;
+	}
+
+RPC_CallInfo* RPC_CallTable::Lookup(uint32 xid) const
+	{
+	uint32 i = slots.Find(HashXID(xid), xid);
+	return i < slots.NumSlots() ? slots[i].call : 0;
+	}
+
+void RPC_CallTable::Insert(RPC_CallInfo* c)
+	{
+	Slot* s = slots.Insert(HashXID(c->XID()));
+	s->xid = c->XID();
+	s->call = c;
+	}
+
+RPC_CallInfo* RPC_CallTable::Remove(uint32 xid)
 	{
-	delete (RPC_CallInfo*) v;
+	uint32 i = slots.Find(HashXID(xid), xid);
+
+	if ( i >= slots.NumSlots() )
+		return 0;
+
+	RPC_CallInfo* c = slots[i].call;
+	slots.Remove(i);
+	return c;
+	}
+
+RPC_CallInfo* RPC_CallTable::ExpireNext(double cutoff)
+	{
+	if ( ! slots.Size() )
+		return 0;
+
+	RPC_CallInfo* c = slots[sweep_pos].call;
+
+	if ( c && c->LastTime() < cutoff )
+		{
+		slots.Remove(sweep_pos);
+		return c;
+		}
+
+	sweep_pos = (sweep_pos + 1) & slots.Mask();
+	return 0;
 	}
 
 RPC_Interpreter::RPC_Interpreter(analyzer::Analyzer* arg_analyzer)
 	{
 	analyzer = arg_analyzer;
-	calls.SetDeleteFunc(rpc_callinfo_delete_func);
 	}
 
 RPC_Interpreter::~RPC_Interpreter()
@@ -123,8 +178,10 @@ int RPC_Interpreter::DeliverRPC(const u_char* buf, int n, int rpclen,
 	if ( ! buf )
 		return 0;
 
-	HashKey h(&xid, 1);
-	RPC_CallInfo* call = calls.Lookup(&h);
+	if ( rpc_timeout > 0 )
+		ExpireCalls(last_time);
+
+	RPC_CallInfo* call = calls.Lookup(xid);
 
 	if ( msg_type == RPC_CALL )
 		{
@@ -164,7 +221,7 @@ int RPC_Interpreter::DeliverRPC(const u_char* buf, int n, int rpclen,
 				return 0;
 				}
 
-			calls.Insert(&h, call);
+			calls.Insert(call);
 			}
 
 		// We now have a valid RPC_CallInfo (either the previous one
@@ -274,7 +331,7 @@ int RPC_Interpreter::DeliverRPC(const u_char* buf, int n, int rpclen,
 
 			Event_RPC_Dialogue(call, status, n);
 
-			delete calls.RemoveEntry(&h);
+			delete calls.Remove(xid);
 			}
 		else
 			{
@@ -308,11 +365,13 @@ int RPC_Interpreter::DeliverRPC(const u_char* buf, int n, int rpclen,
 
 void RPC_Interpreter::Timeout()
 	{
-	IterCookie* cookie = calls.InitForIteration();
-	RPC_CallInfo* c;
-
-	while ( (c = calls.NextEntry(cookie)) )
+	for ( uint32 i = 0; i < calls.NumSlots(); ++i )
 		{
+		RPC_CallInfo* c = calls.CallAt(i);
+
+		if ( ! c )
+			continue;
+
 		Event_RPC_Dialogue(c, BifEnum::RPC_TIMEOUT, 0);
 
 		if ( c->IsValidCall() )
@@ -326,6 +385,30 @@ void RPC_Interpreter::Timeout()
 		}
 	}
 
+void RPC_Interpreter::ExpireCalls(double t)
+	{
+	for ( int i = 0; i < SWEEP_CALL_SLOTS; ++i )
+		{
+		RPC_CallInfo* c = calls.ExpireNext(t - rpc_timeout);
+
+		if ( ! c )
+			continue;
+
+		Event_RPC_Dialogue(c, BifEnum::RPC_TIMEOUT, 0);
+
+		if ( c->IsValidCall() )
+			{
+			const u_char* buf = nullptr;
+			int n = 0;
+
+			if ( ! RPC_BuildReply(c, BifEnum::RPC_TIMEOUT, buf, n, t, t, 0) )
+				Weird("bad_RPC");
+			}
+
+		delete c;
+		}
+	}
+
 void RPC_Interpreter::Event_RPC_Dialogue(RPC_CallInfo* c, BifEnum::rpc_status status, int reply_len)
 	{
 	if ( rpc_dialogue )
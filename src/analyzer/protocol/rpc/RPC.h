@@ -3,6 +3,7 @@
 #ifndef ANALYZER_PROTOCOL_RPC_RPC_H
 #define ANALYZER_PROTOCOL_RPC_RPC_H
 
+#include "OpenTable.h"
 #include "analyzer/protocol/tcp/TCP.h"
 #include "analyzer/protocol/udp/UDP.h"
 
@@ -99,7 +100,54 @@ protected:
 	Val* v;		// single (perhaps compound) value corresponding to call
 };
 
-declare(PDict,RPC_CallInfo);
+// Maps XIDs to the calls waiting for their replies. It's an OpenTable
+// keyed on the XID itself, so looking up a call doesn't need a HashKey.
+// It deletes the calls still in it when it goes away.
+class RPC_CallTable {
+public:
+	RPC_CallTable();
+	~RPC_CallTable();
+
+	RPC_CallInfo* Lookup(uint32 xid) const;
+
+	// The table must not have a call with the same XID yet.
+	void Insert(RPC_CallInfo* c);
+
+	// Takes the call with the given XID out of the table, returning it
+	// if there is one.
+	RPC_CallInfo* Remove(uint32 xid);
+
+	// Looks at the next slot of a sweep round the table. If that has a
+	// call last seen before the given time, takes it out of the table
+	// and returns it; the slot then gets looked at again next time.
+	RPC_CallInfo* ExpireNext(double cutoff);
+
+	int Size() const		{ return slots.Size(); }
+
+	// For iterating over all calls; CallAt() returns nil for empty
+	// slots.
+	uint32 NumSlots() const		{ return slots.NumSlots(); }
+	RPC_CallInfo* CallAt(uint32 i) const	{ return slots[i].call; }
+
+protected:
+	struct Slot {
+		uint32 xid;
+		RPC_CallInfo* call;	// nil if the slot is empty
+
+		bool Used() const	{ return call != 0; }
+		hash_t Hash() const	{ return HashXID(xid); }
+		bool Matches(uint32 arg_xid) const	{ return xid == arg_xid; }
+	};
+
+	static hash_t HashXID(uint32 xid)
+		{
+		uint32 h = xid * 0x9e3779b1;
+		return h ^ (h >> 16);
+		}
+
+	OpenTable<Slot> slots;
+	uint32 sweep_pos;
+};
 
 class RPC_Interpreter {
 public:
@@ -125,7 +173,11 @@ protected:
 
 	void Weird(const char* name, const char* addl = "");
 
-	PDict(RPC_CallInfo) calls;
+	// Times out a few of the calls that haven't seen a reply for
+	// rpc_timeout.
+	void ExpireCalls(double t);
+
+	RPC_CallTable calls;
 	analyzer::Analyzer* analyzer;
 };
 
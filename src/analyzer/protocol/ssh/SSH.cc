@@ -8,6 +8,7 @@
 
 #include "types.bif.h"
 #include "events.bif.h"
+#include "consts.bif.h"
 
 using namespace analyzer::SSH;
 
@@ -20,6 +21,10 @@ SSH_Analyzer::SSH_Analyzer(Connection* c)
 	skipped_banner = false;
 	service_accept_size = 0;
 	userauth_failure_size = 0;
+	skipping = false;
+
+	for ( int i = 0; i < 2; ++i )
+		skip_pos[i] = skipped_packets[i] = skipped_bytes[i] = 0;
 	}
 
 SSH_Analyzer::~SSH_Analyzer()
@@ -31,6 +36,17 @@ void SSH_Analyzer::Done()
 	{
 	tcp::TCP_ApplicationAnalyzer::Done();
 
+	if ( skipping && ssh_encrypted_packets )
+		{
+		for ( int i = 1; i >= 0; --i )
+			ConnectionEventFast(ssh_encrypted_packets, {
+				BuildConnVal(),
+				val_mgr->GetBool(i),
+				val_mgr->GetCount(skipped_packets[i]),
+				val_mgr->GetCount(skipped_bytes[i]),
+			});
+		}
+
 	interp->FlowEOF(true);
 	interp->FlowEOF(false);
 	}
@@ -63,6 +79,15 @@ void SSH_Analyzer::DeliverStream(int len, const u_char* data, bool orig)
 		if ( ! auth_decision_made )
 			ProcessEncrypted(len, orig);
 
+		// The inference of the authentication outcome only looks at
+		// SSH2, so for SSH1 there's nothing left to find out.
+		if ( BifConst::SSH::skip_encrypted_payload &&
+		     ! ssh_encrypted_packet &&
+		     (auth_decision_made ||
+		      interp->get_version() != binpac::SSH::SSH2) &&
+		     interp->get_state(! orig) == binpac::SSH::ENCRYPTED )
+			StartSkipping();
+
 		return;
 		}
 
@@ -76,6 +101,43 @@ void SSH_Analyzer::DeliverStream(int len, const u_char* data, bool orig)
 		}
 	}
 
+void SSH_Analyzer::DeliverPacket(int len, const u_char* data, bool orig,
+				uint64 seq, const IP_Hdr* ip, int caplen)
+	{
+	tcp::TCP_ApplicationAnalyzer::DeliverPacket(len, data, orig, seq, ip, caplen);
+
+	if ( ! skipping || len <= 0 )
+		return;
+
+	// Once reassembly has stopped, the packets get here as they arrive,
+	// and only their sizes matter.
+	if ( seq + len <= skip_pos[orig] )
+		// Retransmission.
+		return;
+
+	uint64 start = max(seq, skip_pos[orig]);
+
+	++skipped_packets[orig];
+	skipped_bytes[orig] += seq + len - start;
+	skip_pos[orig] = seq + len;
+	}
+
+void SSH_Analyzer::StartSkipping()
+	{
+	if ( skipping || had_gap || Parent() != TCP() )
+		return;
+
+	tcp::TCP_Reassembler* r_orig = TCP()->Orig()->contents_processor;
+	tcp::TCP_Reassembler* r_resp = TCP()->Resp()->contents_processor;
+
+	if ( ! r_orig || ! r_resp || ! TCP()->StopReassembly(this) )
+		return;
+
+	skip_pos[1] = r_orig->LastReassemSeq();
+	skip_pos[0] = r_resp->LastReassemSeq();
+	skipping = true;
+	}
+
 void SSH_Analyzer::Undelivered(uint64 seq, int len, bool orig)
 	{
 	tcp::TCP_ApplicationAnalyzer::Undelivered(seq, len, orig);
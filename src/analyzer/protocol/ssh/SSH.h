@@ -19,6 +19,8 @@ namespace analyzer {
 			// Overriden from Analyzer.
 			void Done() override;
 			void DeliverStream(int len, const u_char* data, bool orig) override;
+			void DeliverPacket(int len, const u_char* data, bool orig,
+					uint64 seq, const IP_Hdr* ip, int caplen) override;
 			void Undelivered(uint64 seq, int len, bool orig) override;
 
 			// Overriden from tcp::TCP_ApplicationAnalyzer.
@@ -32,6 +34,10 @@ namespace analyzer {
 
 			void ProcessEncrypted(int len, bool orig);
 
+			// Switches to just counting the encrypted packets as they
+			// arrive, if the TCP analyzer agrees to stop reassembling.
+			void StartSkipping();
+
 			bool had_gap;
 
 			// Packet analysis stuff
@@ -41,6 +47,13 @@ namespace analyzer {
 			int service_accept_size;
 			int userauth_failure_size;
 
+			// For SSH::skip_encrypted_payload, per direction and
+			// indexed by is_orig.
+			bool skipping;
+			uint64 skip_pos[2];	// next sequence number to count
+			uint64 skipped_packets[2];
+			uint64 skipped_bytes[2];
+
 			};
 
 		}
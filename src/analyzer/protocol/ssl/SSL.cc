@@ -5,6 +5,7 @@
 #include "util.h"
 
 #include "events.bif.h"
+#include "consts.bif.h"
 #include "ssl_pac.h"
 #include "tls-handshake_pac.h"
 
@@ -16,6 +17,8 @@ SSL_Analyzer::SSL_Analyzer(Connection* c)
 	interp = new binpac::SSL::SSL_Conn(this);
 	handshake_interp = new binpac::TLSHandshake::Handshake_Conn(this);
 	had_gap = false;
+	skipping = false;
+	memset(walkers, 0, sizeof(walkers));
 	}
 
 SSL_Analyzer::~SSL_Analyzer()
@@ -28,6 +31,17 @@ void SSL_Analyzer::Done()
 	{
 	tcp::TCP_ApplicationAnalyzer::Done();
 
+	if ( skipping && ssl_encrypted_records )
+		{
+		for ( int i = 1; i >= 0; --i )
+			ConnectionEventFast(ssl_encrypted_records, {
+				BuildConnVal(),
+				val_mgr->GetBool(i),
+				val_mgr->GetCount(walkers[i].records),
+				val_mgr->GetCount(walkers[i].bytes),
+			});
+		}
+
 	interp->FlowEOF(true);
 	interp->FlowEOF(false);
 	handshake_interp->FlowEOF(true);
@@ -61,6 +75,9 @@ void SSL_Analyzer::DeliverStream(int len, const u_char* data, bool orig)
 		// deliver data to the other side if the script layer can handle this.
 		return;
 
+	if ( BifConst::SSL::skip_encrypted_payload )
+		WalkRecords(&walkers[orig], data, len);
+
 	try
 		{
 		interp->NewData(orig, data, data + len);
@@ -69,6 +86,112 @@ void SSL_Analyzer::DeliverStream(int len, const u_char* data, bool orig)
 		{
 		ProtocolViolation(fmt("Binpac exception: %s", e.c_msg()));
 		}
+
+	if ( BifConst::SSL::skip_encrypted_payload && ! ssl_encrypted_data &&
+	     interp->isEstablished() )
+		StartSkipping();
+	}
+
+void SSL_Analyzer::DeliverPacket(int len, const u_char* data, bool orig,
+				uint64 seq, const IP_Hdr* ip, int caplen)
+	{
+	tcp::TCP_ApplicationAnalyzer::DeliverPacket(len, data, orig, seq, ip, caplen);
+
+	if ( ! skipping || len <= 0 )
+		return;
+
+	// Once reassembly has stopped, the packets get here as they arrive.
+	RecordWalker* w = &walkers[orig];
+
+	if ( seq + len <= w->pos )
+		// Retransmission.
+		return;
+
+	if ( seq > w->pos )
+		{
+		// Something's missing, which loses the record boundaries.
+		w->lost = true;
+		w->bytes += len;
+		w->pos = seq + len;
+		return;
+		}
+
+	int skip = w->pos - seq;
+	int avail = max(0, caplen - skip);
+	int missing = len - skip - avail;
+
+	w->bytes += len - skip;
+	w->pos = seq + len;
+
+	WalkRecords(w, data + skip, avail);
+
+	if ( missing > 0 )
+		{
+		// Not captured, but fine if within a record's body.
+		if ( w->hdr_len == 0 && w->body_left >= uint64(missing) )
+			w->body_left -= missing;
+		else
+			w->lost = true;
+		}
+	}
+
+void SSL_Analyzer::WalkRecords(RecordWalker* w, const u_char* data, int len)
+	{
+	while ( len > 0 && ! w->lost )
+		{
+		if ( w->body_left )
+			{
+			int n = min(uint64(len), w->body_left);
+			w->body_left -= n;
+			data += n;
+			len -= n;
+			continue;
+			}
+
+		int n = min(len, int(sizeof(w->hdr)) - w->hdr_len);
+		memcpy(w->hdr + w->hdr_len, data, n);
+		w->hdr_len += n;
+		data += n;
+		len -= n;
+
+		if ( w->hdr_len < int(sizeof(w->hdr)) )
+			break;
+
+		// Only TLS records can be followed this way, which have a
+		// content type of 20 to 24; SSLv2 or garbage ends it.
+		if ( w->hdr[0] < 20 || w->hdr[0] > 24 )
+			{
+			w->lost = true;
+			break;
+			}
+
+		w->body_left = (w->hdr[3] << 8) | w->hdr[4];
+		w->hdr_len = 0;
+		++w->records;
+		}
+	}
+
+void SSL_Analyzer::StartSkipping()
+	{
+	if ( skipping || had_gap || Parent() != TCP() ||
+	     walkers[0].lost || walkers[1].lost )
+		// Only when sitting right on top of TCP and in sync with the
+		// record boundaries of both directions.
+		return;
+
+	tcp::TCP_Reassembler* r_orig = TCP()->Orig()->contents_processor;
+	tcp::TCP_Reassembler* r_resp = TCP()->Resp()->contents_processor;
+
+	if ( ! r_orig || ! r_resp || ! TCP()->StopReassembly(this) )
+		return;
+
+	walkers[1].pos = r_orig->LastReassemSeq();
+	walkers[0].pos = r_resp->LastReassemSeq();
+
+	for ( auto& w : walkers )
+		w.records = w.bytes = 0;
+
+	skipping = true;
 	}
 
 void SSL_Analyzer::SendHandshake(uint16 raw_tls_version, const u_char* begin, const u_char* end, bool orig)
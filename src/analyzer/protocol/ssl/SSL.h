@@ -19,6 +19,8 @@ public:
 	// Overriden from Analyzer.
 	void Done() override;
 	void DeliverStream(int len, const u_char* data, bool orig) override;
+	void DeliverPacket(int len, const u_char* data, bool orig,
+			uint64 seq, const IP_Hdr* ip, int caplen) override;
 	void Undelivered(uint64 seq, int len, bool orig) override;
 
 	void SendHandshake(uint16 raw_tls_version, const u_char* begin, const u_char* end, bool orig);
@@ -33,10 +35,30 @@ public:
 		{ return new SSL_Analyzer(conn); }
 
 protected:
+	// Follows the TLS record boundaries of one direction by their
+	// headers alone, for SSL::skip_encrypted_payload.
+	struct RecordWalker {
+		u_char hdr[5];
+		int hdr_len;
+		uint64 body_left;
+		bool lost;	// record boundaries are unknown
+		uint64 pos;	// next sequence number to look at
+		uint64 records;
+		uint64 bytes;
+	};
+
+	void WalkRecords(RecordWalker* w, const u_char* data, int len);
+
+	// Switches to following just the record headers in the packets, if
+	// the TCP analyzer agrees to stop reassembling.
+	void StartSkipping();
+
 	binpac::SSL::SSL_Conn* interp;
 	binpac::TLSHandshake::Handshake_Conn* handshake_interp;
 	bool had_gap;
 
+	RecordWalker walkers[2];
+	bool skipping;
 };
 
 } } // namespace analyzer::* 
@@ -15,12 +15,17 @@
 
 using namespace analyzer::stepping_stone;
 
+// How many buckets the time index splits stp_delta into.
+#define STP_BUCKETS 16
+
 SteppingStoneEndpoint::SteppingStoneEndpoint(tcp::TCP_Endpoint* e, SteppingStoneManager* m)
 	{
 	endp = e;
 	stp_max_top_seq = 0;
 	stp_last_time = stp_resume_time = 0.0;
 	stp_manager = m;
+	stp_bucket = -1;
+	stp_pos = 0;
 	stp_id = stp_manager->NextID();
 	stp_key = new HashKey(bro_int_t(stp_id));
 
@@ -73,22 +78,7 @@ int SteppingStoneEndpoint::DataSent(double t, uint64 seq, int len, int caplen,
 	if ( len <= 0 )
 		return 0;
 
-	double tmin = t - stp_delta;
-
-	while ( stp_manager->OrderedEndpoints().length() > 0 )
-		{
-		int f = stp_manager->OrderedEndpoints().front();
-
-		if ( stp_manager->OrderedEndpoints()[f]->stp_resume_time < tmin )
-			{
-			SteppingStoneEndpoint* e =
-				stp_manager->OrderedEndpoints().pop_front();
-			e->Done();
-			Unref(e);
-			}
-		else
-			break;
-		}
+	stp_manager->Expire(t - stp_delta);
 
 	uint64 ack = endp->ToRelativeSeqSpace(endp->AckSeq(), endp->AckWraps());
 	uint64 top_seq = seq + len;
@@ -109,27 +99,28 @@ int SteppingStoneEndpoint::DataSent(double t, uint64 seq, int len, int caplen,
 	stp_last_time = stp_resume_time = t;
 
 	Event(stp_resume_endp, stp_id);
-	loop_over_queue(stp_manager->OrderedEndpoints(), i)
+
+	stp_manager->ForEach([this](SteppingStoneEndpoint* ep)
 		{
-		SteppingStoneEndpoint* ep = stp_manager->OrderedEndpoints()[i];
-		if ( ep->endp->TCP() != endp->TCP() )
+		if ( ep->endp->TCP() == endp->TCP() )
+			// ep and this belong to same connection
+			return;
+
+		// The pair may be correlated already from an earlier
+		// resumption; it holds one reference each way.
+		if ( ! stp_inbound_endps.Lookup(ep->stp_key) )
 			{
 			Ref(ep);
 			Ref(this);
 
 			stp_inbound_endps.Insert(ep->stp_key, ep);
 			ep->stp_outbound_endps.Insert(stp_key, this);
-
-			Event(stp_correlate_pair, ep->stp_id, stp_id);
 			}
 
-		else
-			{ // ep and this belong to same connection
-			}
-		}
+		Event(stp_correlate_pair, ep->stp_id, stp_id);
+		});
 
-	stp_manager->OrderedEndpoints().push_back(this);
-	Ref(this);
+	stp_manager->Insert(this, t);
 
 	return 1;
 	}
@@ -158,6 +149,142 @@ void SteppingStoneEndpoint::CreateEndpEvent(int is_orig)
 	});
 	}
 
+SteppingStoneManager::SteppingStoneManager()
+	{
+	// The window spans one bucket more than it covers, as it usually
+	// cuts into the oldest one.
+	buckets.resize(STP_BUCKETS + 2);
+	width = stp_delta / STP_BUCKETS;
+	oldest = newest = 0;
+	num_endps = 0;
+	max_endps = int(opt_internal_int("stp_max_endps"));
+	endp_cnt = 0;
+	}
+
+void SteppingStoneManager::Expire(double tmin)
+	{
+	if ( ! num_endps )
+		return;
+
+	int64 first = BucketOf(tmin);
+
+	// Everything in the buckets before the one tmin falls into is out
+	// of the window.
+	while ( oldest < first && oldest < newest )
+		{
+		std::vector<SteppingStoneEndpoint*>& b = Bucket(oldest);
+
+		for ( size_t i = 0; i < b.size(); ++i )
+			if ( b[i] )
+				Remove(b[i]);
+
+		b.clear();
+		++oldest;
+		}
+
+	// The rest are in the order they resumed, so the ones still to go
+	// come first.
+	while ( num_endps )
+		{
+		std::vector<SteppingStoneEndpoint*>& b = Bucket(oldest);
+
+		for ( size_t i = 0; i < b.size(); ++i )
+			{
+			if ( ! b[i] )
+				continue;
+
+			if ( b[i]->stp_resume_time >= tmin )
+				return;
+
+			Remove(b[i]);
+			}
+
+		if ( oldest == newest )
+			break;
+
+		b.clear();
+		++oldest;
+		}
+	}
+
+void SteppingStoneManager::Insert(SteppingStoneEndpoint* e, double t)
+	{
+	if ( e->stp_bucket >= 0 )
+		{
+		// Keeps the reference the index has.
+		Bucket(e->stp_bucket)[e->stp_pos] = 0;
+		--num_endps;
+		}
+	else
+		Ref(e);
+
+	int64 k = BucketOf(t);
+
+	if ( ! num_endps )
+		{
+		// Empty, start the ring over at this bucket.
+		for ( int64 j = oldest; j <= newest; ++j )
+			Bucket(j).clear();
+
+		oldest = newest = k;
+		}
+
+	// If more buckets have gone by than the ring holds, make room.
+	while ( k - oldest >= int64(buckets.size()) )
+		{
+		std::vector<SteppingStoneEndpoint*>& b = Bucket(oldest);
+
+		for ( size_t i = 0; i < b.size(); ++i )
+			if ( b[i] )
+				Remove(b[i]);
+
+		b.clear();
+		++oldest;
+		}
+
+	if ( k > newest )
+		{
+		for ( int64 j = newest + 1; j <= k; ++j )
+			Bucket(j).clear();
+
+		newest = k;
+		}
+
+	std::vector<SteppingStoneEndpoint*>& b = Bucket(newest);
+	e->stp_bucket = newest;
+	e->stp_pos = b.size();
+	b.push_back(e);
+	++num_endps;
+
+	while ( max_endps > 0 && num_endps > max_endps )
+		RemoveOldest();
+	}
+
+void SteppingStoneManager::Remove(SteppingStoneEndpoint* e)
+	{
+	Bucket(e->stp_bucket)[e->stp_pos] = 0;
+	e->stp_bucket = -1;
+	--num_endps;
+
+	e->Done();
+	Unref(e);
+	}
+
+void SteppingStoneManager::RemoveOldest()
+	{
+	for ( int64 k = oldest; k <= newest; ++k )
+		{
+		const std::vector<SteppingStoneEndpoint*>& b = Bucket(k);
+
+		for ( size_t i = 0; i < b.size(); ++i )
+			if ( b[i] )
+				{
+				Remove(b[i]);
+				return;
+				}
+		}
+	}
+
 SteppingStone_Analyzer::SteppingStone_Analyzer(Connection* c)
 : tcp::TCP_ApplicationAnalyzer("STEPPINGSTONE", c)
 	{
@@ -3,7 +3,8 @@
 #ifndef ANALYZER_PROTOCOL_STEPPING_STONE_STEPPINGSTONE_H
 #define ANALYZER_PROTOCOL_STEPPING_STONE_STEPPINGSTONE_H
 
-#include "Queue.h"
+#include <vector>
+
 #include "analyzer/protocol/tcp/TCP.h"
 
 class NetSessions;
@@ -13,7 +14,6 @@ namespace analyzer { namespace stepping_stone {
 class SteppingStoneEndpoint;
 class SteppingStoneManager;
 
-declare(PQueue,SteppingStoneEndpoint);
 declare(PDict,SteppingStoneEndpoint);
 
 class SteppingStoneEndpoint : public BroObj {
@@ -26,6 +26,8 @@ public:
 		     const IP_Hdr* ip, const struct tcphdr* tp);
 
 protected:
+	friend class SteppingStoneManager;
+
 	void Event(EventHandlerPtr f, int id1, int id2 = -1);
 	void CreateEndpEvent(int is_orig);
 
@@ -35,6 +37,11 @@ protected:
 	double stp_resume_time;
 	SteppingStoneManager* stp_manager;
 
+	// Where the manager's time index has the endpoint; stp_bucket is
+	// -1 if it's not in there.
+	int64 stp_bucket;
+	uint32 stp_pos;
+
 	// Hashes for inbound/outbound endpoints that are correlated
 	// at least once with this endpoint.  They are necessary for
 	// removing correlated endpoint pairs in Bro, since there is
@@ -71,19 +78,67 @@ protected:
 	SteppingStoneEndpoint* resp_endp;
 };
 
-// Manages ids for the possible stepping stone connections.
+// Manages ids for the possible stepping stone connections, and indexes
+// the endpoints that resumed sending within the last stp_delta by the
+// time they did so.
+//
+// The index is a ring of buckets, each covering a fixed share of
+// stp_delta, so that the endpoints falling out of the window go in bulk
+// with their bucket. Each endpoint is in there once, at its latest
+// resumption.
 class SteppingStoneManager {
 public:
-	SteppingStoneManager()		{ endp_cnt = 0; }
-
-	PQueue(SteppingStoneEndpoint)& OrderedEndpoints()
-		{ return ordered_endps; }
+	SteppingStoneManager();
 
 	// Use postfix ++, since the first ID needs to be even.
 	int NextID()			{ return endp_cnt++; }
 
+	// Takes out the endpoints that resumed before tmin.
+	void Expire(double tmin);
+
+	// Calls f for each endpoint in the index, in the order they
+	// resumed.
+	template<typename F>
+	void ForEach(F f) const
+		{
+		for ( int64 k = oldest; k <= newest; ++k )
+			{
+			const std::vector<SteppingStoneEndpoint*>& b = Bucket(k);
+
+			for ( size_t i = 0; i < b.size(); ++i )
+				if ( b[i] )
+					f(b[i]);
+			}
+		}
+
+	// Adds the endpoint as having resumed at time t, moving it if it's
+	// in the index already. Time must not go backwards.
+	void Insert(SteppingStoneEndpoint* e, double t);
+
+	int Size() const		{ return num_endps; }
+
 protected:
-	PQueue(SteppingStoneEndpoint) ordered_endps;
+	int64 BucketOf(double t) const
+		{ return width > 0 ? int64(t / width) : 0; }
+
+	std::vector<SteppingStoneEndpoint*>& Bucket(int64 k)
+		{ return buckets[k % buckets.size()]; }
+	const std::vector<SteppingStoneEndpoint*>& Bucket(int64 k) const
+		{ return buckets[k % buckets.size()]; }
+
+	// Takes the endpoint out of the index, dropping the index's
+	// reference to it.
+	void Remove(SteppingStoneEndpoint* e);
+
+	// Removes the oldest endpoint if there's one.
+	void RemoveOldest();
+
+	std::vector<std::vector<SteppingStoneEndpoint*> > buckets;
+	double width;	// time covered by each bucket
+	int64 oldest;	// number of the oldest bucket in use
+	int64 newest;	// number of the newest bucket in use
+	int num_endps;
+	int max_endps;	// 0 for no limit
 	int endp_cnt;
 };
 
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <climits>
 
 #include "ContentLine.h"
 #include "analyzer/protocol/tcp/TCP.h"
@@ -105,9 +106,14 @@ void ContentLine_Analyzer::DeliverStream(int len, const u_char* data,
 		buf = tmp;
 		}
 
+	uint64_t end_seq = seq + len;
+
 	DoDeliver(len, data);
 
-	seq += len;
+	// Our own DoDeliver() keeps seq current as it goes, those of
+	// derived classes don't. Skipping can take it past this chunk.
+	if ( seq < end_seq )
+		seq = end_seq;
 	}
 
 void ContentLine_Analyzer::Undelivered(uint64 seq, int len, bool orig)
@@ -155,6 +161,52 @@ void ContentLine_Analyzer::DoDeliver(int len, const u_char* data)
 			last_char = *data;
 			--len; ++data; ++seq;
 			++seq_delivered_in_lines;
+
+			if ( len == 0 )
+				break;
+			}
+
+		if ( skip_pending > 0 )
+			SkipBytes(skip_pending);
+
+		// Note that the skipping must take place *after*
+		// the CR/LF check above, so that the '\n' of the
+		// previous line is skipped first. It comes before plain
+		// delivery, as a body getting skipped is usually also to
+		// be delivered plain.
+		if ( seq < seq_to_skip )
+			{
+			int64_t skip_len = seq_to_skip - seq;
+			int consumed = min(skip_len, (int64_t)len);
+
+			if ( skip_len > len )
+				{
+				// Have the reassembler drop what lies beyond this
+				// chunk right away rather than buffering it for us.
+				// Those bytes never reach us, so they count as
+				// skipped right away.
+				int64_t beyond = min(skip_len, (int64_t)INT_MAX) - len;
+				TCP_ApplicationAnalyzer* parent =
+					static_cast<TCP_ApplicationAnalyzer*>(Parent());
+
+				if ( ! parent->SkipStream(IsOrig(), beyond) )
+					skip_len = len;
+				else
+					skip_len = len + beyond;
+				}
+
+			// Move past the range before reporting it, so that
+			// what gets skipped next on account of it starts at
+			// its end.
+			uint64_t skip_seq = seq;
+			seq += skip_len;
+			seq_delivered_in_lines = seq;
+
+			ForwardUndelivered(skip_seq, skip_len, IsOrig());
+
+			len -= consumed;
+			data += consumed;
+			continue;
 			}
 
 		if ( plain_delivery_length > 0 )
@@ -171,32 +223,14 @@ void ContentLine_Analyzer::DoDeliver(int len, const u_char* data)
 
 			data += deliver_plain;
 			len -= deliver_plain;
-			if ( len == 0 )
-				return;
-			}
-
-		if ( skip_pending > 0 )
-			SkipBytes(skip_pending);
+			seq += deliver_plain;
+			seq_delivered_in_lines = seq;
 
-		// Note that the skipping must take place *after*
-		// the CR/LF check above, so that the '\n' of the
-		// previous line is skipped first.
-		if ( seq < seq_to_skip )
-			{
-			// Skip rest of the data and return
-			int64_t skip_len = seq_to_skip - seq;
-			if ( skip_len > len )
-				skip_len = len;
-
-			ForwardUndelivered(seq, skip_len, IsOrig());
-
-			len -= skip_len; data += skip_len; seq += skip_len;
-			seq_delivered_in_lines += skip_len;
+			// What got delivered may ask for skipping what
+			// follows.
+			continue;
 			}
 
-		if ( len <= 0 )
-			break;
-
 		int n = DoDeliverOnce(len, data);
 		len -= n;
 		data += n;
@@ -204,6 +238,34 @@ void ContentLine_Analyzer::DoDeliver(int len, const u_char* data)
 		}
 	}
 
+// True if any byte of the word is zero.
+#define HAS_ZERO_BYTE(w) \
+	(((w) - 0x0101010101010101ULL) & ~(w) & 0x8080808080808080ULL)
+
+// Returns the length of the initial run of bytes that don't need any
+// special treatment, i.e., anything but CR, LF and NUL.  Checks a word
+// at a time as long as possible.
+static int ordinary_run(const u_char* data, int len)
+	{
+	int n = 0;
+
+	for ( ; n + 8 <= len; n += 8 )
+		{
+		uint64 w;
+		memcpy(&w, data + n, sizeof(w));
+
+		if ( HAS_ZERO_BYTE(w) ||
+		     HAS_ZERO_BYTE(w ^ 0x0d0d0d0d0d0d0d0dULL) ||
+		     HAS_ZERO_BYTE(w ^ 0x0a0a0a0a0a0a0a0aULL) )
+			break;
+		}
+
+	while ( n < len && data[n] && data[n] != '\r' && data[n] != '\n' )
+		++n;
+
+	return n;
+	}
+
 int ContentLine_Analyzer::DoDeliverOnce(int len, const u_char* data)
 	{
 	const u_char* data_start = data;
@@ -213,6 +275,30 @@ int ContentLine_Analyzer::DoDeliverOnce(int len, const u_char* data)
 
 	for ( ; len > 0; --len, ++data )
 		{
+		if ( last_char != '\r' )
+			{
+			// Copy a run of ordinary bytes in one go. We stop
+			// short of max_line_length so that the byte
+			// exceeding it gets handled below.
+			int n = min(ordinary_run(data, len),
+				    max_line_length - offset);
+
+			if ( n > 0 )
+				{
+				while ( offset + n >= buf_len )
+					InitBuffer(buf_len * 2);
+
+				memcpy(buf + offset, data, n);
+				offset += n;
+				data += n;
+				len -= n;
+				last_char = data[-1];
+
+				if ( len == 0 )
+					break;
+				}
+			}
+
 		if ( offset >= buf_len )
 			InitBuffer(buf_len * 2);
 
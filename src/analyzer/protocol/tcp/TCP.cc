@@ -2,6 +2,7 @@
 
 #include <algorithm>
 
+#include "Net.h"
 #include "NetVar.h"
 #include "File.h"
 #include "Event.h"
@@ -228,6 +229,63 @@ void TCP_Analyzer::SetReassembler(TCP_Reassembler* rorig,
 	reassembling = 1;
 	}
 
+bool TCP_Analyzer::SoleStreamConsumer(analyzer::Analyzer* requester,
+					TCP_Endpoint* e)
+	{
+	const analyzer_list& children(GetChildren());
+	LOOP_OVER_CONST_CHILDREN(i)
+		{
+		if ( *i != requester && ! dynamic_cast<pia::PIA*>(*i) )
+			return false;
+		}
+
+	TCP_Reassembler* r = e->contents_processor;
+
+	return ! e->GetContentsFile() && ! (r && r->HasOtherConsumers());
+	}
+
+bool TCP_Analyzer::StopReassembly(analyzer::Analyzer* requester)
+	{
+	if ( ! reassembling )
+		return true;
+
+	TCP_Endpoint* endps[] = { orig, resp };
+
+	for ( auto e : endps )
+		{
+		TCP_Reassembler* r = e->contents_processor;
+
+		if ( ! SoleStreamConsumer(requester, e) ||
+		     (r && r->NumUndeliveredBytes()) )
+			return false;
+		}
+
+	for ( auto e : endps )
+		{
+		if ( e->contents_processor )
+			e->contents_processor->StopDeliveries();
+		}
+
+	DBG_LOG(DBG_ANALYZER, "%s stopped reassembly for %s",
+			this->GetAnalyzerName(), requester->GetAnalyzerName());
+
+	reassembling = 0;
+	return true;
+	}
+
+bool TCP_Analyzer::SkipStream(analyzer::Analyzer* requester, bool is_orig,
+				uint64 len)
+	{
+	TCP_Endpoint* e = is_orig ? orig : resp;
+	TCP_Reassembler* r = e->contents_processor;
+
+	if ( ! reassembling || ! r || ! SoleStreamConsumer(requester, e) )
+		return false;
+
+	r->SkipContents(r->DataSeq() + len);
+	return true;
+	}
+
 const struct tcphdr* TCP_Analyzer::ExtractTCP_Header(const u_char*& data,
 							int& len, int& caplen)
 	{
@@ -260,6 +318,7 @@ bool TCP_Analyzer::ValidateChecksum(const struct tcphdr* tp,
 				TCP_Endpoint* endpoint, int len, int caplen)
 	{
 	if ( ! ignore_checksums && caplen >= len &&
+	     ! (current_pkt && current_pkt->l4_checksum_valid) &&
 	     ! endpoint->ValidChecksum(tp, len) )
 		{
 		Weird("bad_TCP_checksum");
@@ -1240,13 +1299,13 @@ void TCP_Analyzer::FlipRoles()
 
 void TCP_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	{
-	RecordVal *orig_endp_val = conn_val->Lookup("orig")->AsRecordVal();
-	RecordVal *resp_endp_val = conn_val->Lookup("resp")->AsRecordVal();
+	RecordVal *orig_endp_val = conn_val->Lookup(1)->AsRecordVal();
+	RecordVal *resp_endp_val = conn_val->Lookup(2)->AsRecordVal();
 
-	orig_endp_val->Assign(0, val_mgr->GetCount(orig->Size()));
-	orig_endp_val->Assign(1, val_mgr->GetCount(int(orig->state)));
-	resp_endp_val->Assign(0, val_mgr->GetCount(resp->Size()));
-	resp_endp_val->Assign(1, val_mgr->GetCount(int(resp->state)));
+	orig_endp_val->AssignCount(0, orig->Size());
+	orig_endp_val->AssignCount(1, int(orig->state));
+	resp_endp_val->AssignCount(0, resp->Size());
+	resp_endp_val->AssignCount(1, int(resp->state));
 
 	// Call children's UpdateConnVal
 	Analyzer::UpdateConnVal(conn_val);
@@ -1766,6 +1825,18 @@ void TCP_ApplicationAnalyzer::SetEnv(bool /* is_orig */, char* name, char* val)
 	delete [] val;
 	}
 
+bool TCP_ApplicationAnalyzer::SkipStream(bool is_orig, uint64 len)
+	{
+	TCP_Analyzer* tcp = TCP();
+
+	// What we've seen needs to be what the reassembler delivered
+	// for the position to line up.
+	if ( ! tcp || Parent() != tcp )
+		return false;
+
+	return tcp->SkipStream(this, is_orig, len);
+	}
+
 void TCP_ApplicationAnalyzer::EndpointEOF(bool is_orig)
 	{
 	analyzer::SupportAnalyzer* sa = is_orig ? orig_supporters : resp_supporters;
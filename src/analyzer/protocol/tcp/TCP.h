@@ -30,6 +30,21 @@ public:
 
 	void EnableReassembly();
 
+	// Stops reassembling the payload on behalf of a child analyzer
+	// that can do with just the packets from now on, which from then
+	// on get forwarded to all children. Declines, returning false, if
+	// anything else may still need the byte stream: another child
+	// besides PIA, contents getting recorded or passed to tcp_contents,
+	// or data still waiting on a hole in either direction.
+	bool StopReassembly(analyzer::Analyzer* requester);
+
+	// Skips the next len bytes of one direction's payload on behalf of
+	// a child analyzer, following what has been delivered so far. They
+	// don't get buffered, and don't count as a gap. Declines, returning
+	// false, if anything else may still need them, as with
+	// StopReassembly() (though data above a hole doesn't matter here).
+	bool SkipStream(analyzer::Analyzer* requester, bool is_orig, uint64 len);
+
 	// Add a child analyzer that will always get the packets,
 	// independently of whether we do any reassembly.
 	void AddChildPacketAnalyzer(analyzer::Analyzer* a);
@@ -108,6 +123,10 @@ protected:
 
 	void SetPartialStatus(TCP_Flags flags, bool is_orig);
 
+	// True if nothing besides the requester (and PIA) uses the
+	// endpoint's reassembled payload.
+	bool SoleStreamConsumer(analyzer::Analyzer* requester, TCP_Endpoint* e);
+
 	// Update the state machine of the TCPs based on the activity.  This
 	// includes our pseudo-states such as TCP_ENDPOINT_PARTIAL.
 	//
@@ -257,6 +276,14 @@ public:
 	//  delete them when done with them.
 	virtual void SetEnv(bool orig, char* name, char* val);
 
+	// Skips the next len bytes of the given direction, following what
+	// has been delivered so far; during a delivery, that's after the
+	// current chunk. They never get buffered, and don't count as a
+	// gap. Returns false if that's not possible, either because
+	// something else needs the data or if we're not directly fed by
+	// the TCP analyzer, in which case the data arrives as usual.
+	bool SkipStream(bool is_orig, uint64 len);
+
 private:
 	TCP_Analyzer* tcp;
 };
@@ -5,6 +5,7 @@
 #include "TCP_Reassembler.h"
 #include "analyzer/protocol/tcp/TCP.h"
 #include "TCP_Endpoint.h"
+#include "metrics/Manager.h"
 
 #include "events.bif.h"
 
@@ -32,7 +33,10 @@ TCP_Reassembler::TCP_Reassembler(analyzer::Analyzer* arg_dst_analyzer,
 	skip_deliveries = 0;
 	did_EOF = 0;
 	seq_to_skip = 0;
+	skip_contents_seq = 0;
 	in_delivery = false;
+	num_gaps = 0;
+	gap_bytes = 0;
 
 	if ( tcp_max_old_segments )
 		SetMaxOldBlocks(tcp_max_old_segments);
@@ -63,6 +67,7 @@ TCP_Reassembler::~TCP_Reassembler()
 void TCP_Reassembler::Done()
 	{
 	MatchUndelivered(-1, true);
+	ReportStats();
 
 	if ( record_contents_file )
 		{ // Record any undelivered data.
@@ -157,6 +162,85 @@ void TCP_Reassembler::Gap(uint64 seq, uint64 len)
 		dst_analyzer->ForwardUndelivered(seq, len, IsOrig());
 
 	had_gap = true;
+	++num_gaps;
+	gap_bytes += len;
+	}
+
+namespace {
+
+// The reassembly metrics of a service.
+struct ServiceMetrics {
+	metrics::Counter* streams;
+	metrics::Counter* out_of_order;
+	metrics::Counter* old_evicted;
+	metrics::Counter* gaps;
+	metrics::Counter* gap_bytes;
+	metrics::Histogram* peak_buffered;
+};
+
+}
+
+// Returns the first analyzer below a that confirmed its protocol, or nil.
+static analyzer::Analyzer* confirmed_analyzer(analyzer::Analyzer* a)
+	{
+	for ( auto child : a->GetChildren() )
+		{
+		if ( child->ProtocolConfirmed() )
+			return child;
+
+		analyzer::Analyzer* c = confirmed_analyzer(child);
+
+		if ( c )
+			return c;
+		}
+
+	return 0;
+	}
+
+static ServiceMetrics* service_metrics(const std::string& service)
+	{
+	static std::map<std::string, ServiceMetrics> services;
+
+	auto i = services.find(service);
+
+	if ( i != services.end() )
+		return &i->second;
+
+	metrics::Labels l = { { "service", service } };
+	ServiceMetrics m;
+
+	m.streams = metrics_mgr->GetCounter("zeek_tcp_reassembly_streams_total",
+		"TCP byte streams that went through reassembly.", l);
+	m.out_of_order = metrics_mgr->GetCounter("zeek_tcp_reassembly_out_of_order_segments_total",
+		"TCP segments that arrived above a hole.", l);
+	m.old_evicted = metrics_mgr->GetCounter("zeek_tcp_reassembly_old_segments_evicted_total",
+		"Delivered TCP segments dropped from the tcp_max_old_segments history.", l);
+	m.gaps = metrics_mgr->GetCounter("zeek_tcp_reassembly_gaps_total",
+		"Content gaps in TCP byte streams.", l);
+	m.gap_bytes = metrics_mgr->GetCounter("zeek_tcp_reassembly_gap_bytes_total",
+		"Bytes missing from TCP byte streams.", l);
+	m.peak_buffered = metrics_mgr->GetHistogram("zeek_tcp_reassembly_peak_buffered_bytes",
+		"Most bytes a TCP byte stream had buffered at once.",
+		metrics::Histogram::ExponentialBounds(1024, 4, 8), l);
+
+	return &services.insert(std::make_pair(service, m)).first->second;
+	}
+
+void TCP_Reassembler::ReportStats()
+	{
+	if ( ! metrics_mgr )
+		return;
+
+	// Like conn.log's service field.
+	analyzer::Analyzer* a = confirmed_analyzer(tcp_analyzer);
+	ServiceMetrics* m = service_metrics(a ? strtolower(a->GetAnalyzerName()) : "unknown");
+
+	m->streams->Inc();
+	m->out_of_order->Inc(stats.out_of_order);
+	m->old_evicted->Inc(stats.old_evicted);
+	m->gaps->Inc(num_gaps);
+	m->gap_bytes->Inc(gap_bytes);
+	m->peak_buffered->Observe(stats.peak_buffered);
 	}
 
 void TCP_Reassembler::Undelivered(uint64 up_to_seq)
@@ -382,6 +466,11 @@ void TCP_Reassembler::BlockInserted(DataBlock* start_block)
 	for ( DataBlock* b = start_block;
 	      b && b->seq <= last_reassem_seq; b = b->next )
 		{
+		// A skip asked for while delivering takes over from
+		// here, as the next block may lie inside it.
+		if ( skip_contents_seq > last_reassem_seq )
+			break;
+
 		if ( b->seq == last_reassem_seq )
 			{ // New stuff.
 			uint64 len = b->Size();
@@ -395,6 +484,19 @@ void TCP_Reassembler::BlockInserted(DataBlock* start_block)
 			}
 		}
 
+	TrimDelivered();
+
+	if ( skip_contents_seq > last_reassem_seq )
+		DoSkipContents();
+
+	// Note: don't make an EOF check here, because then we'd miss it
+	// for FIN packets that don't carry any payload (and thus
+	// endpoint->DataSent is not called).  Instead, do the check in
+	// TCP_Connection::NextPacket.
+	}
+
+void TCP_Reassembler::TrimDelivered()
+	{
 	TCP_Endpoint* e = endp;
 
 	if ( ! e->peer->HasContents() )
@@ -411,11 +513,42 @@ void TCP_Reassembler::BlockInserted(DataBlock* start_block)
 		// don't hang onto the data further, as we may wind up
 		// carrying it all the way until this connection ends.
 		TrimToSeq(last_reassem_seq);
+	}
 
-	// Note: don't make an EOF check here, because then we'd miss it
-	// for FIN packets that don't carry any payload (and thus
-	// endpoint->DataSent is not called).  Instead, do the check in
-	// TCP_Connection::NextPacket.
+bool TCP_Reassembler::DeliverDirect(uint64 seq, int len, const u_char* data)
+	{
+	if ( ! tcp_direct_delivery || blocks || old_blocks )
+		return false;
+
+	// All of these need a copy of the delivered data.
+	if ( rexmit_inconsistency || max_old_blocks || record_contents_file )
+		return false;
+
+	if ( len <= 0 || seq > last_reassem_seq )
+		// Nothing to do, or a hole that needs buffering.
+		return false;
+
+	uint64 upper_seq = seq + len;
+
+	if ( upper_seq <= last_reassem_seq )
+		// Already delivered.
+		return true;
+
+	// Skip what we've already delivered.  Without buffered blocks
+	// there's nothing to split this off from otherwise.
+	uint64 amount_old = last_reassem_seq - seq;
+	data += amount_old;
+	seq += amount_old;
+	len -= amount_old;
+
+	last_reassem_seq += len;
+	DeliverBlock(seq, len, data);
+	TrimDelivered();
+
+	if ( skip_contents_seq > last_reassem_seq )
+		DoSkipContents();
+
+	return true;
 	}
 
 void TCP_Reassembler::Overlap(const u_char* b1, const u_char* b2, uint64 n)
@@ -482,7 +615,10 @@ int TCP_Reassembler::DataSent(double t, uint64 seq, int len,
 		}
 
 	flags = arg_flags;
-	NewBlock(t, seq, len, data);
+
+	if ( ! DeliverDirect(seq, len, data) )
+		NewBlock(t, seq, len, data);
+
 	flags = TCP_Flags();
 
 	if ( Endpoint()->NoDataAcked() && tcp_max_above_hole_without_any_acks &&
@@ -625,6 +761,51 @@ void TCP_Reassembler::SkipToSeq(uint64 seq)
 		}
 	}
 
+void TCP_Reassembler::SkipContents(uint64 up_to_seq)
+	{
+	if ( up_to_seq <= skip_contents_seq )
+		return;
+
+	skip_contents_seq = up_to_seq;
+
+	// While delivering, the block loops still need the current
+	// state; they come back here when done.
+	if ( ! in_delivery )
+		DoSkipContents();
+	}
+
+void TCP_Reassembler::DoSkipContents()
+	{
+	while ( ! skip_deliveries )
+		{
+		if ( skip_contents_seq > last_reassem_seq )
+			{
+			// Since it all counts as delivered now, trimming
+			// doesn't report anything missing.
+			last_reassem_seq = skip_contents_seq;
+			TrimToSeq(last_reassem_seq);
+			}
+
+		// Deliver what's buffered in order from here. The first
+		// block can straddle the end of the range, if it was
+		// waiting above a hole. Delivering may ask for another
+		// skip, and may trim blocks, so start over each time.
+		DataBlock* b = blocks;
+
+		while ( b && b->upper <= last_reassem_seq )
+			b = b->next;
+
+		if ( ! b || b->seq > last_reassem_seq )
+			break;
+
+		uint64 seq = last_reassem_seq;
+		last_reassem_seq = b->upper;
+		DeliverBlock(seq, b->upper - seq, b->block + (seq - b->seq));
+		}
+
+	TrimDelivered();
+	}
+
 int TCP_Reassembler::DataPending() const
 	{
 	// If we are skipping deliveries, the reassembler will not get called
@@ -61,6 +61,12 @@ public:
 	// Can be used to skip HTTP data for performance considerations.
 	void SkipToSeq(uint64 seq);
 
+	// Treats everything up to up_to_seq as delivered, for when nothing
+	// downstream has a use for it: it doesn't get buffered or passed
+	// on, and unlike with SkipToSeq() doesn't count as a gap either.
+	// If called during a delivery, takes effect once that returns.
+	void SkipContents(uint64 up_to_seq);
+
 	int DataSent(double t, uint64 seq, int len, const u_char* data,
 		     analyzer::tcp::TCP_Flags flags, bool replaying=true);
 	void AckReceived(uint64 seq);
@@ -86,17 +92,40 @@ public:
 	bool IsSkippedContents(uint64 seq, int length) const
 		{ return seq + length <= seq_to_skip; }
 
+	// Stops reassembly for good, discarding what's buffered, as when
+	// giving up on a connection with too much data above a hole.
+	void StopDeliveries()
+		{ ClearBlocks(); ClearOldBlocks(); skip_deliveries = 1; }
+
+	// True if the reassembled data is needed for more than feeding
+	// the destination analyzer.
+	bool HasOtherConsumers() const
+		{ return deliver_tcp_contents || record_contents_file; }
+
 private:
 	TCP_Reassembler()	{ }
 
 	void Undelivered(uint64 up_to_seq) override;
 	void Gap(uint64 seq, uint64 len);
 
+	// Adds the reassembler's statistics to the metrics of the service
+	// the connection turned out to be.
+	void ReportStats();
+
 	void RecordToSeq(uint64 start_seq, uint64 stop_seq, BroFile* f);
 	void RecordBlock(DataBlock* b, BroFile* f);
 	void RecordGap(uint64 start_seq, uint64 upper_seq, BroFile* f);
 
 	void BlockInserted(DataBlock* b) override;
+	void TrimDelivered();
+
+	// Moves past what SkipContents() asked for, then delivers what's
+	// buffered in order from there.
+	void DoSkipContents();
+
+	// Hands in-order data directly to DeliverBlock() without buffering
+	// it, if tcp_direct_delivery allows. Returns true if it did so.
+	bool DeliverDirect(uint64 seq, int len, const u_char* data);
 	void Overlap(const u_char* b1, const u_char* b2, uint64 n) override;
 
 	TCP_Endpoint* endp;
@@ -107,10 +136,14 @@ private:
 	unsigned int skip_deliveries:1;
 
 	uint64 seq_to_skip;
+	uint64 skip_contents_seq;
 
 	bool in_delivery;
 	analyzer::tcp::TCP_Flags flags;
 
+	uint64 num_gaps;
+	uint64 gap_bytes;
+
 	BroFile* record_contents_file;	// file on which to reassemble contents
 
 	Analyzer* dst_analyzer;
@@ -225,7 +225,6 @@ void Teredo_Analyzer::DeliverPacket(int len, const u_char* data, bool orig,
 		Conn()->Event(teredo_bubble, 0, teredo_hdr);
 		}
 
-	EncapsulatingConn ec(Conn(), BifEnum::Tunnel::TEREDO);
-
-	sessions->DoNextInnerPacket(network_time, 0, inner, e, ec);
+	sessions->DoNextInnerPacket(network_time, 0, inner,
+	                            inner_encap.Get(Conn(), BifEnum::Tunnel::TEREDO));
 	}
@@ -4,6 +4,7 @@
 #include "analyzer/Analyzer.h"
 #include "NetVar.h"
 #include "Reporter.h"
+#include "TunnelEncapsulation.h"
 
 namespace analyzer { namespace teredo {
 
@@ -51,6 +52,7 @@ public:
 protected:
 	bool valid_orig;
 	bool valid_resp;
+	InnerEncapsulation inner_encap;
 };
 
 class TeredoEncapsulation {
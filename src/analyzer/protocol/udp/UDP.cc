@@ -62,7 +62,8 @@ void UDP_Analyzer::DeliverPacket(int len, const u_char* data, bool is_orig,
 
 	int chksum = up->uh_sum;
 
-	auto validate_checksum = ! ignore_checksums && caplen >=len;
+	auto validate_checksum = ! ignore_checksums && caplen >=len &&
+	                         ! (current_pkt && current_pkt->l4_checksum_valid);
 	constexpr auto vxlan_len = 8;
 	constexpr auto eth_len = 14;
 
@@ -209,8 +210,8 @@ void UDP_Analyzer::DeliverPacket(int len, const u_char* data, bool is_orig,
 
 void UDP_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	{
-	RecordVal *orig_endp = conn_val->Lookup("orig")->AsRecordVal();
-	RecordVal *resp_endp = conn_val->Lookup("resp")->AsRecordVal();
+	RecordVal *orig_endp = conn_val->Lookup(1)->AsRecordVal();
+	RecordVal *resp_endp = conn_val->Lookup(2)->AsRecordVal();
 
 	UpdateEndpointVal(orig_endp, 1);
 	UpdateEndpointVal(resp_endp, 0);
@@ -224,14 +225,14 @@ void UDP_Analyzer::UpdateEndpointVal(RecordVal* endp, int is_orig)
 	bro_int_t size = is_orig ? request_len : reply_len;
 	if ( size < 0 )
 		{
-		endp->Assign(0, val_mgr->GetCount(0));
-		endp->Assign(1, val_mgr->GetCount(int(UDP_INACTIVE)));
+		endp->AssignCount(0, 0);
+		endp->AssignCount(1, int(UDP_INACTIVE));
 		}
 
 	else
 		{
-		endp->Assign(0, val_mgr->GetCount(size));
-		endp->Assign(1, val_mgr->GetCount(int(UDP_ACTIVE)));
+		endp->AssignCount(0, size);
+		endp->AssignCount(1, int(UDP_ACTIVE));
 		}
 	}
 
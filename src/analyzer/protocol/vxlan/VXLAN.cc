@@ -96,6 +96,6 @@ void VXLAN_Analyzer::DeliverPacket(int len, const u_char* data, bool orig,
 		Conn()->Event(vxlan_packet, 0, inner->BuildPktHdrVal(),
 		              val_mgr->GetCount(vni));
 
-	EncapsulatingConn ec(Conn(), BifEnum::Tunnel::VXLAN);
-	sessions->DoNextInnerPacket(network_time, &pkt, inner, estack, ec);
+	sessions->DoNextInnerPacket(network_time, &pkt, inner,
+	                            inner_encap.Get(Conn(), BifEnum::Tunnel::VXLAN));
 	}
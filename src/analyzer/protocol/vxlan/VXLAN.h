@@ -6,6 +6,7 @@
 #include "analyzer/Analyzer.h"
 #include "NetVar.h"
 #include "Reporter.h"
+#include "TunnelEncapsulation.h"
 
 namespace analyzer { namespace vxlan {
 
@@ -22,6 +23,9 @@ public:
 
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new VXLAN_Analyzer(conn); }
+
+protected:
+	InnerEncapsulation inner_encap;
 };
 
 } } // namespace analyzer::*
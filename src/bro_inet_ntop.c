@@ -70,23 +70,41 @@ bro_inet_ntop(int af, const void * __restrict src, char * __restrict dst,
  * notes:
  *	(1) uses no statics
  *	(2) takes a u_char* not an in_addr as input
+ *	(3) writes the digits itself, as snprintf is slow for this
  * author:
  *	Paul Vixie, 1996.  Modified by Jon Siwek, 2012, to replace strlcpy
  */
 static const char *
 bro_inet_ntop4(const u_char *src, char *dst, socklen_t size)
 {
-	static const char fmt[] = "%u.%u.%u.%u";
 	char tmp[sizeof "255.255.255.255"];
-	int l;
+	char *p = tmp;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		u_int b = src[i];
+
+		if (b >= 100) {
+			*p++ = '0' + b / 100;
+			b %= 100;
+			*p++ = '0' + b / 10;
+			b %= 10;
+		} else if (b >= 10) {
+			*p++ = '0' + b / 10;
+			b %= 10;
+		}
+
+		*p++ = '0' + b;
+		*p++ = '.';
+	}
+
+	*--p = 0;
 
-	l = snprintf(tmp, sizeof(tmp), fmt, src[0], src[1], src[2], src[3]);
-	if (l <= 0 || (socklen_t) l >= size) {
+	if ((socklen_t) (p - tmp) >= size) {
 		errno = ENOSPC;
 		return (NULL);
 	}
-	strncpy(dst, tmp, size - 1);
-	dst[size - 1] = 0;
+	memcpy(dst, tmp, p - tmp + 1);
 	return (dst);
 }
 
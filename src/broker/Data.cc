@@ -205,8 +205,11 @@ struct val_converter {
 		auto tt = type->AsTableType();
 		auto rval = new TableVal(tt);
 
-		for ( auto& item : a )
+		for ( auto& const_item : a )
 			{
+			// The set is discarded once converted, so its elements may
+			// be moved from even though that breaks its ordering.
+			auto& item = const_cast<broker::data&>(const_item);
 			auto expected_index_types = tt->Indices()->Types();
 			broker::vector composite_key;
 			auto indices = caf::get_if<broker::vector>(&item);
@@ -4,6 +4,7 @@
 #include <cstdio>
 #include <cstring>
 #include <unistd.h>
+#include <zlib.h>
 
 #include "Manager.h"
 #include "Data.h"
@@ -19,6 +20,7 @@
 #include "DebugLogger.h"
 #include "iosource/Manager.h"
 #include "SerializationFormat.h"
+#include "Sessions.h"
 
 using namespace std;
 
@@ -83,6 +85,84 @@ struct scoped_reporter_location {
 		}
 };
 
+// Log writes carrying more than one row go out with this message type
+// instead of LogWrite's, but are the same otherwise. Receivers that don't
+// know about it warn about an unknown message, rather than taking the
+// first row and silently dropping the others.
+static const broker::count LOG_WRITE_ROWS_TYPE = 1000;
+
+// Returns the type field of a message, which broker lays out as protocol
+// version, type, and contents. Returns null if the message doesn't have
+// one.
+static broker::count* message_type(broker::data* msg)
+	{
+	auto v = caf::get_if<broker::vector>(msg);
+
+	if ( ! v || v->size() < 2 )
+		return nullptr;
+
+	return caf::get_if<broker::count>(&(*v)[1]);
+	}
+
+// Leads log data compressed with Broker::log_compression_level, followed
+// by the uncompressed size as a 32-bit big-endian integer.  Uncompressed
+// data starts with the number of fields the same way, so it never has
+// this as its first byte.
+static const char LOG_DEFLATE_MAGIC = '\xff';
+
+// Upper bound on what compressed log data may claim to inflate to.
+static const uint32 LOG_INFLATE_MAX = 256 * 1024 * 1024;
+
+// Compresses serialized log data in place, if that makes it smaller.
+static void deflate_log_data(std::string* data, int level)
+	{
+	if ( data->size() > LOG_INFLATE_MAX )
+		return;
+
+	uLongf len = compressBound(data->size());
+	std::string out(5 + len, '\0');
+	uint32 size = data->size();
+
+	out[0] = LOG_DEFLATE_MAGIC;
+	out[1] = size >> 24;
+	out[2] = size >> 16;
+	out[3] = size >> 8;
+	out[4] = size;
+
+	if ( compress2(reinterpret_cast<Bytef*>(&out[5]), &len,
+	               reinterpret_cast<const Bytef*>(data->data()), size,
+	               level) != Z_OK )
+		return;
+
+	if ( 5 + len >= data->size() )
+		return;
+
+	out.resize(5 + len);
+	*data = std::move(out);
+	}
+
+static bool inflate_log_data(const std::string& in, std::string* out)
+	{
+	if ( in.size() < 5 )
+		return false;
+
+	auto p = reinterpret_cast<const u_char*>(in.data());
+	uint32 size = (uint32(p[1]) << 24) | (uint32(p[2]) << 16) |
+	              (uint32(p[3]) << 8) | uint32(p[4]);
+
+	if ( size > LOG_INFLATE_MAX )
+		return false;
+
+	out->resize(size);
+	uLongf len = size;
+
+	if ( uncompress(reinterpret_cast<Bytef*>(&(*out)[0]), &len,
+	                p + 5, in.size() - 5) != Z_OK )
+		return false;
+
+	return len == size;
+	}
+
 #ifdef DEBUG
 static std::string RenderMessage(std::string topic, const broker::data& x)
 	{
@@ -133,9 +213,17 @@ Manager::Manager(bool arg_reading_pcaps)
 	reading_pcaps = arg_reading_pcaps;
 	after_zeek_init = false;
 	peer_count = 0;
+	peers_added = 0;
 	times_processed_without_idle = 0;
 	log_batch_size = 0;
 	log_batch_interval = 0;
+	event_batch_size = 0;
+	event_batch_interval = 0;
+	log_compression_level = 0;
+	max_messages_per_process = 0;
+	max_process_time = 0;
+	last_packets_processed = 0;
+	id_changes_per_snapshot = 0;
 	log_topic_func = nullptr;
 	vector_of_data_type = nullptr;
 	log_id_type = nullptr;
@@ -154,6 +242,15 @@ void Manager::InitPostScript()
 
 	log_batch_size = get_option("Broker::log_batch_size")->AsCount();
 	log_batch_interval = get_option("Broker::log_batch_interval")->AsInterval();
+	log_compression_level = get_option("Broker::log_compression_level")->AsCount();
+
+	if ( log_compression_level > 9 )
+		log_compression_level = 9;
+	event_batch_size = get_option("Broker::event_batch_size")->AsCount();
+	event_batch_interval = get_option("Broker::event_batch_interval")->AsInterval();
+	max_messages_per_process = get_option("Broker::max_messages_per_process")->AsCount();
+	max_process_time = get_option("Broker::max_process_time")->AsInterval();
+	id_changes_per_snapshot = get_option("Broker::id_changes_per_snapshot")->AsCount();
 	default_log_topic_prefix =
 	    get_option("Broker::default_log_topic_prefix")->AsString()->CheckString();
 	log_topic_func = get_option("Broker::log_topic")->AsFunc();
@@ -206,10 +303,12 @@ void Manager::InitPostScript()
 
 	auto cqs = get_option("Broker::congestion_queue_size")->AsCount();
 	bstate = std::make_shared<BrokerState>(std::move(config), cqs);
+	queue_statistics.capacity = cqs;
 	}
 
 void Manager::Terminate()
 	{
+	FlushEventBuffers();
 	FlushLogBuffers();
 
 	vector<string> stores_to_close;
@@ -331,6 +430,7 @@ void Manager::Unpeer(const string& addr, uint16_t port)
 	DBG_LOG(DBG_BROKER, "Stopping to peer with %s:%" PRIu16,
 		addr.c_str(), port);
 
+	FlushEventBuffers();
 	FlushLogBuffers();
 	bstate->endpoint.unpeer_nosync(addr, port);
 	}
@@ -359,11 +459,83 @@ bool Manager::PublishEvent(string topic, std::string name, broker::vector args)
 	DBG_LOG(DBG_BROKER, "Publishing event: %s",
 		RenderEvent(topic, name, args).c_str());
 	broker::zeek::Event ev(std::move(name), std::move(args));
-	bstate->endpoint.publish(move(topic), ev.move_data());
-	++statistics.num_events_outgoing;
+	++topic_statistics[topic].messages_out;
+
+	if ( event_batch_size <= 1 )
+		{
+		bstate->endpoint.publish(move(topic), ev.move_data());
+		++statistics.num_events_outgoing;
+		return true;
+		}
+
+	auto& eb = event_buffers[topic];
+
+	if ( eb.events.empty() )
+		eb.first = network_time;
+
+	eb.events.emplace_back(ev.move_data());
+
+	if ( eb.events.size() >= event_batch_size )
+		statistics.num_events_outgoing += eb.Flush(bstate->endpoint, topic);
+
 	return true;
 	}
 
+size_t Manager::EventBuffer::Flush(broker::endpoint& endpoint, const std::string& topic)
+	{
+	if ( endpoint.is_shutdown() )
+		return 0;
+
+	auto rval = events.size();
+
+	if ( rval == 1 )
+		endpoint.publish(topic, std::move(events[0]));
+
+	else if ( rval > 1 )
+		{
+		broker::zeek::Batch msg(std::move(events));
+		endpoint.publish(topic, msg.move_data());
+		}
+
+	events = broker::vector{};
+	return rval;
+	}
+
+size_t Manager::FlushEventBuffers(bool force)
+	{
+	if ( event_buffers.empty() )
+		return 0;
+
+	auto rval = 0u;
+
+	for ( auto& kv : event_buffers )
+		{
+		auto& eb = kv.second;
+
+		if ( eb.events.empty() )
+			continue;
+
+		if ( force || network_time - eb.first >= event_batch_interval )
+			rval += eb.Flush(bstate->endpoint, kv.first);
+		}
+
+	statistics.num_events_outgoing += rval;
+	return rval;
+	}
+
+void Manager::GetBufferedSizes(size_t* log_bytes, size_t* events) const
+	{
+	*log_bytes = 0;
+	*events = 0;
+
+	for ( const auto& lb : log_buffers )
+		for ( const auto& kv : lb.writes )
+			*log_bytes += kv.second->fmt.BytesWritten();
+
+	for ( const auto& kv : event_buffers )
+		*events += kv.second.events.size();
+	}
+
 bool Manager::PublishEvent(string topic, RecordVal* args)
 	{
 	if ( bstate->endpoint.is_shutdown() )
@@ -390,12 +562,35 @@ bool Manager::PublishEvent(string topic, RecordVal* args)
 	return PublishEvent(topic, event_name, std::move(xs));
 	}
 
+bool Manager::PublishEvent(std::string topic, val_list* args, Frame* frame)
+	{
+	// Converts the arguments right into what goes out, rather than
+	// through a Broker::Event record that would then need copying.
+	std::string name;
+	broker::vector xs;
+
+	double start = current_time(true);
+	bool ok = MakeEventArgs(args, frame, &name, &xs);
+	AddEncodeTime(current_time(true) - start);
+
+	if ( ! ok )
+		return false;
+
+	return PublishEvent(std::move(topic), std::move(name), std::move(xs));
+	}
+
 bool Manager::PublishIdentifier(std::string topic, std::string id)
+	{
+	std::vector<std::string> topics{std::move(topic)};
+	return PublishIdentifier(std::move(topics), std::move(id));
+	}
+
+bool Manager::PublishIdentifier(std::vector<std::string> topics, std::string id)
 	{
 	if ( bstate->endpoint.is_shutdown() )
 		return true;
 
-	if ( peer_count == 0 )
+	if ( peer_count == 0 || topics.empty() )
 		return true;
 
 	ID* i = global_scope()->Lookup(id.c_str());
@@ -410,7 +605,9 @@ bool Manager::PublishIdentifier(std::string topic, std::string id)
 		// receiving side, but not sure what use that would be.
 		return false;
 
+	double start = current_time(true);
 	auto data = val_to_data(val);
+	AddEncodeTime(current_time(true) - start);
 
 	if ( ! data )
 		{
@@ -419,9 +616,179 @@ bool Manager::PublishIdentifier(std::string topic, std::string id)
 		return false;
 		}
 
+	// Events published before must not arrive after the update.
+	FlushEventBuffers();
+
 	broker::zeek::IdentifierUpdate msg(move(id), move(*data));
+	auto msg_data = msg.move_data();
+
+	// The value only gets converted once, however many topics it goes
+	// to; the last one gets the original.
+	for ( size_t j = 0; j < topics.size(); ++j )
+		{
+		auto& topic = topics[j];
+		DBG_LOG(DBG_BROKER, "Publishing id-update: %s",
+		        RenderMessage(topic, msg_data).c_str());
+		++topic_statistics[topic].messages_out;
+
+		if ( j + 1 < topics.size() )
+			bstate->endpoint.publish(move(topic), msg_data);
+		else
+			bstate->endpoint.publish(move(topic), std::move(msg_data));
+
+		++statistics.num_ids_outgoing;
+		}
+
+	return true;
+	}
+
+// The set type for the indices of a table type.
+static SetType* index_set_type(TableType* tt)
+	{
+	TypeList* indices = tt->Indices();
+	::Ref(indices);
+	return new SetType(indices, 0);
+	}
+
+bool Manager::PublishIdentifierChanges(std::string topic, std::string id)
+	{
+	if ( bstate->endpoint.is_shutdown() )
+		return true;
+
+	ID* i = global_scope()->Lookup(id.c_str());
+
+	if ( ! i )
+		return false;
+
+	auto val = i->ID_Val();
+
+	if ( ! val || val->Type()->Tag() != TYPE_TABLE )
+		{
+		id_changes.erase(id);
+		return PublishIdentifier(move(topic), move(id));
+		}
+
+	auto tv = val->AsTableVal();
+	auto ic = id_changes.find(id);
+	bool ours = ic != id_changes.end() && ic->second.table == tv &&
+	            tv->TrackingChanges();
+
+	if ( peer_count == 0 )
+		{
+		// Nobody to keep up to date. Any future peer gets the whole
+		// table first anyway.
+		if ( ours )
+			tv->TrackChanges(false);
+
+		if ( ic != id_changes.end() )
+			id_changes.erase(ic);
+
+		return true;
+		}
+
+	std::vector<HashKey*> keys;
+	bool snapshot = ! ours || ic->second.peers_added != peers_added ||
+	                ic->second.since_snapshot >= id_changes_per_snapshot;
+
+	if ( ! tv->TakeChanges(&keys) ||
+	     keys.size() >= static_cast<size_t>(tv->Size()) )
+		snapshot = true;
+
+	if ( ! snapshot && keys.empty() )
+		// Nothing changed.
+		return true;
+
+	if ( ic == id_changes.end() )
+		ic = id_changes.emplace(id, IdChanges{tv, 0, 0, 0}).first;
+
+	IdChanges& state = ic->second;
+	state.table = tv;
+	++state.version;
+
+	double start = current_time(true);
+	broker::vector update;
+	update.reserve(4);
+
+	if ( snapshot )
+		{
+		for ( auto k : keys )
+			delete k;
+
+		tv->TrackChanges(true);
+		state.peers_added = peers_added;
+		state.since_snapshot = 0;
+
+		auto data = val_to_data(tv);
+
+		if ( ! data )
+			{
+			id_changes.erase(ic);
+			tv->TrackChanges(false);
+			Error("Failed to publish ID with unsupported type: %s (%s)",
+			      id.c_str(), type_name(tv->Type()->Tag()));
+			return false;
+			}
+
+		update.emplace_back(broker::count(0));
+		update.emplace_back(broker::count(state.version));
+		update.emplace_back(move(*data));
+		}
+	else
+		{
+		++state.since_snapshot;
+
+		// Entries still there go out with their current value, the
+		// others as removed.
+		auto tt = tv->Type()->AsTableType();
+		auto set_type = index_set_type(tt);
+		auto puts = new TableVal(tt);
+		auto erases = new TableVal(set_type);
+		Unref(set_type);
+		auto tbl = tv->AsTable();
+
+		for ( auto k : keys )
+			{
+			auto entry = tbl->Lookup(k);
+			auto index = tv->RecoverIndex(k);
+
+			if ( entry )
+				puts->Assign(index, entry->Value() ? entry->Value()->Ref() : 0);
+			else
+				erases->Assign(index, 0);
+
+			Unref(index);
+			delete k;
+			}
+
+		auto puts_data = val_to_data(puts);
+		auto erases_data = val_to_data(erases);
+		Unref(puts);
+		Unref(erases);
+
+		if ( ! puts_data || ! erases_data )
+			{
+			id_changes.erase(ic);
+			tv->TrackChanges(false);
+			Error("Failed to publish ID with unsupported type: %s (%s)",
+			      id.c_str(), type_name(tv->Type()->Tag()));
+			return false;
+			}
+
+		update.emplace_back(broker::count(1));
+		update.emplace_back(broker::count(state.version));
+		update.emplace_back(move(*puts_data));
+		update.emplace_back(move(*erases_data));
+		}
+
+	AddEncodeTime(current_time(true) - start);
+
+	// Events published before must not arrive after the update.
+	FlushEventBuffers();
+
+	broker::zeek::IdentifierUpdate msg(move(id), move(update));
 	DBG_LOG(DBG_BROKER, "Publishing id-update: %s",
 	        RenderMessage(topic, msg.as_data()).c_str());
+	++topic_statistics[topic].messages_out;
 	bstate->endpoint.publish(move(topic), msg.move_data());
 	++statistics.num_ids_outgoing;
 	return true;
@@ -473,6 +840,7 @@ bool Manager::PublishLogCreate(EnumVal* stream, EnumVal* writer,
 	broker::zeek::LogCreate msg(move(bstream_id), move(bwriter_id), move(writer_info), move(fields_data));
 
 	DBG_LOG(DBG_BROKER, "Publishing log creation: %s", RenderMessage(topic, msg.as_data()).c_str());
+	++topic_statistics[topic].messages_out;
 
 	if ( peer.node != NoPeer.node )
 		// Direct message.
@@ -511,33 +879,6 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path, int
 		return false;
 		}
 
-	BinarySerializationFormat fmt;
-	char* data;
-	int len;
-
-	fmt.StartWrite();
-
-	bool success = fmt.Write(num_fields, "num_fields");
-
-	if ( ! success )
-		{
-		reporter->Error("Failed to remotely log stream %s: num_fields serialization failed", stream_id);
-		return false;
-		}
-
-	for ( int i = 0; i < num_fields; ++i )
-		{
-		if ( ! vals[i]->Write(&fmt) )
-			{
-			reporter->Error("Failed to remotely log stream %s: field %d serialization failed", stream_id, i);
-			return false;
-			}
-		}
-
-	len = fmt.EndWrite(&data);
-	std::string serial_data(data, len);
-	free(data);
-
 	val_list vl{
 		stream->Ref(),
 		new StringVal(path),
@@ -556,29 +897,65 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path, int
 	std::string topic = v->AsString()->CheckString();
 	Unref(v);
 
-	auto bstream_id = broker::enum_value(move(stream_id));
-	auto bwriter_id = broker::enum_value(move(writer_id));
-	broker::zeek::LogWrite msg(move(bstream_id), move(bwriter_id), move(path),
-	                          move(serial_data));
-
-	DBG_LOG(DBG_BROKER, "Buffering log record: %s", RenderMessage(topic, msg.as_data()).c_str());
-
 	if ( log_buffers.size() <= (unsigned int)stream_id_num )
 		log_buffers.resize(stream_id_num + 1);
 
 	auto& lb = log_buffers[stream_id_num];
+
+	std::string key = topic + '\0' + writer_id + '\0' + path;
+	auto& pending = lb.writes[key];
+
+	if ( ! pending )
+		{
+		pending.reset(new PendingLogWrite);
+		pending->topic = topic;
+		pending->stream_id = broker::enum_value(stream_id);
+		pending->writer_id = broker::enum_value(writer_id);
+		pending->path = path;
+		pending->num_rows = 0;
+		pending->fmt.StartWrite();
+
+		if ( ! pending->fmt.Write(num_fields, "num_fields") )
+			{
+			reporter->Error("Failed to remotely log stream %s: num_fields serialization failed", stream_id);
+			lb.writes.erase(key);
+			return false;
+			}
+		}
+
+	double start = current_time(true);
+
+	for ( int i = 0; i < num_fields; ++i )
+		{
+		if ( ! vals[i]->Write(&pending->fmt) )
+			{
+			// The partial row leaves the buffer unusable.
+			reporter->Error("Failed to remotely log stream %s: field %d serialization failed", stream_id, i);
+			lb.message_count -= pending->num_rows;
+			lb.writes.erase(key);
+			return false;
+			}
+		}
+
+	AddEncodeTime(current_time(true) - start);
+	++topic_statistics[topic].messages_out;
+
+	DBG_LOG(DBG_BROKER, "Buffering log record for %s at path %s",
+	        topic.c_str(), path.c_str());
+
+	++pending->num_rows;
 	++lb.message_count;
-	auto& pending_batch = lb.msgs[topic];
-	pending_batch.emplace_back(msg.move_data());
 
 	if ( lb.message_count >= log_batch_size ||
 	     (network_time - lb.last_flush >= log_batch_interval ) )
-		statistics.num_logs_outgoing += lb.Flush(bstate->endpoint, log_batch_size);
+		statistics.num_logs_outgoing += lb.Flush(bstate->endpoint, log_batch_size,
+		                                            log_compression_level);
 
 	return true;
 	}
 
-size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_size)
+size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_size,
+                                 int compression_level)
 	{
 	if ( endpoint.is_shutdown() )
 		return 0;
@@ -587,15 +964,37 @@ size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_si
 		// No logs buffered for this stream.
 		return 0;
 
-	for ( auto& kv : msgs )
+	std::unordered_map<std::string, broker::vector> batches;
+
+	for ( auto& kv : writes )
 		{
-		auto& topic = kv.first;
-		auto& pending_batch = kv.second;
-		broker::vector batch;
-		batch.reserve(log_batch_size + 1);
-		pending_batch.swap(batch);
-		broker::zeek::Batch msg(std::move(batch));
-		endpoint.publish(topic, msg.move_data());
+		auto& pending = kv.second;
+
+		char* data;
+		int len = pending->fmt.EndWrite(&data);
+		std::string serial_data(data, len);
+		free(data);
+
+		if ( compression_level > 0 )
+			deflate_log_data(&serial_data, compression_level);
+
+		broker::zeek::LogWrite msg(move(pending->stream_id),
+		                          move(pending->writer_id),
+		                          move(pending->path), move(serial_data));
+		auto data = msg.move_data();
+
+		if ( pending->num_rows > 1 )
+			*message_type(&data) = LOG_WRITE_ROWS_TYPE;
+
+		batches[pending->topic].emplace_back(std::move(data));
+		}
+
+	writes.clear();
+
+	for ( auto& kv : batches )
+		{
+		broker::zeek::Batch msg(std::move(kv.second));
+		endpoint.publish(kv.first, msg.move_data());
 		}
 
 	auto rval = message_count;
@@ -610,7 +1009,8 @@ size_t Manager::FlushLogBuffers()
 	auto rval = 0u;
 
 	for ( auto& lb : log_buffers )
-		rval += lb.Flush(bstate->endpoint, log_batch_interval);
+		rval += lb.Flush(bstate->endpoint, log_batch_interval,
+		                 log_compression_level);
 
 	return rval;
 	}
@@ -694,6 +1094,24 @@ RecordVal* Manager::MakeEvent(val_list* args, Frame* frame)
 	auto rval = new RecordVal(BifType::Record::Broker::Event);
 	auto arg_vec = new VectorVal(vector_of_data_type);
 	rval->Assign(1, arg_vec);
+
+	std::string name;
+	broker::vector xs;
+
+	if ( ! MakeEventArgs(args, frame, &name, &xs) )
+		return rval;
+
+	rval->Assign(0, new StringVal(name));
+
+	for ( auto i = 0u; i < xs.size(); ++i )
+		arg_vec->Assign(i, make_data_val(std::move(xs[i])));
+
+	return rval;
+	}
+
+bool Manager::MakeEventArgs(val_list* args, Frame* frame, std::string* name,
+                            broker::vector* xs)
+	{
 	Func* func = 0;
 	scoped_reporter_location srl{frame};
 
@@ -708,7 +1126,7 @@ RecordVal* Manager::MakeEvent(val_list* args, Frame* frame)
 			if ( arg_val->Type()->Tag() != TYPE_FUNC )
 				{
 				Error("attempt to convert non-event into an event type");
-				return rval;
+				return false;
 				}
 
 			func = arg_val->AsFunc();
@@ -716,7 +1134,7 @@ RecordVal* Manager::MakeEvent(val_list* args, Frame* frame)
 			if ( func->Flavor() != FUNC_FLAVOR_EVENT )
 				{
 				Error("attempt to convert non-event into an event type");
-				return rval;
+				return false;
 				}
 
 			auto num_args = func->FType()->Args()->NumFields();
@@ -725,10 +1143,10 @@ RecordVal* Manager::MakeEvent(val_list* args, Frame* frame)
 				{
 				Error("bad # of arguments: got %d, expect %d",
 				      args->length(), num_args + 1);
-				return rval;
+				return false;
 				}
 
-			rval->Assign(0, new StringVal(func->Name()));
+			xs->reserve(num_args);
 			continue;
 			}
 
@@ -737,36 +1155,43 @@ RecordVal* Manager::MakeEvent(val_list* args, Frame* frame)
 
 		if ( ! same_type(got_type, expected_type) )
 			{
-			rval->Assign(0, 0);
 			Error("event parameter #%d type mismatch, got %s, expect %s", i,
 			      type_name(got_type->Tag()),
 			      type_name(expected_type->Tag()));
-			return rval;
+			return false;
 			}
 
-		RecordVal* data_val;
-
 		if ( same_type(got_type, bro_broker::DataVal::ScriptDataType()) )
 			{
-			data_val = (*args)[i]->AsRecordVal();
-			Ref(data_val);
+			auto data_val = (*args)[i]->AsRecordVal()->Lookup(0);
+
+			if ( data_val )
+				{
+				xs->emplace_back(static_cast<DataVal*>(data_val)->data);
+				continue;
+				}
 			}
 		else
-			data_val = make_data_val((*args)[i]);
-
-		if ( ! data_val->Lookup(0) )
 			{
-			Unref(data_val);
-			rval->Assign(0, 0);
-			Error("failed to convert param #%d of type %s to broker data",
-				  i, type_name(got_type->Tag()));
-			return rval;
+			auto data = val_to_data((*args)[i]);
+
+			if ( data )
+				{
+				xs->emplace_back(std::move(*data));
+				continue;
+				}
 			}
 
-		arg_vec->Assign(i - 1, data_val);
+		Error("failed to convert param #%d of type %s to broker data",
+		      i, type_name(got_type->Tag()));
+		return false;
 		}
 
-	return rval;
+	if ( ! func )
+		return false;
+
+	*name = func->Name();
+	return true;
 	}
 
 bool Manager::Subscribe(const string& topic_prefix)
@@ -832,6 +1257,15 @@ double Manager::NextTimestamp(double* local_network_time)
 
 void Manager::DispatchMessage(const broker::topic& topic, broker::data msg)
 	{
+	auto type = message_type(&msg);
+
+	if ( type && *type == LOG_WRITE_ROWS_TYPE )
+		{
+		*type = static_cast<broker::count>(broker::zeek::Message::Type::LogWrite);
+		ProcessLogWrite(std::move(msg), true);
+		return;
+		}
+
 	switch ( broker::zeek::Message::type(msg) ) {
 	case broker::zeek::Message::Type::Invalid:
 		reporter->Warning("received invalid broker message: %s",
@@ -847,7 +1281,7 @@ void Manager::DispatchMessage(const broker::topic& topic, broker::data msg)
 		break;
 
 	case broker::zeek::Message::Type::LogWrite:
-		ProcessLogWrite(std::move(msg));
+		ProcessLogWrite(std::move(msg), false);
 		break;
 
 	case broker::zeek::Message::Type::IdentifierUpdate:
@@ -905,26 +1339,94 @@ void Manager::Process()
 		reporter->InternalWarning("ignoring status_subscriber message with unexpected type");
 		}
 
-	auto messages = bstate->subscriber.poll();
+	auto& qs = queue_statistics;
+	qs.depth = bstate->subscriber.available();
+
+	if ( qs.depth > qs.max_depth )
+		qs.max_depth = qs.depth;
+
+	// While packets keep arriving, incoming messages only get a limited
+	// share of the main loop, if so configured. Otherwise everything
+	// that's waiting gets processed.
+	size_t limit = 0;
+	double deadline = 0;
+	auto packets = sessions ? sessions->NumPacketsProcessed() : 0;
 
-	for ( auto& message : messages )
+	if ( packets != last_packets_processed )
 		{
-		had_input = true;
+		limit = max_messages_per_process;
+
+		if ( max_process_time > 0 )
+			deadline = current_time(true) + max_process_time;
+		}
 
-		auto& topic = broker::get_topic(message);
-		auto& msg = broker::get_data(message);
+	last_packets_processed = packets;
 
-		try
+	double start = 0;
+	size_t processed = 0;
+	size_t available = qs.depth;
+
+	while ( available )
+		{
+		auto n = available;
+
+		if ( limit && n > limit - processed )
+			n = limit - processed;
+
+		// Check the clock every few messages.
+		if ( deadline && n > 16 )
+			n = 16;
+
+		auto messages = n == available ? bstate->subscriber.poll() :
+		                                 bstate->subscriber.get(n);
+
+		if ( messages.empty() )
+			break;
+
+		if ( ! start )
+			start = current_time(true);
+
+		had_input = true;
+		processed += messages.size();
+
+		for ( auto& message : messages )
 			{
-			DispatchMessage(topic, std::move(msg));
+			auto& topic = broker::get_topic(message);
+			auto& msg = broker::get_data(message);
+			++topic_statistics[topic.string()].messages_in;
+
+			try
+				{
+				DispatchMessage(topic, std::move(msg));
+				}
+			catch ( std::runtime_error& e )
+				{
+				reporter->Warning("ignoring invalid Broker message: %s", + e.what());
+				++qs.num_dropped;
+				continue;
+				}
 			}
-		catch ( std::runtime_error& e )
+
+		if ( ! limit && ! deadline )
+			break;
+
+		available = bstate->subscriber.available();
+
+		if ( (limit && processed >= limit) ||
+		     (deadline && current_time(true) >= deadline) )
 			{
-			reporter->Warning("ignoring invalid Broker message: %s", + e.what());
-			continue;
+			// Left for the next round.
+			qs.deferred += available;
+			break;
 			}
 		}
 
+	if ( processed )
+		{
+		qs.decode_time += current_time(true) - start;
+		qs.processed += processed;
+		}
+
 	for ( auto& s : data_stores )
 		{
 		auto num_available = s.second->proxy.mailbox().size();
@@ -952,7 +1454,16 @@ void Manager::Process()
 		// fit several Process loops in before the next poll event (e.g. the
 		// select() call ), but still large enough such that we don't have to
 		// wait long before the next poll ourselves after being forced to idle.
-		if ( times_processed_without_idle > 12 )
+		//
+		// While the queue of incoming messages fills up faster than we
+		// get to it, that would only let it reach the congestion limit
+		// and throttle our peers, so we keep going instead.
+		if ( bstate->subscriber.available() > qs.capacity / 2 )
+			{
+			times_processed_without_idle = 0;
+			SetIdle(false);
+			}
+		else if ( times_processed_without_idle > 12 )
 			{
 			times_processed_without_idle = 0;
 			SetIdle(true);
@@ -1114,7 +1625,7 @@ bool bro_broker::Manager::ProcessLogCreate(broker::zeek::LogCreate lc)
 	return true;
 	}
 
-bool bro_broker::Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
+bool bro_broker::Manager::ProcessLogWrite(broker::zeek::LogWrite lw, bool many_rows)
 	{
 	DBG_LOG(DBG_BROKER, "Received log-write: %s", RenderMessage(lw.as_data()).c_str());
 
@@ -1125,7 +1636,6 @@ bool bro_broker::Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
 		return false;
 		}
 
-	++statistics.num_logs_incoming;
 	auto& stream_id_name = lw.stream_id().name;
 
 	// Get stream ID.
@@ -1165,6 +1675,19 @@ bool bro_broker::Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
 		return false;
 		}
 
+	std::string inflated;
+
+	if ( ! serial_data->empty() && (*serial_data)[0] == LOG_DEFLATE_MAGIC )
+		{
+		if ( ! inflate_log_data(*serial_data, &inflated) )
+			{
+			reporter->Warning("failed to decompress remote log values for stream: %s", stream_id_name.data());
+			return false;
+			}
+
+		serial_data = &inflated;
+		}
+
 	BinarySerializationFormat fmt;
 	fmt.StartRead(serial_data->data(), serial_data->size());
 
@@ -1177,26 +1700,34 @@ bool bro_broker::Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
 		return false;
 		}
 
-	auto vals = new threading::Value* [num_fields];
-
-	for ( int i = 0; i < num_fields; ++i )
+	// A multi-row message carries as many rows as there's data.
+	do
 		{
-		vals[i] = new threading::Value;
+		auto vals = new threading::Value* [num_fields];
 
-		if ( ! vals[i]->Read(&fmt) )
+		for ( int i = 0; i < num_fields; ++i )
 			{
-			for ( int j = 0; j <=i; ++j )
-				delete vals[j];
+			vals[i] = new threading::Value;
 
-			delete [] vals;
-			reporter->Warning("failed to unserialize remote log field %d for stream: %s", i, stream_id_name.data());
+			if ( ! vals[i]->Read(&fmt) )
+				{
+				for ( int j = 0; j <=i; ++j )
+					delete vals[j];
 
-			return false;
+				delete [] vals;
+				reporter->Warning("failed to unserialize remote log field %d for stream: %s", i, stream_id_name.data());
+
+				return false;
+				}
 			}
+
+		++statistics.num_logs_incoming;
+		log_mgr->WriteFromRemote(stream_id->AsEnumVal(), writer_id->AsEnumVal(),
+		                         *path, num_fields, vals);
 		}
+	while ( many_rows && num_fields > 0 &&
+	        size_t(fmt.BytesRead()) < serial_data->size() );
 
-	log_mgr->WriteFromRemote(stream_id->AsEnumVal(), writer_id->AsEnumVal(),
-	                         std::move(*path), num_fields, vals);
 	fmt.EndRead();
 	return true;
 	}
@@ -1224,6 +1755,11 @@ bool Manager::ProcessIdentifierUpdate(broker::zeek::IdentifierUpdate iu)
 		return false;
 		}
 
+	// Tables never convert into vectors, except when sent through
+	// PublishIdentifierChanges().
+	if ( id->Type()->Tag() == TYPE_TABLE && caf::get_if<broker::vector>(&id_value) )
+		return ProcessIdentifierChanges(id, std::move(caf::get<broker::vector>(id_value)));
+
 	auto val = data_to_val(std::move(id_value), id->Type());
 
 	if ( ! val )
@@ -1233,10 +1769,106 @@ bool Manager::ProcessIdentifierUpdate(broker::zeek::IdentifierUpdate iu)
 		return false;
 		}
 
+	id_versions.erase(id_name);
 	id->SetVal(val);
 	return true;
 	}
 
+bool Manager::ProcessIdentifierChanges(ID* id, broker::vector update)
+	{
+	broker::count* kind = nullptr;
+	broker::count* version = nullptr;
+
+	if ( update.size() >= 3 )
+		{
+		kind = caf::get_if<broker::count>(&update[0]);
+		version = caf::get_if<broker::count>(&update[1]);
+		}
+
+	if ( ! kind || ! version || *kind > 1 || update.size() != 3 + *kind )
+		{
+		reporter->Warning("received invalid changes for id: %s", id->Name());
+		return false;
+		}
+
+	if ( *kind == 0 )
+		{
+		auto val = data_to_val(std::move(update[2]), id->Type());
+
+		if ( ! val )
+			{
+			reporter->Error("Failed to receive ID with unsupported type: %s (%s)",
+			                id->Name(), type_name(id->Type()->Tag()));
+			return false;
+			}
+
+		id->SetVal(val);
+		id_versions[id->Name()] = *version;
+		return true;
+		}
+
+	auto last = id_versions.find(id->Name());
+	auto current = id->ID_Val();
+
+	if ( last == id_versions.end() || last->second + 1 != *version || ! current )
+		{
+		// Missed an update, so these changes don't apply to what we
+		// have. The sender gets everybody in sync again with the next
+		// whole table.
+		DBG_LOG(DBG_BROKER, "Ignoring changes to %s without their base",
+		        id->Name());
+
+		if ( last != id_versions.end() )
+			id_versions.erase(last);
+
+		return false;
+		}
+
+	auto tt = id->Type()->AsTableType();
+	auto set_type = index_set_type(tt);
+	auto puts = data_to_val(std::move(update[2]), tt);
+	auto erases = data_to_val(std::move(update[3]), set_type);
+	Unref(set_type);
+
+	if ( ! puts || ! erases )
+		{
+		reporter->Error("Failed to receive ID with unsupported type: %s (%s)",
+		                id->Name(), type_name(id->Type()->Tag()));
+		Unref(puts);
+		Unref(erases);
+		id_versions.erase(last);
+		return false;
+		}
+
+	auto tv = current->AsTableVal();
+	HashKey* k;
+	IterCookie* c = erases->AsTable()->InitForIteration();
+
+	while ( erases->AsTable()->NextEntry(k, c) )
+		{
+		auto index = erases->AsTableVal()->RecoverIndex(k);
+		Unref(tv->Delete(index));
+		Unref(index);
+		delete k;
+		}
+
+	TableEntryVal* entry;
+	c = puts->AsTable()->InitForIteration();
+
+	while ( (entry = puts->AsTable()->NextEntry(k, c)) )
+		{
+		auto index = puts->AsTableVal()->RecoverIndex(k);
+		tv->Assign(index, entry->Value() ? entry->Value()->Ref() : 0);
+		Unref(index);
+		delete k;
+		}
+
+	Unref(puts);
+	Unref(erases);
+	last->second = *version;
+	return true;
+	}
+
 void Manager::ProcessStatus(broker::status stat)
 	{
 	DBG_LOG(DBG_BROKER, "Received status message: %s", RenderMessage(stat).c_str());
@@ -1251,6 +1883,7 @@ void Manager::ProcessStatus(broker::status stat)
 
 	case broker::sc::peer_added:
 		++peer_count;
+		++peers_added;
 		assert(ctx);
 		log_mgr->SendAllWritersTo(*ctx);
 		event = Broker::peer_added;
@@ -1403,7 +2036,12 @@ void Manager::ProcessStoreResponse(StoreHandleVal* s, broker::store::response re
 		}
 
 	if ( response.answer )
+		{
+		if ( request->second->Caching() )
+			s->CacheInsert(request->second->CacheKey(), *response.answer);
+
 		request->second->Result(query_result(make_data_val(std::move(*response.answer))));
+		}
 	else if ( response.answer.error() == broker::ec::request_timeout )
 		{
 		// Fine, trigger's timeout takes care of things.
@@ -1484,7 +2122,8 @@ StoreHandleVal* Manager::MakeMaster(const string& name, broker::backend type,
 
 StoreHandleVal* Manager::MakeClone(const string& name, double resync_interval,
                                    double stale_interval,
-                                   double mutation_buffer_interval)
+                                   double mutation_buffer_interval,
+                                   double cache_interval)
 	{
 	if ( bstate->endpoint.is_shutdown() )
 		return nullptr;
@@ -1504,7 +2143,7 @@ StoreHandleVal* Manager::MakeClone(const string& name, double resync_interval,
 		return nullptr;
 		}
 
-	auto handle = new StoreHandleVal{*result};
+	auto handle = new StoreHandleVal{*result, cache_interval};
 	Ref(handle);
 
 	data_stores.emplace(name, handle);
@@ -1560,6 +2199,14 @@ const Stats& Manager::GetStatistics()
 	statistics.num_peers = peer_count;
 	statistics.num_stores = data_stores.size();
 	statistics.num_pending_queries = pending_queries.size();
+	statistics.num_store_cache_hits = 0;
+	statistics.num_store_cache_misses = 0;
+
+	for ( const auto& s : data_stores )
+		{
+		statistics.num_store_cache_hits += s.second->cache_hits;
+		statistics.num_store_cache_misses += s.second->cache_misses;
+		}
 
 	// The other attributes are set as activity happens.
 
@@ -24,6 +24,7 @@
 #include "iosource/IOSource.h"
 #include "Val.h"
 #include "logging/WriterBackend.h"
+#include "SerializationFormat.h"
 
 namespace bro_broker {
 
@@ -51,6 +52,44 @@ struct Stats {
 	size_t num_ids_incoming = 0;
 	// Number of total identifiers sent.
 	size_t num_ids_outgoing = 0;
+	// Number of store lookups answered from clones' read caches.
+	size_t num_store_cache_hits = 0;
+	// Number of store lookups on caching clones that went to the store.
+	size_t num_store_cache_misses = 0;
+};
+
+/**
+ * Statistics about the messages exchanged on one topic.
+ */
+struct TopicStats {
+	// Number of messages received.
+	size_t messages_in = 0;
+	// Number of events, log records and identifiers sent.
+	size_t messages_out = 0;
+};
+
+/**
+ * Statistics about the queue of incoming messages and the cost of
+ * converting messages.
+ */
+struct QueueStats {
+	// Number of messages waiting when the queue was last checked.
+	size_t depth = 0;
+	// Largest number of messages seen waiting.
+	size_t max_depth = 0;
+	// Number of waiting messages beyond which peers get throttled.
+	size_t capacity = 0;
+	// Number of messages processed by the main thread.
+	size_t processed = 0;
+	// Sum of the messages left queued whenever processing stopped at
+	// Broker::max_messages_per_process or Broker::max_process_time.
+	size_t deferred = 0;
+	// Number of received messages ignored for being invalid.
+	size_t num_dropped = 0;
+	// Seconds spent converting script values into messages.
+	double encode_time = 0;
+	// Seconds spent converting received messages into script values.
+	double decode_time = 0;
 };
 
 /**
@@ -142,6 +181,25 @@ public:
 	 */
 	bool PublishIdentifier(std::string topic, std::string id);
 
+	/**
+	 * Send an identifier's value to several topics, converting it only
+	 * once.
+	 * @param topics the topic strings to send the message to.
+	 * @param id the name of the identifier to send.
+	 * @return true if the messages are sent successfully.
+	 */
+	bool PublishIdentifier(std::vector<std::string> topics, std::string id);
+
+	/**
+	 * Send the changes to a table identifier since the previous call,
+	 * or its whole value if peers may lack earlier changes. Values
+	 * that aren't tables go out whole.
+	 * @param topic a topic string associated with the message.
+	 * @param id the name of the identifier to send.
+	 * @return true if the message is sent successfully.
+	 */
+	bool PublishIdentifierChanges(std::string topic, std::string id);
+
 	/**
 	 * Send an event to any interested peers.
 	 * @param topic a topic string associated with the message.
@@ -164,6 +222,17 @@ public:
 	 */
 	bool PublishEvent(std::string topic, RecordVal* ev);
 
+	/**
+	 * Send an event to any interested peers.
+	 * @param topic a topic string associated with the message.
+	 * Peers advertise interest by registering a subscription to some prefix
+	 * of this topic name.
+	 * @param args the event and its arguments, as for MakeEvent().
+	 * @param frame the calling frame, used to report location info upon error
+	 * @return true if the message is sent successfully.
+	 */
+	bool PublishEvent(std::string topic, val_list* args, Frame* frame);
+
 	/**
 	 * Send a message to create a log stream to any interested peers.
 	 * The log stream may or may not already exist on the receiving side.
@@ -280,12 +349,16 @@ public:
 	 * that this doesn't completely prevent the loss of store updates: all
 	 * mutation messages are fire-and-forget and not explicitly acknowledged by
 	 * the master.  A negative/zero value indicates to never buffer commands.
+	 * @param cache_interval How long values looked up through the clone's
+	 * handle get served from an in-process cache before asking the clone
+	 * again.  Zero disables the cache.
 	 * @return a pointer to the newly created store a nullptr on failure.
 	 */
 	StoreHandleVal* MakeClone(const std::string& name,
 	                          double resync_interval = 10.0,
 	                          double stale_interval = 300.0,
-	                          double mutation_buffer_interval = 120.0);
+	                          double mutation_buffer_interval = 120.0,
+	                          double cache_interval = 0.0);
 
 	/**
 	 * Lookup a data store by it's identifier name and type.
@@ -316,11 +389,45 @@ public:
 	 */
 	size_t FlushLogBuffers();
 
+	/**
+	 * Send events buffered for batching, see \c Broker::event_batch_size.
+	 * @param force if false, only send the batches whose oldest event has
+	 * waited for \c Broker::event_batch_interval.
+	 * @return the number of events sent.
+	 */
+	size_t FlushEventBuffers(bool force = true);
+
+	/**
+	 * Returns what's buffered for batching and not sent yet.
+	 * @param log_bytes set to the size of the serialized log rows.
+	 * @param events set to the number of events.
+	 */
+	void GetBufferedSizes(size_t* log_bytes, size_t* events) const;
+
 	/**
 	 * @return communication statistics.
 	 */
 	const Stats& GetStatistics();
 
+	/**
+	 * @return message statistics per topic, indexed by topic.
+	 */
+	const std::unordered_map<std::string, TopicStats>& GetTopicStatistics() const
+		{ return topic_statistics; }
+
+	/**
+	 * @return statistics about the queue of incoming messages.
+	 */
+	const QueueStats& GetQueueStatistics() const
+		{ return queue_statistics; }
+
+	/**
+	 * Accounts for time spent converting script values into a message.
+	 * @param secs the time spent.
+	 */
+	void AddEncodeTime(double secs)
+		{ queue_statistics.encode_time += secs; }
+
 	/**
 	 * Creating an instance of this struct simply helps the manager
 	 * keep track of whether calls into its API are coming from script
@@ -333,11 +440,14 @@ public:
 
 private:
 
+	bool MakeEventArgs(val_list* args, Frame* frame, std::string* name,
+	                   broker::vector* xs);
 	void DispatchMessage(const broker::topic& topic, broker::data msg);
 	void ProcessEvent(const broker::topic& topic, broker::zeek::Event ev);
 	bool ProcessLogCreate(broker::zeek::LogCreate lc);
-	bool ProcessLogWrite(broker::zeek::LogWrite lw);
+	bool ProcessLogWrite(broker::zeek::LogWrite lw, bool many_rows);
 	bool ProcessIdentifierUpdate(broker::zeek::IdentifierUpdate iu);
+	bool ProcessIdentifierChanges(ID* id, broker::vector update);
 	void ProcessStatus(broker::status stat);
 	void ProcessError(broker::error err);
 	void ProcessStoreResponse(StoreHandleVal*, broker::store::response response);
@@ -357,13 +467,35 @@ private:
 	const char* Tag() override
 		{ return "Broker::Manager"; }
 
+	// Log rows buffered for one topic, writer and path. They go out as
+	// a single LogWrite message carrying the number of fields once,
+	// followed by the serialized rows back to back. With more than one
+	// row, the message gets a type of its own, see Manager.cc.
+	struct PendingLogWrite {
+		std::string topic;
+		broker::enum_value stream_id;
+		broker::enum_value writer_id;
+		std::string path;
+		BinarySerializationFormat fmt;
+		size_t num_rows;
+	};
+
 	struct LogBuffer {
-		// Indexed by topic string.
-		std::unordered_map<std::string, broker::vector> msgs;
+		// Indexed by topic, writer, and path.
+		std::unordered_map<std::string, std::unique_ptr<PendingLogWrite>> writes;
 		double last_flush;
 		size_t message_count;
 
-		size_t Flush(broker::endpoint& endpoint, size_t batch_size);
+		size_t Flush(broker::endpoint& endpoint, size_t batch_size,
+		             int compression_level);
+	};
+
+	// Events published to one topic and not sent yet.
+	struct EventBuffer {
+		broker::vector events;
+		double first; // Network time the oldest one was published.
+
+		size_t Flush(broker::endpoint& endpoint, const std::string& topic);
 	};
 
 	// Data stores
@@ -380,6 +512,7 @@ private:
 	};
 
 	std::vector<LogBuffer> log_buffers; // Indexed by stream ID enum.
+	std::unordered_map<std::string, EventBuffer> event_buffers; // Indexed by topic.
 	std::string default_log_topic_prefix;
 	std::shared_ptr<BrokerState> bstate;
 	std::unordered_map<std::string, StoreHandleVal*> data_stores;
@@ -387,16 +520,37 @@ private:
 	                   query_id_hasher> pending_queries;
 	std::vector<std::string> forwarded_prefixes;
 
+	// A table identifier published through PublishIdentifierChanges().
+	struct IdChanges {
+		TableVal* table; // Only compared against, not referenced.
+		uint64 version;
+		uint64 peers_added; // Value of peers_added when last sent whole.
+		size_t since_snapshot;
+	};
+
+	std::unordered_map<std::string, IdChanges> id_changes; // Indexed by ID name.
+	std::unordered_map<std::string, uint64> id_versions; // Last received, by ID name.
+
 	Stats statistics;
+	std::unordered_map<std::string, TopicStats> topic_statistics;
+	QueueStats queue_statistics;
 
 	uint16_t bound_port;
 	bool reading_pcaps;
 	bool after_zeek_init;
 	int peer_count;
+	uint64 peers_added;
 	int times_processed_without_idle;
 
 	size_t log_batch_size;
 	double log_batch_interval;
+	size_t event_batch_size;
+	double event_batch_interval;
+	int log_compression_level;
+	size_t max_messages_per_process;
+	double max_process_time;
+	uint64 last_packets_processed;
+	size_t id_changes_per_snapshot;
 	Func* log_topic_func;
 	VectorType* vector_of_data_type;
 	EnumType* log_id_type;
@@ -1,5 +1,8 @@
 #include "Store.h"
 #include "broker/Manager.h"
+#include "Net.h"
+
+#include <algorithm>
 
 namespace bro_broker {
 
@@ -63,6 +66,91 @@ bool StoreHandleVal::DoUnserialize(const broker::data& data)
 	return false;
 	}
 
+const broker::data* StoreHandleVal::CacheLookup(const broker::data& key)
+	{
+	auto i = cache.find(key);
+
+	if ( i == cache.end() )
+		{
+		++cache_misses;
+		return nullptr;
+		}
+
+	if ( i->second.expires <= network_time )
+		{
+		cache.erase(i);
+		++cache_misses;
+		return nullptr;
+		}
+
+	if ( ! i->second.valid )
+		{
+		++cache_misses;
+		return nullptr;
+		}
+
+	++cache_hits;
+	return &i->second.value;
+	}
+
+void StoreHandleVal::CachePrune()
+	{
+	if ( cache.size() < cache_prune_size )
+		return;
+
+	for ( auto i = cache.begin(); i != cache.end(); )
+		{
+		if ( i->second.expires <= network_time )
+			i = cache.erase(i);
+		else
+			++i;
+		}
+
+	cache_prune_size = std::max(cache.size() * 2, size_t(1024));
+	}
+
+void StoreHandleVal::CacheInsert(const broker::data& key, broker::data value)
+	{
+	if ( network_time < cache_blocked_until )
+		return;
+
+	auto i = cache.find(key);
+
+	if ( i != cache.end() && ! i->second.valid &&
+	     i->second.expires > network_time )
+		// Might still be the value from before our own modification.
+		return;
+
+	CachePrune();
+
+	auto& e = cache[key];
+	e.value = std::move(value);
+	e.expires = network_time + cache_interval;
+	e.valid = true;
+	}
+
+void StoreHandleVal::CacheInvalidate(const broker::data& key)
+	{
+	if ( ! Caching() )
+		return;
+
+	CachePrune();
+
+	auto& e = cache[key];
+	e.value = broker::data{};
+	e.expires = network_time + cache_interval;
+	e.valid = false;
+	}
+
+void StoreHandleVal::CacheClear()
+	{
+	if ( ! Caching() )
+		return;
+
+	cache.clear();
+	cache_blocked_until = network_time + cache_interval;
+	}
+
 broker::backend to_backend_type(BifEnum::Broker::BackendType type)
 	{
 	switch ( type ) {
@@ -12,6 +12,8 @@
 #include <broker/backend.hh>
 #include <broker/backend_options.hh>
 
+#include <map>
+
 namespace bro_broker {
 
 extern OpaqueType* opaque_of_store_handle;
@@ -100,11 +102,30 @@ public:
 	const broker::store& Store() const
 		{ return store; }
 
+	/**
+	 * Marks the query as a lookup whose answer may go into the handle's
+	 * read cache.
+	 * @param key the key being looked up.
+	 */
+	void CacheAs(broker::data key)
+		{
+		cache_key = std::move(key);
+		caching = true;
+		}
+
+	bool Caching() const
+		{ return caching; }
+
+	const broker::data& CacheKey() const
+		{ return cache_key; }
+
 private:
 
 	Trigger* trigger;
 	const CallExpr* call;
 	broker::store store;
+	bool caching = false;
+	broker::data cache_key;
 };
 
 /**
@@ -112,18 +133,75 @@ private:
  */
 class StoreHandleVal : public OpaqueVal {
 public:
-	StoreHandleVal(broker::store s)
-		: OpaqueVal(bro_broker::opaque_of_store_handle), store{s}, proxy{store}
+	StoreHandleVal(broker::store s, double arg_cache_interval = 0)
+		: OpaqueVal(bro_broker::opaque_of_store_handle), store{s}, proxy{store},
+		  cache_interval(arg_cache_interval)
 		{ }
 
 	void ValDescribe(ODesc* d) const override;
 
+	/**
+	 * Looks up a key in the handle's read cache.  Counts a hit or a miss.
+	 * @param key the key to look up.
+	 * @return the cached value, or nullptr if there's no entry that's
+	 * younger than the cache interval.
+	 */
+	const broker::data* CacheLookup(const broker::data& key);
+
+	/**
+	 * Remembers the value of a key read from the store.
+	 * @param key the key.
+	 * @param value its value.
+	 */
+	void CacheInsert(const broker::data& key, broker::data value);
+
+	/**
+	 * Drops a key from the read cache because it's being modified
+	 * through this handle.  The key doesn't get cached again for the
+	 * cache interval, as a clone only sees its own modifications once
+	 * the master has sent them back.
+	 * @param key the key.
+	 */
+	void CacheInvalidate(const broker::data& key);
+
+	/**
+	 * Drops all keys from the read cache, and doesn't cache any for the
+	 * cache interval.
+	 */
+	void CacheClear();
+
+	bool Caching() const
+		{ return cache_interval > 0; }
+
 	broker::store store;
 	broker::store::proxy proxy;
 
+	// Number of lookups answered from, or missing, the read cache.
+	uint64 cache_hits = 0;
+	uint64 cache_misses = 0;
+
 protected:
 	StoreHandleVal() = default;
 
+	struct CacheEntry {
+		broker::data value;
+		double expires;
+		// False for keys modified through the handle, which don't
+		// get cached until the entry expires.
+		bool valid;
+	};
+
+	// How long values read through the handle get served from the
+	// cache.  Zero disables caching.
+	double cache_interval = 0;
+	// Nothing gets cached before this time, see CacheClear().
+	double cache_blocked_until = 0;
+	std::map<broker::data, CacheEntry> cache;
+	// Expired entries get dropped once the cache grows beyond this.
+	size_t cache_prune_size = 1024;
+
+	void CachePrune();
+
 	DECLARE_OPAQUE_VALUE(StoreHandleVal)
 };
 
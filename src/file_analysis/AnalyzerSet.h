@@ -101,6 +101,13 @@ public:
 	file_analysis::Analyzer* NextEntry(IterCookie* c)
 		{ return analyzer_map.NextEntry(c); }
 
+	/**
+	 * @return the number of analyzers currently in the set, not counting
+	 *         queued modifications.
+	 */
+	int Size() const
+		{ return analyzer_map.Length(); }
+
 protected:
 
 	/**
@@ -84,6 +84,7 @@ File::File(const string& file_id, const string& source_name, Connection* conn,
            analyzer::Tag tag, bool is_orig)
 	: id(file_id), val(0), file_reassembler(0), stream_offset(0),
 	  reassembly_max_buffer(0), did_metadata_inference(false),
+	  magic_state(0), magic_bytes(0),
 	  reassembly_enabled(false), postpone_timeout(false), done(false),
 	  analyzers(this)
 	{
@@ -109,6 +110,7 @@ File::~File()
 	DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Destroying File object", id.c_str());
 	Unref(val);
 	delete file_reassembler;
+	delete magic_state;
 
 	for ( auto a : done_analyzers )
 		delete a;
@@ -275,6 +277,18 @@ bool File::RemoveAnalyzer(file_analysis::Tag tag, RecordVal* args)
 	return done ? false : analyzers.QueueRemove(tag, args);
 	}
 
+bool File::StopIfOnlyAnalyzer(file_analysis::Analyzer* a)
+	{
+	if ( done || analyzers.Size() > 1 ||
+	     analyzers.Find(a->Tag(), a->Args()) != a )
+		return false;
+
+	DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Stopping, %s is the last analyzer",
+		id.c_str(), file_mgr->GetComponentName(a->Tag()).c_str());
+
+	return file_mgr->IgnoreFile(id);
+	}
+
 void File::EnableReassembly()
 	{
 	reassembly_enabled = true;
@@ -331,10 +345,17 @@ void File::InferMetadata()
 		return;
 
 	RuleMatcher::MIME_Matches matches;
-	const u_char* data = bof_buffer_val->AsString()->Bytes();
-	uint64 len = bof_buffer_val->AsString()->Len();
-	len = min(len, LookupFieldDefaultCount(bof_buffer_size_idx));
-	file_mgr->DetectMIME(data, len, &matches);
+
+	if ( magic_state )
+		// Already matched everything there is.
+		rule_matcher->MIMEMatches(magic_state, &matches);
+	else
+		{
+		const u_char* data = bof_buffer_val->AsString()->Bytes();
+		uint64 len = bof_buffer_val->AsString()->Len();
+		len = min(len, LookupFieldDefaultCount(bof_buffer_size_idx));
+		file_mgr->DetectMIME(data, len, &matches);
+		}
 
 	RecordVal* meta = new RecordVal(fa_metadata_type);
 
@@ -363,6 +384,12 @@ bool File::BufferBOF(const u_char* data, uint64 len)
 	if ( bof_buffer.size < desired_size )
 		return true;
 
+	CompleteBOF();
+	return false;
+	}
+
+void File::CompleteBOF()
+	{
 	bof_buffer.full = true;
 
 	if ( bof_buffer.size > 0 )
@@ -370,16 +397,50 @@ bool File::BufferBOF(const u_char* data, uint64 len)
 		BroString* bs = concatenate(bof_buffer.chunks);
 		val->Assign(bof_buffer_idx, new StringVal(bs));
 		}
+	}
 
-	return false;
+void File::SniffIncrementally(const u_char* data, uint64 len)
+	{
+	if ( ! magic_state )
+		magic_state = rule_matcher->InitFileMagic();
+
+	// Only the BOF buffer's worth of data counts, as it
+	// would without incremental sniffing.
+	uint64 desired_size = LookupFieldDefaultCount(bof_buffer_size_idx);
+	len = min(len, desired_size > magic_bytes ? desired_size - magic_bytes : 0);
+	magic_bytes += len;
+
+	if ( rule_matcher->MatchIncremental(magic_state, data, len) &&
+	     ! bof_buffer.full )
+		{
+		DBG_LOG(DBG_FILE_ANALYSIS, "[%s] File type known after %" PRIu64 " bytes",
+		        id.c_str(), magic_bytes);
+		CompleteBOF();
+		}
 	}
 
 void File::DeliverStream(const u_char* data, uint64 len)
 	{
+	if ( file_delivery_block_size && len > file_delivery_block_size )
+		{
+		// Have all analyzers process one block before moving on to the
+		// next, rather than each of them running over the whole chunk
+		// after it's dropped out of the cache again.
+		for ( uint64 i = 0; i < len; i += file_delivery_block_size )
+			DeliverStream(data + i, min(file_delivery_block_size, len - i));
+
+		return;
+		}
+
 	bool bof_was_full = bof_buffer.full;
 	// Buffer enough data for the BOF buffer
 	BufferBOF(data, len);
 
+	if ( incremental_file_sniffing && ! did_metadata_inference &&
+	     ! bof_was_full && rule_matcher && FileEventAvailable(file_sniff) &&
+	     LookupFieldDefaultCount(missing_bytes_idx) == 0 )
+		SniffIncrementally(data, len);
+
 	if ( ! did_metadata_inference && bof_buffer.full &&
 	     LookupFieldDefaultCount(missing_bytes_idx) == 0 )
 		InferMetadata();
@@ -449,25 +510,32 @@ void File::DeliverChunk(const u_char* data, uint64 len, uint64 offset)
 	// Potentially handle reassembly and deliver to the stream analyzers.
 	if ( file_reassembler )
 		{
-		if ( reassembly_max_buffer > 0 &&
-		     reassembly_max_buffer < file_reassembler->TotalSize() )
-			{
-			uint64 current_offset = stream_offset;
-			uint64 gap_bytes = file_reassembler->Flush();
-			IncrementByteCount(gap_bytes, overflow_bytes_idx);
+		if ( ReassemblyOverLimit(len) &&
+		     file_reassembler->Spill(offset, len, data) )
+			; // Comes back once reassembly has caught up with it.
 
-			if ( FileEventAvailable(file_reassembly_overflow) )
+		else
+			{
+			if ( file_reassembler->HasBlocks() && ReassemblyOverLimit(0) )
 				{
-				FileEvent(file_reassembly_overflow, {
-					val->Ref(),
-					val_mgr->GetCount(current_offset),
-					val_mgr->GetCount(gap_bytes),
-				});
+				uint64 current_offset = stream_offset;
+				uint64 gap_bytes = file_reassembler->Flush();
+				IncrementByteCount(gap_bytes, overflow_bytes_idx);
+
+				if ( FileEventAvailable(file_reassembly_overflow) )
+					{
+					FileEvent(file_reassembly_overflow, {
+						val->Ref(),
+						val_mgr->GetCount(current_offset),
+						val_mgr->GetCount(gap_bytes),
+					});
+					}
 				}
-			}
 
-		// Forward data to the reassembler.
-		file_reassembler->NewBlock(network_time, offset, len, data);
+			// Forward data to the reassembler.
+			file_reassembler->NewBlock(network_time, offset, len, data);
+			file_reassembler->UnspillReached();
+			}
 		}
 	else if ( stream_offset == offset )
 		{
@@ -515,6 +583,16 @@ void File::DeliverChunk(const u_char* data, uint64 len, uint64 offset)
 		EndOfFile();
 	}
 
+bool File::ReassemblyOverLimit(uint64 len) const
+	{
+	if ( reassembly_max_buffer > 0 &&
+	     file_reassembler->TotalSize() + len > reassembly_max_buffer )
+		return true;
+
+	return file_reassembly_max_memory > 0 &&
+	       Reassembler::MemoryAllocation(REASSEM_FILE) + len > file_reassembly_max_memory;
+	}
+
 void File::DoneWithAnalyzer(Analyzer* analyzer)
 	{
 	done_analyzers.push_back(analyzer);
@@ -649,8 +727,8 @@ void File::FileEvent(EventHandlerPtr h, val_list vl)
 		}
 	}
 
-bool File::PermitWeird(const char* name, uint64 threshold, uint64 rate,
+bool File::PermitWeird(WeirdID id, uint64 threshold, uint64 rate,
                        double duration)
 	{
-	return ::PermitWeird(weird_state, name, threshold, rate, duration);
+	return ::PermitWeird(weird_state, id, threshold, rate, duration);
 	}
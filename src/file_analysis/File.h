@@ -15,6 +15,8 @@
 #include "BroString.h"
 #include "WeirdState.h"
 
+class RuleFileMagicState;
+
 namespace file_analysis {
 
 class FileReassembler;
@@ -120,6 +122,15 @@ public:
 	 */
 	bool RemoveAnalyzer(file_analysis::Tag tag, RecordVal* args);
 
+	/**
+	 * Stops analysis of the file like \c Files::stop if no analyzer other
+	 * than the given one is attached to it. For analyzers that are done
+	 * before the end of the file.
+	 * @param a the analyzer that's done.
+	 * @return true if analysis of the file was stopped, else false.
+	 */
+	bool StopIfOnlyAnalyzer(file_analysis::Analyzer* a);
+
 	/**
 	 * Signal that this analyzer can be deleted once it's safe to do so.
 	 */
@@ -203,7 +214,7 @@ public:
 	 * Whether to permit a weird to carry on through the full reporter/weird
 	 * framework.
 	 */
-	bool PermitWeird(const char* name, uint64 threshold, uint64 rate,
+	bool PermitWeird(WeirdID id, uint64 threshold, uint64 rate,
 	                 double duration);
 
 protected:
@@ -269,6 +280,22 @@ protected:
 	 */
 	bool BufferBOF(const u_char* data, uint64 len);
 
+	/**
+	 * Marks the BOF buffer as complete and makes its contents available
+	 * to the script layer.
+	 */
+	void CompleteBOF();
+
+	/**
+	 * Feeds data at the beginning of a file into the file magic
+	 * signatures as it arrives, for \c incremental_file_sniffing.  Once
+	 * further data can't change the result, completes the BOF buffer so
+	 * that metadata inference happens right away.
+	 * @param data pointer to a data chunk.
+	 * @param len number of bytes in the data chunk.
+	 */
+	void SniffIncrementally(const u_char* data, uint64 len);
+
 	/**
 	 * Does metadata inference (e.g. mime type detection via file
 	 * magic signatures) using data in the BOF (beginning-of-file) buffer
@@ -303,6 +330,12 @@ protected:
 	 */
 	void DeliverChunk(const u_char* data, uint64 len, uint64 offset);
 
+	/**
+	 * @return whether buffering another \a len bytes for reassembly would
+	 * exceed the file's reassembly buffer or \c file_reassembly_max_memory.
+	 */
+	bool ReassemblyOverLimit(uint64 len) const;
+
 	/**
 	 * Lookup a record field index/offset by name.
 	 * @param field_name the name of the record field.
@@ -323,6 +356,8 @@ protected:
 	uint64 stream_offset;      /**< The offset of the file which has been forwarded. */
 	uint64 reassembly_max_buffer;      /**< Maximum allowed buffer for reassembly. */
 	bool did_metadata_inference;        /**< Whether the metadata inference has already been attempted. */
+	RuleFileMagicState* magic_state;    /**< File magic match state for incremental sniffing, if used. */
+	uint64 magic_bytes;                 /**< Bytes fed into \c magic_state so far. */
 	bool reassembly_enabled;           /**< Whether file stream reassembly is needed. */
 	bool postpone_timeout;     /**< Whether postponing timeout is requested. */
 	bool done;                 /**< If this object is about to be deleted. */
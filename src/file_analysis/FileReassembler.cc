@@ -1,24 +1,38 @@
 
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
 #include "FileReassembler.h"
 #include "File.h"
+#include "NetVar.h"
 
 
 namespace file_analysis {
 
 class File;
 
+uint64 FileReassembler::total_spilled_size = 0;
+uint64 FileReassembler::total_spills = 0;
+
 FileReassembler::FileReassembler(File *f, uint64 starting_offset)
-	: Reassembler(starting_offset, REASSEM_FILE), the_file(f), flushing(false)
+	: Reassembler(starting_offset, REASSEM_FILE), the_file(f), flushing(false),
+	  spill_fd(-1), spill_file_size(0), spilled_size(0)
 	{
 	}
 
 FileReassembler::FileReassembler()
-	: Reassembler(), the_file(0), flushing(false)
+	: Reassembler(), the_file(0), flushing(false),
+	  spill_fd(-1), spill_file_size(0), spilled_size(0)
 	{
 	}
 
 FileReassembler::~FileReassembler()
 	{
+	if ( spill_fd >= 0 )
+		safe_close(spill_fd);
+
+	total_spilled_size -= spilled_size;
 	}
 
 uint64 FileReassembler::Flush()
@@ -26,16 +40,22 @@ uint64 FileReassembler::Flush()
 	if ( flushing )
 		return 0;
 
-	if ( last_block )
+	if ( ! last_block && spilled.empty() )
+		return 0;
+
+	uint64 end = last_block ? last_block->upper : 0;
+
+	if ( ! spilled.empty() )
 		{
-		// This is expected to call back into FileReassembler::Undelivered().
-		flushing = true;
-		uint64 rval = TrimToSeq(last_block->upper);
-		flushing = false;
-		return rval;
+		auto last = spilled.rbegin();
+		end = max(end, last->first + last->second.len);
 		}
 
-	return 0;
+	// This is expected to call back into FileReassembler::Undelivered().
+	flushing = true;
+	uint64 rval = FlushSpilledTo(end);
+	flushing = false;
+	return rval;
 	}
 
 uint64 FileReassembler::FlushTo(uint64 sequence)
@@ -44,12 +64,119 @@ uint64 FileReassembler::FlushTo(uint64 sequence)
 		return 0;
 
 	flushing = true;
-	uint64 rval = TrimToSeq(sequence);
+	uint64 rval = FlushSpilledTo(sequence);
 	flushing = false;
 	last_reassem_seq = sequence;
 	return rval;
 	}
 
+uint64 FileReassembler::FlushSpilledTo(uint64 sequence)
+	{
+	uint64 rval = 0;
+
+	// Going through the spilled chunks in order means they don't all
+	// have to be in memory at the same time.
+	while ( ! spilled.empty() && spilled.begin()->first < sequence )
+		{
+		uint64 seq = spilled.begin()->first;
+
+		if ( seq > last_reassem_seq )
+			rval += TrimToSeq(seq);
+
+		Unspill();
+		UnspillReached();
+		}
+
+	return rval + TrimToSeq(sequence);
+	}
+
+bool FileReassembler::Spill(uint64 seq, uint64 len, const u_char* data)
+	{
+	if ( ! file_reassembly_spill_dir->Len() || seq <= last_reassem_seq ||
+	     spilled_size + len > file_reassembly_max_spill ||
+	     spilled.find(seq) != spilled.end() )
+		return false;
+
+	if ( spill_fd < 0 )
+		{
+		std::string tmpl = fmt("%s/zeek-file-reassembly-XXXXXX",
+		                       file_reassembly_spill_dir->CheckString());
+		char* path = copy_string(tmpl.c_str());
+		spill_fd = mkstemp(path);
+
+		if ( spill_fd < 0 )
+			{
+			char buf[128];
+			bro_strerror_r(errno, buf, sizeof(buf));
+			reporter->Error("cannot create spill file %s: %s", path, buf);
+			delete [] path;
+			return false;
+			}
+
+		// Nobody else needs to see it, and this way it goes away
+		// by itself.
+		unlink(path);
+		delete [] path;
+		}
+
+	if ( pwrite(spill_fd, data, len, spill_file_size) != ssize_t(len) )
+		{
+		char buf[128];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		reporter->Error("cannot write to spill file: %s", buf);
+		return false;
+		}
+
+	SpilledChunk c;
+	c.len = len;
+	c.file_offset = spill_file_size;
+	spilled[seq] = c;
+
+	spill_file_size += len;
+	spilled_size += len;
+	total_spilled_size += len;
+	++total_spills;
+	return true;
+	}
+
+void FileReassembler::UnspillReached()
+	{
+	while ( ! spilled.empty() && spilled.begin()->first <= last_reassem_seq )
+		Unspill();
+	}
+
+void FileReassembler::Unspill()
+	{
+	auto it = spilled.begin();
+	uint64 seq = it->first;
+	SpilledChunk c = it->second;
+
+	spilled.erase(it);
+	spilled_size -= c.len;
+	total_spilled_size -= c.len;
+
+	u_char* data = new u_char[c.len];
+
+	if ( pread(spill_fd, data, c.len, c.file_offset) != ssize_t(c.len) )
+		{
+		// What's missing will be reported as a gap.
+		char buf[128];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		reporter->Error("cannot read from spill file: %s", buf);
+		}
+	else
+		NewBlock(network_time, seq, c.len, data);
+
+	delete [] data;
+
+	if ( spilled.empty() )
+		{
+		// Give the disk space back.
+		if ( ftruncate(spill_fd, 0) == 0 )
+			spill_file_size = 0;
+		}
+	}
+
 void FileReassembler::BlockInserted(DataBlock* start_block)
 	{
 	if ( start_block->seq > last_reassem_seq ||
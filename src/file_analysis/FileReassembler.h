@@ -1,6 +1,8 @@
 #ifndef FILE_ANALYSIS_FILEREASSEMBLER_H
 #define FILE_ANALYSIS_FILEREASSEMBLER_H
 
+#include <map>
+
 #include "Reassem.h"
 #include "File.h"
 
@@ -47,6 +49,44 @@ public:
 	bool IsCurrentlyFlushing() const
 		{ return flushing; }
 
+	/**
+	 * Puts a chunk of data that can't be delivered yet into a temporary
+	 * file in \c file_reassembly_spill_dir instead of memory. It comes
+	 * back once reassembly gets to it.
+	 * @param seq the offset of the chunk within the file.
+	 * @param len the size of the chunk.
+	 * @param data the chunk.
+	 * @return false if spilling is disabled, the chunk could be delivered
+	 * right away, or the file has already spilled \c
+	 * file_reassembly_max_spill bytes.
+	 */
+	bool Spill(uint64 seq, uint64 len, const u_char* data);
+
+	/**
+	 * Feeds spilled chunks back in once reassembly has reached them.
+	 */
+	void UnspillReached();
+
+	/**
+	 * @return the number of bytes this reassembler has spilled to disk.
+	 */
+	uint64 SpilledSize() const
+		{ return spilled_size; }
+
+	/**
+	 * @return the number of bytes all file reassemblers have spilled to
+	 * disk.
+	 */
+	static uint64 TotalSpilledSize()
+		{ return total_spilled_size; }
+
+	/**
+	 * @return the number of chunks all file reassemblers have spilled to
+	 * disk since startup, including ones read back in since.
+	 */
+	static uint64 TotalSpills()
+		{ return total_spills; }
+
 protected:
 	FileReassembler();
 
@@ -54,8 +94,28 @@ protected:
 	void BlockInserted(DataBlock* b) override;
 	void Overlap(const u_char* b1, const u_char* b2, uint64 n) override;
 
+	// Delivers everything up to a given offset, bringing spilled chunks
+	// back in order on the way.
+	uint64 FlushSpilledTo(uint64 sequence);
+
+	// Reads a spilled chunk back into the reassembler.
+	void Unspill();
+
+	struct SpilledChunk {
+		uint64 len;
+		uint64 file_offset;	// within the spill file
+	};
+
 	File* the_file;
 	bool flushing;
+
+	int spill_fd;
+	uint64 spill_file_size;
+	uint64 spilled_size;
+	std::map<uint64, SpilledChunk> spilled;	// keyed by offset in the file
+
+	static uint64 total_spilled_size;
+	static uint64 total_spills;
 };
 
 } // namespace analyzer::* 
@@ -189,6 +189,22 @@ void Manager::DataIn(const u_char* data, uint64 len, const string& file_id,
 		RemoveFile(file->GetID());
 	}
 
+void Manager::DataIn(const u_char* data, uint64 len, uint64 offset,
+                     const string& file_id, const string& source)
+	{
+	File* file = GetFile(file_id, 0, analyzer::Tag::Error, false, false,
+	                     source.c_str());
+
+	// An empty chunk just creates the file.
+	if ( ! file || ! len )
+		return;
+
+	file->DataIn(data, len, offset);
+
+	if ( file->IsComplete() )
+		RemoveFile(file->GetID());
+	}
+
 void Manager::EndOfFile(analyzer::Tag tag, Connection* conn)
 	{
 	EndOfFile(tag, conn, true);
@@ -219,6 +235,17 @@ string Manager::Gap(uint64 offset, uint64 len, analyzer::Tag tag,
 	return id;
 	}
 
+bool Manager::Gap(uint64 offset, uint64 len, const string& file_id)
+	{
+	File* file = LookupFile(file_id);
+
+	if ( ! file )
+		return false;
+
+	file->Gap(offset, len);
+	return true;
+	}
+
 string Manager::SetSize(uint64 size, analyzer::Tag tag, Connection* conn,
                         bool is_orig, const string& precomputed_id)
 	{
@@ -152,6 +152,19 @@ public:
 	void DataIn(const u_char* data, uint64 len, const string& file_id,
 	            const string& source);
 
+	/**
+	 * Pass in non-sequential file data from external source.
+	 * @param data pointer to start of a chunk of file data.
+	 * @param len number of bytes in the data chunk.
+	 * @param offset number of bytes in to file at which the chunk starts.
+	 * @param file_id an identifier for the file (usually a hash of \a source).
+	 * @param source uniquely identifies the file and should also describe
+	 *        in human-readable form where the file input is coming from.
+	 *        With \a len zero, the file is just created if need be.
+	 */
+	void DataIn(const u_char* data, uint64 len, uint64 offset,
+	            const string& file_id, const string& source);
+
 	/**
 	 * Signal the end of file data regardless of which direction it is being
 	 * sent over the connection.
@@ -194,6 +207,15 @@ public:
 	                Connection* conn, bool is_orig,
 	                const std::string& precomputed_file_id = "");
 
+	/**
+	 * Signal a gap in file data from an external source.
+	 * @param offset number of bytes in to file at which missing chunk starts.
+	 * @param len length in bytes of the missing chunk of file data.
+	 * @param file_id the file identifier/hash.
+	 * @return false if the file isn't known.
+	 */
+	bool Gap(uint64 offset, uint64 len, const string& file_id);
+
 	/**
 	 * Provide the expected number of bytes that comprise a file.
 	 * @param size the number of bytes in the full file.
@@ -295,6 +317,16 @@ public:
 	 */
 	bool IsIgnored(const string& file_id);
 
+	/**
+	 * Check if analysis is available for files transferred over a given
+	 * network protocol.
+	 * @param tag the network protocol over which files can be transferred and
+	 *        analyzed by the file analysis framework.
+	 * @return whether file analysis is disabled for the analyzer given by
+	 *         \a tag.
+	 */
+	static bool IsDisabled(analyzer::Tag tag);
+
 	/**
 	 * Instantiates a new file analyzer instance for the file.
 	 * @param tag The file analyzer's tag.
@@ -394,16 +426,6 @@ protected:
 	 */
 	std::string GetFileID(analyzer::Tag tag, Connection* c, bool is_orig);
 
-	/**
-	 * Check if analysis is available for files transferred over a given
-	 * network protocol.
-	 * @param tag the network protocol over which files can be transferred and
-	 *        analyzed by the file analysis framework.
-	 * @return whether file analysis is disabled for the analyzer given by
-	 *         \a tag.
-	 */
-	static bool IsDisabled(analyzer::Tag tag);
-
 private:
 	typedef set<Tag> TagSet;
 	typedef map<string, TagSet*> MIMEMap;
@@ -1,20 +1,125 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
 #include <string>
+#include <dirent.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include "Extract.h"
+#include "ExtractWriter.h"
 #include "util.h"
 #include "Event.h"
 #include "file_analysis/Manager.h"
+#include "probabilistic/BloomFilter.h"
+
+#include "analyzer/extract/consts.bif.h"
 
 using namespace file_analysis;
 
+// Sizing of the Bloom filter of prefixes in the content store.
+#define DEDUP_PREFIXES_CAPACITY 1000000
+#define DEDUP_PREFIXES_FP 0.0001
+
+// Prefixes of the files that went into the content store, for
+// FileExtract::dedup_early_abort.
+static probabilistic::BloomFilter* dedup_prefixes = 0;
+
+// Adds the prefixes of the files already in the content store.
+static void load_dedup_prefixes(probabilistic::BloomFilter* bf)
+	{
+	const char* store = BifConst::FileExtract::dedup_store->CheckString();
+	uint64 prefix_size = BifConst::FileExtract::dedup_prefix_size;
+	DIR* dir = prefix_size ? opendir(store) : 0;
+
+	if ( ! dir )
+		return;
+
+	u_char* buf = new u_char[prefix_size];
+	struct dirent* e;
+
+	while ( (e = readdir(dir)) )
+		{
+		if ( e->d_name[0] == '.' )
+			continue;
+
+		std::string path = fmt("%s/%s", store, e->d_name);
+		int fd = open(path.c_str(), O_RDONLY);
+
+		if ( fd < 0 )
+			continue;
+
+		uint64 n = 0;
+
+		while ( n < prefix_size )
+			{
+			ssize_t r = read(fd, buf + n, prefix_size - n);
+
+			if ( r <= 0 )
+				break;
+
+			n += r;
+			}
+
+		safe_close(fd);
+
+		// Shorter files never get aborted early.
+		if ( n < prefix_size )
+			continue;
+
+		u_char digest[SHA256_DIGEST_LENGTH];
+		EVP_MD_CTX* c = hash_init(Hash_SHA256);
+		hash_update(c, buf, n);
+		hash_final(c, digest);
+		HashKey key(digest, sizeof(digest));
+		bf->Add(&key);
+		}
+
+	delete [] buf;
+	closedir(dir);
+	}
+
+static probabilistic::BloomFilter* get_dedup_prefixes()
+	{
+	if ( ! dedup_prefixes )
+		{
+		size_t cells = probabilistic::BasicBloomFilter::M(DEDUP_PREFIXES_FP,
+		                                                  DEDUP_PREFIXES_CAPACITY);
+		size_t k = probabilistic::BasicBloomFilter::K(cells, DEDUP_PREFIXES_CAPACITY);
+		probabilistic::Hasher::seed_t seed = probabilistic::Hasher::MakeSeed(0, 0);
+		const probabilistic::Hasher* h = new probabilistic::DoubleHasher(k, seed);
+		dedup_prefixes = new probabilistic::BasicBloomFilter(h, cells);
+		load_dedup_prefixes(dedup_prefixes);
+		}
+
+	return dedup_prefixes;
+	}
+
 Extract::Extract(RecordVal* args, File* file, const string& arg_filename,
                  uint64 arg_limit)
     : file_analysis::Analyzer(file_mgr->GetComponentTag("EXTRACT"), args, file),
       filename(arg_filename), limit(arg_limit), depth(0)
 	{
+	fd = 0;
+	writer_id = 0;
+	dropped = 0;
+	dedup_hash = 0;
+	have_dedup_prefix = false;
+	dedup_aborted = false;
+	async = BifConst::FileExtract::async_writes;
+
+	if ( async )
+		{
+		// Reserve space for as much as we expect to write.
+		Val* total = file->GetVal()->Lookup("total_bytes");
+		uint64 prealloc = total ? total->AsCount() : 0;
+
+		if ( limit && (! prealloc || prealloc > limit) )
+			prealloc = limit;
+
+		writer_id = ExtractWriter::Get()->Open(filename, prealloc);
+		return;
+		}
+
 	fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666);
 
 	if ( fd < 0 )
@@ -23,13 +128,23 @@ Extract::Extract(RecordVal* args, File* file, const string& arg_filename,
 		char buf[128];
 		bro_strerror_r(errno, buf, sizeof(buf));
 		reporter->Error("cannot open %s: %s", filename.c_str(), buf);
+		return;
 		}
+
+	if ( BifConst::FileExtract::dedup_store->Len() > 0 )
+		dedup_hash = hash_init(Hash_SHA256);
 	}
 
 Extract::~Extract()
 	{
+	if ( async )
+		ExtractWriter::Get()->Close(writer_id, depth);
+
 	if ( fd )
 		safe_close(fd);
+
+	if ( dedup_hash )
+		EVP_MD_CTX_free(dedup_hash);
 	}
 
 static Val* get_extract_field_val(RecordVal* args, const char* name)
@@ -82,7 +197,7 @@ static bool check_limit_exceeded(uint64 lim, uint64 depth, uint64 len, uint64* n
 
 bool Extract::DeliverStream(const u_char* data, uint64 len)
 	{
-	if ( ! fd )
+	if ( ! fd && ! async )
 		return false;
 
 	uint64 towrite = 0;
@@ -104,22 +219,203 @@ bool Extract::DeliverStream(const u_char* data, uint64 len)
 
 	if ( towrite > 0 )
 		{
-		safe_write(fd, reinterpret_cast<const char*>(data), towrite);
+		if ( ! async )
+			{
+			if ( dedup_hash )
+				DedupUpdate(data, towrite);
+
+			if ( ! dedup_aborted )
+				safe_write(fd, reinterpret_cast<const char*>(data), towrite);
+			}
+
+		else if ( ! ExtractWriter::Get()->Write(writer_id, depth, data, towrite) )
+			// The writer is too far behind. This leaves a hole
+			// in the file.
+			dropped += towrite;
+
 		depth += towrite;
 		}
 
+	if ( limit_exceeded )
+		ReportDropped();
+
 	return ( ! limit_exceeded );
 	}
 
+bool Extract::EndOfFile()
+	{
+	ReportDropped();
+
+	if ( dedup_hash )
+		Deduplicate();
+
+	return true;
+	}
+
+void Extract::ReportDropped()
+	{
+	if ( ! dropped )
+		return;
+
+	if ( file_extraction_dropped )
+		{
+		File* f = GetFile();
+		f->FileEvent(file_extraction_dropped, {
+			f->GetVal()->Ref(),
+			Args()->Ref(),
+			val_mgr->GetCount(dropped),
+		});
+		}
+
+	dropped = 0;
+	}
+
 bool Extract::Undelivered(uint64 offset, uint64 len)
 	{
+	if ( async )
+		{
+		// The writer seeks past the gap, and fills it up if it's
+		// at the end of the file.
+		if ( depth == offset )
+			depth += len;
+
+		return true;
+		}
+
+	// The content can't be matched up with anything anymore.
+	if ( dedup_hash )
+		DedupAbandon();
+
 	if ( depth == offset )
 		{
-		char* tmp = new char[len]();
-		safe_write(fd, tmp, len);
-		delete [] tmp;
+		if ( ! dedup_aborted )
+			{
+			char* tmp = new char[len]();
+			safe_write(fd, tmp, len);
+			delete [] tmp;
+			}
+
 		depth += len;
 		}
 
 	return true;
 	}
+
+void Extract::DedupUpdate(const u_char* data, uint64 len)
+	{
+	uint64 prefix_size = BifConst::FileExtract::dedup_prefix_size;
+
+	if ( ! BifConst::FileExtract::dedup_early_abort ||
+	     depth >= prefix_size || depth + len < prefix_size )
+		{
+		hash_update(dedup_hash, data, len);
+		return;
+		}
+
+	// This completes the prefix. Finish a copy of the hash for it,
+	// and carry on with the rest.
+	uint64 n = prefix_size - depth;
+	hash_update(dedup_hash, data, n);
+
+	EVP_MD_CTX* c = EVP_MD_CTX_new();
+	EVP_MD_CTX_copy_ex(c, dedup_hash);
+	hash_final(c, dedup_prefix);
+	have_dedup_prefix = true;
+
+	HashKey key(dedup_prefix, sizeof(dedup_prefix));
+
+	if ( get_dedup_prefixes()->Count(&key) )
+		// Likely a known file, no need to write the rest.
+		dedup_aborted = true;
+
+	hash_update(dedup_hash, data + n, len - n);
+	}
+
+void Extract::Deduplicate()
+	{
+	u_char digest[SHA256_DIGEST_LENGTH];
+	hash_final(dedup_hash, digest);
+	dedup_hash = 0;
+
+	std::string sha256 = sha256_digest_print(digest);
+	const char* store = BifConst::FileExtract::dedup_store->CheckString();
+	std::string stored = fmt("%s/%s", store, sha256.c_str());
+
+	if ( is_file(stored) )
+		{
+		safe_close(fd);
+		fd = 0;
+
+		if ( BifConst::FileExtract::dedup_link )
+			{
+			// Link to a temporary name first, so that the extracted
+			// file doesn't go missing if that fails.
+			std::string tmp = filename + ".dedup";
+
+			if ( link(stored.c_str(), tmp.c_str()) < 0 ||
+			     rename(tmp.c_str(), filename.c_str()) < 0 )
+				{
+				char buf[128];
+				bro_strerror_r(errno, buf, sizeof(buf));
+				reporter->Error("cannot link %s to %s: %s",
+				                filename.c_str(), stored.c_str(), buf);
+				unlink(tmp.c_str());
+				}
+			}
+		else
+			unlink(filename.c_str());
+
+		if ( have_dedup_prefix )
+			{
+			HashKey key(dedup_prefix, sizeof(dedup_prefix));
+			get_dedup_prefixes()->Add(&key);
+			}
+
+		if ( file_extraction_duplicate )
+			{
+			File* f = GetFile();
+			f->FileEvent(file_extraction_duplicate, {
+				f->GetVal()->Ref(),
+				Args()->Ref(),
+				new StringVal(sha256),
+			});
+			}
+
+		return;
+		}
+
+	if ( dedup_aborted )
+		{
+		// A Bloom filter false positive, or the store changed
+		// underneath us. Either way, the file is incomplete.
+		reporter->Weird(GetFile(), "file_extraction_dedup_mismatch");
+		return;
+		}
+
+	if ( ! ensure_dir(store) )
+		return;
+
+	if ( link(filename.c_str(), stored.c_str()) < 0 && errno != EEXIST )
+		{
+		char buf[128];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		reporter->Error("cannot link %s to %s: %s", stored.c_str(),
+		                filename.c_str(), buf);
+		return;
+		}
+
+	if ( have_dedup_prefix )
+		{
+		HashKey key(dedup_prefix, sizeof(dedup_prefix));
+		get_dedup_prefixes()->Add(&key);
+		}
+	}
+
+void Extract::DedupAbandon()
+	{
+	EVP_MD_CTX_free(dedup_hash);
+	dedup_hash = 0;
+
+	if ( dedup_aborted )
+		reporter->Weird(GetFile(), "file_extraction_dedup_mismatch");
+	}
@@ -8,6 +8,7 @@
 #include "Val.h"
 #include "File.h"
 #include "Analyzer.h"
+#include "digest.h"
 
 #include "analyzer/extract/events.bif.h"
 
@@ -41,6 +42,13 @@ public:
 	 */
 	bool Undelivered(uint64 offset, uint64 len) override;
 
+	/**
+	 * Reports any data dropped by asynchronous writing, and deduplicates
+	 * the extracted file against the content store.
+	 * @return true
+	 */
+	bool EndOfFile() override;
+
 	/**
 	 * Create a new instance of an Extract analyzer.
 	 * @param args the \c AnalyzerArgs value which represents the analyzer.
@@ -71,10 +79,39 @@ protected:
 	        uint64 arg_limit);
 
 private:
+	// Raises file_extraction_dropped for data dropped so far.
+	void ReportDropped();
+
+	// Feeds data into the content hash, checking the file's prefix
+	// against known ones once it's complete.
+	void DedupUpdate(const u_char* data, uint64 len);
+
+	// Replaces the extracted file with the stored copy if it has one,
+	// else adds it to the store.
+	void Deduplicate();
+
+	// Gives up on deduplicating, e.g. after a gap.
+	void DedupAbandon();
+
 	string filename;
 	int fd;
 	uint64 limit;
 	uint64 depth;
+
+	// With FileExtract::async_writes, the ExtractWriter's ID for the
+	// file, and how many bytes it had to drop.
+	bool async;
+	uint64 writer_id;
+	uint64 dropped;
+
+	// With FileExtract::dedup_store, the running SHA-256 of the
+	// content, and that of its first FileExtract::dedup_prefix_size
+	// bytes. Once the prefix is known to be in the store, writing
+	// stops if FileExtract::dedup_early_abort is set.
+	EVP_MD_CTX* dedup_hash;
+	u_char dedup_prefix[SHA256_DIGEST_LENGTH];
+	bool have_dedup_prefix;
+	bool dedup_aborted;
 };
 
 } // namespace file_analysis
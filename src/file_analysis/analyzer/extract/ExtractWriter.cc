@@ -0,0 +1,243 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ExtractWriter.h"
+#include "util.h"
+
+#include "analyzer/extract/consts.bif.h"
+
+using namespace file_analysis;
+
+// How much consecutive data to collect for a file before writing it out.
+#define EXTRACT_WRITE_BATCH_SIZE (1024 * 1024)
+
+namespace file_analysis {
+
+class ExtractOpenMessage : public threading::InputMessage<ExtractWriter>
+{
+public:
+	ExtractOpenMessage(ExtractWriter* writer, uint64 id, const std::string& filename, uint64 prealloc)
+		: threading::InputMessage<ExtractWriter>("ExtractOpen", writer),
+		id(id), filename(filename), prealloc(prealloc)	{}
+
+	bool Process() override { return Object()->DoOpen(id, filename, prealloc); }
+
+private:
+	uint64 id;
+	std::string filename;
+	uint64 prealloc;
+};
+
+class ExtractWriteMessage : public threading::InputMessage<ExtractWriter>
+{
+public:
+	ExtractWriteMessage(ExtractWriter* writer, uint64 id, uint64 offset, const u_char* data, uint64 len)
+		: threading::InputMessage<ExtractWriter>("ExtractWrite", writer),
+		id(id), offset(offset), data(reinterpret_cast<const char*>(data), len)	{}
+
+	bool Process() override { return Object()->DoWrite(id, offset, data); }
+
+private:
+	uint64 id;
+	uint64 offset;
+	std::string data;
+};
+
+class ExtractCloseMessage : public threading::InputMessage<ExtractWriter>
+{
+public:
+	ExtractCloseMessage(ExtractWriter* writer, uint64 id, uint64 size)
+		: threading::InputMessage<ExtractWriter>("ExtractClose", writer),
+		id(id), size(size)	{}
+
+	bool Process() override { return Object()->DoClose(id, size); }
+
+private:
+	uint64 id;
+	uint64 size;
+};
+
+}
+
+ExtractWriter::ExtractWriter() : MsgThread()
+	{
+	next_id = 0;
+	pending = 0;
+	SetName("extract-writer");
+	}
+
+ExtractWriter* ExtractWriter::Get()
+	{
+	// The thread manager takes ownership of the thread.
+	static ExtractWriter* writer = 0;
+
+	if ( ! writer )
+		{
+		writer = new ExtractWriter();
+		writer->Start();
+		}
+
+	return writer;
+	}
+
+uint64 ExtractWriter::Open(const std::string& filename, uint64 prealloc)
+	{
+	uint64 id = ++next_id;
+	SendIn(new ExtractOpenMessage(this, id, filename, prealloc));
+	return id;
+	}
+
+bool ExtractWriter::Write(uint64 id, uint64 offset, const u_char* data, uint64 len)
+	{
+	if ( pending + len > BifConst::FileExtract::async_max_pending )
+		return false;
+
+	pending += len;
+	SendIn(new ExtractWriteMessage(this, id, offset, data, len));
+	return true;
+	}
+
+void ExtractWriter::Close(uint64 id, uint64 size)
+	{
+	SendIn(new ExtractCloseMessage(this, id, size));
+	}
+
+bool ExtractWriter::DoOpen(uint64 id, const std::string& filename, uint64 prealloc)
+	{
+	int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+	if ( fd < 0 )
+		{
+		char buf[128];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		Error(Fmt("cannot open %s: %s", filename.c_str(), buf));
+		return true;
+		}
+
+#ifdef __linux__
+	// Reserving the space without changing the file's size still lets
+	// the file system lay it out in one piece. Failing is harmless.
+	if ( prealloc )
+		fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, prealloc);
+#endif
+
+	OpenFile& f = files[id];
+	f.fd = fd;
+	f.filename = filename;
+	f.buf_offset = 0;
+	return true;
+	}
+
+bool ExtractWriter::DoWrite(uint64 id, uint64 offset, const std::string& data)
+	{
+	auto i = files.find(id);
+
+	if ( i == files.end() )
+		{
+		// Failed to open.
+		pending -= data.size();
+		return true;
+		}
+
+	OpenFile* f = &i->second;
+
+	if ( f->buf.size() && f->buf_offset + f->buf.size() != offset )
+		Flush(f);
+
+	if ( f->buf.empty() )
+		f->buf_offset = offset;
+
+	f->buf.append(data);
+
+	if ( f->buf.size() >= EXTRACT_WRITE_BATCH_SIZE )
+		Flush(f);
+
+	return true;
+	}
+
+bool ExtractWriter::DoClose(uint64 id, uint64 size)
+	{
+	auto i = files.find(id);
+
+	if ( i == files.end() )
+		return true;
+
+	OpenFile* f = &i->second;
+	Flush(f);
+
+	// Dropped data or gaps at the end didn't get written, but the file
+	// should still have its full size.
+	struct stat st;
+
+	if ( fstat(f->fd, &st) == 0 && uint64(st.st_size) < size )
+		{
+		if ( ftruncate(f->fd, size) < 0 )
+			{
+			char buf[128];
+			bro_strerror_r(errno, buf, sizeof(buf));
+			Error(Fmt("cannot extend %s: %s", f->filename.c_str(), buf));
+			}
+		}
+
+	safe_close(f->fd);
+	files.erase(i);
+	return true;
+	}
+
+void ExtractWriter::Flush(OpenFile* f)
+	{
+	if ( f->buf.empty() )
+		return;
+
+	const char* data = f->buf.data();
+	uint64 len = f->buf.size();
+	uint64 offset = f->buf_offset;
+
+	while ( len > 0 )
+		{
+		ssize_t n = pwrite(f->fd, data, len, offset);
+
+		if ( n < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			char buf[128];
+			bro_strerror_r(errno, buf, sizeof(buf));
+			Error(Fmt("cannot write to %s: %s", f->filename.c_str(), buf));
+			break;
+			}
+
+		data += n;
+		len -= n;
+		offset += n;
+		}
+
+	pending -= f->buf.size();
+	f->buf.clear();
+	}
+
+bool ExtractWriter::OnHeartbeat(double network_time, double current_time)
+	{
+	// Don't let data sit in a batch for long.
+	for ( auto& f : files )
+		Flush(&f.second);
+
+	return true;
+	}
+
+bool ExtractWriter::OnFinish(double network_time)
+	{
+	for ( auto& f : files )
+		{
+		Flush(&f.second);
+		safe_close(f.second.fd);
+		}
+
+	files.clear();
+	return true;
+	}
@@ -0,0 +1,96 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// A thread doing the disk I/O for file extraction, so that a slow disk
+// doesn't stall packet processing.
+
+#ifndef FILE_ANALYSIS_EXTRACTWRITER_H
+#define FILE_ANALYSIS_EXTRACTWRITER_H
+
+#include <atomic>
+#include <map>
+#include <string>
+
+#include "threading/MsgThread.h"
+
+namespace file_analysis {
+
+class ExtractWriter : public threading::MsgThread {
+public:
+	/**
+	 * Returns the writer thread, starting it on first use.
+	 */
+	static ExtractWriter* Get();
+
+	/**
+	 * Opens a file for extraction into it.
+	 *
+	 * @param filename The file to create.
+	 *
+	 * @param prealloc If non-zero, the number of bytes to reserve disk
+	 * space for up front.
+	 *
+	 * @return An identifier to pass to the other methods.
+	 */
+	uint64 Open(const std::string& filename, uint64 prealloc);
+
+	/**
+	 * Queues data for writing into a file. If more than
+	 * \c FileExtract::async_max_pending bytes are already waiting, the
+	 * data gets dropped instead, leaving a hole in the file.
+	 *
+	 * @param id The file, as returned by Open().
+	 *
+	 * @param offset Where in the file the data goes.
+	 *
+	 * @return False if the data got dropped.
+	 */
+	bool Write(uint64 id, uint64 offset, const u_char* data, uint64 len);
+
+	/**
+	 * Closes a file once everything queued for it has been written.
+	 *
+	 * @param id The file, as returned by Open().
+	 *
+	 * @param size The file's final size. Holes at the end get filled
+	 * up to it.
+	 */
+	void Close(uint64 id, uint64 size);
+
+	// Executed in the writer thread, through the messages sent by the
+	// methods above.
+	bool DoOpen(uint64 id, const std::string& filename, uint64 prealloc);
+	bool DoWrite(uint64 id, uint64 offset, const std::string& data);
+	bool DoClose(uint64 id, uint64 size);
+
+protected:
+	bool OnHeartbeat(double network_time, double current_time) override;
+	bool WantsHeartbeats() override	{ return pending > 0; }
+	bool OnFinish(double network_time) override;
+
+private:
+	ExtractWriter();
+
+	struct OpenFile {
+		int fd;
+		std::string filename;
+		// Data for consecutive offsets starting at buf_offset,
+		// waiting to go out with a single write.
+		uint64 buf_offset;
+		std::string buf;
+	};
+
+	void Flush(OpenFile* f);
+
+	// Main thread only.
+	uint64 next_id;
+
+	// Writer thread only.
+	std::map<uint64, OpenFile> files;
+
+	// Bytes handed to Write() but not written yet.
+	std::atomic<uint64> pending;
+};
+
+}
+
+#endif
@@ -1,5 +1,6 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <algorithm>
 #include <string>
 
 #include "Hash.h"
@@ -57,3 +58,140 @@ void Hash::Finalize()
 		hash->Get(),
 	});
 	}
+
+// How much of a chunk to feed to one digest before moving on to the next,
+// small enough to stay in the L1 cache in between.
+#define HASHES_SLICE_SIZE 8192
+
+// The digests the combined analyzer supports, in the order it raises
+// their events.
+static const char* hashes_kinds[] = { "md5", "sha1", "sha256" };
+
+static HashVal* new_hash_val(const char* kind)
+	{
+	if ( strcmp(kind, "md5") == 0 )
+		return new MD5Val();
+
+	if ( strcmp(kind, "sha1") == 0 )
+		return new SHA1Val();
+
+	return new SHA256Val();
+	}
+
+file_analysis::Analyzer* Hashes::Instantiate(RecordVal* args, File* file)
+	{
+	if ( ! file_hash )
+		return 0;
+
+	std::vector<const char*> kinds;
+	TableVal* selected = 0;
+	Val* v = args->Lookup("hashes");
+
+	if ( v )
+		{
+		selected = v->AsTableVal();
+
+		ListVal* l = selected->ConvertToPureList();
+
+		for ( int i = 0; i < l->Length(); ++i )
+			{
+			const char* name = l->Index(i)->AsString()->CheckString();
+			bool known = false;
+
+			for ( auto k : hashes_kinds )
+				known = known || strcmp(name, k) == 0;
+
+			if ( ! known )
+				reporter->Error("unknown hash algorithm for HASHES file analyzer: %s", name);
+			}
+
+		Unref(l);
+		}
+
+	for ( auto k : hashes_kinds )
+		{
+		if ( selected )
+			{
+			StringVal* name = new StringVal(k);
+			bool wanted = selected->Lookup(name, false);
+			Unref(name);
+
+			if ( ! wanted )
+				continue;
+			}
+
+		kinds.push_back(k);
+		}
+
+	if ( kinds.empty() )
+		return 0;
+
+	return new Hashes(args, file, kinds);
+	}
+
+Hashes::Hashes(RecordVal* args, File* file, const std::vector<const char*>& arg_kinds)
+	: file_analysis::Analyzer(file_mgr->GetComponentTag("HASHES"), args, file), kinds(arg_kinds), fed(false)
+	{
+	for ( auto k : kinds )
+		{
+		HashVal* h = new_hash_val(k);
+		h->Init();
+		hashes.push_back(h);
+		}
+	}
+
+Hashes::~Hashes()
+	{
+	for ( auto h : hashes )
+		Unref(h);
+	}
+
+bool Hashes::DeliverStream(const u_char* data, uint64 len)
+	{
+	for ( auto h : hashes )
+		{
+		if ( ! h->IsValid() )
+			return false;
+		}
+
+	if ( ! fed )
+		fed = len > 0;
+
+	while ( len > 0 )
+		{
+		uint64 n = std::min(len, uint64(HASHES_SLICE_SIZE));
+
+		for ( auto h : hashes )
+			h->Feed(data, n);
+
+		data += n;
+		len -= n;
+		}
+
+	return true;
+	}
+
+bool Hashes::EndOfFile()
+	{
+	if ( ! fed || ! file_hash )
+		return false;
+
+	for ( size_t i = 0; i < hashes.size(); ++i )
+		{
+		if ( ! hashes[i]->IsValid() )
+			continue;
+
+		mgr.QueueEventFast(file_hash, {
+			GetFile()->GetVal()->Ref(),
+			new StringVal(kinds[i]),
+			hashes[i]->Get(),
+		});
+		}
+
+	return false;
+	}
+
+bool Hashes::Undelivered(uint64 offset, uint64 len)
+	{
+	return false;
+	}
@@ -4,6 +4,7 @@
 #define FILE_ANALYSIS_HASH_H
 
 #include <string>
+#include <vector>
 
 #include "Val.h"
 #include "OpaqueVal.h"
@@ -155,6 +156,72 @@ protected:
 		{}
 };
 
+/**
+ * An analyzer to produce several hashes of file contents at once. Compared
+ * to attaching the individual hash analyzers, each chunk of data gets
+ * handed over only once, and is fed to all digests piecewise so that it
+ * stays in the CPU cache while they're computed.
+ */
+class Hashes : public file_analysis::Analyzer {
+public:
+
+	/**
+	 * Destructor.
+	 */
+	~Hashes() override;
+
+	/**
+	 * Create a new instance of the combined hashing file analyzer.
+	 * @param args the \c AnalyzerArgs value which represents the analyzer.
+	 * Its \c hashes field selects the digests, all supported ones if
+	 * it's not set.
+	 * @param file the file to which the analyzer will be attached.
+	 * @return the new analyzer instance or a null pointer if there's no
+	 *         handler for the "file_hash" event or no valid digest was
+	 *         selected.
+	 */
+	static file_analysis::Analyzer* Instantiate(RecordVal* args, File* file);
+
+	/**
+	 * Incrementally hash next chunk of file contents.
+	 * @param data pointer to start of a chunk of a file data.
+	 * @param len number of bytes in the data chunk.
+	 * @return false if a digest is in an invalid state, else true.
+	 */
+	bool DeliverStream(const u_char* data, uint64 len) override;
+
+	/**
+	 * Finalizes the hashes and raises a "file_hash" event for each.
+	 * @return always false so analyze will be deteched from file.
+	 */
+	bool EndOfFile() override;
+
+	/**
+	 * Missing data can't be handled, so just indicate the this analyzer should
+	 * be removed from receiving further data.  The hashes will not be
+	 * finalized.
+	 * @param offset byte offset in file at which missing chunk starts.
+	 * @param len number of missing bytes.
+	 * @return always false so analyzer will detach from file.
+	 */
+	bool Undelivered(uint64 offset, uint64 len) override;
+
+protected:
+
+	/**
+	 * Constructor.
+	 * @param args the \c AnalyzerArgs value which represents the analyzer.
+	 * @param file the file to which the analyzer will be attached.
+	 * @param kinds the names of the hash algorithms to use.
+	 */
+	Hashes(RecordVal* args, File* file, const std::vector<const char*>& kinds);
+
+private:
+	std::vector<HashVal*> hashes;
+	std::vector<const char*> kinds;
+	bool fed;
+};
+
 } // namespace file_analysis
 
 #endif
@@ -1,6 +1,8 @@
 #include "PE.h"
 #include "file_analysis/Manager.h"
 
+#include "analyzer/pe/consts.bif.h"
+
 using namespace file_analysis;
 
 PE::PE(RecordVal* args, File* file)
@@ -31,7 +33,15 @@ bool PE::DeliverStream(const u_char* data, uint64 len)
 		return false;
 		}
 
-	return ! conn->is_done();
+	if ( ! conn->is_done() )
+		return true;
+
+	// The headers and section table are parsed, there's nothing more
+	// to get out of the file.
+	if ( BifConst::PE::headers_only )
+		GetFile()->StopIfOnlyAnalyzer(this);
+
+	return false;
 	}
 
 bool PE::EndOfFile()
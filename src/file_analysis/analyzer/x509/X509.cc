@@ -1,12 +1,16 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <list>
 #include <string>
+#include <unordered_map>
 
 #include "X509.h"
 #include "Event.h"
+#include "digest.h"
 
 #include "events.bif.h"
 #include "types.bif.h"
+#include "consts.bif.h"
 
 #include "file_analysis/Manager.h"
 
@@ -20,6 +24,27 @@
 
 using namespace file_analysis;
 
+namespace {
+
+// Certificates recently seen, keyed by the SHA-256 of their DER encoding.
+// The same few certificates make up most of what's on the wire, so this
+// saves parsing them over and over again.
+struct ParseCacheEntry {
+	X509Val* cert_val;
+	RecordVal* cert_record;
+	std::list<std::string>::iterator lru;
+};
+
+std::unordered_map<std::string, ParseCacheEntry> parse_cache;
+
+// Keys of the cached certificates, most recently used first.
+std::list<std::string> parse_cache_lru;
+
+uint64 parse_cache_hits = 0;
+uint64 parse_cache_misses = 0;
+
+}
+
 file_analysis::X509::X509(RecordVal* args, file_analysis::File* file)
 	: file_analysis::X509Common::X509Common(file_mgr->GetComponentTag("X509"), args, file)
 	{
@@ -38,8 +63,38 @@ bool file_analysis::X509::Undelivered(uint64 offset, uint64 len)
 	return false;
 	}
 
-bool file_analysis::X509::EndOfFile()
+bool file_analysis::X509::LookupOrParse(X509Val** cert_val, RecordVal** cert_record)
 	{
+	uint64 cache_size = BifConst::X509::parse_cache_size;
+	std::string key;
+
+	if ( cache_size )
+		{
+		u_char digest[SHA256_DIGEST_LENGTH];
+		EVP_MD_CTX* c = hash_init(Hash_SHA256);
+		hash_update(c, cert_data.data(), cert_data.size());
+		hash_final(c, digest);
+		key.assign(reinterpret_cast<const char*>(digest), sizeof(digest));
+
+		auto i = parse_cache.find(key);
+
+		if ( i != parse_cache.end() )
+			{
+			++parse_cache_hits;
+			parse_cache_lru.splice(parse_cache_lru.begin(), parse_cache_lru, i->second.lru);
+
+			*cert_val = i->second.cert_val;
+			(*cert_val)->Ref();
+
+			// Scripts may modify the record they get, so they
+			// get a copy rather than the cached one.
+			*cert_record = i->second.cert_record->Clone()->AsRecordVal();
+			return true;
+			}
+
+		++parse_cache_misses;
+		}
+
 	// ok, now we can try to parse the certificate with openssl. Should
 	// be rather straightforward...
 	const unsigned char* cert_char = reinterpret_cast<const unsigned char*>(cert_data.data());
@@ -51,10 +106,53 @@ bool file_analysis::X509::EndOfFile()
 		return false;
 		}
 
-	X509Val* cert_val = new X509Val(ssl_cert); // cert_val takes ownership of ssl_cert
+	*cert_val = new X509Val(ssl_cert); // cert_val takes ownership of ssl_cert
 
 	// parse basic information into record.
-	RecordVal* cert_record = ParseCertificate(cert_val, GetFile());
+	*cert_record = ParseCertificate(*cert_val, GetFile());
+
+	if ( ! cache_size )
+		return true;
+
+	while ( parse_cache.size() >= cache_size )
+		{
+		auto i = parse_cache.find(parse_cache_lru.back());
+		Unref(i->second.cert_val);
+		Unref(i->second.cert_record);
+		parse_cache.erase(i);
+		parse_cache_lru.pop_back();
+		}
+
+	parse_cache_lru.push_front(key);
+
+	ParseCacheEntry e;
+	e.cert_val = *cert_val;
+	e.cert_record = (*cert_record)->Clone()->AsRecordVal();
+	e.lru = parse_cache_lru.begin();
+	(*cert_val)->Ref();
+	parse_cache.insert(std::make_pair(key, e));
+
+	return true;
+	}
+
+file_analysis::X509::ParseCacheStats file_analysis::X509::GetParseCacheStats()
+	{
+	ParseCacheStats s;
+	s.hits = parse_cache_hits;
+	s.misses = parse_cache_misses;
+	s.entries = parse_cache.size();
+	return s;
+	}
+
+bool file_analysis::X509::EndOfFile()
+	{
+	X509Val* cert_val;
+	RecordVal* cert_record;
+
+	if ( ! LookupOrParse(&cert_val, &cert_record) )
+		return false;
+
+	::X509* ssl_cert = cert_val->GetCertificate();
 
 	// and send the record on to scriptland
 	mgr.QueueEvent(x509_certificate, {
@@ -304,21 +402,21 @@ void file_analysis::X509::ParseSAN(X509_EXTENSION* ext)
 				{
 				case GEN_DNS:
 					if ( names == 0 )
-						names = new VectorVal(internal_type("string_vec")->AsVectorType());
+						names = new VectorVal(string_vec);
 
 					names->Assign(names->Size(), bs);
 					break;
 
 				case GEN_URI:
 					if ( uris == 0 )
-						uris = new VectorVal(internal_type("string_vec")->AsVectorType());
+						uris = new VectorVal(string_vec);
 
 					uris->Assign(uris->Size(), bs);
 					break;
 
 				case GEN_EMAIL:
 					if ( emails == 0 )
-						emails = new VectorVal(internal_type("string_vec")->AsVectorType());
+						emails = new VectorVal(string_vec);
 
 					emails->Assign(emails->Size(), bs);
 					break;
@@ -87,6 +87,21 @@ public:
 	 */
 	static RecordVal* ParseCertificate(X509Val* cert_val, File* file = 0);
 
+	/**
+	 * Statistics of the cache of parsed certificates, see
+	 * \c X509::parse_cache_size.
+	 */
+	struct ParseCacheStats {
+		uint64 hits;	// Certificates found in the cache.
+		uint64 misses;	// Certificates that had to be parsed.
+		uint64 entries;	// Certificates currently cached.
+	};
+
+	/**
+	 * @return the statistics of the parse cache.
+	 */
+	static ParseCacheStats GetParseCacheStats();
+
 	static file_analysis::Analyzer* Instantiate(RecordVal* args, File* file)
 		{ return new X509(args, file); }
 
@@ -94,6 +109,11 @@ protected:
 	X509(RecordVal* args, File* file);
 
 private:
+	// Turns cert_data into a certificate and its record, taking them
+	// from the parse cache if possible. Returns false if the data
+	// doesn't parse. The caller gets a reference to both values.
+	bool LookupOrParse(X509Val** cert_val, RecordVal** cert_record);
+
 	void ParseBasicConstraints(X509_EXTENSION* ex);
 	void ParseSAN(X509_EXTENSION* ex);
 	void ParseExtensionsSpecific(X509_EXTENSION* ex, bool, ASN1_OBJECT*, const char*) override;
@@ -8,10 +8,12 @@
 
 using namespace input;
 
-Component::Component(const std::string& name, factory_callback arg_factory)
+Component::Component(const std::string& name, factory_callback arg_factory,
+                     bool arg_splittable)
 	: plugin::Component(plugin::component::READER, name)
 	{
 	factory = arg_factory;
+	splittable = arg_splittable;
 	}
 
 void Component::Initialize()
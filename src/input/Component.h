@@ -31,8 +31,13 @@ public:
 	 * input::ReaderBackend. This is typically a static \c Instatiate()
 	 * method inside the class that just allocates and returns a new
 	 * instance.
+	 *
+	 * @param splittable True if the reader can read a part of a file,
+	 * as set by ReaderBackend::ReaderInfo::part, so that several
+	 * instances can read one file together.
 	 */
-	Component(const std::string& name, factory_callback factory);
+	Component(const std::string& name, factory_callback factory,
+	          bool splittable = false);
 
 	/**
 	 * Destructor.
@@ -51,6 +56,11 @@ public:
 	 */
 	factory_callback Factory() const	{ return factory; }
 
+	/**
+	 * Returns true if the reader supports reading a part of a file.
+	 */
+	bool Splittable() const	{ return splittable; }
+
 protected:
 	/**
 	  * Overriden from plugin::Component.
@@ -59,6 +69,7 @@ protected:
 
 private:
 	factory_callback factory;
+	bool splittable;
 };
 
 }
@@ -0,0 +1,424 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+#include "FileWatcher.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef USE_INOTIFY
+#include <sys/inotify.h>
+#endif
+
+#ifdef USE_KQUEUE
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+#include "ReaderFrontend.h"
+#include "Timer.h"
+#include "util.h"
+
+using namespace input;
+
+FileWatcher::FileWatcher()
+	{
+#if defined(USE_INOTIFY)
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#elif defined(USE_KQUEUE)
+	fd = kqueue();
+
+	if ( fd >= 0 && fcntl(fd, F_SETFD, FD_CLOEXEC) < 0 )
+		{
+		close(fd);
+		fd = -1;
+		}
+#else
+	fd = -1;
+	errno = ENOSYS;
+#endif
+
+	// We only have something to do when our descriptor becomes ready.
+	SetIdle(true);
+	}
+
+FileWatcher::~FileWatcher()
+	{
+	while ( ! directories.empty() )
+		RemoveDirectory(directories.begin()->first, false);
+
+	if ( fd >= 0 )
+		close(fd);
+	}
+
+bool FileWatcher::Watch(ReaderFrontend* reader, const std::string& path,
+                        ReaderMode mode)
+	{
+	if ( fd < 0 || mode == MODE_MANUAL )
+		return false;
+
+	SafeDirname dir(path, false);
+	SafeBasename base(path, false);
+
+	if ( dir.error || base.error )
+		return false;
+
+	if ( ! AddEntry(dir.result, base.result, reader, mode) )
+		{
+		Unwatch(reader);
+		return false;
+		}
+
+	// A symlink only changes when it gets replaced; its target's
+	// directory needs to be watched, too, to see writes.
+	char resolved[PATH_MAX];
+	char resolved_dir[PATH_MAX];
+
+	if ( ! realpath(path.c_str(), resolved) ||
+	     ! realpath(dir.result.c_str(), resolved_dir) ||
+	     std::string(resolved_dir) + "/" + base.result == resolved )
+		return true;
+
+	SafeDirname rdir(resolved, false);
+	SafeBasename rbase(resolved, false);
+
+	if ( rdir.error || rbase.error ||
+	     ! AddEntry(rdir.result, rbase.result, reader, mode) )
+		{
+		Unwatch(reader);
+		return false;
+		}
+
+	return true;
+	}
+
+bool FileWatcher::AddEntry(const std::string& dir, const std::string& name,
+                           ReaderFrontend* reader, ReaderMode mode)
+	{
+	Entry e;
+	e.name = name;
+	e.reader = reader;
+
+	int id = -1;
+
+#if defined(USE_INOTIFY)
+	// For rereading, only the end of a write matters. IN_ATTRIB catches
+	// updates of the modification time only.
+	if ( mode == MODE_REREAD )
+		e.mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB;
+	else
+		e.mask = IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+
+	// Watching the directory instead of the file itself sees the file
+	// getting replaced. Adding to an existing watch returns the same
+	// descriptor.
+	id = inotify_add_watch(fd, dir.c_str(), e.mask | IN_ONLYDIR | IN_MASK_ADD |
+	                       IN_DELETE_SELF | IN_MOVE_SELF);
+
+	if ( id < 0 )
+		return false;
+
+#elif defined(USE_KQUEUE)
+	if ( mode == MODE_REREAD )
+		e.mask = NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB;
+	else
+		e.mask = NOTE_WRITE | NOTE_EXTEND;
+
+	e.fd = -1;
+
+	std::map<std::string, int>::const_iterator i = directory_ids.find(dir);
+
+	if ( i != directory_ids.end() )
+		id = i->second;
+
+	else
+		{
+		// kqueue needs an open descriptor for everything it watches.
+		// The directory changes when entries get added or removed.
+		id = open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+
+		if ( id < 0 )
+			return false;
+
+		struct kevent ev;
+		EV_SET(&ev, id, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+		       NOTE_WRITE | NOTE_DELETE | NOTE_RENAME, 0, 0);
+
+		if ( kevent(fd, &ev, 1, 0, 0, 0) < 0 )
+			{
+			int err = errno;
+			close(id);
+			errno = err;
+			return false;
+			}
+		}
+
+	OpenEntry(&e, dir);
+#else
+	return false;
+#endif
+
+	Directory& d = directories[id];
+
+	if ( d.path.empty() )
+		{
+		d.path = dir;
+		directory_ids[dir] = id;
+		}
+
+	d.entries.push_back(e);
+	return true;
+	}
+
+void FileWatcher::Unwatch(ReaderFrontend* reader)
+	{
+	triggered.erase(reader);
+
+	std::vector<int> empty;
+
+	for ( auto& d : directories )
+		{
+		std::vector<Entry>& entries = d.second.entries;
+
+		for ( std::vector<Entry>::iterator e = entries.begin(); e != entries.end(); )
+			{
+			if ( e->reader != reader )
+				{
+				++e;
+				continue;
+				}
+
+#ifdef USE_KQUEUE
+			CloseEntry(&*e);
+#endif
+			e = entries.erase(e);
+			}
+
+		if ( entries.empty() )
+			empty.push_back(d.first);
+		}
+
+	for ( auto id : empty )
+		RemoveDirectory(id, false);
+	}
+
+void FileWatcher::RemoveDirectory(int id, bool notify)
+	{
+	std::map<int, Directory>::iterator i = directories.find(id);
+
+	if ( i == directories.end() )
+		return;
+
+	for ( auto& e : i->second.entries )
+		{
+#ifdef USE_KQUEUE
+		CloseEntry(&e);
+#endif
+
+		if ( notify )
+			{
+			// Let the reader go back to polling, it will ask for
+			// a new watch once it found its file again.
+			triggered.erase(e.reader);
+			e.reader->SetWatched(false);
+			}
+		}
+
+#if defined(USE_INOTIFY)
+	// Fails if the kernel removed the watch already, that's fine.
+	inotify_rm_watch(fd, id);
+#elif defined(USE_KQUEUE)
+	close(id);
+#endif
+
+	directory_ids.erase(i->second.path);
+	directories.erase(i);
+	}
+
+void FileWatcher::Trigger(ReaderFrontend* reader)
+	{
+	if ( ! reader->Disabled() )
+		triggered.insert(reader);
+	}
+
+void FileWatcher::GetFds(iosource::FD_Set* read, iosource::FD_Set* write,
+                         iosource::FD_Set* except)
+	{
+	if ( fd >= 0 && ! directories.empty() )
+		read->Insert(fd);
+	}
+
+double FileWatcher::NextTimestamp(double* network_time)
+	{
+	// Only called once our descriptor is ready.
+	return timer_mgr->Time();
+	}
+
+void FileWatcher::Process()
+	{
+#if defined(USE_INOTIFY)
+	ReadInotify();
+#elif defined(USE_KQUEUE)
+	ReadKqueue();
+#endif
+
+	// A writer may have caused many events, the reader only needs to
+	// look once.
+	std::set<ReaderFrontend*> readers;
+	readers.swap(triggered);
+
+	for ( auto r : readers )
+		r->Update();
+	}
+
+#ifdef USE_INOTIFY
+
+void FileWatcher::ReadInotify()
+	{
+	char buf[16384] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	for ( ;; )
+		{
+		ssize_t len = read(fd, buf, sizeof(buf));
+
+		if ( len < 0 && errno == EINTR )
+			continue;
+
+		if ( len <= 0 )
+			break;
+
+		for ( char* p = buf; p < buf + len; )
+			{
+			const struct inotify_event* ev = (const struct inotify_event*) p;
+			p += sizeof(struct inotify_event) + ev->len;
+
+			if ( ev->mask & IN_Q_OVERFLOW )
+				{
+				// Events got lost, everybody has to look.
+				for ( const auto& d : directories )
+					for ( const auto& e : d.second.entries )
+						Trigger(e.reader);
+
+				continue;
+				}
+
+			if ( ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF) )
+				{
+				RemoveDirectory(ev->wd, true);
+				continue;
+				}
+
+			std::map<int, Directory>::const_iterator d = directories.find(ev->wd);
+
+			if ( d == directories.end() || ! ev->len )
+				continue;
+
+			for ( const auto& e : d->second.entries )
+				{
+				if ( (ev->mask & e.mask) && e.name == ev->name )
+					Trigger(e.reader);
+				}
+			}
+		}
+	}
+
+#endif
+
+#ifdef USE_KQUEUE
+
+void FileWatcher::OpenEntry(Entry* e, const std::string& dir)
+	{
+	std::string path = dir + "/" + e->name;
+	e->fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if ( e->fd < 0 )
+		// Doesn't exist (yet), we'll see it appear in the directory.
+		return;
+
+	struct kevent ev;
+	EV_SET(&ev, e->fd, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+	       e->mask | NOTE_DELETE | NOTE_RENAME, 0, 0);
+
+	if ( kevent(fd, &ev, 1, 0, 0, 0) < 0 )
+		CloseEntry(e);
+	}
+
+void FileWatcher::CloseEntry(Entry* e)
+	{
+	// Closing removes the kevent, too.
+	if ( e->fd >= 0 )
+		close(e->fd);
+
+	e->fd = -1;
+	}
+
+void FileWatcher::ReadKqueue()
+	{
+	struct kevent evs[64];
+	struct timespec zero = { 0, 0 };
+
+	for ( ;; )
+		{
+		int n = kevent(fd, 0, 0, evs, 64, &zero);
+
+		if ( n < 0 && errno == EINTR )
+			continue;
+
+		if ( n <= 0 )
+			break;
+
+		for ( int i = 0; i < n; ++i )
+			{
+			int id = evs[i].ident;
+			unsigned int fflags = evs[i].fflags;
+
+			std::map<int, Directory>::iterator d = directories.find(id);
+
+			if ( d != directories.end() )
+				{
+				if ( fflags & (NOTE_DELETE | NOTE_RENAME) )
+					{
+					RemoveDirectory(id, true);
+					continue;
+					}
+
+				// Entries got added or removed; a watched file
+				// may have been replaced.
+				for ( auto& e : d->second.entries )
+					{
+					CloseEntry(&e);
+					OpenEntry(&e, d->second.path);
+					Trigger(e.reader);
+					}
+
+				continue;
+				}
+
+			for ( auto& dir : directories )
+				{
+				for ( auto& e : dir.second.entries )
+					{
+					if ( e.fd != id )
+						continue;
+
+					if ( fflags & e.mask )
+						Trigger(e.reader);
+
+					if ( fflags & (NOTE_DELETE | NOTE_RENAME) )
+						// Reopened once the directory
+						// changes.
+						CloseEntry(&e);
+					}
+				}
+			}
+
+		if ( n < 64 )
+			break;
+		}
+	}
+
+#endif
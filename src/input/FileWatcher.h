@@ -0,0 +1,116 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Notifies readers about changes to their input files, so that they don't
+// have to check for them on every heartbeat. Uses inotify on Linux and
+// kqueue on the BSDs and macOS.
+
+#ifndef INPUT_FILEWATCHER_H
+#define INPUT_FILEWATCHER_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "iosource/IOSource.h"
+#include "ReaderBackend.h"
+
+#if defined(HAVE_LINUX)
+#define USE_INOTIFY
+#elif defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__APPLE__)
+#define USE_KQUEUE
+#endif
+
+namespace input {
+
+class ReaderFrontend;
+
+/**
+ * An IOSource that watches input files for changes and triggers an update
+ * of the readers using them. Only one instance gets created, by the input
+ * manager, the first time a reader asks for a watch.
+ */
+class FileWatcher : public iosource::IOSource {
+public:
+	FileWatcher();
+	~FileWatcher() override;
+
+	/**
+	 * Returns true if the watcher is usable. If not, readers have to keep
+	 * polling their files.
+	 */
+	bool IsOK() const	{ return fd >= 0; }
+
+	/**
+	 * Starts watching a file on behalf of a reader.
+	 *
+	 * @param reader The reader to update when the file changes.
+	 *
+	 * @param path The file. It doesn't need to exist yet.
+	 *
+	 * @param mode The reader's mode, which determines which changes are
+	 * of interest: for MODE_REREAD only ones that complete a write,
+	 * for MODE_STREAM any data appended.
+	 *
+	 * @return False if the file couldn't be watched.
+	 */
+	bool Watch(ReaderFrontend* reader, const std::string& path,
+	           ReaderMode mode);
+
+	/**
+	 * Stops watching all files of a reader. Must be called before the
+	 * reader goes away.
+	 */
+	void Unwatch(ReaderFrontend* reader);
+
+	// IOSource interface.
+	void GetFds(iosource::FD_Set* read, iosource::FD_Set* write,
+	            iosource::FD_Set* except) override;
+	double NextTimestamp(double* network_time) override;
+	void Process() override;
+	const char* Tag() override	{ return "input::FileWatcher"; }
+
+private:
+	// A file being watched for a reader.
+	struct Entry {
+		std::string name;	// File name within the directory.
+		ReaderFrontend* reader;
+		unsigned int mask;	// Changes of interest.
+#ifdef USE_KQUEUE
+		int fd;			// Open descriptor of the file, or -1.
+#endif
+	};
+
+	// A directory with watched files, keyed by inotify watch
+	// descriptor or, for kqueue, the directory's open descriptor.
+	struct Directory {
+		std::string path;
+		std::vector<Entry> entries;
+	};
+
+	bool AddEntry(const std::string& dir, const std::string& name,
+	              ReaderFrontend* reader, ReaderMode mode);
+	void RemoveDirectory(int id, bool notify);
+	void Trigger(ReaderFrontend* reader);
+
+#ifdef USE_KQUEUE
+	void OpenEntry(Entry* e, const std::string& dir);
+	void CloseEntry(Entry* e);
+	void ReadKqueue();
+#endif
+
+#ifdef USE_INOTIFY
+	void ReadInotify();
+#endif
+
+	int fd;
+	std::map<int, Directory> directories;
+	std::map<std::string, int> directory_ids;
+
+	// Readers to update at the end of the current Process().
+	std::set<ReaderFrontend*> triggered;
+};
+
+}
+
+#endif /* INPUT_FILEWATCHER_H */
@@ -1,8 +1,14 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
 #include <algorithm>
+#include <set>
+#include <glob.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "Manager.h"
+#include "FileWatcher.h"
 #include "ReaderFrontend.h"
 #include "ReaderBackend.h"
 #include "input.bif.h"
@@ -14,6 +20,7 @@
 #include "CompHash.h"
 
 #include "../file_analysis/Manager.h"
+#include "../iosource/Manager.h"
 #include "../threading/SerialTypes.h"
 
 using namespace input;
@@ -54,6 +61,74 @@ static void input_hash_delete_func(void* val)
 
 declare(PDict, InputHash);
 
+/**
+ * One of the sources a stream reads: its file, or with a glob, one of the
+ * files matched. A source has several readers if it's split into parts.
+ */
+class Manager::Source {
+public:
+	vector<ReaderFrontend*> readers;
+
+	// Number of readers that haven't ended the current pass over their
+	// part of the source yet.
+	int pending;
+
+	// For table streams, what the source put into the table. Rows of
+	// the current pass go into currDict; the ones of the previous pass
+	// that haven't shown up again are left in lastDict.
+	PDict(InputHash)* currDict;
+	PDict(InputHash)* lastDict;
+
+	// For the first pass over the source of a stream without predicate
+	// and event, the table the rows get collected in before they go
+	// into the destination all at once. size_hint is how many rows the
+	// readers expect.
+	TableVal* staging;
+	int size_hint;
+	bool loaded;
+
+	// Notes that one of the readers ended its pass. Returns true if
+	// that ends the pass over the whole source.
+	bool EndPart();
+
+	Source();
+	~Source();
+};
+
+Manager::Source::Source()
+	: readers(), pending(), staging(), size_hint(), loaded()
+	{
+	currDict = new PDict(InputHash);
+	currDict->SetDeleteFunc(input_hash_delete_func);
+	lastDict = new PDict(InputHash);
+	lastDict->SetDeleteFunc(input_hash_delete_func);
+	}
+
+Manager::Source::~Source()
+	{
+	for ( auto r : readers )
+		delete r;
+
+	Unref(staging);
+
+	currDict->Clear();
+	delete currDict;
+	lastDict->Clear();
+	delete lastDict;
+	}
+
+bool Manager::Source::EndPart()
+	{
+	if ( pending > 1 )
+		{
+		--pending;
+		return false;
+		}
+
+	pending = readers.size();
+	return true;
+	}
+
 /**
  * Base stuff that every stream can do.
  */
@@ -65,12 +140,31 @@ public:
 	StreamType stream_type; // to distinguish between event and table streams
 
 	EnumVal* type;
-	ReaderFrontend* reader;
+	ReaderFrontend* reader; // the first of the readers
 	TableVal* config;
 	EventHandlerPtr error_event;
 
 	RecordVal* description;
 
+	// The source as given in the description.
+	string source;
+
+	// What the stream reads, and which reader reads which source.
+	vector<Source*> sources;
+	map<ReaderFrontend*, Source*> reader_sources;
+
+	// Number of sources still in the first pass, or the one a forced
+	// update started. End-of-Data waits for them.
+	int pending;
+
+	Source* SourceOf(ReaderFrontend* r) const
+		{
+		auto s = reader_sources.find(r);
+		return s != reader_sources.end() ? s->second : 0;
+		}
+
+	void StopReaders();
+
 	virtual ~Stream();
 
 protected:
@@ -79,7 +173,8 @@ protected:
 
 Manager::Stream::Stream(StreamType t)
     : name(), removed(), stream_type(t), type(), reader(), config(),
-      error_event(), description()
+      error_event(), description(), source(), sources(), reader_sources(),
+      pending()
 	{
 	}
 
@@ -94,8 +189,15 @@ Manager::Stream::~Stream()
 	if ( config )
 		Unref(config);
 
-	if ( reader )
-	        delete(reader);
+	for ( auto s : sources )
+		delete s;
+	}
+
+void Manager::Stream::StopReaders()
+	{
+	for ( auto s : sources )
+		for ( auto r : s->readers )
+			r->Stop();
 	}
 
 class Manager::TableStream: public Manager::Stream {
@@ -109,8 +211,10 @@ public:
 	RecordType* rtype;
 	RecordType* itype;
 
-	PDict(InputHash)* currDict;
-	PDict(InputHash)* lastDict;
+	// True if the readers only send rows that changed since their
+	// previous pass, and name the removed ones at the end. Rows then
+	// go straight into their source's lastDict, which stays current.
+	bool changes_only;
 
 	Func* pred;
 
@@ -143,7 +247,7 @@ public:
 Manager::TableStream::TableStream()
 	: Manager::Stream::Stream(TABLE_STREAM),
 	  num_idx_fields(), num_val_fields(), want_record(), tab(), rtype(),
-	  itype(), currDict(), lastDict(), pred(), event()
+	  itype(), changes_only(), pred(), event()
 	{
 	}
 
@@ -169,18 +273,6 @@ Manager::TableStream::~TableStream()
 
 	if ( rtype ) // can be 0 for sets
 		Unref(rtype);
-
-        if ( currDict != 0 )
-		{
-		currDict->Clear();
-	        delete currDict;
-		}
-
-        if ( lastDict != 0 )
-		{
-		lastDict->Clear();;
-	        delete lastDict;
-		}
 	}
 
 Manager::AnalysisStream::AnalysisStream()
@@ -196,16 +288,20 @@ Manager::Manager()
 	: plugin::ComponentManager<input::Tag, input::Component>("Input", "Reader")
 	{
 	end_of_data = internal_handler("Input::end_of_data");
+	watcher = 0;
+	watcher_failed = false;
 	}
 
 Manager::~Manager()
 	{
+	// Streams delete their readers.
+	std::set<Stream*> streams;
+
 	for ( map<ReaderFrontend*, Stream*>::iterator s = readers.begin(); s != readers.end(); ++s )
-		{
-		delete s->second;
-		delete s->first;
-		}
+		streams.insert(s->second);
 
+	for ( auto s : streams )
+		delete s;
 	}
 
 ReaderBackend* Manager::CreateBackend(ReaderFrontend* frontend, EnumVal* tag)
@@ -224,6 +320,39 @@ ReaderBackend* Manager::CreateBackend(ReaderFrontend* frontend, EnumVal* tag)
 	return backend;
 	}
 
+// Returns the regular files a glob pattern matches, or the ones in a
+// directory, sorted. Relative paths get made absolute, so that readers
+// don't apply a path prefix of their own.
+static vector<string> expand_glob(const string& arg_pattern)
+	{
+	vector<string> paths;
+	string pattern = arg_pattern;
+	struct stat st;
+
+	if ( stat(pattern.c_str(), &st) == 0 && S_ISDIR(st.st_mode) )
+		pattern += "/*";
+
+	string cwd;
+	char buf[PATH_MAX];
+
+	if ( pattern.front() != '/' && getcwd(buf, sizeof(buf)) )
+		cwd = string(buf) + "/";
+
+	glob_t g;
+
+	if ( glob(pattern.c_str(), 0, 0, &g) == 0 )
+		{
+		for ( size_t i = 0; i < g.gl_pathc; ++i )
+			{
+			if ( stat(g.gl_pathv[i], &st) == 0 && S_ISREG(st.st_mode) )
+				paths.push_back(cwd + g.gl_pathv[i]);
+			}
+		}
+
+	globfree(&g);
+	return paths;
+	}
+
 // Create a new input reader object to be used at whomevers leisure later on.
 bool Manager::CreateStream(Stream* info, RecordVal* description)
 	{
@@ -306,10 +435,77 @@ bool Manager::CreateStream(Stream* info, RecordVal* description)
 		}
 
 
-	ReaderFrontend* reader_obj = new ReaderFrontend(rinfo, reader);
-	assert(reader_obj);
+	bool glob = false;
+	bro_uint_t splits = 1;
+
+	if ( rtype->FieldOffset("glob") >= 0 )
+		{
+		Val* glob_val = description->Lookup("glob", true);
+		glob = glob_val->AsBool();
+		Unref(glob_val);
+		}
+
+	if ( rtype->FieldOffset("splits") >= 0 )
+		{
+		Val* splits_val = description->Lookup("splits", true);
+		splits = splits_val->AsCount();
+		Unref(splits_val);
+		}
+
+	vector<string> paths;
+
+	if ( glob )
+		{
+		paths = expand_glob(source);
+
+		if ( paths.empty() )
+			{
+			reporter->Error("Input stream %s: no files match %s",
+			                name.c_str(), source.c_str());
+			Unref(reader);
+			return false;
+			}
+		}
+	else
+		paths.push_back(source);
+
+	int parts = 1;
+
+	if ( splits > 1 && rinfo.mode != MODE_STREAM )
+		{
+		Component* c = Lookup(reader);
+
+		if ( c && c->Splittable() )
+			parts = std::min(splits, bro_uint_t(256));
+		else
+			reporter->Warning("Input stream %s: reader cannot split files, reading them in one piece",
+			                  name.c_str());
+		}
+
+	for ( const auto& path : paths )
+		{
+		Source* s = new Source();
+		info->sources.push_back(s);
+
+		for ( int part = 0; part < parts; ++part )
+			{
+			ReaderBackend::ReaderInfo pinfo(rinfo);
+			delete [] pinfo.source;
+			pinfo.source = copy_string(path.c_str());
+			pinfo.part = part;
+			pinfo.num_parts = parts;
+
+			ReaderFrontend* reader_obj = new ReaderFrontend(pinfo, reader);
+			s->readers.push_back(reader_obj);
+			info->reader_sources[reader_obj] = s;
+			}
+
+		s->pending = parts;
+		}
 
-	info->reader = reader_obj;
+	info->reader = info->sources[0]->readers[0];
+	info->pending = info->sources.size();
+	info->source = source;
 	info->type = reader->AsEnumVal(); // ref'd by lookupwithdefault
 	info->name = name;
 
@@ -472,9 +668,7 @@ bool Manager::CreateEventStream(RecordVal* fval)
 
 	assert(stream->reader);
 
-	stream->reader->Init(stream->num_fields, logf );
-
-	readers[stream->reader] = stream;
+	InitReaders(stream, stream->num_fields, logf);
 
 	DBG_LOG(DBG_INPUT, "Successfully created event stream %s",
 		stream->name.c_str());
@@ -482,6 +676,41 @@ bool Manager::CreateEventStream(RecordVal* fval)
 	return true;
 }
 
+void Manager::InitReaders(Stream* i, int num_fields, const Field* const* fields,
+                          int num_index_fields)
+	{
+	// The backends take ownership of their fields, so all readers but
+	// the first get copies, made before any of them starts.
+	vector<const Field* const*> reader_fields = { fields };
+
+	for ( auto s : i->sources )
+		{
+		for ( size_t k = 0; k < s->readers.size(); ++k )
+			{
+			if ( s == i->sources[0] && k == 0 )
+				continue;
+
+			Field** copy = new Field*[num_fields];
+
+			for ( int j = 0; j < num_fields; ++j )
+				copy[j] = new Field(*fields[j]);
+
+			reader_fields.push_back(copy);
+			}
+		}
+
+	size_t n = 0;
+
+	for ( auto s : i->sources )
+		{
+		for ( auto r : s->readers )
+			{
+			r->Init(num_fields, reader_fields[n++], num_index_fields);
+			readers[r] = i;
+			}
+		}
+	}
+
 bool Manager::CreateTableStream(RecordVal* fval)
 	{
 	RecordType* rtype = fval->Type()->AsRecordType();
@@ -703,19 +932,21 @@ bool Manager::CreateTableStream(RecordVal* fval)
 	stream->itype = idx->AsRecordType();
 	stream->event = event ? event_registry->Lookup(event->Name()) : 0;
 	stream->error_event = error_event ? event_registry->Lookup(error_event->Name()) : nullptr;
-	stream->currDict = new PDict(InputHash);
-	stream->currDict->SetDeleteFunc(input_hash_delete_func);
-	stream->lastDict = new PDict(InputHash);
-	stream->lastDict->SetDeleteFunc(input_hash_delete_func);
 	stream->want_record = ( want_record->InternalInt() == 1 );
 
+	// Without a predicate, whether a row gets into the table only
+	// depends on the row, so rows that didn't change since the previous
+	// pass don't need to come over from the reader thread.
+	// Readers sharing a source can't tell what the others removed.
+	stream->changes_only = ( ! pred && stream->reader->Info().mode == MODE_REREAD &&
+	                         stream->reader->Info().num_parts == 1 );
+
 	Unref(want_record); // ref'd by lookupwithdefault
 	Unref(pred);
 
 	assert(stream->reader);
-	stream->reader->Init(fieldsV.size(), fields );
-
-	readers[stream->reader] = stream;
+	InitReaders(stream, fieldsV.size(), fields,
+	            stream->changes_only ? idxfields : 0);
 
 	DBG_LOG(DBG_INPUT, "Successfully created table stream %s",
 		stream->name.c_str());
@@ -873,7 +1104,7 @@ bool Manager::RemoveStream(Stream *i)
 	DBG_LOG(DBG_INPUT, "Successfully queued removal of stream %s",
 		i->name.c_str());
 
-	i->reader->Stop();
+	i->StopReaders();
 
 	return true;
 	}
@@ -906,6 +1137,14 @@ bool Manager::RemoveStreamContinuation(ReaderFrontend* reader)
 #endif
 
 	readers.erase(reader);
+
+	// Wait for the others.
+	for ( const auto& r : i->reader_sources )
+		{
+		if ( readers.count(r.first) )
+			return true;
+		}
+
 	delete(i);
 
 	return true;
@@ -1010,7 +1249,11 @@ bool Manager::ForceUpdate(const string &name)
 		return false;
 		}
 
-	i->reader->Update();
+	i->pending = i->sources.size();
+
+	for ( auto s : i->sources )
+		for ( auto r : s->readers )
+			r->Update();
 
 #ifdef DEBUG
 	DBG_LOG(DBG_INPUT, "Forcing update of stream %s", name.c_str());
@@ -1092,7 +1335,7 @@ void Manager::SendEntry(ReaderFrontend* reader, Value* *vals)
 	int readFields = 0;
 
 	if ( i->stream_type == TABLE_STREAM )
-		readFields = SendEntryTable(i, vals);
+		readFields = SendEntryTable(i, i->SourceOf(reader), vals);
 
 	else if ( i->stream_type == EVENT_STREAM )
 		{
@@ -1115,14 +1358,30 @@ void Manager::SendEntry(ReaderFrontend* reader, Value* *vals)
 	delete_value_ptr_array(vals, readFields);
 	}
 
-int Manager::SendEntryTable(Stream* i, const Value* const *vals)
+int Manager::SendEntryTable(Stream* i, Source* src, const Value* const *vals)
 	{
 	bool updated = false;
 
 	assert(i);
+	assert(src);
 
 	assert(i->stream_type == TABLE_STREAM);
 	TableStream* stream = (TableStream*) i;
+	PDict(InputHash)* currDict = stream->changes_only ? src->lastDict : src->currDict;
+	TableVal* tab = stream->tab;
+
+	if ( ! src->loaded && ! stream->pred && ! stream->event )
+		{
+		// Nothing can look at the rows one by one, so they can go in
+		// together once all are there.
+		if ( ! src->staging )
+			{
+			src->staging = new TableVal(stream->tab->Type()->AsTableType());
+			src->staging->Reserve(src->size_hint);
+			}
+
+		tab = src->staging;
+		}
 
 	HashKey* idxhash = HashValues(stream->num_idx_fields, vals);
 
@@ -1148,15 +1407,15 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 			}
 		}
 
-	InputHash *h = stream->lastDict->Lookup(idxhash);
+	InputHash *h = src->lastDict->Lookup(idxhash);
 	if ( h != 0 )
 		{
 		// seen before
 		if ( stream->num_val_fields == 0 || h->valhash == valhash )
 			{
 			// ok, exact duplicate, move entry to new dicrionary and do nothing else.
-			stream->lastDict->Remove(idxhash);
-			stream->currDict->Insert(idxhash, h);
+			src->lastDict->Remove(idxhash);
+			currDict->Insert(idxhash, h);
 			delete idxhash;
 			return stream->num_val_fields + stream->num_idx_fields;
 			}
@@ -1165,7 +1424,7 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 			{
 			assert( stream->num_val_fields > 0 );
 			// entry was updated in some way
-			stream->lastDict->Remove(idxhash);
+			src->lastDict->Remove(idxhash);
 			// keep h for predicates
 			updated = true;
 			}
@@ -1227,7 +1486,7 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 				else
 					{
 					// keep old one
-					stream->currDict->Insert(idxhash, h);
+					currDict->Insert(idxhash, h);
 					delete idxhash;
 					return stream->num_val_fields + stream->num_idx_fields;
 					}
@@ -1267,10 +1526,10 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 		{
 		assert(stream->num_val_fields > 0);
 		// in that case, we need the old value to send the event (if we send an event).
-		oldval = stream->tab->Lookup(idxval, false);
+		oldval = tab->Lookup(idxval, false);
 		}
 
-	HashKey* k = stream->tab->ComputeHash(idxval);
+	HashKey* k = tab->ComputeHash(idxval);
 	if ( ! k )
 		reporter->InternalError("could not hash");
 
@@ -1281,13 +1540,13 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 	if ( oldval && stream->event && updated )
 		Ref(oldval); // otherwise it is no longer accessible after the assignment
 
-	stream->tab->Assign(idxval, k, valval);
+	tab->Assign(idxval, k, valval);
 	Unref(idxval); // asssign does not consume idxval.
 
 	if ( predidx != 0 )
 		Unref(predidx);
 
-	stream->currDict->Insert(idxhash, ih);
+	currDict->Insert(idxhash, ih);
 	delete idxhash;
 
 	if ( stream->event )
@@ -1325,7 +1584,7 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 	return stream->num_val_fields + stream->num_idx_fields;
 	}
 
-void Manager::EndCurrentSend(ReaderFrontend* reader)
+void Manager::EndCurrentSend(ReaderFrontend* reader, std::vector<std::string>* removed)
 	{
 	Stream *i = FindStream(reader);
 
@@ -1340,26 +1599,76 @@ void Manager::EndCurrentSend(ReaderFrontend* reader)
 	DBG_LOG(DBG_INPUT, "Got EndCurrentSend stream %s", i->name.c_str());
 #endif
 
+	Source* src = i->SourceOf(reader);
+
+	if ( ! src->EndPart() )
+		// Rows this reader didn't see may still come from the other
+		// parts of the source.
+		return;
+
 	if ( i->stream_type != TABLE_STREAM )
 		{
 #ifdef DEBUG
 	DBG_LOG(DBG_INPUT, "%s is event, sending end of data", i->name.c_str());
 #endif
 		// just signal the end of the data source
-		SendEndOfData(i);
+		EndOfPass(i);
 		return;
 		}
 
 	assert(i->stream_type == TABLE_STREAM);
 	TableStream* stream = (TableStream*) i;
 
+	if ( src->staging )
+		{
+		TableVal* staging = src->staging;
+		src->staging = 0;
+
+		if ( stream->tab->Size() == 0 )
+			stream->tab->TakeEntries(staging);
+		else
+			{
+			// Keep what's there already.
+			const PDict(TableEntryVal)* tbl = staging->AsTable();
+			IterCookie* c = tbl->InitForIteration();
+			TableEntryVal* v;
+			HashKey* k;
+
+			while ( (v = tbl->NextEntry(k, c)) )
+				{
+				Val* v_val = v->Value();
+				stream->tab->Assign(0, k, v_val ? v_val->Ref() : 0);
+				}
+			}
+
+		Unref(staging);
+		}
+
+	src->loaded = true;
+
+	if ( stream->changes_only && removed )
+		{
+		// lastDict holds everything; move the removed entries over and
+		// swap, so that they get handled like below.
+		for ( const auto& key : *removed )
+			{
+			HashKey k(key.data(), key.size());
+			InputHash* ih = src->lastDict->RemoveEntry(&k);
+
+			if ( ih )
+				src->currDict->Insert(&k, ih);
+			}
+
+		std::swap(src->lastDict, src->currDict);
+		}
+
 	// lastdict contains all deleted entries and should be empty apart from that
-	IterCookie *c = stream->lastDict->InitForIteration();
-	stream->lastDict->MakeRobustCookie(c);
+	IterCookie *c = src->lastDict->InitForIteration();
+	src->lastDict->MakeRobustCookie(c);
 	InputHash* ih;
 	HashKey *lastDictIdxKey;
 
-	while ( ( ih = stream->lastDict->NextEntry(lastDictIdxKey, c) ) )
+	while ( ( ih = src->lastDict->NextEntry(lastDictIdxKey, c) ) )
 		{
 		ListVal * idx = 0;
 		Val *val = 0;
@@ -1395,7 +1704,7 @@ void Manager::EndCurrentSend(ReaderFrontend* reader)
 				// ah well - and we have to add the entry to currDict...
 				Unref(predidx);
 				Unref(ev);
-				stream->currDict->Insert(lastDictIdxKey, stream->lastDict->RemoveEntry(lastDictIdxKey));
+				src->currDict->Insert(lastDictIdxKey, src->lastDict->RemoveEntry(lastDictIdxKey));
 				delete lastDictIdxKey;
 				continue;
 				}
@@ -1416,24 +1725,24 @@ void Manager::EndCurrentSend(ReaderFrontend* reader)
 			Unref(ev);
 
 		Unref(stream->tab->Delete(ih->idxkey));
-		stream->lastDict->Remove(lastDictIdxKey); // delete in next line
+		src->lastDict->Remove(lastDictIdxKey); // delete in next line
 		delete lastDictIdxKey;
 		delete(ih);
 		}
 
-	stream->lastDict->Clear(); // should be empt. buti- well... who knows...
-	delete(stream->lastDict);
+	src->lastDict->Clear(); // should be empt. buti- well... who knows...
+	delete(src->lastDict);
 
-	stream->lastDict = stream->currDict;
-	stream->currDict = new PDict(InputHash);
-	stream->currDict->SetDeleteFunc(input_hash_delete_func);
+	src->lastDict = src->currDict;
+	src->currDict = new PDict(InputHash);
+	src->currDict->SetDeleteFunc(input_hash_delete_func);
 
 #ifdef DEBUG
 	DBG_LOG(DBG_INPUT, "EndCurrentSend complete for stream %s",
 		i->name.c_str());
 #endif
 
-	SendEndOfData(i);
+	EndOfPass(i);
 	}
 
 void Manager::SendEndOfData(ReaderFrontend* reader)
@@ -1447,6 +1756,22 @@ void Manager::SendEndOfData(ReaderFrontend* reader)
 		return;
 		}
 
+	if ( i->SourceOf(reader)->EndPart() )
+		EndOfPass(i);
+	}
+
+void Manager::EndOfPass(Stream* i)
+	{
+	// Until all sources are through with the first pass, or the one
+	// of a forced update, count them down. After that, sources that
+	// get reread on their own each end a pass.
+	if ( i->pending > 1 )
+		{
+		--i->pending;
+		return;
+		}
+
+	i->pending = 0;
 	SendEndOfData(i);
 	}
 
@@ -1458,7 +1783,7 @@ void Manager::SendEndOfData(const Stream *i)
 		i->name.c_str());
 #endif
 	SendEvent(end_of_data, 2, new StringVal(i->name.c_str()),
-	          new StringVal(i->reader->Info().source));
+	          new StringVal(i->source.c_str()));
 
 	if ( i->stream_type == ANALYSIS_STREAM )
 		file_mgr->EndOfFile(static_cast<const AnalysisStream*>(i)->file_id);
@@ -1716,6 +2041,77 @@ void Manager::Clear(ReaderFrontend* reader)
 	stream->tab->RemoveAll();
 	}
 
+void Manager::SizeHint(ReaderFrontend* reader, int num_entries)
+	{
+	Stream *i = FindStream(reader);
+	if ( i == 0 )
+		{
+		reporter->InternalWarning("Unknown reader %s in SizeHint",
+		                          reader->Name());
+		return;
+		}
+
+	if ( i->stream_type != TABLE_STREAM )
+		return;
+
+	// Don't set aside more than a reasonable amount on a bad guess.
+	const int max_hint = 1 << 24;
+	// Each of the source's readers guesses for its own part.
+	Source* src = i->SourceOf(reader);
+	int64 n = int64(std::max(num_entries, 0)) * src->readers.size();
+	src->size_hint = int(std::min(n, int64(max_hint)));
+	}
+
+void Manager::WatchFile(ReaderFrontend* reader, const string& path)
+	{
+	Stream *i = FindStream(reader);
+	if ( i == 0 )
+		{
+		reporter->InternalWarning("Unknown reader %s in WatchFile",
+		                          reader->Name());
+		return;
+		}
+
+	// Without a watch, the reader just keeps checking itself.
+	if ( i->removed || ! BifConst::Input::watch_files || watcher_failed )
+		return;
+
+	if ( ! watcher )
+		{
+		FileWatcher* w = new FileWatcher();
+
+		if ( ! w->IsOK() )
+			{
+			reporter->Warning("cannot watch input files for changes, falling back to polling: %s",
+			                  strerror(errno));
+			watcher_failed = true;
+			delete w;
+			return;
+			}
+
+		watcher = w;
+		iosource_mgr->Register(watcher, true);
+		}
+
+	if ( ! watcher->Watch(reader, path, reader->Info().mode) )
+		{
+		DBG_LOG(DBG_INPUT, "Cannot watch %s for %s, it will keep polling",
+		        path.c_str(), reader->Name());
+		return;
+		}
+
+	reader->SetWatched(true);
+
+	// The file may have changed before the watch was in place.
+	reader->Update();
+	}
+
+void Manager::UnwatchFiles(ReaderFrontend* reader)
+	{
+	if ( watcher )
+		watcher->Unwatch(reader);
+	}
+
 // put interface: delete old entry from table.
 bool Manager::Delete(ReaderFrontend* reader, Value* *vals)
 	{
@@ -2009,7 +2405,7 @@ RecordVal* Manager::ValueToRecordVal(const Stream* stream, const Value* const *v
 
 // Count the length of the values used to create a correct length buffer for
 // hashing later
-int Manager::GetValueLength(const Value* val) const
+int Manager::GetValueLength(const Value* val)
 	{
 	assert( val->present ); // presence has to be checked elsewhere
 	int length = 0;
@@ -2106,7 +2502,7 @@ int Manager::GetValueLength(const Value* val) const
 
 // Given a threading::value, copy the raw data bytes into *data and return how many bytes were copied.
 // Used for hashing the values for lookup in the bro table
-int Manager::CopyValue(char *data, const int startpos, const Value* val) const
+int Manager::CopyValue(char *data, const int startpos, const Value* val)
 	{
 	assert( val->present ); // presence has to be checked elsewhere
 
@@ -2238,7 +2634,7 @@ int Manager::CopyValue(char *data, const int startpos, const Value* val) const
 	}
 
 // Hash num_elements threading values and return the HashKey for them. At least one of the vals has to be ->present.
-HashKey* Manager::HashValues(const int num_elements, const Value* const *vals) const
+HashKey* Manager::HashValues(const int num_elements, const Value* const *vals)
 	{
 	int length = 0;
 
@@ -2646,7 +3042,7 @@ void Manager::Terminate()
 			continue;
 
 		i->second->removed = true;
-		i->second->reader->Stop();
+		i->second->StopReaders();
 		}
 
 	}
@@ -17,6 +17,7 @@ namespace input {
 
 class ReaderFrontend;
 class ReaderBackend;
+class FileWatcher;
 
 /**
  * Singleton class for managing input streams.
@@ -112,11 +113,25 @@ public:
 	 */
 	static bool IsCompatibleType(BroType* t, bool atomic_only=false);
 
+	/**
+	 * Computes the key that identifies a set of values read by a
+	 * reader. Table streams key their rows by it. Also safe to call
+	 * from reader threads.
+	 *
+	 * @param num_elements The number of values.
+	 *
+	 * @param vals The values.
+	 *
+	 * @return The key, or null if none of the values is set.
+	 */
+	static HashKey* HashValues(const int num_elements, const threading::Value* const *vals);
+
 protected:
 	friend class ReaderFrontend;
 	friend class PutMessage;
 	friend class DeleteMessage;
 	friend class ClearMessage;
+	friend class SizeHintMessage;
 	friend class SendEventMessage;
 	friend class SendEntryMessage;
 	friend class EndCurrentSendMessage;
@@ -124,6 +139,7 @@ protected:
 	friend class DisableMessage;
 	friend class EndOfDataMessage;
 	friend class ReaderErrorMessage;
+	friend class WatchFileMessage;
 
 	// For readers to write to input stream in direct mode (reporting
 	// new/deleted values directly). Functions take ownership of
@@ -139,7 +155,19 @@ protected:
 	// monitoring new/deleted values) Functions take ownership of
 	// threading::Value fields.
 	void SendEntry(ReaderFrontend* reader, threading::Value* *vals);
-	void EndCurrentSend(ReaderFrontend* reader);
+	void EndCurrentSend(ReaderFrontend* reader, std::vector<std::string>* removed = 0);
+
+	// Tells the manager roughly how many entries a reader is about to
+	// send.
+	void SizeHint(ReaderFrontend* reader, int num_entries);
+
+	// Asks for a reader to get updated when its file changes, instead
+	// of it checking on every heartbeat. Tells the reader if that
+	// worked out.
+	void WatchFile(ReaderFrontend* reader, const string& path);
+
+	// Stops watching a reader's files. Called when it gets stopped.
+	void UnwatchFiles(ReaderFrontend* reader);
 
 	// Allows readers to directly send Bro events. The num_vals and vals
 	// must be the same the named event expects. Takes ownership of
@@ -180,6 +208,7 @@ private:
 	class TableStream;
 	class EventStream;
 	class AnalysisStream;
+	class Source;
 
 	// Actual RemoveStream implementation -- the function's public and
 	// protected definitions are wrappers around this function.
@@ -187,13 +216,22 @@ private:
 
 	bool CreateStream(Stream*, RecordVal* description);
 
+	// Initializes all readers of a stream, each with its own copy of
+	// the fields.
+	void InitReaders(Stream* i, int num_fields, const threading::Field* const* fields,
+	                 int num_index_fields = 0);
+
+	// Called when a pass over one of the stream's sources has ended.
+	// Sends the End-of-Data event once all sources are through.
+	void EndOfPass(Stream* i);
+
 	// Check if the types of the error_ev event are correct. If table is
 	// true, check for tablestream type, otherwhise check for eventstream
 	// type.
 	bool CheckErrorEventTypes(std::string stream_name, const Func* error_event, bool table) const;
 
 	// SendEntry implementation for Table stream.
-	int SendEntryTable(Stream* i, const threading::Value* const *vals);
+	int SendEntryTable(Stream* i, Source* src, const threading::Value* const *vals);
 
 	// Put implementation for Table stream.
 	int PutTable(Stream* i, const threading::Value* const *vals);
@@ -216,15 +254,12 @@ private:
 	// Call predicate function and return result.
 	bool CallPred(Func* pred_func, const int numvals, ...) const;
 
-	// Get a hashkey for a set of threading::Values.
-	HashKey* HashValues(const int num_elements, const threading::Value* const *vals) const;
-
 	// Get the memory used by a specific value.
-	int GetValueLength(const threading::Value* val) const;
+	static int GetValueLength(const threading::Value* val);
 
 	// Copies the raw data in a specific threading::Value to position
 	// startpos.
-	int CopyValue(char *data, const int startpos, const threading::Value* val) const;
+	static int CopyValue(char *data, const int startpos, const threading::Value* val);
 
 	// Convert Threading::Value to an internal Bro Type (works also with
 	// Records).
@@ -264,6 +299,10 @@ private:
 	map<ReaderFrontend*, Stream*> readers;
 
 	EventHandlerPtr end_of_data;
+
+	// Created on first use, then owned by the iosource manager.
+	FileWatcher* watcher;
+	bool watcher_failed;
 };
 
 
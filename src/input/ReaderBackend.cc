@@ -54,6 +54,22 @@ public:
 private:
 };
 
+class SizeHintMessage : public threading::OutputMessage<ReaderFrontend> {
+public:
+	SizeHintMessage(ReaderFrontend* reader, int num_entries)
+		: threading::OutputMessage<ReaderFrontend>("SizeHint", reader),
+		num_entries(num_entries) {}
+
+	virtual bool Process()
+		{
+		input_mgr->SizeHint(Object(), num_entries);
+		return true;
+		}
+
+private:
+	int num_entries;
+};
+
 class SendEventMessage : public threading::OutputMessage<ReaderFrontend> {
 public:
 	SendEventMessage(ReaderFrontend* reader, const char* name, const int num_vals, Value* *val)
@@ -116,16 +132,20 @@ private:
 
 class EndCurrentSendMessage : public threading::OutputMessage<ReaderFrontend> {
 public:
-	EndCurrentSendMessage(ReaderFrontend* reader)
-		: threading::OutputMessage<ReaderFrontend>("EndCurrentSend", reader) {}
+	EndCurrentSendMessage(ReaderFrontend* reader, std::vector<std::string>* removed)
+		: threading::OutputMessage<ReaderFrontend>("EndCurrentSend", reader),
+		removed(removed) {}
+
+	virtual ~EndCurrentSendMessage()	{ delete removed; }
 
 	virtual bool Process()
 		{
-		input_mgr->EndCurrentSend(Object());
+		input_mgr->EndCurrentSend(Object(), removed);
 		return true;
 		}
 
 private:
+	std::vector<std::string>* removed;
 };
 
 class EndOfDataMessage : public threading::OutputMessage<ReaderFrontend> {
@@ -142,6 +162,22 @@ public:
 private:
 };
 
+class WatchFileMessage : public threading::OutputMessage<ReaderFrontend> {
+public:
+	WatchFileMessage(ReaderFrontend* reader, const std::string& path)
+		: threading::OutputMessage<ReaderFrontend>("WatchFile", reader),
+		path(path) {}
+
+	virtual bool Process()
+		{
+		input_mgr->WatchFile(Object(), path);
+		return true;
+		}
+
+private:
+	std::string path;
+};
+
 class ReaderClosedMessage : public threading::OutputMessage<ReaderFrontend> {
 public:
 	ReaderClosedMessage(ReaderFrontend* reader)
@@ -205,6 +241,8 @@ ReaderBackend::ReaderBackend(ReaderFrontend* arg_frontend) : MsgThread()
 	info = new ReaderInfo(frontend->Info());
 	num_fields = 0;
 	fields = 0;
+	num_index_fields = 0;
+	watch_requested = watched = false;
 
 	SetName(frontend->Name());
 	}
@@ -236,7 +274,45 @@ void ReaderBackend::SendEvent(const char* name, const int num_vals, Value* *vals
 
 void ReaderBackend::EndCurrentSend()
 	{
-	SendOut(new EndCurrentSendMessage(frontend));
+	std::vector<std::string>* removed = 0;
+
+	if ( num_index_fields )
+		{
+		// Whatever is left from the previous pass wasn't sent again.
+		removed = new std::vector<std::string>;
+		removed->reserve(last_rows.size());
+
+		for ( const auto& r : last_rows )
+			removed->push_back(r.first);
+
+		last_rows.clear();
+		last_rows.swap(current_rows);
+		}
+
+	SendOut(new EndCurrentSendMessage(frontend, removed));
+	}
+
+void ReaderBackend::SendSizeHint(int num_entries)
+	{
+	SendOut(new SizeHintMessage(frontend, num_entries));
+	}
+
+void ReaderBackend::WatchFile(const std::string& path)
+	{
+	if ( watch_requested )
+		return;
+
+	watch_requested = true;
+	SendOut(new WatchFileMessage(frontend, path));
+	}
+
+void ReaderBackend::SetWatched(bool arg_watched)
+	{
+	watched = arg_watched;
+
+	if ( ! watched )
+		// Allow asking again.
+		watch_requested = false;
 	}
 
 void ReaderBackend::EndOfData()
@@ -246,11 +322,53 @@ void ReaderBackend::EndOfData()
 
 void ReaderBackend::SendEntry(Value* *vals)
 	{
+	if ( num_index_fields && Unchanged(vals) )
+		{
+		for ( unsigned int i = 0; i < num_fields; ++i )
+			delete vals[i];
+
+		delete [] vals;
+		return;
+		}
+
 	SendOut(new SendEntryMessage(frontend, vals));
 	}
 
+bool ReaderBackend::Unchanged(const Value* const* vals)
+	{
+	// Keyed the same way as the manager keys its rows.
+	HashKey* idx = Manager::HashValues(num_index_fields, vals);
+
+	if ( ! idx )
+		// The manager complains about it.
+		return false;
+
+	std::string key(static_cast<const char*>(idx->Key()), idx->Size());
+	delete idx;
+
+	hash_t valhash = 0;
+	HashKey* val = Manager::HashValues(num_fields - num_index_fields,
+	                                   vals + num_index_fields);
+
+	if ( val )
+		{
+		valhash = val->Hash();
+		delete val;
+		}
+
+	auto last = last_rows.find(key);
+	bool unchanged = ( last != last_rows.end() && last->second == valhash );
+
+	if ( last != last_rows.end() )
+		last_rows.erase(last);
+
+	current_rows[std::move(key)] = valhash;
+	return unchanged;
+	}
+
 bool ReaderBackend::Init(const int arg_num_fields,
-		         const threading::Field* const* arg_fields)
+		         const threading::Field* const* arg_fields,
+		         const int arg_num_index_fields)
 	{
 	if ( Failed() )
 		return true;
@@ -261,6 +379,7 @@ bool ReaderBackend::Init(const int arg_num_fields,
 
 	num_fields = arg_num_fields;
 	fields = arg_fields;
+	num_index_fields = arg_num_index_fields;
 
 	// disable if DoInit returns error.
 	int success = DoInit(*info, arg_num_fields, arg_fields);
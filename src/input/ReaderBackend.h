@@ -3,7 +3,12 @@
 #ifndef INPUT_READERBACKEND_H
 #define INPUT_READERBACKEND_H
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "BroString.h"
+#include "Hash.h"
 
 #include "threading/SerialTypes.h"
 #include "threading/MsgThread.h"
@@ -103,11 +108,24 @@ public:
 		 */
 		ReaderMode mode;
 
+		/**
+		 * For readers that support splitting a file among several
+		 * instances (see input::Component::Splittable()), the part
+		 * of the source this one reads, out of num_parts. The file
+		 * gets divided into num_parts byte ranges of equal size,
+		 * and a reader reads the records that start in range
+		 * number part.
+		 */
+		int part;
+		int num_parts;
+
 		ReaderInfo()
 			{
 			source = 0;
 			name = 0;
 			mode = MODE_NONE;
+			part = 0;
+			num_parts = 1;
 			}
 
 		ReaderInfo(const ReaderInfo& other)
@@ -115,6 +133,8 @@ public:
 			source = other.source ? copy_string(other.source) : 0;
 			name = other.name ? copy_string(other.name) : 0;
 			mode = other.mode;
+			part = other.part;
+			num_parts = other.num_parts;
 
 			for ( config_map::const_iterator i = other.config.begin(); i != other.config.end(); i++ )
 				config.insert(std::make_pair(copy_string(i->first), copy_string(i->second)));
@@ -149,9 +169,15 @@ public:
 	 * @param config A string map containing additional configuration options
 	 * for the reader.
 	 *
+	 * @param num_index_fields If non-zero, the number of leading fields
+	 * that identify a row of a table stream. SendEntry() then only
+	 * passes on rows that changed since the previous EndCurrentSend(),
+	 * which in turn tells the manager which ones went away.
+	 *
 	 * @return False if an error occured.
 	 */
-	bool Init(int num_fields, const threading::Field* const* fields);
+	bool Init(int num_fields, const threading::Field* const* fields,
+	          int num_index_fields = 0);
 
 	/**
 	 * Force trigger an update of the input stream. The action that will
@@ -170,6 +196,12 @@ public:
 	 */
 	void DisableFrontend();
 
+	/**
+	 * Records whether the input::FileWatcher watches the backend's file,
+	 * see WatchFile(). Called through a message from the main thread.
+	 */
+	void SetWatched(bool arg_watched);
+
 	/**
 	 * Returns the log fields as passed into the constructor.
 	 */
@@ -329,6 +361,15 @@ protected:
 	 */
 	void SendEntry(threading::Value** vals);
 
+	/**
+	 * Method telling the manager roughly how many entries the following
+	 * calls to SendEntry() are going to send, so that it can set aside
+	 * room for them up front. Optional; a guess is fine.
+	 *
+	 * @param num_entries The expected number of entries.
+	 */
+	void SendSizeHint(int num_entries);
+
 	/**
 	 * Method telling the manager, that the current list of entries sent
 	 * by SendEntry is finished.
@@ -339,7 +380,31 @@ protected:
 	 */
 	void EndCurrentSend();
 
+	/**
+	 * Asks the main thread to watch the reader's file for changes, and
+	 * update the reader when there are any. Once that's in place,
+	 * Watched() returns true and the reader can skip looking for changes
+	 * on its heartbeats. Repeated calls are ignored until the watch gets
+	 * dropped again, e.g., because the file's directory went away.
+	 *
+	 * Only useful for MODE_REREAD and MODE_STREAM. Watching may not be
+	 * available, so readers must keep working without.
+	 *
+	 * @param path The file to watch.
+	 */
+	void WatchFile(const std::string& path);
+
+	/**
+	 * Returns true if changes to the file passed to WatchFile() trigger
+	 * updates, see there.
+	 */
+	bool Watched() const	{ return watched; }
+
 private:
+	// Returns true if a row is the same as in the previous pass, and
+	// records it for the current one.
+	bool Unchanged(const threading::Value* const* vals);
+
 	// Frontend that instantiated us. This object must not be accessed
 	// from this class, it's running in a different thread!
 	ReaderFrontend* frontend;
@@ -348,7 +413,16 @@ private:
 	unsigned int num_fields;
 	const threading::Field* const * fields; // raw mapping
 
+	// For table streams, as passed to Init(); row key bytes and value
+	// hashes of the previous and the current pass.
+	unsigned int num_index_fields;
+	std::unordered_map<std::string, hash_t> last_rows;
+	std::unordered_map<std::string, hash_t> current_rows;
+
 	bool disabled;
+
+	bool watch_requested;
+	bool watched;
 };
 
 }
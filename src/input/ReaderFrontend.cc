@@ -12,18 +12,21 @@ class InitMessage : public threading::InputMessage<ReaderBackend>
 {
 public:
 	InitMessage(ReaderBackend* backend,
-		    const int num_fields, const threading::Field* const* fields)
+		    const int num_fields, const threading::Field* const* fields,
+		    const int num_index_fields)
 		: threading::InputMessage<ReaderBackend>("Init", backend),
-		num_fields(num_fields), fields(fields) { }
+		num_fields(num_fields), fields(fields),
+		num_index_fields(num_index_fields) { }
 
 	virtual bool Process()
 		{
-		return Object()->Init(num_fields, fields);
+		return Object()->Init(num_fields, fields, num_index_fields);
 		}
 
 private:
 	const int num_fields;
 	const threading::Field* const* fields;
+	const int num_index_fields;
 };
 
 class UpdateMessage : public threading::InputMessage<ReaderBackend>
@@ -36,13 +39,34 @@ public:
 	virtual bool Process() { return Object()->Update(); }
 };
 
+class SetWatchedMessage : public threading::InputMessage<ReaderBackend>
+{
+public:
+	SetWatchedMessage(ReaderBackend* backend, bool watched)
+		: threading::InputMessage<ReaderBackend>("SetWatched", backend),
+		watched(watched) { }
+
+	virtual bool Process()
+		{
+		Object()->SetWatched(watched);
+		return true;
+		}
+
+private:
+	const bool watched;
+};
+
 ReaderFrontend::ReaderFrontend(const ReaderBackend::ReaderInfo& arg_info, EnumVal* type)
 	{
 	disabled = initialized = false;
 	info = new ReaderBackend::ReaderInfo(arg_info);
 
 	const char* t = type->Type()->AsEnumType()->Lookup(type->InternalInt());
-	name = copy_string(fmt("%s/%s", arg_info.source, t));
+
+	if ( arg_info.num_parts > 1 )
+		name = copy_string(fmt("%s/%s/%d", arg_info.source, t, arg_info.part));
+	else
+		name = copy_string(fmt("%s/%s", arg_info.source, t));
 
 	backend = input_mgr->CreateBackend(this, type);
 	assert(backend);
@@ -51,6 +75,8 @@ ReaderFrontend::ReaderFrontend(const ReaderBackend::ReaderInfo& arg_info, EnumVa
 
 void ReaderFrontend::Stop()
 	{
+	input_mgr->UnwatchFiles(this);
+
 	if ( backend )
 		{
 		backend->SignalStop();
@@ -65,7 +91,8 @@ ReaderFrontend::~ReaderFrontend()
 	}
 
 void ReaderFrontend::Init(const int arg_num_fields,
-		          const threading::Field* const* arg_fields)
+		          const threading::Field* const* arg_fields,
+		          const int num_index_fields)
 	{
 	if ( disabled )
 		return;
@@ -77,7 +104,7 @@ void ReaderFrontend::Init(const int arg_num_fields,
 	fields = arg_fields;
 	initialized = true;
 
-	backend->SendIn(new InitMessage(backend, num_fields, fields));
+	backend->SendIn(new InitMessage(backend, num_fields, fields, num_index_fields));
 	}
 
 void ReaderFrontend::Update()
@@ -94,6 +121,14 @@ void ReaderFrontend::Update()
 	backend->SendIn(new UpdateMessage(backend));
 	}
 
+void ReaderFrontend::SetWatched(bool watched)
+	{
+	if ( disabled || ! backend )
+		return;
+
+	backend->SendIn(new SetWatchedMessage(backend, watched));
+	}
+
 const char* ReaderFrontend::Name() const
 	{
 	return name;
@@ -55,7 +55,8 @@ public:
 	 *
 	 * This method must only be called from the main thread.
 	 */
-	void Init(const int arg_num_fields, const threading::Field* const* fields);
+	void Init(const int arg_num_fields, const threading::Field* const* fields,
+	          const int num_index_fields = 0);
 
 	/**
 	 * Force an update of the current input source. Actual action depends
@@ -68,6 +69,18 @@ public:
 	 */
 	void Update();
 
+	/**
+	 * Tells the backend whether the input::FileWatcher is watching its
+	 * file. While it is, the backend doesn't need to check for changes
+	 * itself.
+	 *
+	 * This method generates a message to the backend reader and triggers
+	 * the corresponding message there.
+	 *
+	 * This method must only be called from the main thread.
+	 */
+	void SetWatched(bool watched);
+
 	/**
 	 * Finalizes reading from this stream.
 	 *
@@ -1,11 +1,13 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
-#include <sstream>
+#include <algorithm>
+#include <climits>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 
 #include "Ascii.h"
 #include "ascii.bif.h"
@@ -17,6 +19,9 @@ using namespace threading;
 using threading::Value;
 using threading::Field;
 
+// How much to read from the file at once.
+#define ASCII_READ_BUFFER_SIZE (1024 * 1024)
+
 FieldMapping::FieldMapping(const string& arg_name, const TypeTag& arg_type, int arg_position)
 	: name(arg_name), type(arg_type), subtype(TYPE_ERROR)
 	{
@@ -50,6 +55,10 @@ Ascii::Ascii(ReaderFrontend *frontend) : ReaderBackend(frontend)
 	{
 	mtime = 0;
 	ino = 0;
+	read_pos = 0;
+	line_start = 0;
+	next_offset = 0;
+	read_len = 0;
 	suppress_warnings = false;
 	fail_on_file_problem = false;
 	fail_on_invalid_lines = false;
@@ -157,6 +166,8 @@ bool Ascii::OpenFile()
 		}
 
 	file.open(fname);
+	read_pos = read_len = 0;
+	line_start = next_offset = 0;
 
 	if ( ! file.is_open() )
 		{
@@ -174,6 +185,10 @@ bool Ascii::OpenFile()
 		}
 
 	suppress_warnings = false;
+
+	if ( Info().mode != MODE_MANUAL )
+		WatchFile(fname);
+
 	return true;
 	}
 
@@ -199,17 +214,10 @@ bool Ascii::ReadHeader(bool useCached)
 		line = headerline;
 
 	// construct list of field names.
-	istringstream splitstream(line);
-	int pos=0;
-	while ( splitstream )
-		{
-		string s;
-		if ( ! getline(splitstream, s, separator[0]))
-			break;
+	int num = SplitLine(line);
 
-		ifields[s] = pos;
-		pos++;
-		}
+	for ( int pos = 0; pos < num; pos++ )
+		ifields[stringfields[pos]] = pos;
 
 	// printf("Updating fields from description %s\n", line.c_str());
 	columnMap.clear();
@@ -259,9 +267,96 @@ bool Ascii::ReadHeader(bool useCached)
 	return true;
 	}
 
+bool Ascii::ReadLine(string& str)
+	{
+	str.clear();
+	line_start = next_offset;
+
+	if ( read_buf.empty() )
+		read_buf.resize(ASCII_READ_BUFFER_SIZE);
+
+	for ( ;; )
+		{
+		if ( read_pos == read_len )
+			{
+			file.read(read_buf.data(), read_buf.size());
+			read_pos = 0;
+			read_len = file.gcount();
+
+			if ( read_len == 0 )
+				// A last line without a newline still counts.
+				return ! str.empty();
+			}
+
+		const char* start = read_buf.data() + read_pos;
+		size_t avail = read_len - read_pos;
+		const char* nl = static_cast<const char*>(memchr(start, '\n', avail));
+
+		if ( nl )
+			{
+			str.append(start, nl - start);
+			read_pos += nl - start + 1;
+			next_offset += nl - start + 1;
+			return true;
+			}
+
+		str.append(start, avail);
+		read_pos = read_len;
+		next_offset += avail;
+		}
+	}
+
+void Ascii::SeekLine(off_t offset)
+	{
+	if ( offset <= next_offset )
+		return;
+
+	// Skip the rest of the line the byte before is part of; a line
+	// starting right at offset then comes next.
+	file.clear();
+	file.seekg(offset - 1);
+	read_pos = read_len = 0;
+	next_offset = offset - 1;
+
+	string rest;
+	ReadLine(rest);
+	}
+
+int Ascii::SplitLine(const string& line)
+	{
+	int num = 0;
+	size_t start = 0;
+
+	if ( line.empty() )
+		return 0;
+
+	for ( ;; )
+		{
+		size_t end = line.find(separator[0], start);
+
+		if ( end == string::npos && start == line.size() && num > 0 )
+			// Nothing after a trailing separator.
+			break;
+
+		if ( stringfields.size() <= size_t(num) )
+			stringfields.emplace_back();
+
+		if ( end == string::npos )
+			{
+			stringfields[num++].assign(line, start, string::npos);
+			break;
+			}
+
+		stringfields[num++].assign(line, start, end - start);
+		start = end + 1;
+		}
+
+	return num;
+	}
+
 bool Ascii::GetLine(string& str)
 	{
-	while ( getline(file, str) )
+	while ( ReadLine(str) )
 		{
 		if ( ! str.size() )
 			continue;
@@ -348,27 +443,52 @@ bool Ascii::DoUpdate()
 		}
 
 	string line;
+	bool hinted = ( Info().mode == MODE_STREAM );
 
 	file.sync();
 
+	// When the file is split, the lines starting in this range are ours.
+	off_t part_begin = 0;
+	off_t part_end = -1;
+
+	if ( Info().num_parts > 1 && file.is_open() )
+		{
+		struct stat sb;
+
+		if ( stat(fname.c_str(), &sb) == 0 )
+			{
+			part_begin = sb.st_size * Info().part / Info().num_parts;
+			part_end = sb.st_size * (Info().part + 1) / Info().num_parts;
+			SeekLine(part_begin);
+			}
+		}
+
 	while ( GetLine(line) )
 		{
-		// split on tabs
-		bool error = false;
-		istringstream splitstream(line);
+		if ( part_end >= 0 && line_start >= part_end )
+			break;
 
-		map<int, string> stringfields;
-		int pos = 0;
-		while ( splitstream )
+		if ( ! hinted )
 			{
-			string s;
-			if ( ! getline(splitstream, s, separator[0]) )
-				break;
+			// Guess from the first line, assuming the others are
+			// about as long.
+			struct stat sb;
 
-			stringfields[pos] = s;
-			pos++;
+			if ( part_end >= 0 )
+				SendSizeHint(std::min((part_end - part_begin) / off_t(line.size() + 1),
+				                      off_t(INT_MAX)));
+
+			else if ( stat(fname.c_str(), &sb) == 0 )
+				SendSizeHint(std::min(sb.st_size / off_t(line.size() + 1),
+				                      off_t(INT_MAX)));
+
+			hinted = true;
 			}
 
+		// split on tabs
+		bool error = false;
+		int pos = SplitLine(line);
+
 		pos--; // for easy comparisons of max element.
 
 		Value** fields = new Value*[NumFields()];
@@ -474,6 +594,10 @@ bool Ascii::DoHeartbeat(double network_time, double current_time)
 
 		case MODE_REREAD:
 		case MODE_STREAM:
+			if ( Watched() )
+				// We get updated when the file changes.
+				break;
+
 			Update(); // Call Update, not DoUpdate, because Update
 				  // checks the "disabled" flag.
 			break;
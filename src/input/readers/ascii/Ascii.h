@@ -52,10 +52,18 @@ protected:
 	void DoClose() override;
 	bool DoUpdate() override;
 	bool DoHeartbeat(double network_time, double current_time) override;
+	bool WantsHeartbeats() override
+		{ return Info().mode != MODE_MANUAL || ! file.is_open(); }
 
 private:
 	bool ReadHeader(bool useCached);
 	bool GetLine(string& str);
+	// Like std::getline(), but goes through read_buf.
+	bool ReadLine(string& str);
+	// Splits a line into stringfields, returning the number of fields.
+	int SplitLine(const string& line);
+	// Moves on to the first line starting at or after offset.
+	void SeekLine(off_t offset);
 	bool OpenFile();
 	// Call Warning or Error, depending on the is_error boolean.
 	// In case of a warning, setting suppress_future to true will suppress all future warnings
@@ -66,6 +74,21 @@ private:
 	time_t mtime;
 	ino_t ino;
 
+	// Data read from the file in large blocks, and the part of it not
+	// consumed yet.
+	vector<char> read_buf;
+	size_t read_pos;
+	size_t read_len;
+
+	// Offsets in the file of the line ReadLine() returned last, and of
+	// what comes after it.
+	off_t line_start;
+	off_t next_offset;
+
+	// The fields of the current line. Kept around so that their memory
+	// gets reused from line to line.
+	vector<string> stringfields;
+
 	// The name using which we actually load the file -- compared
 	// to the input source name, this one may have a path_prefix
 	// attached to it.
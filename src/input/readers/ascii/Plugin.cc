@@ -11,7 +11,7 @@ class Plugin : public plugin::Plugin {
 public:
 	plugin::Configuration Configure()
 		{
-		AddComponent(new ::input::Component("Ascii", ::input::reader::Ascii::Instantiate));
+		AddComponent(new ::input::Component("Ascii", ::input::reader::Ascii::Instantiate, true));
 
 		plugin::Configuration config;
 		config.name = "Zeek::AsciiReader";
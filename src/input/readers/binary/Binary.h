@@ -27,6 +27,7 @@ protected:
 	void DoClose() override;
 	bool DoUpdate() override;
 	bool DoHeartbeat(double network_time, double current_time) override;
+	bool WantsHeartbeats() override	{ return Info().mode != MODE_MANUAL; }
 
 private:
 	bool OpenInput();
@@ -0,0 +1,730 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <algorithm>
+#include <climits>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Columnar.h"
+
+#include "threading/SerialTypes.h"
+
+using namespace input::reader;
+using threading::Value;
+using threading::Field;
+
+#define COLUMNAR_VERSION 1
+
+#define COLUMN_PLAIN 0
+#define COLUMN_DICT 1
+
+Columnar::Columnar(ReaderFrontend *frontend)
+	: ReaderBackend(frontend), mtime(0), ino(0), firstrun(true), offset(0),
+	  truncated(false)
+	{
+	}
+
+Columnar::~Columnar()
+	{
+	DoClose();
+	}
+
+void Columnar::DoClose()
+	{
+	for ( auto& col : columns )
+		{
+		for ( auto v : col )
+			delete v;
+
+		col.clear();
+		}
+
+	std::string().swap(buf);
+	}
+
+bool Columnar::DoInit(const ReaderInfo& info, int num_fields,
+                      const Field* const* fields)
+	{
+	mtime = 0;
+	ino = 0;
+	firstrun = true;
+	offset = 0;
+
+	if ( ! info.source || strlen(info.source) == 0 )
+		{
+		Error("No source path provided");
+		return false;
+		}
+
+	fname = info.source;
+	columns.resize(num_fields);
+
+	if ( UpdateModificationTime() == -1 )
+		return false;
+
+	return DoUpdate();
+	}
+
+int Columnar::UpdateModificationTime()
+	{
+	struct stat sb;
+
+	if ( stat(fname.c_str(), &sb) == -1 )
+		{
+		Error(Fmt("Could not get stat for %s", fname.c_str()));
+		return -1;
+		}
+
+	if ( sb.st_ino == ino && sb.st_mtime == mtime )
+		// no change
+		return 0;
+
+	mtime = sb.st_mtime;
+	ino = sb.st_ino;
+	return 1;
+	}
+
+bool Columnar::ReadFile(off_t from)
+	{
+	int fd = open(fname.c_str(), O_RDONLY);
+
+	if ( fd < 0 )
+		{
+		Error(Fmt("cannot open %s: %s", fname.c_str(), Strerror(errno)));
+		return false;
+		}
+
+	struct stat sb;
+
+	if ( fstat(fd, &sb) < 0 )
+		{
+		Error(Fmt("Could not get stat for %s", fname.c_str()));
+		safe_close(fd);
+		return false;
+		}
+
+	buf.resize(sb.st_size > from ? sb.st_size - from : 0);
+
+	size_t n = 0;
+
+	while ( n < buf.size() )
+		{
+		ssize_t r = pread(fd, &buf[n], buf.size() - n, from + n);
+
+		if ( r < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			Error(Fmt("error reading %s: %s", fname.c_str(), Strerror(errno)));
+			safe_close(fd);
+			return false;
+			}
+
+		if ( r == 0 )
+			// Got shorter in the meantime.
+			break;
+
+		n += r;
+		}
+
+	buf.resize(n);
+	safe_close(fd);
+	return true;
+	}
+
+bool Columnar::GetVarint(Cursor* c, uint64* n)
+	{
+	*n = 0;
+
+	for ( int shift = 0; shift < 64; shift += 7 )
+		{
+		if ( c->pos >= c->end )
+			return false;
+
+		u_char b = *c->pos++;
+		*n |= uint64(b & 0x7f) << shift;
+
+		if ( b < 0x80 )
+			return true;
+		}
+
+	return false;
+	}
+
+bool Columnar::GetBytes(Cursor* c, uint64 len, const char** data)
+	{
+	if ( len > uint64(c->end - c->pos) )
+		return false;
+
+	*data = c->pos;
+	c->pos += len;
+	return true;
+	}
+
+bool Columnar::ReadHeader(Cursor* c)
+	{
+	const char* magic;
+
+	if ( ! GetBytes(c, 5, &magic) )
+		{
+		truncated = true;
+		return false;
+		}
+
+	if ( memcmp(magic, "ZCOL", 4) != 0 )
+		{
+		Error(Fmt("%s is not a columnar log file", fname.c_str()));
+		return false;
+		}
+
+	if ( magic[4] != COLUMNAR_VERSION )
+		{
+		Error(Fmt("unsupported columnar format version %d in %s",
+		          magic[4], fname.c_str()));
+		return false;
+		}
+
+	uint64 len;
+	const char* path;
+	uint64 num_columns;
+
+	if ( ! (GetVarint(c, &len) && GetBytes(c, len, &path) &&
+	        GetVarint(c, &num_columns)) )
+		{
+		truncated = true;
+		return false;
+		}
+
+	column_map.clear();
+	std::vector<bool> found(NumFields(), false);
+
+	for ( uint64 j = 0; j < num_columns; ++j )
+		{
+		const char* name;
+		uint64 name_len;
+		const char* type;
+		uint64 type_len;
+
+		if ( ! (GetVarint(c, &name_len) && GetBytes(c, name_len, &name) &&
+		        GetVarint(c, &type_len) && GetBytes(c, type_len, &type)) )
+			{
+			truncated = true;
+			return false;
+			}
+
+		std::string column_name(name, name_len);
+		std::string column_type(type, type_len);
+		int field = -1;
+
+		for ( int i = 0; i < NumFields(); ++i )
+			{
+			if ( column_name != Fields()[i]->name )
+				continue;
+
+			if ( column_type != Fields()[i]->TypeName() )
+				{
+				Error(Fmt("field %s has type %s in %s, expected %s",
+				          column_name.c_str(), column_type.c_str(), fname.c_str(),
+				          Fields()[i]->TypeName().c_str()));
+				return false;
+				}
+
+			field = i;
+			found[i] = true;
+			break;
+			}
+
+		column_map.push_back(field);
+		}
+
+	for ( int i = 0; i < NumFields(); ++i )
+		{
+		if ( ! found[i] && ! Fields()[i]->optional )
+			{
+			Error(Fmt("did not find requested field %s in %s",
+			          Fields()[i]->name, fname.c_str()));
+			return false;
+			}
+		}
+
+	return true;
+	}
+
+bool Columnar::ReadChunk(Cursor* c, uint64 num_rows)
+	{
+	for ( size_t j = 0; j < column_map.size(); ++j )
+		{
+		int i = column_map[j];
+
+		if ( DecodeColumn(c, num_rows, i >= 0 ? Fields()[i] : 0,
+		                  i >= 0 ? &columns[i] : 0) )
+			continue;
+
+		for ( auto& col : columns )
+			{
+			for ( auto v : col )
+				delete v;
+
+			col.clear();
+			}
+
+		return false;
+		}
+
+	return true;
+	}
+
+bool Columnar::DecodeColumn(Cursor* c, uint64 num_rows, const Field* f,
+                            std::vector<Value*>* col)
+	{
+	const char* kind;
+
+	if ( ! GetBytes(c, 1, &kind) )
+		{
+		truncated = true;
+		return false;
+		}
+
+	if ( col )
+		col->reserve(num_rows);
+
+	if ( *kind == COLUMN_PLAIN )
+		{
+		for ( uint64 r = 0; r < num_rows; ++r )
+			{
+			uint64 len;
+			const char* data;
+
+			if ( ! GetVarint(c, &len) || (len && ! GetBytes(c, len - 1, &data)) )
+				{
+				truncated = true;
+				return false;
+				}
+
+			if ( ! col )
+				continue;
+
+			Value* v = len ? DecodeValue(data, len - 1, f->type, f->subtype)
+			               : new Value(f->type, false);
+
+			if ( ! v )
+				return false;
+
+			col->push_back(v);
+			}
+
+		return true;
+		}
+
+	if ( *kind != COLUMN_DICT )
+		return false;
+
+	uint64 dict_size;
+
+	if ( ! GetVarint(c, &dict_size) )
+		{
+		truncated = true;
+		return false;
+		}
+
+	// Each entry takes at least one byte.
+	if ( dict_size > uint64(c->end - c->pos) )
+		{
+		truncated = true;
+		return false;
+		}
+
+	std::vector<std::pair<const char*, uint64>> dict;
+	dict.reserve(dict_size);
+
+	for ( uint64 k = 0; k < dict_size; ++k )
+		{
+		uint64 len;
+		const char* data;
+
+		if ( ! (GetVarint(c, &len) && GetBytes(c, len, &data)) )
+			{
+			truncated = true;
+			return false;
+			}
+
+		dict.push_back(std::make_pair(data, len));
+		}
+
+	uint64 rows = 0;
+
+	while ( rows < num_rows )
+		{
+		uint64 run_len;
+		uint64 index;
+
+		if ( ! (GetVarint(c, &run_len) && GetVarint(c, &index)) )
+			{
+			truncated = true;
+			return false;
+			}
+
+		if ( ! run_len || run_len > num_rows - rows || index > dict.size() )
+			return false;
+
+		rows += run_len;
+
+		if ( ! col )
+			continue;
+
+		for ( uint64 k = 0; k < run_len; ++k )
+			{
+			Value* v = index ?
+				DecodeValue(dict[index - 1].first, dict[index - 1].second,
+				            f->type, f->subtype) :
+				new Value(f->type, false);
+
+			if ( ! v )
+				return false;
+
+			col->push_back(v);
+			}
+		}
+
+	return true;
+	}
+
+Value* Columnar::DecodeValue(const char* data, uint64 len, TypeTag type, TypeTag subtype)
+	{
+	Cursor c = { data, data + len };
+	Value* val = new Value(type, subtype, true);
+
+	switch ( type ) {
+	case TYPE_BOOL:
+		{
+		const char* b;
+
+		if ( ! GetBytes(&c, 1, &b) )
+			goto decode_error;
+
+		val->val.int_val = *b ? 1 : 0;
+		break;
+		}
+
+	case TYPE_INT:
+		{
+		uint64 n;
+
+		if ( ! GetVarint(&c, &n) )
+			goto decode_error;
+
+		val->val.int_val = bro_int_t(n >> 1) ^ -bro_int_t(n & 1);
+		break;
+		}
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		if ( ! GetVarint(&c, &val->val.uint_val) )
+			goto decode_error;
+
+		break;
+
+	case TYPE_PORT:
+		{
+		uint64 port;
+		const char* proto;
+
+		if ( ! (GetVarint(&c, &port) && GetBytes(&c, 1, &proto)) ||
+		     port > 65535 || *proto < TRANSPORT_UNKNOWN || *proto > TRANSPORT_ICMP )
+			goto decode_error;
+
+		val->val.port_val.port = port;
+		val->val.port_val.proto = TransportProto(*proto);
+		break;
+		}
+
+	case TYPE_ADDR:
+	case TYPE_SUBNET:
+		{
+		Value::addr_t& a = type == TYPE_ADDR ?
+			val->val.addr_val : val->val.subnet_val.prefix;
+		const char* family;
+		const char* bytes;
+
+		if ( ! GetBytes(&c, 1, &family) )
+			goto decode_error;
+
+		if ( *family == 4 && GetBytes(&c, sizeof(a.in.in4), &bytes) )
+			{
+			a.family = IPv4;
+			memcpy(&a.in.in4, bytes, sizeof(a.in.in4));
+			}
+
+		else if ( *family == 6 && GetBytes(&c, sizeof(a.in.in6), &bytes) )
+			{
+			a.family = IPv6;
+			memcpy(&a.in.in6, bytes, sizeof(a.in.in6));
+			}
+
+		else
+			goto decode_error;
+
+		if ( type == TYPE_SUBNET )
+			{
+			// Stored relative to the address family already,
+			// which is what the input framework wants.
+			const char* width;
+
+			if ( ! GetBytes(&c, 1, &width) )
+				goto decode_error;
+
+			val->val.subnet_val.length = uint8_t(*width);
+			}
+
+		break;
+		}
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		{
+		const char* bytes;
+
+		if ( ! GetBytes(&c, 8, &bytes) )
+			goto decode_error;
+
+		uint64 n = 0;
+
+		for ( int i = 0; i < 8; ++i )
+			n |= uint64(u_char(bytes[i])) << (8 * i);
+
+		memcpy(&val->val.double_val, &n, sizeof(n));
+		break;
+		}
+
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+	case TYPE_PATTERN:
+		{
+		uint64 n;
+		const char* bytes;
+
+		if ( ! (GetVarint(&c, &n) && GetBytes(&c, n, &bytes)) || n > INT_MAX )
+			goto decode_error;
+
+		char* s = new char[n + 1];
+		memcpy(s, bytes, n);
+		s[n] = '\0';
+
+		if ( type == TYPE_PATTERN )
+			val->val.pattern_text_val = s;
+		else
+			{
+			val->val.string_val.data = s;
+			val->val.string_val.length = n;
+			}
+
+		break;
+		}
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		{
+		Value::set_t& set = type == TYPE_TABLE ?
+			val->val.set_val : val->val.vector_val;
+		uint64 n;
+
+		// Each element takes at least one byte.
+		if ( ! GetVarint(&c, &n) || n > uint64(c.end - c.pos) )
+			goto decode_error;
+
+		set.vals = new Value*[n];
+		set.size = 0;
+
+		for ( uint64 i = 0; i < n; ++i )
+			{
+			uint64 elem_len;
+			const char* elem;
+
+			if ( ! GetVarint(&c, &elem_len) ||
+			     (elem_len && ! GetBytes(&c, elem_len - 1, &elem)) )
+				goto decode_error;
+
+			Value* e = elem_len ? DecodeValue(elem, elem_len - 1, subtype, TYPE_VOID)
+			                    : new Value(subtype, false);
+
+			if ( ! e )
+				goto decode_error;
+
+			set.vals[set.size++] = e;
+			}
+
+		break;
+		}
+
+	default:
+		Error(Fmt("unsupported field type %s for %s", type_name(type), fname.c_str()));
+		goto decode_error;
+	}
+
+	return val;
+
+decode_error:
+	delete val;
+	return 0;
+	}
+
+// read the entire file and send appropriate thingies back to InputMgr
+bool Columnar::DoUpdate()
+	{
+	if ( firstrun )
+		firstrun = false;
+
+	else
+		{
+		switch ( Info().mode  ) {
+		case MODE_REREAD:
+			{
+			switch ( UpdateModificationTime() ) {
+			case -1:
+				return false; // error
+			case 0:
+				return true; // no change
+			case 1:
+				break; // file changed. reread.
+			default:
+				assert(false);
+			}
+
+			break;
+			}
+
+		case MODE_MANUAL:
+			break;
+
+		case MODE_STREAM:
+			{
+			// Pick up where we left off, unless the file got
+			// replaced.
+			ino_t old_ino = ino;
+
+			if ( UpdateModificationTime() == -1 )
+				return false;
+
+			if ( ino != old_ino )
+				offset = 0;
+
+			break;
+			}
+
+		default:
+			assert(false);
+		}
+		}
+
+	bool stream = ( Info().mode == MODE_STREAM );
+	off_t start = stream ? offset : 0;
+
+	if ( ! ReadFile(start) )
+		return false;
+
+	Cursor c = { buf.data(), buf.data() + buf.size() };
+	truncated = false;
+
+	if ( start == 0 )
+		{
+		if ( ! ReadHeader(&c) )
+			{
+			if ( ! truncated )
+				// Already reported.
+				return false;
+
+			if ( stream )
+				// Still being written.
+				return true;
+
+			Error(Fmt("truncated header in %s", fname.c_str()));
+			return false;
+			}
+
+		offset = c.pos - buf.data();
+		}
+
+	bool hinted = stream;
+
+	for ( ;; )
+		{
+		const char* chunk_start = c.pos;
+		uint64 num_rows;
+
+		if ( ! GetVarint(&c, &num_rows) || ! num_rows )
+			// The end, or the file is still being written.
+			break;
+
+		if ( ! ReadChunk(&c, num_rows) )
+			{
+			if ( ! truncated )
+				Warning(Fmt("malformed chunk in %s, ignoring the rest of the file",
+				            fname.c_str()));
+			break;
+			}
+
+		if ( ! hinted )
+			{
+			// Guess from the first chunk, assuming the others
+			// are about as large.
+			double n = double(num_rows) * (c.end - chunk_start) / (c.pos - chunk_start);
+			SendSizeHint(int(std::min(n, double(INT_MAX))));
+			hinted = true;
+			}
+
+		for ( uint64 r = 0; r < num_rows; ++r )
+			{
+			Value** fields = new Value*[NumFields()];
+
+			for ( int i = 0; i < NumFields(); ++i )
+				fields[i] = columns[i].empty() ?
+					new Value(Fields()[i]->type, false) : columns[i][r];
+
+			if ( stream )
+				Put(fields);
+			else
+				SendEntry(fields);
+			}
+
+		for ( auto& col : columns )
+			col.clear();
+
+		offset = start + (c.pos - buf.data());
+		}
+
+	std::string().swap(buf);
+
+	if ( ! stream )
+		EndCurrentSend();
+
+#ifdef DEBUG
+	Debug(DBG_INPUT, "DoUpdate finished successfully");
+#endif
+
+	return true;
+	}
+
+bool Columnar::DoHeartbeat(double network_time, double current_time)
+	{
+	switch ( Info().mode ) {
+		case MODE_MANUAL:
+			// yay, we do nothing :)
+			break;
+
+		case MODE_REREAD:
+		case MODE_STREAM:
+			Update();	// call update and not DoUpdate, because update
+					// checks disabled.
+			break;
+		default:
+			assert(false);
+	}
+
+	return true;
+	}
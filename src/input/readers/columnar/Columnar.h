@@ -0,0 +1,84 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Input reader for files written by the Columnar log writer, see
+// logging/writers/columnar/Columnar.h for the format. Values get decoded
+// straight from their binary form, there's no text parsing involved.
+// Fields are matched up with the file's columns by name.
+
+#ifndef INPUT_READERS_COLUMNAR_H
+#define INPUT_READERS_COLUMNAR_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "input/ReaderBackend.h"
+
+namespace input { namespace reader {
+
+/**
+ * Reader for the columnar binary log format.
+ */
+class Columnar : public ReaderBackend {
+public:
+	explicit Columnar(ReaderFrontend* frontend);
+	~Columnar() override;
+
+	static ReaderBackend* Instantiate(ReaderFrontend* frontend)
+		{ return new Columnar(frontend); }
+
+protected:
+	bool DoInit(const ReaderInfo& info, int arg_num_fields,
+	            const threading::Field* const* fields) override;
+	void DoClose() override;
+	bool DoUpdate() override;
+	bool DoHeartbeat(double network_time, double current_time) override;
+	bool WantsHeartbeats() override	{ return Info().mode != MODE_MANUAL; }
+
+private:
+	// A position in the data read from the file.
+	struct Cursor {
+		const char* pos;
+		const char* end;
+	};
+
+	bool ReadFile(off_t offset);
+	bool ReadHeader(Cursor* c);
+	bool ReadChunk(Cursor* c, uint64 num_rows);
+	int UpdateModificationTime();
+
+	bool DecodeColumn(Cursor* c, uint64 num_rows, const threading::Field* f,
+	                  std::vector<threading::Value*>* col);
+	threading::Value* DecodeValue(const char* data, uint64 len,
+	                              TypeTag type, TypeTag subtype);
+
+	static bool GetVarint(Cursor* c, uint64* n);
+	static bool GetBytes(Cursor* c, uint64 len, const char** data);
+
+	string fname;
+	time_t mtime;
+	ino_t ino;
+	bool firstrun;
+
+	// What got read from the file.
+	std::string buf;
+
+	// Where the next chunk starts in the file, for streaming.
+	off_t offset;
+
+	// Set when the data ended in the middle of something, as opposed to
+	// being malformed.
+	bool truncated;
+
+	// For each of the file's columns, the index of the field it goes
+	// to, or -1 if it's not wanted.
+	std::vector<int> column_map;
+
+	// Decoded columns of the current chunk, one per field.
+	std::vector<std::vector<threading::Value*>> columns;
+};
+
+}
+}
+
+#endif /* INPUT_READERS_COLUMNAR_H */
@@ -26,6 +26,7 @@ Config::Config(ReaderFrontend *frontend) : ReaderBackend(frontend)
 	ino = 0;
 	suppress_warnings = false;
 	fail_on_file_problem = false;
+	re_compiled = false;
 
 	// find all option names and their types.
 	auto globals = global_scope()->Vars();
@@ -56,6 +57,8 @@ Config::Config(ReaderFrontend *frontend) : ReaderBackend(frontend)
 
 Config::~Config()
 	{
+	if ( re_compiled )
+		regfree(&re);
 	}
 
 void Config::DoClose()
@@ -75,6 +78,14 @@ bool Config::DoInit(const ReaderInfo& info, int num_fields, const Field* const*
 	formatter::Ascii::SeparatorInfo sep_info("\t", set_separator, "", empty_field);
 	formatter = unique_ptr<threading::formatter::Formatter>(new formatter::Ascii(this, sep_info));
 
+	if ( regcomp(&re, "^([^[:blank:]]+)[[:blank:]]+(.*)$", REG_EXTENDED) )
+		{
+		Error(Fmt("Failed to compile regex."));
+		return false;
+		}
+
+	re_compiled = true;
+
 	return DoUpdate();
 	}
 
@@ -198,13 +209,6 @@ bool Config::DoUpdate()
 		unseen_options.insert(i.first);
 		}
 
-	regex_t re;
-	if ( regcomp(&re, "^([^[:blank:]]+)[[:blank:]]+(.*)$", REG_EXTENDED) )
-		{
-		Error(Fmt("Failed to compile regex."));
-		return true;
-		}
-
 	while ( GetLine(line) )
 		{
 		regmatch_t match[3];
@@ -230,6 +234,18 @@ bool Config::DoUpdate()
 			continue;
 			}
 
+		// We only send the value if it has changed, and don't even
+		// parse it again if it reads the same. (Yes, this means we
+		// keep all configuration options in memory twice - once here
+		// in the reader and once in memory in Bro; that is difficult
+		// to change.)
+		auto search = option_values.find(key);
+		if ( search != option_values.end() && search->second.text == value )
+			{
+			unseen_options.erase(key);
+			continue;
+			}
+
 		Value* eventval = formatter->ParseValue(value, key, std::get<0>((*typeit).second), std::get<1>((*typeit).second));
 		if ( ! eventval )
 			{
@@ -245,17 +261,24 @@ bool Config::DoUpdate()
 
 		unseen_options.erase(key);
 
-		// we only send the event if the underlying value has changed. Let's check that.
-		// (Yes, this means we keep all configuration options in memory twice - once here in
-		// the reader and once in memory in Bro; that is difficult to change.
-		auto search = option_values.find(key);
-		if ( search != option_values.end() && search->second == value )
+		hash_t hash = 0;
+		HashKey* hk = input::Manager::HashValues(1, &eventval);
+
+		if ( hk )
 			{
+			hash = hk->Hash();
+			delete hk;
+			}
+
+		if ( search != option_values.end() && search->second.hash == hash )
+			{
+			// Written differently, but the same value.
+			search->second.text = value;
 			delete eventval;
 			continue;
 			}
 
-		option_values[key] = value;
+		option_values[key] = OptionValue{value, hash};
 
 			{
 			Value** fields = new Value*[2];
@@ -291,8 +314,6 @@ bool Config::DoUpdate()
 			}
 		}
 
-	regfree(&re);
-
 	if ( Info().mode != MODE_STREAM )
 		EndCurrentSend();
 
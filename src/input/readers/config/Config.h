@@ -9,6 +9,7 @@
 #include <memory>
 #include <unordered_map>
 #include <sys/types.h>
+#include <regex.h>
 
 #include "input/ReaderBackend.h"
 #include "threading/formatters/Ascii.h"
@@ -36,6 +37,7 @@ protected:
 	void DoClose() override;
 	bool DoUpdate() override;
 	bool DoHeartbeat(double network_time, double current_time) override;
+	bool WantsHeartbeats() override	{ return Info().mode != MODE_MANUAL; }
 
 private:
 	bool GetLine(string& str);
@@ -59,7 +61,20 @@ private:
 
 	std::unique_ptr<threading::formatter::Formatter> formatter;
 	std::unordered_map<std::string, std::tuple<TypeTag, TypeTag>> option_types;
-	std::unordered_map<std::string, std::string> option_values;
+
+	// The last value sent for an option, as text and as a hash of what
+	// got parsed from it. Text that's different but parses to the same
+	// value, e.g., with other whitespace, doesn't count as a change.
+	struct OptionValue {
+		std::string text;
+		hash_t hash;
+	};
+
+	std::unordered_map<std::string, OptionValue> option_values;
+
+	// Splits lines into option name and value.
+	regex_t re;
+	bool re_compiled;
 };
 
 
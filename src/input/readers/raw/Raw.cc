@@ -420,6 +420,9 @@ bool Raw::DoInit(const ReaderInfo& info, int num_fields, const Field* const* fie
 	if ( result == false )
 		return result;
 
+	if ( ! execute && Info().mode != MODE_MANUAL )
+		WatchFile(fname);
+
 #ifdef DEBUG
 	Debug(DBG_INPUT, "Raw reader created, will perform first update");
 #endif
@@ -712,6 +715,10 @@ bool Raw::DoHeartbeat(double network_time, double current_time)
 
 		case MODE_REREAD:
 		case MODE_STREAM:
+			if ( Watched() )
+				// We get updated when the file changes.
+				break;
+
 #ifdef DEBUG
 	Debug(DBG_INPUT, "Starting Heartbeat update");
 #endif
@@ -21,7 +21,8 @@ using threading::Field;
 
 SQLite::SQLite(ReaderFrontend *frontend)
 	: ReaderBackend(frontend),
-	  fields(), num_fields(), mode(), started(), query(), db(), st()
+	  fields(), num_fields(), mode(), started(), query(), db(), st(),
+	  watermark_param(), watermark()
 	{
 	set_separator.assign(
 			(const char*) BifConst::LogSQLite::set_separator->Bytes(),
@@ -51,9 +52,14 @@ void SQLite::DoClose()
 	{
 	if ( db != 0 )
 		{
+		sqlite3_finalize(st);
+		st = 0;
 		sqlite3_close(db);
 		db = 0;
 		}
+
+	sqlite3_value_free(watermark);
+	watermark = 0;
 	}
 
 bool SQLite::checkError(int code)
@@ -79,9 +85,9 @@ bool SQLite::DoInit(const ReaderInfo& info, int arg_num_fields, const threading:
 	// allows simultaneous writes to one file.
 	sqlite3_enable_shared_cache(1);
 
-	if ( Info().mode != MODE_MANUAL )
+	if ( Info().mode != MODE_MANUAL && Info().mode != MODE_STREAM )
 		{
-		Error("SQLite only supports manual reading mode.");
+		Error("SQLite only supports manual and streaming reading modes.");
 		return false;
 		}
 
@@ -118,6 +124,36 @@ bool SQLite::DoInit(const ReaderInfo& info, int arg_num_fields, const threading:
 		return false;
 		}
 
+	if ( Info().mode == MODE_STREAM )
+		{
+		// Streaming only fetches rows added since the last time, by
+		// way of the query comparing to the last row's watermark.
+		watermark_param = sqlite3_bind_parameter_index(st, ":watermark");
+
+		if ( ! watermark_param )
+			{
+			Error(Fmt("Query for streaming SQLite data source %s needs a :watermark parameter. Aborting.", info.source));
+			return false;
+			}
+
+		it = info.config.find("watermark");
+		watermark_column = it != info.config.end() ? it->second : "rowid";
+
+		it = info.config.find("watermark_start");
+		if ( it != info.config.end() )
+			{
+			// Gets converted to the column's type by SQLite.
+			if ( checkError(sqlite3_bind_text(st, watermark_param, it->second, -1, SQLITE_TRANSIENT)) )
+				return false;
+			}
+		else
+			{
+			// Sorts before any number or text.
+			if ( checkError(sqlite3_bind_int64(st, watermark_param, INT64_MIN)) )
+				return false;
+			}
+		}
+
 	DoUpdate();
 
 	return true;
@@ -244,6 +280,16 @@ Value* SQLite::EntryToVal(sqlite3_stmt *st, const threading::Field *field, int p
 
 	}
 
+bool SQLite::DoHeartbeat(double network_time, double current_time)
+	{
+	if ( Info().mode == MODE_STREAM )
+		// Call Update, not DoUpdate, because Update checks the
+		// "disabled" flag.
+		Update();
+
+	return true;
+	}
+
 bool SQLite::DoUpdate()
 	{
 	int numcolumns = sqlite3_column_count(st);
@@ -303,6 +349,32 @@ bool SQLite::DoUpdate()
 			}
 		}
 
+	int watermark_pos = -1;
+
+	if ( watermark_param )
+		{
+		for ( int i = 0; i < numcolumns; ++i )
+			{
+			if ( watermark_column == sqlite3_column_name(st, i) )
+				watermark_pos = i;
+			}
+
+		if ( watermark_pos == -1 )
+			{
+			Error(Fmt("Watermark column %s not found after SQLite statement", watermark_column.c_str()));
+			delete [] mapping;
+			delete [] submapping;
+			return false;
+			}
+
+		if ( watermark && checkError(sqlite3_bind_value(st, watermark_param, watermark)) )
+			{
+			delete [] mapping;
+			delete [] submapping;
+			return false;
+			}
+		}
+
 	int errorcode;
 	while ( ( errorcode = sqlite3_step(st)) == SQLITE_ROW )
 		{
@@ -323,7 +395,18 @@ bool SQLite::DoUpdate()
 				}
 			}
 
-		SendEntry(ofields);
+		if ( watermark_pos != -1 )
+			{
+			// The query sorts by the watermark, so the last row's
+			// is the one to continue from.
+			sqlite3_value_free(watermark);
+			watermark = sqlite3_value_dup(sqlite3_column_value(st, watermark_pos));
+			}
+
+		if ( Info().mode == MODE_STREAM )
+			Put(ofields);
+		else
+			SendEntry(ofields);
 		}
 
 	delete [] mapping;
@@ -332,7 +415,8 @@ bool SQLite::DoUpdate()
 	if ( checkError(errorcode) ) // check the last error code returned by sqlite
 		return false;
 
-	EndCurrentSend();
+	if ( Info().mode != MODE_STREAM )
+		EndCurrentSend();
 
 	if ( checkError(sqlite3_reset(st)) )
 		return false;
@@ -25,7 +25,8 @@ protected:
 	bool DoInit(const ReaderInfo& info, int arg_num_fields, const threading::Field* const* arg_fields) override;
 	void DoClose() override;
 	bool DoUpdate() override;
-	bool DoHeartbeat(double network_time, double current_time) override { return true; }
+	bool DoHeartbeat(double network_time, double current_time) override;
+	bool WantsHeartbeats() override	{ return Info().mode == MODE_STREAM; }
 
 private:
 	bool checkError(int code);
@@ -41,6 +42,13 @@ private:
 	sqlite3_stmt *st;
 	threading::formatter::Ascii* io;
 
+	// For streaming: the query's :watermark parameter, the result
+	// column it gets set from, and that column's value in the last row
+	// seen.
+	int watermark_param;
+	string watermark_column;
+	sqlite3_value* watermark;
+
 	string set_separator;
 	string unset_field;
 	string empty_field;
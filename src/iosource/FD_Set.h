@@ -77,6 +77,37 @@ public:
 		return false;
 		}
 
+	/**
+	 * @return Whether this set and another one have at least one file
+	 *         descriptor in common.
+	 */
+	bool Ready(const FD_Set& other) const
+		{
+		const FD_Set& small = fds.size() <= other.fds.size() ? *this : other;
+		const FD_Set& large = fds.size() <= other.fds.size() ? other : *this;
+
+		for ( std::set<int>::const_iterator it = small.fds.begin();
+		      it != small.fds.end(); ++it )
+			{
+			if ( large.fds.find(*it) != large.fds.end() )
+				return true;
+			}
+
+		return false;
+		}
+
+	/**
+	 * Provides access to the file descriptors in the set.
+	 */
+	std::set<int>::const_iterator begin() const
+		{ return fds.begin(); }
+
+	/**
+	 * Provides access to the file descriptors in the set.
+	 */
+	std::set<int>::const_iterator end() const
+		{ return fds.end(); }
+
 	/**
 	 * @return whether any file descriptors have been added to the set.
 	 */
@@ -2,8 +2,10 @@
 
 #include <sys/types.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 #include <assert.h>
+#include <errno.h>
 
 #include <algorithm>
 
@@ -14,11 +16,30 @@
 #include "plugin/Manager.h"
 
 #include "util.h"
+#include "Net.h"
 
 #define DEFAULT_PREFIX "pcap"
 
+// Longest that we sleep waiting for a packet to become due in
+// pseudo-realtime mode, in seconds.
+#define PSEUDO_REALTIME_MAX_SLEEP 0.01
+
 using namespace iosource;
 
+Manager::Manager()
+	{
+	call_count = 0;
+	dont_counts = 0;
+
+#ifdef USE_EPOLL
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+	if ( epoll_fd < 0 )
+		reporter->Warning("epoll_create1 failed, falling back to select(): %s",
+		                  strerror(errno));
+#endif
+	}
+
 Manager::~Manager()
 	{
 	for ( SourceList::iterator i = sources.begin(); i != sources.end(); ++i )
@@ -37,6 +58,11 @@ Manager::~Manager()
 		}
 
 	pkt_dumpers.clear();
+
+#ifdef USE_EPOLL
+	if ( epoll_fd >= 0 )
+		close(epoll_fd);
+#endif
 	}
 
 void Manager::RemoveAll()
@@ -72,6 +98,10 @@ IOSource* Manager::FindSoonest(double* ts)
 	double soonest_local_network_time = 1e20;
 	bool all_idle = true;
 
+	// File descriptors to check, and those found ready.
+	FD_Set fd_read, fd_write, fd_except;
+	FD_Set read_ready, write_ready, except_ready;
+
 	// Find soonest source of those which tell us they have something to
 	// process.
 	for ( SourceList::iterator i = sources.begin(); i != sources.end(); ++i )
@@ -95,17 +125,12 @@ IOSource* Manager::FindSoonest(double* ts)
 	// If we found one and aren't going to select this time,
 	// return it.
 	int maxx = 0;
+	bool ready = false;
 
 	if ( soonest_src && (call_count % SELECT_FREQUENCY) != 0 )
 		goto finished;
 
 	// Select on the join of all file descriptors.
-	fd_set fd_read, fd_write, fd_except;
-
-	FD_ZERO(&fd_read);
-	FD_ZERO(&fd_write);
-	FD_ZERO(&fd_except);
-
 	for ( SourceList::iterator i = sources.begin();
 	      i != sources.end(); ++i )
 		{
@@ -118,7 +143,9 @@ IOSource* Manager::FindSoonest(double* ts)
 
 		src->Clear();
 		src->src->GetFds(&src->fd_read, &src->fd_write, &src->fd_except);
-		src->SetFds(&fd_read, &fd_write, &fd_except, &maxx);
+		fd_read.Insert(src->fd_read);
+		fd_write.Insert(src->fd_write);
+		fd_except.Insert(src->fd_except);
 		}
 
 	// We can't block indefinitely even when all sources are dry:
@@ -138,17 +165,42 @@ IOSource* Manager::FindSoonest(double* ts)
 		// the kernel's packet buffers to fill. - Robin
 		timeout.tv_sec = 0;
 		timeout.tv_usec = 20; // SELECT_TIMEOUT;
-		select(0, 0, 0, 0, &timeout);
+
+		double delay = PseudoRealtimeDelay();
+
+		if ( delay > 0 )
+			{
+			// In pseudo-realtime mode, we know when the next
+			// packet is due, and sleep until then rather than
+			// polling for it. Capped so that other sources still
+			// get checked regularly.
+			delay = std::min(delay, PSEUDO_REALTIME_MAX_SLEEP);
+			struct timespec ts;
+			ts.tv_sec = time_t(delay);
+			ts.tv_nsec = long((delay - ts.tv_sec) * 1e9);
+			nanosleep(&ts, 0);
+			}
+
+		else if ( delay < 0 )
+			select(0, 0, 0, 0, &timeout);
 		}
 
-	if ( ! maxx )
+	maxx = std::max(std::max(fd_read.Max(), fd_write.Max()), fd_except.Max());
+
+	if ( maxx <= 0 )
 		// No selectable fd at all.
 		goto finished;
 
-	timeout.tv_sec = 0;
-	timeout.tv_usec = 0;
+#ifdef USE_EPOLL
+	if ( epoll_fd >= 0 )
+		ready = EpollReady(fd_read, fd_write, fd_except,
+		                   &read_ready, &write_ready, &except_ready);
+	else
+#endif
+		ready = SelectReady(fd_read, fd_write, fd_except,
+		                    &read_ready, &write_ready, &except_ready);
 
-	if ( select(maxx + 1, &fd_read, &fd_write, &fd_except, &timeout) > 0 )
+	if ( ready )
 		{ // Find soonest.
 		for ( SourceList::iterator i = sources.begin();
 		      i != sources.end(); ++i )
@@ -158,7 +210,7 @@ IOSource* Manager::FindSoonest(double* ts)
 			if ( ! src->src->IsIdle() )
 				continue;
 
-			if ( src->Ready(&fd_read, &fd_write, &fd_except) )
+			if ( src->Ready(read_ready, write_ready, except_ready) )
 				{
 				double local_network_time = 0;
 				double ts = src->src->NextTimestamp(&local_network_time);
@@ -179,6 +231,24 @@ finished:
 	return soonest_src;
 	}
 
+double Manager::PseudoRealtimeDelay()
+	{
+	if ( ! pseudo_realtime )
+		return -1;
+
+	double delay = -1;
+
+	for ( PktSrcList::iterator i = pkt_srcs.begin(); i != pkt_srcs.end(); ++i )
+		{
+		double d = (*i)->PseudoRealtimeDelay();
+
+		if ( d >= 0 && (delay < 0 || d < delay) )
+			delay = d;
+		}
+
+	return delay;
+	}
+
 void Manager::Register(IOSource* src, bool dont_count)
 	{
 	// First see if we already have registered that source. If so, just
@@ -318,10 +388,170 @@ PktDumper* Manager::OpenPktDumper(const string& path, bool append)
 	return pd;
 	}
 
-void Manager::Source::SetFds(fd_set* read, fd_set* write, fd_set* except,
-                             int* maxx) const
+bool Manager::SelectReady(const FD_Set& read, const FD_Set& write,
+                          const FD_Set& except, FD_Set* read_ready,
+                          FD_Set* write_ready, FD_Set* except_ready)
+	{
+	fd_set fd_read, fd_write, fd_except;
+	FD_ZERO(&fd_read);
+	FD_ZERO(&fd_write);
+	FD_ZERO(&fd_except);
+
+	int maxx = 0;
+	maxx = std::max(maxx, read.Set(&fd_read));
+	maxx = std::max(maxx, write.Set(&fd_write));
+	maxx = std::max(maxx, except.Set(&fd_except));
+
+	struct timeval timeout;
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 0;
+
+	if ( select(maxx + 1, &fd_read, &fd_write, &fd_except, &timeout) <= 0 )
+		return false;
+
+	for ( auto fd : read )
+		if ( FD_ISSET(fd, &fd_read) )
+			read_ready->Insert(fd);
+
+	for ( auto fd : write )
+		if ( FD_ISSET(fd, &fd_write) )
+			write_ready->Insert(fd);
+
+	for ( auto fd : except )
+		if ( FD_ISSET(fd, &fd_except) )
+			except_ready->Insert(fd);
+
+	return true;
+	}
+
+#ifdef USE_EPOLL
+
+bool Manager::EpollReady(const FD_Set& read, const FD_Set& write,
+                         const FD_Set& except, FD_Set* read_ready,
+                         FD_Set* write_ready, FD_Set* except_ready)
+	{
+	std::map<int, uint32_t> wanted;
+
+	for ( auto fd : read )
+		wanted[fd] |= EPOLLIN;
+
+	for ( auto fd : write )
+		wanted[fd] |= EPOLLOUT;
+
+	for ( auto fd : except )
+		wanted[fd] |= EPOLLPRI;
+
+	EpollSync(wanted);
+
+	bool ready = false;
+
+	// Descriptors that epoll can't watch are always ready, as with
+	// select().
+	for ( const auto& u : epoll_unsupported )
+		{
+		if ( u.second & EPOLLIN )
+			read_ready->Insert(u.first);
+
+		if ( u.second & EPOLLOUT )
+			write_ready->Insert(u.first);
+
+		if ( u.second & EPOLLPRI )
+			except_ready->Insert(u.first);
+
+		ready = true;
+		}
+
+	if ( epoll_registered.empty() )
+		return ready;
+
+	if ( epoll_events.size() < epoll_registered.size() )
+		epoll_events.resize(epoll_registered.size());
+
+	int n = epoll_wait(epoll_fd, epoll_events.data(), epoll_events.size(), 0);
+
+	for ( int i = 0; i < n; ++i )
+		{
+		int fd = epoll_events[i].data.fd;
+		uint32_t ev = epoll_events[i].events;
+		uint32_t interest = epoll_registered[fd];
+
+		// select() reports errors and hangups as readiness for
+		// whatever the caller asked for.
+		if ( ev & (EPOLLERR | EPOLLHUP) )
+			ev |= interest;
+
+		if ( (ev & EPOLLIN) && (interest & EPOLLIN) )
+			read_ready->Insert(fd);
+
+		if ( (ev & EPOLLOUT) && (interest & EPOLLOUT) )
+			write_ready->Insert(fd);
+
+		if ( (ev & EPOLLPRI) && (interest & EPOLLPRI) )
+			except_ready->Insert(fd);
+
+		ready = true;
+		}
+
+	return ready;
+	}
+
+void Manager::EpollSync(const std::map<int, uint32_t>& wanted)
 	{
-	*maxx = std::max(*maxx, fd_read.Set(read));
-	*maxx = std::max(*maxx, fd_write.Set(write));
-	*maxx = std::max(*maxx, fd_except.Set(except));
+	// Drop registrations that are no longer needed. If the fd has been
+	// closed in the meantime, the kernel has already removed it and the
+	// call fails harmlessly.
+	for ( auto i = epoll_registered.begin(); i != epoll_registered.end(); )
+		{
+		if ( wanted.find(i->first) == wanted.end() )
+			{
+			epoll_ctl(epoll_fd, EPOLL_CTL_DEL, i->first, 0);
+			i = epoll_registered.erase(i);
+			}
+		else
+			++i;
+		}
+
+	epoll_unsupported.clear();
+
+	for ( const auto& w : wanted )
+		{
+		int fd = w.first;
+		uint32_t mask = w.second;
+
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = mask;
+		ev.data.fd = fd;
+
+		auto i = epoll_registered.find(fd);
+
+		if ( i != epoll_registered.end() )
+			{
+			if ( i->second == mask )
+				continue;
+
+			// ENOENT means the fd got closed and reused since we
+			// registered it; fall through to adding it again.
+			if ( epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0 )
+				{
+				i->second = mask;
+				continue;
+				}
+
+			epoll_registered.erase(i);
+
+			if ( errno != ENOENT )
+				{
+				epoll_unsupported[fd] = mask;
+				continue;
+				}
+			}
+
+		if ( epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0 )
+			epoll_registered[fd] = mask;
+		else
+			epoll_unsupported[fd] = mask;
+		}
 	}
+
+#endif
@@ -5,8 +5,17 @@
 
 #include <string>
 #include <list>
+#include <map>
+#include <vector>
+
+#include "zeek-config.h"
 #include "iosource/FD_Set.h"
 
+#ifdef HAVE_LINUX
+#define USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 namespace iosource {
 
 class IOSource;
@@ -21,7 +30,7 @@ public:
 	/**
 	 * Constructor.
 	 */
-	Manager()	{ call_count = 0; dont_counts = 0; }
+	Manager();
 
 	/**
 	 * Destructor.
@@ -111,6 +120,51 @@ private:
 	void Register(PktSrc* src);
 	void RemoveAll();
 
+	/**
+	 * In pseudo-realtime mode, returns how long until the soonest
+	 * packet of any source is due, in seconds, or -1 if not known.
+	 */
+	double PseudoRealtimeDelay();
+
+	/**
+	 * Determines which of the given file descriptors are ready, using
+	 * select().
+	 *
+	 * @return True if any descriptor is ready.
+	 */
+	bool SelectReady(const FD_Set& read, const FD_Set& write,
+	                 const FD_Set& except, FD_Set* read_ready,
+	                 FD_Set* write_ready, FD_Set* except_ready);
+
+#ifdef USE_EPOLL
+	/**
+	 * Determines which of the given file descriptors are ready, using
+	 * epoll. The epoll instance keeps its registrations across calls;
+	 * only descriptors that were added, removed, or changed interest
+	 * since the last call cause a system call of their own.
+	 *
+	 * @return True if any descriptor is ready.
+	 */
+	bool EpollReady(const FD_Set& read, const FD_Set& write,
+	                const FD_Set& except, FD_Set* read_ready,
+	                FD_Set* write_ready, FD_Set* except_ready);
+
+	// Updates the epoll registrations to match the given interest
+	// masks, indexed by file descriptor.
+	void EpollSync(const std::map<int, uint32_t>& wanted);
+
+	int epoll_fd;
+
+	// Interest masks currently registered with the epoll instance.
+	std::map<int, uint32_t> epoll_registered;
+
+	// File descriptors that epoll doesn't support (e.g., regular files).
+	// Like select(), we consider them always ready.
+	std::map<int, uint32_t> epoll_unsupported;
+
+	std::vector<struct epoll_event> epoll_events;
+#endif
+
 	unsigned int call_count;
 	int dont_counts;
 
@@ -121,13 +175,11 @@ private:
 		FD_Set fd_except;
 		bool dont_count;
 
-		bool Ready(fd_set* read, fd_set* write, fd_set* except) const
+		bool Ready(const FD_Set& read, const FD_Set& write,
+		           const FD_Set& except) const
 			{ return fd_read.Ready(read) || fd_write.Ready(write) ||
 			         fd_except.Ready(except); }
 
-		void SetFds(fd_set* read, fd_set* write, fd_set* except,
-		            int* maxx) const;
-
 		void Clear()
 			{ fd_read.Clear(); fd_write.Clear(); fd_except.Clear(); }
 	};
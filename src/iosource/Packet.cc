@@ -47,6 +47,7 @@ void Packet::Init(int arg_link_type, pkt_timeval *arg_ts, uint32 arg_caplen,
 	inner_vlan = 0;
 	l2_src = 0;
 	l2_dst = 0;
+	l4_checksum_valid = false;
 
 	l2_valid = false;
 
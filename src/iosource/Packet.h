@@ -195,6 +195,13 @@ public:
 	 */
 	uint32 inner_vlan;
 
+	/**
+	 * True if the packet source knows the transport-layer checksum to
+	 * be good, e.g. because the NIC verified it already. Zeek then
+	 * doesn't verify it again.
+	 */
+	bool l4_checksum_valid;
+
 private:
 	// Calculate layer 2 attributes. Sets
 	void ProcessLayer2();
@@ -12,6 +12,7 @@
 #include "Sessions.h"
 #include "broker/Manager.h"
 #include "iosource/Manager.h"
+#include "metrics/Manager.h"
 
 #include "pcap/pcap.bif.h"
 
@@ -166,6 +167,24 @@ double PktSrc::CheckPseudoTime()
 	return pseudo_time <= ct ? bro_start_time + pseudo_time : 0;
 	}
 
+double PktSrc::PseudoRealtimeDelay()
+	{
+	if ( ! pseudo_realtime || ! IsOpen() )
+		return -1;
+
+	if ( ! ExtractNextPacketInternal() )
+		return -1;
+
+	if ( ! first_wallclock )
+		// The first packet is due right away.
+		return 0;
+
+	double pseudo_time = current_packet.time - first_timestamp;
+	double ct = (current_time(true) - first_wallclock) * pseudo_realtime;
+
+	return pseudo_time > ct ? (pseudo_time - ct) / pseudo_realtime : 0;
+	}
+
 void PktSrc::Init()
 	{
 	Open();
@@ -231,27 +250,94 @@ void PktSrc::Process()
 	if ( ! IsOpen() )
 		return;
 
-	if ( ! ExtractNextPacketInternal() )
-		return;
+	int batch = BatchSize();
+
+	for ( int i = 0; i < batch; ++i )
+		{
+		if ( i > 0 && (! IsOpen() || terminating || ! HasPendingPackets()) )
+			break;
+
+		if ( i > 0 && pseudo_realtime && ! CheckPseudoTime() )
+			// Next one isn't due yet.
+			break;
+
+		if ( ! ExtractNextPacketInternal() )
+			break;
 
+		ProcessCurrentPacket();
+		}
+	}
+
+void PktSrc::ProcessCurrentPacket()
+	{
 	if ( current_packet.Layer2Valid() )
 		{
 		if ( pseudo_realtime )
 			{
 			current_pseudo = CheckPseudoTime();
+			UpdatePseudoRealtimeStats();
 			net_packet_dispatch(current_pseudo, &current_packet, this);
 			if ( ! first_wallclock )
 				first_wallclock = current_time(true);
 			}
 
 		else
+			{
+			metrics::Histogram* lag = metrics_mgr->GetLatencies().packet_lag;
+
+			if ( lag && props.is_live )
+				lag->Observe(current_time(true) - current_packet.time);
+
 			net_packet_dispatch(current_packet.time, &current_packet, this);
+			}
 		}
 
 	have_packet = 0;
 	DoneWithPacket();
 	}
 
+void PktSrc::UpdatePseudoRealtimeStats()
+	{
+	++pseudo_stats.packets;
+	pseudo_stats.speed = pseudo_realtime;
+
+	if ( ! first_wallclock )
+		// First packet, which sets the time base.
+		return;
+
+	double now = current_time(true);
+	double trace_time = current_packet.time - first_timestamp;
+	double lateness = (now - first_wallclock) - trace_time / pseudo_realtime;
+
+	pseudo_stats.trace_time = trace_time;
+	pseudo_stats.wall_time = now - first_wallclock;
+
+	if ( lateness > 0 )
+		{
+		pseudo_stats.total_lateness += lateness;
+
+		if ( lateness > pseudo_stats.max_lateness )
+			pseudo_stats.max_lateness = lateness;
+		}
+	}
+
+int PktSrc::BatchSize() const
+	{
+	// When reading traces, packets from all sources need to be
+	// interleaved by timestamp, so we go back to the main loop after
+	// each one. In pseudo-realtime mode, a single source may dispatch
+	// all packets that are due at once; Process() stops at the first
+	// one that isn't.
+	if ( pseudo_realtime && iosource_mgr->GetPktSrcs().size() > 1 )
+		return 1;
+
+	if ( ! props.is_live && ! pseudo_realtime )
+		return 1;
+
+	int n = BifConst::Pcap::packet_batch_size;
+	return n > 0 ? n : 1;
+	}
+
 const char* PktSrc::Tag()
 	{
 	return "PktSrc";
@@ -9,9 +9,12 @@
 #include "BPF_Program.h"
 #include "Dict.h"
 #include "Packet.h"
+#include "net_util.h"
 
 declare(PDict,BPF_Program);
 
+struct ConnID;
+
 namespace iosource {
 
 /**
@@ -105,6 +108,62 @@ public:
 	 */
 	double CurrentPacketWallClock();
 
+	/**
+	 * In pseudo-realtime mode, returns how much wall clock time is left
+	 * until the next packet is due, in seconds, or zero if it's due
+	 * already. Returns -1 if not running pseudo-realtime mode, or if the
+	 * source has no packet waiting.
+	 */
+	double PseudoRealtimeDelay();
+
+	/**
+	 * Struct for returning statistics on the pseudo-realtime replay of a
+	 * source.
+	 */
+	struct PseudoRealtimeStats {
+		/**
+		 * Packets dispatched.
+		 */
+		uint64 packets;
+
+		/**
+		 * The pseudo-realtime factor that the replay aims for.
+		 */
+		double speed;
+
+		/**
+		 * Trace time spanned by the packets dispatched.
+		 */
+		double trace_time;
+
+		/**
+		 * Wall clock time that dispatching them took.
+		 */
+		double wall_time;
+
+		/**
+		 * Total and maximum of how much later than due, in wall
+		 * clock time, the packets got dispatched.
+		 */
+		double total_lateness;
+		double max_lateness;
+
+		PseudoRealtimeStats()
+			{
+			packets = 0;
+			speed = trace_time = wall_time = total_lateness = max_lateness = 0;
+			}
+	};
+
+	/**
+	 * In pseudo-realtime mode, returns statistics on how well the
+	 * replay keeps up with the trace.
+	 *
+	 * @param stats A statistics structure that the method fills out.
+	 */
+	void GetPseudoRealtimeStats(PseudoRealtimeStats* stats) const
+		{ *stats = pseudo_stats; }
+
 	/**
 	 * Signals packet source that processing is going to be continued
 	 * after previous suspension.
@@ -207,6 +266,59 @@ public:
 	 */
 	virtual void Statistics(Stats* stats) = 0;
 
+	/**
+	 * Struct for returning the packets a source dropped for a shunted
+	 * flow.
+	 */
+	struct ShuntStats {
+		uint64 orig_packets;
+		uint64 orig_bytes;
+		uint64 resp_packets;
+		uint64 resp_bytes;
+
+		ShuntStats()
+			{ orig_packets = orig_bytes = resp_packets = resp_bytes = 0; }
+	};
+
+	/**
+	 * Asks the source to drop further packets of a flow before they
+	 * reach Zeek, in the kernel or on the NIC, so that they don't need
+	 * to get captured in the first place.
+	 *
+	 * Derived classes may override this if they can drop flows; by
+	 * default, sources can't.
+	 *
+	 * @param id The flow's endpoints, with the originator as the source.
+	 *
+	 * @param proto The flow's transport protocol.
+	 *
+	 * @return True if the source drops the flow's packets from now on.
+	 */
+	virtual bool Shunt(const ConnID& id, TransportProto proto)	{ return false; }
+
+	/**
+	 * Returns what the source dropped for a shunted flow so far.
+	 *
+	 * @param id The flow's endpoints, as passed to \a Shunt().
+	 *
+	 * @param proto The flow's transport protocol.
+	 *
+	 * @param stats A statistics structure that the method fills out.
+	 *
+	 * @return False if the flow isn't shunted.
+	 */
+	virtual bool ShuntStatistics(const ConnID& id, TransportProto proto,
+	                             ShuntStats* stats)	{ return false; }
+
+	/**
+	 * Lets further packets of a shunted flow reach Zeek again.
+	 *
+	 * @param id The flow's endpoints, as passed to \a Shunt().
+	 *
+	 * @param proto The flow's transport protocol.
+	 */
+	virtual void Unshunt(const ConnID& id, TransportProto proto)	{ }
+
 protected:
 	friend class Manager;
 
@@ -336,6 +448,20 @@ protected:
 	 */
 	virtual void DoneWithPacket() = 0;
 
+	/**
+	 * Returns true if the source can provide another packet right away
+	 * without blocking. The base class uses this to decide whether to
+	 * keep dispatching packets from within a single call to \a
+	 * Process() when reading live input, which avoids a round-trip
+	 * through the main loop's source selection for every packet.
+	 *
+	 * Derived classes may override this if they can tell cheaply that
+	 * more input is pending. The default implementation returns true,
+	 * which means that the base class will simply attempt to extract
+	 * the next packet and stop once \a ExtractNextPacket() fails.
+	 */
+	virtual bool HasPendingPackets()	{ return true; }
+
 private:
 	// Checks if the current packet has a pseudo-time <= current_time. If
 	// yes, returns pseudo-time, otherwise 0.
@@ -344,6 +470,18 @@ private:
 	// Internal helper for ExtractNextPacket().
 	bool ExtractNextPacketInternal();
 
+	// Hands the current packet to net_packet_dispatch() and releases
+	// it afterwards.
+	void ProcessCurrentPacket();
+
+	// Accounts for dispatching the current packet in pseudo-realtime
+	// mode.
+	void UpdatePseudoRealtimeStats();
+
+	// Returns the maximum number of packets that a single call to
+	// Process() may dispatch.
+	int BatchSize() const;
+
 	// IOSource interface implementation.
 	void Init() override;
 	void Done() override;
@@ -366,6 +504,7 @@ private:
 	double first_wallclock;
 	double current_wallclock;
 	double current_pseudo;
+	PseudoRealtimeStats pseudo_stats;
 	double next_sync_point; // For trace synchronziation in pseudo-realtime
 
 	std::string errbuf;
@@ -0,0 +1,28 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "plugin/Plugin.h"
+
+#include "Source.h"
+
+namespace plugin {
+namespace Zeek_AF_Packet {
+
+class Plugin : public plugin::Plugin {
+public:
+	plugin::Configuration Configure()
+		{
+#ifdef HAVE_LINUX
+		AddComponent(new ::iosource::PktSrcComponent("AF_PacketReader", "af_packet", ::iosource::PktSrcComponent::LIVE, ::iosource::af_packet::AF_PacketSource::Instantiate));
+#endif
+
+		plugin::Configuration config;
+		config.name = "Zeek::AF_Packet";
+		config.description = "Packet acquisition via Linux AF_PACKET sockets";
+		return config;
+		}
+} plugin;
+
+}
+}
@@ -0,0 +1,605 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#ifdef HAVE_LINUX
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/syscall.h>
+
+#include <vector>
+
+extern "C" {
+#include <linux/bpf.h>
+#include <linux/filter.h>
+}
+
+#include "ShuntFilter.h"
+
+using namespace iosource::af_packet;
+
+namespace {
+
+// Registers of the program. Loading packet data implicitly goes through
+// R6 and into R0, which makes R0 the natural accumulator of the classic
+// filter. Calls clobber R1 to R5.
+enum {
+	R0 = 0, R1, R2, R3, R4, R5, R6, R7, R8, R9, R10
+};
+
+const int REG_A = R0;		// Classic accumulator.
+const int REG_X = R7;		// Classic index register.
+const int REG_SAVE = R8;	// Keeps A while loading for X.
+const int REG_LEN = R9;		// Length of the packet.
+const int REG_CTX = R6;
+const int REG_FP = R10;
+
+// Stack layout: the flow's key right below the frame pointer, the
+// classic filter's scratch memory below it.
+const int KEY_OFF = -int(sizeof(ShuntFilter::Key));
+const int KEY_SRC = KEY_OFF + int(offsetof(ShuntFilter::Key, src));
+const int KEY_DST = KEY_OFF + int(offsetof(ShuntFilter::Key, dst));
+const int KEY_PORTS = KEY_OFF + int(offsetof(ShuntFilter::Key, ports));
+const int KEY_PROTO = KEY_OFF + int(offsetof(ShuntFilter::Key, proto));
+const int MEM_OFF = KEY_OFF - BPF_MEMWORDS * 4;
+
+// Classic ancillary loads we can map to fields of the packet's context.
+const int32 AD_PROTOCOL = SKF_AD_OFF + SKF_AD_PROTOCOL;
+const int32 AD_VLAN_TAG = SKF_AD_OFF + SKF_AD_VLAN_TAG;
+const int32 AD_VLAN_TAG_PRESENT = SKF_AD_OFF + SKF_AD_VLAN_TAG_PRESENT;
+
+// What we consider the whole packet when no filter limits it.
+const int32 ACCEPT_ALL = 262144;
+
+// Assembles a program, with jumps to labels resolved at the end.
+class Program {
+public:
+	void Emit(uint8 code, int dst, int src, int16 off, int32 imm)
+		{
+		struct bpf_insn i;
+		memset(&i, 0, sizeof(i));
+		i.code = code;
+		i.dst_reg = dst;
+		i.src_reg = src;
+		i.off = off;
+		i.imm = imm;
+		insns.push_back(i);
+		}
+
+	// Jumps with a comparison of dst against an immediate.
+	void JumpImm(uint8 op, int dst, int32 imm, int label)
+		{
+		fixups.push_back(std::make_pair(insns.size(), label));
+		Emit(BPF_JMP | op | BPF_K, dst, 0, 0, imm);
+		}
+
+	// Jumps with a comparison of two registers.
+	void JumpReg(uint8 op, int dst, int src, int label)
+		{
+		fixups.push_back(std::make_pair(insns.size(), label));
+		Emit(BPF_JMP | op | BPF_X, dst, src, 0, 0);
+		}
+
+	void Jump(int label)
+		{
+		fixups.push_back(std::make_pair(insns.size(), label));
+		Emit(BPF_JMP | BPF_JA, 0, 0, 0, 0);
+		}
+
+	void Mov32Imm(int dst, int32 imm)
+		{ Emit(BPF_ALU | BPF_MOV | BPF_K, dst, 0, 0, imm); }
+
+	void Mov32Reg(int dst, int src)
+		{ Emit(BPF_ALU | BPF_MOV | BPF_X, dst, src, 0, 0); }
+
+	void Mov64Reg(int dst, int src)
+		{ Emit(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0); }
+
+	void LoadAbs(uint8 size, int32 off)
+		{ Emit(BPF_LD | BPF_ABS | size, 0, 0, 0, off); }
+
+	void LoadCtx(int dst, int16 off)
+		{ Emit(BPF_LDX | BPF_MEM | BPF_W, dst, REG_CTX, off, 0); }
+
+	void StoreStack(int16 off, int src)
+		{ Emit(BPF_STX | BPF_MEM | BPF_W, REG_FP, src, off, 0); }
+
+	void StoreStackImm(int16 off, int32 imm)
+		{ Emit(BPF_ST | BPF_MEM | BPF_W, REG_FP, 0, off, imm); }
+
+	void LoadStack(int dst, int16 off)
+		{ Emit(BPF_LDX | BPF_MEM | BPF_W, dst, REG_FP, off, 0); }
+
+	void Return(int32 val)
+		{
+		Mov32Imm(R0, val);
+		Emit(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+		}
+
+	void Exit()
+		{ Emit(BPF_JMP | BPF_EXIT, 0, 0, 0, 0); }
+
+	int NewLabel()
+		{
+		labels.push_back(-1);
+		return labels.size() - 1;
+		}
+
+	void Bind(int label)
+		{ labels[label] = insns.size(); }
+
+	bool Resolve()
+		{
+		for ( const auto& f : fixups )
+			{
+			int target = labels[f.second];
+
+			if ( target < 0 || target <= int(f.first) )
+				return false;
+
+			int off = target - int(f.first) - 1;
+
+			if ( off > 32767 )
+				return false;
+
+			insns[f.first].off = off;
+			}
+
+		return true;
+		}
+
+	std::vector<struct bpf_insn> insns;
+
+private:
+	std::vector<int> labels;
+	std::vector<std::pair<size_t, int> > fixups;
+};
+
+int bpf(int cmd, union bpf_attr* attr)
+	{
+	return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+	}
+
+// Copies a flow direction's addresses, ports and protocol from the packet
+// to the key, then drops the packet if the flow is shunted. Anything we
+// can't parse goes on to the filter.
+void emit_shunt_check(Program* p, int map_fd, int filter)
+	{
+	int v4 = p->NewLabel();
+	int v6 = p->NewLabel();
+	int lookup = p->NewLabel();
+
+	p->Mov64Reg(REG_CTX, R1);
+	p->LoadCtx(REG_LEN, offsetof(struct __sk_buff, len));
+
+	// Loads past the end of the packet would end the program and
+	// drop it, so we check first.
+	p->JumpImm(BPF_JLT, REG_LEN, 14, filter);
+	p->LoadAbs(BPF_H, 12);
+	p->JumpImm(BPF_JEQ, R0, 0x0800, v4);
+	p->JumpImm(BPF_JEQ, R0, 0x86dd, v6);
+	p->Jump(filter);
+
+	int v4_proto_ok = p->NewLabel();
+	p->Bind(v4);
+	p->JumpImm(BPF_JLT, REG_LEN, 14 + 20, filter);
+	p->LoadAbs(BPF_B, 14 + 9);
+	p->JumpImm(BPF_JEQ, R0, IPPROTO_TCP, v4_proto_ok);
+	p->JumpImm(BPF_JNE, R0, IPPROTO_UDP, filter);
+	p->Bind(v4_proto_ok);
+	p->StoreStack(KEY_PROTO, R0);
+
+	// Later fragments don't have ports.
+	p->LoadAbs(BPF_H, 14 + 6);
+	p->Emit(BPF_ALU | BPF_AND | BPF_K, R0, 0, 0, 0x1fff);
+	p->JumpImm(BPF_JNE, R0, 0, filter);
+
+	p->StoreStackImm(KEY_SRC, 0);
+	p->StoreStackImm(KEY_SRC + 4, 0);
+	p->StoreStackImm(KEY_SRC + 8, 0xffff);
+	p->LoadAbs(BPF_W, 14 + 12);
+	p->StoreStack(KEY_SRC + 12, R0);
+	p->StoreStackImm(KEY_DST, 0);
+	p->StoreStackImm(KEY_DST + 4, 0);
+	p->StoreStackImm(KEY_DST + 8, 0xffff);
+	p->LoadAbs(BPF_W, 14 + 16);
+	p->StoreStack(KEY_DST + 12, R0);
+
+	// The ports follow the header, whose length may vary.
+	p->LoadAbs(BPF_B, 14);
+	p->Emit(BPF_ALU | BPF_AND | BPF_K, R0, 0, 0, 0xf);
+	p->Emit(BPF_ALU | BPF_LSH | BPF_K, R0, 0, 0, 2);
+	p->Mov32Reg(REG_X, R0);
+	p->Emit(BPF_ALU64 | BPF_ADD | BPF_K, R0, 0, 0, 14 + 4);
+	p->JumpReg(BPF_JGT, R0, REG_LEN, filter);
+	p->Emit(BPF_LD | BPF_IND | BPF_W, 0, REG_X, 0, 14);
+	p->StoreStack(KEY_PORTS, R0);
+	p->Jump(lookup);
+
+	// We only look at IPv6 packets without extension headers.
+	int v6_proto_ok = p->NewLabel();
+	p->Bind(v6);
+	p->JumpImm(BPF_JLT, REG_LEN, 14 + 40 + 4, filter);
+	p->LoadAbs(BPF_B, 14 + 6);
+	p->JumpImm(BPF_JEQ, R0, IPPROTO_TCP, v6_proto_ok);
+	p->JumpImm(BPF_JNE, R0, IPPROTO_UDP, filter);
+	p->Bind(v6_proto_ok);
+	p->StoreStack(KEY_PROTO, R0);
+
+	for ( int i = 0; i < 8; ++i )
+		{
+		p->LoadAbs(BPF_W, 14 + 8 + i * 4);
+		p->StoreStack(KEY_SRC + i * 4, R0);
+		}
+
+	p->LoadAbs(BPF_W, 14 + 40);
+	p->StoreStack(KEY_PORTS, R0);
+
+	p->Bind(lookup);
+	p->Emit(BPF_LD | BPF_DW | BPF_IMM, R1, BPF_PSEUDO_MAP_FD, 0, map_fd);
+	p->Emit(0, 0, 0, 0, 0);
+	p->Mov64Reg(R2, REG_FP);
+	p->Emit(BPF_ALU64 | BPF_ADD | BPF_K, R2, 0, 0, KEY_OFF);
+	p->Emit(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem);
+	p->JumpImm(BPF_JEQ, R0, 0, filter);
+
+	p->Emit(BPF_ALU64 | BPF_MOV | BPF_K, R1, 0, 0, 1);
+	p->Emit(BPF_STX | BPF_XADD | BPF_DW, R0, R1,
+	        offsetof(ShuntFilter::Counters, packets), 0);
+	p->Emit(BPF_STX | BPF_XADD | BPF_DW, R0, REG_LEN,
+	        offsetof(ShuntFilter::Counters, bytes), 0);
+	p->Return(0);
+	}
+
+// Compares A against a classic instruction's operand. Immediates would
+// get sign-extended to 64 bits, so we move large ones to a register.
+void emit_compare(Program* p, uint8 op, const struct sock_filter& f,
+                  int label)
+	{
+	if ( BPF_SRC(f.code) == BPF_X )
+		p->JumpReg(op, REG_A, REG_X, label);
+
+	else if ( f.k & 0x80000000 )
+		{
+		p->Mov32Imm(R1, f.k);
+		p->JumpReg(op, REG_A, R1, label);
+		}
+
+	else
+		p->JumpImm(op, REG_A, f.k, label);
+	}
+
+// Translates a classic filter, much like the kernel does internally.
+bool emit_filter(Program* p, const struct sock_filter* filter,
+                 unsigned int len, std::string* error)
+	{
+	// The kernel has checked the scratch memory gets written before
+	// being read, but the verifier only sees our translation.
+	for ( int i = 0; i < BPF_MEMWORDS; ++i )
+		p->StoreStackImm(MEM_OFF + i * 4, 0);
+
+	p->Mov32Imm(REG_A, 0);
+	p->Mov32Imm(REG_X, 0);
+
+	if ( ! filter )
+		{
+		p->Return(ACCEPT_ALL);
+		return true;
+		}
+
+	std::vector<int> labels(len);
+
+	for ( unsigned int i = 0; i < len; ++i )
+		labels[i] = p->NewLabel();
+
+	for ( unsigned int i = 0; i < len; ++i )
+		{
+		const struct sock_filter& f = filter[i];
+		p->Bind(labels[i]);
+
+		unsigned int jt = i + 1 + f.jt;
+		unsigned int jf = i + 1 + f.jf;
+
+		switch ( BPF_CLASS(f.code) ) {
+		case BPF_LD:
+			switch ( BPF_MODE(f.code) ) {
+			case BPF_ABS:
+				if ( int32(f.k) >= 0 )
+					p->LoadAbs(BPF_SIZE(f.code), f.k);
+
+				else if ( int32(f.k) == AD_PROTOCOL )
+					{
+					p->LoadCtx(REG_A, offsetof(struct __sk_buff, protocol));
+					p->Emit(BPF_ALU | BPF_END | BPF_TO_BE, REG_A, 0, 0, 16);
+					}
+
+				else if ( int32(f.k) == AD_VLAN_TAG )
+					p->LoadCtx(REG_A, offsetof(struct __sk_buff, vlan_tci));
+
+				else if ( int32(f.k) == AD_VLAN_TAG_PRESENT )
+					p->LoadCtx(REG_A, offsetof(struct __sk_buff, vlan_present));
+
+				else
+					{
+					*error = fmt("unsupported ancillary load %d",
+					             int32(f.k) - SKF_AD_OFF);
+					return false;
+					}
+				break;
+
+			case BPF_IND:
+				p->Emit(BPF_LD | BPF_IND | BPF_SIZE(f.code), 0, REG_X, 0, f.k);
+				break;
+
+			case BPF_LEN:
+				p->LoadCtx(REG_A, offsetof(struct __sk_buff, len));
+				break;
+
+			case BPF_IMM:
+				p->Mov32Imm(REG_A, f.k);
+				break;
+
+			case BPF_MEM:
+				if ( f.k >= BPF_MEMWORDS )
+					goto bad;
+
+				p->LoadStack(REG_A, MEM_OFF + f.k * 4);
+				break;
+
+			default:
+				goto bad;
+			}
+			break;
+
+		case BPF_LDX:
+			switch ( BPF_MODE(f.code) ) {
+			case BPF_IMM:
+				p->Mov32Imm(REG_X, f.k);
+				break;
+
+			case BPF_LEN:
+				p->LoadCtx(REG_X, offsetof(struct __sk_buff, len));
+				break;
+
+			case BPF_MEM:
+				if ( f.k >= BPF_MEMWORDS )
+					goto bad;
+
+				p->LoadStack(REG_X, MEM_OFF + f.k * 4);
+				break;
+
+			case BPF_MSH:
+				// Loading goes through A, which we must keep.
+				p->Mov64Reg(REG_SAVE, REG_A);
+				p->LoadAbs(BPF_B, f.k);
+				p->Emit(BPF_ALU | BPF_AND | BPF_K, R0, 0, 0, 0xf);
+				p->Emit(BPF_ALU | BPF_LSH | BPF_K, R0, 0, 0, 2);
+				p->Mov32Reg(REG_X, R0);
+				p->Mov64Reg(REG_A, REG_SAVE);
+				break;
+
+			default:
+				goto bad;
+			}
+			break;
+
+		case BPF_ST:
+		case BPF_STX:
+			if ( f.k >= BPF_MEMWORDS )
+				goto bad;
+
+			p->StoreStack(MEM_OFF + f.k * 4,
+			              BPF_CLASS(f.code) == BPF_ST ? REG_A : REG_X);
+			break;
+
+		case BPF_ALU:
+			{
+			uint8 op = BPF_OP(f.code);
+
+			if ( op == BPF_NEG )
+				{
+				p->Emit(BPF_ALU | BPF_NEG, REG_A, 0, 0, 0);
+				break;
+				}
+
+			if ( BPF_SRC(f.code) == BPF_K )
+				{
+				p->Emit(BPF_ALU | op | BPF_K, REG_A, 0, 0, f.k);
+				break;
+				}
+
+			// A classic filter returns zero when dividing by
+			// zero.
+			if ( op == BPF_DIV || op == BPF_MOD )
+				{
+				int ok = p->NewLabel();
+				p->JumpImm(BPF_JNE, REG_X, 0, ok);
+				p->Return(0);
+				p->Bind(ok);
+				}
+
+			p->Emit(BPF_ALU | op | BPF_X, REG_A, REG_X, 0, 0);
+			break;
+			}
+
+		case BPF_JMP:
+			{
+			uint8 op = BPF_OP(f.code);
+
+			if ( op == BPF_JA )
+				{
+				if ( i + 1 + f.k >= len )
+					goto bad;
+
+				p->Jump(labels[i + 1 + f.k]);
+				break;
+				}
+
+			if ( jt >= len || jf >= len )
+				goto bad;
+
+			if ( op != BPF_JEQ && op != BPF_JGT && op != BPF_JGE &&
+			     op != BPF_JSET )
+				goto bad;
+
+			emit_compare(p, op, f, labels[jt]);
+			p->Jump(labels[jf]);
+			break;
+			}
+
+		case BPF_RET:
+			if ( BPF_RVAL(f.code) == BPF_A )
+				p->Exit();
+
+			else if ( BPF_RVAL(f.code) == BPF_K )
+				p->Return(f.k);
+
+			else
+				goto bad;
+			break;
+
+		case BPF_MISC:
+			if ( BPF_MISCOP(f.code) == BPF_TAX )
+				p->Mov32Reg(REG_X, REG_A);
+			else
+				p->Mov32Reg(REG_A, REG_X);
+			break;
+
+		default:
+			goto bad;
+		}
+		}
+
+	return true;
+
+bad:
+	*error = "unsupported filter instruction";
+	return false;
+	}
+
+}
+
+ShuntFilter::ShuntFilter()
+	{
+	map_fd = -1;
+	}
+
+ShuntFilter::~ShuntFilter()
+	{
+	if ( map_fd >= 0 )
+		close(map_fd);
+	}
+
+bool ShuntFilter::Init(uint32 max_flows, std::string* error)
+	{
+	union bpf_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = BPF_MAP_TYPE_HASH;
+	attr.key_size = sizeof(Key);
+	attr.value_size = sizeof(Counters);
+	attr.max_entries = max_flows;
+
+	map_fd = bpf(BPF_MAP_CREATE, &attr);
+
+	if ( map_fd < 0 )
+		{
+		*error = strerror(errno);
+		return false;
+		}
+
+	return true;
+	}
+
+int ShuntFilter::Load(const struct sock_filter* filter, unsigned int len,
+                      std::string* error)
+	{
+	Program p;
+	int rest = p.NewLabel();
+
+	emit_shunt_check(&p, map_fd, rest);
+	p.Bind(rest);
+
+	if ( ! emit_filter(&p, filter, len, error) )
+		return -1;
+
+	if ( ! p.Resolve() )
+		{
+		*error = "filter jumps out of range";
+		return -1;
+		}
+
+	char log[4096];
+	log[0] = '\0';
+
+	union bpf_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+	attr.insns = (uint64) (uintptr_t) p.insns.data();
+	attr.insn_cnt = p.insns.size();
+	attr.license = (uint64) (uintptr_t) "BSD";
+	attr.log_buf = (uint64) (uintptr_t) log;
+	attr.log_size = sizeof(log);
+	attr.log_level = 1;
+
+	int fd = bpf(BPF_PROG_LOAD, &attr);
+
+	// The log fills up for large programs, which fails loading them
+	// altogether, so we only ask for it when necessary.
+	if ( fd < 0 && errno == ENOSPC )
+		{
+		attr.log_buf = 0;
+		attr.log_size = 0;
+		attr.log_level = 0;
+		fd = bpf(BPF_PROG_LOAD, &attr);
+		}
+
+	if ( fd < 0 )
+		{
+		*error = log[0] ? log : strerror(errno);
+		return -1;
+		}
+
+	return fd;
+	}
+
+bool ShuntFilter::Add(const Key& key)
+	{
+	Counters zero;
+	memset(&zero, 0, sizeof(zero));
+
+	union bpf_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = map_fd;
+	attr.key = (uint64) (uintptr_t) &key;
+	attr.value = (uint64) (uintptr_t) &zero;
+	attr.flags = BPF_ANY;
+
+	return bpf(BPF_MAP_UPDATE_ELEM, &attr) == 0;
+	}
+
+void ShuntFilter::Remove(const Key& key)
+	{
+	union bpf_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = map_fd;
+	attr.key = (uint64) (uintptr_t) &key;
+
+	bpf(BPF_MAP_DELETE_ELEM, &attr);
+	}
+
+bool ShuntFilter::Lookup(const Key& key, Counters* counters) const
+	{
+	union bpf_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = map_fd;
+	attr.key = (uint64) (uintptr_t) &key;
+	attr.value = (uint64) (uintptr_t) counters;
+
+	return bpf(BPF_MAP_LOOKUP_ELEM, &attr) == 0;
+	}
+
+#endif
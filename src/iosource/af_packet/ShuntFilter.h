@@ -0,0 +1,103 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef IOSOURCE_PKTSRC_AF_PACKET_SHUNTFILTER_H
+#define IOSOURCE_PKTSRC_AF_PACKET_SHUNTFILTER_H
+
+#include "zeek-config.h"
+
+#ifdef HAVE_LINUX
+
+#include <string>
+
+#include "util.h"
+
+struct sock_filter;
+
+namespace iosource {
+namespace af_packet {
+
+/**
+ * An eBPF socket filter dropping the packets of shunted flows in the
+ * kernel. It keeps the flows in a hash table that the kernel shares with
+ * us, and counts their packets and bytes there. Packets of other flows
+ * go through the regular BPF filter, which gets translated to eBPF so
+ * that both can run in the same program.
+ */
+class ShuntFilter {
+public:
+	/**
+	 * A direction of a flow, with all values in host order. IPv4
+	 * addresses are IPv4-mapped IPv6 addresses.
+	 */
+	struct Key {
+		uint32 src[4];
+		uint32 dst[4];
+		uint32 ports;	// Source port in the upper half.
+		uint32 proto;
+	};
+
+	/**
+	 * Counters of the packets dropped for a direction of a flow.
+	 */
+	struct Counters {
+		uint64 packets;
+		uint64 bytes;
+	};
+
+	ShuntFilter();
+	~ShuntFilter();
+
+	/**
+	 * Sets up the table of flows. Fails if the kernel doesn't let us,
+	 * which usually means missing privileges.
+	 *
+	 * @param max_flows The number of flow directions the table holds.
+	 *
+	 * @param error Set to the reason if failing.
+	 */
+	bool Init(uint32 max_flows, std::string* error);
+
+	/**
+	 * Builds the program to attach to a socket.
+	 *
+	 * @param filter The classic BPF filter to run on the packets of flows
+	 * that aren't shunted, or null for accepting all of them.
+	 *
+	 * @param len The number of the filter's instructions.
+	 *
+	 * @param error Set to the reason if failing.
+	 *
+	 * @return The program's file descriptor, to be closed by the caller,
+	 * or -1 if the filter can't be translated or the kernel refuses the
+	 * program.
+	 */
+	int Load(const struct sock_filter* filter, unsigned int len,
+	         std::string* error);
+
+	/**
+	 * Starts dropping the packets of a flow's direction, with the
+	 * counters at zero. Fails if the table is full.
+	 */
+	bool Add(const Key& key);
+
+	/**
+	 * Stops dropping the packets of a flow's direction.
+	 */
+	void Remove(const Key& key);
+
+	/**
+	 * Reads the counters of a flow's direction. Returns false if it
+	 * isn't shunted.
+	 */
+	bool Lookup(const Key& key, Counters* counters) const;
+
+private:
+	int map_fd;
+};
+
+}
+}
+
+#endif
+
+#endif
@@ -0,0 +1,600 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#ifdef HAVE_LINUX
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+extern "C" {
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+}
+
+#include "Source.h"
+#include "iosource/Packet.h"
+#include "Conn.h"
+
+#include "af_packet.bif.h"
+#include "pcap/pcap.bif.h"
+
+using namespace iosource::af_packet;
+
+AF_PacketSource::~AF_PacketSource()
+	{
+	Close();
+	delete [] vlan_buffer;
+	delete shunt;
+	}
+
+AF_PacketSource::AF_PacketSource(const std::string& path, bool is_live)
+	{
+	props.path = path;
+	props.is_live = is_live;
+	fd = -1;
+	ifindex = 0;
+	loopback = false;
+	ring = 0;
+	ring_size = 0;
+	block_size = 0;
+	num_blocks = 0;
+	current_block = 0;
+	block = 0;
+	next_hdr = 0;
+	pkts_left = 0;
+	kernel_packets = 0;
+	kernel_drops = 0;
+	vlan_buffer = 0;
+	drained = false;
+	shunt = 0;
+	shunt_attached = false;
+	}
+
+void AF_PacketSource::Open()
+	{
+	if ( ! props.is_live )
+		{
+		Error("af_packet sources can only read from interfaces");
+		return;
+		}
+
+	ifindex = if_nametoindex(props.path.c_str());
+
+	if ( ! ifindex )
+		{
+		Error(fmt("unknown interface %s", props.path.c_str()));
+		return;
+		}
+
+	fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+
+	if ( fd < 0 )
+		{
+		SystemError("socket");
+		return;
+		}
+
+	struct ifreq ifr;
+	memset(&ifr, 0, sizeof(ifr));
+	safe_strncpy(ifr.ifr_name, props.path.c_str(), sizeof(ifr.ifr_name));
+
+	if ( ioctl(fd, SIOCGIFFLAGS, &ifr) < 0 )
+		{
+		SystemError("SIOCGIFFLAGS");
+		return;
+		}
+
+	loopback = (ifr.ifr_flags & IFF_LOOPBACK);
+
+	int version = TPACKET_V3;
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0 )
+		{
+		SystemError("PACKET_VERSION");
+		return;
+		}
+
+	if ( BifConst::AF_Packet::enable_hw_timestamping && ! EnableHWTimestamping() )
+		return;
+
+	if ( ! SetupRing() )
+		return;
+
+	struct sockaddr_ll addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sll_family = AF_PACKET;
+	addr.sll_protocol = htons(ETH_P_ALL);
+	addr.sll_ifindex = ifindex;
+
+	if ( bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 )
+		{
+		SystemError("bind");
+		return;
+		}
+
+	struct packet_mreq mreq;
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.mr_ifindex = ifindex;
+	mreq.mr_type = PACKET_MR_PROMISC;
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 )
+		{
+		SystemError("PACKET_ADD_MEMBERSHIP");
+		return;
+		}
+
+	// Only now that we're bound, so that the other members of the
+	// group don't miss packets while we're setting up.
+	if ( BifConst::AF_Packet::enable_fanout && ! JoinFanout() )
+		return;
+
+	if ( BifConst::AF_Packet::max_shunted_flows )
+		{
+		std::string error;
+		shunt = new ShuntFilter();
+
+		// One entry per direction.
+		if ( ! shunt->Init(2 * BifConst::AF_Packet::max_shunted_flows, &error) )
+			{
+			Info(fmt("af_packet: not shunting flows in the kernel: %s", error.c_str()));
+			delete shunt;
+			shunt = 0;
+			}
+		}
+
+	props.selectable_fd = fd;
+	props.link_type = BifConst::AF_Packet::link_type;
+	props.netmask = NETMASK_UNKNOWN;
+	props.is_live = true;
+
+	Opened(props);
+	}
+
+bool AF_PacketSource::SetupRing()
+	{
+	block_size = BifConst::AF_Packet::block_size;
+	num_blocks = BifConst::AF_Packet::buffer_size / block_size;
+
+	if ( ! block_size || block_size % getpagesize() || ! num_blocks )
+		{
+		Error("AF_Packet::block_size must be a multiple of the page size, and at most AF_Packet::buffer_size");
+		Close();
+		return false;
+		}
+
+	// With TPACKET_V3, packets take as much of a block as they need; the
+	// frame size only serves the kernel's sanity checks.
+	unsigned int frame_size = TPACKET_ALIGN(TPACKET3_HDRLEN + BifConst::Pcap::snaplen);
+
+	if ( frame_size > block_size )
+		{
+		Error("AF_Packet::block_size is too small for Pcap::snaplen");
+		Close();
+		return false;
+		}
+
+	struct tpacket_req3 req;
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = block_size;
+	req.tp_block_nr = num_blocks;
+	req.tp_frame_size = frame_size;
+	req.tp_frame_nr = (block_size / frame_size) * num_blocks;
+	req.tp_retire_blk_tov = BifConst::AF_Packet::block_timeout * 1000;
+	req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0 )
+		{
+		SystemError("PACKET_RX_RING");
+		return false;
+		}
+
+	ring_size = size_t(block_size) * num_blocks;
+	ring = (u_char*) mmap(0, ring_size, PROT_READ | PROT_WRITE,
+	                      MAP_SHARED | MAP_POPULATE, fd, 0);
+
+	if ( ring == MAP_FAILED )
+		{
+		ring = 0;
+		SystemError("mmap");
+		return false;
+		}
+
+	current_block = 0;
+	block = 0;
+	pkts_left = 0;
+	return true;
+	}
+
+bool AF_PacketSource::JoinFanout()
+	{
+	int mode;
+
+	switch ( BifConst::AF_Packet::fanout_mode->AsEnum() ) {
+	case 1:
+		mode = PACKET_FANOUT_LB;
+		break;
+
+	case 2:
+		mode = PACKET_FANOUT_CPU;
+		break;
+
+	case 3:
+#ifdef PACKET_FANOUT_QM
+		mode = PACKET_FANOUT_QM;
+		break;
+#else
+		Error("AF_Packet::FANOUT_QM is not supported on this system");
+		Close();
+		return false;
+#endif
+
+	default:
+		mode = PACKET_FANOUT_HASH;
+		break;
+	}
+
+	if ( BifConst::AF_Packet::enable_defrag )
+		mode |= PACKET_FANOUT_FLAG_DEFRAG;
+
+	int arg = (BifConst::AF_Packet::fanout_id & 0xffff) | (mode << 16);
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0 )
+		{
+		SystemError("PACKET_FANOUT");
+		return false;
+		}
+
+	return true;
+	}
+
+bool AF_PacketSource::EnableHWTimestamping()
+	{
+	struct hwtstamp_config config;
+	memset(&config, 0, sizeof(config));
+	config.tx_type = HWTSTAMP_TX_OFF;
+	config.rx_filter = HWTSTAMP_FILTER_ALL;
+
+	struct ifreq ifr;
+	memset(&ifr, 0, sizeof(ifr));
+	safe_strncpy(ifr.ifr_name, props.path.c_str(), sizeof(ifr.ifr_name));
+	ifr.ifr_data = (char*) &config;
+
+	if ( ioctl(fd, SIOCSHWTSTAMP, &ifr) < 0 )
+		{
+		SystemError("SIOCSHWTSTAMP");
+		return false;
+		}
+
+	int req = SOF_TIMESTAMPING_RAW_HARDWARE;
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_TIMESTAMP, &req, sizeof(req)) < 0 )
+		{
+		SystemError("PACKET_TIMESTAMP");
+		return false;
+		}
+
+	return true;
+	}
+
+void AF_PacketSource::Close()
+	{
+	if ( fd < 0 )
+		return;
+
+	if ( ring )
+		munmap(ring, ring_size);
+
+	close(fd);
+	fd = -1;
+	ring = 0;
+	block = 0;
+	pkts_left = 0;
+
+	delete shunt;
+	shunt = 0;
+	shunt_attached = false;
+
+	Closed();
+	}
+
+bool AF_PacketSource::ExtractNextPacket(Packet* pkt)
+	{
+	if ( ! ring )
+		return false;
+
+	struct tpacket3_hdr* hdr = 0;
+
+	while ( ! hdr )
+		{
+		while ( ! pkts_left )
+			{
+			if ( block )
+				ReleaseBlock();
+
+			struct tpacket_block_desc* b =
+				(struct tpacket_block_desc*) (ring + size_t(current_block) * block_size);
+
+			// Make sure we see the block's contents only after its status.
+			if ( ! (__atomic_load_n(&b->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) )
+				{
+				drained = true;
+				return false;
+				}
+
+			block = b;
+			pkts_left = b->hdr.bh1.num_pkts;
+			next_hdr = (struct tpacket3_hdr*) ((u_char*) b + b->hdr.bh1.offset_to_first_pkt);
+			}
+
+		hdr = next_hdr;
+		next_hdr = (struct tpacket3_hdr*) ((u_char*) hdr + hdr->tp_next_offset);
+		--pkts_left;
+
+		// On loopback we'd see everything twice, once going out and
+		// once coming back in. Like libpcap, skip the former.
+		if ( loopback )
+			{
+			const struct sockaddr_ll* sll = (const struct sockaddr_ll*)
+				((const u_char*) hdr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+
+			if ( sll->sll_pkttype == PACKET_OUTGOING )
+				hdr = 0;
+			}
+		}
+
+	drained = false;
+
+	const u_char* data = (const u_char*) hdr + hdr->tp_mac;
+	uint32 caplen = hdr->tp_snaplen;
+	uint32 len = hdr->tp_len;
+
+	if ( (hdr->tp_status & TP_STATUS_VLAN_VALID) && caplen >= 12 )
+		{
+		if ( ! vlan_buffer )
+			vlan_buffer = new u_char[BifConst::Pcap::snaplen + 4];
+
+		uint16 tpid = ETH_P_8021Q;
+
+		if ( hdr->tp_status & TP_STATUS_VLAN_TPID_VALID )
+			tpid = hdr->hv1.tp_vlan_tpid;
+
+		if ( caplen > BifConst::Pcap::snaplen )
+			caplen = BifConst::Pcap::snaplen;
+
+		uint16 tag[2] = { htons(tpid), htons(hdr->hv1.tp_vlan_tci) };
+		memcpy(vlan_buffer, data, 12);
+		memcpy(vlan_buffer + 12, tag, 4);
+		memcpy(vlan_buffer + 16, data + 12, caplen - 12);
+
+		data = vlan_buffer;
+		caplen += 4;
+		len += 4;
+		}
+
+	struct timeval ts;
+	ts.tv_sec = hdr->tp_sec;
+	ts.tv_usec = hdr->tp_nsec / 1000;
+
+	pkt->Init(props.link_type, &ts, caplen, len, data);
+
+#ifdef TP_STATUS_CSUM_VALID
+	// The kernel or the NIC verified the checksum, or, for packets going
+	// out, has yet to fill it in.
+	if ( BifConst::AF_Packet::trust_checksum_offload &&
+	     (hdr->tp_status & (TP_STATUS_CSUM_VALID | TP_STATUS_CSUMNOTREADY)) )
+		pkt->l4_checksum_valid = true;
+#endif
+
+	if ( len == 0 || caplen == 0 )
+		{
+		Weird("empty_af_packet_header", pkt);
+		return false;
+		}
+
+	++stats.received;
+	stats.bytes_received += len;
+
+	return true;
+	}
+
+void AF_PacketSource::DoneWithPacket()
+	{
+	// Blocks go back to the kernel once we're through all their
+	// packets, which happens when looking for the next one.
+	}
+
+void AF_PacketSource::ReleaseBlock()
+	{
+	__atomic_store_n(&block->hdr.bh1.block_status, (uint32_t) TP_STATUS_KERNEL,
+	                 __ATOMIC_RELEASE);
+
+	block = 0;
+	current_block = (current_block + 1) % num_blocks;
+	}
+
+bool AF_PacketSource::HasPendingPackets()
+	{
+	return ring && ! drained;
+	}
+
+bool AF_PacketSource::PrecompileFilter(int index, const std::string& filter)
+	{
+	return PktSrc::PrecompileBPFFilter(index, filter);
+	}
+
+bool AF_PacketSource::SetFilter(int index)
+	{
+	if ( fd < 0 )
+		return true; // Prevent error message
+
+	BPF_Program* code = GetBPFFilter(index);
+
+	if ( ! code )
+		{
+		Error(fmt("No precompiled pcap filter for index %d", index));
+		return false;
+		}
+
+	// The kernel runs classic BPF with the same instruction layout.
+	struct bpf_program* prog = code->GetProgram();
+	struct sock_fprog fprog;
+	fprog.len = prog->bf_len;
+	fprog.filter = (struct sock_filter*) prog->bf_insns;
+
+	if ( shunt && AttachShuntFilter(fprog.filter, fprog.len) )
+		return true;
+
+	if ( setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0 )
+		{
+		Error(fmt("af_packet: cannot attach filter: %s", strerror(errno)));
+		return false;
+		}
+
+	return true;
+	}
+
+bool AF_PacketSource::AttachShuntFilter(const struct sock_filter* filter,
+                                        unsigned int len)
+	{
+	std::string error;
+	int prog = shunt->Load(filter, len, &error);
+
+	if ( prog >= 0 )
+		{
+		int rc = setsockopt(fd, SOL_SOCKET, SO_ATTACH_BPF, &prog, sizeof(prog));
+
+		if ( rc < 0 )
+			error = strerror(errno);
+
+		// The socket keeps its own reference.
+		close(prog);
+
+		if ( rc == 0 )
+			{
+			shunt_attached = true;
+			return true;
+			}
+		}
+
+	Info(fmt("af_packet: not shunting flows in the kernel: %s", error.c_str()));
+	delete shunt;
+	shunt = 0;
+	shunt_attached = false;
+	return false;
+	}
+
+static void make_shunt_key(const IPAddr& src, uint32 src_port,
+                           const IPAddr& dst, uint32 dst_port,
+                           TransportProto proto, ShuntFilter::Key* key)
+	{
+	src.CopyIPv6(key->src, IPAddr::Host);
+	dst.CopyIPv6(key->dst, IPAddr::Host);
+	key->ports = (uint32(ntohs(src_port)) << 16) | ntohs(dst_port);
+	key->proto = (proto == TRANSPORT_TCP ? IPPROTO_TCP : IPPROTO_UDP);
+	}
+
+bool AF_PacketSource::Shunt(const ConnID& id, TransportProto proto)
+	{
+	if ( ! shunt || (proto != TRANSPORT_TCP && proto != TRANSPORT_UDP) )
+		return false;
+
+	if ( ! shunt_attached && ! AttachShuntFilter(0, 0) )
+		return false;
+
+	ShuntFilter::Key orig, resp;
+	make_shunt_key(id.src_addr, id.src_port, id.dst_addr, id.dst_port, proto, &orig);
+	make_shunt_key(id.dst_addr, id.dst_port, id.src_addr, id.src_port, proto, &resp);
+
+	if ( ! shunt->Add(orig) )
+		return false;
+
+	if ( ! shunt->Add(resp) )
+		{
+		shunt->Remove(orig);
+		return false;
+		}
+
+	return true;
+	}
+
+bool AF_PacketSource::ShuntStatistics(const ConnID& id, TransportProto proto,
+                                      ShuntStats* stats)
+	{
+	if ( ! shunt )
+		return false;
+
+	ShuntFilter::Key orig, resp;
+	make_shunt_key(id.src_addr, id.src_port, id.dst_addr, id.dst_port, proto, &orig);
+	make_shunt_key(id.dst_addr, id.dst_port, id.src_addr, id.src_port, proto, &resp);
+
+	ShuntFilter::Counters c;
+
+	if ( ! shunt->Lookup(orig, &c) )
+		return false;
+
+	stats->orig_packets = c.packets;
+	stats->orig_bytes = c.bytes;
+
+	if ( ! shunt->Lookup(resp, &c) )
+		return false;
+
+	stats->resp_packets = c.packets;
+	stats->resp_bytes = c.bytes;
+	return true;
+	}
+
+void AF_PacketSource::Unshunt(const ConnID& id, TransportProto proto)
+	{
+	if ( ! shunt )
+		return;
+
+	ShuntFilter::Key orig, resp;
+	make_shunt_key(id.src_addr, id.src_port, id.dst_addr, id.dst_port, proto, &orig);
+	make_shunt_key(id.dst_addr, id.dst_port, id.src_addr, id.src_port, proto, &resp);
+
+	shunt->Remove(orig);
+	shunt->Remove(resp);
+	}
+
+void AF_PacketSource::Statistics(Stats* s)
+	{
+	if ( fd >= 0 )
+		{
+		struct tpacket_stats_v3 tstats;
+		socklen_t size = sizeof(tstats);
+
+		if ( getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &tstats, &size) == 0 )
+			{
+			// The kernel counts dropped packets as received, too.
+			kernel_packets += tstats.tp_packets;
+			kernel_drops += tstats.tp_drops;
+			}
+		}
+
+	s->received = stats.received;
+	s->bytes_received = stats.bytes_received;
+	s->link = kernel_packets;
+	s->dropped = kernel_drops;
+	}
+
+void AF_PacketSource::SystemError(const char* where)
+	{
+	Error(fmt("af_packet: %s failed: %s", where, strerror(errno)));
+	Close();
+	}
+
+iosource::PktSrc* AF_PacketSource::Instantiate(const std::string& path, bool is_live)
+	{
+	return new AF_PacketSource(path, is_live);
+	}
+
+#endif
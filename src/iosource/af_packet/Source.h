@@ -0,0 +1,107 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef IOSOURCE_PKTSRC_AF_PACKET_SOURCE_H
+#define IOSOURCE_PKTSRC_AF_PACKET_SOURCE_H
+
+#include "zeek-config.h"
+
+#ifdef HAVE_LINUX
+
+extern "C" {
+#include <linux/if_packet.h>
+}
+
+#include "../PktSrc.h"
+#include "ShuntFilter.h"
+
+namespace iosource {
+namespace af_packet {
+
+/**
+ * A packet source reading from a Linux AF_PACKET socket through a
+ * TPACKET_V3 ring buffer that's shared with the kernel. Packets get passed
+ * on right from the ring, and the kernel hands them over in blocks, which
+ * saves a system call per packet. Multiple processes can share the
+ * packets of an interface through a fanout group.
+ */
+class AF_PacketSource : public iosource::PktSrc {
+public:
+	AF_PacketSource(const std::string& path, bool is_live);
+	~AF_PacketSource() override;
+
+	static PktSrc* Instantiate(const std::string& path, bool is_live);
+
+protected:
+	// PktSrc interface.
+	void Open() override;
+	void Close() override;
+	bool ExtractNextPacket(Packet* pkt) override;
+	void DoneWithPacket() override;
+	bool HasPendingPackets() override;
+	bool PrecompileFilter(int index, const std::string& filter) override;
+	bool SetFilter(int index) override;
+	void Statistics(Stats* stats) override;
+	bool Shunt(const ConnID& id, TransportProto proto) override;
+	bool ShuntStatistics(const ConnID& id, TransportProto proto,
+	                     ShuntStats* stats) override;
+	void Unshunt(const ConnID& id, TransportProto proto) override;
+
+private:
+	bool SetupRing();
+	bool JoinFanout();
+	bool EnableHWTimestamping();
+
+	// Replaces the socket's filter with one that drops the shunted flows
+	// before running the given one. If that doesn't work, we stop
+	// shunting.
+	bool AttachShuntFilter(const struct sock_filter* filter, unsigned int len);
+
+	// Reports an error with the current errno and closes the socket.
+	void SystemError(const char* where);
+
+	// Hands the current block back to the kernel.
+	void ReleaseBlock();
+
+	Properties props;
+	Stats stats;
+
+	int fd;
+	int ifindex;
+	bool loopback;
+
+	u_char* ring;
+	size_t ring_size;
+	unsigned int block_size;
+	unsigned int num_blocks;
+
+	// The block we're reading from, if it's ours, and the packets of
+	// it yet to read.
+	unsigned int current_block;
+	struct tpacket_block_desc* block;
+	struct tpacket3_hdr* next_hdr;
+	unsigned int pkts_left;
+
+	// Counters from the kernel, which resets them on every read.
+	uint64 kernel_packets;
+	uint64 kernel_drops;
+
+	// The kernel strips VLAN tags off the packets, we put them back with
+	// a copy.
+	u_char* vlan_buffer;
+
+	// Set when the ring had no more packets for us, so that batched
+	// processing stops early.
+	bool drained;
+
+	// The flows the kernel drops for us, if it lets us. The filter
+	// checking for them only gets attached once needed.
+	ShuntFilter* shunt;
+	bool shunt_attached;
+};
+
+}
+}
+
+#endif
+
+#endif
@@ -0,0 +1,534 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <sys/stat.h>
+#include <errno.h>
+
+#include <algorithm>
+
+extern "C" {
+#include <pcap.h>
+}
+
+#include "AsyncDumper.h"
+#include "../PktSrc.h"
+#include "../../Net.h"
+#include "../../Reporter.h"
+#include "../../threading/Manager.h"
+
+#include "pcap.bif.h"
+
+using namespace iosource::pcap;
+
+// Longest that packets sit in a partially filled buffer, in terms of
+// packet time, before it gets handed to the writer anyway.
+#define FLUSH_INTERVAL 1.0
+
+// Sizes of the pcapng blocks we write, without packet data.
+#define PCAPNG_SHB_LEN 28
+#define PCAPNG_IDB_LEN 20
+#define PCAPNG_EPB_LEN 32
+
+AsyncPcapDumper::AsyncPcapDumper(const std::string& path, bool arg_append)
+	{
+	append = arg_append;
+	props.path = path;
+
+	buffer_size = 0;
+	max_buffers = 0;
+	pcapng = false;
+	compress = false;
+	rotate_size = 0;
+	rotate_interval = 0;
+	rotate_files = 0;
+
+	cur = 0;
+	in_file = false;
+	file_seq = 0;
+	file_bytes = 0;
+	file_start = 0;
+	last_handoff = 0;
+	pkt_time = 0;
+	dropped = 0;
+	dumped = 0;
+
+	num_buffers = 0;
+	stopping = false;
+	failed = false;
+
+	out.file = 0;
+	out.gz = 0;
+	writer_seq = 0;
+	}
+
+AsyncPcapDumper::~AsyncPcapDumper()
+	{
+	// Normally Close() has taken care of all this already.
+	if ( writer.joinable() )
+		{
+			{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			}
+
+		cond.notify_one();
+		writer.join();
+		CloseOutput();
+		}
+
+	delete cur;
+
+	for ( auto b : queue )
+		delete b;
+
+	for ( auto b : free_buffers )
+		delete b;
+	}
+
+void AsyncPcapDumper::Open()
+	{
+	if ( props.path.empty() )
+		{
+		Error("no filename given");
+		return;
+		}
+
+	buffer_size = std::max(BifConst::Pcap::async_buffer_size,
+	                       (bro_uint_t) BifConst::Pcap::snaplen + PCAPNG_EPB_LEN + PCAPNG_IDB_LEN);
+	// One to fill and at least one to hand off.
+	max_buffers = std::max(BifConst::Pcap::async_max_buffers, (bro_uint_t) 2);
+	pcapng = BifConst::Pcap::async_pcapng;
+	compress = BifConst::Pcap::async_compress;
+	rotate_size = BifConst::Pcap::async_rotate_size;
+	rotate_interval = BifConst::Pcap::async_rotate_interval;
+	rotate_files = BifConst::Pcap::async_rotate_files;
+
+	// Appending only applies to a single output file.
+	bool append_to = false;
+
+	if ( append && ! rotate_size && rotate_interval <= 0 )
+		{
+		struct stat s;
+
+		if ( stat(props.path.c_str(), &s) < 0 )
+			{
+			if ( errno != ENOENT )
+				{
+				Error(fmt("can't stat file %s: %s", props.path.c_str(), strerror(errno)));
+				return;
+				}
+			}
+
+		else
+			append_to = (s.st_size > 0);
+		}
+
+	std::string name = FileName(0);
+
+	if ( ! OpenOutput(name, append_to) )
+		{
+		Error(fmt("can't open dump %s: %s", name.c_str(), strerror(errno)));
+		return;
+		}
+
+	cur = new Buffer;
+	cur->data.resize(buffer_size);
+	cur->len = 0;
+	cur->last_in_file = false;
+	num_buffers = 1;
+
+	// A pcap file we append to has its header already, whereas pcapng
+	// simply starts a new section.
+	in_file = append_to && ! pcapng;
+
+	writer = std::thread(&AsyncPcapDumper::Writer, this);
+	thread_mgr->PlaceThread(writer);
+
+	props.open_time = network_time;
+	props.hdr_size = Packet::GetLinkHeaderSize(DLT_EN10MB);
+	Opened(props);
+	}
+
+void AsyncPcapDumper::Close()
+	{
+	if ( ! cur )
+		return;
+
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// Whatever is left goes out regardless of the bound.
+		if ( cur->len )
+			queue.push_back(cur);
+		else
+			free_buffers.push_back(cur);
+
+		cur = 0;
+		stopping = true;
+		}
+
+	cond.notify_one();
+	writer.join();
+
+	if ( ! CloseOutput() && ! failed )
+		Fail(fmt("can't close dump %s: %s",
+		         FileName(writer_seq).c_str(), strerror(errno)));
+
+	if ( failed )
+		Error(error);
+
+	if ( dropped )
+		reporter->Warning("packet dumper %s dropped %" PRIu64 " of %" PRIu64
+		                  " packets because writing fell behind",
+		                  props.path.c_str(), dropped, dropped + dumped);
+
+	Closed();
+	}
+
+bool AsyncPcapDumper::Dump(const Packet* pkt)
+	{
+	if ( ! cur )
+		return false;
+
+	if ( failed )
+		{
+		if ( ! IsError() )
+			{
+				{
+				std::lock_guard<std::mutex> lock(mutex);
+				Error(error);
+				}
+
+			reporter->Error("packet dumper %s: %s", props.path.c_str(),
+			                ErrorMsg());
+			}
+
+		return false;
+		}
+
+	double t = pkt_time = pkt->ts.tv_sec + pkt->ts.tv_usec / 1e6;
+
+	if ( in_file && NeedRotation(t) && HandOff(true) )
+		{
+		// If the writer is too busy even for that, we stay with the
+		// current file for now and try again with the next packet.
+		in_file = false;
+		++file_seq;
+		}
+
+	if ( ! in_file )
+		{
+		if ( cur->len && ! HandOff(false) )
+			{
+			++dropped;
+			return true;
+			}
+
+		StartFile(pkt->link_type);
+		file_start = t;
+		}
+
+	else if ( cur->len && t - last_handoff >= FLUSH_INTERVAL )
+		HandOff(false);
+
+	bool new_interface = pcapng &&
+	                     interfaces.find(pkt->link_type) == interfaces.end();
+
+	size_t padded_len = (pkt->cap_len + 3) & ~3;
+	size_t need = pcapng ?
+	              PCAPNG_EPB_LEN + padded_len +
+	              (new_interface ? PCAPNG_IDB_LEN : 0) :
+	              4 * sizeof(uint32) + pkt->cap_len;
+
+	if ( cur->len + need > cur->data.size() )
+		{
+		if ( cur->len && ! HandOff(false) )
+			{
+			++dropped;
+			return true;
+			}
+
+		if ( need > cur->data.size() )
+			cur->data.resize(need);
+		}
+
+	if ( pcapng )
+		{
+		if ( new_interface )
+			AddInterface(pkt->link_type);
+
+		uint64 ts = uint64(pkt->ts.tv_sec) * 1000000 + pkt->ts.tv_usec;
+		uint32 epb[7] = {
+			6, uint32(PCAPNG_EPB_LEN + padded_len),
+			interfaces[pkt->link_type],
+			uint32(ts >> 32), uint32(ts & 0xffffffff),
+			pkt->cap_len, pkt->len
+		};
+
+		static const u_char padding[3] = { 0, 0, 0 };
+
+		Append(epb, sizeof(epb));
+		Append(pkt->data, pkt->cap_len);
+		Append(padding, padded_len - pkt->cap_len);
+		Append(&epb[1], sizeof(uint32));
+		}
+
+	else
+		{
+		// The on-disk record header, which isn't struct pcap_pkthdr
+		// on platforms with a 64-bit timeval.
+		uint32 rec[4] = {
+			uint32(pkt->ts.tv_sec), uint32(pkt->ts.tv_usec),
+			pkt->cap_len, pkt->len
+		};
+
+		Append(rec, sizeof(rec));
+		Append(pkt->data, pkt->cap_len);
+		}
+
+	++dumped;
+	return true;
+	}
+
+bool AsyncPcapDumper::Append(const void* data, size_t len)
+	{
+	if ( cur->len + len > cur->data.size() )
+		return false;
+
+	memcpy(&cur->data[cur->len], data, len);
+	cur->len += len;
+	file_bytes += len;
+	return true;
+	}
+
+void AsyncPcapDumper::StartFile(int link_type)
+	{
+	in_file = true;
+	file_bytes = 0;
+	interfaces.clear();
+
+	if ( pcapng )
+		{
+		// Section header block, with unspecified section length.
+		uint32 shb[7] = {
+			0x0a0d0d0a, PCAPNG_SHB_LEN, 0x1a2b3c4d, 0,
+			0xffffffff, 0xffffffff, PCAPNG_SHB_LEN
+		};
+
+		// Major and minor version, 16 bits each.
+		uint16 version[2] = { 1, 0 };
+		memcpy(&shb[3], version, sizeof(version));
+
+		Append(shb, sizeof(shb));
+		}
+
+	else
+		{
+		// Same layout as libpcap's struct pcap_file_header.
+		struct {
+			uint32 magic;
+			uint16 version_major;
+			uint16 version_minor;
+			int32 thiszone;
+			uint32 sigfigs;
+			uint32 snaplen;
+			uint32 linktype;
+		} hdr;
+
+		hdr.magic = 0xa1b2c3d4;
+		hdr.version_major = 2;
+		hdr.version_minor = 4;
+		hdr.thiszone = 0;
+		hdr.sigfigs = 0;
+		hdr.snaplen = BifConst::Pcap::snaplen;
+		hdr.linktype = link_type;
+
+		Append(&hdr, sizeof(hdr));
+		}
+	}
+
+void AsyncPcapDumper::AddInterface(int link_type)
+	{
+	// Each link type we see in a file gets its own interface
+	// description block, so that its packets can refer to it.
+	uint32 id = interfaces.size();
+	interfaces[link_type] = id;
+
+	uint32 idb[5] = {
+		1, PCAPNG_IDB_LEN, 0, uint32(BifConst::Pcap::snaplen),
+		PCAPNG_IDB_LEN
+	};
+
+	// Link type and a reserved field, 16 bits each.
+	uint16 lt = link_type;
+	memcpy(&idb[2], &lt, sizeof(lt));
+
+	Append(idb, sizeof(idb));
+	}
+
+bool AsyncPcapDumper::NeedRotation(double t) const
+	{
+	if ( rotate_size && file_bytes >= rotate_size )
+		return true;
+
+	if ( rotate_interval > 0 && t - file_start >= rotate_interval )
+		return true;
+
+	return false;
+	}
+
+bool AsyncPcapDumper::HandOff(bool last_in_file)
+	{
+	if ( ! cur->len && ! last_in_file )
+		return true;
+
+	Buffer* next = 0;
+
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if ( free_buffers.size() )
+			{
+			next = free_buffers.back();
+			free_buffers.pop_back();
+			}
+
+		else if ( num_buffers < max_buffers )
+			{
+			next = new Buffer;
+			next->data.resize(buffer_size);
+			++num_buffers;
+			}
+
+		else
+			// All buffers are waiting for the writer.
+			return false;
+
+		cur->last_in_file = last_in_file;
+		queue.push_back(cur);
+		}
+
+	cond.notify_one();
+
+	cur = next;
+	cur->len = 0;
+	cur->last_in_file = false;
+	last_handoff = pkt_time;
+	return true;
+	}
+
+std::string AsyncPcapDumper::FileName(uint64 seq) const
+	{
+	if ( ! rotate_size && rotate_interval <= 0 )
+		return props.path;
+
+	if ( rotate_files )
+		seq %= rotate_files;
+
+	return fmt("%s.%" PRIu64, props.path.c_str(), seq);
+	}
+
+void AsyncPcapDumper::Writer()
+	{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while ( true )
+		{
+		cond.wait(lock, [this] { return stopping || ! queue.empty(); });
+
+		if ( queue.empty() )
+			break;
+
+		Buffer* b = queue.front();
+		queue.pop_front();
+
+		lock.unlock();
+
+		// After a failure, we just discard the output.
+		if ( ! failed )
+			WriteBuffer(b);
+
+		lock.lock();
+		free_buffers.push_back(b);
+		}
+	}
+
+bool AsyncPcapDumper::WriteBuffer(const Buffer* b)
+	{
+	std::string name = FileName(writer_seq);
+
+	if ( ! WriteOutput(&b->data[0], b->len) )
+		{
+		Fail(fmt("can't write to %s: %s", name.c_str(), strerror(errno)));
+		return false;
+		}
+
+	if ( ! b->last_in_file )
+		return true;
+
+	if ( ! CloseOutput() )
+		{
+		Fail(fmt("can't close dump %s: %s", name.c_str(), strerror(errno)));
+		return false;
+		}
+
+	name = FileName(++writer_seq);
+
+	if ( ! OpenOutput(name, false) )
+		{
+		Fail(fmt("can't open dump %s: %s", name.c_str(), strerror(errno)));
+		return false;
+		}
+
+	return true;
+	}
+
+void AsyncPcapDumper::Fail(const std::string& msg)
+	{
+	std::lock_guard<std::mutex> lock(mutex);
+	error = msg;
+	failed = true;
+	}
+
+bool AsyncPcapDumper::OpenOutput(const std::string& name, bool append_to)
+	{
+	const char* mode = append_to ? "ab" : "wb";
+
+	if ( compress )
+		return (out.gz = gzopen(name.c_str(), mode)) != 0;
+
+	return (out.file = fopen(name.c_str(), mode)) != 0;
+	}
+
+bool AsyncPcapDumper::WriteOutput(const u_char* data, size_t len)
+	{
+	if ( ! len )
+		return true;
+
+	if ( out.gz )
+		return gzwrite(out.gz, data, len) == int(len);
+
+	if ( out.file )
+		return fwrite(data, 1, len, out.file) == len;
+
+	return false;
+	}
+
+bool AsyncPcapDumper::CloseOutput()
+	{
+	bool ok = true;
+
+	if ( out.gz )
+		ok = (gzclose(out.gz) == Z_OK);
+
+	else if ( out.file )
+		ok = (fclose(out.file) == 0);
+
+	out.gz = 0;
+	out.file = 0;
+	return ok;
+	}
+
+iosource::PktDumper* AsyncPcapDumper::Instantiate(const std::string& path, bool append)
+	{
+	return new AsyncPcapDumper(path, append);
+	}
@@ -0,0 +1,120 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// A packet dumper that keeps disk I/O off the main thread.
+//
+// Packets get copied, already in their on-disk format, into large buffers
+// that a writer thread then writes out. If the writer falls behind and
+// all buffers are waiting, further packets are dropped (and counted)
+// rather than stalling packet processing. The output can be pcap or
+// pcapng, optionally gzip-compressed, and can be rotated by size or time
+// into a ring of a fixed number of files.
+
+#ifndef IOSOURCE_PKTSRC_PCAP_ASYNCDUMPER_H
+#define IOSOURCE_PKTSRC_PCAP_ASYNCDUMPER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "zlib.h"
+
+#include "../PktDumper.h"
+
+namespace iosource {
+namespace pcap {
+
+class AsyncPcapDumper : public PktDumper {
+public:
+	AsyncPcapDumper(const std::string& path, bool append);
+	~AsyncPcapDumper() override;
+
+	static PktDumper* Instantiate(const std::string& path, bool append);
+
+protected:
+	// PktDumper interface.
+	void Open() override;
+	void Close() override;
+	bool Dump(const Packet* pkt) override;
+
+private:
+	struct Buffer {
+		std::vector<u_char> data;
+		size_t len;
+		bool last_in_file;	// writer moves on to the next file after it
+	};
+
+	// Output file, touched by the main thread only before the writer
+	// thread starts and after it finished.
+	struct Output {
+		FILE* file;
+		gzFile gz;
+	};
+
+	// Main thread.
+	bool Append(const void* data, size_t len);
+	void StartFile(int link_type);
+	bool HandOff(bool last_in_file);
+	bool NeedRotation(double t) const;
+	void AddInterface(int link_type);
+	std::string FileName(uint64 seq) const;
+
+	// Writer thread.
+	void Writer();
+	bool WriteBuffer(const Buffer* b);
+	void Fail(const std::string& msg);
+
+	// Either thread, see Output.
+	bool OpenOutput(const std::string& name, bool append_to);
+	bool WriteOutput(const u_char* data, size_t len);
+	bool CloseOutput();
+
+	Properties props;
+	bool append;
+
+	// Options, copied from the Pcap:: script constants.
+	size_t buffer_size;
+	size_t max_buffers;
+	bool pcapng;
+	bool compress;
+	uint64 rotate_size;
+	double rotate_interval;
+	uint64 rotate_files;
+
+	// State of the main thread.
+	Buffer* cur;
+	bool in_file;	// header of the current file written
+	uint64 file_seq;
+	uint64 file_bytes;
+	double file_start;
+	double last_handoff;
+	double pkt_time;	// of the packet being dumped
+	std::map<int, uint32> interfaces;	// pcapng link type -> interface ID
+	uint64 dropped;
+	uint64 dumped;
+
+	// Shared with the writer thread, protected by the mutex.
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::deque<Buffer*> queue;
+	std::vector<Buffer*> free_buffers;
+	size_t num_buffers;
+	bool stopping;
+	std::string error;
+	std::atomic<bool> failed;
+
+	// State of the writer thread.
+	Output out;
+	uint64 writer_seq;
+
+	std::thread writer;
+};
+
+}
+}
+
+#endif
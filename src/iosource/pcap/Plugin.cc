@@ -4,6 +4,7 @@
 
 #include "Source.h"
 #include "Dumper.h"
+#include "AsyncDumper.h"
 
 namespace plugin {
 namespace Zeek_Pcap {
@@ -14,6 +15,7 @@ public:
 		{
 		AddComponent(new ::iosource::PktSrcComponent("PcapReader", "pcap", ::iosource::PktSrcComponent::BOTH, ::iosource::pcap::PcapSource::Instantiate));
 		AddComponent(new ::iosource::PktDumperComponent("PcapWriter", "pcap", ::iosource::pcap::PcapDumper::Instantiate));
+		AddComponent(new ::iosource::PktDumperComponent("AsyncPcapWriter", "async", ::iosource::pcap::AsyncPcapDumper::Instantiate));
 
 		plugin::Configuration config;
 		config.name = "Zeek::Pcap";
@@ -0,0 +1,272 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ReadAhead.h"
+#include "../../threading/Manager.h"
+
+using namespace iosource::pcap;
+
+// How much the decompressor hands to the pipe at a time.
+#define GZIP_CHUNK_SIZE 65536
+
+GzipPipe::GzipPipe()
+	{
+	gz = 0;
+	write_fd = -1;
+	stopping = false;
+	}
+
+GzipPipe::~GzipPipe()
+	{
+	// With the reading end closed, the decompressor's next write
+	// fails, if it's waiting in one.
+	stopping = true;
+
+	if ( decompressor.joinable() )
+		decompressor.join();
+
+	if ( write_fd >= 0 )
+		close(write_fd);
+
+	if ( gz )
+		gzclose(gz);
+	}
+
+bool GzipPipe::IsGzip(const std::string& path)
+	{
+	FILE* f = fopen(path.c_str(), "rb");
+
+	if ( ! f )
+		return false;
+
+	u_char magic[2];
+	bool is_gzip = fread(magic, 1, 2, f) == 2 &&
+	               magic[0] == 0x1f && magic[1] == 0x8b;
+
+	fclose(f);
+	return is_gzip;
+	}
+
+FILE* GzipPipe::Open(const std::string& path)
+	{
+	gz = gzopen(path.c_str(), "rb");
+
+	if ( ! gz )
+		{
+		error = std::string("can't open ") + path + ": " + strerror(errno);
+		return 0;
+		}
+
+	int fds[2];
+
+	if ( pipe(fds) < 0 )
+		{
+		error = std::string("can't create pipe: ") + strerror(errno);
+		return 0;
+		}
+
+	FILE* f = fdopen(fds[0], "rb");
+
+	if ( ! f )
+		{
+		error = std::string("can't fdopen pipe: ") + strerror(errno);
+		close(fds[0]);
+		close(fds[1]);
+		return 0;
+		}
+
+	write_fd = fds[1];
+	decompressor = std::thread(&GzipPipe::Decompress, this);
+	thread_mgr->PlaceThread(decompressor);
+	return f;
+	}
+
+void GzipPipe::Decompress()
+	{
+	// Once the reader is gone, we want to see EPIPE rather than
+	// having the process signaled.
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, 0);
+
+	char buf[GZIP_CHUNK_SIZE];
+
+	while ( ! stopping )
+		{
+		int n = gzread(gz, buf, sizeof(buf));
+
+		if ( n <= 0 )
+			// End of file, or a corrupt one. Either way, libpcap
+			// sees the file ending.
+			break;
+
+		for ( int written = 0; written < n; )
+			{
+			ssize_t w = write(write_fd, buf + written, n - written);
+
+			if ( w < 0 )
+				{
+				if ( errno == EINTR )
+					continue;
+
+				stopping = true;
+				break;
+				}
+
+			written += w;
+			}
+		}
+
+	close(write_fd);
+	write_fd = -1;
+	}
+
+ReadAhead::ReadAhead(pcap_t* arg_pd, size_t num_buffers, size_t arg_buffer_size)
+	{
+	pd = arg_pd;
+	buffer_size = arg_buffer_size;
+	cur = 0;
+	next_record = 0;
+	eof = false;
+	stopping = false;
+
+	// One more than asked for, as the main thread holds on to one of
+	// them while working through it.
+	for ( size_t i = 0; i < num_buffers + 1; ++i )
+		{
+		Buffer* b = new Buffer;
+		b->data.resize(buffer_size);
+		b->len = 0;
+		free_buffers.push_back(b);
+		}
+
+	reader = std::thread(&ReadAhead::Reader, this);
+	thread_mgr->PlaceThread(reader);
+	}
+
+ReadAhead::~ReadAhead()
+	{
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		}
+
+	cond.notify_all();
+	reader.join();
+
+	delete cur;
+
+	for ( auto b : full )
+		delete b;
+
+	for ( auto b : free_buffers )
+		delete b;
+	}
+
+bool ReadAhead::Next(struct pcap_pkthdr** hdr, const u_char** data)
+	{
+	if ( ! cur || next_record >= cur->records.size() )
+		{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		if ( cur )
+			{
+			free_buffers.push_back(cur);
+			cur = 0;
+			cond.notify_all();
+			}
+
+		cond.wait(lock, [this] { return eof || ! full.empty(); });
+
+		if ( full.empty() )
+			return false;
+
+		cur = full.front();
+		full.pop_front();
+		next_record = 0;
+		}
+
+	Record& r = cur->records[next_record++];
+	*hdr = &r.hdr;
+	*data = &cur->data[r.offset];
+	return true;
+	}
+
+void ReadAhead::Reader()
+	{
+	Buffer* b = 0;
+
+	while ( true )
+		{
+		if ( ! b )
+			{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this] { return stopping || ! free_buffers.empty(); });
+
+			if ( stopping )
+				return;
+
+			b = free_buffers.back();
+			free_buffers.pop_back();
+			b->records.clear();
+			b->len = 0;
+			}
+
+		struct pcap_pkthdr* hdr;
+		const u_char* data;
+
+		// As on the main thread, a read error counts as the end
+		// of the file.
+		if ( pcap_next_ex(pd, &hdr, &data) != 1 )
+			break;
+
+		if ( b->len + hdr->caplen > b->data.size() && b->records.size() )
+			{
+			// Hand the full buffer over and continue with the
+			// next. The packet's data remains valid until we read
+			// another one.
+				{
+				std::unique_lock<std::mutex> lock(mutex);
+				full.push_back(b);
+				cond.notify_all();
+				cond.wait(lock, [this] { return stopping || ! free_buffers.empty(); });
+
+				if ( stopping )
+					return;
+
+				b = free_buffers.back();
+				free_buffers.pop_back();
+				}
+
+			b->records.clear();
+			b->len = 0;
+			}
+
+		if ( hdr->caplen > b->data.size() )
+			b->data.resize(hdr->caplen);
+
+		Record r;
+		r.hdr = *hdr;
+		r.offset = b->len;
+		b->records.push_back(r);
+
+		memcpy(&b->data[b->len], data, hdr->caplen);
+		b->len += hdr->caplen;
+		}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if ( b->records.size() )
+		full.push_back(b);
+	else
+		free_buffers.push_back(b);
+
+	eof = true;
+	cond.notify_all();
+	}
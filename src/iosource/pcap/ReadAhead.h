@@ -0,0 +1,134 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Helpers for reading trace files off the main thread.
+//
+// GzipPipe decompresses a gzip'ed trace on a thread of its own and feeds
+// the result into a pipe that libpcap then reads from. ReadAhead reads
+// packets from a pcap handle on another thread into a bounded number of
+// large buffers, which the main thread then works through in order.
+// Together, decompression, file I/O, and Zeek's packet processing all
+// run in parallel.
+
+#ifndef IOSOURCE_PKTSRC_PCAP_READAHEAD_H
+#define IOSOURCE_PKTSRC_PCAP_READAHEAD_H
+
+extern "C" {
+#include <pcap.h>
+}
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "zlib.h"
+
+namespace iosource {
+namespace pcap {
+
+class GzipPipe {
+public:
+	GzipPipe();
+
+	/**
+	 * Destructor. Stops the decompression. The file returned by Open()
+	 * must have been closed before.
+	 */
+	~GzipPipe();
+
+	/**
+	 * Returns true if a file starts with the gzip magic.
+	 */
+	static bool IsGzip(const std::string& path);
+
+	/**
+	 * Starts decompressing a file.
+	 *
+	 * @param path The gzip'ed file.
+	 *
+	 * @return A file to read the decompressed data from, or null on
+	 * error, with Error() describing it.
+	 */
+	FILE* Open(const std::string& path);
+
+	/**
+	 * Returns a description of the last error.
+	 */
+	const std::string& Error() const	{ return error; }
+
+private:
+	void Decompress();
+
+	gzFile gz;
+	int write_fd;
+	std::atomic<bool> stopping;
+	std::thread decompressor;
+	std::string error;
+};
+
+class ReadAhead {
+public:
+	/**
+	 * Constructor. Starts reading right away.
+	 *
+	 * @param pd The pcap handle to read from. It must not be used by
+	 * anybody else until the instance has been destroyed.
+	 *
+	 * @param num_buffers How many buffers may be filled ahead.
+	 *
+	 * @param buffer_size The size of each buffer.
+	 */
+	ReadAhead(pcap_t* pd, size_t num_buffers, size_t buffer_size);
+
+	/**
+	 * Destructor. Stops reading.
+	 */
+	~ReadAhead();
+
+	/**
+	 * Returns the next packet, waiting for it to be read if necessary.
+	 * The data remains valid until the next call.
+	 *
+	 * @return False once there are no more packets.
+	 */
+	bool Next(struct pcap_pkthdr** hdr, const u_char** data);
+
+private:
+	struct Record {
+		struct pcap_pkthdr hdr;
+		size_t offset;
+	};
+
+	struct Buffer {
+		std::vector<Record> records;
+		std::vector<u_char> data;
+		size_t len;
+	};
+
+	void Reader();
+
+	pcap_t* pd;
+	size_t buffer_size;
+
+	// State of the main thread.
+	Buffer* cur;
+	size_t next_record;
+
+	// Shared with the reader thread, protected by the mutex.
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::deque<Buffer*> full;
+	std::vector<Buffer*> free_buffers;
+	bool eof;
+	bool stopping;
+
+	std::thread reader;
+};
+
+}
+}
+
+#endif
@@ -28,6 +28,10 @@ PcapSource::PcapSource(const std::string& path, bool is_live)
 	memset(&current_hdr, 0, sizeof(current_hdr));
 	memset(&last_hdr, 0, sizeof(last_hdr));
 	last_data = 0;
+	drained = false;
+	gzip = 0;
+	read_ahead = 0;
+	filter_index = -1;
 	}
 
 void PcapSource::Open()
@@ -43,10 +47,18 @@ void PcapSource::Close()
 	if ( ! pd )
 		return;
 
+	// The reader thread needs to be gone before the handle, and the
+	// handle before the decompressor, which is writing to its file.
+	delete read_ahead;
+	read_ahead = 0;
+
 	pcap_close(pd);
 	pd = 0;
 	last_data = 0;
 
+	delete gzip;
+	gzip = 0;
+
 	Closed();
 	}
 
@@ -161,7 +173,32 @@ void PcapSource::OpenOffline()
 	{
 	char errbuf[PCAP_ERRBUF_SIZE];
 
-	pd = pcap_open_offline(props.path.c_str(), errbuf);
+	if ( props.path != "-" && GzipPipe::IsGzip(props.path) )
+		{
+		// libpcap can't read gzip'ed traces itself, so we give it
+		// the output of a decompressor thread instead.
+		gzip = new GzipPipe();
+		FILE* f = gzip->Open(props.path);
+
+		if ( ! f )
+			{
+			Error(gzip->Error());
+			delete gzip;
+			gzip = 0;
+			return;
+			}
+
+		pd = pcap_fopen_offline(f, errbuf);
+
+		if ( ! pd )
+			{
+			fclose(f);
+			delete gzip;
+			gzip = 0;
+			}
+		}
+	else
+		pd = pcap_open_offline(props.path.c_str(), errbuf);
 
 	if ( ! pd )
 		{
@@ -180,6 +217,10 @@ void PcapSource::OpenOffline()
 	if ( props.selectable_fd < 0 )
 		InternalError("OS does not support selectable pcap fd");
 
+	if ( BifConst::Pcap::read_ahead_buffers > 0 )
+		read_ahead = new ReadAhead(pd, BifConst::Pcap::read_ahead_buffers,
+		                           BifConst::Pcap::read_ahead_buffer_size);
+
 	props.is_live = false;
 	Opened(props);
 	}
@@ -189,18 +230,38 @@ bool PcapSource::ExtractNextPacket(Packet* pkt)
 	if ( ! pd )
 		return false;
 
-	const u_char* data = pcap_next(pd, &current_hdr);
+	// We use pcap_next_ex() rather than pcap_next(): it avoids the
+	// dispatch callback that pcap_next() goes through internally, and
+	// it lets us tell timeouts apart from errors.
+	struct pcap_pkthdr* hdr;
+	const u_char* data;
+	int res = read_ahead ? NextReadAhead(&hdr, &data) :
+	                       pcap_next_ex(pd, &hdr, &data);
+
+	switch ( res ) {
+	case 1:
+		break;
+
+	case 0:
+		// Live capture timed out without a packet.
+		drained = true;
+		return false;
 
-	if ( ! data )
-		{
-		// Source has gone dry.  If it's a network interface, this just means
-		// it's timed out. If it's a file, though, then the file has been
-		// exhausted.
+	default:
+		// End of savefile (-2) or a read error (-1). As with
+		// pcap_next(), a file that can't be read any further is
+		// considered exhausted; a live interface just reports no
+		// packet for now.
 		if ( ! props.is_live )
 			Close();
+		else
+			drained = true;
 
 		return false;
-		}
+	}
+
+	drained = false;
+	current_hdr = *hdr;
 
 	last_data = data;
 	pkt->Init(props.link_type, &current_hdr.ts, current_hdr.caplen, current_hdr.len, data);
@@ -219,11 +280,33 @@ bool PcapSource::ExtractNextPacket(Packet* pkt)
 	return true;
 	}
 
+int PcapSource::NextReadAhead(struct pcap_pkthdr** hdr, const u_char** data)
+	{
+	// Returns the same as pcap_next_ex() would for a trace file.
+	while ( read_ahead->Next(hdr, data) )
+		{
+		if ( filter_index < 0 ||
+		     ApplyBPFFilter(filter_index, *hdr, *data) )
+			return 1;
+
+		if ( ! pd )
+			// The filter failed and closed us.
+			return -1;
+		}
+
+	return -2;
+	}
+
 void PcapSource::DoneWithPacket()
 	{
 	// Nothing to do.
 	}
 
+bool PcapSource::HasPendingPackets()
+	{
+	return pd && ! drained;
+	}
+
 bool PcapSource::PrecompileFilter(int index, const std::string& filter)
 	{
 	return PktSrc::PrecompileBPFFilter(index, filter);
@@ -254,6 +337,11 @@ bool PcapSource::SetFilter(int index)
 		// since the default scripts will always attempt to compile
 		// and install a default filter
 		}
+	else if ( read_ahead )
+		// The reader thread may have gotten ahead of us, so
+		// filtering must happen as we take packets from it.
+		filter_index = index;
+
 	else
 		{
 		if ( pcap_setfilter(pd, code->GetProgram()) < 0 )
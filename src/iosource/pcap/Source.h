@@ -4,6 +4,7 @@
 #define IOSOURCE_PKTSRC_PCAP_SOURCE_H
 
 #include "../PktSrc.h"
+#include "ReadAhead.h"
 
 namespace iosource {
 namespace pcap {
@@ -21,6 +22,7 @@ protected:
 	void Close() override;
 	bool ExtractNextPacket(Packet* pkt) override;
 	void DoneWithPacket() override;
+	bool HasPendingPackets() override;
 	bool PrecompileFilter(int index, const std::string& filter) override;
 	bool SetFilter(int index) override;
 	void Statistics(Stats* stats) override;
@@ -30,6 +32,7 @@ private:
 	void OpenOffline();
 	void PcapError(const char* where = 0);
 	void SetHdrSize();
+	int NextReadAhead(struct pcap_pkthdr** hdr, const u_char** data);
 
 	Properties props;
 	Stats stats;
@@ -39,6 +42,17 @@ private:
 	struct pcap_pkthdr current_hdr;
 	struct pcap_pkthdr last_hdr;
 	const u_char* last_data;
+
+	// Set when the last read attempt on a live interface came back
+	// empty, so that batched processing stops early.
+	bool drained;
+
+	// For trace files, see ReadAhead.h. With read-ahead, filters get
+	// applied as packets are taken from it, and filter_index is the one
+	// installed (or -1 for none).
+	GzipPipe* gzip;
+	ReadAhead* read_ahead;
+	int filter_index;
 };
 
 }
@@ -8,6 +8,7 @@
 #include "Net.h"
 #include "Type.h"
 #include "File.h"
+#include "Probes.h"
 
 #include "broker/Manager.h"
 #include "threading/Manager.h"
@@ -41,6 +42,18 @@ struct Manager::Filter {
 	bool remote;
 	double interval;
 	Func* postprocessor;
+	int shards;
+	int shard_field;	// offset of the column to shard by, or -1
+	unsigned int next_shard;	// for round-robin sharding
+
+	double sample_rate;
+	int sample_field;	// offset of the column to sample by, or -1
+	uint64 rate_limit;	// records per second, 0 for unlimited
+	double rate_burst;
+	double tokens;
+	double last_refill;
+	uint64 sampled_out;
+	uint64 rate_limited;
 
 	int num_fields;
 	threading::Field** fields;
@@ -48,7 +61,12 @@ struct Manager::Filter {
 	// Vector indexed by field number. Each element is a list of record
 	// indices defining a path leading to the value across potential
 	// sub-records.
-	vector<list<int> > indices;
+	vector<vector<int> > indices;
+
+	// Vector indexed by field number, true if the field lives in the
+	// same sub-record as the one before it. Writes then don't need to
+	// walk the path to that sub-record again.
+	vector<bool> same_parent;
 
 	~Filter();
 };
@@ -85,6 +103,87 @@ struct Manager::Stream {
 	~Stream();
 	};
 
+static string shard_path(const string& path, int shard)
+	{
+	return path + "-shard" + std::to_string(shard);
+	}
+
+bool Manager::IsShardPath(const Filter* f, const string& path)
+	{
+	if ( f->shards < 2 )
+		return false;
+
+	for ( int i = 0; i < f->shards; ++i )
+		if ( path == shard_path(f->path, i) )
+			return true;
+
+	return false;
+	}
+
+static hash_t hash_column(Val* v)
+	{
+	if ( v->Type()->Tag() == TYPE_STRING )
+		return HashKey::HashBytes(v->AsString()->Bytes(), v->AsString()->Len());
+
+	ODesc d;
+	v->Describe(&d);
+	return HashKey::HashBytes(d.Bytes(), d.Len());
+	}
+
+int Manager::SelectShard(Filter* f, RecordVal* columns)
+	{
+	if ( f->shard_field < 0 )
+		return f->next_shard++ % f->shards;
+
+	Val* v = columns->Lookup(f->shard_field);
+
+	if ( ! v )
+		return 0;
+
+	return hash_column(v) % f->shards;
+	}
+
+// Resolution of sampling decisions.
+#define SAMPLE_SCALE 1000000
+
+bool Manager::Sample(Filter* f, RecordVal* columns)
+	{
+	Val* v = f->sample_field >= 0 ? columns->Lookup(f->sample_field) : 0;
+	hash_t h;
+
+	if ( v && ! (v->Type()->Tag() == TYPE_STRING && v->AsString()->Len() == 0) )
+		{
+		// Swap the halves, so that we don't decide by the same bits
+		// as sharding does.
+		h = hash_column(v);
+		h = (h >> 32) | (h << 32);
+		}
+	else
+		h = bro_random();
+
+	return double(h % SAMPLE_SCALE) < f->sample_rate * SAMPLE_SCALE;
+	}
+
+bool Manager::TakeToken(Filter* f)
+	{
+	// Refill the bucket for the time passed since the last record.
+	if ( network_time > f->last_refill )
+		{
+		f->tokens += (network_time - f->last_refill) * f->rate_limit;
+
+		if ( f->tokens > f->rate_burst )
+			f->tokens = f->rate_burst;
+
+		f->last_refill = network_time;
+		}
+
+	if ( f->tokens < 1 )
+		return false;
+
+	f->tokens -= 1;
+	return true;
+	}
+
 Manager::Filter::~Filter()
 	{
 	Unref(fval);
@@ -491,7 +590,8 @@ bool Manager::TraverseRecord(Stream* stream, Filter* filter, RecordType* rt,
 			}
 
 		// Alright, we want this field.
-		filter->indices.push_back(new_indices);
+		filter->indices.push_back(vector<int>(new_indices.begin(),
+		                                      new_indices.end()));
 
 		void* tmp =
 			realloc(filter->fields,
@@ -553,6 +653,12 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 	Val* scope_sep = fval->Lookup("scope_sep", true);
 	Val* ext_prefix = fval->Lookup("ext_prefix", true);
 	Val* ext_func = fval->Lookup("ext_func", true);
+	Val* shards = fval->Lookup("shards", true);
+	Val* shard_field = fval->Lookup("shard_field", true);
+	Val* sample_rate = fval->Lookup("sample_rate", true);
+	Val* sample_field = fval->Lookup("sample_field", true);
+	Val* rate_limit = fval->Lookup("rate_limit", true);
+	Val* rate_burst = fval->Lookup("rate_burst", true);
 
 	Filter* filter = new Filter;
 	filter->fval = fval->Ref();
@@ -570,6 +676,23 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 	filter->scope_sep = scope_sep->AsString()->CheckString();
 	filter->ext_prefix = ext_prefix->AsString()->CheckString();
 	filter->ext_func = ext_func ? ext_func->AsFunc() : 0;
+	filter->shards = shards->AsCount();
+	filter->shard_field = -1;
+	filter->next_shard = 0;
+
+	string shard_field_name = shard_field->AsString()->CheckString();
+
+	if ( shard_field_name.size() )
+		filter->shard_field = stream->columns->FieldOffset(shard_field_name.c_str());
+
+	filter->sample_rate = sample_rate->AsDouble();
+	filter->sample_field = stream->columns->FieldOffset(sample_field->AsString()->CheckString());
+	filter->rate_limit = rate_limit->AsCount();
+	filter->rate_burst = rate_burst->AsCount() ? rate_burst->AsCount() : rate_limit->AsCount();
+	filter->tokens = filter->rate_burst;
+	filter->last_refill = network_time;
+	filter->sampled_out = 0;
+	filter->rate_limited = 0;
 
 	Unref(name);
 	Unref(pred);
@@ -583,6 +706,12 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 	Unref(scope_sep);
 	Unref(ext_prefix);
 	Unref(ext_func);
+	Unref(shards);
+	Unref(shard_field);
+	Unref(sample_rate);
+	Unref(sample_field);
+	Unref(rate_limit);
+	Unref(rate_burst);
 
 	// Build the list of fields that the filter wants included, including
 	// potentially rolling out fields.
@@ -620,6 +749,22 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 		return false;
 		}
 
+	for ( int i = 0; i < filter->num_fields; ++i )
+		{
+		const vector<int>& cur = filter->indices[i];
+		bool same = false;
+
+		// Extension fields are never nested, so they can't share.
+		if ( i > 0 && cur.size() > 1 )
+			{
+			const vector<int>& prev = filter->indices[i - 1];
+			same = prev.size() == cur.size() &&
+			       std::equal(cur.begin(), cur.end() - 1, prev.begin());
+			}
+
+		filter->same_parent.push_back(same);
+		}
+
 	// Get the path for the filter.
 	Val* path_val = fval->Lookup("path");
 
@@ -636,6 +781,29 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 		filter->path_val = 0;
 		}
 
+	if ( filter->shards < 1 )
+		{
+		reporter->Error("filter '%s' needs at least one shard", filter->name.c_str());
+		delete filter;
+		return false;
+		}
+
+	if ( filter->sample_rate < 0 || filter->sample_rate > 1 )
+		{
+		reporter->Error("sample rate of filter '%s' must be between 0 and 1",
+		                filter->name.c_str());
+		delete filter;
+		return false;
+		}
+
+	if ( shard_field_name.size() && filter->shard_field < 0 )
+		{
+		reporter->Error("unknown shard field '%s' for filter '%s'",
+		                shard_field_name.c_str(), filter->name.c_str());
+		delete filter;
+		return false;
+		}
+
 	// Remove any filter with the same name we might already have.
 	RemoveFilter(id, filter->name);
 
@@ -653,6 +821,7 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 	DBG_LOG(DBG_LOGGING, "   path      : %s", filter->path.c_str());
 	DBG_LOG(DBG_LOGGING, "   path_func : %s", (filter->path_func ? "set" : "not set"));
 	DBG_LOG(DBG_LOGGING, "   pred      : %s", (filter->pred ? "set" : "not set"));
+	DBG_LOG(DBG_LOGGING, "   shards    : %d", filter->shards);
 
 	for ( int i = 0; i < filter->num_fields; i++ )
 		{
@@ -706,6 +875,8 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 	if ( ! stream->enabled )
 		return true;
 
+	ZEEK_PROBE1(log__write, stream->name.c_str());
+
 	columns = columns->CoerceTo(stream->columns);
 
 	if ( ! columns )
@@ -725,6 +896,12 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 		Filter* filter = *i;
 		string path = filter->path;
 
+		if ( filter->sample_rate < 1 && ! Sample(filter, columns) )
+			{
+			++filter->sampled_out;
+			continue;
+			}
+
 		if ( filter->pred )
 			{
 			// See whether the predicates indicates that we want
@@ -744,6 +921,12 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 				continue;
 			}
 
+		if ( filter->rate_limit && ! TakeToken(filter) )
+			{
+			++filter->rate_limited;
+			continue;
+			}
+
 		if ( filter->path_func )
 			{
 			Val* path_arg;
@@ -796,6 +979,9 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 #endif
 			}
 
+		if ( filter->shards > 1 )
+			path = shard_path(path, SelectShard(filter, columns));
+
 		Stream::WriterPathPair wpp(filter->writer->AsEnum(), path);
 
 		// See if we already have a writer for this path.
@@ -1090,9 +1276,12 @@ threading::Value** Manager::RecordToFilterVals(Stream* stream, Filter* filter,
 
 	threading::Value** vals = new threading::Value*[filter->num_fields];
 
+	// The (sub-)record holding the current field.
+	RecordVal* parent = nullptr;
+
 	for ( int i = 0; i < filter->num_fields; ++i )
 		{
-		Val* val;
+		RecordVal* rec;
 		if ( i < filter->num_ext_fields )
 			{
 			if ( ! ext_rec )
@@ -1102,29 +1291,34 @@ threading::Value** Manager::RecordToFilterVals(Stream* stream, Filter* filter,
 				continue;
 				}
 
-			val = ext_rec;
+			rec = ext_rec;
 			}
 		else
-			val = columns;
+			rec = columns;
 
-		// For each field, first find the right value, which can
-		// potentially be nested inside other records.
-		list<int>& indices = filter->indices[i];
+		const vector<int>& indices = filter->indices[i];
+		size_t last = indices.size() - 1;
 
-		for ( list<int>::iterator j = indices.begin(); j != indices.end(); ++j )
+		if ( ! filter->same_parent[i] )
 			{
-			val = val->AsRecordVal()->Lookup(*j);
+			// First find the record holding the value, which can
+			// potentially be nested inside other records.
+			parent = rec;
 
-			if ( ! val )
+			for ( size_t j = 0; j < last && parent; ++j )
 				{
-				// Value, or any of its parents, is not set.
-				vals[i] = new threading::Value(filter->fields[i]->type, false);
-				break;
+				Val* v = parent->Lookup(indices[j]);
+				parent = v ? v->AsRecordVal() : nullptr;
 				}
 			}
 
+		Val* val = parent ? parent->Lookup(indices[last]) : nullptr;
+
 		if ( val )
 			vals[i] = ValToLogVal(val);
+		else
+			// Value, or any of its parents, is not set.
+			vals[i] = new threading::Value(filter->fields[i]->type, false);
 		}
 
 	if ( ext_rec )
@@ -1196,7 +1390,7 @@ WriterFrontend* Manager::CreateWriter(EnumVal* id, EnumVal* writer, WriterBacken
 		{
 		Filter* f = *it;
 		if ( f->writer->AsEnum() == writer->AsEnum() &&
-		     f->path == info->path )
+		     (f->path == info->path || IsShardPath(f, info->path)) )
 			{
 			found_filter_match = true;
 			winfo->interval = f->interval;
@@ -1344,6 +1538,34 @@ bool Manager::SetBuf(EnumVal* id, bool enabled)
 	return true;
 	}
 
+RecordVal* Manager::GetFilterStats(EnumVal* id, const string& name)
+	{
+	RecordVal* stats = new RecordVal(BifType::Record::Log::FilterStats);
+	uint64 sampled_out = 0;
+	uint64 rate_limited = 0;
+
+	Stream* stream = FindStream(id);
+
+	if ( stream )
+		{
+		for ( list<Filter*>::iterator i = stream->filters.begin();
+		      i != stream->filters.end(); ++i )
+			{
+			if ( (*i)->name == name )
+				{
+				sampled_out = (*i)->sampled_out;
+				rate_limited = (*i)->rate_limited;
+				break;
+				}
+			}
+		}
+
+	stats->Assign(0, val_mgr->GetCount(sampled_out));
+	stats->Assign(1, val_mgr->GetCount(rate_limited));
+
+	return stats;
+	}
+
 bool Manager::Flush(EnumVal* id)
 	{
 	Stream* stream = FindStream(id);
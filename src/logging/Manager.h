@@ -198,6 +198,19 @@ public:
 	 */
 	bool Flush(EnumVal* id);
 
+	/**
+	 * Returns the counters for records a filter dropped due to sampling
+	 * or rate limiting.
+	 *
+	 * @param id  The enum value corresponding the log stream.
+	 *
+	 * @param name The name of the filter.
+	 *
+	 * This methods corresponds directly to the internal BiF defined in
+	 * logging.bif, which just forwards here.
+	 */
+	RecordVal* GetFilterStats(EnumVal* id, const string& name);
+
 	/**
 	 * Signals the manager to shutdown at Bro's termination.
 	 */
@@ -263,6 +276,18 @@ private:
 	threading::Value** RecordToFilterVals(Stream* stream, Filter* filter,
 				    RecordVal* columns);
 
+	// Returns the shard that a record written to a sharded filter goes to.
+	int SelectShard(Filter* filter, RecordVal* columns);
+
+	// Returns true if the path is one of a sharded filter's outputs.
+	bool IsShardPath(const Filter* filter, const string& path);
+
+	// Returns true if sampling keeps the record.
+	bool Sample(Filter* filter, RecordVal* columns);
+
+	// Returns true if the filter's rate limit lets another record pass.
+	bool TakeToken(Filter* filter);
+
 	threading::Value* ValToLogVal(Val* val, BroType* ty = 0);
 	Stream* FindStream(EnumVal* id);
 	void RemoveDisabledWriters(Stream* stream);
@@ -2,6 +2,7 @@
 #include "Net.h"
 #include "threading/SerialTypes.h"
 #include "broker/Manager.h"
+#include "metrics/Manager.h"
 
 #include "Manager.h"
 #include "WriterFrontend.h"
@@ -55,16 +56,27 @@ private:
 class WriteMessage : public threading::InputMessage<WriterBackend>
 {
 public:
-	WriteMessage(WriterBackend* backend, int num_fields, int num_writes, Value*** vals)
+	WriteMessage(WriterBackend* backend, int num_fields, int num_writes, Value*** vals,
+		     double buffered_at)
 		: threading::InputMessage<WriterBackend>("Write", backend),
-		num_fields(num_fields), num_writes(num_writes), vals(vals)	{}
+		num_fields(num_fields), num_writes(num_writes), vals(vals),
+		buffered_at(buffered_at)	{}
 
-	virtual bool Process() { return Object()->Write(num_fields, num_writes, vals); }
+	virtual bool Process()
+		{
+		bool result = Object()->Write(num_fields, num_writes, vals);
+
+		if ( buffered_at )
+			metrics_mgr->GetLatencies().log_write->Observe(current_time(true) - buffered_at);
+
+		return result;
+		}
 
 private:
 	int num_fields;
 	int num_writes;
 	Value ***vals;
+	double buffered_at;
 };
 
 class SetBufMessage : public threading::InputMessage<WriterBackend>
@@ -111,6 +123,7 @@ WriterFrontend::WriterFrontend(const WriterBackend::WriterInfo& arg_info, EnumVa
 	remote = arg_remote;
 	write_buffer = 0;
 	write_buffer_pos = 0;
+	write_buffer_start = 0;
 	info = new WriterBackend::WriterInfo(arg_info);
 
 	num_fields = 0;
@@ -215,8 +228,15 @@ void WriterFrontend::Write(int arg_num_fields, Value** vals)
 		write_buffer_pos = 0;
 		}
 
+	if ( ! write_buffer_pos && metrics_mgr->GetLatencies().log_buffer_wait )
+		write_buffer_start = current_time(true);
+
 	write_buffer[write_buffer_pos++] = vals;
 
+	if ( write_buffer_pos == 1 )
+		// The backend's next heartbeat gets it flushed.
+		backend->WakeForHeartbeat();
+
 	if ( write_buffer_pos >= WRITER_BUFFER_SIZE || ! buf || terminating )
 		// Buffer full (or no bufferin desired or termiating).
 		FlushWriteBuffer();
@@ -229,12 +249,17 @@ void WriterFrontend::FlushWriteBuffer()
 		// Nothing to do.
 		return;
 
+	if ( write_buffer_start )
+		metrics_mgr->GetLatencies().log_buffer_wait->Observe(current_time(true) - write_buffer_start);
+
 	if ( backend )
-		backend->SendIn(new WriteMessage(backend, num_fields, write_buffer_pos, write_buffer));
+		backend->SendIn(new WriteMessage(backend, num_fields, write_buffer_pos,
+						 write_buffer, write_buffer_start));
 
 	// Clear buffer (no delete, we pass ownership to child thread.)
 	write_buffer = 0;
 	write_buffer_pos = 0;
+	write_buffer_start = 0;
 	}
 
 void WriterFrontend::SetBuf(bool enabled)
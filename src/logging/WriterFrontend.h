@@ -209,6 +209,7 @@ protected:
 	static const int WRITER_BUFFER_SIZE = 1000;
 	int write_buffer_pos;	// Position of next write in buffer.
 	threading::Value*** write_buffer;	// Buffer of size WRITER_BUFFER_SIZE.
+	double write_buffer_start;	// When the first write got buffered, if measuring latencies.
 };
 
 }
@@ -1,9 +1,11 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <algorithm>
 #include <string>
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 #include "threading/SerialTypes.h"
 
@@ -15,6 +17,9 @@ using namespace threading;
 using threading::Value;
 using threading::Field;
 
+// Size of the individual buffers that write buffering collects output in.
+#define WRITE_BUFFER_CHUNK 65536
+
 Ascii::Ascii(WriterFrontend* frontend) : WriterBackend(frontend)
 	{
 	fd = 0;
@@ -25,7 +30,15 @@ Ascii::Ascii(WriterFrontend* frontend) : WriterBackend(frontend)
 	use_json = false;
 	formatter = 0;
 	gzip_level = 0;
+	gzip_block_size = 0;
+	gzip_threads = 0;
 	gzfile = nullptr;
+	gzblocks = nullptr;
+	write_buffer_size = 0;
+	max_write_latency = 0;
+	wbufs_used = 0;
+	wbuf_len = 0;
+	wbuf_time = 0;
 
 	InitConfigOptions();
 	init_options = InitFilterOptions();
@@ -37,6 +50,10 @@ void Ascii::InitConfigOptions()
 	include_meta = BifConst::LogAscii::include_meta;
 	use_json = BifConst::LogAscii::use_json;
 	gzip_level = BifConst::LogAscii::gzip_level;
+	gzip_block_size = BifConst::LogAscii::gzip_block_size;
+	gzip_threads = BifConst::LogAscii::gzip_threads;
+	write_buffer_size = BifConst::LogAscii::write_buffer_size;
+	max_write_latency = BifConst::LogAscii::max_write_latency;
 
 	separator.assign(
 			(const char*) BifConst::LogAscii::separator->Bytes(),
@@ -102,6 +119,27 @@ bool Ascii::InitFilterOptions()
 				return false;
 				}
 			}
+
+		else if ( strcmp(i->first, "gzip_block_size") == 0 )
+			gzip_block_size = strtoull(i->second, 0, 10);
+
+		else if ( strcmp(i->first, "write_buffer_size") == 0 )
+			write_buffer_size = strtoull(i->second, 0, 10);
+
+		else if ( strcmp(i->first, "max_write_latency") == 0 )
+			max_write_latency = atof(i->second);
+
+		else if ( strcmp(i->first, "gzip_threads") == 0 )
+			{
+			gzip_threads = atoi(i->second);
+
+			if ( gzip_threads < 0 )
+				{
+				Error("invalid value for 'gzip_threads', must be a non-negative number.");
+				return false;
+				}
+			}
+
 		else if ( strcmp(i->first, "use_json") == 0 )
 			{
 			if ( strcmp(i->second, "T") == 0 )
@@ -219,6 +257,7 @@ void Ascii::CloseFile(double t)
 	InternalClose(fd);
 	fd = 0;
 	gzfile = nullptr;
+	gzblocks = nullptr;
 	}
 
 bool Ascii::DoInit(const WriterInfo& info, int num_fields, const Field* const * fields)
@@ -254,21 +293,28 @@ bool Ascii::DoInit(const WriterInfo& info, int num_fields, const Field* const *
 			return false;
 			}
 
-		char mode[4];
-		snprintf(mode, sizeof(mode), "wb%d", gzip_level);
-		errno = 0; // errno will only be set under certain circumstances by gzdopen.
-		gzfile = gzdopen(fd, mode);
-
-		if ( gzfile == nullptr )
+		if ( gzip_block_size > 0 )
+			gzblocks = new GzipBlocks(fd, gzip_level, gzip_block_size,
+			                          gzip_threads);
+		else
 			{
-			Error(Fmt("cannot gzip %s: %s", fname.c_str(),
-			                                Strerror(errno)));
-			return false;
+			char mode[4];
+			snprintf(mode, sizeof(mode), "wb%d", gzip_level);
+			errno = 0; // errno will only be set under certain circumstances by gzdopen.
+			gzfile = gzdopen(fd, mode);
+
+			if ( gzfile == nullptr )
+				{
+				Error(Fmt("cannot gzip %s: %s", fname.c_str(),
+				                                Strerror(errno)));
+				return false;
+				}
 			}
 		}
 	else
 		{
 		gzfile = nullptr;
+		gzblocks = nullptr;
 		}
 
 	if ( ! WriteHeader(path) )
@@ -334,6 +380,18 @@ bool Ascii::WriteHeader(const string& path)
 
 bool Ascii::DoFlush(double network_time)
 	{
+	if ( ! FlushWriteBuffer() )
+		{
+		Error(Fmt("error writing to %s: %s", fname.c_str(), Strerror(errno)));
+		return false;
+		}
+
+	if ( gzblocks && ! gzblocks->Flush() )
+		{
+		Error(Fmt("Ascii::DoFlush error: %s", gzblocks->Error().c_str()));
+		return false;
+		}
+
 	fsync(fd);
 	return true;
 	}
@@ -387,8 +445,13 @@ bool Ascii::DoWrite(int num_fields, const Field* const * fields,
 	if ( ! InternalWrite(fd, bytes, len) )
 		goto write_error;
 
-        if ( ! IsBuf() )
+	if ( ! IsBuf() )
+		{
+		if ( ! FlushWriteBuffer() )
+			goto write_error;
+
 		fsync(fd);
+		}
 
 	return true;
 
@@ -432,13 +495,26 @@ bool Ascii::DoRotate(const char* rotated_path, double open, double close, bool t
 
 bool Ascii::DoSetBuf(bool enabled)
 	{
-	// Nothing to do.
-	return true;
+	if ( enabled )
+		return true;
+
+	// Get out what's pending right away.
+	return FlushWriteBuffer();
 	}
 
 bool Ascii::DoHeartbeat(double network_time, double current_time)
 	{
-	// Nothing to do.
+	// The time we get passed may be pseudo-realtime, but we went by
+	// the wall clock when buffering.
+	if ( wbuf_len && ::current_time(true) - wbuf_time >= max_write_latency )
+		{
+		if ( ! FlushWriteBuffer() )
+			{
+			Error(Fmt("error writing to %s: %s", fname.c_str(), Strerror(errno)));
+			return false;
+			}
+		}
+
 	return true;
 	}
 
@@ -478,8 +554,22 @@ string Ascii::Timestamp(double t)
 
 bool Ascii::InternalWrite(int fd, const char* data, int len)
 	{
+	if ( gzblocks )
+		{
+		if ( gzblocks->Write(data, len) )
+			return true;
+
+		Error(Fmt("Ascii::InternalWrite error: %s\n", gzblocks->Error().c_str()));
+		return false;
+		}
+
 	if ( ! gzfile )
+		{
+		if ( write_buffer_size )
+			return BufferWrite(data, len);
+
 		return safe_write(fd, data, len);
+		}
 
 	while ( len > 0 )
 		{
@@ -501,10 +591,27 @@ bool Ascii::InternalWrite(int fd, const char* data, int len)
 
 bool Ascii::InternalClose(int fd)
 	{
+	if ( gzblocks )
+		{
+		bool ok = gzblocks->Close();
+
+		if ( ! ok )
+			Error(Fmt("Ascii::InternalClose error: %s\n", gzblocks->Error().c_str()));
+
+		delete gzblocks;
+		gzblocks = nullptr;
+		return ok;
+		}
+
 	if ( ! gzfile )
 		{
+		bool ok = FlushWriteBuffer();
+
+		if ( ! ok )
+			Error(Fmt("Ascii::InternalClose error: %s\n", Strerror(errno)));
+
 		safe_close(fd);
-		return true;
+		return ok;
 		}
 
 	int res = gzclose(gzfile);
@@ -531,3 +638,60 @@ bool Ascii::InternalClose(int fd)
 	return false;
 	}
 
+bool Ascii::BufferWrite(const char* data, int len)
+	{
+	if ( ! wbuf_len )
+		wbuf_time = current_time(true);
+
+	while ( len > 0 )
+		{
+		if ( ! wbufs_used || wbufs[wbufs_used - 1].size() == WRITE_BUFFER_CHUNK )
+			{
+			if ( wbufs_used == wbufs.size() )
+				{
+				wbufs.emplace_back();
+				wbufs.back().reserve(WRITE_BUFFER_CHUNK);
+				}
+
+			++wbufs_used;
+			}
+
+		std::string& buf = wbufs[wbufs_used - 1];
+		int n = std::min(len, int(WRITE_BUFFER_CHUNK - buf.size()));
+		buf.append(data, n);
+
+		data += n;
+		len -= n;
+		wbuf_len += n;
+		}
+
+	if ( wbuf_len >= write_buffer_size ||
+	     current_time(true) - wbuf_time >= max_write_latency )
+		return FlushWriteBuffer();
+
+	return true;
+	}
+
+bool Ascii::FlushWriteBuffer()
+	{
+	if ( ! wbuf_len )
+		return true;
+
+	std::vector<struct iovec> iov(wbufs_used);
+
+	for ( size_t i = 0; i < wbufs_used; ++i )
+		{
+		iov[i].iov_base = &wbufs[i][0];
+		iov[i].iov_len = wbufs[i].size();
+		}
+
+	bool ok = safe_writev(fd, iov.data(), iov.size());
+
+	for ( size_t i = 0; i < wbufs_used; ++i )
+		wbufs[i].clear();
+
+	wbufs_used = 0;
+	wbuf_len = 0;
+
+	return ok;
+	}
@@ -5,11 +5,16 @@
 #ifndef LOGGING_WRITER_ASCII_H
 #define LOGGING_WRITER_ASCII_H
 
+#include <string>
+#include <vector>
+
 #include "logging/WriterBackend.h"
 #include "threading/formatters/Ascii.h"
 #include "threading/formatters/JSON.h"
 #include "zlib.h"
 
+#include "GzipBlocks.h"
+
 namespace logging { namespace writer {
 
 class Ascii : public WriterBackend {
@@ -33,6 +38,7 @@ protected:
 	bool DoFlush(double network_time) override;
 	bool DoFinish(double network_time) override;
 	bool DoHeartbeat(double network_time, double current_time) override;
+	bool WantsHeartbeats() override	{ return wbuf_len > 0; }
 
 private:
 	bool IsSpecial(const string &path) 	{ return path.find("/dev/") == 0; }
@@ -45,13 +51,23 @@ private:
 	bool InitFormatter();
 	bool InternalWrite(int fd, const char* data, int len);
 	bool InternalClose(int fd);
+	bool BufferWrite(const char* data, int len);
+	bool FlushWriteBuffer();
 
 	int fd;
 	gzFile gzfile;
+	GzipBlocks* gzblocks;
 	string fname;
 	ODesc desc;
 	bool ascii_done;
 
+	// Uncompressed output collected for writing out in one go. We keep
+	// the buffers around once allocated.
+	std::vector<std::string> wbufs;
+	size_t wbufs_used;
+	size_t wbuf_len;
+	double wbuf_time; // when the oldest data currently buffered came in
+
 	// Options set from the script-level.
 	bool output_to_stdout;
 	bool include_meta;
@@ -64,6 +80,10 @@ private:
 	string meta_prefix;
 
 	int gzip_level; // level > 0 enables gzip compression
+	uint64 gzip_block_size; // size > 0 compresses in independent blocks
+	int gzip_threads;
+	uint64 write_buffer_size; // size > 0 enables write buffering
+	double max_write_latency;
 	bool use_json;
 	string json_timestamps;
 
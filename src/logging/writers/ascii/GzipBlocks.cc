@@ -0,0 +1,208 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <algorithm>
+#include <errno.h>
+
+#include "zlib.h"
+
+#include "util.h"
+
+#include "GzipBlocks.h"
+
+using namespace logging::writer;
+
+// How many blocks per worker may be waiting to be written before Write()
+// holds off, so that a slow disk doesn't let the buffers grow unbounded.
+#define MAX_PENDING_PER_WORKER 2
+
+GzipBlocks::GzipBlocks(int arg_fd, int arg_level, size_t arg_block_size,
+                       int num_threads)
+	{
+	fd = arg_fd;
+	level = arg_level;
+	block_size = arg_block_size;
+	terminating = false;
+	written = false;
+
+	for ( int i = 0; i < num_threads; ++i )
+		workers.push_back(std::thread(&GzipBlocks::Worker, this));
+	}
+
+GzipBlocks::~GzipBlocks()
+	{
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		terminating = true;
+		}
+
+	work_cond.notify_all();
+
+	for ( auto& t : workers )
+		t.join();
+	}
+
+void GzipBlocks::Compress(Block* b, int level)
+	{
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+
+	// 16 added to the window bits selects the gzip format.
+	if ( deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8,
+	                  Z_DEFAULT_STRATEGY) != Z_OK )
+		{
+		b->ok = false;
+		return;
+		}
+
+	b->out.resize(deflateBound(&zs, b->in.size()));
+
+	zs.next_in = (Bytef*) b->in.data();
+	zs.avail_in = b->in.size();
+	zs.next_out = (Bytef*) &b->out[0];
+	zs.avail_out = b->out.size();
+
+	b->ok = (deflate(&zs, Z_FINISH) == Z_STREAM_END);
+	b->out.resize(zs.total_out);
+
+	deflateEnd(&zs);
+
+	// Don't need the input anymore.
+	std::string().swap(b->in);
+	}
+
+void GzipBlocks::Worker()
+	{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while ( true )
+		{
+		work_cond.wait(lock, [this] { return terminating || ! queue.empty(); });
+
+		if ( terminating )
+			return;
+
+		BlockPtr b = queue.front();
+		queue.pop_front();
+
+		lock.unlock();
+		Compress(b.get(), level);
+		lock.lock();
+
+		b->done = true;
+		done_cond.notify_all();
+		}
+	}
+
+bool GzipBlocks::Write(const char* data, int len)
+	{
+	while ( len > 0 )
+		{
+		if ( ! current )
+			{
+			current = std::make_shared<Block>();
+			current->in.reserve(block_size);
+			}
+
+		size_t n = std::min(size_t(len), block_size - current->in.size());
+		current->in.append(data, n);
+		data += n;
+		len -= n;
+
+		if ( current->in.size() < block_size )
+			break;
+
+		Submit();
+
+		if ( ! WriteFinished(false) )
+			return false;
+		}
+
+	return true;
+	}
+
+void GzipBlocks::Submit()
+	{
+	BlockPtr b = current;
+	current = nullptr;
+
+	if ( workers.empty() )
+		{
+		Compress(b.get(), level);
+		b->done = true;
+		pending.push_back(b);
+		return;
+		}
+
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.push_back(b);
+		queue.push_back(b);
+		}
+
+	work_cond.notify_one();
+	}
+
+bool GzipBlocks::WriteFinished(bool wait)
+	{
+	size_t max_pending = MAX_PENDING_PER_WORKER * workers.size();
+
+	while ( ! pending.empty() )
+		{
+		BlockPtr b = pending.front();
+
+			{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			if ( ! b->done )
+				{
+				if ( ! wait && pending.size() <= max_pending )
+					break;
+
+				done_cond.wait(lock, [&b] { return b->done; });
+				}
+			}
+
+		pending.pop_front();
+
+		if ( ! b->ok )
+			{
+			error = "gzip compression failed";
+			return false;
+			}
+
+		if ( ! safe_write(fd, b->out.data(), b->out.size()) )
+			{
+			char buf[256];
+			bro_strerror_r(errno, buf, sizeof(buf));
+			error = buf;
+			return false;
+			}
+
+		written = true;
+		}
+
+	return true;
+	}
+
+bool GzipBlocks::Flush()
+	{
+	if ( current && current->in.size() )
+		Submit();
+
+	return WriteFinished(true);
+	}
+
+bool GzipBlocks::Close()
+	{
+	// Even without any data, the file needs a gzip member to be valid.
+	if ( ! written && pending.empty() && ! current )
+		current = std::make_shared<Block>();
+
+	if ( current )
+		Submit();
+
+	bool ok = Flush();
+	safe_close(fd);
+	fd = -1;
+	return ok;
+	}
@@ -0,0 +1,123 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Parallel gzip compression for the ASCII writer.
+//
+// The output gets cut into blocks of a fixed size that are compressed
+// independently, with each block becoming a complete gzip member. A file
+// of concatenated members is still a valid gzip file, which gunzip and
+// zlib's gzread() decompress transparently. Blocks are compressed either
+// directly or on a small pool of worker threads, and are always written
+// to the file in the order they were filled.
+
+#ifndef LOGGING_WRITER_GZIPBLOCKS_H
+#define LOGGING_WRITER_GZIPBLOCKS_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace logging { namespace writer {
+
+class GzipBlocks {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param fd The file to write the compressed output to.
+	 *
+	 * @param level The zlib compression level, 1-9.
+	 *
+	 * @param block_size The amount of uncompressed data per block.
+	 *
+	 * @param num_threads The number of worker threads to compress
+	 * blocks on. If zero, blocks get compressed by the calling thread.
+	 */
+	GzipBlocks(int fd, int level, size_t block_size, int num_threads);
+
+	/**
+	 * Destructor. Stops the workers, discarding any output not written
+	 * yet. Call Close() first to keep it.
+	 */
+	~GzipBlocks();
+
+	/**
+	 * Adds data to the output.
+	 *
+	 * @return False on error, with Error() describing it.
+	 */
+	bool Write(const char* data, int len);
+
+	/**
+	 * Compresses what's currently buffered, even if the block isn't
+	 * full yet, and waits until all blocks have been written out.
+	 *
+	 * @return False on error, with Error() describing it.
+	 */
+	bool Flush();
+
+	/**
+	 * Flushes all output and closes the file.
+	 *
+	 * @return False on error, with Error() describing it.
+	 */
+	bool Close();
+
+	/**
+	 * Returns a description of the last error.
+	 */
+	const std::string& Error() const	{ return error; }
+
+private:
+	struct Block {
+		std::string in;
+		std::string out;
+		bool done = false;
+		bool ok = false;
+	};
+
+	typedef std::shared_ptr<Block> BlockPtr;
+
+	// Compresses a block's input into its output.
+	static void Compress(Block* b, int level);
+
+	// Hands the current block off for compression.
+	void Submit();
+
+	// Writes out finished blocks in order. If wait is true, blocks
+	// until all submitted ones have been written.
+	bool WriteFinished(bool wait);
+
+	void Worker();
+
+	int fd;
+	int level;
+	size_t block_size;
+
+	BlockPtr current;
+
+	// Blocks in output order, not yet written.
+	std::deque<BlockPtr> pending;
+
+	// Blocks waiting for a worker.
+	std::deque<BlockPtr> queue;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable work_cond;
+	std::condition_variable done_cond;
+	bool terminating;
+
+	// True once anything went out to the file.
+	bool written;
+
+	std::string error;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,449 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <string>
+#include <unordered_map>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "threading/SerialTypes.h"
+
+#include "Columnar.h"
+#include "columnar.bif.h"
+
+using namespace logging::writer;
+using namespace threading;
+using threading::Value;
+using threading::Field;
+
+#define COLUMNAR_VERSION 1
+
+#define COLUMN_PLAIN 0
+#define COLUMN_DICT 1
+
+Columnar::Columnar(WriterFrontend* frontend) : WriterBackend(frontend)
+	{
+	fd = 0;
+	columnar_done = false;
+	chunk_rows = BifConst::LogColumnar::chunk_rows;
+	num_rows = 0;
+	}
+
+Columnar::~Columnar()
+	{
+	if ( ! columnar_done )
+		// In case of errors aborting the logging altogether,
+		// DoFinish() may not have been called.
+		CloseFile(network_time);
+	}
+
+bool Columnar::DoInit(const WriterInfo& info, int num_fields, const Field* const * fields)
+	{
+	assert(! fd);
+
+	for ( WriterInfo::config_map::const_iterator i = info.config.begin();
+	      i != info.config.end(); ++i )
+		{
+		if ( strcmp(i->first, "chunk_rows") == 0 )
+			{
+			chunk_rows = strtoull(i->second, 0, 10);
+
+			if ( ! chunk_rows )
+				{
+				Error("invalid value for 'chunk_rows', must be a positive number");
+				return false;
+				}
+			}
+		}
+
+	if ( ! chunk_rows )
+		{
+		Error("invalid value for 'LogColumnar::chunk_rows', must be positive");
+		return false;
+		}
+
+	columns.resize(num_fields);
+
+	return OpenFile();
+	}
+
+bool Columnar::OpenFile()
+	{
+	fname = Info().path + string(".") + LogExt();
+	fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+	if ( fd < 0 )
+		{
+		Error(Fmt("cannot open %s: %s", fname.c_str(), Strerror(errno)));
+		fd = 0;
+		return false;
+		}
+
+	buffer.append("ZCOL");
+	buffer.push_back(COLUMNAR_VERSION);
+
+	const char* path = Info().path;
+	PutString(&buffer, path, strlen(path));
+	PutVarint(&buffer, NumFields());
+
+	for ( int i = 0; i < NumFields(); ++i )
+		{
+		const Field* f = Fields()[i];
+		string type = f->TypeName();
+		PutString(&buffer, f->name, strlen(f->name));
+		PutString(&buffer, type.data(), type.size());
+		}
+
+	if ( ! WriteBuffer() )
+		{
+		Error(Fmt("error writing to %s: %s", fname.c_str(), Strerror(errno)));
+		return false;
+		}
+
+	return true;
+	}
+
+bool Columnar::CloseFile(double close)
+	{
+	if ( ! fd )
+		return true;
+
+	WriteChunk();
+	PutVarint(&buffer, 0);
+	PutDouble(&buffer, close);
+
+	bool ok = WriteBuffer();
+
+	safe_close(fd);
+	fd = 0;
+
+	return ok;
+	}
+
+void Columnar::WriteChunk()
+	{
+	if ( ! num_rows )
+		return;
+
+	PutVarint(&buffer, num_rows);
+
+	for ( auto& col : columns )
+		{
+		EncodeColumn(col);
+		col.clear();
+		}
+
+	num_rows = 0;
+	}
+
+bool Columnar::WriteBuffer()
+	{
+	if ( buffer.empty() )
+		return true;
+
+	bool ok = safe_write(fd, buffer.data(), buffer.size());
+	buffer.clear();
+	return ok;
+	}
+
+void Columnar::EncodeColumn(const std::vector<std::string>& col)
+	{
+	// Only use a dictionary if values repeat on average.
+	std::unordered_map<std::string, uint64> dict;
+	std::vector<const std::string*> entries;
+	bool use_dict = true;
+
+	for ( const auto& v : col )
+		{
+		if ( v.empty() || dict.count(v) )
+			continue;
+
+		if ( (dict.size() + 1) * 2 > col.size() )
+			{
+			use_dict = false;
+			break;
+			}
+
+		entries.push_back(&v);
+		dict[v] = entries.size();
+		}
+
+	if ( ! use_dict )
+		{
+		buffer.push_back(COLUMN_PLAIN);
+
+		for ( const auto& v : col )
+			{
+			PutVarint(&buffer, v.empty() ? 0 : v.size() + 1);
+			buffer.append(v);
+			}
+
+		return;
+		}
+
+	buffer.push_back(COLUMN_DICT);
+	PutVarint(&buffer, entries.size());
+
+	for ( const auto& e : entries )
+		PutString(&buffer, e->data(), e->size());
+
+	uint64 run_index = 0;
+	uint64 run_len = 0;
+
+	for ( const auto& v : col )
+		{
+		uint64 index = v.empty() ? 0 : dict[v];
+
+		if ( run_len && index == run_index )
+			{
+			++run_len;
+			continue;
+			}
+
+		if ( run_len )
+			{
+			PutVarint(&buffer, run_len);
+			PutVarint(&buffer, run_index);
+			}
+
+		run_index = index;
+		run_len = 1;
+		}
+
+	if ( run_len )
+		{
+		PutVarint(&buffer, run_len);
+		PutVarint(&buffer, run_index);
+		}
+	}
+
+void Columnar::EncodeValue(std::string* s, const Value* v)
+	{
+	switch ( v->type ) {
+	case TYPE_BOOL:
+		s->push_back(v->val.int_val ? 1 : 0);
+		break;
+
+	case TYPE_INT:
+		{
+		// Zigzag, so that small negative numbers stay short.
+		uint64 n = uint64(v->val.int_val);
+		PutVarint(s, (n << 1) ^ (v->val.int_val < 0 ? ~uint64(0) : 0));
+		break;
+		}
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		PutVarint(s, v->val.uint_val);
+		break;
+
+	case TYPE_PORT:
+		PutVarint(s, v->val.port_val.port);
+		s->push_back(v->val.port_val.proto);
+		break;
+
+	case TYPE_ADDR:
+	case TYPE_SUBNET:
+		{
+		const Value::addr_t& a = v->type == TYPE_ADDR ?
+			v->val.addr_val : v->val.subnet_val.prefix;
+
+		if ( a.family == IPv4 )
+			{
+			s->push_back(4);
+			s->append((const char*) &a.in.in4, sizeof(a.in.in4));
+			}
+		else
+			{
+			s->push_back(6);
+			s->append((const char*) &a.in.in6, sizeof(a.in.in6));
+			}
+
+		if ( v->type == TYPE_SUBNET )
+			{
+			// Logging passes IPv4 prefix lengths relative to the
+			// internal IPv6 form.
+			uint8_t len = v->val.subnet_val.length;
+			s->push_back(a.family == IPv4 ? len - 96 : len);
+			}
+
+		break;
+		}
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		PutDouble(s, v->val.double_val);
+		break;
+
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+		PutString(s, v->val.string_val.data, v->val.string_val.length);
+		break;
+
+	case TYPE_PATTERN:
+		PutString(s, v->val.pattern_text_val, strlen(v->val.pattern_text_val));
+		break;
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		{
+		const Value::set_t& set = v->type == TYPE_TABLE ?
+			v->val.set_val : v->val.vector_val;
+
+		PutVarint(s, set.size);
+
+		std::string elem;
+
+		for ( bro_int_t i = 0; i < set.size; ++i )
+			{
+			elem.clear();
+
+			if ( set.vals[i]->present )
+				EncodeValue(&elem, set.vals[i]);
+
+			PutVarint(s, elem.empty() ? 0 : elem.size() + 1);
+			s->append(elem);
+			}
+
+		break;
+		}
+
+	default:
+		Error(Fmt("unsupported field type %d for %s", v->type, fname.c_str()));
+		break;
+	}
+	}
+
+void Columnar::PutVarint(std::string* s, uint64 n)
+	{
+	while ( n >= 0x80 )
+		{
+		s->push_back(char((n & 0x7f) | 0x80));
+		n >>= 7;
+		}
+
+	s->push_back(char(n));
+	}
+
+void Columnar::PutDouble(std::string* s, double d)
+	{
+	uint64 n;
+	memcpy(&n, &d, sizeof(n));
+
+	for ( int i = 0; i < 8; ++i )
+		s->push_back(char((n >> (8 * i)) & 0xff));
+	}
+
+void Columnar::PutString(std::string* s, const char* data, int len)
+	{
+	PutVarint(s, len);
+	s->append(data, len);
+	}
+
+bool Columnar::DoWrite(int num_fields, const Field* const * fields,
+			     Value** vals)
+	{
+	if ( ! fd && ! OpenFile() )
+		return false;
+
+	for ( int i = 0; i < num_fields; ++i )
+		{
+		std::string v;
+
+		if ( vals[i]->present )
+			EncodeValue(&v, vals[i]);
+
+		columns[i].push_back(std::move(v));
+		}
+
+	if ( ++num_rows < chunk_rows && IsBuf() )
+		return true;
+
+	WriteChunk();
+
+	if ( ! WriteBuffer() )
+		{
+		Error(Fmt("error writing to %s: %s", fname.c_str(), Strerror(errno)));
+		return false;
+		}
+
+	return true;
+	}
+
+bool Columnar::DoSetBuf(bool enabled)
+	{
+	if ( enabled || ! fd )
+		return true;
+
+	// Get out what's pending right away.
+	WriteChunk();
+	return WriteBuffer();
+	}
+
+bool Columnar::DoFlush(double network_time)
+	{
+	if ( ! fd )
+		return true;
+
+	// Note that this ends the current chunk early.
+	WriteChunk();
+	return WriteBuffer();
+	}
+
+bool Columnar::DoRotate(const char* rotated_path, double open, double close, bool terminating)
+	{
+	// Don't rotate if there's not a file currently open.
+	if ( ! fd )
+		{
+		FinishedRotation();
+		return true;
+		}
+
+	if ( ! CloseFile(close) )
+		{
+		Error(Fmt("error writing to %s: %s", fname.c_str(), Strerror(errno)));
+		FinishedRotation();
+		return false;
+		}
+
+	string nname = string(rotated_path) + "." + LogExt();
+
+	if ( rename(fname.c_str(), nname.c_str()) != 0 )
+		{
+		char buf[256];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		Error(Fmt("failed to rename %s to %s: %s", fname.c_str(),
+		          nname.c_str(), buf));
+		FinishedRotation();
+		return false;
+		}
+
+	if ( ! FinishedRotation(nname.c_str(), fname.c_str(), open, close, terminating) )
+		{
+		Error(Fmt("error rotating %s to %s", fname.c_str(), nname.c_str()));
+		return false;
+		}
+
+	return true;
+	}
+
+bool Columnar::DoFinish(double network_time)
+	{
+	if ( columnar_done )
+		{
+		fprintf(stderr, "internal error: duplicate finish\n");
+		abort();
+		}
+
+	columnar_done = true;
+
+	return CloseFile(network_time);
+	}
+
+bool Columnar::DoHeartbeat(double network_time, double current_time)
+	{
+	return true;
+	}
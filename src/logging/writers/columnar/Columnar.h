@@ -0,0 +1,93 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Log writer for a compact, column-oriented binary format.
+//
+// Rows get buffered per stream and written out in chunks, with each
+// chunk storing all values of one column together. A column is either
+// dictionary-encoded, with runs of identical values collapsed, or stored
+// plainly if its values don't repeat enough. The files describe their own
+// schema. All integers are little-endian, "varint" is the usual base-128
+// encoding with the low groups first:
+//
+//     file    := "ZCOL" version:u8 header chunk* end
+//     header  := path:str num_fields:varint (name:str type:str)*
+//     chunk   := num_rows:varint column*       (num_rows > 0, one per field)
+//     column  := 0x00 (0:varint | (len+1):varint value)*  (one per row)
+//              | 0x01 dict_size:varint (len:varint value)*
+//                     (run_len:varint index:varint)*
+//     end     := 0:varint close:f64
+//     str     := len:varint bytes
+//
+// In dictionary-encoded columns, index 0 stands for an unset value and
+// index n for the n-th dictionary entry. Values are encoded by type:
+// bool as one byte; int as zigzag varint; count as varint; port as
+// varint plus a protocol byte (0 unknown, 1 tcp, 2 udp, 3 icmp); addr as
+// a family byte (4 or 6) plus the raw bytes; subnet as an addr plus a
+// prefix length byte; double, time and interval as f64; enum, string and
+// the remaining types as str; and sets and vectors as an element count
+// followed by each element as a (len+1):varint value pair, 0 for unset.
+
+#ifndef LOGGING_WRITER_COLUMNAR_H
+#define LOGGING_WRITER_COLUMNAR_H
+
+#include <string>
+#include <vector>
+
+#include "logging/WriterBackend.h"
+
+namespace logging { namespace writer {
+
+class Columnar : public WriterBackend {
+public:
+	explicit Columnar(WriterFrontend* frontend);
+	~Columnar() override;
+
+	static string LogExt()	{ return "zcol"; }
+
+	static WriterBackend* Instantiate(WriterFrontend* frontend)
+		{ return new Columnar(frontend); }
+
+protected:
+	bool DoInit(const WriterInfo& info, int num_fields,
+			    const threading::Field* const* fields) override;
+	bool DoWrite(int num_fields, const threading::Field* const* fields,
+			     threading::Value** vals) override;
+	bool DoSetBuf(bool enabled) override;
+	bool DoRotate(const char* rotated_path, double open,
+			      double close, bool terminating) override;
+	bool DoFlush(double network_time) override;
+	bool DoFinish(double network_time) override;
+	bool DoHeartbeat(double network_time, double current_time) override;
+	bool WantsHeartbeats() override	{ return false; }
+
+private:
+	bool OpenFile();
+	bool CloseFile(double close);
+	void WriteChunk();
+	bool WriteBuffer();
+
+	void EncodeColumn(const std::vector<std::string>& col);
+	void EncodeValue(std::string* s, const threading::Value* v);
+
+	static void PutVarint(std::string* s, uint64 n);
+	static void PutDouble(std::string* s, double d);
+	static void PutString(std::string* s, const char* data, int len);
+
+	int fd;
+	string fname;
+	bool columnar_done;
+	uint64 chunk_rows;
+
+	// Buffered rows, one vector of encoded values per field. An empty
+	// string stands for an unset value.
+	std::vector<std::vector<std::string>> columns;
+	uint64 num_rows;
+
+	// Output that's ready to go to the file.
+	std::string buffer;
+};
+
+}
+}
+
+#endif
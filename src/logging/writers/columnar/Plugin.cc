@@ -0,0 +1,25 @@
+// See the file  in the main distribution directory for copyright.
+
+
+#include "plugin/Plugin.h"
+
+#include "Columnar.h"
+
+namespace plugin {
+namespace Zeek_ColumnarWriter {
+
+class Plugin : public plugin::Plugin {
+public:
+	plugin::Configuration Configure()
+		{
+		AddComponent(new ::logging::Component("Columnar", ::logging::writer::Columnar::Instantiate));
+
+		plugin::Configuration config;
+		config.name = "Zeek::ColumnarWriter";
+		config.description = "Columnar binary log writer";
+		return config;
+		}
+} plugin;
+
+}
+}
@@ -28,6 +28,7 @@ protected:
 	bool DoFlush(double network_time) override { return true; }
 	bool DoFinish(double network_time) override { return true; }
 	bool DoHeartbeat(double network_time, double current_time) override { return true; }
+	bool WantsHeartbeats() override { return false; }
 };
 
 }
@@ -18,7 +18,8 @@ using threading::Field;
 
 SQLite::SQLite(WriterFrontend* frontend)
 	: WriterBackend(frontend),
-	  fields(), num_fields(), db(), st()
+	  fields(), num_fields(), db(), st(),
+	  batch_rows(), batch_start(), in_batch()
 	{
 	set_separator.assign(
 			(const char*) BifConst::LogSQLite::set_separator->Bytes(),
@@ -35,6 +36,9 @@ SQLite::SQLite(WriterFrontend* frontend)
 			BifConst::LogSQLite::empty_field->Len()
 			);
 
+	batch_size = BifConst::LogSQLite::batch_size;
+	flush_interval = BifConst::LogSQLite::flush_interval;
+
 	threading::formatter::Ascii::SeparatorInfo sep_info(string(), set_separator, unset_field, empty_field);
 	io = new threading::formatter::Ascii(this, sep_info);
 	}
@@ -120,10 +124,6 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields,
 		return false;
 		}
 
-	// Allow connections to same DB to use single data/schema cache. Also
-	// allows simultaneous writes to one file.
-	sqlite3_enable_shared_cache(1);
-
 	num_fields = arg_num_fields;
 	fields = arg_fields;
 
@@ -140,16 +140,31 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields,
 	else
 		tablename = it->second;
 
+	// Each writer gets its own cache. In a shared one, a writer's open
+	// transaction would lock out all others, instead of them waiting
+	// for it as set up below.
 	if ( checkError(sqlite3_open_v2(
 					fullpath.c_str(),
 					&db,
 					SQLITE_OPEN_READWRITE |
 					SQLITE_OPEN_CREATE |
-					SQLITE_OPEN_NOMUTEX
+					SQLITE_OPEN_NOMUTEX |
+					SQLITE_OPEN_PRIVATECACHE
 					,
 					NULL)) )
 		return false;
 
+	if ( checkError(sqlite3_busy_timeout(db, int(BifConst::LogSQLite::busy_timeout * 1000))) )
+		return false;
+
+	string journal_mode((const char*) BifConst::LogSQLite::journal_mode->Bytes(),
+	                    BifConst::LogSQLite::journal_mode->Len());
+	string synchronous((const char*) BifConst::LogSQLite::synchronous->Bytes(),
+	                   BifConst::LogSQLite::synchronous->Len());
+
+	if ( ! Pragma("journal_mode", journal_mode) || ! Pragma("synchronous", synchronous) )
+		return false;
+
 	string create = "CREATE TABLE IF NOT EXISTS " + tablename + " (\n";
 		//"id SERIAL UNIQUE NOT NULL"; // SQLite has rowids, we do not need a counter here.
 
@@ -333,8 +348,72 @@ int SQLite::AddParams(Value* val, int pos)
 	}
 	}
 
+bool SQLite::Exec(const string& sql)
+	{
+	char *errorMsg = 0;
+	int res = sqlite3_exec(db, sql.c_str(), NULL, NULL, &errorMsg);
+
+	if ( res != SQLITE_OK )
+		{
+		Error(Fmt("Error executing '%s': %s", sql.c_str(), errorMsg ? errorMsg : sqlite3_errstr(res)));
+		sqlite3_free(errorMsg);
+		return false;
+		}
+
+	return true;
+	}
+
+bool SQLite::Pragma(const char* name, const string& value)
+	{
+	if ( value.empty() )
+		return true;
+
+	// Pragmas don't take parameters, so make sure there's nothing but a
+	// keyword in there.
+	for ( string::const_iterator i = value.begin(); i != value.end(); ++i )
+		{
+		if ( ! isalnum(*i) )
+			{
+			Error(Fmt("invalid value for %s: %s", name, value.c_str()));
+			return false;
+			}
+		}
+
+	return Exec(string("PRAGMA ") + name + " = " + value + ";");
+	}
+
+bool SQLite::BeginBatch()
+	{
+	// Immediate, so that waiting for other writers happens here instead
+	// of failing halfway through.
+	if ( ! Exec("BEGIN IMMEDIATE;") )
+		return false;
+
+	in_batch = true;
+	batch_rows = 0;
+	batch_start = current_time(true);
+	return true;
+	}
+
+bool SQLite::CommitBatch()
+	{
+	if ( ! in_batch )
+		return true;
+
+	in_batch = false;
+
+	if ( sqlite3_get_autocommit(db) )
+		// SQLite rolled the transaction back after an error already.
+		return true;
+
+	return Exec("COMMIT;");
+	}
+
 bool SQLite::DoWrite(int num_fields, const Field* const * fields, Value** vals)
 	{
+	if ( batch_size > 1 && ! in_batch && ! BeginBatch() )
+		return false;
+
 	// bind parameters
 	for ( int i = 0; i < num_fields; i++ )
 		{
@@ -353,11 +432,35 @@ bool SQLite::DoWrite(int num_fields, const Field* const * fields, Value** vals)
 	if ( checkError(sqlite3_reset(st)) )
 		return false;
 
+	if ( in_batch && ++batch_rows >= batch_size )
+		return CommitBatch();
+
+	return true;
+	}
+
+bool SQLite::DoFlush(double network_time)
+	{
+	return CommitBatch();
+	}
+
+bool SQLite::DoFinish(double network_time)
+	{
+	return CommitBatch();
+	}
+
+bool SQLite::DoHeartbeat(double network_time, double current_time)
+	{
+	if ( in_batch && current_time - batch_start >= flush_interval )
+		return CommitBatch();
+
 	return true;
 	}
 
 bool SQLite::DoRotate(const char* rotated_path, double open, double close, bool terminating)
 	{
+	if ( ! CommitBatch() )
+		return false;
+
 	if ( ! FinishedRotation("/dev/null", Info().path, open, close, terminating))
 		{
 		Error(Fmt("error rotating %s", Info().path));
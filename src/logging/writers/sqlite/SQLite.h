@@ -29,13 +29,21 @@ protected:
 	bool DoSetBuf(bool enabled) override { return true; }
 	bool DoRotate(const char* rotated_path, double open,
 			      double close, bool terminating) override;
-	bool DoFlush(double network_time) override { return true; }
-	bool DoFinish(double network_time) override { return true; }
-	bool DoHeartbeat(double network_time, double current_time) override { return true; }
+	bool DoFlush(double network_time) override;
+	bool DoFinish(double network_time) override;
+	bool DoHeartbeat(double network_time, double current_time) override;
+	bool WantsHeartbeats() override	{ return in_batch; }
 
 private:
 	bool checkError(int code);
 
+	bool Exec(const string& sql);
+	bool Pragma(const char* name, const string& value);
+
+	// Start and end a batch of rows written in one transaction.
+	bool BeginBatch();
+	bool CommitBatch();
+
 	int AddParams(threading::Value* val, int pos);
 	string GetTableType(int, int);
 
@@ -49,6 +57,14 @@ private:
 	string unset_field;
 	string empty_field;
 
+	unsigned int batch_size;
+	double flush_interval;
+
+	// Rows written in the current transaction, and when it began.
+	unsigned int batch_rows;
+	double batch_start;
+	bool in_batch;
+
 	threading::formatter::Ascii* io;
 };
 
@@ -8,6 +8,7 @@
 #include <signal.h>
 #include <string.h>
 #include <list>
+#include <fstream>
 #ifdef HAVE_GETOPT_H
 #include <getopt.h>
 #endif
@@ -31,8 +32,10 @@ extern "C" {
 #include "Reporter.h"
 #include "Net.h"
 #include "NetVar.h"
+#include "Optimize.h"
 #include "Var.h"
 #include "Timer.h"
+#include "Conn.h"
 #include "Stmt.h"
 #include "Debug.h"
 #include "DFA.h"
@@ -41,6 +44,7 @@ extern "C" {
 #include "EventRegistry.h"
 #include "Stats.h"
 #include "Brofiler.h"
+#include "ScriptProfiler.h"
 #include "Traverse.h"
 
 #include "threading/Manager.h"
@@ -55,12 +59,22 @@ extern "C" {
 #include "zeekygen/Manager.h"
 #include "iosource/Manager.h"
 #include "broker/Manager.h"
+#include "metrics/Manager.h"
+#include "StallDetector.h"
+#include "Zygote.h"
+#include "HugePages.h"
+#include "Checkpoint.h"
+
+#ifdef ENABLE_MICROBENCH
+#include "microbench/Microbench.h"
+#endif
 
 #include "binpac_bro.h"
 
 #include "3rdparty/sqlite3.h"
 
 Brofiler brofiler;
+ScriptProfiler script_profiler;
 
 #ifndef HAVE_STRSEP
 extern "C" {
@@ -91,6 +105,8 @@ file_analysis::Manager* file_mgr = 0;
 zeekygen::Manager* zeekygen_mgr = 0;
 iosource::Manager* iosource_mgr = 0;
 bro_broker::Manager* broker_mgr = 0;
+metrics::Manager* metrics_mgr = 0;
+StallDetector* stall_detector = 0;
 
 const char* prog;
 char* writefile = 0;
@@ -116,9 +132,13 @@ OpaqueType* entropy_type = 0;
 OpaqueType* cardinality_type = 0;
 OpaqueType* topk_type = 0;
 OpaqueType* bloomfilter_type = 0;
+OpaqueType* cuckoofilter_type = 0;
+OpaqueType* xorfilter_type = 0;
+OpaqueType* countminsketch_type = 0;
 OpaqueType* x509_opaque_type = 0;
 OpaqueType* ocsp_resp_opaque_type = 0;
 OpaqueType* paraglob_type = 0;
+OpaqueType* pattern_stream_type = 0;
 
 // Keep copy of command line
 int bro_argc;
@@ -174,6 +194,7 @@ void usage(int code = 1)
 	fprintf(stderr, "    -H|--save-seeds <file>         | save seeds to given file\n");
 	fprintf(stderr, "    -I|--print-id <ID name>        | print out given ID\n");
 	fprintf(stderr, "    -N|--print-plugins             | print available plugins and exit (-NN for verbose)\n");
+	fprintf(stderr, "    -O|--optimize                  | fold constant conditions in scripts (-OO to print statistics)\n");
 	fprintf(stderr, "    -P|--prime-dns                 | prime DNS\n");
 	fprintf(stderr, "    -Q|--time                      | print execution time summary to stderr\n");
 	fprintf(stderr, "    -S|--debug-rules               | enable rule debugging\n");
@@ -187,6 +208,11 @@ void usage(int code = 1)
 	fprintf(stderr, "    -M|--mem-profile               | record heap [perftools]\n");
 #endif
 	fprintf(stderr, "    --pseudo-realtime[=<speedup>]  | enable pseudo-realtime for performance evaluation (default 1)\n");
+	fprintf(stderr, "    --timer-mgr <pq|cq|wheel>      | select the timer manager implementation (default pq)\n");
+	fprintf(stderr, "    --zygote <node>[,<node>...]    | parse scripts once, then fork a process per cluster node\n");
+#ifdef ENABLE_MICROBENCH
+	fprintf(stderr, "    --microbench[=<filter>]        | run the microbenchmarks whose names contain filter, and exit\n");
+#endif
 
 #ifdef USE_IDMEF
 	fprintf(stderr, "    -n|--idmef-dtd <idmef-msg.dtd> | specify path to IDMEF DTD file\n");
@@ -201,7 +227,7 @@ void usage(int code = 1)
 	fprintf(stderr, "    $ZEEK_LOG_SUFFIX               | ASCII log file extension (.%s)\n", logging::writer::Ascii::LogExt().c_str());
 	fprintf(stderr, "    $ZEEK_PROFILER_FILE            | Output file for script execution statistics (not set)\n");
 	fprintf(stderr, "    $ZEEK_DISABLE_ZEEKYGEN         | Disable Zeekygen documentation support (%s)\n", zeekenv("ZEEK_DISABLE_ZEEKYGEN") ? "set" : "not set");
-	fprintf(stderr, "    $ZEEK_DNS_RESOLVER             | IPv4/IPv6 address of DNS resolver to use (%s)\n", zeekenv("ZEEK_DNS_RESOLVER") ? zeekenv("ZEEK_DNS_RESOLVER") : "not set, will use first IPv4 address from /etc/resolv.conf");
+	fprintf(stderr, "    $ZEEK_DNS_RESOLVER             | IPv4/IPv6 address of DNS resolver to use, optionally as <addr>:<port> or [<addr>]:<port> (%s)\n", zeekenv("ZEEK_DNS_RESOLVER") ? zeekenv("ZEEK_DNS_RESOLVER") : "not set, will use first IPv4 address from /etc/resolv.conf");
 
 	fprintf(stderr, "\n");
 
@@ -315,6 +341,13 @@ void terminate_bro()
 
 	brofiler.WriteStats();
 
+	if ( checkpointer )
+		{
+		checkpointer->Save();
+		delete checkpointer;
+		checkpointer = 0;
+		}
+
 	EventHandlerPtr zeek_done = internal_handler("zeek_done");
 	if ( zeek_done )
 		mgr.QueueEventFast(zeek_done, val_list{});
@@ -322,6 +355,17 @@ void terminate_bro()
 	timer_mgr->Expire();
 	mgr.Drain();
 
+	if ( script_profiler.Active() )
+		{
+		script_profiler.Stop();
+
+		const char* file = script_profiling_file->CheckString();
+
+		if ( *file && ! script_profiler.Write(file) )
+			reporter->Error("can't write script profile to %s: %s",
+			                file, strerror(errno));
+		}
+
 	if ( profiling_logger )
 		{
 		// FIXME: There are some occasional crashes in the memory
@@ -334,6 +378,7 @@ void terminate_bro()
 
 	mgr.Drain();
 
+	metrics_mgr->Terminate();
 	log_mgr->Terminate();
 	input_mgr->Terminate();
 	thread_mgr->Terminate();
@@ -344,6 +389,7 @@ void terminate_bro()
 	plugin_mgr->FinishPlugins();
 
 	delete zeekygen_mgr;
+	delete inactivity_sweeper;
 	delete timer_mgr;
 	delete event_registry;
 	delete analyzer_mgr;
@@ -351,6 +397,8 @@ void terminate_bro()
 	// broker_mgr is deleted via iosource_mgr
 	delete iosource_mgr;
 	delete log_mgr;
+	delete metrics_mgr;
+	delete stall_detector;
 	delete reporter;
 	delete plugin_mgr;
 	delete val_mgr;
@@ -387,6 +435,30 @@ RETSIGTYPE sig_handler(int signo)
 	return RETSIGVAL;
 	}
 
+// Warns about capture interfaces whose NIC sits on another NUMA node than
+// the CPU of the main thread.
+static void check_interface_nodes(const name_list& interfaces)
+	{
+	int node = thread_mgr->MainThreadNode();
+
+	if ( node < 0 )
+		return;
+
+	for ( int i = 0; i < interfaces.length(); ++i )
+		{
+		// Skip a packet source prefix like "af_packet::".
+		const char* iface = strrchr(interfaces[i], ':');
+		iface = iface ? iface + 1 : interfaces[i];
+
+		std::ifstream in(fmt("/sys/class/net/%s/device/numa_node", iface));
+		int nic_node;
+
+		if ( in >> nic_node && nic_node >= 0 && nic_node != node )
+			reporter->Warning("interface %s is on NUMA node %d, but the main thread runs on node %d",
+					  iface, nic_node, node);
+		}
+	}
+
 static void atexit_handler()
 	{
 	set_processing_status("TERMINATED", "atexit");
@@ -427,7 +499,14 @@ int main(int argc, char** argv)
 	int rule_debug = 0;
 	int RE_level = 4;
 	int print_plugins = 0;
+	int optimize = 0;
 	int time_bro = 0;
+	const char* timer_mgr_type = "pq";
+	const char* zygote_nodes = 0;
+#ifdef ENABLE_MICROBENCH
+	int microbench = 0;
+	const char* microbench_filter = 0;
+#endif
 
 	static struct option long_opts[] = {
 		{"parse-only",	no_argument,		0,	'a'},
@@ -449,6 +528,7 @@ int main(int argc, char** argv)
 		{"load-seeds",		required_argument,	0,	'G'},
 		{"save-seeds",		required_argument,	0,	'H'},
 		{"print-plugins",	no_argument,		0,	'N'},
+		{"optimize",		no_argument,		0,	'O'},
 		{"prime-dns",		no_argument,		0,	'P'},
 		{"time",		no_argument,		0,	'Q'},
 		{"debug-rules",		no_argument,		0,	'S'},
@@ -469,6 +549,11 @@ int main(int argc, char** argv)
 #endif
 
 		{"pseudo-realtime",	optional_argument, 0,	'E'},
+		{"timer-mgr",		required_argument, 0,	'K'},
+		{"zygote",		required_argument, 0,	'Z'},
+#ifdef	ENABLE_MICROBENCH
+		{"microbench",		optional_argument, 0,	'Y'},
+#endif
 
 		{0,			0,			0,	0},
 	};
@@ -501,7 +586,7 @@ int main(int argc, char** argv)
 	opterr = 0;
 
 	char opts[256];
-	safe_strncpy(opts, "B:e:f:G:H:I:i:n:p:r:s:T:t:U:w:X:CFNPQSWabdhv",
+	safe_strncpy(opts, "B:e:f:G:H:I:i:n:p:r:s:T:t:U:w:X:CFNOPQSWabdhv",
 		     sizeof(opts));
 
 #ifdef USE_PERFTOOLS_DEBUG
@@ -580,6 +665,21 @@ int main(int argc, char** argv)
 				pseudo_realtime = atof(optarg);
 			break;
 
+		case 'K':
+			timer_mgr_type = optarg;
+			break;
+
+		case 'Z':
+			zygote_nodes = optarg;
+			break;
+
+#ifdef ENABLE_MICROBENCH
+		case 'Y':
+			microbench = 1;
+			microbench_filter = optarg;
+			break;
+#endif
+
 		case 'F':
 			if ( dns_type != DNS_DEFAULT )
 				usage(1);
@@ -602,6 +702,10 @@ int main(int argc, char** argv)
 			++print_plugins;
 			break;
 
+		case 'O':
+			++optimize;
+			break;
+
 		case 'P':
 			if ( dns_type != DNS_DEFAULT )
 				usage(1);
@@ -688,6 +792,12 @@ int main(int argc, char** argv)
 	SSL_library_init();
 	SSL_load_error_strings();
 
+#ifdef ENABLE_MICROBENCH
+	// The benchmarks need the managers above, but no scripts.
+	if ( microbench )
+		exit(microbench::run(microbench_filter));
+#endif
+
 	int r = sqlite3_initialize();
 
 	if ( r != SQLITE_OK )
@@ -708,8 +818,17 @@ int main(int argc, char** argv)
 	createCurrentDoc("1.0");		// Set a global XML document
 #endif
 
-	timer_mgr = new PQ_TimerMgr("<GLOBAL>");
-	// timer_mgr = new CQ_TimerMgr();
+	if ( streq(timer_mgr_type, "pq") )
+		timer_mgr = new PQ_TimerMgr("<GLOBAL>");
+	else if ( streq(timer_mgr_type, "cq") )
+		timer_mgr = new CQ_TimerMgr("<GLOBAL>");
+	else if ( streq(timer_mgr_type, "wheel") )
+		timer_mgr = new Wheel_TimerMgr("<GLOBAL>");
+	else
+		{
+		fprintf(stderr, "unknown timer manager '%s'\n", timer_mgr_type);
+		usage(1);
+		}
 
 	zeekygen_mgr = new zeekygen::Manager(zeekygen_config, bro_argv[0]);
 
@@ -756,6 +875,9 @@ int main(int argc, char** argv)
 	input_mgr = new input::Manager();
 	file_mgr = new file_analysis::Manager();
 	broker_mgr = new bro_broker::Manager(read_files.length() > 0);
+	metrics_mgr = new metrics::Manager();
+
+	double time_plugins_start = current_time(true);
 
 	plugin_mgr->InitPreScript();
 	analyzer_mgr->InitPreScript();
@@ -776,6 +898,9 @@ int main(int argc, char** argv)
 
 	plugin_mgr->ActivateDynamicPlugins(! bare_mode);
 
+	double time_plugins_done = current_time(true);
+	double time_parse_start, time_parse_done;
+
 	init_event_handlers();
 
 	md5_type = new OpaqueType("md5");
@@ -785,9 +910,13 @@ int main(int argc, char** argv)
 	cardinality_type = new OpaqueType("cardinality");
 	topk_type = new OpaqueType("topk");
 	bloomfilter_type = new OpaqueType("bloomfilter");
+	cuckoofilter_type = new OpaqueType("cuckoofilter");
+	xorfilter_type = new OpaqueType("xorfilter");
+	countminsketch_type = new OpaqueType("countminsketch");
 	x509_opaque_type = new OpaqueType("x509");
 	ocsp_resp_opaque_type = new OpaqueType("ocsp_resp");
 	paraglob_type = new OpaqueType("paraglob");
+	pattern_stream_type = new OpaqueType("pattern_stream");
 
 	// The leak-checker tends to produce some false
 	// positives (memory which had already been
@@ -800,10 +929,14 @@ int main(int argc, char** argv)
 	HeapLeakChecker::Disabler disabler;
 #endif
 
+	time_parse_start = current_time(true);
+
 	is_parsing = true;
 	yyparse();
 	is_parsing = false;
 
+	time_parse_done = current_time(true);
+
 	RecordVal::ResizeParseTimeRecords();
 
 	init_general_global_var();
@@ -826,8 +959,18 @@ int main(int argc, char** argv)
 	if ( reporter->Errors() > 0 )
 		exit(1);
 
+	// Leave the scripts as written when debugging them.
+	if ( optimize && ! g_policy_debug )
+		optimize_scripts(optimize > 1);
+
+	// Everything so far gets shared with the nodes. What follows starts
+	// threads and opens connections, which each node does on its own.
+	if ( zygote_nodes )
+		zygote_fork(zygote_nodes, &interfaces);
+
 	plugin_mgr->InitPostScript();
 	zeekygen_mgr->InitPostScript();
+	mgr.InitPostScript();
 	broker_mgr->InitPostScript();
 
 	if ( print_plugins )
@@ -859,6 +1002,22 @@ int main(int argc, char** argv)
 	reporter->InitOptions();
 	zeekygen_mgr->GenerateDocs();
 
+	// Before starting threads and setting up packet sources, so that
+	// they and their buffers end up next to the main thread.
+	int main_cpu = opt_internal_int("main_thread_cpu");
+
+	if ( main_cpu >= 0 )
+		thread_mgr->PinMainThread(main_cpu);
+
+	set_huge_page_limit(opt_internal_unsigned("huge_page_memory"));
+
+	metrics_mgr->InitPostScript();
+
+	double stall_threshold = opt_internal_double("main_loop_stall_threshold");
+
+	if ( stall_threshold > 0 )
+		stall_detector = new StallDetector(stall_threshold);
+
 	if ( user_pcap_filter )
 		{
 		ID* id = global_scope()->Lookup("cmd_line_bpf_filter");
@@ -919,6 +1078,9 @@ int main(int argc, char** argv)
 			}
 		}
 
+	if ( main_cpu >= 0 )
+		check_interface_nodes(interfaces);
+
 	if ( dns_type != DNS_PRIME )
 		net_init(interfaces, read_files, writefile, do_watchdog);
 
@@ -973,11 +1135,25 @@ int main(int argc, char** argv)
 			segment_logger = profiling_logger;
 		}
 
+	if ( script_profiling_interval > 0 &&
+	     ! script_profiler.Start(script_profiling_interval) )
+		reporter->Error("can't start script profiling: %s", strerror(errno));
+
 	if ( ! reading_live && ! reading_traces )
 		// Set up network_time to track real-time, since
 		// we don't have any other source for it.
 		net_update_time(current_time());
 
+	checkpointer = new Checkpointer();
+
+	if ( checkpointer->IsActive() )
+		checkpointer->Restore();
+	else
+		{
+		delete checkpointer;
+		checkpointer = 0;
+		}
+
 	EventHandlerPtr zeek_init = internal_handler("zeek_init");
 	if ( zeek_init )	//### this should be a function
 		mgr.QueueEventFast(zeek_init, val_list{});
@@ -1087,6 +1263,13 @@ int main(int argc, char** argv)
 
 			fprintf(stderr, "# initialization %.6f\n", time_net_start - time_start);
 
+			// Where startup time goes: loading plugins, parsing
+			// scripts, and everything after, including zeek_init.
+			fprintf(stderr, "# initialization plugins %.6f, parsing %.6f, post-parse %.6f\n",
+				time_plugins_done - time_plugins_start,
+				time_parse_done - time_parse_start,
+				time_net_start - time_parse_done);
+
 			fprintf(stderr, "# initialization %" PRIu64 "M/%" PRIu64 "M\n",
 				mem_net_start_total / 1024 / 1024,
 				mem_net_start_malloced / 1024 / 1024);
@@ -0,0 +1,420 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "Manager.h"
+#include "Server.h"
+
+#include "Conn.h"
+#include "Event.h"
+#include "ID.h"
+#include "MemoryAccounting.h"
+#include "Net.h"
+#include "NetVar.h"
+#include "Reassem.h"
+#include "Reporter.h"
+#include "Sessions.h"
+#include "Timer.h"
+#include "Var.h"
+#include "analyzer/Manager.h"
+#include "broker/Manager.h"
+#include "iosource/Manager.h"
+#include "iosource/PktSrc.h"
+#include "threading/Manager.h"
+
+using namespace metrics;
+
+Manager::Manager()
+	{
+	update_interval = 0;
+	last_update = 0;
+	server = 0;
+	}
+
+Manager::~Manager()
+	{
+	Terminate();
+
+	for ( auto& f : families )
+		for ( auto m : f.second.metrics )
+			delete m;
+	}
+
+void Manager::InitPostScript()
+	{
+	update_interval = opt_internal_double("metrics_update_interval");
+
+	RegisterCoreMetrics();
+	RegisterMemoryMetrics();
+
+	if ( opt_internal_int("latency_stats") )
+		RegisterLatencies();
+
+	Val* port_val = opt_internal_val("metrics_port");
+	uint32 port = port_val ? port_val->AsPortVal()->Port() : 0;
+
+	if ( ! port )
+		return;
+
+	StringVal* addr_val = opt_internal_string("metrics_address");
+	std::string addr = addr_val ? addr_val->CheckString() : "";
+	Unref(addr_val);
+
+	server = new Server([this] { return Expose(); });
+
+	if ( ! server->Start(addr, port) )
+		{
+		reporter->Error("metrics endpoint: %s", server->Error().c_str());
+		delete server;
+		server = 0;
+		}
+	}
+
+void Manager::Terminate()
+	{
+	delete server;
+	server = 0;
+	}
+
+Metric* Manager::Lookup(const std::string& name, const std::string& help,
+			Metric::Type type, const Labels& labels,
+			const std::vector<double>& bounds)
+	{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto i = families.find(name);
+
+	if ( i == families.end() )
+		{
+		Family f;
+		f.type = type;
+		f.help = help;
+		f.bounds = bounds;
+		i = families.insert(std::make_pair(name, f)).first;
+		}
+
+	Family& f = i->second;
+
+	if ( f.type != type )
+		reporter->InternalError("metric %s registered as both %s and %s",
+					name.c_str(), Metric::TypeName(f.type),
+					Metric::TypeName(type));
+
+	for ( auto m : f.metrics )
+		if ( m->GetLabels() == labels )
+			return m;
+
+	Metric* m = 0;
+
+	switch ( type ) {
+	case Metric::COUNTER:
+		m = new Counter(labels);
+		break;
+
+	case Metric::GAUGE:
+		m = new Gauge(labels);
+		break;
+
+	case Metric::HISTOGRAM:
+		m = new Histogram(f.bounds, labels);
+		break;
+	}
+
+	f.metrics.push_back(m);
+	return m;
+	}
+
+Counter* Manager::GetCounter(const std::string& name, const std::string& help,
+			     const Labels& labels)
+	{
+	return static_cast<Counter*>(Lookup(name, help, Metric::COUNTER, labels,
+					     std::vector<double>()));
+	}
+
+Gauge* Manager::GetGauge(const std::string& name, const std::string& help,
+			 const Labels& labels)
+	{
+	return static_cast<Gauge*>(Lookup(name, help, Metric::GAUGE, labels,
+					   std::vector<double>()));
+	}
+
+Histogram* Manager::GetHistogram(const std::string& name, const std::string& help,
+				 const std::vector<double>& bounds,
+				 const Labels& labels)
+	{
+	return static_cast<Histogram*>(Lookup(name, help, Metric::HISTOGRAM,
+					       labels, bounds));
+	}
+
+void Manager::AddCollector(Collector c)
+	{
+	collectors.push_back(c);
+	}
+
+void Manager::Update(bool force)
+	{
+	if ( ! force )
+		{
+		// Only worth it if somebody may be looking. Network time is
+		// good enough as a clock here and comes for free.
+		if ( ! server || network_time - last_update < update_interval )
+			return;
+		}
+
+	last_update = network_time;
+
+	for ( const auto& c : collectors )
+		c();
+	}
+
+std::string Manager::Expose()
+	{
+	std::string out;
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for ( const auto& f : families )
+		{
+		if ( f.second.metrics.empty() )
+			continue;
+
+		out += "# HELP " + f.first + " " + f.second.help + "\n";
+		out += "# TYPE " + f.first + " " + Metric::TypeName(f.second.type) + "\n";
+
+		for ( auto m : f.second.metrics )
+			m->Expose(f.first, &out);
+		}
+
+	return out;
+	}
+
+std::string Manager::ExposeAll()
+	{
+	Update(true);
+	return Expose();
+	}
+
+void Manager::RegisterCoreMetrics()
+	{
+	Counter* pkts_recvd = GetCounter("zeek_packets_received_total",
+		"Packets received by all packet sources.");
+	Counter* pkts_dropped = GetCounter("zeek_packets_dropped_total",
+		"Packets dropped by all packet sources.");
+	Counter* pkts_link = GetCounter("zeek_packets_link_total",
+		"Packets seen on the link by all packet sources, if known.");
+	Counter* bytes_recvd = GetCounter("zeek_bytes_received_total",
+		"Bytes received by all packet sources.");
+
+	AddCollector([=]
+		{
+		uint64 recv = 0;
+		uint64 drop = 0;
+		uint64 link = 0;
+		uint64 bytes = 0;
+
+		for ( auto ps : iosource_mgr->GetPktSrcs() )
+			{
+			struct iosource::PktSrc::Stats stat;
+			ps->Statistics(&stat);
+			recv += stat.received;
+			drop += stat.dropped;
+			link += stat.link;
+			bytes += stat.bytes_received;
+			}
+
+		pkts_recvd->Set(recv);
+		pkts_dropped->Set(drop);
+		pkts_link->Set(link);
+		bytes_recvd->Set(bytes);
+		});
+
+	static const char* protocols[] = { "tcp", "udp", "icmp" };
+	Gauge* conns[3];
+	Counter* conns_total[3];
+
+	for ( int i = 0; i < 3; ++i )
+		{
+		Labels l = { { "protocol", protocols[i] } };
+		conns[i] = GetGauge("zeek_connections_active",
+			"Connections currently in memory.", l);
+		conns_total[i] = GetCounter("zeek_connections_total",
+			"Connections seen.", l);
+		}
+
+	Gauge* frags = GetGauge("zeek_fragments_active",
+		"IP fragments currently waiting for reassembly.");
+
+	AddCollector([=]
+		{
+		if ( ! sessions )
+			return;
+
+		SessionStats s;
+		sessions->GetStats(s);
+
+		conns[0]->Set(s.num_TCP_conns);
+		conns[1]->Set(s.num_UDP_conns);
+		conns[2]->Set(s.num_ICMP_conns);
+		conns_total[0]->Set(s.cumulative_TCP_conns);
+		conns_total[1]->Set(s.cumulative_UDP_conns);
+		conns_total[2]->Set(s.cumulative_ICMP_conns);
+		frags->Set(s.num_fragments);
+		});
+
+	Counter* events_queued = GetCounter("zeek_events_queued_total",
+		"Events queued.");
+	Counter* events_dispatched = GetCounter("zeek_events_dispatched_total",
+		"Events dispatched.");
+	Gauge* timers = GetGauge("zeek_timers_pending",
+		"Timers currently pending.");
+	Counter* timers_total = GetCounter("zeek_timers_total",
+		"Timers scheduled.");
+	Gauge* threads = GetGauge("zeek_threads",
+		"Threads the thread manager currently runs.");
+
+	AddCollector([=]
+		{
+		events_queued->Set(num_events_queued);
+		events_dispatched->Set(num_events_dispatched);
+		timers->Set(timer_mgr->Size());
+		timers_total->Set(timer_mgr->CumulativeNum());
+		threads->Set(thread_mgr->NumThreads());
+		});
+
+	Gauge* memory = GetGauge("zeek_memory_max_resident_bytes",
+		"Peak resident memory of the process.");
+
+	static const char* reassem_names[] = { "file", "frag", "tcp", "unknown" };
+	static const ReassemblerType reassem_types[] = {
+		REASSEM_FILE, REASSEM_FRAG, REASSEM_TCP, REASSEM_UNKNOWN };
+	Gauge* reassem[4];
+
+	for ( int i = 0; i < 4; ++i )
+		reassem[i] = GetGauge("zeek_reassembler_bytes",
+			"Memory buffered by reassemblers.",
+			{ { "type", reassem_names[i] } });
+
+	AddCollector([=]
+		{
+		uint64 total;
+		get_memory_usage(&total, 0);
+		memory->Set(total);
+
+		for ( int i = 0; i < 4; ++i )
+			reassem[i]->Set(Reassembler::MemoryAllocation(reassem_types[i]));
+		});
+	}
+
+void Manager::RegisterMemoryMetrics()
+	{
+	Gauge* thread_msgs[2] = {
+		GetGauge("zeek_thread_messages_pending",
+			"Messages waiting in the queues between threads.",
+			{ { "direction", "in" } }),
+		GetGauge("zeek_thread_messages_pending",
+			"Messages waiting in the queues between threads.",
+			{ { "direction", "out" } }),
+	};
+
+	Gauge* broker_events = GetGauge("zeek_broker_events_buffered",
+		"Events batched for sending to peers.");
+
+	// Metrics for analyzers and globals come and go. Those no longer
+	// around drop to zero rather than disappearing.
+	auto analyzers = std::make_shared<std::map<std::string, Gauge*> >();
+	auto globals = std::make_shared<std::map<std::string, std::pair<Gauge*, Gauge*> > >();
+
+	AddCollector([=]
+		{
+		subsystem_memory_list usage;
+		get_subsystem_memory(&usage);
+
+		for ( const auto& u : usage )
+			GetGauge("zeek_memory_subsystem_bytes",
+				"Estimated memory used by subsystems.",
+				{ { "subsystem", u.first } })->Set(u.second);
+
+		uint64 in = 0;
+		uint64 out = 0;
+
+		for ( const auto& t : thread_mgr->GetMsgThreadStats() )
+			{
+			in += t.second.pending_in;
+			out += t.second.pending_out;
+			}
+
+		thread_msgs[0]->Set(in);
+		thread_msgs[1]->Set(out);
+
+		size_t log_bytes = 0;
+		size_t events = 0;
+
+		if ( broker_mgr )
+			broker_mgr->GetBufferedSizes(&log_bytes, &events);
+
+		broker_events->Set(events);
+
+		for ( auto& kv : *analyzers )
+			kv.second->Set(0);
+
+		for ( const auto& kv : analyzer_mgr->GetAllUsageStats() )
+			{
+			if ( ! kv.second.live )
+				continue;
+
+			std::string name = analyzer_mgr->GetComponentName(kv.first);
+			Gauge*& g = (*analyzers)[name];
+
+			if ( ! g )
+				g = GetGauge("zeek_analyzers_live",
+					"Analyzer instances currently in existence.",
+					{ { "analyzer", name } });
+
+			g->Set(kv.second.live);
+			}
+
+		for ( auto& kv : *globals )
+			{
+			kv.second.first->Set(0);
+			kv.second.second->Set(0);
+			}
+
+		std::vector<GlobalMemoryUsage> global_usage;
+		get_global_memory(&global_usage);
+
+		for ( const auto& u : global_usage )
+			{
+			if ( ! u.entries )
+				continue;
+
+			auto& g = (*globals)[u.id->Name()];
+
+			if ( ! g.first )
+				{
+				Labels l = { { "id", u.id->Name() } };
+				g.first = GetGauge("zeek_global_entries",
+					"Elements of global tables, sets and vectors.", l);
+				g.second = GetGauge("zeek_global_bytes",
+					"Estimated memory of global tables, sets and vectors.", l);
+				}
+
+			g.first->Set(u.entries);
+			g.second->Set(u.bytes);
+			}
+		});
+	}
+
+void Manager::RegisterLatencies()
+	{
+	// From a microsecond to a bit over a minute, in steps of a factor
+	// of two.
+	auto bounds = Histogram::ExponentialBounds(1e-6, 2, 27);
+
+	latencies.packet_lag = GetHistogram("zeek_packet_lag_seconds",
+		"Time from capturing packets to processing them.", bounds);
+	latencies.event_wait = GetHistogram("zeek_event_queue_wait_seconds",
+		"Time events wait in the queue for dispatch.", bounds);
+	latencies.log_buffer_wait = GetHistogram("zeek_log_buffer_wait_seconds",
+		"Time log records wait in buffers before going to the writer threads.",
+		bounds);
+	latencies.log_write = GetHistogram("zeek_log_write_latency_seconds",
+		"Time from logging records to the writers having written them.",
+		bounds);
+	}
@@ -0,0 +1,147 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef METRICS_MANAGER_H
+#define METRICS_MANAGER_H
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Metric.h"
+
+namespace metrics {
+
+class Server;
+
+/**
+ * The registry of the metrics that Zeek's subsystems maintain about
+ * themselves. Subsystems either update their metrics directly, from any
+ * thread, or register a collector that copies their internal statistics
+ * into metrics periodically on the main thread. An HTTP endpoint running
+ * on a thread of its own exposes the metrics in the Prometheus text
+ * format, so that scraping them never involves the main loop.
+ *
+ * Metrics live until the manager gets destroyed.
+ */
+class Manager {
+public:
+	typedef std::function<void ()> Collector;
+
+	Manager();
+	~Manager();
+
+	/**
+	 * Registers the core's own metrics and starts the HTTP endpoint if
+	 * configured.
+	 */
+	void InitPostScript();
+
+	/**
+	 * Stops the HTTP endpoint.
+	 */
+	void Terminate();
+
+	/**
+	 * Returns a counter, creating it on first use.
+	 *
+	 * @param name The name of the metric, which several metrics with
+	 * different labels may share. By convention, counter names end in
+	 * "_total".
+	 *
+	 * @param help A description of the metric. The first registration
+	 * of a name sets it.
+	 *
+	 * @param labels Labels distinguishing the metric from others of
+	 * the same name.
+	 */
+	Counter* GetCounter(const std::string& name, const std::string& help,
+			    const Labels& labels = Labels());
+
+	/**
+	 * Returns a gauge, creating it on first use. See GetCounter().
+	 */
+	Gauge* GetGauge(const std::string& name, const std::string& help,
+			const Labels& labels = Labels());
+
+	/**
+	 * Returns a histogram, creating it on first use. See GetCounter().
+	 *
+	 * @param bounds The upper bounds of the buckets. The first
+	 * registration of a name sets them for all metrics of the name.
+	 */
+	Histogram* GetHistogram(const std::string& name, const std::string& help,
+				const std::vector<double>& bounds,
+				const Labels& labels = Labels());
+
+	/**
+	 * Histograms of the latencies along the way from packets to logs,
+	 * in seconds. They are null unless latency_stats is set.
+	 */
+	struct Latencies {
+		Histogram* packet_lag = 0;	// capture to processing, live only
+		Histogram* event_wait = 0;	// queueing to dispatch of events
+		Histogram* log_buffer_wait = 0;	// log records in frontend buffers
+		Histogram* log_write = 0;	// log records until written out
+	};
+
+	const Latencies& GetLatencies() const	{ return latencies; }
+
+	/**
+	 * Registers a function that updates metrics from statistics that
+	 * can only be accessed on the main thread. Collectors run every
+	 * metrics_update_interval, and before the metrics get exposed
+	 * through ExposeAll().
+	 */
+	void AddCollector(Collector c);
+
+	/**
+	 * Runs the collectors if they're due. Called from the main loop.
+	 *
+	 * @param force If true, runs them even if they're not due yet.
+	 */
+	void Update(bool force = false);
+
+	/**
+	 * Returns all metrics in the Prometheus text format. Can be called
+	 * from any thread. Doesn't run the collectors, so that values
+	 * mirrored from them may be up to metrics_update_interval old.
+	 */
+	std::string Expose();
+
+	/**
+	 * Like Expose() but runs the collectors first. Main thread only.
+	 */
+	std::string ExposeAll();
+
+private:
+	struct Family {
+		Metric::Type type;
+		std::string help;
+		std::vector<double> bounds;	// for histograms
+		std::vector<Metric*> metrics;
+	};
+
+	Metric* Lookup(const std::string& name, const std::string& help,
+		       Metric::Type type, const Labels& labels,
+		       const std::vector<double>& bounds);
+
+	void RegisterCoreMetrics();
+	void RegisterMemoryMetrics();
+	void RegisterLatencies();
+
+	std::mutex mutex;	// protects the families, not the values
+	std::map<std::string, Family> families;
+	std::vector<Collector> collectors;
+	double update_interval;
+	double last_update;
+	Latencies latencies;
+	Server* server;
+};
+
+}
+
+extern metrics::Manager* metrics_mgr;
+
+#endif
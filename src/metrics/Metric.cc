@@ -0,0 +1,312 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "Metric.h"
+
+using namespace metrics;
+
+int metrics::thread_shard()
+	{
+	static std::atomic<int> next_shard(0);
+	static thread_local int shard = -1;
+
+	if ( shard < 0 )
+		shard = next_shard.fetch_add(1, std::memory_order_relaxed) % NUM_SHARDS;
+
+	return shard;
+	}
+
+// Escapes a label value as the text format requires.
+static void append_label_value(const std::string& v, std::string* out)
+	{
+	for ( auto c : v )
+		{
+		switch ( c ) {
+		case '\\':
+			*out += "\\\\";
+			break;
+
+		case '"':
+			*out += "\\\"";
+			break;
+
+		case '\n':
+			*out += "\\n";
+			break;
+
+		default:
+			*out += c;
+		}
+		}
+	}
+
+Metric::Metric(Type arg_type, const Labels& arg_labels)
+	{
+	type = arg_type;
+	labels = arg_labels;
+	}
+
+Metric::~Metric()
+	{
+	}
+
+const char* Metric::TypeName(Type type)
+	{
+	switch ( type ) {
+	case COUNTER:
+		return "counter";
+
+	case GAUGE:
+		return "gauge";
+
+	case HISTOGRAM:
+		return "histogram";
+	}
+
+	return "untyped";
+	}
+
+void Metric::ExposeSample(const std::string& name, const std::string& value,
+			  std::string* out, const char* extra_label,
+			  const std::string& extra_value) const
+	{
+	*out += name;
+
+	if ( labels.size() || extra_label )
+		{
+		*out += '{';
+		bool first = true;
+
+		for ( const auto& l : labels )
+			{
+			if ( ! first )
+				*out += ',';
+
+			*out += l.first;
+			*out += "=\"";
+			append_label_value(l.second, out);
+			*out += '"';
+			first = false;
+			}
+
+		if ( extra_label )
+			{
+			if ( ! first )
+				*out += ',';
+
+			*out += extra_label;
+			*out += "=\"";
+			append_label_value(extra_value, out);
+			*out += '"';
+			}
+
+		*out += '}';
+		}
+
+	*out += ' ';
+	*out += value;
+	*out += '\n';
+	}
+
+std::string Metric::FormatValue(double v)
+	{
+	if ( isnan(v) )
+		return "NaN";
+
+	if ( isinf(v) )
+		return v > 0 ? "+Inf" : "-Inf";
+
+	char buf[64];
+
+	if ( v == floor(v) && fabs(v) < 1e15 )
+		snprintf(buf, sizeof(buf), "%.0f", v);
+
+	else
+		{
+		// The shortest of the two that reads back the same.
+		snprintf(buf, sizeof(buf), "%.15g", v);
+
+		if ( strtod(buf, 0) != v )
+			snprintf(buf, sizeof(buf), "%.17g", v);
+		}
+
+	return buf;
+	}
+
+std::string Metric::FormatValue(uint64 v)
+	{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%" PRIu64, v);
+	return buf;
+	}
+
+Counter::Counter(const Labels& labels)
+	: Metric(COUNTER, labels)
+	{
+	for ( int i = 0; i < NUM_SHARDS; ++i )
+		shards[i].value = 0;
+	}
+
+void Counter::Set(uint64 n)
+	{
+	shards[0].value.store(n, std::memory_order_relaxed);
+
+	for ( int i = 1; i < NUM_SHARDS; ++i )
+		shards[i].value.store(0, std::memory_order_relaxed);
+	}
+
+uint64 Counter::Value() const
+	{
+	uint64 v = 0;
+
+	for ( int i = 0; i < NUM_SHARDS; ++i )
+		v += shards[i].value.load(std::memory_order_relaxed);
+
+	return v;
+	}
+
+void Counter::Expose(const std::string& name, std::string* out) const
+	{
+	ExposeSample(name, FormatValue(Value()), out);
+	}
+
+Gauge::Gauge(const Labels& labels)
+	: Metric(GAUGE, labels)
+	{
+	value = 0;
+	}
+
+void Gauge::Add(double v)
+	{
+	double old = value.load(std::memory_order_relaxed);
+
+	while ( ! value.compare_exchange_weak(old, old + v,
+					      std::memory_order_relaxed) )
+		;
+	}
+
+void Gauge::Expose(const std::string& name, std::string* out) const
+	{
+	ExposeSample(name, FormatValue(Value()), out);
+	}
+
+Histogram::Histogram(const std::vector<double>& arg_bounds, const Labels& labels)
+	: Metric(HISTOGRAM, labels)
+	{
+	bounds = arg_bounds;
+	std::sort(bounds.begin(), bounds.end());
+
+	// The counts of different shards are allocated separately. A
+	// cache line's worth of slack at the end keeps them from sharing
+	// one.
+	size_t n = bounds.size() + 1 + 64 / sizeof(std::atomic<uint64>);
+
+	for ( int i = 0; i < NUM_SHARDS; ++i )
+		{
+		shards[i].counts.reset(new std::atomic<uint64>[n]);
+
+		for ( size_t j = 0; j < n; ++j )
+			shards[i].counts[j] = 0;
+
+		shards[i].sum = 0;
+		}
+	}
+
+void Histogram::Observe(double v)
+	{
+	Shard& s = shards[thread_shard()];
+	size_t i = std::lower_bound(bounds.begin(), bounds.end(), v) - bounds.begin();
+
+	s.counts[i].fetch_add(1, std::memory_order_relaxed);
+
+	double old = s.sum.load(std::memory_order_relaxed);
+
+	while ( ! s.sum.compare_exchange_weak(old, old + v,
+					      std::memory_order_relaxed) )
+		;
+	}
+
+std::vector<uint64> Histogram::Counts() const
+	{
+	std::vector<uint64> counts(bounds.size() + 1);
+
+	for ( int i = 0; i < NUM_SHARDS; ++i )
+		for ( size_t j = 0; j < counts.size(); ++j )
+			counts[j] += shards[i].counts[j].load(std::memory_order_relaxed);
+
+	return counts;
+	}
+
+double Histogram::Sum() const
+	{
+	double sum = 0;
+
+	for ( int i = 0; i < NUM_SHARDS; ++i )
+		sum += shards[i].sum.load(std::memory_order_relaxed);
+
+	return sum;
+	}
+
+double Histogram::Quantile(double q) const
+	{
+	std::vector<uint64> counts = Counts();
+	uint64 total = 0;
+
+	for ( auto c : counts )
+		total += c;
+
+	if ( ! total )
+		return 0;
+
+	double rank = q * total;
+	double lower = 0;
+	uint64 seen = 0;
+
+	for ( size_t i = 0; i < bounds.size(); ++i )
+		{
+		if ( counts[i] && seen + counts[i] >= rank )
+			return lower + (bounds[i] - lower) * (rank - seen) / counts[i];
+
+		seen += counts[i];
+		lower = bounds[i];
+		}
+
+	return lower;
+	}
+
+std::vector<double> Histogram::ExponentialBounds(double start, double factor,
+						 int count)
+	{
+	std::vector<double> bounds;
+	double b = start;
+
+	for ( int i = 0; i < count; ++i )
+		{
+		bounds.push_back(b);
+		b *= factor;
+		}
+
+	return bounds;
+	}
+
+void Histogram::Expose(const std::string& name, std::string* out) const
+	{
+	std::vector<uint64> counts = Counts();
+	uint64 total = 0;
+
+	for ( size_t i = 0; i < counts.size(); ++i )
+		{
+		total += counts[i];
+		std::string le = i < bounds.size() ? FormatValue(bounds[i]) : "+Inf";
+		ExposeSample(name + "_bucket", FormatValue(total), out, "le", le);
+		}
+
+	ExposeSample(name + "_sum", FormatValue(Sum()), out);
+	ExposeSample(name + "_count", FormatValue(total), out);
+	}
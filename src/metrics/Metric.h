@@ -0,0 +1,217 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef METRICS_METRIC_H
+#define METRICS_METRIC_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "util.h"
+
+namespace metrics {
+
+/**
+ * Name/value pairs distinguishing metrics of the same name.
+ */
+typedef std::vector<std::pair<std::string, std::string> > Labels;
+
+/**
+ * Number of shards that counters and histograms spread their updates
+ * over. Each thread updates the shard it got assigned, so that threads
+ * don't compete for the same cache lines.
+ */
+static const int NUM_SHARDS = 16;
+
+/**
+ * Returns the shard the calling thread updates.
+ */
+int thread_shard();
+
+/**
+ * Base class for the metrics of a registry. All updates and reads are
+ * lock-free and may happen from any thread.
+ */
+class Metric {
+public:
+	enum Type { COUNTER, GAUGE, HISTOGRAM };
+
+	Metric(Type type, const Labels& labels);
+	virtual ~Metric();
+
+	Type GetType() const	{ return type; }
+	const Labels& GetLabels() const	{ return labels; }
+
+	/**
+	 * Appends the metric's samples in the Prometheus text format.
+	 *
+	 * @param name The name of the metric.
+	 *
+	 * @param out The string to append to.
+	 */
+	virtual void Expose(const std::string& name, std::string* out) const = 0;
+
+	/**
+	 * Returns a metric type's name in the Prometheus text format.
+	 */
+	static const char* TypeName(Type type);
+
+protected:
+	// Appends a single sample, with an extra label if given.
+	void ExposeSample(const std::string& name, const std::string& value,
+			  std::string* out, const char* extra_label = 0,
+			  const std::string& extra_value = "") const;
+
+	// Formats a value for the text format.
+	static std::string FormatValue(double v);
+	static std::string FormatValue(uint64 v);
+
+private:
+	Type type;
+	Labels labels;
+};
+
+/**
+ * A value that only ever grows, like the number of packets seen.
+ */
+class Counter : public Metric {
+public:
+	explicit Counter(const Labels& labels);
+
+	/**
+	 * Increments the counter.
+	 */
+	void Inc(uint64 n = 1)
+		{ shards[thread_shard()].value.fetch_add(n, std::memory_order_relaxed); }
+
+	/**
+	 * Sets the counter, for counters that mirror a total maintained
+	 * elsewhere. Such counters must be set from a single thread only,
+	 * and must not be incremented.
+	 */
+	void Set(uint64 n);
+
+	/**
+	 * Returns the current value.
+	 */
+	uint64 Value() const;
+
+	void Expose(const std::string& name, std::string* out) const override;
+
+private:
+	// Padded to keep each shard in cache lines of its own.
+	struct Shard {
+		std::atomic<uint64> value;
+		char padding[64 - sizeof(std::atomic<uint64>)];
+	};
+
+	Shard shards[NUM_SHARDS];
+};
+
+/**
+ * A value that can go up and down, like the number of connections.
+ */
+class Gauge : public Metric {
+public:
+	explicit Gauge(const Labels& labels);
+
+	/**
+	 * Sets the value.
+	 */
+	void Set(double v)	{ value.store(v, std::memory_order_relaxed); }
+
+	/**
+	 * Adds to the value, which may be negative.
+	 */
+	void Add(double v);
+
+	/**
+	 * Returns the current value.
+	 */
+	double Value() const	{ return value.load(std::memory_order_relaxed); }
+
+	void Expose(const std::string& name, std::string* out) const override;
+
+private:
+	std::atomic<double> value;
+};
+
+/**
+ * Counts observations, like processing times, in buckets of values.
+ */
+class Histogram : public Metric {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param bounds The inclusive upper bounds of the buckets, in
+	 * increasing order. A final bucket without bound is added
+	 * implicitly.
+	 *
+	 * @param labels The metric's labels.
+	 */
+	Histogram(const std::vector<double>& bounds, const Labels& labels);
+
+	/**
+	 * Records an observation.
+	 */
+	void Observe(double v);
+
+	const std::vector<double>& Bounds() const	{ return bounds; }
+
+	/**
+	 * Returns the number of observations in each bucket, with the one
+	 * without bound last. Unlike in the text format, these are not
+	 * cumulative.
+	 */
+	std::vector<uint64> Counts() const;
+
+	/**
+	 * Returns the sum of all observations.
+	 */
+	double Sum() const;
+
+	/**
+	 * Estimates a quantile of the observations, interpolating within
+	 * the bucket it falls into. Observations in the final bucket count
+	 * as the largest bound.
+	 *
+	 * @param q The quantile, between 0 and 1.
+	 *
+	 * @return The estimate, or zero if there are no observations.
+	 */
+	double Quantile(double q) const;
+
+	/**
+	 * Returns bounds growing by a constant factor, which keep the
+	 * relative error constant over a wide range of values.
+	 *
+	 * @param start The first bound.
+	 *
+	 * @param factor The factor between successive bounds.
+	 *
+	 * @param count The number of bounds.
+	 */
+	static std::vector<double> ExponentialBounds(double start, double factor,
+						     int count);
+
+	void Expose(const std::string& name, std::string* out) const override;
+
+private:
+	// Padded like the counter's, see Histogram() for the counts.
+	struct Shard {
+		std::unique_ptr<std::atomic<uint64>[]> counts;
+		std::atomic<double> sum;
+		char padding[64 - sizeof(std::unique_ptr<std::atomic<uint64>[]>) -
+			     sizeof(std::atomic<double>)];
+	};
+
+	std::vector<double> bounds;
+	Shard shards[NUM_SHARDS];
+};
+
+}
+
+#endif
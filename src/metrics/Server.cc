@@ -0,0 +1,293 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "Server.h"
+#include "threading/Manager.h"
+
+using namespace metrics;
+
+// How long a client may take to send its request and read the response,
+// in milliseconds.
+#define REQUEST_TIMEOUT 5000
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0	// SO_NOSIGPIPE covers it where this is missing
+#endif
+
+// Largest request we read.
+#define MAX_REQUEST_SIZE 8192
+
+Server::Server(std::function<std::string ()> arg_expose)
+	{
+	expose = arg_expose;
+	listen_fd = -1;
+	wakeup[0] = wakeup[1] = -1;
+	}
+
+Server::~Server()
+	{
+	Stop();
+	}
+
+bool Server::Start(const std::string& addr, uint16_t port)
+	{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST | AI_NUMERICSERV;
+
+	struct addrinfo* res;
+	std::string service = std::to_string(port);
+	int rc = getaddrinfo(addr.empty() ? 0 : addr.c_str(), service.c_str(),
+			     &hints, &res);
+
+	if ( rc != 0 )
+		{
+		error = std::string("invalid address ") + addr + ": " + gai_strerror(rc);
+		return false;
+		}
+
+	listen_fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+
+	if ( listen_fd < 0 )
+		{
+		error = std::string("can't create socket: ") + strerror(errno);
+		freeaddrinfo(res);
+		return false;
+		}
+
+	int on = 1;
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	fcntl(listen_fd, F_SETFD, FD_CLOEXEC);
+
+	if ( bind(listen_fd, res->ai_addr, res->ai_addrlen) < 0 ||
+	     listen(listen_fd, 16) < 0 )
+		{
+		error = std::string("can't listen on ") + addr + ":" + service +
+			": " + strerror(errno);
+		freeaddrinfo(res);
+		close(listen_fd);
+		listen_fd = -1;
+		return false;
+		}
+
+	freeaddrinfo(res);
+
+	if ( pipe(wakeup) < 0 )
+		{
+		error = std::string("can't create pipe: ") + strerror(errno);
+		close(listen_fd);
+		listen_fd = -1;
+		return false;
+		}
+
+	thread = std::thread(&Server::Run, this);
+	thread_mgr->PlaceThread(thread);
+	return true;
+	}
+
+void Server::Stop()
+	{
+	if ( thread.joinable() )
+		{
+		char c = 0;
+
+		while ( write(wakeup[1], &c, 1) < 0 && errno == EINTR )
+			;
+
+		thread.join();
+		}
+
+	if ( listen_fd >= 0 )
+		{
+		close(listen_fd);
+		listen_fd = -1;
+		}
+
+	for ( int i = 0; i < 2; ++i )
+		{
+		if ( wakeup[i] >= 0 )
+			{
+			close(wakeup[i]);
+			wakeup[i] = -1;
+			}
+		}
+	}
+
+void Server::Run()
+	{
+	// Signals are for the main thread, and we want to see EPIPE from
+	// clients going away.
+	sigset_t set;
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, 0);
+
+	while ( true )
+		{
+		struct pollfd fds[2];
+		fds[0].fd = listen_fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = wakeup[0];
+		fds[1].events = POLLIN;
+
+		if ( poll(fds, 2, -1) < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			return;
+			}
+
+		if ( fds[1].revents )
+			return;
+
+		if ( ! (fds[0].revents & POLLIN) )
+			continue;
+
+		int fd = accept(listen_fd, 0, 0);
+
+		if ( fd < 0 )
+			continue;
+
+		Serve(fd);
+		close(fd);
+		}
+	}
+
+bool Server::WaitFor(int fd, short events,
+		     std::chrono::steady_clock::time_point deadline)
+	{
+	while ( true )
+		{
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+			deadline - std::chrono::steady_clock::now()).count();
+
+		if ( left <= 0 )
+			return false;
+
+		struct pollfd fds[2];
+		fds[0].fd = fd;
+		fds[0].events = events;
+		fds[1].fd = wakeup[0];
+		fds[1].events = POLLIN;
+
+		int rc = poll(fds, 2, left);
+
+		if ( rc < 0 && errno == EINTR )
+			continue;
+
+		if ( rc < 0 || fds[1].revents )
+			return false;
+
+		if ( rc > 0 )
+			return true;
+		}
+	}
+
+void Server::Serve(int fd)
+	{
+	// A client that stops reading must not hold up the thread any more
+	// than one that doesn't send its request.
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	if ( flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0 )
+		return;
+
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+	auto deadline = std::chrono::steady_clock::now() +
+		std::chrono::milliseconds(REQUEST_TIMEOUT);
+
+	std::string request;
+
+	while ( request.find("\r\n\r\n") == std::string::npos &&
+		request.find("\n\n") == std::string::npos )
+		{
+		if ( request.size() > MAX_REQUEST_SIZE )
+			return;
+
+		char buf[1024];
+		ssize_t n = recv(fd, buf, sizeof(buf), 0);
+
+		if ( n < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			if ( (errno == EAGAIN || errno == EWOULDBLOCK) &&
+			     WaitFor(fd, POLLIN, deadline) )
+				continue;
+
+			return;
+			}
+
+		if ( n == 0 )
+			return;
+
+		request.append(buf, n);
+		}
+
+	std::string::size_type end = request.find_first_of("\r\n");
+	std::string line = request.substr(0, end);
+	std::string status;
+	std::string body;
+
+	if ( line.compare(0, 4, "GET ") != 0 )
+		status = "405 Method Not Allowed";
+
+	else
+		{
+		std::string path = line.substr(4, line.find(' ', 4) - 4);
+		std::string::size_type query = path.find('?');
+
+		if ( query != std::string::npos )
+			path.erase(query);
+
+		if ( path == "/metrics" || path == "/" )
+			{
+			status = "200 OK";
+			body = expose();
+			}
+		else
+			status = "404 Not Found";
+		}
+
+	std::string response = "HTTP/1.0 " + status + "\r\n" +
+		"Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n" +
+		"Content-Length: " + std::to_string(body.size()) + "\r\n" +
+		"Connection: close\r\n\r\n" + body;
+
+	for ( size_t written = 0; written < response.size(); )
+		{
+		ssize_t n = send(fd, response.data() + written,
+				 response.size() - written, MSG_NOSIGNAL);
+
+		if ( n < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			if ( (errno == EAGAIN || errno == EWOULDBLOCK) &&
+			     WaitFor(fd, POLLOUT, deadline) )
+				continue;
+
+			return;
+			}
+
+		written += n;
+		}
+	}
@@ -0,0 +1,75 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace metrics {
+
+/**
+ * A minimal HTTP server answering scrapes of the metrics on a thread of its
+ * own. It handles one request per connection and one connection at a time,
+ * which is all that scrapers need.
+ */
+class Server {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param expose Produces the body of a response. It's called on the
+	 * server's thread.
+	 */
+	explicit Server(std::function<std::string ()> expose);
+
+	/**
+	 * Destructor. Stops the server.
+	 */
+	~Server();
+
+	/**
+	 * Starts listening and serving requests.
+	 *
+	 * @param addr The address to bind to.
+	 *
+	 * @param port The TCP port to listen on.
+	 *
+	 * @return False if the socket couldn't be set up, with Error()
+	 * describing why.
+	 */
+	bool Start(const std::string& addr, uint16_t port);
+
+	/**
+	 * Stops serving requests. Waits for a request in progress to
+	 * finish.
+	 */
+	void Stop();
+
+	/**
+	 * Returns a description of the last error.
+	 */
+	const std::string& Error() const	{ return error; }
+
+private:
+	void Run();
+	void Serve(int fd);
+
+	// Polls fd for the events until the deadline. Returns false if
+	// it passes, or if the server is stopping.
+	bool WaitFor(int fd, short events,
+		     std::chrono::steady_clock::time_point deadline);
+
+	std::function<std::string ()> expose;
+	int listen_fd;
+	int wakeup[2];	// pipe to interrupt the thread's poll()
+	std::string error;
+	std::thread thread;
+};
+
+}
+
+#endif
@@ -0,0 +1,944 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Benchmarks of the data structures on Zeek's per-packet and per-event
+// paths. Keys follow what the structures see in practice: connection
+// tuples with many clients talking to few servers, and DNS-like names.
+
+#include "zeek-config.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Base64.h"
+#include "BroString.h"
+#include "CompHash.h"
+#include "Conn.h"
+#include "Desc.h"
+#include "Dict.h"
+#include "IPAddr.h"
+#include "PrefixTable.h"
+#include "PriorityQueue.h"
+#include "Type.h"
+#include "Val.h"
+#include "modp_numtoa.h"
+
+extern "C" {
+#include "cq.h"
+}
+
+#include "Microbench.h"
+
+using namespace microbench;
+
+namespace {
+
+// Fixed, so that runs are comparable.
+#define SEED 4711
+
+// Entries in the data structures that benchmarks operate on in a steady
+// state, roughly a busy sensor's connection table.
+#define STEADY_SIZE 100000
+
+std::mt19937_64 rng(SEED);
+
+// Connection tuples of 10.0.0.0/16 clients with ephemeral ports talking to
+// a few hundred servers on common ports, some more popular than others.
+std::vector<ConnID> ipv4_conns(int n)
+	{
+	static const uint32 ports[] = { 80, 443, 53, 22, 25, 123, 445, 8080 };
+	std::uniform_int_distribution<uint32> client(0, 0xffff);
+	std::uniform_int_distribution<uint32> eph_port(32768, 60999);
+	std::geometric_distribution<uint32> server(0.02);
+	std::geometric_distribution<uint32> port(0.4);
+
+	std::vector<ConnID> ids(n);
+
+	for ( int i = 0; i < n; ++i )
+		{
+		uint32 src = htonl((10 << 24) | client(rng));
+		uint32 dst = htonl((192 << 24) | (168 << 16) | (server(rng) & 0xffff));
+
+		ids[i].src_addr = IPAddr(IPv4, &src, IPAddr::Network);
+		ids[i].dst_addr = IPAddr(IPv4, &dst, IPAddr::Network);
+		ids[i].src_port = htons(eph_port(rng));
+		ids[i].dst_port = htons(ports[port(rng) % 8]);
+		ids[i].is_one_way = false;
+		}
+
+	return ids;
+	}
+
+// Like ipv4_conns(), in 2001:db8::/32.
+std::vector<ConnID> ipv6_conns(int n)
+	{
+	std::uniform_int_distribution<uint32> word;
+	std::geometric_distribution<uint32> server(0.02);
+
+	std::vector<ConnID> ids = ipv4_conns(n);
+
+	for ( auto& id : ids )
+		{
+		uint32 src[4] = { htonl(0x20010db8), word(rng), word(rng), word(rng) };
+		uint32 dst[4] = { htonl(0x20010db8), 0, 0, htonl(server(rng)) };
+
+		id.src_addr = IPAddr(IPv6, src, IPAddr::Network);
+		id.dst_addr = IPAddr(IPv6, dst, IPAddr::Network);
+		}
+
+	return ids;
+	}
+
+// Host names of varying lengths below a handful of zones.
+std::vector<std::string> dns_names(int n)
+	{
+	static const char* zones[] = {
+		"example.com", "example.net", "in-addr.arpa", "cdn.example.org",
+	};
+
+	std::uniform_int_distribution<int> len(3, 24);
+	std::uniform_int_distribution<int> letter('a', 'z');
+	std::uniform_int_distribution<int> zone(0, 3);
+
+	std::vector<std::string> names(n);
+
+	for ( auto& name : names )
+		{
+		int l = len(rng);
+
+		for ( int i = 0; i < l; ++i )
+			name += char(letter(rng));
+
+		name += ".";
+		name += zones[zone(rng)];
+		}
+
+	return names;
+	}
+
+std::vector<ConnIDKey> conn_keys(const std::vector<ConnID>& ids)
+	{
+	std::vector<ConnIDKey> keys(ids.size());
+
+	for ( size_t i = 0; i < ids.size(); ++i )
+		BuildConnIDKey(ids[i], &keys[i]);
+
+	return keys;
+	}
+
+// Dictionary
+
+class DictBenchmark : public Benchmark {
+public:
+	DictBenchmark(const char* name, bool arg_ipv6)
+		: Benchmark(name)	{ ipv6 = arg_ipv6; }
+
+protected:
+	void Fill(Dictionary* d, int n)
+		{
+		for ( int i = 0; i < n; ++i )
+			d->Insert(&keys[i], sizeof(ConnIDKey), hashes[i],
+				  &keys[i], 1);
+		}
+
+	void MakeKeys(int n)
+		{
+		keys = conn_keys(ipv6 ? ipv6_conns(n) : ipv4_conns(n));
+		hashes.resize(n);
+
+		for ( int i = 0; i < n; ++i )
+			hashes[i] = HashKey::HashBytes(&keys[i], sizeof(ConnIDKey));
+		}
+
+	bool ipv6;
+	std::vector<ConnIDKey> keys;
+	std::vector<hash_t> hashes;
+};
+
+// Inserting into a growing table, including the resizes.
+class DictInsert : public DictBenchmark {
+public:
+	DictInsert(const char* name, bool ipv6) : DictBenchmark(name, ipv6)	{ }
+
+	void Setup(uint64 n) override
+		{
+		MakeKeys(n);
+		d = new Dictionary;
+		}
+
+	void Run(uint64 n) override	{ Fill(d, n); }
+
+	void TearDown() override	{ delete d; }
+
+private:
+	Dictionary* d;
+};
+
+DictInsert dict_insert_v4("dict/insert/conn-v4", false);
+DictInsert dict_insert_v6("dict/insert/conn-v6", true);
+
+// Looking up keys that are mostly present, as for packets of existing
+// connections, in a table of steady size.
+class DictLookup : public DictBenchmark {
+public:
+	DictLookup(const char* name, bool ipv6) : DictBenchmark(name, ipv6)
+		{ d = 0; }
+
+	void Setup(uint64 n) override
+		{
+		if ( d )
+			return;
+
+		MakeKeys(STEADY_SIZE + STEADY_SIZE / 10);
+		d = new Dictionary;
+		Fill(d, STEADY_SIZE);
+		}
+
+	void Run(uint64 n) override
+		{
+		// One in eleven keys is one the table doesn't have.
+		int num_keys = keys.size();
+		int i = 0;
+
+		for ( uint64 j = 0; j < n; ++j )
+			{
+			keep(d->Lookup(&keys[i], sizeof(ConnIDKey), hashes[i]));
+
+			if ( ++i == num_keys )
+				i = 0;
+			}
+		}
+
+private:
+	Dictionary* d;
+};
+
+DictLookup dict_lookup_v4("dict/lookup/conn-v4", false);
+DictLookup dict_lookup_v6("dict/lookup/conn-v6", true);
+
+// Removing every entry of a table.
+class DictRemove : public DictBenchmark {
+public:
+	DictRemove() : DictBenchmark("dict/remove/conn-v4", false)	{ }
+
+	void Setup(uint64 n) override
+		{
+		MakeKeys(n);
+		d = new Dictionary;
+		Fill(d, n);
+		}
+
+	void Run(uint64 n) override
+		{
+		for ( uint64 i = 0; i < n; ++i )
+			keep(d->Remove(&keys[i], sizeof(ConnIDKey), hashes[i]));
+		}
+
+	void TearDown() override	{ delete d; }
+
+private:
+	Dictionary* d;
+};
+
+DictRemove dict_remove;
+
+// Iterating over a table of steady size, per entry.
+class DictIterate : public DictBenchmark {
+public:
+	DictIterate() : DictBenchmark("dict/iterate/conn-v4", false)
+		{ d = 0; }
+
+	void Setup(uint64 n) override
+		{
+		if ( d )
+			return;
+
+		MakeKeys(STEADY_SIZE);
+		d = new Dictionary;
+		Fill(d, STEADY_SIZE);
+		}
+
+	void Run(uint64 n) override
+		{
+		IterCookie* c = d->InitForIteration();
+		HashKey* h;
+
+		for ( uint64 i = 0; i < n; ++i )
+			{
+			void* v = d->NextEntry(h, c, 0);
+
+			if ( ! v )
+				c = d->InitForIteration();
+
+			keep(v);
+			}
+
+		d->StopIteration(c);
+		}
+
+private:
+	Dictionary* d;
+};
+
+DictIterate dict_iterate;
+
+// Looking up names, hashing each, as for events and identifiers. The
+// keyed hash is what tables of names from traffic need; the fast one is
+// what the internal dictionaries use.
+class DictLookupName : public Benchmark {
+public:
+	DictLookupName(const char* name, HashPolicy arg_policy)
+		: Benchmark(name)	{ policy = arg_policy; d = 0; }
+
+	void Setup(uint64 n) override
+		{
+		if ( d )
+			return;
+
+		names = dns_names(STEADY_SIZE);
+		d = new Dictionary(UNORDERED, 0, policy);
+
+		for ( const auto& name : names )
+			{
+			HashKey k(name.c_str(), policy);
+			d->Insert(&k, (void*) name.c_str());
+			}
+		}
+
+	void Run(uint64 n) override
+		{
+		int num_names = names.size();
+		int i = 0;
+
+		for ( uint64 j = 0; j < n; ++j )
+			{
+			HashKey k(names[i].c_str(), policy);
+			keep(d->Lookup(&k));
+
+			if ( ++i == num_names )
+				i = 0;
+			}
+		}
+
+private:
+	HashPolicy policy;
+	Dictionary* d;
+	std::vector<std::string> names;
+};
+
+DictLookupName dict_lookup_name_keyed("dict/lookup/name-keyed", HASH_KEYED);
+DictLookupName dict_lookup_name_fast("dict/lookup/name-fast", HASH_FAST);
+
+// CompositeHash
+
+class HashBenchmark : public Benchmark {
+public:
+	explicit HashBenchmark(const char* name) : Benchmark(name)
+		{ hash = 0; }
+
+	void Run(uint64 n) override
+		{
+		int num_vals = vals.size();
+		int i = 0;
+
+		for ( uint64 j = 0; j < n; ++j )
+			{
+			delete hash->ComputeHash(vals[i], 1);
+
+			if ( ++i == num_vals )
+				i = 0;
+			}
+		}
+
+protected:
+	CompositeHash* hash;
+	std::vector<Val*> vals;
+};
+
+// The index of a table[addr, port, addr, port].
+class HashConnTuple : public HashBenchmark {
+public:
+	HashConnTuple() : HashBenchmark("comphash/conn-tuple")	{ }
+
+	void Setup(uint64 n) override
+		{
+		if ( hash )
+			return;
+
+		TypeList* t = new TypeList();
+		t->Append(base_type(TYPE_ADDR));
+		t->Append(base_type(TYPE_PORT));
+		t->Append(base_type(TYPE_ADDR));
+		t->Append(base_type(TYPE_PORT));
+		hash = new CompositeHash(t);
+		Unref(t);
+
+		for ( const auto& id : ipv4_conns(1000) )
+			{
+			ListVal* v = new ListVal(TYPE_ANY);
+			v->Append(new AddrVal(id.src_addr));
+			v->Append(val_mgr->GetPort(ntohs(id.src_port), TRANSPORT_TCP));
+			v->Append(new AddrVal(id.dst_addr));
+			v->Append(val_mgr->GetPort(ntohs(id.dst_port), TRANSPORT_TCP));
+			vals.push_back(v);
+			}
+		}
+};
+
+HashConnTuple hash_conn_tuple;
+
+// The index of a table[string], like a set of host names.
+class HashString : public HashBenchmark {
+public:
+	HashString() : HashBenchmark("comphash/string")	{ }
+
+	void Setup(uint64 n) override
+		{
+		if ( hash )
+			return;
+
+		TypeList* t = new TypeList();
+		t->Append(base_type(TYPE_STRING));
+		hash = new CompositeHash(t);
+		Unref(t);
+
+		for ( const auto& name : dns_names(1000) )
+			vals.push_back(new StringVal(name));
+		}
+};
+
+HashString hash_string;
+
+// The index of a table[conn_id]. A record is never a singleton index,
+// so its values come wrapped in a list.
+class HashConnID : public HashBenchmark {
+public:
+	HashConnID() : HashBenchmark("comphash/conn-id-record")	{ }
+
+	void Setup(uint64 n) override
+		{
+		if ( hash )
+			return;
+
+		static const char* fields[] = { "orig_h", "orig_p", "resp_h", "resp_p" };
+		static const TypeTag tags[] = { TYPE_ADDR, TYPE_PORT, TYPE_ADDR, TYPE_PORT };
+
+		type_decl_list* decls = new type_decl_list();
+
+		for ( int i = 0; i < 4; ++i )
+			decls->append(new TypeDecl(base_type(tags[i]),
+						   copy_string(fields[i])));
+
+		RecordType* rt = new RecordType(decls);
+
+		TypeList* t = new TypeList();
+		t->Append(rt);
+		hash = new CompositeHash(t);
+		Unref(t);
+
+		for ( const auto& id : ipv4_conns(1000) )
+			{
+			RecordVal* r = new RecordVal(rt);
+			r->Assign(0, new AddrVal(id.src_addr));
+			r->Assign(1, val_mgr->GetPort(ntohs(id.src_port), TRANSPORT_TCP));
+			r->Assign(2, new AddrVal(id.dst_addr));
+			r->Assign(3, val_mgr->GetPort(ntohs(id.dst_port), TRANSPORT_TCP));
+
+			ListVal* v = new ListVal(TYPE_ANY);
+			v->Append(r);
+			vals.push_back(v);
+			}
+		}
+};
+
+HashConnID hash_conn_id;
+
+// The index of a table[string, count], mixing variable and fixed size
+// parts in one key.
+class HashNested : public HashBenchmark {
+public:
+	HashNested() : HashBenchmark("comphash/string-count")	{ }
+
+	void Setup(uint64 n) override
+		{
+		if ( hash )
+			return;
+
+		TypeList* t = new TypeList();
+		t->Append(base_type(TYPE_STRING));
+		t->Append(base_type(TYPE_COUNT));
+		hash = new CompositeHash(t);
+		Unref(t);
+
+		std::uniform_int_distribution<uint64> count(0, 1 << 20);
+
+		for ( const auto& name : dns_names(1000) )
+			{
+			ListVal* v = new ListVal(TYPE_ANY);
+			v->Append(new StringVal(name));
+			v->Append(val_mgr->GetCount(count(rng)));
+			vals.push_back(v);
+			}
+		}
+};
+
+HashNested hash_nested;
+
+// Timer queues
+
+// Timer expiration times advance with the network time, and most timers
+// are scheduled within a few minutes of it.
+class TimerTimes {
+public:
+	TimerTimes() : delay(1.0 / 30)	{ now = 1e9; }
+
+	double Next()
+		{
+		now += 1e-5;
+		return now + delay(rng);
+		}
+
+	double Now() const	{ return now; }
+
+private:
+	std::exponential_distribution<double> delay;
+	double now;
+};
+
+class Element : public PQ_Element {
+public:
+	explicit Element(double t) : PQ_Element(t)	{ }
+	void SetTime(double t)	{ time = t; }
+};
+
+// Expiring the soonest timer and scheduling a new one, in a queue of
+// steady size.
+class PQHold : public Benchmark {
+public:
+	PQHold() : Benchmark("timers/pq/hold")	{ q = 0; }
+
+	void Setup(uint64 n) override
+		{
+		if ( q )
+			return;
+
+		q = new PriorityQueue();
+
+		for ( int i = 0; i < STEADY_SIZE; ++i )
+			q->Add(new Element(times.Next()));
+		}
+
+	void Run(uint64 n) override
+		{
+		for ( uint64 i = 0; i < n; ++i )
+			{
+			Element* e = static_cast<Element*>(q->Remove());
+			e->SetTime(times.Next());
+			q->Add(e);
+			}
+		}
+
+private:
+	PriorityQueue* q;
+	TimerTimes times;
+};
+
+PQHold pq_hold;
+
+// Like PQHold, for the calendar queue.
+class CQHold : public Benchmark {
+public:
+	CQHold() : Benchmark("timers/cq/hold")	{ q = 0; }
+
+	void Setup(uint64 n) override
+		{
+		if ( q )
+			return;
+
+		q = cq_init(60.0, 1.0);
+
+		for ( int i = 0; i < STEADY_SIZE; ++i )
+			cq_enqueue(q, times.Next(), &cookies[i % 2]);
+		}
+
+	void Run(uint64 n) override
+		{
+		for ( uint64 i = 0; i < n; ++i )
+			{
+			void* c = cq_dequeue(q, HUGE_VAL);
+			cq_enqueue(q, times.Next(), c);
+			}
+		}
+
+private:
+	cq_handle* q;
+	TimerTimes times;
+	int cookies[2];
+};
+
+CQHold cq_hold;
+
+// PrefixTable
+
+// Looking up addresses in a table of /16 to /28 networks, as
+// Site::local_nets and similar sets do.
+class PrefixLookup : public Benchmark {
+public:
+	PrefixLookup(const char* name, bool arg_batch) : Benchmark(name)
+		{
+		batch = arg_batch;
+		t = 0;
+		}
+
+	void Setup(uint64 n) override
+		{
+		if ( t )
+			return;
+
+		t = new PrefixTable();
+
+		std::uniform_int_distribution<uint32> net;
+		std::uniform_int_distribution<int> width(16, 28);
+
+		for ( int i = 0; i < 1000; ++i )
+			{
+			uint32 a = htonl(net(rng));
+			t->Insert(IPAddr(IPv4, &a, IPAddr::Network), 96 + width(rng));
+			}
+
+		for ( const auto& id : ipv4_conns(1000) )
+			{
+			addrs.push_back(id.src_addr);
+			addrs.push_back(id.dst_addr);
+			}
+
+		results.resize(addrs.size());
+		}
+
+	void Run(uint64 n) override
+		{
+		int num_addrs = addrs.size();
+
+		if ( batch )
+			{
+			for ( uint64 i = 0; i < n; i += num_addrs )
+				{
+				t->Lookup(&addrs[0], num_addrs, &results[0]);
+				keep(results[0]);
+				}
+
+			return;
+			}
+
+		int i = 0;
+
+		for ( uint64 j = 0; j < n; ++j )
+			{
+			keep(t->Lookup(addrs[i], 128));
+
+			if ( ++i == num_addrs )
+				i = 0;
+			}
+		}
+
+private:
+	bool batch;
+	PrefixTable* t;
+	std::vector<IPAddr> addrs;
+	std::vector<void*> results;
+};
+
+PrefixLookup prefix_lookup("prefix/lookup/v4", false);
+PrefixLookup prefix_lookup_batch("prefix/lookup-batch/v4", true);
+
+// IPAddr
+
+// Writing out addresses, as the log formatters do for each connection.
+class AddrFormat : public Benchmark {
+public:
+	AddrFormat() : Benchmark("addr/format/v4")	{ }
+
+	void Setup(uint64 n) override
+		{
+		if ( addrs.size() )
+			return;
+
+		for ( const auto& id : ipv4_conns(1000) )
+			addrs.push_back(id.src_addr);
+		}
+
+	void Run(uint64 n) override
+		{
+		char buf[IPAddr::MAX_STRING_LEN];
+
+		for ( uint64 i = 0; i < n; ++i )
+			{
+			keep(addrs[i % addrs.size()].AsString(buf));
+			keep(buf);
+			}
+		}
+
+private:
+	std::vector<IPAddr> addrs;
+};
+
+AddrFormat addr_format;
+
+// Sorting addresses, as for std::map and sets keyed by them.
+class AddrSort : public Benchmark {
+public:
+	AddrSort() : Benchmark("addr/sort/v6")	{ }
+
+	void Setup(uint64 n) override
+		{
+		addrs.clear();
+
+		for ( const auto& id : ipv6_conns(n) )
+			addrs.push_back(id.src_addr);
+		}
+
+	void Run(uint64 n) override
+		{
+		std::sort(addrs.begin(), addrs.end());
+		keep(&addrs[0]);
+		}
+
+private:
+	std::vector<IPAddr> addrs;
+};
+
+AddrSort addr_sort;
+
+// BroString
+
+class StringBenchmark : public Benchmark {
+public:
+	explicit StringBenchmark(const char* name) : Benchmark(name)	{ }
+
+	void Setup(uint64 n) override
+		{
+		if ( strings.size() )
+			return;
+
+		for ( const auto& name : dns_names(1000) )
+			strings.push_back(new BroString(name));
+
+		needle = new BroString(".example.");
+		}
+
+protected:
+	std::vector<BroString*> strings;
+	BroString* needle;
+};
+
+class StringCopy : public StringBenchmark {
+public:
+	StringCopy() : StringBenchmark("string/copy")	{ }
+
+	void Run(uint64 n) override
+		{
+		for ( uint64 i = 0; i < n; ++i )
+			delete new BroString(*strings[i % strings.size()]);
+		}
+};
+
+StringCopy string_copy;
+
+class StringFind : public StringBenchmark {
+public:
+	StringFind() : StringBenchmark("string/find")	{ }
+
+	void Run(uint64 n) override
+		{
+		for ( uint64 i = 0; i < n; ++i )
+			keep(strings[i % strings.size()]->FindSubstring(needle));
+		}
+};
+
+StringFind string_find;
+
+class StringSubstring : public StringBenchmark {
+public:
+	StringSubstring() : StringBenchmark("string/substring")	{ }
+
+	void Run(uint64 n) override
+		{
+		for ( uint64 i = 0; i < n; ++i )
+			delete strings[i % strings.size()]->GetSubstring(2, 8);
+		}
+};
+
+StringSubstring string_substring;
+
+// ODesc
+
+// Writing a log line's worth of fields with escaping on, the way the
+// ASCII writer does.
+class DescEscaped : public Benchmark {
+public:
+	DescEscaped() : Benchmark("desc/escaped-line")	{ }
+
+	void Run(uint64 n) override
+		{
+		for ( uint64 i = 0; i < n; ++i )
+			{
+			ODesc d;
+			d.EnableEscaping();
+			d.AddEscapeSequence("\t");
+			d.Add(1553039494.536204, true);
+			d.AddRaw("\t", 1);
+			d.Add("CHhAvVGS1DHFjwGM9");
+			d.AddRaw("\t", 1);
+			d.Add("www.example.com");
+			d.AddRaw("\t", 1);
+			d.Add(uint64(i));
+			keep(d.Len());
+			}
+		}
+};
+
+DescEscaped desc_escaped;
+
+// Formatting timestamps the way the ASCII writer does, with six digits
+// after the decimal point.
+class FormatTime : public Benchmark {
+public:
+	FormatTime() : Benchmark("format/time")	{ }
+
+	void Run(uint64 n) override
+		{
+		char buf[256];
+
+		for ( uint64 i = 0; i < n; ++i )
+			{
+			keep(modp_dtoa_n(1553039494.536204 + i * 1e-6, buf, 6, 0));
+			keep(buf);
+			}
+		}
+};
+
+FormatTime format_time;
+
+// Base64
+
+// Decoding a line of a base64 encoded MIME attachment.
+class Base64DecodeLine : public Benchmark {
+public:
+	Base64DecodeLine() : Benchmark("base64/decode-line")	{ }
+
+	void Setup(uint64 n) override
+		{
+		if ( line.size() )
+			return;
+
+		const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+		for ( int i = 0; i < 76; ++i )
+			line += alphabet[(i * 7) % 64];
+		}
+
+	void Run(uint64 n) override
+		{
+		Base64Converter dec(0);
+		char buf[64];
+
+		for ( uint64 i = 0; i < n; ++i )
+			{
+			int len = sizeof(buf);
+			char* pbuf = buf;
+			dec.Decode(line.size(), line.data(), &len, &pbuf);
+			keep(buf);
+			}
+		}
+
+private:
+	std::string line;
+};
+
+Base64DecodeLine base64_decode_line;
+
+// Val
+
+class ValDouble : public Benchmark {
+public:
+	ValDouble() : Benchmark("val/new-double")	{ }
+
+	void Run(uint64 n) override
+		{
+		for ( uint64 i = 0; i < n; ++i )
+			Unref(new Val(double(i), TYPE_DOUBLE));
+		}
+};
+
+ValDouble val_double;
+
+class ValString : public Benchmark {
+public:
+	ValString() : Benchmark("val/new-string")	{ }
+
+	void Run(uint64 n) override
+		{
+		for ( uint64 i = 0; i < n; ++i )
+			Unref(new StringVal("www.example.com"));
+		}
+};
+
+ValString val_string;
+
+class ValCount : public Benchmark {
+public:
+	ValCount() : Benchmark("val/get-count")	{ }
+
+	void Run(uint64 n) override
+		{
+		// Mostly small counts, which come preallocated.
+		for ( uint64 i = 0; i < n; ++i )
+			Unref(val_mgr->GetCount(i & 0x3ff));
+		}
+};
+
+ValCount val_count;
+
+// Building a conn_id-like record, as for each new connection.
+class ValRecord : public Benchmark {
+public:
+	ValRecord() : Benchmark("val/new-record")	{ rt = 0; }
+
+	void Setup(uint64 n) override
+		{
+		if ( rt )
+			return;
+
+		type_decl_list* decls = new type_decl_list();
+		decls->append(new TypeDecl(base_type(TYPE_ADDR), copy_string("orig_h")));
+		decls->append(new TypeDecl(base_type(TYPE_PORT), copy_string("orig_p")));
+		decls->append(new TypeDecl(base_type(TYPE_ADDR), copy_string("resp_h")));
+		decls->append(new TypeDecl(base_type(TYPE_PORT), copy_string("resp_p")));
+		rt = new RecordType(decls);
+
+		ids = ipv4_conns(1000);
+		}
+
+	void Run(uint64 n) override
+		{
+		for ( uint64 i = 0; i < n; ++i )
+			{
+			const ConnID& id = ids[i % ids.size()];
+			RecordVal* r = new RecordVal(rt);
+			r->Assign(0, new AddrVal(id.src_addr));
+			r->Assign(1, val_mgr->GetPort(ntohs(id.src_port), TRANSPORT_TCP));
+			r->Assign(2, new AddrVal(id.dst_addr));
+			r->Assign(3, val_mgr->GetPort(ntohs(id.dst_port), TRANSPORT_TCP));
+			Unref(r);
+			}
+		}
+
+private:
+	RecordType* rt;
+	std::vector<ConnID> ids;
+};
+
+ValRecord val_record;
+
+}
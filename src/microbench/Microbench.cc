@@ -0,0 +1,230 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+
+#include "Microbench.h"
+
+using namespace microbench;
+
+// How long a measurement should take at least, in seconds.
+#define MIN_TIME 0.2
+
+// How many measurements to take of each benchmark. We report the fastest,
+// which is the one least disturbed by the rest of the system.
+#define REPETITIONS 3
+
+Benchmark::Benchmark(const char* arg_name)
+	{
+	name = arg_name;
+	All().push_back(this);
+	}
+
+std::vector<Benchmark*>& Benchmark::All()
+	{
+	// Constructed on first use, as benchmarks register from static
+	// initializers.
+	static std::vector<Benchmark*> all;
+	return all;
+	}
+
+static double now()
+	{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+	}
+
+namespace {
+
+// Hardware event counters for the calling thread, where the OS provides
+// them. On Linux, unprivileged users may need kernel.perf_event_paranoid
+// set to 2 or lower.
+class Counters {
+public:
+	enum Event { INSTRUCTIONS, CACHE_MISSES, NUM_EVENTS };
+
+	Counters();
+	~Counters();
+
+	bool Available() const	{ return fds[0] >= 0; }
+
+	void Start();
+	void Stop(uint64* values);
+
+private:
+	int fds[NUM_EVENTS];
+};
+
+}
+
+Counters::Counters()
+	{
+	for ( int i = 0; i < NUM_EVENTS; ++i )
+		fds[i] = -1;
+
+#ifdef __linux__
+	static const uint64 configs[NUM_EVENTS] = {
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+	};
+
+	for ( int i = 0; i < NUM_EVENTS; ++i )
+		{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[i];
+		attr.disabled = (i == 0);
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		// The first counter leads the group, so that they all
+		// count the same stretch.
+		fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1,
+				 i == 0 ? -1 : fds[0], 0);
+
+		if ( fds[i] < 0 )
+			{
+			for ( int j = 0; j < i; ++j )
+				{
+				close(fds[j]);
+				fds[j] = -1;
+				}
+
+			break;
+			}
+		}
+#endif
+	}
+
+Counters::~Counters()
+	{
+	for ( int i = 0; i < NUM_EVENTS; ++i )
+		if ( fds[i] >= 0 )
+			close(fds[i]);
+	}
+
+void Counters::Start()
+	{
+#ifdef __linux__
+	if ( ! Available() )
+		return;
+
+	ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+
+void Counters::Stop(uint64* values)
+	{
+	for ( int i = 0; i < NUM_EVENTS; ++i )
+		values[i] = 0;
+
+#ifdef __linux__
+	if ( ! Available() )
+		return;
+
+	ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+	for ( int i = 0; i < NUM_EVENTS; ++i )
+		{
+		uint64 v;
+
+		if ( read(fds[i], &v, sizeof(v)) == sizeof(v) )
+			values[i] = v;
+		}
+#endif
+	}
+
+// Runs n operations of the benchmark and returns the seconds they took.
+static double measure(Benchmark* b, uint64 n, Counters* counters,
+		      uint64* events)
+	{
+	b->Setup(n);
+
+	counters->Start();
+	double start = now();
+	b->Run(n);
+	double t = now() - start;
+	counters->Stop(events);
+
+	b->TearDown();
+	return t;
+	}
+
+int microbench::run(const char* filter)
+	{
+	std::vector<Benchmark*> benchmarks = Benchmark::All();
+
+	std::sort(benchmarks.begin(), benchmarks.end(),
+		  [](Benchmark* a, Benchmark* b)
+			{ return strcmp(a->Name(), b->Name()) < 0; });
+
+	Counters counters;
+
+	printf("%-40s %12s %12s %12s %14s\n", "benchmark", "ops",
+	       "ns/op", "instr/op", "cache-miss/op");
+
+	for ( auto b : benchmarks )
+		{
+		if ( filter && *filter && ! strstr(b->Name(), filter) )
+			continue;
+
+		// Find a number of operations that takes long enough.
+		uint64 events[Counters::NUM_EVENTS];
+		uint64 n = 1;
+		double t;
+
+		while ( (t = measure(b, n, &counters, events)) < MIN_TIME / 10 )
+			n *= 10;
+
+		if ( t < MIN_TIME )
+			n = uint64(n * MIN_TIME / std::max(t, 1e-9));
+
+		double best = -1;
+		uint64 best_events[Counters::NUM_EVENTS];
+
+		for ( int i = 0; i < REPETITIONS; ++i )
+			{
+			t = measure(b, n, &counters, events);
+
+			if ( best < 0 || t < best )
+				{
+				best = t;
+				std::copy(events, events + Counters::NUM_EVENTS,
+					  best_events);
+				}
+			}
+
+		printf("%-40s %12" PRIu64 " %12.1f", b->Name(), n, best * 1e9 / n);
+
+		if ( counters.Available() )
+			printf(" %12.1f %14.3f\n",
+			       double(best_events[Counters::INSTRUCTIONS]) / n,
+			       double(best_events[Counters::CACHE_MISSES]) / n);
+		else
+			printf(" %12s %14s\n", "-", "-");
+
+		fflush(stdout);
+		}
+
+	if ( ! counters.Available() )
+		fprintf(stderr, "note: hardware counters not available\n");
+
+	return 0;
+	}
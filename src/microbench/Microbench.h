@@ -0,0 +1,75 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef MICROBENCH_MICROBENCH_H
+#define MICROBENCH_MICROBENCH_H
+
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+namespace microbench {
+
+/**
+ * A benchmark of a single operation on a core data structure. The harness
+ * calls Setup() and Run() with growing numbers of operations until Run()
+ * takes long enough to measure, and reports the time and hardware events
+ * that Run() took per operation.
+ */
+class Benchmark {
+public:
+	/**
+	 * Constructor. Registers the benchmark.
+	 *
+	 * @param name A name of the form "<structure>/<operation>/<keys>".
+	 */
+	explicit Benchmark(const char* name);
+
+	virtual ~Benchmark()	{ }
+
+	const char* Name() const	{ return name; }
+
+	/**
+	 * Prepares running \a n operations, outside of the measurement.
+	 */
+	virtual void Setup(uint64 n)	{ }
+
+	/**
+	 * Runs \a n operations.
+	 */
+	virtual void Run(uint64 n) = 0;
+
+	/**
+	 * Cleans up after Run(), outside of the measurement.
+	 */
+	virtual void TearDown()	{ }
+
+	/**
+	 * Returns all registered benchmarks.
+	 */
+	static std::vector<Benchmark*>& All();
+
+private:
+	const char* name;
+};
+
+/**
+ * Runs the benchmarks whose names contain \a filter, or all if it's null,
+ * and prints a report to stdout. Requires the global state that main()
+ * sets up before loading scripts.
+ *
+ * @return An exit code.
+ */
+int run(const char* filter);
+
+// Keeps the compiler from optimizing away computations whose results
+// the benchmarks don't use.
+template<typename T>
+inline void keep(const T& v)
+	{
+	asm volatile("" : : "g"(&v) : "memory");
+	}
+
+}
+
+#endif
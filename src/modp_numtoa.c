@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 // other interesting references on num to string convesion
@@ -418,5 +419,115 @@ void modp_dtoa3(double value, char* str, int n, int prec)
     strreverse(str, wstr-1);
 }
 
+static const char _digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
 
+static int count_digits(uint32_t value)
+{
+    int n = 1;
+
+    for (;;) {
+        if (value < 10) return n;
+        if (value < 100) return n + 1;
+        if (value < 1000) return n + 2;
+        if (value < 10000) return n + 3;
+        value /= 10000;
+        n += 4;
+    }
+}
+
+// Writes the decimal digits of value so that they end right before end,
+// two at a time.
+static void write_digits_back(char* end, uint32_t value)
+{
+    while (value >= 100) {
+        const char* d = &_digit_pairs[2 * (value % 100)];
+        value /= 100;
+        *--end = d[1];
+        *--end = d[0];
+    }
+
+    if (value >= 10) {
+        const char* d = &_digit_pairs[2 * value];
+        *--end = d[1];
+        *--end = d[0];
+    } else
+        *--end = (char)(48 + value);
+}
+
+// This is the same as modp_dtoa/modp_dtoa2 for the values that don't need
+// exponential notation, with the rounding copied as is. Everything else
+// goes to those.
+int modp_dtoa_n(double value, char* str, int prec, int trim)
+{
+    const double thres_max = (double)(0x7FFFFFFF);
+
+    if (! (value == value) || prec <= 0 || prec > 9 ||
+        value > thres_max || -value > thres_max) {
+        if (trim)
+            modp_dtoa2(value, str, prec);
+        else
+            modp_dtoa(value, str, prec);
+
+        return strlen(str);
+    }
+
+    char* wstr = str;
+    int n;
 
+    if (value < 0) {
+        *wstr++ = '-';
+        value = -value;
+    }
+
+    int whole = (int) value;
+    double tmp = (value - whole) * _pow10[prec];
+    uint32_t frac = (uint32_t)(tmp);
+    double diff = tmp - frac;
+
+    if (diff > 0.5) {
+        ++frac;
+        if (frac >= _pow10[prec]) {
+            frac = 0;
+            ++whole;
+        }
+    } else if (diff == 0.5 && ((frac == 0) || (frac & 1))) {
+        ++frac;
+    }
+
+    // Count the digits, then fill them in from the back.
+    uint32_t uwhole = whole;
+
+    n = count_digits(uwhole);
+    wstr += n;
+    write_digits_back(wstr, uwhole);
+
+    int count = prec;
+
+    if (trim) {
+        if (! frac) {
+            *wstr = '\0';
+            return wstr - str;
+        }
+
+        while (!(frac % 10)) {
+            --count;
+            frac /= 10;
+        }
+    }
+
+    *wstr++ = '.';
+
+    n = count_digits(frac);
+
+    while (count-- > n)
+        *wstr++ = '0';
+
+    wstr += n;
+    write_digits_back(wstr, frac);
+
+    *wstr = '\0';
+    return wstr - str;
+}
@@ -106,6 +106,22 @@ void modp_dtoa2(double value, char* buf, int precision);
  */
 void modp_dtoa3(double value, char* buf, int n, int precision);
 
+/** \brief convert a floating point number to char buffer, returning
+ *         the length
+ *
+ * This gives the same as modp_dtoa, or with trim set as modp_dtoa2, but
+ * writes the digits front to back and returns the number of characters,
+ * without the terminating NUL. That's quicker for callers appending the
+ * result somewhere, like timestamps to log lines.
+ *
+ * \param[in] value
+ * \param[out] buf  The allocated output buffer.  Should be 32 chars or more.
+ * \param[in] precision  Number of digits to the right of the decimal point.
+ *    Can only be 0-9.
+ * \param[in] trim  Whether to leave out trailing zeros.
+ */
+int modp_dtoa_n(double value, char* buf, int precision, int trim);
+
 END_C
 
 #endif
@@ -9,6 +9,14 @@
 
 #include <arpa/inet.h>
 
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "Reporter.h"
 #include "net_util.h"
 #include "IPAddr.h"
@@ -16,23 +24,61 @@
 
 // - adapted from tcpdump
 // Returns the ones-complement checksum of a chunk of b short-aligned bytes.
+//
+// As 2^16 is 1 modulo 0xffff, any wider word adds up to the same as the
+// shorts it consists of once folded, which lets us sum several at once.
 int ones_complement_checksum(const void* p, int b, uint32 sum)
 	{
-	const unsigned char* sp = (unsigned char*) p;
+	const unsigned char* sp = (const unsigned char*) p;
+	uint64 acc = sum;
 
 	b /= 2;	// convert to count of short's
 
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+
+	while ( b >= 8 )
+		{
+		// Each 32-bit lane grows by less than 2^17 per 16 bytes;
+		// add them up before they can overflow.
+		int blocks = std::min(b / 8, 16384);
+		__m128i lanes = zero;
+
+		for ( int i = 0; i < blocks; ++i )
+			{
+			__m128i v = _mm_loadu_si128((const __m128i*) sp);
+			lanes = _mm_add_epi32(lanes, _mm_unpacklo_epi16(v, zero));
+			lanes = _mm_add_epi32(lanes, _mm_unpackhi_epi16(v, zero));
+			sp += 16;
+			}
+
+		uint32 l[4];
+		_mm_storeu_si128((__m128i*) l, lanes);
+		acc += uint64(l[0]) + l[1] + l[2] + l[3];
+		b -= blocks * 8;
+		}
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	while ( b >= 2 )
+		{
+		uint32 w;
+		memcpy(&w, sp, sizeof(w));
+		acc += w;
+		sp += 4;
+		b -= 2;
+		}
+#endif
+
 	/* No need for endian conversions. */
 	while ( --b >= 0 )
 		{
-		sum += *sp + (*(sp+1) << 8);
+		acc += *sp + (*(sp+1) << 8);
 		sp += 2;
 		}
 
-	while ( sum > 0xffff )
-		sum = (sum & 0xffff) + (sum >> 16);
+	while ( acc > 0xffff )
+		acc = (acc & 0xffff) + (acc >> 16);
 
-	return sum;
+	return acc;
 	}
 
 int ones_complement_checksum(const IPAddr& a, uint32 sum)
@@ -22,10 +22,10 @@
 %token TOK_WHILE TOK_AS TOK_IS
 
 %token TOK_ATTR_ADD_FUNC TOK_ATTR_DEFAULT TOK_ATTR_OPTIONAL TOK_ATTR_REDEF
-%token TOK_ATTR_DEL_FUNC TOK_ATTR_EXPIRE_FUNC
+%token TOK_ATTR_DEL_FUNC TOK_ATTR_EXPIRE_FUNC TOK_ATTR_EXPIRE_BATCH_FUNC
 %token TOK_ATTR_EXPIRE_CREATE TOK_ATTR_EXPIRE_READ TOK_ATTR_EXPIRE_WRITE
 %token TOK_ATTR_RAW_OUTPUT
-%token TOK_ATTR_PRIORITY TOK_ATTR_LOG TOK_ATTR_ERROR_HANDLER
+%token TOK_ATTR_PRIORITY TOK_ATTR_LOG TOK_ATTR_ERROR_HANDLER TOK_ATTR_CHECKPOINT
 %token TOK_ATTR_TYPE_COLUMN TOK_ATTR_DEPRECATED
 
 %token TOK_DEBUG
@@ -1309,6 +1309,8 @@ attr:
 			{ $$ = new Attr(ATTR_DEL_FUNC, $3); }
 	|	TOK_ATTR_EXPIRE_FUNC '=' expr
 			{ $$ = new Attr(ATTR_EXPIRE_FUNC, $3); }
+	|	TOK_ATTR_EXPIRE_BATCH_FUNC '=' expr
+			{ $$ = new Attr(ATTR_EXPIRE_BATCH_FUNC, $3); }
 	|	TOK_ATTR_EXPIRE_CREATE '=' expr
 			{ $$ = new Attr(ATTR_EXPIRE_CREATE, $3); }
 	|	TOK_ATTR_EXPIRE_READ '=' expr
@@ -1325,6 +1327,8 @@ attr:
 			{ $$ = new Attr(ATTR_LOG); }
 	|	TOK_ATTR_ERROR_HANDLER
 			{ $$ = new Attr(ATTR_ERROR_HANDLER); }
+	|	TOK_ATTR_CHECKPOINT
+			{ $$ = new Attr(ATTR_CHECKPOINT); }
 	|	TOK_ATTR_DEPRECATED
 			{ $$ = new Attr(ATTR_DEPRECATED); }
 	|	TOK_ATTR_DEPRECATED '=' TOK_CONSTANT
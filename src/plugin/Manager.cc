@@ -44,6 +44,22 @@ void Manager::SearchDynamicPlugins(const std::string& dir)
 	{
 	assert(! init);
 
+	if ( ! dir.empty() )
+		plugin_dirs_to_search.push_back(dir);
+	}
+
+void Manager::FindDynamicPlugins() const
+	{
+	// Searching in order keeps the first of several plugins with the
+	// same name, as before.
+	for ( const auto& dir : plugin_dirs_to_search )
+		SearchDynamicPluginsInternal(dir);
+
+	plugin_dirs_to_search.clear();
+	}
+
+void Manager::SearchDynamicPluginsInternal(const std::string& dir) const
+	{
 	if ( dir.empty() )
 		return;
 
@@ -54,7 +70,7 @@ void Manager::SearchDynamicPlugins(const std::string& dir)
 		std::string d;
 
 		while ( std::getline(s, d, ':') )
-			SearchDynamicPlugins(d);
+			SearchDynamicPluginsInternal(d);
 
 		return;
 		}
@@ -122,6 +138,19 @@ void Manager::SearchDynamicPlugins(const std::string& dir)
 
 		string path = dir + "/" + dp->d_name;
 
+#ifdef _DIRENT_HAVE_D_TYPE
+		// Where the directory entry tells the type, only symlinks
+		// need a stat() to tell whether they lead to a directory.
+		if ( dp->d_type == DT_DIR )
+			{
+			SearchDynamicPluginsInternal(path);
+			continue;
+			}
+
+		if ( dp->d_type != DT_LNK && dp->d_type != DT_UNKNOWN )
+			continue;
+#endif
+
 		if( stat(path.c_str(), &st) < 0 )
 			{
 			DBG_LOG(DBG_PLUGINS, "Cannot stat %s: %s", path.c_str(), strerror(errno));
@@ -129,7 +158,7 @@ void Manager::SearchDynamicPlugins(const std::string& dir)
 			}
 
 		if ( st.st_mode & S_IFDIR )
-			SearchDynamicPlugins(path);
+			SearchDynamicPluginsInternal(path);
 		}
 
 	closedir(d);
@@ -137,6 +166,8 @@ void Manager::SearchDynamicPlugins(const std::string& dir)
 
 bool Manager::ActivateDynamicPluginInternal(const std::string& name, bool ok_if_not_found)
 	{
+	FindDynamicPlugins();
+
 	dynamic_plugin_map::iterator m = dynamic_plugins.find(strtolower(name));
 
 	if ( m == dynamic_plugins.end() )
@@ -308,6 +339,8 @@ bool Manager::ActivateDynamicPlugins(bool all)
 
 	if ( all )
 		{
+		FindDynamicPlugins();
+
 		for ( dynamic_plugin_map::const_iterator i = dynamic_plugins.begin();
 		      i != dynamic_plugins.end(); i++ )
 			{
@@ -436,6 +469,8 @@ Manager::inactive_plugin_list Manager::InactivePlugins() const
 
 	inactive_plugin_list inactives;
 
+	FindDynamicPlugins();
+
 	for ( dynamic_plugin_map::const_iterator i = dynamic_plugins.begin(); i != dynamic_plugins.end(); i++ )
 		{
 		bool found = false;
@@ -66,6 +66,10 @@ public:
 	 * recursively. For plugins found, the method makes them available for
 	 * later activation via ActivatePlugin().
 	 *
+	 * The directories get searched only once something needs to know
+	 * about the plugins, so that runs not activating any don't pay for
+	 * walking them.
+	 *
 	 * This must be called only before InitPluginsPreScript().
 	 *
 	 * @param dir The directory to search for plugins. Multiple directories
@@ -410,13 +414,19 @@ public:
 
 private:
 	bool ActivateDynamicPluginInternal(const std::string& name, bool ok_if_not_found = false);
+	void FindDynamicPlugins() const;
+	void SearchDynamicPluginsInternal(const std::string& dir) const;
 	void UpdateInputFiles();
 	void MetaHookPre(HookType hook, const HookArgumentList& args) const;
 	void MetaHookPost(HookType hook, const HookArgumentList& args, HookArgument result) const;
 
 	 // All found dynamic plugins, mapping their names to base directory.
 	typedef std::map<std::string, std::string> dynamic_plugin_map;
-	dynamic_plugin_map dynamic_plugins;
+	mutable dynamic_plugin_map dynamic_plugins;
+
+	// Directories passed to SearchDynamicPlugins() that haven't been
+	// searched yet.
+	mutable std::vector<std::string> plugin_dirs_to_search;
 
 	// We temporarliy buffer scripts to load to get them to load in the
 	// right order.
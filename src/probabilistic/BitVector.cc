@@ -5,6 +5,7 @@
 #include <limits>
 
 #include "BitVector.h"
+#include "Blob.h"
 #include "digest.h"
 
 using namespace probabilistic;
@@ -427,7 +428,7 @@ BitVector::Reference BitVector::operator[](size_type i)
 
 BitVector::size_type BitVector::Count() const
 	{
-	std::vector<block_type>::const_iterator first = bits.begin();
+	auto first = bits.begin();
 	size_t n = 0;
 	size_type length = Blocks();
 
@@ -507,17 +508,40 @@ uint64 BitVector::Hash() const
 
 broker::expected<broker::data> BitVector::Serialize() const
 	{
-	broker::vector v = {static_cast<uint64>(num_bits), static_cast<uint64>(bits.size())};
-	v.reserve(2 + bits.size());
-
-	for ( size_t i = 0; i < bits.size(); ++i )
-		v.emplace_back(static_cast<uint64>(bits[i]));
-
-	return {std::move(v)};
+	BlobWriter w(sizeof(uint64) + bits.size() * sizeof(block_type));
+	w.Add(static_cast<uint64>(num_bits));
+	w.AddArray(bits.data(), bits.size());
+	return {w.Take()};
 	}
 
 std::unique_ptr<BitVector> BitVector::Unserialize(const broker::data& data)
 	{
+	if ( auto blob = caf::get_if<std::string>(&data) )
+		{
+		BlobReader r(*blob);
+		uint64 num_bits;
+
+		if ( ! r.Get(&num_bits) )
+			return nullptr;
+
+		size_t blocks = r.Remaining() / sizeof(block_type);
+
+		if ( r.Remaining() % sizeof(block_type) ||
+		     blocks != num_bits / bits_per_block +
+				(num_bits % bits_per_block != 0) )
+			return nullptr;
+
+		auto bv = std::unique_ptr<BitVector>(new BitVector());
+		bv->num_bits = num_bits;
+		bv->bits.resize(blocks);
+
+		if ( ! r.GetArray(bv->bits.data(), blocks) )
+			return nullptr;
+
+		return bv;
+		}
+
+	// The layout before blobs, with an entry per block.
 	auto v = caf::get_if<broker::vector>(&data);
 	if ( ! (v && v->size() >= 2) )
 		return nullptr;
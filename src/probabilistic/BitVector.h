@@ -9,6 +9,8 @@
 #include <broker/data.hh>
 #include <broker/expected.hh>
 
+#include "../HugePages.h"
+
 namespace probabilistic {
 
 /**
@@ -351,7 +353,7 @@ private:
 	 */
 	static size_type lowest_bit(block_type block);
 
-	std::vector<block_type> bits;
+	std::vector<block_type, HugePageAllocator<block_type> > bits;
 	size_type num_bits;
 };
 
@@ -0,0 +1,158 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef PROBABILISTIC_BLOB_H
+#define PROBABILISTIC_BLOB_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <type_traits>
+
+namespace probabilistic {
+
+// The probabilistic data structures serialize their arrays of counters
+// and bits as one binary string each, rather than as a broker::vector
+// with an entry per element. A blob starts with the version of its
+// layout, followed by fixed-size fields and arrays, all little-endian.
+static const uint8_t BLOB_VERSION = 1;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define BLOB_NATIVE_ORDER 1
+#else
+#define BLOB_NATIVE_ORDER 0
+#endif
+
+/**
+ * Builds a blob.
+ */
+class BlobWriter {
+public:
+	/**
+	 * Starts a blob with the current layout version.
+	 *
+	 * @param size The number of bytes it's going to take, if known.
+	 */
+	explicit BlobWriter(size_t size = 0)
+		{
+		s.reserve(size + 1);
+		s.push_back(BLOB_VERSION);
+		}
+
+	template<typename T>
+	void Add(T x)
+		{ AddArray(&x, 1); }
+
+	void Add(double d)
+		{
+		uint64_t x;
+		memcpy(&x, &d, sizeof(x));
+		Add(x);
+		}
+
+	template<typename T>
+	void AddArray(const T* a, size_t n)
+		{
+		static_assert(std::is_integral<T>::value, "blobs hold integers");
+
+		if ( BLOB_NATIVE_ORDER || sizeof(T) == 1 )
+			{
+			s.append(reinterpret_cast<const char*>(a), n * sizeof(T));
+			return;
+			}
+
+		for ( size_t i = 0; i < n; ++i )
+			for ( size_t j = 0; j < sizeof(T); ++j )
+				s.push_back(char(uint64_t(a[i]) >> (8 * j)));
+		}
+
+	/**
+	 * Returns the blob, leaving the writer empty.
+	 */
+	std::string Take()
+		{ return std::move(s); }
+
+private:
+	std::string s;
+};
+
+/**
+ * Reads a blob back, straight from the string holding it.
+ */
+class BlobReader {
+public:
+	/**
+	 * Checks the blob's layout version; Valid() returns false if it's
+	 * not the current one.
+	 */
+	explicit BlobReader(const std::string& arg_s)
+		: s(arg_s), pos(1), ok(! s.empty() && uint8_t(s[0]) == BLOB_VERSION)
+		{ }
+
+	template<typename T>
+	bool Get(T* x)
+		{ return GetArray(x, 1); }
+
+	bool Get(double* d)
+		{
+		uint64_t x;
+
+		if ( ! Get(&x) )
+			return false;
+
+		memcpy(d, &x, sizeof(x));
+		return true;
+		}
+
+	template<typename T>
+	bool GetArray(T* a, size_t n)
+		{
+		static_assert(std::is_integral<T>::value, "blobs hold integers");
+
+		if ( ! ok || n > Remaining() / sizeof(T) )
+			return ok = false;
+
+		const char* p = s.data() + pos;
+		pos += n * sizeof(T);
+
+		if ( BLOB_NATIVE_ORDER || sizeof(T) == 1 )
+			{
+			memcpy(a, p, n * sizeof(T));
+			return true;
+			}
+
+		for ( size_t i = 0; i < n; ++i )
+			{
+			uint64_t x = 0;
+
+			for ( size_t j = 0; j < sizeof(T); ++j )
+				x |= uint64_t(uint8_t(p[i * sizeof(T) + j])) << (8 * j);
+
+			a[i] = T(x);
+			}
+
+		return true;
+		}
+
+	/**
+	 * Returns the number of bytes not read yet.
+	 */
+	size_t Remaining() const
+		{ return ok ? s.size() - pos : 0; }
+
+	/**
+	 * Returns false if the blob has a different version, or something
+	 * was read beyond its end.
+	 */
+	bool Valid() const
+		{ return ok; }
+
+private:
+	const std::string& s;
+	size_t pos;
+	bool ok;
+};
+
+}
+
+#endif
@@ -1,16 +1,26 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <algorithm>
 #include <typeinfo>
 #include <cmath>
 #include <limits>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include <broker/error.hh>
 
 #include "BloomFilter.h"
 
 #include "CounterVector.h"
+#include "Blob.h"
 
+#include "../digest.h"
 #include "../util.h"
+#include "../HugePages.h"
 #include "../Reporter.h"
 
 using namespace probabilistic;
@@ -70,6 +80,13 @@ std::unique_ptr<BloomFilter> BloomFilter::Unserialize(const broker::data& data)
 	case Counting:
 		bf = std::unique_ptr<BloomFilter>(new CountingBloomFilter());
 		break;
+
+	case Blocked:
+		bf = std::unique_ptr<BloomFilter>(new BlockedBloomFilter());
+		break;
+
+	default:
+		return nullptr;
 	}
 
 	if ( ! bf->DoUnserialize((*v)[2]) )
@@ -300,3 +317,213 @@ bool CountingBloomFilter::DoUnserialize(const broker::data& data)
 	cells = c.release();
 	return true;
 	}
+
+BlockedBloomFilter::BlockedBloomFilter()
+	{
+	words = 0;
+	num_blocks = 0;
+	}
+
+BlockedBloomFilter::BlockedBloomFilter(const Hasher* hasher, size_t cells)
+	: BloomFilter(hasher)
+	{
+	words = 0;
+	Allocate(std::max((cells + BLOCK_BITS - 1) / BLOCK_BITS, size_t(1)));
+	}
+
+BlockedBloomFilter::~BlockedBloomFilter()
+	{
+	huge_free(words);
+	}
+
+void BlockedBloomFilter::Allocate(size_t n)
+	{
+	void* p = huge_alloc(n * BLOCK_BITS / 8, BLOCK_BITS / 8);
+
+	huge_free(words);
+	words = static_cast<uint64_t*>(p);
+	num_blocks = n;
+	memset(words, 0, num_blocks * BLOCK_BITS / 8);
+	}
+
+bool BlockedBloomFilter::Empty() const
+	{
+	for ( size_t i = 0; i < num_blocks * BLOCK_WORDS; ++i )
+		{
+		if ( words[i] )
+			return false;
+		}
+
+	return true;
+	}
+
+void BlockedBloomFilter::Clear()
+	{
+	memset(words, 0, num_blocks * BLOCK_BITS / 8);
+	}
+
+bool BlockedBloomFilter::Merge(const BloomFilter* other)
+	{
+	if ( typeid(*this) != typeid(*other) )
+		return false;
+
+	const BlockedBloomFilter* o = static_cast<const BlockedBloomFilter*>(other);
+
+	if ( ! hasher->Equals(o->hasher) )
+		{
+		reporter->Error("incompatible hashers in BlockedBloomFilter merge");
+		return false;
+		}
+
+	else if ( num_blocks != o->num_blocks )
+		{
+		reporter->Error("different number of blocks in BlockedBloomFilter merge");
+		return false;
+		}
+
+	for ( size_t i = 0; i < num_blocks * BLOCK_WORDS; ++i )
+		words[i] |= o->words[i];
+
+	return true;
+	}
+
+BlockedBloomFilter* BlockedBloomFilter::Clone() const
+	{
+	BlockedBloomFilter* copy = new BlockedBloomFilter();
+
+	copy->hasher = hasher->Clone();
+	copy->Allocate(num_blocks);
+	memcpy(copy->words, words, num_blocks * BLOCK_BITS / 8);
+
+	return copy;
+	}
+
+string BlockedBloomFilter::InternalState() const
+	{
+	u_char buf[SHA256_DIGEST_LENGTH];
+	uint64 digest;
+	EVP_MD_CTX* ctx = hash_init(Hash_SHA256);
+
+	hash_update(ctx, words, num_blocks * BLOCK_BITS / 8);
+	hash_final(ctx, buf);
+	memcpy(&digest, buf, sizeof(digest));
+
+	return fmt("%" PRIu64, digest);
+	}
+
+size_t BlockedBloomFilter::Locate(const HashKey* key, uint64_t* mask) const
+	{
+	uint64_t h = hasher->Single(key);
+
+	// The upper half of the hash picks the block, by multiply-shift
+	// rather than a modulo. Two 16-bit values from the lower half then
+	// give the bits within the block by double hashing; with an odd
+	// stride, no bit gets hit twice.
+	size_t block = ((h >> 32) * num_blocks) >> 32;
+	uint32_t a = h & 0xffff;
+	uint32_t b = ((h >> 16) & 0xffff) | 1;
+	size_t k = std::min(std::max(hasher->K(), size_t(1)), size_t(16));
+
+	for ( size_t i = 0; i < BLOCK_WORDS; ++i )
+		mask[i] = 0;
+
+	for ( size_t i = 0; i < k; ++i )
+		{
+		uint32_t bit = (a + i * b) & (BLOCK_BITS - 1);
+		mask[bit / 64] |= uint64_t(1) << (bit % 64);
+		}
+
+	return block;
+	}
+
+void BlockedBloomFilter::Add(const HashKey* key)
+	{
+	alignas(16) uint64_t mask[BLOCK_WORDS];
+	uint64_t* block = words + Locate(key, mask) * BLOCK_WORDS;
+
+#ifdef __SSE2__
+	for ( size_t i = 0; i < BLOCK_WORDS; i += 2 )
+		{
+		__m128i* p = reinterpret_cast<__m128i*>(block + i);
+		__m128i m = _mm_load_si128(reinterpret_cast<const __m128i*>(mask + i));
+		_mm_store_si128(p, _mm_or_si128(_mm_load_si128(p), m));
+		}
+#else
+	for ( size_t i = 0; i < BLOCK_WORDS; ++i )
+		block[i] |= mask[i];
+#endif
+	}
+
+size_t BlockedBloomFilter::Count(const HashKey* key) const
+	{
+	alignas(16) uint64_t mask[BLOCK_WORDS];
+	const uint64_t* block = words + Locate(key, mask) * BLOCK_WORDS;
+
+	// Collect the bits that are wanted but not set, without branching.
+#ifdef __SSE2__
+	__m128i missing = _mm_setzero_si128();
+
+	for ( size_t i = 0; i < BLOCK_WORDS; i += 2 )
+		{
+		__m128i w = _mm_load_si128(reinterpret_cast<const __m128i*>(block + i));
+		__m128i m = _mm_load_si128(reinterpret_cast<const __m128i*>(mask + i));
+		missing = _mm_or_si128(missing, _mm_andnot_si128(w, m));
+		}
+
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) == 0xffff;
+#else
+	uint64_t missing = 0;
+
+	for ( size_t i = 0; i < BLOCK_WORDS; ++i )
+		missing |= mask[i] & ~block[i];
+
+	return missing == 0;
+#endif
+	}
+
+broker::expected<broker::data> BlockedBloomFilter::DoSerialize() const
+	{
+	BlobWriter w(sizeof(uint64) + num_blocks * BLOCK_WORDS * sizeof(uint64_t));
+	w.Add(static_cast<uint64>(num_blocks));
+	w.AddArray(words, num_blocks * BLOCK_WORDS);
+	return {w.Take()};
+	}
+
+bool BlockedBloomFilter::DoUnserialize(const broker::data& data)
+	{
+	if ( auto blob = caf::get_if<std::string>(&data) )
+		{
+		BlobReader r(*blob);
+		const size_t block_size = BLOCK_WORDS * sizeof(uint64_t);
+		uint64 n;
+
+		if ( ! (r.Get(&n) && n > 0 && n <= r.Remaining() / block_size &&
+			r.Remaining() == n * block_size) )
+			return false;
+
+		Allocate(n);
+		return r.GetArray(words, num_blocks * BLOCK_WORDS);
+		}
+
+	// The layout before blobs, with an entry per word.
+	auto v = caf::get_if<broker::vector>(&data);
+	if ( ! (v && v->size() >= 1) )
+		return false;
+
+	auto n = caf::get_if<uint64>(&(*v)[0]);
+	if ( ! (n && *n > 0 && v->size() == 1 + *n * BLOCK_WORDS) )
+		return false;
+
+	Allocate(*n);
+
+	for ( size_t i = 0; i < num_blocks * BLOCK_WORDS; ++i )
+		{
+		auto x = caf::get_if<uint64>(&(*v)[1 + i]);
+		if ( ! x )
+			return false;
+
+		words[i] = *x;
+		}
+
+	return true;
+	}
@@ -16,7 +16,7 @@ namespace probabilistic {
 class CounterVector;
 
 /** Types of derived BloomFilter classes. */
-enum BloomFilterType { Basic, Counting };
+enum BloomFilterType { Basic, Counting, Blocked };
 
 /**
  * The abstract base class for Bloom filters.
@@ -226,6 +226,75 @@ private:
 	CounterVector* cells;
 };
 
+/**
+ * A blocked Bloom filter. All *k* bits of an element fall into the same
+ * 512-bit block, i.e., a single cache line, and derive from a single hash
+ * value. That makes adding and testing cost one memory access no matter
+ * what *k* is, at the price of a somewhat higher false-positive rate than a
+ * basic Bloom filter of the same size.
+ */
+class BlockedBloomFilter : public BloomFilter {
+public:
+	/**
+	 * The number of bits per block.
+	 */
+	static const size_t BLOCK_BITS = 512;
+
+	/**
+	 * Constructs a blocked Bloom filter.
+	 *
+	 * @param hasher The hasher to use. Only its first hash function gets
+	 * used; its *k* determines the number of bits set per element, at
+	 * most 16.
+	 *
+	 * @param cells The number of cells, rounded up to a multiple of
+	 * *BLOCK_BITS*. The ideal number can be computed with
+	 * *BasicBloomFilter::M*.
+	 */
+	BlockedBloomFilter(const Hasher* hasher, size_t cells);
+
+	/**
+	 * Destructor.
+	 */
+	~BlockedBloomFilter() override;
+
+	// Overridden from BloomFilter.
+	bool Empty() const override;
+	void Clear() override;
+	bool Merge(const BloomFilter* other) override;
+	BlockedBloomFilter* Clone() const override;
+	string InternalState() const override;
+
+protected:
+	friend class BloomFilter;
+
+	/**
+	 * Default constructor.
+	 */
+	BlockedBloomFilter();
+
+	// Overridden from BloomFilter.
+	void Add(const HashKey* key) override;
+	size_t Count(const HashKey* key) const override;
+	broker::expected<broker::data> DoSerialize() const override;
+	bool DoUnserialize(const broker::data& data) override;
+	BloomFilterType Type() const override
+		{ return BloomFilterType::Blocked; }
+
+private:
+	static const size_t BLOCK_WORDS = BLOCK_BITS / 64;
+
+	// Allocates zeroed, cache-line aligned storage for n blocks.
+	void Allocate(size_t n);
+
+	// Computes the index of the block for a key, and the bits it sets
+	// within the block.
+	size_t Locate(const HashKey* key, uint64_t* mask) const;
+
+	uint64_t* words;
+	size_t num_blocks;
+};
+
 }
 
 #endif
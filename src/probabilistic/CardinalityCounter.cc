@@ -2,13 +2,35 @@
 
 #include <math.h>
 #include <stdint.h>
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "CardinalityCounter.h"
+#include "Blob.h"
 #include "Reporter.h"
 
 using namespace probabilistic;
 
+// Sparse entries keep the bucket index above 6 bits for the value, which
+// limits the sparse representation to 2^26 buckets.
+static const int SPARSE_VALUE_BITS = 6;
+static const int SPARSE_MAX_P = 32 - SPARSE_VALUE_BITS;
+
+static inline uint32_t sparse_index(uint32_t e)
+	{
+	return e >> SPARSE_VALUE_BITS;
+	}
+
+static inline uint8_t sparse_value(uint32_t e)
+	{
+	return e & ((1 << SPARSE_VALUE_BITS) - 1);
+	}
+
 int CardinalityCounter::OptimalB(double error, double confidence) const
 	{
 	double initial_estimate = 2 * (log(1.04) - log(error)) / log(2);
@@ -55,17 +77,19 @@ void CardinalityCounter::Init(uint64_t size)
 
 	p = calc_p;
 
-	buckets.reserve(m);
-	for ( uint64_t i = 0; i < m; i++ )
-		buckets.push_back(0);
-
-	assert(buckets.size() == m);
+	// Start out sparse where possible, the buckets get allocated once
+	// enough of them are used.
+	if ( p > SPARSE_MAX_P )
+		{
+		buckets.assign(m, 0);
+		assert(buckets.size() == m);
+		}
 
 	V = m;
 	}
 
 CardinalityCounter::CardinalityCounter(CardinalityCounter& other)
-	: buckets(other.buckets)
+	: buckets(other.buckets), sparse(other.sparse), pending(other.pending)
 	{
 	V = other.V;
 	alpha_m = other.alpha_m;
@@ -82,6 +106,8 @@ CardinalityCounter::CardinalityCounter(CardinalityCounter&& o)
 
 	o.m = 0;
 	buckets = std::move(o.buckets);
+	sparse = std::move(o.sparse);
+	pending = std::move(o.pending);
 	}
 
 CardinalityCounter::CardinalityCounter(double error_margin, double confidence)
@@ -97,13 +123,13 @@ CardinalityCounter::CardinalityCounter(uint64_t size)
 	Init(size);
 	}
 
-CardinalityCounter::CardinalityCounter(uint64_t arg_size, uint64_t arg_V, double arg_alpha_m)
+CardinalityCounter::CardinalityCounter(uint64_t arg_size, uint64_t arg_V,
+                                       double arg_alpha_m, bool dense)
 	{
 	m = arg_size;
 
-	buckets.reserve(m);
-	for ( uint64_t i = 0; i < m; i++ )
-		buckets.push_back(0);
+	if ( dense )
+		buckets.assign(m, 0);
 
 	alpha_m = arg_alpha_m;
 	V = arg_V;
@@ -128,13 +154,91 @@ void CardinalityCounter::AddElement(uint64_t hash)
 	uint64_t index = hash % m;
 	hash = hash-index;
 
+	Update(index, Rank(hash));
+	}
+
+void CardinalityCounter::Update(uint64_t index, uint8_t rank)
+	{
+	if ( IsSparse() )
+		{
+		uint32_t e = (index << SPARSE_VALUE_BITS) | rank;
+
+		// Repeated elements are common, those don't need to wait
+		// for a flush.
+		if ( ! pending.empty() && pending.back() == e )
+			return;
+
+		pending.push_back(e);
+
+		// Sorting in batches keeps adding cheap. Letting the batch
+		// grow with the number of entries amortizes the merge.
+		if ( pending.size() > 4 + sparse.size() / 2 )
+			{
+			Flush();
+			CheckSparse();
+			}
+
+		return;
+		}
+
 	if( buckets[index] == 0 )
 		V--;
 
-	uint8_t temp = Rank(hash);
+	if ( rank > buckets[index] )
+		buckets[index] = rank;
+	}
 
-	if ( temp > buckets[index] )
-		buckets[index] = temp;
+void CardinalityCounter::Flush() const
+	{
+	if ( pending.empty() )
+		return;
+
+	std::sort(pending.begin(), pending.end());
+
+	std::vector<uint32_t> merged;
+	merged.reserve(sparse.size() + pending.size());
+	std::merge(sparse.begin(), sparse.end(), pending.begin(), pending.end(),
+	           std::back_inserter(merged));
+
+	// Entries of the same bucket are next to each other, ordered by
+	// value; the last one is the one to keep.
+	size_t n = 0;
+
+	for ( size_t i = 0; i < merged.size(); ++i )
+		{
+		if ( i + 1 < merged.size() &&
+		     sparse_index(merged[i]) == sparse_index(merged[i + 1]) )
+			continue;
+
+		merged[n++] = merged[i];
+		}
+
+	merged.resize(n);
+	merged.shrink_to_fit();
+	sparse.swap(merged);
+	pending.clear();
+	}
+
+void CardinalityCounter::CheckSparse()
+	{
+	// An entry takes four bytes, a bucket one.
+	if ( sparse.size() > m / 4 )
+		ToDense();
+	}
+
+void CardinalityCounter::ToDense()
+	{
+	Flush();
+
+	buckets.assign(m, 0);
+
+	for ( auto e : sparse )
+		buckets[sparse_index(e)] = sparse_value(e);
+
+	V = m - sparse.size();
+
+	std::vector<uint32_t>().swap(sparse);
+	std::vector<uint32_t>().swap(pending);
 	}
 
 /**
@@ -148,15 +252,43 @@ void CardinalityCounter::AddElement(uint64_t hash)
  **/
 double CardinalityCounter::Size() const
 	{
+	// The number of buckets for each value.
+	uint64_t counts[66] = { 0 };
+	uint64_t zeros = V;
 	double answer = 0;
-	for ( unsigned int i = 0; i < m; i++ )
-		answer += pow(2, -((int)buckets[i]));
+
+	if ( IsSparse() )
+		{
+		Flush();
+		zeros = m - sparse.size();
+		counts[0] = zeros;
+		answer = zeros;
+
+		for ( auto e : sparse )
+			{
+			answer += pow(2, -((int)sparse_value(e)));
+			++counts[sparse_value(e)];
+			}
+		}
+	else
+		{
+		for ( unsigned int i = 0; i < m; i++ )
+			{
+			answer += pow(2, -((int)buckets[i]));
+			++counts[buckets[i]];
+			}
+		}
 
 	answer = 1 / answer;
 	answer = (alpha_m * m * m * answer);
 
 	if ( answer <= 5.0 * (m/2) )
-		return m * log(((double)m) / V);
+		return m * log(((double)m) / zeros);
+
+	// This is where the raw estimate is too high, HLL++ corrects
+	// for that.
+	else if ( answer <= 5.0 * m )
+		return ImprovedEstimate(counts);
 
 	else if ( answer <= (pow(2, 64) / 30) )
 		return answer;
@@ -165,21 +297,110 @@ double CardinalityCounter::Size() const
 		return -pow(2, 64) * log(1 - (answer / pow(2, 64)));
 	}
 
+static double sigma(double x)
+	{
+	if ( x == 1 )
+		return INFINITY;
+
+	double y = 1;
+	double z = x;
+	double z_prev;
+
+	do {
+		x *= x;
+		z_prev = z;
+		z += x * y;
+		y += y;
+	} while ( z != z_prev );
+
+	return z;
+	}
+
+static double tau(double x)
+	{
+	if ( x == 0 || x == 1 )
+		return 0;
+
+	double y = 1;
+	double z = 1 - x;
+	double z_prev;
+
+	do {
+		x = sqrt(x);
+		z_prev = z;
+		y *= 0.5;
+		z -= pow(1 - x, 2) * y;
+	} while ( z != z_prev );
+
+	return z / 3;
+	}
+
+double CardinalityCounter::ImprovedEstimate(const uint64_t* counts) const
+	{
+	// Bucket values go from 0 to q + 1.
+	int q = 64 - p;
+
+	double z = m * tau(1 - (double)counts[q + 1] / m);
+
+	for ( int k = q; k >= 1; --k )
+		z = 0.5 * (z + counts[k]);
+
+	z += m * sigma((double)counts[0] / m);
+
+	return 0.5 / log(2) * m * m / z;
+	}
+
 bool CardinalityCounter::Merge(CardinalityCounter* c)
 	{
 	if ( m != c->GetM() )
 		return false;
 
-	const vector<uint8_t> temp = c->GetBuckets();
+	if ( c->IsSparse() )
+		{
+		c->Flush();
+
+		for ( auto e : c->sparse )
+			Update(sparse_index(e), sparse_value(e));
+
+		if ( IsSparse() )
+			{
+			Flush();
+			CheckSparse();
+			}
+
+		return true;
+		}
+
+	if ( IsSparse() )
+		ToDense();
+
+	const uint8_t* other = c->GetBuckets().data();
+	uint8_t* mine = buckets.data();
+	uint64_t i = 0;
 
 	V = 0;
 
-	for ( unsigned int i = 0; i < m; i++ )
+#ifdef __SSE2__
+	// Take the maximum of 16 buckets at once, counting the zeros on
+	// the way.
+	const __m128i zero = _mm_setzero_si128();
+
+	for ( ; i + 16 <= m; i += 16 )
 		{
-		if ( temp[i] > buckets[i] )
-			buckets[i] = temp[i];
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mine + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(other + i));
+		__m128i r = _mm_max_epu8(a, b);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(mine + i), r);
+		V += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(r, zero)));
+		}
+#endif
 
-		if ( buckets[i] == 0 )
+	for ( ; i < m; i++ )
+		{
+		if ( other[i] > mine[i] )
+			mine[i] = other[i];
+
+		if ( mine[i] == 0 )
 			++V;
 		}
 
@@ -198,17 +419,35 @@ uint64_t CardinalityCounter::GetM() const
 
 broker::expected<broker::data> CardinalityCounter::Serialize() const
 	{
-	broker::vector v = {m, V, alpha_m};
-	v.reserve(3 + m);
+	// The blob has whether it's sparse, m, V and alpha_m, followed by
+	// either the sparse entries or the buckets.
+	bool is_sparse = IsSparse();
+
+	if ( is_sparse )
+		Flush();
 
-	for ( size_t i = 0; i < m; ++i )
-		v.emplace_back(static_cast<uint64>(buckets[i]));
+	size_t payload = is_sparse ? sparse.size() * sizeof(uint32_t) : m;
+	BlobWriter w(1 + 3 * sizeof(uint64) + payload);
 
-	return {std::move(v)};
+	w.Add(uint8_t(is_sparse));
+	w.Add(static_cast<uint64>(m));
+	w.Add(static_cast<uint64>(is_sparse ? m - sparse.size() : V));
+	w.Add(alpha_m);
+
+	if ( is_sparse )
+		w.AddArray(sparse.data(), sparse.size());
+	else
+		w.AddArray(buckets.data(), m);
+
+	return {w.Take()};
 	}
 
 std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker::data& data)
 	{
+	if ( auto blob = caf::get_if<std::string>(&data) )
+		return UnserializeBlob(*blob);
+
+	// The layout before blobs, with an entry per bucket or sparse entry.
 	auto v = caf::get_if<broker::vector>(&data);
 	if ( ! (v && v->size() >= 3) )
 		return nullptr;
@@ -219,10 +458,35 @@ std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker
 
 	if ( ! (m && V && alpha_m) )
 		return nullptr;
+
+	auto entries = v->size() == 4 ? caf::get_if<broker::vector>(&(*v)[3]) : nullptr;
+
+	if ( entries )
+		{
+		if ( *m < 16 || *m > (uint64_t(1) << SPARSE_MAX_P) )
+			return nullptr;
+
+		auto cc = std::unique_ptr<CardinalityCounter>(new CardinalityCounter(*m, *V, *alpha_m, false));
+		cc->pending.reserve(entries->size());
+
+		for ( const auto& d : *entries )
+			{
+			auto x = caf::get_if<uint64>(&d);
+			if ( ! (x && (*x >> SPARSE_VALUE_BITS) < *m && sparse_value(*x) > 0) )
+				return nullptr;
+
+			cc->pending.push_back(*x);
+			}
+
+		cc->Flush();
+		cc->CheckSparse();
+		return cc;
+		}
+
 	if ( v->size() != 3 + *m )
 		return nullptr;
 
-	auto cc = std::unique_ptr<CardinalityCounter>(new CardinalityCounter(*m, *V, *alpha_m));
+	auto cc = std::unique_ptr<CardinalityCounter>(new CardinalityCounter(*m, *V, *alpha_m, true));
 	if ( *m != cc->m )
 		return nullptr;
 	if ( cc->buckets.size() != * m )
@@ -240,6 +504,52 @@ std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker
 	return cc;
 	}
 
+std::unique_ptr<CardinalityCounter> CardinalityCounter::UnserializeBlob(const std::string& blob)
+	{
+	BlobReader r(blob);
+	uint8_t is_sparse;
+	uint64 m, V;
+	double alpha_m;
+
+	if ( ! (r.Get(&is_sparse) && r.Get(&m) && r.Get(&V) && r.Get(&alpha_m)) )
+		return nullptr;
+
+	if ( is_sparse )
+		{
+		if ( m < 16 || m > (uint64_t(1) << SPARSE_MAX_P) ||
+		     r.Remaining() % sizeof(uint32_t) )
+			return nullptr;
+
+		auto cc = std::unique_ptr<CardinalityCounter>(new CardinalityCounter(m, V, alpha_m, false));
+		cc->pending.resize(r.Remaining() / sizeof(uint32_t));
+
+		if ( ! r.GetArray(cc->pending.data(), cc->pending.size()) )
+			return nullptr;
+
+		for ( auto x : cc->pending )
+			{
+			if ( ! ((x >> SPARSE_VALUE_BITS) < m && sparse_value(x) > 0) )
+				return nullptr;
+			}
+
+		cc->Flush();
+		cc->CheckSparse();
+		return cc;
+		}
+
+	if ( r.Remaining() != m )
+		return nullptr;
+
+	auto cc = std::unique_ptr<CardinalityCounter>(new CardinalityCounter(m, V, alpha_m, true));
+	if ( m != cc->m || cc->buckets.size() != m )
+		return nullptr;
+
+	if ( ! r.GetArray(cc->buckets.data(), m) )
+		return nullptr;
+
+	return cc;
+	}
+
 /**
  * The following function is copied from libc/string/flsll.c from the FreeBSD source
  * tree. Original copyright message follows
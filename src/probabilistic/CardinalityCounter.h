@@ -14,6 +14,11 @@ namespace probabilistic {
 
 /**
  * A probabilistic cardinality counter using the HyperLogLog algorithm.
+ *
+ * Following HyperLogLog++ (Heule et al., "HyperLogLog in Practice", EDBT
+ * 2013), a counter starts out with a sparse representation that only
+ * keeps the registers that are set, and switches to the dense array of all
+ * registers once that takes less space.
  */
 class CardinalityCounter {
 public:
@@ -88,6 +93,11 @@ public:
 	 */
 	bool Merge(CardinalityCounter* c);
 
+	/**
+	 * Returns true if the counter still uses the sparse representation.
+	 */
+	bool IsSparse() const	{ return buckets.empty(); }
+
 	broker::expected<broker::data> Serialize() const;
 	static std::unique_ptr<CardinalityCounter> Unserialize(const broker::data& data);
 
@@ -101,7 +111,7 @@ protected:
 
 	/**
 	 * Returns the buckets array that holds all of the rough cardinality
-	 * estimates.
+	 * estimates. It's empty while the counter is sparse.
 	 *
 	 * Use GetM() to determine the size.
 	 *
@@ -114,7 +124,44 @@ private:
 	 * Constructor used when unserializing, i.e., all parameters are
 	 * known.
 	 */
-	explicit CardinalityCounter(uint64_t size, uint64_t V, double alpha_m);
+	CardinalityCounter(uint64_t size, uint64_t V, double alpha_m, bool dense);
+
+	/**
+	 * Unserializes a counter from the binary layout Serialize() produces.
+	 */
+	static std::unique_ptr<CardinalityCounter> UnserializeBlob(const std::string& blob);
+
+	/**
+	 * Raises a bucket to at least the given rank.
+	 */
+	void Update(uint64_t index, uint8_t rank);
+
+	/**
+	 * Merges the pending sparse entries into the sorted ones, keeping
+	 * the highest rank for each bucket.
+	 */
+	void Flush() const;
+
+	/**
+	 * Switches to the dense representation if the sparse one has become
+	 * larger.
+	 */
+	void CheckSparse();
+
+	/**
+	 * Switches to the dense representation.
+	 */
+	void ToDense();
+
+	/**
+	 * Estimates the cardinality from the histogram of bucket values
+	 * with the improved estimator from Ertl, "New cardinality estimation
+	 * algorithms for HyperLogLog sketches" (2017). It has no bias in the
+	 * range where the raw estimate is known to overestimate.
+	 *
+	 * @param counts The number of buckets for each value, 0 to 65 - p.
+	 */
+	double ImprovedEstimate(const uint64_t* counts) const;
 
 	/**
 	 * Helper function with code used jointly by multiple constructors.
@@ -174,10 +221,20 @@ private:
 	 */
 	std::vector<uint8_t> buckets;
 
+	/**
+	 * The sparse representation: for each bucket that isn't 0, its
+	 * index shifted left by 6 bits, or-ed with its value. *sparse* is
+	 * sorted and has one entry per bucket; new ones get collected in
+	 * *pending* first. Both are empty once *buckets* is used.
+	 */
+	mutable std::vector<uint32_t> sparse;
+	mutable std::vector<uint32_t> pending;
+
 	/**
 	 * There are some state constants that need to be kept track of to
 	 * make the final estimate easier. V is the number of values in
-	 * buckets that are 0 and this is used in the small error correction.
+	 * buckets that are 0 and this is used in the small error correction;
+	 * it's only kept up to date for the dense representation.
 	 * alpha_m is a multiplicative constant used in the algorithm.
 	 */
 	uint64_t V;
@@ -0,0 +1,223 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string.h>
+
+#include "CountMinSketch.h"
+#include "Blob.h"
+
+#include <broker/error.hh>
+
+#include "../digest.h"
+#include "../util.h"
+
+using namespace probabilistic;
+
+static inline uint64_t saturating_add(uint64_t a, uint64_t b)
+	{
+	return a + b < a ? std::numeric_limits<uint64_t>::max() : a + b;
+	}
+
+CountMinSketch::CountMinSketch()
+	{
+	hasher = 0;
+	width = 0;
+	depth = 0;
+	conservative = false;
+	total = 0;
+	}
+
+CountMinSketch::CountMinSketch(const Hasher* arg_hasher, size_t arg_width,
+                               bool arg_conservative)
+	{
+	hasher = arg_hasher;
+	width = std::max(arg_width, size_t(1));
+	depth = hasher->K();
+	conservative = arg_conservative;
+	total = 0;
+	cells.resize(width * depth);
+	}
+
+CountMinSketch::~CountMinSketch()
+	{
+	delete hasher;
+	}
+
+size_t CountMinSketch::Width(double error)
+	{
+	return std::ceil(M_E / error);
+	}
+
+size_t CountMinSketch::Depth(double confidence)
+	{
+	return std::max(std::ceil(std::log(1 / (1 - confidence))), 1.0);
+	}
+
+void CountMinSketch::Add(const HashKey* key, uint64_t count)
+	{
+	Hasher::digest_vector h = hasher->Hash(key);
+	total = saturating_add(total, count);
+
+	if ( ! conservative )
+		{
+		for ( size_t i = 0; i < depth; ++i )
+			{
+			uint64_t& c = cells[i * width + h[i] % width];
+			c = saturating_add(c, count);
+			}
+
+		return;
+		}
+
+	// Raise every counter to what the estimate becomes; the ones
+	// above that already account for this element.
+	uint64_t estimate = std::numeric_limits<uint64_t>::max();
+
+	for ( size_t i = 0; i < depth; ++i )
+		estimate = std::min(estimate, cells[i * width + h[i] % width]);
+
+	estimate = saturating_add(estimate, count);
+
+	for ( size_t i = 0; i < depth; ++i )
+		{
+		uint64_t& c = cells[i * width + h[i] % width];
+		c = std::max(c, estimate);
+		}
+	}
+
+uint64_t CountMinSketch::Estimate(const HashKey* key) const
+	{
+	Hasher::digest_vector h = hasher->Hash(key);
+	uint64_t estimate = std::numeric_limits<uint64_t>::max();
+
+	for ( size_t i = 0; i < depth; ++i )
+		estimate = std::min(estimate, cells[i * width + h[i] % width]);
+
+	return estimate;
+	}
+
+void CountMinSketch::Clear()
+	{
+	std::fill(cells.begin(), cells.end(), 0);
+	total = 0;
+	}
+
+bool CountMinSketch::Merge(const CountMinSketch* other)
+	{
+	if ( ! hasher->Equals(other->hasher) || width != other->width )
+		return false;
+
+	// Sums of counters stay above the sums of the counts, whichever
+	// way they got updated.
+	for ( size_t i = 0; i < cells.size(); ++i )
+		cells[i] = saturating_add(cells[i], other->cells[i]);
+
+	total = saturating_add(total, other->total);
+	return true;
+	}
+
+CountMinSketch* CountMinSketch::Clone() const
+	{
+	CountMinSketch* copy = new CountMinSketch();
+
+	copy->hasher = hasher->Clone();
+	copy->width = width;
+	copy->depth = depth;
+	copy->conservative = conservative;
+	copy->total = total;
+	copy->cells = cells;
+
+	return copy;
+	}
+
+std::string CountMinSketch::InternalState() const
+	{
+	u_char buf[SHA256_DIGEST_LENGTH];
+	uint64 digest;
+	EVP_MD_CTX* ctx = hash_init(Hash_SHA256);
+
+	hash_update(ctx, cells.data(), cells.size() * sizeof(uint64_t));
+	hash_final(ctx, buf);
+	memcpy(&digest, buf, sizeof(digest));
+
+	return fmt("%" PRIu64, digest);
+	}
+
+broker::expected<broker::data> CountMinSketch::Serialize() const
+	{
+	auto h = hasher->Serialize();
+
+	if ( ! h )
+		return broker::ec::invalid_data; // Cannot serialize
+
+	BlobWriter w(cells.size() * sizeof(uint64_t));
+	w.AddArray(cells.data(), cells.size());
+
+	return {broker::vector{std::move(*h), static_cast<uint64>(width),
+	                       conservative, static_cast<uint64>(total),
+	                       w.Take()}};
+	}
+
+std::unique_ptr<CountMinSketch> CountMinSketch::Unserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() >= 4) )
+		return nullptr;
+
+	auto width = caf::get_if<uint64>(&(*v)[1]);
+	auto conservative = caf::get_if<bool>(&(*v)[2]);
+	auto total = caf::get_if<uint64>(&(*v)[3]);
+
+	if ( ! (width && conservative && total) || *width == 0 )
+		return nullptr;
+
+	auto hasher_ = Hasher::Unserialize((*v)[0]);
+	if ( ! hasher_ )
+		return nullptr;
+
+	auto blob = v->size() == 5 ? caf::get_if<std::string>(&(*v)[4]) : nullptr;
+	size_t num_cells = *width * hasher_->K();
+
+	if ( ! blob && v->size() != 4 + num_cells )
+		return nullptr;
+
+	auto cms = std::unique_ptr<CountMinSketch>(new CountMinSketch());
+	cms->width = *width;
+	cms->depth = hasher_->K();
+	cms->conservative = *conservative;
+	cms->total = *total;
+	cms->hasher = hasher_.release();
+
+	if ( blob )
+		{
+		BlobReader r(*blob);
+
+		if ( r.Remaining() / sizeof(uint64_t) != num_cells ||
+		     r.Remaining() % sizeof(uint64_t) )
+			return nullptr;
+
+		cms->cells.resize(num_cells);
+
+		if ( ! r.GetArray(cms->cells.data(), num_cells) )
+			return nullptr;
+
+		return cms;
+		}
+
+	// The layout before blobs, with an entry per cell.
+	cms->cells.reserve(v->size() - 4);
+
+	for ( size_t i = 4; i < v->size(); ++i )
+		{
+		auto x = caf::get_if<uint64>(&(*v)[i]);
+		if ( ! x )
+			return nullptr;
+
+		cms->cells.push_back(*x);
+		}
+
+	return cms;
+	}
@@ -0,0 +1,138 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef PROBABILISTIC_COUNTMINSKETCH_H
+#define PROBABILISTIC_COUNTMINSKETCH_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <broker/data.hh>
+#include <broker/expected.hh>
+
+#include "Hasher.h"
+
+namespace probabilistic {
+
+/**
+ * A Count-Min sketch (Cormode and Muthukrishnan, "An Improved Data Stream
+ * Summary: The Count-Min Sketch and its Applications", 2005). It estimates
+ * how often each element occurred in fixed memory: one row of counters per
+ * hash function, and an element's estimate is the smallest of its counters.
+ * Estimates never fall below the true count and exceed it by more than
+ * *error* times the total of all counts only with a probability of
+ * *1 - confidence*.
+ *
+ * With conservative update (Estan and Varghese, "New Directions in Traffic
+ * Measurement and Accounting", SIGCOMM 2002), adding only raises the
+ * counters that need it, which makes the overestimates a lot smaller.
+ */
+class CountMinSketch {
+public:
+	/**
+	 * Constructs a Count-Min sketch.
+	 *
+	 * @param hasher The hasher to use. It needs one hash function per
+	 * row. The sketch takes ownership.
+	 *
+	 * @param width The number of counters per row. The right number can
+	 * be computed with *Width*.
+	 *
+	 * @param conservative Whether to use conservative update.
+	 */
+	CountMinSketch(const Hasher* hasher, size_t width, bool conservative);
+
+	/**
+	 * Destructor.
+	 */
+	~CountMinSketch();
+
+	/**
+	 * Computes the number of counters per row for a given error.
+	 *
+	 * @param error The maximum error relative to the total count.
+	 *
+	 * @return The number of counters per row.
+	 */
+	static size_t Width(double error);
+
+	/**
+	 * Computes the number of rows, i.e., hash functions, needed for a
+	 * given confidence.
+	 *
+	 * @param confidence The probability that an estimate stays within
+	 * the error.
+	 *
+	 * @return The number of rows.
+	 */
+	static size_t Depth(double confidence);
+
+	/**
+	 * Adds to an element's count. Counters saturate instead of
+	 * overflowing.
+	 *
+	 * @param key The key associated with the element.
+	 *
+	 * @param count The amount to add.
+	 */
+	void Add(const HashKey* key, uint64_t count);
+
+	/**
+	 * Estimates an element's count.
+	 *
+	 * @param key The key associated with the element.
+	 *
+	 * @return The estimate, which is at least the true count.
+	 */
+	uint64_t Estimate(const HashKey* key) const;
+
+	/**
+	 * Returns the sum of all counts added.
+	 */
+	uint64_t Total() const	{ return total; }
+
+	/**
+	 * Resets all counts to 0.
+	 */
+	void Clear();
+
+	/**
+	 * Adds the counts of another sketch with the same parameters.
+	 *
+	 * @param other The other sketch.
+	 *
+	 * @return False if the sketches don't match.
+	 */
+	bool Merge(const CountMinSketch* other);
+
+	/**
+	 * Constructs a copy of the sketch.
+	 */
+	CountMinSketch* Clone() const;
+
+	/**
+	 * Returns a string with a representation of the sketch's internal
+	 * state. This is for debugging/testing purposes only.
+	 */
+	std::string InternalState() const;
+
+	broker::expected<broker::data> Serialize() const;
+	static std::unique_ptr<CountMinSketch> Unserialize(const broker::data& data);
+
+private:
+	CountMinSketch();
+
+	const Hasher* hasher;
+	size_t width;
+	size_t depth;
+	bool conservative;
+	uint64_t total;
+
+	// The rows, one after the other.
+	std::vector<uint64_t> cells;
+};
+
+}
+
+#endif
@@ -0,0 +1,429 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+#include "CuckooFilter.h"
+#include "Blob.h"
+
+#include <broker/error.hh>
+
+#include "../digest.h"
+#include "../util.h"
+#include "../Reporter.h"
+
+using namespace probabilistic;
+
+// How many fingerprints to move around before giving up on an insertion.
+static const int MAX_KICKS = 500;
+
+// The share of slots to fill at capacity. Insertions start failing at
+// about 95%, some slack keeps that from happening earlier by chance.
+static const double LOAD_FACTOR = 0.92;
+
+// Additional buckets, small filters are more prone to filling up early.
+static const double EXTRA_BUCKETS = 8;
+
+CuckooFilter::CuckooFilter()
+	{
+	hasher = 0;
+	num_buckets = 0;
+	fp_bits = 0;
+	num_elements = 0;
+	victim_fp = 0;
+	victim_bucket = 0;
+	rng = 0x9e3779b97f4a7c15ULL;
+	}
+
+CuckooFilter::CuckooFilter(const Hasher* arg_hasher, size_t capacity,
+                           size_t fingerprint_bits)
+	{
+	hasher = arg_hasher;
+	fp_bits = std::min(std::max(fingerprint_bits, size_t(4)), size_t(32));
+	num_elements = 0;
+	victim_fp = 0;
+	victim_bucket = 0;
+	rng = 0x9e3779b97f4a7c15ULL;
+
+	// Bucket indices get derived from 32 bits of the hash.
+	double buckets = std::ceil(capacity / (BUCKET_SIZE * LOAD_FACTOR)) + EXTRA_BUCKETS;
+	num_buckets = std::min(buckets, 4294967296.0);
+
+	table.resize((num_buckets * BUCKET_SIZE * fp_bits + 63) / 64);
+	}
+
+CuckooFilter::~CuckooFilter()
+	{
+	delete hasher;
+	}
+
+size_t CuckooFilter::FingerprintBits(double fp)
+	{
+	// A lookup compares against up to 2 * BUCKET_SIZE fingerprints.
+	double bits = std::ceil(std::log2(2 * BUCKET_SIZE / fp));
+	return std::min(std::max(bits, 4.0), 32.0);
+	}
+
+void CuckooFilter::Locate(uint64_t h, uint32_t* fp, uint64_t* bucket) const
+	{
+	// The upper half of the hash gives the fingerprint, 0 marks empty
+	// slots. The lower one picks the bucket by multiply-shift.
+	*fp = (h >> 32) & ((uint64_t(1) << fp_bits) - 1);
+
+	if ( *fp == 0 )
+		*fp = 1;
+
+	*bucket = ((h & 0xffffffff) * num_buckets) >> 32;
+	}
+
+uint64_t CuckooFilter::AltBucket(uint64_t bucket, uint32_t fp) const
+	{
+	// Mirroring at a point derived from the fingerprint leads back to
+	// the first bucket when applied twice, without needing a power of
+	// two for the number of buckets.
+	uint64_t hf = (uint64_t(uint32_t(fp * 0x5bd1e995)) * num_buckets) >> 32;
+	return hf >= bucket ? hf - bucket : hf + num_buckets - bucket;
+	}
+
+uint32_t CuckooFilter::Get(uint64_t bucket, size_t slot) const
+	{
+	uint64_t pos = (bucket * BUCKET_SIZE + slot) * fp_bits;
+	uint64_t word = pos / 64;
+	unsigned int offset = pos % 64;
+	uint64_t v = table[word] >> offset;
+
+	if ( offset + fp_bits > 64 )
+		v |= table[word + 1] << (64 - offset);
+
+	return v & ((uint64_t(1) << fp_bits) - 1);
+	}
+
+void CuckooFilter::Set(uint64_t bucket, size_t slot, uint32_t fp)
+	{
+	uint64_t pos = (bucket * BUCKET_SIZE + slot) * fp_bits;
+	uint64_t word = pos / 64;
+	unsigned int offset = pos % 64;
+	uint64_t mask = (uint64_t(1) << fp_bits) - 1;
+
+	table[word] = (table[word] & ~(mask << offset)) | (uint64_t(fp) << offset);
+
+	if ( offset + fp_bits > 64 )
+		{
+		unsigned int shift = 64 - offset;
+		table[word + 1] = (table[word + 1] & ~(mask >> shift)) |
+		                  (uint64_t(fp) >> shift);
+		}
+	}
+
+uint64_t CuckooFilter::NextRandom()
+	{
+	// xorshift64; this doesn't need to be good, and shouldn't disturb
+	// the script-level random numbers.
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng >> 32;
+	}
+
+bool CuckooFilter::InsertIntoBucket(uint64_t bucket, uint32_t fp)
+	{
+	for ( size_t i = 0; i < BUCKET_SIZE; ++i )
+		{
+		if ( Get(bucket, i) == 0 )
+			{
+			Set(bucket, i, fp);
+			return true;
+			}
+		}
+
+	return false;
+	}
+
+bool CuckooFilter::RemoveFromBucket(uint64_t bucket, uint32_t fp)
+	{
+	for ( size_t i = 0; i < BUCKET_SIZE; ++i )
+		{
+		if ( Get(bucket, i) == fp )
+			{
+			Set(bucket, i, 0);
+			return true;
+			}
+		}
+
+	return false;
+	}
+
+bool CuckooFilter::BucketContains(uint64_t bucket, uint32_t fp) const
+	{
+	for ( size_t i = 0; i < BUCKET_SIZE; ++i )
+		{
+		if ( Get(bucket, i) == fp )
+			return true;
+		}
+
+	return false;
+	}
+
+void CuckooFilter::Insert(uint64_t bucket, uint32_t fp)
+	{
+	uint64_t alt = AltBucket(bucket, fp);
+
+	if ( InsertIntoBucket(bucket, fp) || InsertIntoBucket(alt, fp) )
+		return;
+
+	// Both buckets are full, move fingerprints to their other bucket
+	// until one finds a free slot.
+	uint64_t b = (NextRandom() & 1) ? alt : bucket;
+
+	for ( int n = 0; n < MAX_KICKS; ++n )
+		{
+		size_t slot = NextRandom() % BUCKET_SIZE;
+		uint32_t evicted = Get(b, slot);
+		Set(b, slot, fp);
+		fp = evicted;
+		b = AltBucket(b, fp);
+
+		if ( InsertIntoBucket(b, fp) )
+			return;
+		}
+
+	// Keep the last one aside so that nothing gets lost.
+	victim_fp = fp;
+	victim_bucket = b;
+	}
+
+bool CuckooFilter::Add(const HashKey* key)
+	{
+	if ( victim_fp )
+		return false;
+
+	uint32_t fp;
+	uint64_t bucket;
+	Locate(hasher->Single(key), &fp, &bucket);
+
+	Insert(bucket, fp);
+	++num_elements;
+	return true;
+	}
+
+bool CuckooFilter::Remove(const HashKey* key)
+	{
+	uint32_t fp;
+	uint64_t bucket;
+	Locate(hasher->Single(key), &fp, &bucket);
+	uint64_t alt = AltBucket(bucket, fp);
+
+	if ( victim_fp == fp && (victim_bucket == bucket || victim_bucket == alt) )
+		{
+		victim_fp = 0;
+		--num_elements;
+		return true;
+		}
+
+	if ( ! (RemoveFromBucket(bucket, fp) || RemoveFromBucket(alt, fp)) )
+		return false;
+
+	--num_elements;
+
+	if ( victim_fp )
+		{
+		// There's room now.
+		uint32_t v = victim_fp;
+		victim_fp = 0;
+		Insert(victim_bucket, v);
+		}
+
+	return true;
+	}
+
+bool CuckooFilter::Lookup(const HashKey* key) const
+	{
+	uint32_t fp;
+	uint64_t bucket;
+	Locate(hasher->Single(key), &fp, &bucket);
+	uint64_t alt = AltBucket(bucket, fp);
+
+	if ( victim_fp == fp && (victim_bucket == bucket || victim_bucket == alt) )
+		return true;
+
+	return BucketContains(bucket, fp) || BucketContains(alt, fp);
+	}
+
+void CuckooFilter::Clear()
+	{
+	std::fill(table.begin(), table.end(), 0);
+	num_elements = 0;
+	victim_fp = 0;
+	victim_bucket = 0;
+	}
+
+bool CuckooFilter::Merge(const CuckooFilter* other)
+	{
+	if ( ! hasher->Equals(other->hasher) )
+		{
+		reporter->Error("incompatible hashers in CuckooFilter merge");
+		return false;
+		}
+
+	else if ( num_buckets != other->num_buckets || fp_bits != other->fp_bits )
+		{
+		reporter->Error("different sizes in CuckooFilter merge");
+		return false;
+		}
+
+	// A fingerprint's buckets only depend on where it is, so the
+	// other's can move over without knowing their elements.
+	for ( uint64_t i = 0; i < other->num_buckets; ++i )
+		{
+		for ( size_t j = 0; j < BUCKET_SIZE; ++j )
+			{
+			uint32_t fp = other->Get(i, j);
+
+			if ( ! fp )
+				continue;
+
+			if ( victim_fp )
+				{
+				reporter->Error("CuckooFilter full during merge");
+				return false;
+				}
+
+			Insert(i, fp);
+			++num_elements;
+			}
+		}
+
+	if ( other->victim_fp )
+		{
+		if ( victim_fp )
+			{
+			reporter->Error("CuckooFilter full during merge");
+			return false;
+			}
+
+		Insert(other->victim_bucket, other->victim_fp);
+		++num_elements;
+		}
+
+	return true;
+	}
+
+CuckooFilter* CuckooFilter::Clone() const
+	{
+	CuckooFilter* copy = new CuckooFilter();
+
+	copy->hasher = hasher->Clone();
+	copy->num_buckets = num_buckets;
+	copy->fp_bits = fp_bits;
+	copy->num_elements = num_elements;
+	copy->table = table;
+	copy->victim_fp = victim_fp;
+	copy->victim_bucket = victim_bucket;
+	copy->rng = rng;
+
+	return copy;
+	}
+
+std::string CuckooFilter::InternalState() const
+	{
+	u_char buf[SHA256_DIGEST_LENGTH];
+	uint64 digest;
+	EVP_MD_CTX* ctx = hash_init(Hash_SHA256);
+
+	hash_update(ctx, table.data(), table.size() * sizeof(uint64_t));
+	hash_update(ctx, &victim_fp, sizeof(victim_fp));
+	hash_final(ctx, buf);
+	memcpy(&digest, buf, sizeof(digest));
+
+	return fmt("%" PRIu64, digest);
+	}
+
+broker::expected<broker::data> CuckooFilter::Serialize() const
+	{
+	auto h = hasher->Serialize();
+
+	if ( ! h )
+		return broker::ec::invalid_data; // Cannot serialize
+
+	broker::vector v = {std::move(*h), static_cast<uint64>(num_buckets),
+	                    static_cast<uint64>(fp_bits),
+	                    static_cast<uint64>(num_elements),
+	                    static_cast<uint64>(victim_fp),
+	                    static_cast<uint64>(victim_bucket)};
+
+	BlobWriter w(table.size() * sizeof(uint64_t));
+	w.AddArray(table.data(), table.size());
+	v.emplace_back(w.Take());
+
+	return {std::move(v)};
+	}
+
+std::unique_ptr<CuckooFilter> CuckooFilter::Unserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() >= 6) )
+		return nullptr;
+
+	auto num_buckets = caf::get_if<uint64>(&(*v)[1]);
+	auto fp_bits = caf::get_if<uint64>(&(*v)[2]);
+	auto num_elements = caf::get_if<uint64>(&(*v)[3]);
+	auto victim_fp = caf::get_if<uint64>(&(*v)[4]);
+	auto victim_bucket = caf::get_if<uint64>(&(*v)[5]);
+
+	if ( ! (num_buckets && fp_bits && num_elements && victim_fp && victim_bucket) )
+		return nullptr;
+
+	if ( *num_buckets == 0 || *num_buckets > 4294967296ULL ||
+	     *fp_bits < 4 || *fp_bits > 32 || *victim_bucket >= *num_buckets )
+		return nullptr;
+
+	auto cf = std::unique_ptr<CuckooFilter>(new CuckooFilter());
+	cf->num_buckets = *num_buckets;
+	cf->fp_bits = *fp_bits;
+	cf->num_elements = *num_elements;
+	cf->victim_fp = *victim_fp;
+	cf->victim_bucket = *victim_bucket;
+
+	size_t table_size = (cf->num_buckets * BUCKET_SIZE * cf->fp_bits + 63) / 64;
+	auto blob = v->size() == 7 ? caf::get_if<std::string>(&(*v)[6]) : nullptr;
+
+	if ( blob )
+		{
+		BlobReader r(*blob);
+
+		if ( r.Remaining() != table_size * sizeof(uint64_t) )
+			return nullptr;
+
+		cf->table.resize(table_size);
+
+		if ( ! r.GetArray(cf->table.data(), table_size) )
+			return nullptr;
+		}
+
+	else
+		{
+		// The layout before blobs, with an entry per table word.
+		if ( v->size() != 6 + table_size )
+			return nullptr;
+
+		cf->table.resize(table_size);
+
+		for ( size_t i = 0; i < table_size; ++i )
+			{
+			auto x = caf::get_if<uint64>(&(*v)[6 + i]);
+			if ( ! x )
+				return nullptr;
+
+			cf->table[i] = *x;
+			}
+		}
+
+	auto hasher_ = Hasher::Unserialize((*v)[0]);
+	if ( ! hasher_ )
+		return nullptr;
+
+	cf->hasher = hasher_.release();
+	return cf;
+	}
@@ -0,0 +1,160 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef PROBABILISTIC_CUCKOOFILTER_H
+#define PROBABILISTIC_CUCKOOFILTER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <broker/data.hh>
+#include <broker/expected.hh>
+
+#include "Hasher.h"
+
+namespace probabilistic {
+
+/**
+ * A cuckoo filter (Fan et al., "Cuckoo Filter: Practically Better Than
+ * Bloom", CoNEXT 2014). It stores a short fingerprint of each element in
+ * one of two buckets, which makes removing elements possible and needs
+ * less space than a Bloom filter for false-positive rates below about 3%.
+ *
+ * Unlike with a Bloom filter, adding elements fails once the filter is
+ * full. Removing an element that was never added may remove a different
+ * one that happens to share its fingerprint.
+ */
+class CuckooFilter {
+public:
+	/**
+	 * The number of fingerprints per bucket.
+	 */
+	static const size_t BUCKET_SIZE = 4;
+
+	/**
+	 * Constructs a cuckoo filter.
+	 *
+	 * @param hasher The hasher to use. Only its first hash function gets
+	 * used. The filter takes ownership.
+	 *
+	 * @param capacity The maximum number of elements.
+	 *
+	 * @param fingerprint_bits The bits of each fingerprint, between 4 and
+	 * 32. The ideal number can be computed with *FingerprintBits*.
+	 */
+	CuckooFilter(const Hasher* hasher, size_t capacity, size_t fingerprint_bits);
+
+	/**
+	 * Destructor.
+	 */
+	~CuckooFilter();
+
+	/**
+	 * Computes the number of fingerprint bits needed for a given false
+	 * positive rate.
+	 *
+	 * @param fp The false positive rate.
+	 *
+	 * @return The number of bits per fingerprint.
+	 */
+	static size_t FingerprintBits(double fp);
+
+	/**
+	 * Adds an element.
+	 *
+	 * @param key The key associated with the element to add.
+	 *
+	 * @return False if the filter is full.
+	 */
+	bool Add(const HashKey* key);
+
+	/**
+	 * Removes an element.
+	 *
+	 * @param key The key associated with the element to remove.
+	 *
+	 * @return False if the element isn't in the filter.
+	 */
+	bool Remove(const HashKey* key);
+
+	/**
+	 * Checks whether an element may be in the filter.
+	 *
+	 * @param key The key associated with the element to check.
+	 *
+	 * @return True if the element may have been added, false if it
+	 * definitely wasn't.
+	 */
+	bool Lookup(const HashKey* key) const;
+
+	/**
+	 * Returns the number of elements in the filter.
+	 */
+	uint64_t Size() const	{ return num_elements; }
+
+	/**
+	 * Removes all elements.
+	 */
+	void Clear();
+
+	/**
+	 * Adds the elements of another filter that has the same parameters.
+	 *
+	 * @param other The other filter.
+	 *
+	 * @return False if the filters don't match or this one got full;
+	 * it may have taken some of the elements then.
+	 */
+	bool Merge(const CuckooFilter* other);
+
+	/**
+	 * Constructs a copy of the filter.
+	 */
+	CuckooFilter* Clone() const;
+
+	/**
+	 * Returns a string with a representation of the filter's internal
+	 * state. This is for debugging/testing purposes only.
+	 */
+	std::string InternalState() const;
+
+	broker::expected<broker::data> Serialize() const;
+	static std::unique_ptr<CuckooFilter> Unserialize(const broker::data& data);
+
+private:
+	CuckooFilter();
+
+	// Splits a hash value into fingerprint and primary bucket.
+	void Locate(uint64_t h, uint32_t* fp, uint64_t* bucket) const;
+
+	// Returns the other bucket a fingerprint may go into.
+	uint64_t AltBucket(uint64_t bucket, uint32_t fp) const;
+
+	// Accessors for the packed fingerprints. An empty slot holds 0.
+	uint32_t Get(uint64_t bucket, size_t slot) const;
+	void Set(uint64_t bucket, size_t slot, uint32_t fp);
+
+	uint64_t NextRandom();
+	void Insert(uint64_t bucket, uint32_t fp);
+	bool InsertIntoBucket(uint64_t bucket, uint32_t fp);
+	bool RemoveFromBucket(uint64_t bucket, uint32_t fp);
+	bool BucketContains(uint64_t bucket, uint32_t fp) const;
+
+	const Hasher* hasher;
+	uint64_t num_buckets;
+	size_t fp_bits;
+	uint64_t num_elements;
+	std::vector<uint64_t> table;
+
+	// Once a fingerprint finds no place, it's kept aside and the filter
+	// counts as full; victim_fp is 0 otherwise.
+	uint32_t victim_fp;
+	uint64_t victim_bucket;
+
+	// For picking which fingerprint to move out of the way.
+	uint64_t rng;
+};
+
+}
+
+#endif
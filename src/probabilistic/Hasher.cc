@@ -3,10 +3,12 @@
 #include <typeinfo>
 #include <openssl/evp.h>
 
+#include "zeek-config.h"
 #include "Hasher.h"
 #include "NetVar.h"
 #include "digest.h"
 #include "siphash24.h"
+#include "wyhash.h"
 
 using namespace probabilistic;
 
@@ -40,6 +42,11 @@ Hasher::digest_vector Hasher::Hash(const HashKey* key) const
 	return Hash(key->Key(), key->Size());
 	}
 
+Hasher::digest Hasher::Single(const HashKey* key) const
+	{
+	return Single(key->Key(), key->Size());
+	}
+
 Hasher::Hasher(size_t arg_k, seed_t arg_seed)
 	{
 	k = arg_k;
@@ -78,6 +85,10 @@ std::unique_ptr<Hasher> Hasher::Unserialize(const broker::data& data)
 	case Double:
 		hasher = std::unique_ptr<Hasher>(new DoubleHasher(*k, {*h1, *h2}));
 		break;
+
+	case Wyhash:
+		hasher = std::unique_ptr<Hasher>(new WyHasher(*k, {*h1, *h2}));
+		break;
 	}
 
 	// Note that the derived classed don't hold any further state of
@@ -147,6 +158,11 @@ Hasher::digest_vector DefaultHasher::Hash(const void* x, size_t n) const
 	return h;
 	}
 
+Hasher::digest DefaultHasher::Single(const void* x, size_t n) const
+	{
+	return hash_functions[0](x, n);
+	}
+
 DefaultHasher* DefaultHasher::Clone() const
 	{
 	return new DefaultHasher(*this);
@@ -178,6 +194,11 @@ Hasher::digest_vector DoubleHasher::Hash(const void* x, size_t n) const
 	return h;
 	}
 
+Hasher::digest DoubleHasher::Single(const void* x, size_t n) const
+	{
+	return h1(x, n);
+	}
+
 DoubleHasher* DoubleHasher::Clone() const
 	{
 	return new DoubleHasher(*this);
@@ -192,3 +213,40 @@ bool DoubleHasher::Equals(const Hasher* other) const
 	return h1 == o->h1 && h2 == o->h2;
 	}
 
+WyHasher::WyHasher(size_t k, seed_t seed)
+	: Hasher(k, seed)
+	{
+	}
+
+Hasher::digest_vector WyHasher::Hash(const void* x, size_t n) const
+	{
+	// The second hash only needs to be independent enough for double
+	// hashing, another round of mixing with the rest of the seed is.
+	digest d1 = wyhash(x, n, Seed().h1);
+	digest d2 = wy_mix(d1 ^ Seed().h2, wy_secret[2]) | 1;
+	digest_vector h(K(), 0);
+
+	for ( size_t i = 0; i < h.size(); ++i )
+		h[i] = d1 + i * d2;
+
+	return h;
+	}
+
+Hasher::digest WyHasher::Single(const void* x, size_t n) const
+	{
+	return wyhash(x, n, Seed().h1);
+	}
+
+WyHasher* WyHasher::Clone() const
+	{
+	return new WyHasher(*this);
+	}
+
+bool WyHasher::Equals(const Hasher* other) const
+	{
+	if ( typeid(*this) != typeid(*other) )
+		return false;
+
+	return K() == other->K() && Seed().h1 == other->Seed().h1 &&
+	       Seed().h2 == other->Seed().h2;
+	}
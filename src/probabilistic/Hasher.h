@@ -13,7 +13,7 @@
 namespace probabilistic {
 
 /** Types of derived Hasher classes. */
-enum HasherType { Default, Double };
+enum HasherType { Default, Double, Wyhash };
 
 /**
  * Abstract base class for hashers. A hasher creates a family of hash
@@ -86,6 +86,28 @@ public:
 	 */
 	virtual digest_vector Hash(const void* x, size_t n) const = 0;
 
+	/**
+	 * Computes a single hash value for an element, for users that derive
+	 * their *k* positions themselves.
+	 *
+	 * @param key The key of the value to hash.
+	 *
+	 * @return The hash value.
+	 */
+	digest Single(const HashKey* key) const;
+
+	/**
+	 * Computes a single hash value for a set of bytes. It's the same as
+	 * the first one *Hash* returns.
+	 *
+	 * @param x Pointer to first byte to hash.
+	 *
+	 * @param n Number of bytes to hash.
+	 *
+	 * @return The hash value.
+	 */
+	virtual digest Single(const void* x, size_t n) const = 0;
+
 	/**
 	 * Returns a deep copy of the hasher.
 	 */
@@ -215,6 +237,7 @@ public:
 
 	// Overridden from Hasher.
 	digest_vector Hash(const void* x, size_t n) const final;
+	digest Single(const void* x, size_t n) const final;
 	DefaultHasher* Clone() const final;
 	bool Equals(const Hasher* other) const final;
 
@@ -244,6 +267,7 @@ public:
 
 	// Overridden from Hasher.
 	digest_vector Hash(const void* x, size_t n) const final;
+	digest Single(const void* x, size_t n) const final;
 	DoubleHasher* Clone() const final;
 	bool Equals(const Hasher* other) const final;
 
@@ -257,6 +281,37 @@ private:
 	UHF h2;
 };
 
+/**
+ * A hasher based on wyhash (Wang Yi, https://github.com/wangyi-fudan/wyhash),
+ * which is much faster than the default hash functions on longer inputs.
+ * It computes one 64-bit hash and derives the *k* values from it by double
+ * hashing. The results are the same on all platforms, so filters using it
+ * can be merged across nodes.
+ */
+class WyHasher : public Hasher {
+public:
+	/**
+	 * Constructor for a hasher with *k* hash functions.
+	 *
+	 * @param k The number of hash functions to use.
+	 *
+	 * @param seed The seed for the hasher.
+	 */
+	WyHasher(size_t k, Hasher::seed_t seed);
+
+	// Overridden from Hasher.
+	digest_vector Hash(const void* x, size_t n) const final;
+	digest Single(const void* x, size_t n) const final;
+	WyHasher* Clone() const final;
+	bool Equals(const Hasher* other) const final;
+
+private:
+	WyHasher() { }
+
+	HasherType Type() const override
+		{ return HasherType::Wyhash; }
+};
+
 }
 
 #endif
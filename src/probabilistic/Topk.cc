@@ -1,5 +1,7 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <string.h>
+
 #include <broker/error.hh>
 
 #include "broker/Data.h"
@@ -10,16 +12,7 @@
 
 namespace probabilistic {
 
-static void topk_element_hash_delete_func(void* val)
-	{
-	Element* e = (Element*) val;
-	delete e;
-	}
-
-Element::~Element()
-	{
-	Unref(value);
-	}
+const uint32 TopkVal::NONE;
 
 void TopkVal::Typify(BroType* t)
 	{
@@ -40,40 +33,246 @@ HashKey* TopkVal::GetHash(Val* v) const
 
 TopkVal::TopkVal(uint64 arg_size) : OpaqueVal(topk_type)
 	{
-	elementDict = new PDict(Element);
-	elementDict->SetDeleteFunc(topk_element_hash_delete_func);
 	size = arg_size;
 	type = 0;
 	numElements = 0;
 	pruned = false;
 	hash = 0;
+	firstBucket = lastBucket = NONE;
 	}
 
 TopkVal::TopkVal() : OpaqueVal(topk_type)
 	{
-	elementDict = new PDict(Element);
-	elementDict->SetDeleteFunc(topk_element_hash_delete_func);
 	size = 0;
 	type = 0;
 	numElements = 0;
+	pruned = false;
 	hash = 0;
+	firstBucket = lastBucket = NONE;
 	}
 
 TopkVal::~TopkVal()
 	{
-	elementDict->Clear();
-	delete elementDict;
+	for ( auto& e : elements )
+		Unref(e.value);
 
-	// now all elements are already gone - delete the buckets
-	std::list<Bucket*>::iterator bi = buckets.begin();
-	while ( bi != buckets.end() )
+	Unref(type);
+	delete hash;
+	}
+
+uint32 TopkVal::Lookup(const HashKey* key) const
+	{
+	if ( index.empty() )
+		return NONE;
+
+	size_t mask = index.size() - 1;
+
+	for ( size_t i = key->Hash() & mask; ; i = (i + 1) & mask )
 		{
-		delete *bi;
-		bi++;
+		uint32 e = index[i];
+
+		if ( e == NONE )
+			return NONE;
+
+		const Element& el = elements[e];
+
+		if ( el.hash == key->Hash() && el.key.size() == size_t(key->Size()) &&
+		     memcmp(el.key.data(), key->Key(), key->Size()) == 0 )
+			return e;
 		}
+	}
 
-	Unref(type);
-	delete hash;
+void TopkVal::IndexInsert(uint32 e)
+	{
+	auto place = [this](uint32 e)
+		{
+		size_t mask = index.size() - 1;
+		size_t i = elements[e].hash & mask;
+
+		while ( index[i] != NONE )
+			i = (i + 1) & mask;
+
+		index[i] = e;
+		};
+
+	// Keep the table at most half full.
+	if ( 2 * (numElements + 1) > index.size() )
+		{
+		size_t n = index.empty() ? 16 : 2 * index.size();
+
+		while ( 2 * (numElements + 1) > n )
+			n *= 2;
+
+		std::vector<uint32> old(n, NONE);
+		old.swap(index);
+
+		for ( auto i : old )
+			{
+			if ( i != NONE )
+				place(i);
+			}
+		}
+
+	place(e);
+	}
+
+void TopkVal::IndexRemove(uint32 e)
+	{
+	size_t mask = index.size() - 1;
+	size_t i = elements[e].hash & mask;
+
+	while ( index[i] != e )
+		i = (i + 1) & mask;
+
+	index[i] = NONE;
+
+	// Move later entries of the same run up into the gap, as long as
+	// that doesn't put them before their own slot.
+	for ( size_t j = (i + 1) & mask; index[j] != NONE; j = (j + 1) & mask )
+		{
+		size_t home = elements[index[j]].hash & mask;
+
+		if ( ((j - home) & mask) >= ((j - i) & mask) )
+			{
+			index[i] = index[j];
+			index[j] = NONE;
+			i = j;
+			}
+		}
+	}
+
+uint32 TopkVal::InsertBucket(uint64 count, uint32 after)
+	{
+	uint32 b;
+
+	if ( freeBuckets.empty() )
+		{
+		b = buckets.size();
+		buckets.push_back(Bucket());
+		}
+	else
+		{
+		b = freeBuckets.back();
+		freeBuckets.pop_back();
+		}
+
+	Bucket& nb = buckets[b];
+	nb.count = count;
+	nb.first = nb.last = NONE;
+	nb.prev = after;
+	nb.next = ( after == NONE ) ? firstBucket : buckets[after].next;
+
+	if ( nb.prev == NONE )
+		firstBucket = b;
+	else
+		buckets[nb.prev].next = b;
+
+	if ( nb.next == NONE )
+		lastBucket = b;
+	else
+		buckets[nb.next].prev = b;
+
+	return b;
+	}
+
+void TopkVal::RemoveBucket(uint32 b)
+	{
+	const Bucket& ob = buckets[b];
+	assert(ob.first == NONE);
+
+	if ( ob.prev == NONE )
+		firstBucket = ob.next;
+	else
+		buckets[ob.prev].next = ob.next;
+
+	if ( ob.next == NONE )
+		lastBucket = ob.prev;
+	else
+		buckets[ob.next].prev = ob.prev;
+
+	freeBuckets.push_back(b);
+	}
+
+void TopkVal::Append(uint32 b, uint32 e)
+	{
+	Element& el = elements[e];
+	Bucket& bu = buckets[b];
+
+	el.bucket = b;
+	el.prev = bu.last;
+	el.next = NONE;
+
+	if ( bu.last == NONE )
+		bu.first = e;
+	else
+		elements[bu.last].next = e;
+
+	bu.last = e;
+	}
+
+void TopkVal::Unlink(uint32 e)
+	{
+	Element& el = elements[e];
+	Bucket& bu = buckets[el.bucket];
+
+	if ( el.prev == NONE )
+		bu.first = el.next;
+	else
+		elements[el.prev].next = el.next;
+
+	if ( el.next == NONE )
+		bu.last = el.prev;
+	else
+		elements[el.next].prev = el.prev;
+	}
+
+uint32 TopkVal::AddElement(Val* value, const HashKey* key)
+	{
+	uint32 e;
+
+	if ( freeElements.empty() )
+		{
+		e = elements.size();
+		elements.push_back(Element());
+		}
+	else
+		{
+		e = freeElements.back();
+		freeElements.pop_back();
+		}
+
+	SetValue(e, value, key);
+	numElements++;
+
+	return e;
+	}
+
+void TopkVal::SetValue(uint32 e, Val* value, const HashKey* key)
+	{
+	Element& el = elements[e];
+	el.epsilon = 0;
+	el.value = value->Ref();
+	el.hash = key->Hash();
+	el.key.assign(static_cast<const char*>(key->Key()), key->Size());
+	IndexInsert(e);
+	}
+
+void TopkVal::RemoveElement(uint32 e)
+	{
+	Element& el = elements[e];
+	uint32 b = el.bucket;
+
+	IndexRemove(e);
+	Unlink(e);
+
+	if ( buckets[b].first == NONE )
+		RemoveBucket(b);
+
+	Unref(el.value);
+	el.value = 0;
+	el.key.clear();
+	freeElements.push_back(e);
+	numElements--;
 	}
 
 void TopkVal::Merge(const TopkVal* value, bool doPrune)
@@ -100,54 +299,36 @@ void TopkVal::Merge(const TopkVal* value, bool doPrune)
 			}
 		}
 
-	std::list<Bucket*>::const_iterator it = value->buckets.begin();
-	while ( it != value->buckets.end() )
+	for ( uint32 b = value->firstBucket; b != NONE; b = value->buckets[b].next )
 		{
-		Bucket* b = *it;
-		uint64_t currcount = b->count;
-		std::list<Element*>::const_iterator eit = b->elements.begin();
+		uint64_t currcount = value->buckets[b].count;
 
-		while ( eit != b->elements.end() )
+		for ( uint32 e = value->buckets[b].first; e != NONE; e = value->elements[e].next )
 			{
-			Element* e = *eit;
+			const Element& other = value->elements[e];
+
 			// lookup if we already know this one...
-			HashKey* key = GetHash(e->value);
-			Element* olde = (Element*) elementDict->Lookup(key);
+			HashKey* key = GetHash(other.value);
+			uint32 olde = Lookup(key);
 
-			if ( olde == 0 )
+			if ( olde == NONE )
 				{
-				olde = new Element();
-				olde->epsilon = 0;
-				olde->value = e->value->Ref();
-				// insert at bucket position 0
-				if ( buckets.size() > 0 )
-					{
-					assert (buckets.front()-> count > 0 );
-					}
-
-				Bucket* newbucket = new Bucket();
-				newbucket->count = 0;
-				newbucket->bucketPos = buckets.insert(buckets.begin(), newbucket);
-
-				olde->parent = newbucket;
-				newbucket->elements.insert(newbucket->elements.end(), olde);
+				olde = AddElement(other.value, key);
 
-				elementDict->Insert(key, olde);
-				numElements++;
+				// insert at bucket position 0
+				if ( firstBucket != NONE )
+					assert(buckets[firstBucket].count > 0);
 
+				Append(InsertBucket(0, NONE), olde);
 				}
 
 			// now that we are sure that the old element is present - increment epsilon
-			olde->epsilon += e->epsilon;
+			elements[olde].epsilon += other.epsilon;
 
 			// and increment position...
 			IncrementCounter(olde, currcount);
 			delete key;
-
-			eit++;
 			}
-
-		it++;
 		}
 
 	// now we have added everything. And our top-k table could be too big.
@@ -161,25 +342,8 @@ void TopkVal::Merge(const TopkVal* value, bool doPrune)
 	while ( numElements > size )
 		{
 		pruned = true;
-		assert(buckets.size() > 0 );
-		Bucket* b = buckets.front();
-		assert(b->elements.size() > 0);
-
-		Element* e = b->elements.front();
-		HashKey* key = GetHash(e->value);
-		elementDict->RemoveEntry(key);
-		delete key;
-		delete e;
-
-		b->elements.pop_front();
-
-		if ( b->elements.size() == 0 )
-			{
-			delete b;
-			buckets.pop_front();
-			}
-
-		numElements--;
+		assert(firstBucket != NONE);
+		RemoveElement(buckets[firstBucket].first);
 		}
 	}
 
@@ -207,24 +371,14 @@ VectorVal* TopkVal::GetTopK(int k) const // returns vector
 	// in any case - just to make this future-proof (and I am lazy) - this can return more than k.
 
 	int read = 0;
-	std::list<Bucket*>::const_iterator it = buckets.end();
-	it--;
-	while (read < k )
+
+	for ( uint32 b = lastBucket; b != NONE && read < k; b = buckets[b].prev )
 		{
-		//printf("Bucket %llu\n", (*it)->count);
-		std::list<Element*>::iterator eit = (*it)->elements.begin();
-		while ( eit != (*it)->elements.end() )
+		for ( uint32 e = buckets[b].first; e != NONE; e = elements[e].next )
 			{
-			//printf("Size: %ld\n", (*it)->elements.size());
-			t->Assign(read, (*eit)->value->Ref());
+			t->Assign(read, elements[e].value->Ref());
 			read++;
-			eit++;
 			}
-
-		if ( it == buckets.begin() )
-			break;
-
-		it--;
 		}
 
 	Unref(v);
@@ -234,43 +388,41 @@ VectorVal* TopkVal::GetTopK(int k) const // returns vector
 uint64_t TopkVal::GetCount(Val* value) const
 	{
 	HashKey* key = GetHash(value);
-	Element* e = (Element*) elementDict->Lookup(key);
+	uint32 e = Lookup(key);
 	delete key;
 
-	if ( e == 0 )
+	if ( e == NONE )
 		{
 		reporter->Error("GetCount for element that is not in top-k");
 		return 0;
 		}
 
-	return e->parent->count;
+	return buckets[elements[e].bucket].count;
 	}
 
 uint64_t TopkVal::GetEpsilon(Val* value) const
 	{
 	HashKey* key = GetHash(value);
-	Element* e = (Element*) elementDict->Lookup(key);
+	uint32 e = Lookup(key);
 	delete key;
 
-	if ( e == 0 )
+	if ( e == NONE )
 		{
 		reporter->Error("GetEpsilon for element that is not in top-k");
 		return 0;
 		}
 
-	return e->epsilon;
+	return elements[e].epsilon;
 	}
 
 uint64_t TopkVal::GetSum() const
 	{
 	uint64_t sum = 0;
 
-	std::list<Bucket*>::const_iterator it = buckets.begin();
-	while ( it != buckets.end() )
+	for ( uint32 b = firstBucket; b != NONE; b = buckets[b].next )
 		{
-		sum += (*it)->elements.size() * (*it)->count;
-
-		it++;
+		for ( uint32 e = buckets[b].first; e != NONE; e = elements[e].next )
+			sum += buckets[b].count;
 		}
 
 	if ( pruned )
@@ -294,37 +446,21 @@ void TopkVal::Encountered(Val* encountered)
 
 	// Step 1 - get the hash.
 	HashKey* key = GetHash(encountered);
-	Element* e = (Element*) elementDict->Lookup(key);
+	uint32 e = Lookup(key);
 
-	if ( e == 0 )
+	if ( e == NONE )
 		{
-		e = new Element();
-		e->epsilon = 0;
-		e->value = encountered->Ref(); // or no ref?
-
 		// well, we do not know this one yet...
 		if ( numElements < size )
 			{
+			e = AddElement(encountered, key);
+
 			// brilliant. just add it at position 1
-			if ( buckets.size() == 0 || (*buckets.begin())->count > 1 )
-				{
-				Bucket* b = new Bucket();
-				b->count = 1;
-				std::list<Bucket*>::iterator pos = buckets.insert(buckets.begin(), b);
-				b->bucketPos = pos;
-				b->elements.insert(b->elements.end(), e);
-				e->parent = b;
-				}
+			if ( firstBucket == NONE || buckets[firstBucket].count > 1 )
+				Append(InsertBucket(1, NONE), e);
 			else
-				{
-				Bucket* b = *buckets.begin();
-				assert(b->count == 1);
-				b->elements.insert(b->elements.end(), e);
-				e->parent = b;
-				}
+				Append(firstBucket, e);
 
-			elementDict->Insert(key, e);
-			numElements++;
 			delete key;
 
 			return; // done. it is at pos 1.
@@ -333,26 +469,22 @@ void TopkVal::Encountered(Val* encountered)
 		else
 			{
 			// replace element with min-value
-			Bucket* b = *buckets.begin(); // bucket with smallest elements
+			uint32 b = firstBucket; // bucket with smallest elements
 
-			// evict oldest element with least hits.
-			assert(b->elements.size() > 0);
-			HashKey* deleteKey = GetHash((*(b->elements.begin()))->value);
-			b->elements.erase(b->elements.begin());
-			Element* deleteElement = (Element*) elementDict->RemoveEntry(deleteKey);
-			assert(deleteElement); // there has to have been a minimal element...
-			delete deleteElement;
-			delete deleteKey;
+			// evict oldest element with least hits, reusing its entry.
+			assert(b != NONE);
+			e = buckets[b].first;
+			IndexRemove(e);
+			Unlink(e);
+			Unref(elements[e].value);
 
 			// and add the new one to the end
-			e->epsilon = b->count;
-			b->elements.insert(b->elements.end(), e);
-			elementDict->Insert(key, e);
-			e->parent = b;
+			SetValue(e, encountered, key);
+			elements[e].epsilon = buckets[b].count;
+			Append(b, e);
 
 			// fallthrough, increment operation has to run!
 			}
-
 		}
 
 	// ok, we now have an element in e
@@ -361,51 +493,32 @@ void TopkVal::Encountered(Val* encountered)
 	}
 
 // increment by count
-void TopkVal::IncrementCounter(Element* e, unsigned int count)
+void TopkVal::IncrementCounter(uint32 e, uint64 count)
 	{
-	Bucket* currBucket = e->parent;
-	uint64 currcount = currBucket->count;
-
-	// well, let's test if there is a bucket for currcount++
-	std::list<Bucket*>::iterator bucketIter = currBucket->bucketPos;
+	uint32 currBucket = elements[e].bucket;
+	uint64 target = buckets[currBucket].count + count;
 
-	Bucket* nextBucket = 0;
+	// well, let's test if there is a bucket for the new count. pos ends
+	// up as the last one with a smaller count.
+	uint32 pos = currBucket;
 
-	bucketIter++;
+	while ( buckets[pos].next != NONE && buckets[buckets[pos].next].count < target )
+		pos = buckets[pos].next;
 
-	while ( bucketIter != buckets.end() && (*bucketIter)->count < currcount+count )
-		bucketIter++;
+	uint32 nextBucket = buckets[pos].next;
 
-	if ( bucketIter != buckets.end() && (*bucketIter)->count == currcount+count )
-		nextBucket = *bucketIter;
-
-	if ( nextBucket == 0 )
-		{
+	if ( nextBucket == NONE || buckets[nextBucket].count != target )
 		// the bucket for the value that we want does not exist.
 		// create it...
-
-		Bucket* b = new Bucket();
-		b->count = currcount+count;
-
-		std::list<Bucket*>::iterator nextBucketPos = buckets.insert(bucketIter, b);
-		b->bucketPos = nextBucketPos; // and give it the iterator we know now.
-
-		nextBucket = b;
-		}
+		nextBucket = InsertBucket(target, pos);
 
 	// ok, now we have the new bucket in nextBucket. Shift the element over...
-	currBucket->elements.remove(e);
-	nextBucket->elements.insert(nextBucket->elements.end(), e);
-
-	e->parent = nextBucket;
+	Unlink(e);
+	Append(nextBucket, e);
 
 	// if currBucket is empty, we have to delete it now
-	if ( currBucket->elements.size() == 0 )
-		{
-		buckets.remove(currBucket);
-		delete currBucket;
-		currBucket = 0;
-		}
+	if ( buckets[currBucket].first == NONE )
+		RemoveBucket(currBucket);
 	}
 
 IMPLEMENT_OPAQUE_VALUE(TopkVal)
@@ -426,31 +539,30 @@ broker::expected<broker::data> TopkVal::DoSerialize() const
 		d.emplace_back(broker::none());
 
 	uint64_t i = 0;
-	std::list<Bucket*>::const_iterator it = buckets.begin();
-	while ( it != buckets.end() )
+
+	for ( uint32 b = firstBucket; b != NONE; b = buckets[b].next )
 		{
-		Bucket* b = *it;
-		uint32_t elements_count = b->elements.size();
+		// Filled in once we know it.
+		size_t elements_count_idx = d.size();
+		uint64 elements_count = 0;
 
-		d.emplace_back(static_cast<uint64>(b->elements.size()));
-		d.emplace_back(b->count);
+		d.emplace_back(elements_count);
+		d.emplace_back(buckets[b].count);
 
-		std::list<Element*>::const_iterator eit = b->elements.begin();
-		while ( eit != b->elements.end() )
+		for ( uint32 e = buckets[b].first; e != NONE; e = elements[e].next )
 			{
-			Element* element = *eit;
-			d.emplace_back(element->epsilon);
-			auto v = bro_broker::val_to_data(element->value);
+			d.emplace_back(elements[e].epsilon);
+			auto v = bro_broker::val_to_data(elements[e].value);
 			if ( ! v )
 				return broker::ec::invalid_data;
 
 			d.emplace_back(*v);
 
-			eit++;
+			elements_count++;
 			i++;
 			}
 
-		it++;
+		d[elements_count_idx] = elements_count;
 		}
 
 	assert(i == numElements);
@@ -473,7 +585,6 @@ bool TopkVal::DoUnserialize(const broker::data& data)
 		return false;
 
 	size = *size_;
-	numElements = *numElements_;
 	pruned = *pruned_;
 
 	auto no_type = caf::get_if<broker::none>(&(*v)[3]);
@@ -487,47 +598,50 @@ bool TopkVal::DoUnserialize(const broker::data& data)
 		Unref(t);
 		}
 
-	uint64_t i = 0;
 	uint64_t idx = 4;
 
-	while ( i < numElements )
+	while ( numElements < *numElements_ )
 		{
-		Bucket* b = new Bucket();
+		if ( idx + 2 > v->size() )
+			return false;
+
 		auto elements_count = caf::get_if<uint64>(&(*v)[idx++]);
 		auto count = caf::get_if<uint64>(&(*v)[idx++]);
 
 		if ( ! (elements_count && count) )
 			return false;
 
-		b->count = *count;
-		b->bucketPos = buckets.insert(buckets.end(), b);
+		uint32 b = InsertBucket(*count, lastBucket);
 
 		for ( uint64_t j = 0; j < *elements_count; j++ )
 			{
-			Element* e = new Element();
+			if ( idx + 2 > v->size() )
+				return false;
+
 			auto epsilon = caf::get_if<uint64>(&(*v)[idx++]);
 			Val* val = bro_broker::data_to_val((*v)[idx++], type);
 
 			if ( ! (epsilon && val) )
+				{
+				Unref(val);
 				return false;
+				}
 
-			e->epsilon = *epsilon;
-			e->value = val;
-			e->parent = b;
-
-			b->elements.insert(b->elements.end(), e);
+			HashKey* key = GetHash(val);
+			assert(Lookup(key) == NONE);
 
-			HashKey* key = GetHash(e->value);
-			assert (elementDict->Lookup(key) == 0);
+			uint32 e = AddElement(val, key);
+			elements[e].epsilon = *epsilon;
+			Append(b, e);
 
-			elementDict->Insert(key, e);
 			delete key;
-
-			i++;
+			Unref(val);
 			}
+
+		if ( buckets[b].first == NONE )
+			RemoveBucket(b);
 		}
 
-	assert(i == numElements);
-	return true;
+	return numElements == *numElements_;
 	}
 }
@@ -3,38 +3,46 @@
 #ifndef topk_h
 #define topk_h
 
-#include <list>
+#include <string>
+#include <vector>
+
 #include "Val.h"
 #include "CompHash.h"
 #include "OpaqueVal.h"
 
 // This class implements the top-k algorithm. Or - to be more precise - an
 // interpretation of it.
+//
+// The elements are kept in a Stream-Summary (Metwally et al., "Efficient
+// Computation of Frequent and Top-k Elements in Data Streams", 2005):
+// buckets of the elements that have the same count, in a list sorted by
+// count. Both live in flat arrays and refer to each other by index, and an
+// open-addressing table finds the element for a value.
 
 namespace probabilistic {
 
-struct Element;
+struct Element {
+	uint64 epsilon;
+	Val* value; // 0 for unused entries
+	hash_t hash;
+	std::string key; // contents of the value's HashKey
+	uint32 bucket;
+
+	// Neighbors in the bucket, oldest first.
+	uint32 prev;
+	uint32 next;
+};
 
 struct Bucket {
 	uint64 count;
-	std::list<Element*> elements;
+	uint32 first;
+	uint32 last;
 
-	// Iterators only get invalidated for removed elements. This one
-	// points to us - so it is invalid when we are no longer there. Cute,
-	// isn't it?
-	std::list<Bucket*>::iterator bucketPos;
+	// Neighbors in the list of buckets, smallest count first.
+	uint32 prev;
+	uint32 next;
 };
 
-struct Element {
-	uint64 epsilon;
-	Val* value;
-	Bucket* parent;
-
-	~Element();
-};
-
-declare(PDict, Element);
-
 class TopkVal : public OpaqueVal {
 
 public:
@@ -143,11 +151,11 @@ private:
 	/**
 	 * Increment the counter for a specific element
 	 *
-	 * @param e element to increment counter for
+	 * @param e index of the element to increment the counter for
 	 *
 	 * @param count increment counter by this much
 	 */
-	void IncrementCounter(Element* e, unsigned int count = 1);
+	void IncrementCounter(uint32 e, uint64 count = 1);
 
 	/**
 	 * get the hashkey for a specific value
@@ -158,6 +166,59 @@ private:
 	 */
 	HashKey* GetHash(Val* v) const; // this probably should go somewhere else.
 
+	/**
+	 * Look up the element for a hash key.
+	 *
+	 * @param key hash key of the value
+	 *
+	 * @returns index of the element, or NONE if it isn't tracked
+	 */
+	uint32 Lookup(const HashKey* key) const;
+
+	/**
+	 * Add an element for a value. The caller has to put it into a
+	 * bucket.
+	 *
+	 * @param value the value, of which the element takes a reference
+	 *
+	 * @param key hash key of the value
+	 *
+	 * @returns index of the element
+	 */
+	uint32 AddElement(Val* value, const HashKey* key);
+
+	/**
+	 * Make an unused element hold a value, with an epsilon of 0.
+	 *
+	 * @param e index of the element
+	 *
+	 * @param value the value, of which the element takes a reference
+	 *
+	 * @param key hash key of the value
+	 */
+	void SetValue(uint32 e, Val* value, const HashKey* key);
+
+	/**
+	 * Remove an element, along with its bucket if that ends up empty.
+	 *
+	 * @param e index of the element
+	 */
+	void RemoveElement(uint32 e);
+
+	/**
+	 * Helpers for maintaining the lists of buckets and elements.
+	 */
+	uint32 InsertBucket(uint64 count, uint32 after);
+	void RemoveBucket(uint32 b);
+	void Append(uint32 b, uint32 e);
+	void Unlink(uint32 e);
+
+	/**
+	 * Helpers for maintaining the index of elements.
+	 */
+	void IndexInsert(uint32 e);
+	void IndexRemove(uint32 e);
+
 	/**
 	 * Set the type that this TopK instance tracks
 	 *
@@ -167,8 +228,21 @@ private:
 
 	BroType* type;
 	CompositeHash* hash;
-	std::list<Bucket*> buckets;
-	PDict(Element)* elementDict;
+
+	// Marks the end of lists and free entries.
+	static const uint32 NONE = 0xffffffff;
+
+	std::vector<Element> elements;
+	std::vector<Bucket> buckets;
+	std::vector<uint32> freeElements;
+	std::vector<uint32> freeBuckets;
+	uint32 firstBucket; // smallest count
+	uint32 lastBucket; // largest count
+
+	// Open addressing with linear probing; holds element indices, and
+	// NONE for empty slots. Its size is a power of two.
+	std::vector<uint32> index;
+
 	uint64 size; // how many elements are we tracking?
 	uint64 numElements; // how many elements do we have at the moment
 	bool pruned; // was this data structure pruned?
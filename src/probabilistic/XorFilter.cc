@@ -0,0 +1,301 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+#include "XorFilter.h"
+
+#include <broker/error.hh>
+
+#include "../digest.h"
+#include "../util.h"
+
+using namespace probabilistic;
+
+// How often to try different seeds before giving up on building a filter.
+// Each try fails with a probability of only about 1/1000 already.
+static const int MAX_TRIES = 100;
+
+static inline uint64_t mix(uint64_t h, uint64_t seed)
+	{
+	// The MurmurHash3 finalizer.
+	h += seed;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+	}
+
+static inline uint64_t reduce(uint32_t x, uint64_t n)
+	{
+	return (uint64_t(x) * n) >> 32;
+	}
+
+static inline uint64_t rotl(uint64_t x, unsigned int n)
+	{
+	return (x << n) | (x >> (64 - n));
+	}
+
+XorFilter::XorFilter()
+	{
+	hasher = 0;
+	seed = 0;
+	num_elements = 0;
+	segment_length = 0;
+	fp_bytes = 0;
+	}
+
+XorFilter::XorFilter(const Hasher* arg_hasher, size_t fingerprint_bits)
+	{
+	hasher = arg_hasher;
+	seed = 0;
+	num_elements = 0;
+	segment_length = 0;
+
+	if ( fingerprint_bits <= 8 )
+		fp_bytes = 1;
+	else if ( fingerprint_bits <= 16 )
+		fp_bytes = 2;
+	else
+		fp_bytes = 4;
+	}
+
+XorFilter::~XorFilter()
+	{
+	delete hasher;
+	}
+
+size_t XorFilter::FingerprintBits(double fp)
+	{
+	// A random element matches with a probability of 2^-bits.
+	double bits = std::ceil(-std::log2(fp));
+
+	if ( bits <= 8 )
+		return 8;
+
+	if ( bits <= 16 )
+		return 16;
+
+	return 32;
+	}
+
+void XorFilter::Slots(uint64_t x, uint64_t* slots) const
+	{
+	// One slot in each third of the table.
+	slots[0] = reduce(x, segment_length);
+	slots[1] = reduce(rotl(x, 21), segment_length) + segment_length;
+	slots[2] = reduce(rotl(x, 42), segment_length) + 2 * segment_length;
+	}
+
+uint32_t XorFilter::Fingerprint(uint64_t x) const
+	{
+	uint64_t fp = x ^ (x >> 32);
+	return fp_bytes == 4 ? uint32_t(fp) : fp & ((1u << (8 * fp_bytes)) - 1);
+	}
+
+uint32_t XorFilter::Get(uint64_t i) const
+	{
+	const unsigned char* p =
+		reinterpret_cast<const unsigned char*>(fingerprints.data()) + i * fp_bytes;
+	uint32_t fp = 0;
+
+	for ( size_t j = 0; j < fp_bytes; ++j )
+		fp |= uint32_t(p[j]) << (8 * j);
+
+	return fp;
+	}
+
+void XorFilter::Set(uint64_t i, uint32_t fp)
+	{
+	for ( size_t j = 0; j < fp_bytes; ++j )
+		fingerprints[i * fp_bytes + j] = (fp >> (8 * j)) & 0xff;
+	}
+
+bool XorFilter::Build(const std::vector<HashKey*>& keys)
+	{
+	std::vector<uint64_t> hashes;
+	hashes.reserve(keys.size());
+
+	for ( const auto& k : keys )
+		hashes.push_back(hasher->Single(k));
+
+	// Equal hash values would never get peeled off below.
+	std::sort(hashes.begin(), hashes.end());
+	hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+	num_elements = hashes.size();
+	segment_length = (32 + uint64_t(std::ceil(1.23 * num_elements))) / 3;
+	uint64_t num_slots = 3 * segment_length;
+
+	std::vector<uint64_t> xors(num_slots);
+	std::vector<uint32_t> counts(num_slots);
+	std::vector<uint64_t> queue;
+	std::vector<std::pair<uint64_t, uint64_t>> stack;
+	queue.reserve(num_slots);
+	stack.reserve(num_elements);
+
+	for ( int tries = 0; ; ++tries )
+		{
+		if ( tries == MAX_TRIES )
+			return false;
+
+		seed = mix(tries, 0x726f6c6c);
+
+		std::fill(xors.begin(), xors.end(), 0);
+		std::fill(counts.begin(), counts.end(), 0);
+		queue.clear();
+		stack.clear();
+
+		// Record which elements hit each slot. With the elements
+		// xor-ed together, the one left in a slot hit once is known.
+		for ( auto h : hashes )
+			{
+			uint64_t x = mix(h, seed);
+			uint64_t s[3];
+			Slots(x, s);
+
+			for ( int j = 0; j < 3; ++j )
+				{
+				xors[s[j]] ^= x;
+				++counts[s[j]];
+				}
+			}
+
+		for ( uint64_t i = 0; i < num_slots; ++i )
+			{
+			if ( counts[i] == 1 )
+				queue.push_back(i);
+			}
+
+		// Peel off elements that have a slot to themselves, which may
+		// leave other ones alone in their slots.
+		while ( ! queue.empty() )
+			{
+			uint64_t i = queue.back();
+			queue.pop_back();
+
+			if ( counts[i] != 1 )
+				continue;
+
+			uint64_t x = xors[i];
+			stack.push_back(std::make_pair(x, i));
+
+			uint64_t s[3];
+			Slots(x, s);
+
+			for ( int j = 0; j < 3; ++j )
+				{
+				xors[s[j]] ^= x;
+
+				if ( --counts[s[j]] == 1 )
+					queue.push_back(s[j]);
+				}
+			}
+
+		if ( stack.size() == num_elements )
+			break;
+		}
+
+	// In reverse order of peeling, each element's own slot is still
+	// free, so it can make the three xor to the fingerprint.
+	fingerprints.assign(num_slots * fp_bytes, '\0');
+
+	for ( auto e = stack.rbegin(); e != stack.rend(); ++e )
+		{
+		uint64_t s[3];
+		Slots(e->first, s);
+		Set(e->second, Fingerprint(e->first) ^ Get(s[0]) ^ Get(s[1]) ^ Get(s[2]));
+		}
+
+	return true;
+	}
+
+bool XorFilter::Lookup(const HashKey* key) const
+	{
+	if ( ! num_elements )
+		return false;
+
+	uint64_t x = mix(hasher->Single(key), seed);
+	uint64_t s[3];
+	Slots(x, s);
+
+	return Fingerprint(x) == (Get(s[0]) ^ Get(s[1]) ^ Get(s[2]));
+	}
+
+XorFilter* XorFilter::Clone() const
+	{
+	XorFilter* copy = new XorFilter();
+
+	copy->hasher = hasher->Clone();
+	copy->seed = seed;
+	copy->num_elements = num_elements;
+	copy->segment_length = segment_length;
+	copy->fp_bytes = fp_bytes;
+	copy->fingerprints = fingerprints;
+
+	return copy;
+	}
+
+std::string XorFilter::InternalState() const
+	{
+	u_char buf[SHA256_DIGEST_LENGTH];
+	uint64 digest;
+	EVP_MD_CTX* ctx = hash_init(Hash_SHA256);
+
+	hash_update(ctx, &seed, sizeof(seed));
+	hash_update(ctx, fingerprints.data(), fingerprints.size());
+	hash_final(ctx, buf);
+	memcpy(&digest, buf, sizeof(digest));
+
+	return fmt("%" PRIu64, digest);
+	}
+
+broker::expected<broker::data> XorFilter::Serialize() const
+	{
+	auto h = hasher->Serialize();
+
+	if ( ! h )
+		return broker::ec::invalid_data; // Cannot serialize
+
+	return {broker::vector{std::move(*h), static_cast<uint64>(seed),
+	                       static_cast<uint64>(num_elements),
+	                       static_cast<uint64>(segment_length),
+	                       static_cast<uint64>(fp_bytes), fingerprints}};
+	}
+
+std::unique_ptr<XorFilter> XorFilter::Unserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() == 6) )
+		return nullptr;
+
+	auto seed = caf::get_if<uint64>(&(*v)[1]);
+	auto num_elements = caf::get_if<uint64>(&(*v)[2]);
+	auto segment_length = caf::get_if<uint64>(&(*v)[3]);
+	auto fp_bytes = caf::get_if<uint64>(&(*v)[4]);
+	auto fingerprints = caf::get_if<std::string>(&(*v)[5]);
+
+	if ( ! (seed && num_elements && segment_length && fp_bytes && fingerprints) )
+		return nullptr;
+
+	if ( ! (*fp_bytes == 1 || *fp_bytes == 2 || *fp_bytes == 4) ||
+	     fingerprints->size() != 3 * *segment_length * *fp_bytes )
+		return nullptr;
+
+	auto hasher_ = Hasher::Unserialize((*v)[0]);
+	if ( ! hasher_ )
+		return nullptr;
+
+	auto xf = std::unique_ptr<XorFilter>(new XorFilter());
+	xf->hasher = hasher_.release();
+	xf->seed = *seed;
+	xf->num_elements = *num_elements;
+	xf->segment_length = *segment_length;
+	xf->fp_bytes = *fp_bytes;
+	xf->fingerprints = *fingerprints;
+	return xf;
+	}
@@ -0,0 +1,115 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef PROBABILISTIC_XORFILTER_H
+#define PROBABILISTIC_XORFILTER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <broker/data.hh>
+#include <broker/expected.hh>
+
+#include "Hasher.h"
+
+namespace probabilistic {
+
+/**
+ * A xor filter (Graf and Lemire, "Xor Filters: Faster and Smaller Than
+ * Bloom and Cuckoo Filters", 2019). It gets built once from a fixed set of
+ * elements and can't change afterwards. In return, it needs about 1.23
+ * fingerprints per element and a lookup reads three of them.
+ */
+class XorFilter {
+public:
+	/**
+	 * Constructs an empty xor filter. Call *Build* to fill it.
+	 *
+	 * @param hasher The hasher to use. Only its first hash function gets
+	 * used. The filter takes ownership.
+	 *
+	 * @param fingerprint_bits The bits per fingerprint: 8, 16, or 32.
+	 * The right number can be computed with *FingerprintBits*.
+	 */
+	XorFilter(const Hasher* hasher, size_t fingerprint_bits);
+
+	/**
+	 * Destructor.
+	 */
+	~XorFilter();
+
+	/**
+	 * Computes the number of fingerprint bits needed for a given false
+	 * positive rate.
+	 *
+	 * @param fp The false positive rate.
+	 *
+	 * @return The number of bits per fingerprint.
+	 */
+	static size_t FingerprintBits(double fp);
+
+	/**
+	 * Builds the filter from a set of elements, replacing any earlier
+	 * contents.
+	 *
+	 * @param keys The keys associated with the elements.
+	 *
+	 * @return False if no filter could be constructed, which is
+	 * practically impossible.
+	 */
+	bool Build(const std::vector<HashKey*>& keys);
+
+	/**
+	 * Checks whether an element may be in the filter.
+	 *
+	 * @param key The key associated with the element to check.
+	 *
+	 * @return True if the element may have been part of the set, false if
+	 * it definitely wasn't.
+	 */
+	bool Lookup(const HashKey* key) const;
+
+	/**
+	 * Returns the number of elements the filter got built from.
+	 */
+	uint64_t Size() const	{ return num_elements; }
+
+	/**
+	 * Constructs a copy of the filter.
+	 */
+	XorFilter* Clone() const;
+
+	/**
+	 * Returns a string with a representation of the filter's internal
+	 * state. This is for debugging/testing purposes only.
+	 */
+	std::string InternalState() const;
+
+	broker::expected<broker::data> Serialize() const;
+	static std::unique_ptr<XorFilter> Unserialize(const broker::data& data);
+
+private:
+	XorFilter();
+
+	// Derives the three slots and the fingerprint of a hash value that
+	// got mixed with the seed.
+	void Slots(uint64_t x, uint64_t* slots) const;
+	uint32_t Fingerprint(uint64_t x) const;
+
+	uint32_t Get(uint64_t i) const;
+	void Set(uint64_t i, uint32_t fp);
+
+	const Hasher* hasher;
+	uint64_t seed;
+	uint64_t num_elements;
+	uint64_t segment_length;
+	size_t fp_bytes;
+
+	// The fingerprints, fp_bytes each, in little-endian order.
+	std::string fingerprints;
+};
+
+}
+
+#endif
@@ -113,12 +113,19 @@ void BasicThread::Start()
 	started = true;
 
 	thread = std::thread(&BasicThread::launcher, this);
+	Place();
 
 	DBG_LOG(DBG_THREADING, "Started thread %s", name);
 
 	OnStart();
 	}
 
+void BasicThread::Place()
+	{
+	if ( started && ! terminating && ! killed )
+		thread_mgr->PlaceThread(thread);
+	}
+
 void BasicThread::SignalStop()
 	{
 	if ( ! started )
@@ -72,6 +72,14 @@ public:
 	 */
 	void Start();
 
+	/**
+	 * Moves the thread, if started, to the CPUs that the thread manager
+	 * has for threads other than the main one. Start() does so already.
+	 *
+	 * Only Bro's main thread must call this method.
+	 */
+	void Place();
+
 	/**
 	 * Signals the thread to prepare for stopping, but doesn't block to
 	 * wait for that to happen. Use WaitForStop() for that.
@@ -24,24 +24,31 @@ Formatter::~Formatter()
 
 string Formatter::Render(const threading::Value::addr_t& addr)
 	{
+	char s[INET6_ADDRSTRLEN];
+	return string(s, Render(addr, s));
+	}
+
+int Formatter::Render(const threading::Value::addr_t& addr, char* buf)
+	{
+	const char* err;
+
 	if ( addr.family == IPv4 )
 		{
-		char s[INET_ADDRSTRLEN];
+		if ( bro_inet_ntop(AF_INET, &addr.in.in4, buf, INET_ADDRSTRLEN) )
+			return strlen(buf);
 
-		if ( ! bro_inet_ntop(AF_INET, &addr.in.in4, s, INET_ADDRSTRLEN) )
-			return "<bad IPv4 address conversion>";
-		else
-			return s;
+		err = "<bad IPv4 address conversion>";
 		}
 	else
 		{
-		char s[INET6_ADDRSTRLEN];
+		if ( bro_inet_ntop(AF_INET6, &addr.in.in6, buf, INET6_ADDRSTRLEN) )
+			return strlen(buf);
 
-		if ( ! bro_inet_ntop(AF_INET6, &addr.in.in6, s, INET6_ADDRSTRLEN) )
-			return "<bad IPv6 address conversion>";
-		else
-			return s;
+		err = "<bad IPv6 address conversion>";
 		}
+
+	strcpy(buf, err);
+	return strlen(err);
 	}
 
 TransportProto Formatter::ParseProto(const string &proto) const
@@ -107,7 +114,11 @@ string Formatter::Render(const threading::Value::subnet_t& subnet)
 string Formatter::Render(double d)
 	{
 	char buf[256];
-	modp_dtoa(d, buf, 6);
-	return buf;
+	return string(buf, Render(d, buf));
+	}
+
+int Formatter::Render(double d, char* buf)
+	{
+	return modp_dtoa_n(d, buf, 6, 0);
 	}
 
@@ -89,6 +89,20 @@ public:
 	 */
 	static string Render(const threading::Value::addr_t& addr);
 
+	/**
+	 * Writes an IP address into a buffer, the same as Render() returns.
+	 * That saves building a string for each address written.
+	 *
+	 * This is a helper function that formatter implementations may use.
+	 *
+	 * @param addr The address.
+	 *
+	 * @param buf The buffer, with room for INET6_ADDRSTRLEN characters.
+	 *
+	 * @return The length written, without the terminating NUL.
+	 */
+	static int Render(const threading::Value::addr_t& addr, char* buf);
+
 	/**
 	 * Convert an subnet value into a string.
 	 *
@@ -112,6 +126,20 @@ public:
 	 */
 	static string Render(double d);
 
+	/**
+	 * Writes a double into a buffer, the same as Render() returns. That
+	 * saves building a string for each timestamp and interval.
+	 *
+	 * This is a helper function that formatter implementations may use.
+	 *
+	 * @param d The double.
+	 *
+	 * @param buf The buffer, with room for 256 characters.
+	 *
+	 * @return The length written, without the terminating NUL.
+	 */
+	static int Render(double d, char* buf);
+
 	/**
 	 * Convert a string into a TransportProto. The string must be one of
 	 * \c tcp, \c udp, \c icmp, or \c unknown.
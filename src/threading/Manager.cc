@@ -1,9 +1,83 @@
 
+#include "zeek-config.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <fstream>
+#include <string>
+
 #include "Manager.h"
 #include "NetVar.h"
 
 using namespace threading;
 
+#ifdef HAVE_LINUX
+
+// Returns the NUMA node of a CPU, or -1 if there's no such information.
+static int cpu_node(int cpu)
+	{
+	std::string dir = fmt("/sys/devices/system/cpu/cpu%d", cpu);
+	DIR* d = opendir(dir.c_str());
+
+	if ( ! d )
+		return -1;
+
+	int node = -1;
+
+	while ( struct dirent* e = readdir(d) )
+		{
+		if ( strncmp(e->d_name, "node", 4) == 0 && isdigit(e->d_name[4]) )
+			{
+			node = atoi(e->d_name + 4);
+			break;
+			}
+		}
+
+	closedir(d);
+	return node;
+	}
+
+// Parses a CPU list like "0-3,8-11" from sysfs, returning false if it
+// can't be read.
+static bool read_cpu_list(const std::string& path, std::vector<int>* cpus)
+	{
+	std::ifstream in(path);
+	std::string list;
+
+	if ( ! std::getline(in, list) )
+		return false;
+
+	const char* p = list.c_str();
+
+	while ( isdigit(*p) )
+		{
+		char* end;
+		int first = strtol(p, &end, 10);
+		int last = first;
+
+		if ( *end == '-' )
+			last = strtol(end + 1, &end, 10);
+
+		for ( int i = first; i <= last; ++i )
+			cpus->push_back(i);
+
+		p = (*end == ',') ? end + 1 : end;
+		}
+
+	return true;
+	}
+
+#endif
+
 Manager::Manager()
 	{
 	DBG_LOG(DBG_THREADING, "Creating thread manager ...");
@@ -11,6 +85,7 @@ Manager::Manager()
 	did_process = true;
 	next_beat = 0;
 	terminating = false;
+	main_node = -1;
 	SetIdle(true);
 	}
 
@@ -52,6 +127,92 @@ void Manager::Terminate()
 	terminating = false;
 	}
 
+bool Manager::PinMainThread(int cpu)
+	{
+#ifdef HAVE_LINUX
+	// The CPUs we may use at all.
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+
+	if ( sched_getaffinity(0, sizeof(allowed), &allowed) < 0 )
+		{
+		reporter->Warning("can't get CPU affinity: %s", strerror(errno));
+		return false;
+		}
+
+	if ( cpu < 0 || cpu >= CPU_SETSIZE || ! CPU_ISSET(cpu, &allowed) )
+		{
+		reporter->Warning("can't pin the main thread to CPU %d: not available", cpu);
+		return false;
+		}
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+
+	if ( sched_setaffinity(0, sizeof(set), &set) < 0 )
+		{
+		reporter->Warning("can't pin the main thread to CPU %d: %s", cpu, strerror(errno));
+		return false;
+		}
+
+	// The other threads get the rest of the node, or, without NUMA, of
+	// the machine.
+	std::vector<int> node_cpus;
+	main_node = cpu_node(cpu);
+
+	if ( main_node < 0 ||
+	     ! read_cpu_list(fmt("/sys/devices/system/node/node%d/cpulist", main_node), &node_cpus) )
+		{
+		for ( int i = 0; i < CPU_SETSIZE; ++i )
+			node_cpus.push_back(i);
+		}
+
+	thread_cpus.clear();
+
+	for ( auto c : node_cpus )
+		{
+		if ( c != cpu && c < CPU_SETSIZE && CPU_ISSET(c, &allowed) )
+			thread_cpus.push_back(c);
+		}
+
+	// A node of a single CPU has to share it.
+	if ( thread_cpus.empty() )
+		thread_cpus.push_back(cpu);
+
+	DBG_LOG(DBG_THREADING, "Pinned main thread to CPU %d on node %d, %zu CPUs for other threads",
+		cpu, main_node, thread_cpus.size());
+
+	for ( auto t : all_threads )
+		t->Place();
+
+	return true;
+#else
+	reporter->Warning("pinning threads to CPUs is not supported on this platform");
+	return false;
+#endif
+	}
+
+void Manager::PlaceThread(std::thread& thread)
+	{
+#ifdef HAVE_LINUX
+	if ( thread_cpus.empty() || ! thread.joinable() )
+		return;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for ( auto c : thread_cpus )
+		CPU_SET(c, &set);
+
+	int err = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+
+	// The thread may have finished already.
+	if ( err && err != ESRCH )
+		reporter->Warning("can't set CPU affinity of a thread: %s", strerror(err));
+#endif
+	}
+
 void Manager::AddThread(BasicThread* thread)
 	{
 	DBG_LOG(DBG_THREADING, "Adding thread %s ...", thread->Name());
@@ -123,7 +284,7 @@ void Manager::Process()
 		{
 		MsgThread* t = *i;
 
-		if ( do_beat )
+		if ( do_beat && t->HeartbeatDue() )
 			t->Heartbeat();
 
 		while ( t->HasOut() )
@@ -3,6 +3,8 @@
 #define THREADING_MANAGER_H
 
 #include <list>
+#include <thread>
+#include <vector>
 
 #include "iosource/IOSource.h"
 
@@ -78,6 +80,37 @@ public:
 	 */
 	void KillThreads();
 
+	/**
+	 * Pins the calling thread, Zeek's main one, to a CPU, and moves all
+	 * other threads, including those started later, to the remaining
+	 * CPUs of the same NUMA node. As Linux allocates memory on the node
+	 * of the thread first touching it, calling this before setting up
+	 * packet sources keeps their buffers local as well. Only supported
+	 * on Linux.
+	 *
+	 * @param cpu The CPU to pin the main thread to.
+	 *
+	 * @return False, with a reporter warning, if that didn't work.
+	 */
+	bool PinMainThread(int cpu);
+
+	/**
+	 * Moves a thread to where PinMainThread() puts threads other than
+	 * the main one. Threads that the main thread starts itself need
+	 * this, as they'd otherwise share its CPU; BasicThread::Start() and
+	 * threads started by other threads take care of that themselves.
+	 * Does nothing if the main thread isn't pinned.
+	 *
+	 * @param thread The thread.
+	 */
+	void PlaceThread(std::thread& thread);
+
+	/**
+	 * Returns the NUMA node of the main thread's CPU, or -1 if it isn't
+	 * pinned or the node isn't known.
+	 */
+	int MainThreadNode() const	{ return main_node; }
+
 protected:
 	friend class BasicThread;
 	friend class MsgThread;
@@ -132,6 +165,10 @@ private:
 	double next_beat;	// Timestamp when the next heartbeat will be sent.
 	bool terminating;	// True if we are in Terminate().
 
+	// With PinMainThread(), the CPUs for the other threads.
+	std::vector<int> thread_cpus;
+	int main_node;
+
 	msg_stats_list stats;
 };
 
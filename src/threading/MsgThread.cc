@@ -50,17 +50,23 @@ public:
 class HeartbeatMessage : public InputMessage<MsgThread>
 {
 public:
-	HeartbeatMessage(MsgThread* thread, double arg_network_time, double arg_current_time)
+	HeartbeatMessage(MsgThread* thread, double arg_network_time, double arg_current_time,
+			 uint64_t arg_seq)
 		: InputMessage<MsgThread>("Heartbeat", thread)
-		{ network_time = arg_network_time; current_time = arg_current_time; }
+		{ network_time = arg_network_time; current_time = arg_current_time; seq = arg_seq; }
 
 	virtual bool Process()	{
-		return Object()->OnHeartbeat(network_time, current_time);
+		bool result = Object()->OnHeartbeat(network_time, current_time);
+
+		// Everything sent before us has been processed by now.
+		Object()->idle_since = Object()->WantsHeartbeats() ? UINT64_MAX : seq;
+		return result;
 	}
 
 private:
 	double network_time;
 	double current_time;
+	uint64_t seq;	// cnt_sent_in including this message
 };
 
 // A message from the child to be passed on to the Reporter.
@@ -177,6 +183,8 @@ MsgThread::MsgThread() : BasicThread(), queue_in(this, 0), queue_out(0, this)
 	main_finished = false;
 	child_finished = false;
 	failed = false;
+	idle_since = UINT64_MAX;
+	heartbeat_needed = false;
 	thread_mgr->AddMsgThread(this);
 	}
 
@@ -258,7 +266,8 @@ void MsgThread::OnKill()
 
 void MsgThread::Heartbeat()
 	{
-	SendIn(new HeartbeatMessage(this, network_time, current_time()));
+	heartbeat_needed = false;
+	SendIn(new HeartbeatMessage(this, network_time, current_time(), cnt_sent_in + 1));
 	}
 
 void MsgThread::Finished()
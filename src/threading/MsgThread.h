@@ -2,6 +2,8 @@
 #ifndef THREADING_MSGTHREAD_H
 #define THREADING_MSGTHREAD_H
 
+#include <atomic>
+
 #include "DebugLogger.h"
 
 #include "BasicThread.h"
@@ -153,6 +155,15 @@ public:
 	void Debug(DebugStream stream, const char* msg);
 #endif
 
+	/**
+	 * Makes sure the next heartbeat goes to the thread even if it said
+	 * it doesn't need any, for example because the caller holds data
+	 * back until the thread asks for it in response to a heartbeat.
+	 *
+	 * Only the main thread may call this method.
+	 */
+	void WakeForHeartbeat()	{ heartbeat_needed = true; }
+
 	/**
 	 * Statistics about inter-thread communication.
 	 */
@@ -223,6 +234,14 @@ protected:
 	 */
 	virtual bool OnHeartbeat(double network_time, double current_time) = 0;
 
+	/**
+	 * Called in the child thread after each OnHeartbeat(). Returning
+	 * false says that further heartbeats would have nothing to do until
+	 * the thread gets another message; the main thread then stops
+	 * sending them. The default keeps them coming.
+	 */
+	virtual bool WantsHeartbeats()	{ return true; }
+
 	/** Triggered for execution in the child thread just before shutting threads down.
 	 *  The child thread should finish its operations.
 	 */
@@ -294,6 +313,14 @@ private:
 	 */
 	bool MightHaveOut() { return queue_out.MaybeReady(); }
 
+	/**
+	 * Returns false if the thread doesn't need a heartbeat. It doesn't
+	 * if it said so after the last one, and didn't get any other message
+	 * since. Must only be called by the main thread.
+	 */
+	bool HeartbeatDue() const
+		{ return heartbeat_needed || idle_since.load() != cnt_sent_in; }
+
 	/** Sends a message to the main thread signaling that the child process
 	 *  has finished processing. Called from child.
 	 */
@@ -308,6 +335,12 @@ private:
 	bool main_finished;	// Main thread is finished, meaning child_finished propagated back through message queue.
 	bool child_finished;	// Child thread is finished.
 	bool failed;	// Set to true when a command failed.
+
+	// The value of cnt_sent_in with the last heartbeat, if the thread
+	// said it didn't want more after that one; otherwise UINT64_MAX.
+	// Set by the child.
+	std::atomic<uint64_t> idle_since;
+	bool heartbeat_needed;	// Main thread only.
 };
 
 /**
@@ -1,10 +1,9 @@
 #ifndef THREADING_QUEUE_H
 #define THREADING_QUEUE_H
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
-#include <deque>
 #include <stdint.h>
 #include <sys/time.h>
 
@@ -18,13 +17,13 @@ namespace threading {
 /**
  * A thread-safe single-reader single-writer queue.
  *
- * The implementation uses multiple queues and reads/writes in rotary fashion
- * in an attempt to limit contention.
+ * The implementation is lock-free as long as there's data to read: the
+ * messages live in a linked list of fixed-size segments that the writer
+ * appends to and the reader consumes, coordinating only through two
+ * atomic counters. Only a reader finding the queue empty takes a lock,
+ * to block until something arrives.
  *
  * All Queue instances must be instantiated by Bro's main thread.
- *
- * TODO: Unclear how critical performance is for this qeueue. We could likely
- * optimize it further if helpful.
  */
 template<typename T>
 class Queue
@@ -59,7 +58,9 @@ public:
 	/**
 	 * Returns true if the next Get() operation will succeed.
 	 */
-	bool Ready();
+	bool Ready()
+		{ return num_reads.load(std::memory_order_relaxed) !=
+			 num_writes.load(std::memory_order_acquire); }
 
 	/**
 	 * Returns true if the next Get() operation might succeed. This
@@ -70,7 +71,9 @@ public:
 	 * it is empty. In other words, this method helps to avoid locking the queue
 	 * frequently, but doesn't allow you to forgo it completely.
 	 */
-	bool MaybeReady() { return (num_reads != num_writes); }
+	bool MaybeReady()
+		{ return num_reads.load(std::memory_order_relaxed) !=
+			 num_writes.load(std::memory_order_relaxed); }
 
 	/**
 	 * Wake up the reader if it's currently blocked for input. This is
@@ -81,7 +84,12 @@ public:
 	/**
 	 * Returns the number of queued items not yet retrieved.
 	 */
-	uint64_t Size();
+	uint64_t Size()
+		{
+		// Reads first, so that we can't see more of them than writes.
+		uint64_t r = num_reads.load(std::memory_order_acquire);
+		return num_writes.load(std::memory_order_acquire) - r;
+		}
 
 	/**
 	 * Statistics about inter-thread communication.
@@ -90,6 +98,7 @@ public:
 		{
 		uint64_t num_reads;	//! Number of messages read from the queue.
 		uint64_t num_writes;	//! Number of messages written to the queue.
+		uint64_t max_pending;	//! Most messages queued at any one time.
 		};
 
 	/**
@@ -101,23 +110,38 @@ public:
 	void GetStats(Stats* stats);
 
 private:
-	static const int NUM_QUEUES = 8;
+	static const int SEGMENT_SIZE = 256;
+	static const int CACHE_LINE_SIZE = 64;
+
+	struct Segment {
+		T items[SEGMENT_SIZE];
+		std::atomic<Segment*> next;
+	};
+
+	// Returns a segment to the writer for reuse, or frees it if there's
+	// one waiting for reuse already.
+	void Recycle(Segment* s);
+
+	// Writer side. Keeping it on separate cache lines from the
+	// reader's state avoids the two threads contending for them.
+	alignas(CACHE_LINE_SIZE) Segment* tail;	// Segment to write into.
+	std::atomic<uint64_t> num_writes;	// Also the next write position.
+	std::atomic<uint64_t> max_pending;
 
-	std::vector<std::unique_lock<std::mutex>> LocksForAllQueues();
+	// Reader side.
+	alignas(CACHE_LINE_SIZE) Segment* head;	// Segment to read from.
+	std::atomic<uint64_t> num_reads;	// Also the next read position.
 
-	std::mutex mutex[NUM_QUEUES];	// Mutex protected shared accesses.
-	std::condition_variable has_data[NUM_QUEUES];	// Signals when data becomes available
-	std::queue<T> messages[NUM_QUEUES];	// Actually holds the queued messages
+	// A consumed segment the writer can reuse.
+	alignas(CACHE_LINE_SIZE) std::atomic<Segment*> spare;
 
-	int read_ptr;	// Where the next operation will read from
-	int write_ptr;	// Where the next operation will write to
+	// For blocking the reader while the queue is empty.
+	std::mutex mutex;
+	std::condition_variable has_data;
+	std::atomic<bool> waiting;
 
 	BasicThread* reader;
 	BasicThread* writer;
-
-	// Statistics.
-	uint64_t num_reads;
-	uint64_t num_writes;
 };
 
 inline static std::unique_lock<std::mutex> acquire_lock(std::mutex& m)
@@ -137,9 +161,11 @@ inline static std::unique_lock<std::mutex> acquire_lock(std::mutex& m)
 template<typename T>
 inline Queue<T>::Queue(BasicThread* arg_reader, BasicThread* arg_writer)
 	{
-	read_ptr = 0;
-	write_ptr = 0;
-	num_reads = num_writes = 0;
+	head = tail = new Segment;
+	head->next = nullptr;
+	spare = nullptr;
+	num_reads = num_writes = max_pending = 0;
+	waiting = false;
 	reader = arg_reader;
 	writer = arg_writer;
 	}
@@ -147,116 +173,114 @@ inline Queue<T>::Queue(BasicThread* arg_reader, BasicThread* arg_writer)
 template<typename T>
 inline Queue<T>::~Queue()
 	{
+	while ( head )
+		{
+		Segment* next = head->next;
+		delete head;
+		head = next;
+		}
+
+	delete spare.load();
 	}
 
 template<typename T>
 inline T Queue<T>::Get()
 	{
-	auto lock = acquire_lock(mutex[read_ptr]);
-
-	int old_read_ptr = read_ptr;
+	uint64_t r = num_reads.load(std::memory_order_relaxed);
 
-	if ( messages[read_ptr].empty() && ! ((reader && reader->Killed()) || (writer && writer->Killed())) )
+	if ( r == num_writes.load() )
 		{
-		if ( has_data[read_ptr].wait_for(lock, std::chrono::seconds(5)) == std::cv_status::timeout )
+		if ( (reader && reader->Killed()) || (writer && writer->Killed()) )
 			return nullptr;
-		}
-
-	if ( messages[read_ptr].empty() )
-		return nullptr;
-
-	T data = messages[read_ptr].front();
-	messages[read_ptr].pop();
 
-	read_ptr = (read_ptr + 1) % NUM_QUEUES;
-	++num_reads;
-
-	return data;
-	}
+		auto lock = acquire_lock(mutex);
 
-template<typename T>
-inline void Queue<T>::Put(T data)
-	{
-	auto lock = acquire_lock(mutex[write_ptr]);
+		// The writer checks this after queueing, so once we have
+		// set it, we'll either see the new data below or get woken
+		// up for it.
+		waiting = true;
 
-	int old_write_ptr = write_ptr;
+		if ( r == num_writes.load() )
+			has_data.wait_for(lock, std::chrono::seconds(5));
 
-	bool need_signal = messages[write_ptr].empty();
+		waiting = false;
 
-	messages[write_ptr].push(data);
+		if ( r == num_writes.load() )
+			return nullptr;
+		}
 
-	write_ptr = (write_ptr + 1) % NUM_QUEUES;
-	++num_writes;
+	int pos = r % SEGMENT_SIZE;
 
-	if ( need_signal )
+	if ( pos == 0 && r > 0 )
 		{
-		lock.unlock();
-		has_data[old_write_ptr].notify_one();
+		// We're done with the current segment. The writer has
+		// linked in the next one before publishing this element.
+		Segment* old = head;
+		head = old->next.load(std::memory_order_acquire);
+		Recycle(old);
 		}
-	}
-
-
-template<typename T>
-inline bool Queue<T>::Ready()
-	{
-	auto lock = acquire_lock(mutex[read_ptr]);
 
-	bool ret = (messages[read_ptr].size());
+	T data = head->items[pos];
+	num_reads.store(r + 1, std::memory_order_release);
 
-	return ret;
+	return data;
 	}
 
 template<typename T>
-inline std::vector<std::unique_lock<std::mutex>> Queue<T>::LocksForAllQueues()
+inline void Queue<T>::Put(T data)
 	{
-	std::vector<std::unique_lock<std::mutex>> locks;
+	uint64_t w = num_writes.load(std::memory_order_relaxed);
+	int pos = w % SEGMENT_SIZE;
 
-	try
+	if ( pos == 0 && w > 0 )
 		{
-		for ( int i = 0; i < NUM_QUEUES; i++ )
-			locks.emplace_back(std::unique_lock<std::mutex>(mutex[i]));
+		Segment* s = spare.exchange(nullptr);
+
+		if ( ! s )
+			s = new Segment;
+
+		s->next.store(nullptr, std::memory_order_relaxed);
+		tail->next.store(s, std::memory_order_release);
+		tail = s;
 		}
 
-	catch ( const std::system_error& e )
+	tail->items[pos] = data;
+	num_writes.store(w + 1);
+
+	uint64_t pending = w + 1 - num_reads.load(std::memory_order_relaxed);
+
+	if ( pending > max_pending.load(std::memory_order_relaxed) )
+		max_pending.store(pending, std::memory_order_relaxed);
+
+	if ( waiting.load() )
 		{
-		reporter->FatalErrorWithCore("cannot lock all mutexes: %s", e.what());
-		// Never gets here.
-		throw std::exception();
+		auto lock = acquire_lock(mutex);
+		has_data.notify_one();
 		}
-
-	return locks;
 	}
 
 template<typename T>
-inline uint64_t Queue<T>::Size()
+inline void Queue<T>::Recycle(Segment* s)
 	{
-	// Need to lock all queues.
-	auto locks = LocksForAllQueues();
-
-	uint64_t size = 0;
+	Segment* expected = nullptr;
 
-	for ( int i = 0; i < NUM_QUEUES; i++ )
-		size += messages[i].size();
-
-	return size;
+	if ( ! spare.compare_exchange_strong(expected, s) )
+		delete s;
 	}
 
 template<typename T>
 inline void Queue<T>::GetStats(Stats* stats)
 	{
-	// To be safe, we look all queues. That's probably unneccessary, but
-	// doesn't really hurt.
-	auto locks = LocksForAllQueues();
-
-	stats->num_reads = num_reads;
-	stats->num_writes = num_writes;
+	stats->num_reads = num_reads.load(std::memory_order_relaxed);
+	stats->num_writes = num_writes.load(std::memory_order_relaxed);
+	stats->max_pending = max_pending.load(std::memory_order_relaxed);
 	}
 
 template<typename T>
 inline void Queue<T>::WakeUp()
 	{
-	for ( int i = 0; i < NUM_QUEUES; i++ )
-		has_data[i].notify_all();
+	auto lock = acquire_lock(mutex);
+	has_data.notify_all();
 	}
 
 }
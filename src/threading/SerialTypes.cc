@@ -1,12 +1,90 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
 
+#include <atomic>
+
 #include "SerialTypes.h"
 #include "SerializationFormat.h"
 #include "Reporter.h"
 
 using namespace threading;
 
+// Upper bound on the number of freed Values we hang on to.
+#define VALUE_POOL_MAX 65536
+
+namespace {
+
+// Freed Values, chained through their first bytes.
+struct FreeValue {
+	FreeValue* next;
+};
+
+// Any thread may add to the shared list, but threads only ever take the
+// whole list at once, into a cache of their own. That way, a node can't
+// get removed and re-added while someone else is trying to take it.
+std::atomic<FreeValue*> free_values(nullptr);
+
+// Number of Values in the shared list plus all threads' caches.
+std::atomic<int> num_free_values(0);
+
+struct ValueCache {
+	FreeValue* head = nullptr;
+
+	~ValueCache()
+		{
+		while ( head )
+			{
+			FreeValue* next = head->next;
+			::operator delete(head);
+			head = next;
+			--num_free_values;
+			}
+		}
+};
+
+thread_local ValueCache value_cache;
+
+}
+
+void* Value::operator new(size_t size)
+	{
+	if ( size == sizeof(Value) )
+		{
+		if ( ! value_cache.head )
+			value_cache.head = free_values.exchange(nullptr, std::memory_order_acquire);
+
+		if ( FreeValue* v = value_cache.head )
+			{
+			value_cache.head = v->next;
+			--num_free_values;
+			return v;
+			}
+		}
+
+	return ::operator new(size);
+	}
+
+void Value::operator delete(void* ptr, size_t size)
+	{
+	if ( size == sizeof(Value) &&
+	     num_free_values.load(std::memory_order_relaxed) < VALUE_POOL_MAX )
+		{
+		++num_free_values;
+
+		FreeValue* v = static_cast<FreeValue*>(ptr);
+		v->next = free_values.load(std::memory_order_relaxed);
+
+		while ( ! free_values.compare_exchange_weak(v->next, v,
+							    std::memory_order_release,
+							    std::memory_order_relaxed) )
+			;
+
+		return;
+		}
+
+	::operator delete(ptr);
+	}
+
 bool Field::Read(SerializationFormat* fmt)
 	{
 	int t;
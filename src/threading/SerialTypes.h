@@ -165,6 +165,15 @@ struct Value {
 	 */
 	~Value();
 
+	/**
+	 * Log writes create a Value per field, and they usually get freed
+	 * by a different thread than the one creating them. To avoid the
+	 * malloc traffic, the memory of freed Values gets recycled through
+	 * a lock-free pool shared by all threads.
+	 */
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	/**
 	 * Unserializes a value.
 	 *
@@ -100,8 +100,11 @@ bool Ascii::Describe(ODesc* desc, threading::Value* val, const string& name) con
 		break;
 
 	case TYPE_ADDR:
-		desc->Add(Render(val->val.addr_val));
+		{
+		char buf[INET6_ADDRSTRLEN];
+		desc->AddN(buf, Render(val->val.addr_val, buf));
 		break;
+		}
 
 	case TYPE_DOUBLE:
 		// Rendering via Add() truncates trailing 0s after the
@@ -115,8 +118,11 @@ bool Ascii::Describe(ODesc* desc, threading::Value* val, const string& name) con
 		// Rendering via Render() keeps trailing 0s after the decimal
 		// point. The difference with DOUBLE is mainly to keep the
 		// log format consistent.
-		desc->Add(Render(val->val.double_val));
+		{
+		char buf[256];
+		desc->AddN(buf, Render(val->val.double_val, buf));
 		break;
+		}
 
 	case TYPE_ENUM:
 	case TYPE_STRING:
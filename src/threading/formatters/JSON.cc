@@ -15,23 +15,97 @@
 
 using namespace threading::formatter;
 
+// Returns true for characters that we emit as 2byte Unicode escapes.
+static inline bool needs_escape(unsigned char c)
+	{
+	return c < 32 || c > 126 || c == '"' || c == '\'' || c == '\\' || c == '&';
+	}
+
+// Returns true if any of the 8 bytes in w needs escaping. This looks at
+// all of them at once, so that we can skip over clean text quickly.
+static inline bool word_needs_escape(uint64_t w)
+	{
+	const uint64_t ones = 0x0101010101010101ULL;
+	const uint64_t highs = 0x8080808080808080ULL;
+
+	// Bytes < 32 and bytes > 126.
+	uint64_t ctrl = (w - ones * 32) & ~w;
+	uint64_t high = (w + ones * 1) | w;
+
+	// Bytes equal to one of the special characters.
+	uint64_t quote = w ^ (ones * '"');
+	uint64_t apos = w ^ (ones * '\'');
+	uint64_t bslash = w ^ (ones * '\\');
+	uint64_t amp = w ^ (ones * '&');
+
+	uint64_t special = ((quote - ones) & ~quote) |
+	                   ((apos - ones) & ~apos) |
+	                   ((bslash - ones) & ~bslash) |
+	                   ((amp - ones) & ~amp);
+
+	return (ctrl | high | special) & highs;
+	}
+
+// Returns the position of the first character in s that needs escaping,
+// or len if there's none.
+static int find_escape(const char* s, int len)
+	{
+	int i = 0;
+
+	for ( ; i + 8 <= len; i += 8 )
+		{
+		uint64_t w;
+		memcpy(&w, s + i, sizeof(w));
+
+		if ( word_needs_escape(w) )
+			break;
+		}
+
+	for ( ; i < len; ++i )
+		if ( needs_escape(s[i]) )
+			break;
+
+	return i;
+	}
+
 JSON::JSON(MsgThread* t, TimeFormat tf) : Formatter(t), surrounding_braces(true)
 	{
 	timestamps = tf;
+	keys_fields = 0;
 	}
 
 JSON::~JSON()
 	{
 	}
 
+const std::vector<std::string>& JSON::Keys(int num_fields,
+                                           const Field* const * fields) const
+	{
+	if ( fields == keys_fields && int(keys.size()) == num_fields )
+		return keys;
+
+	keys.clear();
+
+	for ( int i = 0; i < num_fields; i++ )
+		keys.push_back(string("\"") + fields[i]->name + "\":");
+
+	keys_fields = fields;
+	return keys;
+	}
+
 bool JSON::Describe(ODesc* desc, int num_fields, const Field* const * fields,
                     Value** vals) const
 	{
+	const std::vector<std::string>& field_keys = Keys(num_fields, fields);
+
 	if ( surrounding_braces )
 		desc->AddRaw("{");
 
 	for ( int i = 0; i < num_fields; i++ )
 		{
+		if ( ! vals[i]->present )
+			continue;
+
 		const u_char* bytes = desc->Bytes();
 		int len = desc->Len();
 
@@ -39,11 +113,12 @@ bool JSON::Describe(ODesc* desc, int num_fields, const Field* const * fields,
 		     len > 0 &&
 		     bytes[len-1] != ',' &&
 		     bytes[len-1] != '{' &&
-		     bytes[len-1] != '[' &&
-		     vals[i]->present )
+		     bytes[len-1] != '[' )
 			desc->AddRaw(",");
 
-		if ( ! Describe(desc, vals[i], fields[i]->name) )
+		desc->AddRaw(field_keys[i]);
+
+		if ( ! Describe(desc, vals[i]) )
 			return false;
 		}
 
@@ -91,10 +166,13 @@ bool JSON::Describe(ODesc* desc, Value* val, const string& name) const
 			break;
 
 		case TYPE_ADDR:
+			{
+			char buf[INET6_ADDRSTRLEN];
 			desc->AddRaw("\"", 1);
-			desc->Add(Render(val->val.addr_val));
+			desc->AddN(buf, Render(val->val.addr_val, buf));
 			desc->AddRaw("\"", 1);
 			break;
+			}
 
 		case TYPE_DOUBLE:
 		case TYPE_INTERVAL:
@@ -154,24 +232,7 @@ bool JSON::Describe(ODesc* desc, Value* val, const string& name) const
 		case TYPE_FUNC:
 			{
 			desc->AddRaw("\"", 1);
-
-			for ( int i = 0; i < val->val.string_val.length; ++i )
-				{
-				char c = val->val.string_val.data[i];
-
-				// 2byte Unicode escape special characters.
-				if ( c < 32 || c > 126 || c == '\n' || c == '"' || c == '\'' || c == '\\' || c == '&' )
-					{
-					desc->AddRaw("\\u00", 4);
-					char hex[2] = {'0', '0'};
-					bytetohex(c, hex);
-					desc->AddRaw(hex, 1);
-					desc->AddRaw(hex + 1, 1);
-					}
-				else
-					desc->AddRaw(&c, 1);
-				}
-
+			AddEscaped(desc, val->val.string_val.data, val->val.string_val.length);
 			desc->AddRaw("\"", 1);
 			break;
 			}
@@ -214,6 +275,27 @@ bool JSON::Describe(ODesc* desc, Value* val, const string& name) const
 	return true;
 	}
 
+void JSON::AddEscaped(ODesc* desc, const char* s, int len) const
+	{
+	while ( len > 0 )
+		{
+		// Copy clean runs in one go.
+		int n = find_escape(s, len);
+		desc->AddRaw(s, n);
+
+		if ( n == len )
+			break;
+
+		// 2byte Unicode escape special characters.
+		char esc[6] = {'\\', 'u', '0', '0', '0', '0'};
+		bytetohex(s[n], esc + 4);
+		desc->AddRaw(esc, 6);
+
+		s += n + 1;
+		len -= n + 1;
+		}
+	}
+
 threading::Value* JSON::ParseValue(const string& s, const string& name, TypeTag type, TypeTag subtype) const
 	{
 	GetThread()->Error("JSON formatter does not support parsing yet.");
@@ -3,6 +3,9 @@
 #ifndef THREADING_FORMATTERS_JSON_H
 #define THREADING_FORMATTERS_JSON_H
 
+#include <string>
+#include <vector>
+
 #include "../Formatter.h"
 
 namespace threading { namespace formatter {
@@ -30,8 +33,19 @@ public:
 	void SurroundingBraces(bool use_braces);
 
 private:
+	// Adds the string with JSON escaping.
+	void AddEscaped(ODesc* desc, const char* s, int len) const;
+
+	// Returns the quoted key prefixes for the given fields, computing
+	// them only when they change.
+	const std::vector<std::string>& Keys(int num_fields,
+	                                     const threading::Field* const * fields) const;
+
 	TimeFormat timestamps;
 	bool surrounding_braces;
+
+	mutable std::vector<std::string> keys;
+	mutable const threading::Field* const * keys_fields;
 };
 
 }}
@@ -30,6 +30,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/resource.h>
+#include <sys/uio.h>
+#include <limits.h>
 #include <fcntl.h>
 #include <stdarg.h>
 #include <errno.h>
@@ -42,6 +44,10 @@
 # include <malloc.h>
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 #include "digest.h"
 #include "input.h"
 #include "util.h"
@@ -492,10 +498,25 @@ int strstr_n(const int big_len, const u_char* big,
 	if ( little_len > big_len )
 		return -1;
 
-	for ( int i = 0; i <= big_len - little_len; ++i )
+	if ( little_len == 0 )
+		return 0;
+
+	// Let memchr() find candidates for the first byte; it scans much
+	// faster than comparing at every position.
+	const u_char* p = big;
+	const u_char* last = big + big_len - little_len;
+
+	while ( p <= last )
 		{
-		if ( ! memcmp(big + i, little, little_len) )
-			return i;
+		p = (const u_char*) memchr(p, little[0], last - p + 1);
+
+		if ( ! p )
+			break;
+
+		if ( ! memcmp(p + 1, little + 1, little_len - 1) )
+			return p - big;
+
+		++p;
 		}
 
 	return -1;
@@ -1522,6 +1543,17 @@ double current_time(bool real)
 		(t - src->CurrentPacketWallClock());
 	}
 
+uint64 read_cycles()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+	}
+
 struct timeval double_to_timeval(double t)
 	{
 	struct timeval tv;
@@ -1542,8 +1574,12 @@ int time_compare(struct timeval* tv_a, struct timeval* tv_b)
 	}
 
 struct UIDEntry {
-	UIDEntry() : key(0, 0), needs_init(true) { }
-	UIDEntry(const uint64 i) : key(i, 0), needs_init(false) { }
+	UIDEntry() : key(0, 0), fast_key(0), needs_init(true) { }
+	UIDEntry(const uint64 i) : key(i, 0), needs_init(false)
+		{
+		// Keyed with the hash seed, just like the regular IDs.
+		fast_key = HashKey::HashBytes(&i, sizeof(i));
+		}
 
 	struct UIDKey {
 		UIDKey(uint64 i, uint64 c) : instance(i), counter(c) { }
@@ -1551,6 +1587,7 @@ struct UIDEntry {
 		uint64 counter;
 	} key;
 
+	uint64 fast_key;	// For calculate_fast_unique_id().
 	bool needs_init;
 };
 
@@ -1561,7 +1598,7 @@ uint64 calculate_unique_id()
 	return calculate_unique_id(UID_POOL_DEFAULT_INTERNAL);
 	}
 
-uint64 calculate_unique_id(size_t pool)
+static UIDEntry& uid_pool_entry(size_t pool)
 	{
 	uint64 uid_instance = 0;
 
@@ -1615,8 +1652,38 @@ uint64 calculate_unique_id(size_t pool)
 	assert(!uid_pool[pool].needs_init);
 	assert(uid_pool[pool].key.instance != 0);
 
-	++uid_pool[pool].key.counter;
-	return HashKey::HashBytes(&(uid_pool[pool].key), sizeof(uid_pool[pool].key));
+	return uid_pool[pool];
+	}
+
+uint64 calculate_unique_id(size_t pool)
+	{
+	UIDEntry& e = uid_pool_entry(pool);
+	++e.key.counter;
+	return HashKey::HashBytes(&e.key, sizeof(e.key));
+	}
+
+static inline uint64 fmix64(uint64 x)
+	{
+	// The MurmurHash3 finalizer, which is invertible.
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+	}
+
+uint64 calculate_fast_unique_id(size_t pool)
+	{
+	UIDEntry& e = uid_pool_entry(pool);
+	uint64 k = e.fast_key;
+
+	// All steps can be undone, so distinct counters never map to the
+	// same ID.
+	uint64 x = ++e.key.counter;
+	x = fmix64(x ^ k);
+	x = fmix64(x + (k << 32 | k >> 32));
+	return x ^ k;
 	}
 
 bool safe_write(int fd, const char* data, int len)
@@ -1643,6 +1710,41 @@ bool safe_write(int fd, const char* data, int len)
 	return true;
 	}
 
+bool safe_writev(int fd, struct iovec* iov, int iovcnt)
+	{
+	while ( iovcnt > 0 )
+		{
+		ssize_t n = writev(fd, iov, iovcnt < IOV_MAX ? iovcnt : IOV_MAX);
+
+		if ( n < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			fprintf(stderr, "safe_writev error: %d\n", errno);
+			abort();
+
+			return false;
+			}
+
+		// Skip what's been written, which may end within a buffer.
+		while ( iovcnt > 0 && size_t(n) >= iov->iov_len )
+			{
+			n -= iov->iov_len;
+			++iov;
+			--iovcnt;
+			}
+
+		if ( iovcnt > 0 )
+			{
+			iov->iov_base = (char*) iov->iov_base + n;
+			iov->iov_len -= n;
+			}
+		}
+
+	return true;
+	}
+
 bool safe_pwrite(int fd, const unsigned char* data, size_t len, size_t offset)
 	{
 	while ( len != 0 )
@@ -411,6 +411,10 @@ extern double network_time;
 // call with real=true).
 extern double current_time(bool real=false);
 
+// Returns a cheap, monotonic counter for measuring short durations: TSC
+// ticks on x86, nanoseconds elsewhere.
+extern uint64 read_cycles();
+
 // Convert a time represented as a double to a timeval struct.
 extern struct timeval double_to_timeval(double t);
 
@@ -427,6 +431,10 @@ extern int time_compare(struct timeval* tv_a, struct timeval* tv_b);
 extern uint64 calculate_unique_id();
 extern uint64 calculate_unique_id(const size_t pool);
 
+// Like calculate_unique_id(), but cheaper: the IDs come from a keyed
+// permutation of the pool's counter instead of a hash of it.
+extern uint64 calculate_fast_unique_id(const size_t pool);
+
 // For now, don't use hash_maps - they're not fully portable.
 #if 0
 // Use for hash_map's string keys.
@@ -469,6 +477,10 @@ inline size_t pad_size(size_t size)
 // thread-safe as long as no two threads write to the same descriptor.
 extern bool safe_write(int fd, const char* data, int len);
 
+// Same as safe_write(), but gathers the data from multiple buffers with
+// writev(). The iovec array gets modified.
+extern bool safe_writev(int fd, struct iovec* iov, int iovcnt);
+
 // Same as safe_write(), but for pwrite().
 extern bool safe_pwrite(int fd, const unsigned char* data, size_t len,
                         size_t offset);
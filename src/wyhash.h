@@ -0,0 +1,128 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef WYHASH_H
+#define WYHASH_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "zeek-config.h"
+
+// The final version 4 of wyhash, with its default secret.
+static const uint64_t wy_secret[4] = {
+	0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+inline void wy_mum(uint64_t* a, uint64_t* b)
+	{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = *a;
+	r *= *b;
+	*a = static_cast<uint64_t>(r);
+	*b = static_cast<uint64_t>(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = static_cast<uint32_t>(*a), lb = static_cast<uint32_t>(*b);
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32);
+	uint64_t c = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+	}
+
+inline uint64_t wy_mix(uint64_t a, uint64_t b)
+	{
+	wy_mum(&a, &b);
+	return a ^ b;
+	}
+
+// Reads are little-endian everywhere, for the same hashes on all nodes.
+inline uint64_t wy_r8(const uint8_t* p)
+	{
+	uint64_t v;
+	memcpy(&v, p, 8);
+#ifdef WORDS_BIGENDIAN
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+	}
+
+inline uint64_t wy_r4(const uint8_t* p)
+	{
+	uint32_t v;
+	memcpy(&v, p, 4);
+#ifdef WORDS_BIGENDIAN
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+	}
+
+inline uint64_t wy_r3(const uint8_t* p, size_t n)
+	{
+	return (uint64_t(p[0]) << 16) | (uint64_t(p[n >> 1]) << 8) | p[n - 1];
+	}
+
+inline uint64_t wyhash(const void* key, size_t len, uint64_t seed)
+	{
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(key);
+	uint64_t a, b;
+
+	seed ^= wy_mix(seed ^ wy_secret[0], wy_secret[1]);
+
+	if ( len <= 16 )
+		{
+		if ( len >= 4 )
+			{
+			a = (wy_r4(p) << 32) | wy_r4(p + ((len >> 3) << 2));
+			b = (wy_r4(p + len - 4) << 32) | wy_r4(p + len - 4 - ((len >> 3) << 2));
+			}
+		else if ( len > 0 )
+			{
+			a = wy_r3(p, len);
+			b = 0;
+			}
+		else
+			a = b = 0;
+		}
+	else
+		{
+		size_t i = len;
+
+		if ( i > 48 )
+			{
+			// Three independent lanes keep the multipliers busy.
+			uint64_t see1 = seed, see2 = seed;
+
+			do {
+				seed = wy_mix(wy_r8(p) ^ wy_secret[1], wy_r8(p + 8) ^ seed);
+				see1 = wy_mix(wy_r8(p + 16) ^ wy_secret[2], wy_r8(p + 24) ^ see1);
+				see2 = wy_mix(wy_r8(p + 32) ^ wy_secret[3], wy_r8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while ( i > 48 );
+
+			seed ^= see1 ^ see2;
+			}
+
+		while ( i > 16 )
+			{
+			seed = wy_mix(wy_r8(p) ^ wy_secret[1], wy_r8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+			}
+
+		a = wy_r8(p + i - 16);
+		b = wy_r8(p + i - 8);
+		}
+
+	a ^= wy_secret[1];
+	b ^= seed;
+	wy_mum(&a, &b);
+	return wy_mix(a ^ wy_secret[0] ^ len, b ^ wy_secret[1]);
+	}
+
+#endif
@@ -0,0 +1,72 @@
+#! /usr/bin/env python
+
+# A DNS server for tests that answers from made-up data and logs each
+# query it gets. Addresses in 10.0.0.0/24 map to host<n>.example and names
+# under ok.example to 10.0.0.<n>, where <n> is the first label's length.
+# Everything else gets NXDOMAIN.
+
+import optparse
+import socket
+import struct
+
+def parse_name(msg, off):
+    labels = []
+
+    while msg[off]:
+        n = msg[off]
+        labels.append(msg[off + 1:off + 1 + n].decode())
+        off += 1 + n
+
+    return ".".join(labels), off + 1
+
+def encode_name(name):
+    out = b""
+
+    for label in name.split("."):
+        out += struct.pack("!B", len(label)) + label.encode()
+
+    return out + b"\0"
+
+def answer(qname, qtype):
+    if qtype == 12 and qname.endswith(".0.0.10.in-addr.arpa"):
+        return 12, encode_name("host%s.example" % qname.split(".")[0])
+
+    if qtype == 1 and qname.endswith(".ok.example"):
+        return 1, socket.inet_aton("10.0.0.%d" % len(qname.split(".")[0]))
+
+    return None
+
+if __name__ == "__main__":
+    parser = optparse.OptionParser()
+    parser.add_option("--addr", default="127.0.0.1")
+    parser.add_option("--port", type="int", default=53)
+    parser.add_option("--ttl", type="int", default=300)
+    parser.add_option("--log", default="queries.log")
+    options, args = parser.parse_args()
+
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.bind((options.addr, options.port))
+    log = open(options.log, "w")
+    open("ready", "w").close()
+
+    while True:
+        msg, peer = s.recvfrom(512)
+        msg = bytearray(msg)
+        qid, = struct.unpack("!H", msg[:2])
+        qname, off = parse_name(msg, 12)
+        qtype, = struct.unpack("!H", msg[off:off + 2])
+        question = bytes(msg[12:off + 4])
+
+        log.write("%s %d\n" % (qname, qtype))
+        log.flush()
+
+        a = answer(qname, qtype)
+
+        if a:
+            rtype, rdata = a
+            reply = struct.pack("!HHHHHH", qid, 0x8180, 1, 1, 0, 0) + question
+            reply += struct.pack("!HHHIH", 0xc00c, rtype, 1, options.ttl, len(rdata)) + rdata
+        else:
+            reply = struct.pack("!HHHHHH", qid, 0x8183, 1, 0, 0, 0) + question
+
+        s.sendto(reply, peer)